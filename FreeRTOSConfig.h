@@ -108,7 +108,7 @@
 /* Memory allocation related definitions. */
 #define configSUPPORT_STATIC_ALLOCATION         0
 #define configSUPPORT_DYNAMIC_ALLOCATION        1
-#define configTOTAL_HEAP_SIZE                   ((size_t)(96*1024))
+#define configTOTAL_HEAP_SIZE                   ((size_t)(64*1024))
 #define configAPPLICATION_ALLOCATED_HEAP        0
 
 /* Hook function related definitions. */
@@ -119,10 +119,20 @@
 #define configUSE_DAEMON_TASK_STARTUP_HOOK      0
 
 /* Run time and task stats gathering related definitions. */
-#define configGENERATE_RUN_TIME_STATS           0
-#define configUSE_TRACE_FACILITY                0
+#define configGENERATE_RUN_TIME_STATS           1
+#define configUSE_TRACE_FACILITY                1
 #define configUSE_STATS_FORMATTING_FUNCTIONS    0
 
+/* The run time counter is the DWT cycle counter. It wraps every ~23 s at
+180 MHz, so consumers must sample more often than that and use differences. */
+#define portCONFIGURE_TIMER_FOR_RUN_TIME_STATS()                        \
+    do {                                                                \
+        (*(volatile uint32_t *)0xE000EDFCUL) |= (1UL << 24); /* DEMCR.TRCENA */ \
+        (*(volatile uint32_t *)0xE0001004UL) = 0;            /* DWT_CYCCNT */   \
+        (*(volatile uint32_t *)0xE0001000UL) |= 1UL;         /* DWT_CTRL.CYCCNTENA */ \
+    } while (0)
+#define portGET_RUN_TIME_COUNTER_VALUE() (*(volatile uint32_t *)0xE0001004UL)
+
 /* Co-routine related definitions. */
 #define configUSE_CO_ROUTINES                   0
 #define configMAX_CO_ROUTINE_PRIORITIES         2
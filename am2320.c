@@ -4,6 +4,7 @@
 #include "eeprom_rtc.h"
 #include "am2320.h"
 #include "i2c_lock.h"
+#include "crc.h"
 
 static void AM2320_Delay(volatile long time);
 static void AM2320_SDA_Output(void);
@@ -167,7 +168,8 @@ uint16_t u16CRC = 0;
 
 
 void Getdata_AM2320(void){
-  uint16_t u16HumiRh1=0,u16Temper1=0,u16CRC1=0;
+  uint8_t i;
+  uint8_t frame[8];
 
   Wake_AM2320();
   AM2320_Delay(_AM2320_800us); // Delay min = 800us
@@ -177,17 +179,16 @@ void Getdata_AM2320(void){
   AM2320_Start();
   AM2320_WriteI2C(AM2320_ADDR_R,AM2320_ACK);
   AM2320_Delay(_AM2320_30us); // Delay min = 30us
-  AM2320_ReadI2C(AM2320_ACK);
-  AM2320_ReadI2C(AM2320_ACK);
-  u16HumiRh1  = AM2320_ReadI2C(AM2320_ACK)<<8;
-  u16HumiRh1 |= AM2320_ReadI2C(AM2320_ACK);
-  u16Temper1  = AM2320_ReadI2C(AM2320_ACK)<<8;
-  u16Temper1 |= AM2320_ReadI2C(AM2320_ACK);
-  u16CRC1  = AM2320_ReadI2C(AM2320_ACK);
-  u16CRC1 |= AM2320_ReadI2C(AM2320_ACK)<<8;
+  // Function code, byte count, humidity, temperature, CRC (low byte first)
+  for(i = 0; i < 8; i++)
+    frame[i] = AM2320_ReadI2C(AM2320_ACK);
   AM2320_Stop();
   
-  u16HumiRh = u16HumiRh1;
-  u16Temper = u16Temper1;
-  u16CRC = u16CRC1;
+  u16CRC = frame[6] | (frame[7]<<8);
+  // Keep the previous reading when the frame is corrupted
+  if(crc16ModbusCalc(frame, 6) != u16CRC)
+    return;
+  
+  u16HumiRh = (frame[2]<<8) | frame[3];
+  u16Temper = (frame[4]<<8) | frame[5];
 }		
@@ -0,0 +1,283 @@
+/* capture.c
+* Export of the in-RAM packet capture as a pcap file, uploaded to an FTP
+* server or published in base64 chunks on the MQTT capture topic
+*/
+#include "net_config.h"
+#include "core/net.h"
+#include "core/net_capture.h"
+#include "ftp/ftp_client.h"
+#include "capture.h"
+#include "ftp.h"
+#include "debug.h"
+// FreeRTOS inclusions
+#include "os_port_config.h"
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "snmpConnect_manager.h"
+#include "mqtt_client/mqtt_json_make.h"
+#include "mqtt_client/app_mqtt_client.h"
+#include "variables.h"
+
+#include <stdlib.h>
+
+#if (NET_CAPTURE_SUPPORT == ENABLED)
+
+typedef struct {
+	FtpClientContext* ftpContext;	// FTP data connection, NULL when publishing over MQTT
+	const char* interfaceName;		// "ethernet" or "gprs", as in the other MQTT messages
+	NetBuffer* chunk;				// FTP chunk being staged, the data connection sends from it
+	uint8_t buffer[CAPTURE_CHUNK_SIZE];
+	size_t length;
+	uint32_t sequence;
+} CaptureExportContext_t;
+
+static const char base64Table[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+static CaptureExportContext_t exportContext;
+static char exportEncoded[(CAPTURE_CHUNK_SIZE + 2) / 3 * 4 + 1];
+static CaptureExportInfo_t exportInfo;
+static TaskHandle_t captureExportTask = NULL;
+
+/* base64 encoding of a chunk, the output is null terminated */
+static void CAPTURE_Base64Encode(const uint8_t* input, size_t length, char* output)
+{
+	uint32_t value;
+	size_t i;
+	for (i = 0; i + 2 < length; i += 3)
+	{
+		value = (input[i] << 16) | (input[i + 1] << 8) | input[i + 2];
+		*output++ = base64Table[(value >> 18) & 0x3F];
+		*output++ = base64Table[(value >> 12) & 0x3F];
+		*output++ = base64Table[(value >> 6) & 0x3F];
+		*output++ = base64Table[value & 0x3F];
+	}
+	// one or two bytes left, padded with '='
+	if (i < length)
+	{
+		value = input[i] << 16;
+		if (i + 1 < length)
+			value |= input[i + 1] << 8;
+		*output++ = base64Table[(value >> 18) & 0x3F];
+		*output++ = base64Table[(value >> 12) & 0x3F];
+		*output++ = (i + 1 < length) ? base64Table[(value >> 6) & 0x3F] : '=';
+		*output++ = '=';
+	}
+	*output = 0;
+}
+
+/* send the staged pcap bytes to the FTP server or the MQTT broker */
+static error_t CAPTURE_Flush(bool_t last)
+{
+	error_t error = NO_ERROR;
+	char* message;
+	uint32_t pubDepth, rcvDepth;
+	uint32_t wait;
+	if (exportContext.ftpContext != NULL)
+	{
+		// the data connection frees the chunk once the server acknowledged it
+		if (exportContext.chunk != NULL)
+		{
+			netBufferSetLength(exportContext.chunk, exportContext.length);
+			error = ftpWriteFileBuffer(exportContext.ftpContext, exportContext.chunk, 0, 0);
+			exportContext.chunk = NULL;
+		}
+	}
+	else
+	{
+		CAPTURE_Base64Encode(exportContext.buffer, exportContext.length, exportEncoded);
+		message = mqtt_json_make_capture_chunk(deviceName, (char*)exportContext.interfaceName,
+											   exportContext.sequence, last, exportEncoded);
+		if (message == NULL)
+			return ERROR_OUT_OF_MEMORY;
+		// the publish queue is shared with the periodic reports, leave room for them
+		for (wait = 0; wait < CAPTURE_MQTT_QUEUE_WAIT; wait++)
+		{
+			mqttGetQueueDepth(&pubDepth, &rcvDepth);
+			if (pubDepth < MQTT_CLIENT_QUEUE_SIZE / 2)
+				break;
+			osDelayTask(100);
+		}
+		if (wait == CAPTURE_MQTT_QUEUE_WAIT)
+			error = ERROR_TIMEOUT;
+		else
+			mqttPublishMsg(CAPTURE_MQTT_TOPIC, message, strlen(message));
+		free(message);
+	}
+	exportContext.length = 0;
+	exportContext.sequence++;
+	return error;
+}
+
+/* pcap write callback, stage the bytes and flush full chunks */
+static error_t CAPTURE_Write(void* param, const void* data, size_t length)
+{
+	error_t error = NO_ERROR;
+	const uint8_t* p = (const uint8_t*)data;
+	size_t n;
+	(void)param;
+	while ((length > 0) && !error)
+	{
+		n = MIN(length, CAPTURE_CHUNK_SIZE - exportContext.length);
+		if (exportContext.ftpContext != NULL)
+		{
+			// staged straight into a network buffer, not copied again into the send buffer
+			if (exportContext.chunk == NULL)
+				exportContext.chunk = netBufferAlloc(CAPTURE_CHUNK_SIZE);
+			if (exportContext.chunk == NULL)
+				return ERROR_OUT_OF_MEMORY;
+			netBufferWrite(exportContext.chunk, exportContext.length, p, n);
+		}
+		else
+			memcpy(exportContext.buffer + exportContext.length, p, n);
+		exportContext.length += n;
+		p += n;
+		length -= n;
+		if (exportContext.length == CAPTURE_CHUNK_SIZE)
+			error = CAPTURE_Flush(FALSE);
+	}
+	return error;
+}
+
+/* upload the capture to the FTP server as a pcap file */
+static CaptureExportStatus_t CAPTURE_ExportFtp(CaptureExportInfo_t* info, uint_t* frames)
+{
+	FtpClientContext ftpContext;
+	IpAddr ipAddr;
+	error_t error;
+	CaptureExportStatus_t status = CAPTURE_EXPORT_SUCCESS;
+	// bulk transfers only go over Ethernet
+	if (interfaceManagerGetClassInterface(TRAFFIC_CLASS_BULK) == NULL)
+		return CAPTURE_EXPORT_NETWORK_ERROR;
+	error = getHostByName(NULL, info->serverIp, &ipAddr, HOST_NAME_ALLOW_STALE);
+	if (error)
+	{
+		TRACE_INFO("Failed to resolve server name!\r\n");
+		return CAPTURE_EXPORT_SERVER_CONNECT_ERROR;
+	}
+	error = ftpConnect(&ftpContext, interfaceManagerGetClassInterface(TRAFFIC_CLASS_BULK), &ipAddr, FTP_SERVER_PORT, FTP_NO_SECURITY | FTP_PASSIVE_MODE);
+	if (error)
+	{
+		TRACE_INFO("Failed to connect to FTP server!\r\n");
+		return CAPTURE_EXPORT_SERVER_CONNECT_ERROR;
+	}
+	do
+	{
+		error = ftpLogin(&ftpContext, FTP_USER, FTP_PSW, "");
+		if (error)
+		{
+			status = CAPTURE_EXPORT_LOGIN_ERROR;
+			break;
+		}
+		error = ftpOpenFile(&ftpContext, info->fileName, FTP_FOR_WRITING | FTP_BINARY_TYPE);
+		if (error)
+		{
+			status = CAPTURE_EXPORT_FILE_OPEN_ERROR;
+			break;
+		}
+		exportContext.ftpContext = &ftpContext;
+		error = netCaptureExport(info->interface, CAPTURE_Write, NULL, frames);
+		if (!error)
+			error = CAPTURE_Flush(TRUE);
+		if (error)
+			status = CAPTURE_EXPORT_WRITE_ERROR;
+		// a chunk left by a failed write
+		if (exportContext.chunk != NULL)
+		{
+			netBufferFree(exportContext.chunk);
+			exportContext.chunk = NULL;
+		}
+		// the server only keeps the file once the data connection is closed properly
+		if (ftpCloseFile(&ftpContext) && (status == CAPTURE_EXPORT_SUCCESS))
+			status = CAPTURE_EXPORT_WRITE_ERROR;
+	} while (0);
+	TRACE_INFO("FTP Connection closed...\r\n");
+	ftpClose(&ftpContext);
+	return status;
+}
+
+/* publish the capture on the MQTT capture topic */
+static CaptureExportStatus_t CAPTURE_ExportMqtt(CaptureExportInfo_t* info, uint_t* frames)
+{
+	error_t error;
+	// the chunks share the MQTT session, which must be on the bulk link
+	if ((interfaceManagerGetClassInterface(TRAFFIC_CLASS_BULK) == NULL) ||
+		(interfaceManagerGetClassInterface(TRAFFIC_CLASS_TELEMETRY) != interfaceManagerGetClassInterface(TRAFFIC_CLASS_BULK)))
+		return CAPTURE_EXPORT_NETWORK_ERROR;
+	exportContext.ftpContext = NULL;
+	error = netCaptureExport(info->interface, CAPTURE_Write, NULL, frames);
+	// the last message may be empty, it tells the receiver the file is complete
+	if (!error)
+		error = CAPTURE_Flush(TRUE);
+	return error ? CAPTURE_EXPORT_WRITE_ERROR : CAPTURE_EXPORT_SUCCESS;
+}
+
+void CAPTURE_ExportTask(void* param)
+{
+	CaptureExportInfo_t* info = (CaptureExportInfo_t*)param;
+	CaptureExportStatus_t status;
+	uint_t frames = 0;
+	char* reportMessage;
+	// the ring must not change while it is exported
+	netCaptureStop();
+	exportContext.interfaceName = (info->interface == ETH_INTERFACE) ? "ethernet" : "gprs";
+	exportContext.length = 0;
+	exportContext.sequence = 0;
+	if (info->serverIp != NULL)
+		status = CAPTURE_ExportFtp(info, &frames);
+	else
+		status = CAPTURE_ExportMqtt(info, &frames);
+	TRACE_INFO("Capture export: %d frames, status %d\r\n", frames, status);
+	reportMessage = mqtt_json_make_capture_result(deviceName, (char*)exportContext.interfaceName, info->serverIp,
+												  info->fileName, frames, (int32_t)status);
+	if (reportMessage != NULL)
+	{
+		mqttPublishMsg(MQTT_EVENT_TOPIC, reportMessage, strlen(reportMessage));
+		free(reportMessage);
+	}
+	free(info->serverIp);
+	free(info->fileName);
+	info->serverIp = NULL;
+	info->fileName = NULL;
+	captureExportTask = NULL;
+	vTaskDelete(NULL);
+}
+
+static char* CAPTURE_CopyString(const char* string)
+{
+	char* copy;
+	if (string == NULL)
+		return NULL;
+	copy = malloc(strlen(string) + 1);
+	if (copy != NULL)
+		strcpy(copy, string);
+	return copy;
+}
+
+void CAPTURE_StartExport(NetInterface* interface, const char* serverIp, const char* fileName)
+{
+	if ((interface == NULL) || ((serverIp != NULL) && (fileName == NULL)))
+	{
+		TRACE_INFO("Invalid capture export value\r\n");
+		return;
+	}
+	if (captureExportTask != NULL)
+	{
+		TRACE_INFO("Capture export already running\r\n");
+		return;
+	}
+	exportInfo.interface = interface;
+	exportInfo.serverIp = CAPTURE_CopyString(serverIp);
+	exportInfo.fileName = CAPTURE_CopyString(fileName);
+	if (xTaskCreate(CAPTURE_ExportTask, "capture export task", 1024, (void*)&exportInfo, tskIDLE_PRIORITY + 1, &captureExportTask) != pdPASS)
+	{
+		TRACE_INFO("Create capture export task failed\r\n");
+		free(exportInfo.serverIp);
+		free(exportInfo.fileName);
+		exportInfo.serverIp = NULL;
+		exportInfo.fileName = NULL;
+		captureExportTask = NULL;
+	}
+}
+
+#endif
@@ -0,0 +1,27 @@
+#ifndef __CAPTURE_H__
+#define __CAPTURE_H__
+#include "core/net.h"
+#include "core/net_capture.h"
+
+#define CAPTURE_MQTT_TOPIC			"DAQ/capture"
+#define CAPTURE_CHUNK_SIZE			600 // pcap bytes per FTP write or MQTT message (800 once base64 encoded)
+#define CAPTURE_MQTT_QUEUE_WAIT		50  // wait for the MQTT publish queue at most 50 x 100 ms per chunk
+
+typedef enum {
+	CAPTURE_EXPORT_SUCCESS = 0,
+	CAPTURE_EXPORT_NETWORK_ERROR,
+	CAPTURE_EXPORT_SERVER_CONNECT_ERROR,
+	CAPTURE_EXPORT_LOGIN_ERROR,
+	CAPTURE_EXPORT_FILE_OPEN_ERROR,
+	CAPTURE_EXPORT_WRITE_ERROR,
+} CaptureExportStatus_t;
+
+typedef struct stCaptureExportInfo {
+	NetInterface* interface;	// interface whose frames are exported
+	char* serverIp;				// FTP server, NULL to publish over MQTT
+	char* fileName;
+} CaptureExportInfo_t;
+
+void CAPTURE_StartExport(NetInterface* interface, const char* serverIp, const char* fileName);
+
+#endif
@@ -0,0 +1,558 @@
+/**
+* @file data_usage.c
+* @brief Monthly data usage per interface and traffic class, with a GPRS budget
+*
+* Every frame sent or received by the network controllers is charged to a
+* traffic class by the accounting hook of the stack. The IP datagram goes to
+* the class of its protocol and ports, the framing around it to the link
+* class. The counters of the current month are kept in EEPROM and saved
+* every hour, on a change of stage and before a reset; only the bytes that
+* changed are written.
+*
+* The GPRS budget covers the IP bytes of the GPRS interface, which is what the
+* operator bills. As it runs out the device gives up, in order: indented JSON,
+* most of the periodic telemetry and the info traps sent over GPRS
+*
+* @section License
+* ^^(^____^)^^
+*
+**/
+
+//Dependencies
+#include "core/net.h"
+#include "snmp/snmp_common.h"
+#include "dns/dns_common.h"
+#include "data_usage.h"
+#include "snmpConnect_manager.h"
+#include "mqtt_client/app_mqtt_client.h"
+#include "mqtt_client/mqtt_json_make.h"
+#include "variables.h"
+#include "eeprom_rtc.h"
+#include "i2c_lock.h"
+#include "task.h"
+#include "debug.h"
+#include <stdlib.h>
+
+#if (USERDEF_DATA_USAGE == ENABLED)
+
+/**
+* @brief Data usage context
+**/
+typedef struct
+{
+  DataUsageRecord record;                               ///<Counters, updated under the stack mutex
+  DataUsageRecord saved;                                ///<Image of the EEPROM record
+  OsMutex mutex;                                        ///<Serializes the EEPROM writes
+  bool_t running;
+  DataUsageStage stage;
+  bool_t saveRequest;
+  bool_t resetRequest;
+  systime_t saveTime;
+} DataUsageContext;
+
+//Names of the traffic classes, as used in MQTT and in the MIB
+static const char_t *const dataUsageClassNames[DATA_USAGE_CLASS_COUNT] =
+{
+  "mqtt_telemetry",
+  "mqtt_command",
+  "snmp",
+  "dns",
+  "ftp",
+  "icmp",
+  "link",
+  "other"
+};
+
+static const char_t *const dataUsageStageNames[] =
+{
+  "normal",
+  "compact",
+  "saving",
+  "exceeded"
+};
+
+static DataUsageContext dataUsageContext;
+
+//========================================
+//Function Implementation
+//========================================
+
+/**
+* @brief Charge an IP datagram to a traffic class
+* @param[in] frame Frame seen by the network controller
+* @return Traffic class
+**/
+static uint_t dataUsageClassify(const NetAccountingFrame *frame)
+{
+  uint16_t srcPort = frame->srcPort;
+  uint16_t destPort = frame->destPort;
+
+  if(frame->ipProtocol == IPV4_PROTOCOL_ICMP || frame->ipProtocol == IPV6_ICMPV6_HEADER)
+    return DATA_USAGE_CLASS_ICMP;
+
+  //Later fragments do not carry the ports
+  if(srcPort == 0 && destPort == 0)
+    return DATA_USAGE_CLASS_OTHER;
+
+  if(frame->ipProtocol == IP_PROTOCOL_TCP)
+  {
+    //The broker acknowledges what the device publishes and the other way
+    //round, so the direction tells the two MQTT classes apart
+    if(srcPort == APP_SERVER_PORT || destPort == APP_SERVER_PORT)
+    {
+      if(frame->direction == NET_ACCOUNTING_DIR_TX)
+        return DATA_USAGE_CLASS_MQTT_TELEMETRY;
+      else
+        return DATA_USAGE_CLASS_MQTT_COMMAND;
+    }
+    if(srcPort == DNS_PORT || destPort == DNS_PORT)
+      return DATA_USAGE_CLASS_DNS;
+    //The FTP client is the only other TCP user, and its passive data
+    //connections use whatever port the server picks
+    return DATA_USAGE_CLASS_FTP;
+  }
+  else if(frame->ipProtocol == IP_PROTOCOL_UDP)
+  {
+    if(srcPort == SNMP_PORT || destPort == SNMP_PORT ||
+      srcPort == SNMP_TRAP_PORT || destPort == SNMP_TRAP_PORT)
+      return DATA_USAGE_CLASS_SNMP;
+    if(srcPort == DNS_PORT || destPort == DNS_PORT)
+      return DATA_USAGE_CLASS_DNS;
+  }
+
+  return DATA_USAGE_CLASS_OTHER;
+}
+
+/**
+* @brief Accounting callback, called by the stack with its mutex held
+* @param[in] frame Frame seen by the network controller
+* @param[in] param Data usage context
+**/
+static void dataUsageAccount(const NetAccountingFrame *frame, void *param)
+{
+  DataUsageContext *context = (DataUsageContext *) param;
+  DataUsageCounter *counters;
+  DataUsageCounter *counter;
+  uint_t dir;
+
+  if(frame->interface == ETH_INTERFACE)
+    counters = context->record.counters[DATA_USAGE_IF_ETHERNET];
+  else if(frame->interface == GPRS_INTERFACE)
+    counters = context->record.counters[DATA_USAGE_IF_GPRS];
+  else
+    return;
+
+  dir = frame->direction;
+  //Framing bytes always go to the link class, and so does a whole frame
+  //that carries no IP datagram
+  counters[DATA_USAGE_CLASS_LINK].bytes[dir] += frame->linkLength;
+  if(frame->ipLength == 0)
+  {
+    counters[DATA_USAGE_CLASS_LINK].packets[dir]++;
+    return;
+  }
+
+  counter = &counters[dataUsageClassify(frame)];
+  counter->bytes[dir] += frame->ipLength;
+  counter->packets[dir]++;
+}
+
+/**
+* @brief Evaluate the stage of the budget
+* @param[in] record Usage of the current month
+* @return Stage
+**/
+static DataUsageStage dataUsageEvalStage(const DataUsageRecord *record)
+{
+  uint64_t budget;
+  uint64_t used;
+
+  //No budget, no restriction
+  if(record->budget == 0)
+    return DATA_USAGE_STAGE_NORMAL;
+
+  budget = (uint64_t) record->budget * 1024;
+  used = dataUsageGetGprsBytes(record);
+
+  if(used >= budget)
+    return DATA_USAGE_STAGE_EXCEEDED;
+  else if(used * 100 >= budget * DATA_USAGE_SAVING_PERCENT)
+    return DATA_USAGE_STAGE_SAVING;
+  else if(used * 100 >= budget * DATA_USAGE_COMPACT_PERCENT)
+    return DATA_USAGE_STAGE_COMPACT;
+  else
+    return DATA_USAGE_STAGE_NORMAL;
+}
+
+/**
+* @brief Start a new month when the clock moves past the counted one
+*
+* The clock only moves the period forward, so that an RTC that lost its time
+* does not wipe the counters. Usage counted before the clock was known is
+* kept in the first known month
+*
+* @param[in] context Data usage context
+* @return TRUE if the period changed
+**/
+static bool_t dataUsageCheckMonth(DataUsageContext *context)
+{
+  DataUsageRecord *record = &context->record;
+  uint8_t year = GTime.year;
+  uint8_t month = GTime.month;
+
+  //Clock not read yet?
+  if(month < 1 || month > 12)
+    return FALSE;
+  if(record->month != 0 && year * 12 + month <= record->year * 12 + record->month)
+    return FALSE;
+
+  osAcquireMutex(&netMutex);
+  if(record->month != 0)
+  {
+    record->lastMonthBytes = dataUsageGetGprsBytes(record);
+    memset(record->counters, 0, sizeof(record->counters));
+  }
+  record->year = year;
+  record->month = month;
+  osReleaseMutex(&netMutex);
+
+  //Debug message
+  TRACE_INFO("Data usage: counting %02u/20%02u\r\n", month, year);
+  return TRUE;
+}
+
+/**
+* @brief Read the record from EEPROM
+* @param[in] context Data usage context
+**/
+static void dataUsageLoad(DataUsageContext *context)
+{
+  uint_t i;
+  uint8_t *p = (uint8_t *) &context->saved;
+
+  for(i = 0; i < sizeof(DataUsageRecord); i++)
+  {
+    I2C_Get_Lock();
+    vTaskSuspendAll();
+    p[i] = ReadEEPROM_Byte(DATA_USAGE_EEPROM_ADDR + i);
+    xTaskResumeAll();
+    I2C_Release_Lock();
+  }
+
+  if(context->saved.magic == DATA_USAGE_MAGIC)
+  {
+    memcpy(&context->record, &context->saved, sizeof(DataUsageRecord));
+  }
+  else
+  {
+    //Blank or older EEPROM, the image is left as read so that the whole
+    //record gets written by the first save
+    memset(&context->record, 0, sizeof(DataUsageRecord));
+    context->record.magic = DATA_USAGE_MAGIC;
+    context->record.budget = DATA_USAGE_DEFAULT_BUDGET;
+    context->saveRequest = TRUE;
+  }
+}
+
+/**
+* @brief Write the bytes of the record that changed since the last save
+*
+* A byte takes 20 ms to write with the scheduler suspended, so the lock is
+* released between bytes and most saves only touch the low bytes of a few
+* counters
+*
+* @param[in] context Data usage context
+**/
+static void dataUsageWrite(DataUsageContext *context)
+{
+  static DataUsageRecord record;
+  uint_t i;
+  uint_t n;
+  const uint8_t *p = (const uint8_t *) &record;
+  uint8_t *q = (uint8_t *) &context->saved;
+
+  osAcquireMutex(&context->mutex);
+  dataUsageGetRecord(&record);
+
+  for(i = 0, n = 0; i < sizeof(DataUsageRecord); i++)
+  {
+    if(p[i] != q[i])
+    {
+      I2C_Get_Lock();
+      vTaskSuspendAll();
+      WriteEEPROM_Byte(DATA_USAGE_EEPROM_ADDR + i, p[i]);
+      xTaskResumeAll();
+      I2C_Release_Lock();
+      q[i] = p[i];
+      n++;
+    }
+  }
+
+  context->saveTime = osGetSystemTime();
+  osReleaseMutex(&context->mutex);
+
+  //Debug message
+  TRACE_INFO("Data usage: %u bytes saved\r\n", n);
+}
+
+/**
+* @brief Data usage task
+*
+* Loads the counters, then keeps the stage of the budget and the period up to
+* date and saves the counters
+*
+* @param[in] param Unused parameter
+**/
+void dataUsageTask(void *param)
+{
+  DataUsageContext *context = &dataUsageContext;
+  static DataUsageRecord record;
+  DataUsageStage stage;
+  systime_t start;
+  bool_t save;
+  bool_t publish;
+
+  if(!osCreateMutex(&context->mutex))
+  {
+    //Debug message
+    TRACE_ERROR("Data usage: failed to create mutex!\r\n");
+    osDeleteTask(NULL);
+  }
+
+  //The month is taken from the RTC
+  start = osGetSystemTime();
+  while((GTime.month < 1 || GTime.month > 12) &&
+    timeCompare(osGetSystemTime(), start + DATA_USAGE_CLOCK_TIMEOUT) < 0)
+  {
+    osDelayTask(100);
+  }
+
+  dataUsageLoad(context);
+  dataUsageCheckMonth(context);
+  context->stage = dataUsageEvalStage(&context->record);
+  context->saveTime = osGetSystemTime();
+  context->running = TRUE;
+
+  if(netAccountingRegisterCallback(dataUsageAccount, context))
+  {
+    //Debug message
+    TRACE_ERROR("Data usage: failed to register the accounting callback!\r\n");
+  }
+
+  //Debug message
+  TRACE_INFO("Data usage: budget %u kB, stage %s\r\n", context->record.budget,
+    dataUsageGetStageName(context->stage));
+
+  while(1)
+  {
+    save = FALSE;
+    publish = FALSE;
+
+    if(context->resetRequest)
+    {
+      context->resetRequest = FALSE;
+      osAcquireMutex(&netMutex);
+      memset(context->record.counters, 0, sizeof(context->record.counters));
+      osReleaseMutex(&netMutex);
+      save = TRUE;
+    }
+    if(context->saveRequest)
+    {
+      context->saveRequest = FALSE;
+      save = TRUE;
+    }
+    //Last month's totals are reported once
+    if(dataUsageCheckMonth(context))
+    {
+      save = TRUE;
+      publish = TRUE;
+    }
+
+    dataUsageGetRecord(&record);
+    stage = dataUsageEvalStage(&record);
+    if(stage != context->stage)
+    {
+      //Debug message
+      TRACE_WARNING("Data usage: stage %s, %u kB of %u kB\r\n", dataUsageGetStageName(stage),
+        (uint_t) (dataUsageGetGprsBytes(&record) / 1024), record.budget);
+      context->stage = stage;
+      save = TRUE;
+      publish = TRUE;
+    }
+
+    if(save || timeCompare(osGetSystemTime(), context->saveTime + DATA_USAGE_SAVE_PERIOD) >= 0)
+      dataUsageWrite(context);
+    if(publish)
+      dataUsagePublish(GPRS_INTERFACE);
+
+    osDelayTask(DATA_USAGE_POLL_PERIOD);
+  }
+}
+
+/**
+* @brief Set the monthly GPRS budget
+* @param[in] budget Budget (kB, 0 for none)
+**/
+void dataUsageSetBudget(uint32_t budget)
+{
+  //Applied and saved by the data usage task
+  dataUsageContext.record.budget = budget;
+  dataUsageContext.saveRequest = TRUE;
+}
+
+/**
+* @brief Clear the counters of the current month
+**/
+void dataUsageReset(void)
+{
+  dataUsageContext.resetRequest = TRUE;
+}
+
+/**
+* @brief Save the counters now, before a reset
+**/
+void dataUsageSave(void)
+{
+  //Nothing to save before the record is loaded
+  if(dataUsageContext.running)
+    dataUsageWrite(&dataUsageContext);
+}
+
+/**
+* @brief Get a consistent copy of the counters
+* @param[out] record Usage of the current month
+**/
+void dataUsageGetRecord(DataUsageRecord *record)
+{
+  osAcquireMutex(&netMutex);
+  memcpy(record, &dataUsageContext.record, sizeof(DataUsageRecord));
+  osReleaseMutex(&netMutex);
+}
+
+/**
+* @brief Get the GPRS bytes charged to the budget
+* @param[in] record Usage of the current month
+* @return IP bytes sent and received over GPRS
+**/
+uint64_t dataUsageGetGprsBytes(const DataUsageRecord *record)
+{
+  const DataUsageCounter *counter;
+  uint64_t n;
+  uint_t i;
+
+  n = 0;
+  for(i = 0; i < DATA_USAGE_CLASS_COUNT; i++)
+  {
+    //The operator bills IP traffic, the framing is not charged
+    if(i == DATA_USAGE_CLASS_LINK)
+      continue;
+    counter = &record->counters[DATA_USAGE_IF_GPRS][i];
+    n += counter->bytes[0] + counter->bytes[1];
+  }
+  return n;
+}
+
+/**
+* @brief Get the stage of the budget
+* @return Stage
+**/
+DataUsageStage dataUsageGetStage(void)
+{
+  return dataUsageContext.stage;
+}
+
+/**
+* @brief Get the name of a traffic class
+* @param[in] trafficClass Traffic class
+* @return Name of the class
+**/
+const char_t *dataUsageGetClassName(uint_t trafficClass)
+{
+  if(trafficClass >= DATA_USAGE_CLASS_COUNT)
+    return "unknown";
+  return dataUsageClassNames[trafficClass];
+}
+
+/**
+* @brief Get the name of a stage
+* @param[in] stage Stage of the budget
+* @return Name of the stage
+**/
+const char_t *dataUsageGetStageName(DataUsageStage stage)
+{
+  if(stage >= arraysize(dataUsageStageNames))
+    return "unknown";
+  return dataUsageStageNames[stage];
+}
+
+/**
+* @brief Check whether the MQTT messages must be printed without indentation
+* @return TRUE once the budget reaches the compact stage
+**/
+bool_t dataUsageCompactJson(void)
+{
+  return (dataUsageContext.stage >= DATA_USAGE_STAGE_COMPACT);
+}
+
+/**
+* @brief Get the ratio between the telemetry period and the MQTT update period
+* @return 1 to send telemetry on every update, N to send it every N updates
+**/
+uint_t dataUsageGetTelemetryDivider(void)
+{
+  //Only the GPRS link is metered
+  if(interfaceManagerGetClassInterface(TRAFFIC_CLASS_TELEMETRY) != GPRS_INTERFACE)
+    return 1;
+
+  if(dataUsageContext.stage >= DATA_USAGE_STAGE_EXCEEDED)
+    return DATA_USAGE_EXCEEDED_DIVIDER;
+  else if(dataUsageContext.stage >= DATA_USAGE_STAGE_SAVING)
+    return DATA_USAGE_SAVING_DIVIDER;
+  else
+    return 1;
+}
+
+/**
+* @brief Check whether the periodic info traps are to be dropped
+* @param[in] interface Interface the traps are sent on
+* @return TRUE over GPRS once the budget reaches the saving stage
+**/
+bool_t dataUsageSuppressInfoTraps(NetInterface *interface)
+{
+  return (interface == GPRS_INTERFACE && dataUsageContext.stage >= DATA_USAGE_STAGE_SAVING);
+}
+
+/**
+* @brief Publish the counters on the MQTT event topic
+* @param[in] interface Interface to report, or NULL for all of them
+**/
+void dataUsagePublish(NetInterface *interface)
+{
+#if (USERDEF_MQTT_CLIENT == ENABLED)
+  DataUsageRecord *record;
+  char *message;
+  uint_t i;
+
+  //Too large for the stacks of the calling tasks
+  record = osAllocMem(sizeof(DataUsageRecord));
+  if(record == NULL)
+    return;
+  dataUsageGetRecord(record);
+
+  for(i = 0; i < DATA_USAGE_IF_COUNT; i++)
+  {
+    if(interface != NULL && interface != &netInterface[i])
+      continue;
+    message = mqtt_json_make_data_usage(deviceName, i, record, dataUsageContext.stage);
+    if(message != NULL)
+    {
+      mqttPublishMsg(MQTT_EVENT_TOPIC, message, strlen(message));
+      free(message);
+    }
+  }
+
+  osFreeMem(record);
+#endif
+}
+
+#endif
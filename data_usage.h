@@ -0,0 +1,122 @@
+/**
+* @file data_usage.h
+* @brief Monthly data usage per interface and traffic class, with a GPRS budget
+*
+* @section License
+* ^^(^____^)^^
+*
+**/
+
+#ifndef __DATA_USAGE_H
+#define __DATA_USAGE_H
+
+#include "net_config.h"
+#include "core/net.h"
+#include "core/net_accounting.h"
+
+#if (USERDEF_DATA_USAGE == ENABLED && NET_ACCOUNTING_SUPPORT != ENABLED)
+#error USERDEF_DATA_USAGE requires NET_ACCOUNTING_SUPPORT
+#endif
+
+//Stages of the budget, as a percentage of the monthly GPRS budget
+#ifndef DATA_USAGE_COMPACT_PERCENT
+#define DATA_USAGE_COMPACT_PERCENT      75
+#endif
+#ifndef DATA_USAGE_SAVING_PERCENT
+#define DATA_USAGE_SAVING_PERCENT       90
+#endif
+//Telemetry is sent once every N periods over GPRS while saving, and once
+//every M periods once the budget is exceeded
+#ifndef DATA_USAGE_SAVING_DIVIDER
+#define DATA_USAGE_SAVING_DIVIDER       4
+#endif
+#ifndef DATA_USAGE_EXCEEDED_DIVIDER
+#define DATA_USAGE_EXCEEDED_DIVIDER     16
+#endif
+//Budget of a blank EEPROM (kB, 0 for no budget)
+#ifndef DATA_USAGE_DEFAULT_BUDGET
+#define DATA_USAGE_DEFAULT_BUDGET       0
+#endif
+//Interval between two saves of the counters to EEPROM (ms)
+#ifndef DATA_USAGE_SAVE_PERIOD
+#define DATA_USAGE_SAVE_PERIOD          3600000
+#endif
+//Interval between two updates of the stage and of the MIB (ms)
+#define DATA_USAGE_POLL_PERIOD          1000
+//Time allowed for the RTC to be read after boot (ms)
+#define DATA_USAGE_CLOCK_TIMEOUT        5000
+//Identifies the layout of the EEPROM record
+#define DATA_USAGE_MAGIC                0xDA7A0001
+#define DATA_USAGE_STACK_SIZE           400
+
+//Interfaces, in the order of netInterface[]
+#define DATA_USAGE_IF_ETHERNET          0
+#define DATA_USAGE_IF_GPRS              1
+#define DATA_USAGE_IF_COUNT             2
+
+/**
+* @brief Traffic classes
+**/
+typedef enum
+{
+  DATA_USAGE_CLASS_MQTT_TELEMETRY,                      ///<MQTT sent by the device
+  DATA_USAGE_CLASS_MQTT_COMMAND,                        ///<MQTT received from the broker
+  DATA_USAGE_CLASS_SNMP,                                ///<Traps, informs and agent requests
+  DATA_USAGE_CLASS_DNS,
+  DATA_USAGE_CLASS_FTP,                                 ///<FTP control and data connections
+  DATA_USAGE_CLASS_ICMP,                                ///<Link probes
+  DATA_USAGE_CLASS_LINK,                                ///<PPP or Ethernet framing, LCP, IPCP, ARP...
+  DATA_USAGE_CLASS_OTHER,
+  DATA_USAGE_CLASS_COUNT
+} DataUsageClass;
+
+/**
+* @brief Stages of the budget
+**/
+typedef enum
+{
+  DATA_USAGE_STAGE_NORMAL,
+  DATA_USAGE_STAGE_COMPACT,                             ///<Compact JSON
+  DATA_USAGE_STAGE_SAVING,                              ///<Fewer telemetry messages, no info traps over GPRS
+  DATA_USAGE_STAGE_EXCEEDED                             ///<Telemetry at the lowest rate
+} DataUsageStage;
+
+/**
+* @brief Counter of a traffic class, index 0 received, 1 sent
+**/
+typedef struct
+{
+  uint64_t bytes[2];
+  uint32_t packets[2];
+} DataUsageCounter;
+
+/**
+* @brief Usage of the current month, as stored in EEPROM
+**/
+typedef struct
+{
+  uint32_t magic;
+  uint8_t year;                                         ///<Month being counted, as in GTime (0 if unknown)
+  uint8_t month;
+  uint32_t budget;                                      ///<Monthly GPRS budget (kB of 1024 bytes, 0 for none)
+  uint64_t lastMonthBytes;                              ///<GPRS bytes charged to the budget last month
+  DataUsageCounter counters[DATA_USAGE_IF_COUNT][DATA_USAGE_CLASS_COUNT];
+} DataUsageRecord;
+
+//=======================================
+//Function declearation
+//=======================================
+void dataUsageTask(void *param);
+void dataUsageSetBudget(uint32_t budget);
+void dataUsageReset(void);
+void dataUsageSave(void);
+void dataUsageGetRecord(DataUsageRecord *record);
+uint64_t dataUsageGetGprsBytes(const DataUsageRecord *record);
+DataUsageStage dataUsageGetStage(void);
+const char_t *dataUsageGetClassName(uint_t trafficClass);
+const char_t *dataUsageGetStageName(DataUsageStage stage);
+bool_t dataUsageCompactJson(void);
+uint_t dataUsageGetTelemetryDivider(void);
+bool_t dataUsageSuppressInfoTraps(NetInterface *interface);
+void dataUsagePublish(NetInterface *interface);
+#endif
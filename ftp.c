@@ -20,12 +20,10 @@
 #include "mqtt_client/mqtt_json_make.h"
 #include "mqtt_client/app_mqtt_client.h"
 #include "variables.h"
+#include "crc.h"
 
 #include <stdlib.h>
 
-#define FTP_USER		"DAQ_FIRMWARE"
-#define FTP_PSW			"12345678"
-#define FTP_SERVER_PORT 21
 #define FIRMWARE_KEY_1	0x55AAAA55
 #define FIRMWARE_KEY_2 	0x2112FEEF
 
@@ -55,9 +53,10 @@ void FTP_FirmwareUpdateTask(void* param)
     size_t writeBufferFreeCount;
 	FtpFwUpdateStatus_t status;
 	char* reportMessage;
+	uint32_t imageCrc;
     //Debug message
     TRACE_INFO("\r\n\r\nResolving server name...\r\n");
-    error = getHostByName(NULL, serverInfo->serverIp, &ipAddr, 0);
+    error = getHostByName(NULL, serverInfo->serverIp, &ipAddr, HOST_NAME_ALLOW_STALE);
     if(error)
     {
         //Debug message
@@ -77,7 +76,8 @@ void FTP_FirmwareUpdateTask(void* param)
     //Debug message
     TRACE_INFO("Connecting to FTP server for firmware update%s\r\n", ipAddrToString(&ipAddr, NULL));
 //    osDelayTask(10000);
-	if (interfaceManagerGetActiveInterface() == NULL)
+	//Firmware images only go over Ethernet
+	if (interfaceManagerGetClassInterface(TRAFFIC_CLASS_BULK) == NULL)
 	{
 		TRACE_INFO("Failed to resolve server name!\r\n");
 		reportMessage = mqtt_json_make_fw_update_result(deviceName, serverInfo->serverIp, serverInfo->fileName, 
@@ -91,8 +91,8 @@ void FTP_FirmwareUpdateTask(void* param)
 		serverInfo->fileSize = 0;
         vTaskDelete(NULL);
 	}
-    //Connect to the FTP server using active interface
-    error = ftpConnect(&ftpContext, interfaceManagerGetActiveInterface(), &ipAddr, FTP_SERVER_PORT, FTP_NO_SECURITY | FTP_PASSIVE_MODE);
+    //Connect to the FTP server on the bulk link
+    error = ftpConnect(&ftpContext, interfaceManagerGetClassInterface(TRAFFIC_CLASS_BULK), &ipAddr, FTP_SERVER_PORT, FTP_NO_SECURITY | FTP_PASSIVE_MODE);
     
     if(error)
     {
@@ -134,6 +134,7 @@ void FTP_FirmwareUpdateTask(void* param)
 	totalRead = 0;
     totalWrite = 0;
     writeBufferOffset = 0;
+	imageCrc = 0;
 	status = FW_UPDATE_STATUS_SUCCESS;
     do
     {
@@ -162,6 +163,8 @@ void FTP_FirmwareUpdateTask(void* param)
 				break;
 			}
             totalRead += length;
+            // CRC of the image as received from the server
+            imageCrc = crc32Update(imageCrc, firmwareBuffer, length);
             TRACE_INFO("Read %d bytes, total %d bytes of %d bytes\r\n", length, totalRead, serverInfo->fileSize);
             // data alignment for flash to write is 8 bytes
             // this code for handle data alignment
@@ -223,6 +226,16 @@ void FTP_FirmwareUpdateTask(void* param)
 			IFLASH_Erase(IMAGE_START_ADDR, IMAGE_SIZE);
 			imageGetStatus = false;
 		}
+		// read the image back from flash, it must match what was received
+		// and the CRC announced by the server if any
+		else if ((crc32Calc((const void*)IMAGE_START_ADDR, totalWrite) != imageCrc) ||
+				 (serverInfo->crcPresent && (serverInfo->crc != imageCrc)))
+		{
+			TRACE_INFO("Image CRC error: %08X, expected %08X\r\n", imageCrc, serverInfo->crc);
+			status = FW_UPDATE_STATUS_CRC_ERROR;
+			IFLASH_Erase(IMAGE_START_ADDR, IMAGE_SIZE);
+			imageGetStatus = false;
+		}
 		else
 		{
 			// all image has receive - restart device to let bootloader update new image
@@ -259,6 +272,9 @@ void FTP_FirmwareUpdateTask(void* param)
 		else
 		{
 			// reset system to let boot loader handle the transfer
+#if (USERDEF_DATA_USAGE == ENABLED)
+			dataUsageSave();
+#endif
 			hal_system_reset();
 		}
 	}
@@ -269,7 +285,8 @@ void FTP_FirmwareUpdateTask(void* param)
     vTaskDelete(NULL);
 }
 
-void FTP_SetInformation(const char* fileName, const char* serverIp, uint32_t fileSize)
+void FTP_SetInformation(const char* fileName, const char* serverIp, uint32_t fileSize,
+						bool_t crcPresent, uint32_t crc)
 {
 	char *name;
 	char *server;
@@ -282,16 +299,19 @@ void FTP_SetInformation(const char* fileName, const char* serverIp, uint32_t fil
 	firmwareInfo.fileSize = fileSize;
 	firmwareInfo.fileName = name;
 	firmwareInfo.serverIp = server;
+	firmwareInfo.crcPresent = crcPresent;
+	firmwareInfo.crc = crc;
 }
 
-void FTP_StartFirmwareUpdate(const char* fileName, const char* serverIp, uint32_t fileSize)
+void FTP_StartFirmwareUpdate(const char* fileName, const char* serverIp, uint32_t fileSize,
+							 bool_t crcPresent, uint32_t crc)
 {
 	if ((fileName == NULL) || (serverIp == NULL) || (fileSize == 0) || (fileSize > FTP_FIRMWARE_MAX_SIZE))
 	{
 		TRACE_INFO("Invalid firmware value\r\n");
 		return;
 	}
-	FTP_SetInformation(fileName, serverIp, fileSize);
+	FTP_SetInformation(fileName, serverIp, fileSize, crcPresent, crc);
 	if (xTaskCreate(FTP_FirmwareUpdateTask, "ftp firmware task", 1024, (void*)&firmwareInfo, tskIDLE_PRIORITY + 1, &ftpFirmwareTask) != pdPASS)
 	{
 		TRACE_INFO("Create ftp task failed\r\n");
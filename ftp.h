@@ -2,6 +2,10 @@
 #define __FTP_H__
 #include "core/net.h"
 
+#define FTP_USER		"DAQ_FIRMWARE"
+#define FTP_PSW			"12345678"
+#define FTP_SERVER_PORT 21
+
 #define FTP_FIRMWARE_MAX_SIZE		983040
 #define FTP_FIRMWARE_BUFFER_SIZE	1024 // firmware buffer size must be even divided by firmware max size
 
@@ -14,14 +18,18 @@ typedef enum {
 	FW_UPDATE_STATUS_FILE_READ_ERROR,
 	FW_UPDATE_STATUS_FILE_SIZE_ERROR,
 	FW_UPDATE_STATUS_FLASH_ERROR,
+	FW_UPDATE_STATUS_CRC_ERROR,
 } FtpFwUpdateStatus_t;
 
 typedef struct stFtpServerInfo {
 	char* serverIp;
 	char* fileName;
 	size_t fileSize;
+	bool_t crcPresent;
+	uint32_t crc;	// CRC-32 of the image, checked when crcPresent is set
 } FtpServerInfo_t;
 
-void FTP_StartFirmwareUpdate(const char* fileName, const char* serverIp, uint32_t fileSize);
+void FTP_StartFirmwareUpdate(const char* fileName, const char* serverIp, uint32_t fileSize,
+							 bool_t crcPresent, uint32_t crc);
 
 #endif
\ No newline at end of file
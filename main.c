@@ -27,6 +27,7 @@
 #include "app_ethernet.h"
 #include "test.h"
 #include "hal_system.h"
+#include "crc.h"
 
 #include "clock_config.h"
 #include "pin_mux.h"
@@ -90,6 +91,8 @@ int_t main(void)
         
     //Initialize kernel
     osInitKernel();
+    //CRC engine (hardware CRC module needs the kernel for its mutex)
+    crcInit();
 #if (USERDEF_GPRS == ENABLED)
     gprs_init();
 #endif
@@ -102,8 +105,7 @@ int_t main(void)
 /********** Create SNMP Task *************/
 #if (USERDEF_CLIENT_SNMP == ENABLED)
     SnmpInitMib();
-    error = SnmpInitClient(ethernetInterface);
-    error = SnmpInitClient(pppInterface);
+    error = SnmpInitClient();
     //Create TrapSend task
     if (error == NO_ERROR)
     {
@@ -29,6 +29,7 @@
 #include "core/net.h"
 #include "ppp/ppp.h"
 #include "modem.h"
+#include "modem_at.h"
 #include "modem_ports.h"
 #include "debug.h"
 #include "fsl_debug_console.h"
@@ -42,6 +43,138 @@
 #define APP_PPP_SECONDARY_DNS "0.0.0.0"
 #define APP_PPP_TIMEOUT 10000
 
+//Power sequence of the M26: the supply settles, then PWRKEY is held low
+//for more than 1 s. The module reports RDY when it accepts commands
+#define MODEM_SUPPLY_SETTLE_TIME 500
+#define MODEM_PWRKEY_ON_TIME 1100
+#define MODEM_BOOT_TIMEOUT 10000
+//Time allowed to register to the network once configured
+#define MODEM_REGISTER_TIMEOUT 30000
+
+/**
+* @brief Information response collected into a buffer
+**/
+typedef struct
+{
+  char_t *buffer;
+  size_t size;
+  size_t length;
+} ModemResponse;
+
+static ModemState modemState;
+
+/**
+* @brief Append an information line to a response
+* @param[in] line Received line
+* @param[in] param Pointer to the ModemResponse
+**/
+static void modemResponseLine(const char_t *line, void *param)
+{
+  ModemResponse *response = (ModemResponse *) param;
+  size_t n;
+
+  //Lines are separated by a line feed, the ones that do not fit are dropped
+  n = strlen(line);
+  if(response->length + n + 2 > response->size)
+    return;
+  if(response->length > 0)
+    response->buffer[response->length++] = '\n';
+  strcpy(response->buffer + response->length, line);
+  response->length += n;
+}
+
+/**
+* @brief Parse the status of a +CREG response or URC
+* @param[in] line Received line
+* @param[in] param Non-NULL for the response to AT+CREG?, which starts with the URC mode
+**/
+static void modemCregLine(const char_t *line, void *param)
+{
+  const char_t *p;
+
+  p = strchr(line, ':');
+  if(p == NULL)
+    return;
+  //+CREG: <n>,<stat> answers the query, +CREG: <stat> is the URC
+  if(param != NULL)
+  {
+    p = strchr(p, ',');
+    if(p == NULL)
+      return;
+  }
+  modemState.registration = (uint8_t) atoi(p + 1);
+  //Debug message
+  TRACE_INFO("Modem registration %u\r\n", modemState.registration);
+}
+
+/**
+* @brief +CREG URC
+**/
+static void modemCregUrc(const char_t *line, void *param)
+{
+  modemCregLine(line, NULL);
+}
+
+/**
+* @brief +CSQN URC, the signal level
+**/
+static void modemSignalUrc(const char_t *line, void *param)
+{
+  const char_t *p;
+
+  p = strchr(line, ':');
+  if(p != NULL)
+    modemState.signal = (uint8_t) atoi(p + 1);
+}
+
+/**
+* @brief RDY and Call Ready, the module accepts commands
+**/
+static void modemReadyUrc(const char_t *line, void *param)
+{
+  modemState.ready = TRUE;
+}
+
+/**
+* @brief RING, incoming calls are not answered
+**/
+static void modemRingUrc(const char_t *line, void *param)
+{
+  modemState.rings++;
+}
+
+/**
+* @brief NO CARRIER outside a command, the call has ended
+**/
+static void modemNoCarrierUrc(const char_t *line, void *param)
+{
+  modemState.carrierLost++;
+  //Debug message
+  TRACE_INFO("Modem call ended\r\n");
+}
+
+/**
+* @brief NORMAL POWER DOWN and UNDER-VOLTAGE POWER DOWN
+**/
+static void modemPowerDownUrc(const char_t *line, void *param)
+{
+  modemState.powered = FALSE;
+  modemState.ready = FALSE;
+  modemState.configured = FALSE;
+  modemState.registration = 0;
+  //Debug message
+  TRACE_ERROR("Modem %s\r\n", line);
+}
+
+/**
+* @brief An answer to AT means the module is ready, with or without RDY
+**/
+static void modemProbeDone(error_t error, void *param)
+{
+  if(!error)
+    modemState.ready = TRUE;
+}
+
 void modemInitGPIO()
 {
   /* Sim select and sim oe pin don't exist in this board */
@@ -55,15 +188,38 @@ void modemInitGPIO()
   MODEM_PWR_INIT(0);
 }
 
+/**
+* @brief Start the AT command engine and register the URC handlers
+* @param[in] interface Underlying network interface
+**/
+
+void modemInitEngine(NetInterface *interface)
+{
+  modemAtInit(interface);
+  modemAtRegisterUrc("+CREG:", modemCregUrc, NULL);
+  modemAtRegisterUrc("+CSQN:", modemSignalUrc, NULL);
+  modemAtRegisterUrc("RDY", modemReadyUrc, NULL);
+  modemAtRegisterUrc("Call Ready", modemReadyUrc, NULL);
+  modemAtRegisterUrc("RING", modemRingUrc, NULL);
+  modemAtRegisterUrc("NO CARRIER", modemNoCarrierUrc, NULL);
+  modemAtRegisterUrc("NORMAL POWER DOWN", modemPowerDownUrc, NULL);
+  modemAtRegisterUrc("UNDER-VOLTAGE POWER DOWN", modemPowerDownUrc, NULL);
+}
+
 void modemTurnOn()
 {
-  vTaskDelay(1000 / portTICK_PERIOD_MS);
+  //The settings are lost, the static facts are kept
+  modemState.ready = FALSE;
+  modemState.configured = FALSE;
+  modemState.registration = 0;
+  modemAtSetDataMode(FALSE);
+
   GPRS_PWR_ON();
-  vTaskDelay(3000 / portTICK_PERIOD_MS);
+  vTaskDelay(MODEM_SUPPLY_SETTLE_TIME / portTICK_PERIOD_MS);
   GPRS_EN_OFF();
-  vTaskDelay(3000/ portTICK_PERIOD_MS);
+  vTaskDelay(MODEM_PWRKEY_ON_TIME / portTICK_PERIOD_MS);
   GPRS_EN_ON();
-  vTaskDelay(1000 / portTICK_PERIOD_MS);
+  modemState.powered = TRUE;
 }
 void modemTurnOff()
 {
@@ -72,9 +228,67 @@ void modemTurnOff()
   GPRS_EN_ON();
   vTaskDelay(1000 / portTICK_PERIOD_MS);
   GPRS_PWR_OFF();
+
+  modemState.powered = FALSE;
+  modemState.ready = FALSE;
+  modemState.configured = FALSE;
+  modemState.registration = 0;
+  modemAtSetDataMode(FALSE);
+}
+
+/**
+* @brief Wait for the module to accept commands after power on
+* @return Error code
+**/
+
+static error_t modemWaitReady(void)
+{
+  systime_t start;
+
+  start = osGetSystemTime();
+  while(!modemState.ready)
+  {
+    if(timeCompare(osGetSystemTime(), start + MODEM_BOOT_TIMEOUT) >= 0)
+      return ERROR_TIMEOUT;
+    //A module set to autobauding sends no RDY, so it is probed as well
+    if(modemAtIdle())
+      modemAtQueue("AT\r", MODEM_AT_SHORT_TIMEOUT, NULL, modemProbeDone, NULL);
+    osDelayTask(MODEM_AT_POLL_INTERVAL);
+    modemAtPoll();
+  }
+
+  //A probe still in progress is not needed anymore
+  modemAtFlush();
+  return NO_ERROR;
+}
+
+/**
+* @brief Wait for the +CREG URC reporting the module registered
+* @return Error code
+**/
+
+static error_t modemWaitRegistered(void)
+{
+  systime_t start;
+
+  start = osGetSystemTime();
+  while(!modemIsRegistered())
+  {
+    if(!modemState.powered || timeCompare(osGetSystemTime(), start + MODEM_REGISTER_TIMEOUT) >= 0)
+      return ERROR_TIMEOUT;
+    osDelayTask(MODEM_AT_POLL_INTERVAL);
+    modemAtPoll();
+  }
+
+  return NO_ERROR;
 }
+
 /**
 * @brief Modem initialization
+*
+* Called once the module has been turned on. The model, revision and ICCID
+* are queried at the first power on only
+*
 * @param[in] interface Underlying network interface
 * @return Error code
 **/
@@ -83,7 +297,11 @@ error_t modemInit(NetInterface *interface)
 {
   error_t error;
   char_t buffer[128];
-  uint8_t nRetry;
+  char_t pin[32];
+  ModemResponse model;
+  ModemResponse revision;
+  ModemResponse iccid;
+  ModemResponse status;
   
   //Set timeout for blocking operations
   pppSetTimeout(interface, APP_PPP_TIMEOUT);
@@ -91,47 +309,59 @@ error_t modemInit(NetInterface *interface)
   //Debug message
   TRACE_INFO("Reseting modem...\r\n"); 
   
-  //Debug message
-  TRACE_INFO("Initializing modem...\r\n");
-  
-  //Module identification
-  error = modemSendAtCommand(interface, "AT+CGMM\r", buffer, sizeof(buffer));
+  //Wait for RDY
+  error = modemWaitReady();
   //Any error to report?
   if(error)
     return error;
   
-  //Get software version
-  error = modemSendAtCommand(interface, "AT+CGMR\r", buffer, sizeof(buffer));
-  //Any error to report?
-  if(error)
-    return error;
+  //Debug message
+  TRACE_INFO("Initializing modem...\r\n");
   
-  //Enable verbose mode
-  error = modemSendAtCommand(interface, "AT+CMEE=2\r", buffer, sizeof(buffer));
-  //Any error to report?
-  if(error)
-    return error;
+  //Module identification, software version and ICCID of the SIM card
+  if(!modemState.infoValid)
+  {
+    model.buffer = modemState.model;
+    model.size = sizeof(modemState.model);
+    model.length = 0;
+    modemAtQueue("AT+CGMM\r", MODEM_AT_SHORT_TIMEOUT, modemResponseLine, NULL, &model);
+    revision.buffer = modemState.revision;
+    revision.size = sizeof(modemState.revision);
+    revision.length = 0;
+    modemAtQueue("AT+CGMR\r", MODEM_AT_SHORT_TIMEOUT, modemResponseLine, NULL, &revision);
+    iccid.buffer = modemState.iccid;
+    iccid.size = sizeof(modemState.iccid);
+    iccid.length = 0;
+    modemAtQueue("AT+QCCID\r", MODEM_AT_SHORT_TIMEOUT, modemResponseLine, NULL, &iccid);
+  }
   
+  //Enable verbose mode
+  modemAtQueue("AT+CMEE=2\r", MODEM_AT_SHORT_TIMEOUT, NULL, NULL, NULL);
   //Enable hardware flow control
-  error = modemSendAtCommand(interface, "AT+IFC=2,2\r", buffer, sizeof(buffer));
-  //Any error to report?
-  if(error)
-    return error;
-  
-  //Query the ICCID of the SIM card
-  error = modemSendAtCommand(interface, "AT+QCCID\r", buffer, sizeof(buffer));
-  //Any error to report?
-  if(error)
-    return error;
+  modemAtQueue("AT+IFC=2,2\r", MODEM_AT_SHORT_TIMEOUT, NULL, NULL, NULL);
   
   //Check if the SIM device needs the PIN code
-  error = modemSendAtCommand(interface, "AT+CPIN?\r", buffer, sizeof(buffer));
+  pin[0] = '\0';
+  status.buffer = pin;
+  status.size = sizeof(pin);
+  status.length = 0;
+  modemAtQueue("AT+CPIN?\r", APP_PPP_TIMEOUT, modemResponseLine, NULL, &status);
+  
+  //Run the commands
+  error = modemAtRun(APP_PPP_TIMEOUT);
   //Any error to report?
   if(error)
     return error;
   
+  if(!modemState.infoValid)
+  {
+    modemState.infoValid = TRUE;
+    //Debug message
+    TRACE_INFO("Modem %s %s, SIM %s\r\n", modemState.model, modemState.revision, modemState.iccid);
+  }
+  
   //Check whether the PIN code is required
-  if(strstr(buffer, "+CPIN: SIM PIN") != NULL)
+  if(strstr(pin, "+CPIN: SIM PIN") != NULL)
   {
 #ifdef APP_PPP_PIN_CODE
     //Format AT+CPIN command
@@ -149,43 +379,34 @@ error_t modemInit(NetInterface *interface)
     return ERROR_FAILURE;
 #endif
   }
-  else if(strstr(buffer, "+CPIN: READY") != NULL)
+  else if(strstr(pin, "+CPIN: READY") != NULL)
   {
     //The PIN code is not required
   }
   
+  //Report the signal level by URC, where the module supports it
+  modemSendAtCommand(interface, "AT+QEXTUNSOL=\"SQ\",1\r", buffer, sizeof(buffer));
+  
+  //Report registration changes by URC
+  modemAtQueue("AT+CREG=1\r", MODEM_AT_SHORT_TIMEOUT, NULL, NULL, NULL);
+  //Format AT+CGDCONT command, the context is kept until power down
+  sprintf(buffer, "AT+CGDCONT=1,\"IP\",\"%s\"\r", APP_PPP_APN);
+  modemAtQueue(buffer, MODEM_AT_SHORT_TIMEOUT, NULL, NULL, NULL);
+  //Current status, in case the module registered before the URC was enabled
+  modemAtQueue("AT+CREG?\r", MODEM_AT_SHORT_TIMEOUT, modemCregLine, NULL, &modemState);
+  
+  //Run the commands
+  error = modemAtRun(APP_PPP_TIMEOUT);
+  //Any error to report?
+  if(error)
+    return error;
+  modemState.configured = TRUE;
+  
   //Wait for the module to be registered
-  nRetry = 5;
-  while(1)
-  {
-    if (nRetry == 0)
-      return ERROR_FAILURE;
-    nRetry--;
-    //Check if the module is registered
-    error = modemSendAtCommand(interface, "AT+CREG?\r", buffer, sizeof(buffer));
-    //Any error to report?
-    if(error)
-      return error;
-    
-    //Check registration status
-    if(strstr(buffer, "+CREG: 0,0") != NULL)
-    {
-      //Not registered
-    }
-    else if(strstr(buffer, "+CREG: 0,1") != NULL)
-    {
-      //Registered (home network)
-      break;
-    }
-    else if(strstr(buffer, "+CREG: 0,5") != NULL)
-    {
-      //Registered (roaming)
-      break;
-    }
-    
-    //Successful initialization
-    osDelayTask(1000);
-  }
+  error = modemWaitRegistered();
+  //Any error to report?
+  if(error)
+    return ERROR_FAILURE;
   
   //Successful processing
   return NO_ERROR;
@@ -204,31 +425,21 @@ error_t modemConnect(NetInterface *interface)
   char_t buffer[64];
   Ipv4Addr ipv4Addr;
   
-  //Format AT+CGDCONT command
-  sprintf(buffer, "AT+CGDCONT=1,\"IP\",\"%s\"\r", APP_PPP_APN);
-  
-  //Send AT command
-  error = modemSendAtCommand(interface, buffer, buffer, sizeof(buffer));
-  //Any error to report?
-  if(error)
-    return error;
+  //The module must be configured and registered
+  if(!modemIsRegistered())
+    return ERROR_NOT_CONNECTED;
   
   //Format ATDT command
   sprintf(buffer, "ATDT %s\r", APP_PPP_PHONE_NUMBER);
   
   //Send AT command
-  modemSendAtCommand(interface, buffer, buffer, sizeof(buffer));
+  error = modemSendAtCommand(interface, buffer, buffer, sizeof(buffer));
   //Any error to report?
   if(error)
     return error;
   
   //Check response
-  else if(strstr(buffer, "NO CARRIER") != NULL)
-  {
-    //Report an error
-    return ERROR_NO_CARRIER;
-  }
-  else if(strstr(buffer, "CONNECT") == NULL)
+  if(!modemAtGetContext()->dataMode)
   {
     //Report an error
     return ERROR_FAILURE;
@@ -282,17 +493,43 @@ error_t modemDisconnect(NetInterface *interface)
   
   //Close the PPP connection
   error = pppClose(interface);
+  //Back to command mode
+  modemAtSetDataMode(FALSE);
   
   //Return error code
   return error;
 }
 
 
+/**
+* @brief Check whether a call can be dialled
+* @return TRUE if the module is configured and registered (home or roaming)
+**/
+
+bool_t modemIsRegistered(void)
+{
+  return modemState.powered && modemState.configured &&
+    (modemState.registration == 1 || modemState.registration == 5);
+}
+
+
+/**
+* @brief Get the state of the module
+* @return Pointer to the state
+**/
+
+const ModemState *modemGetState(void)
+{
+  return &modemState;
+}
+
+
 /**
 * @brief Send an AT command to the modem
 * @param[in] interface Underlying network interface
 * @param[in] command AT command
-* @param[in] response Pointer to the buffer where to copy the modem's response
+* @param[in] response Pointer to the buffer where to copy the information
+*   lines of the modem's response, separated by line feeds
 * @param[in] size Size of the response buffer
 * @return Error code
 **/
@@ -301,56 +538,20 @@ error_t modemSendAtCommand(NetInterface *interface,
                            const char_t *command, char_t *response, size_t size)
 {
   error_t error;
-  size_t n;
+  ModemResponse lines;
   
-  //Debug message
-  TRACE_INFO("\r\nAT command:  %s\r\n", command);
+  //The command is copied, so the response may use the same buffer
+  error = modemAtQueue(command, APP_PPP_TIMEOUT, modemResponseLine, NULL, &lines);
+  //Any error to report?
+  if(error)
+    return error;
   
-  //Send AT command
-  error = pppSendAtCommand(interface, command);
+  lines.buffer = response;
+  lines.size = size;
+  lines.length = 0;
+  if(size > 0)
+    response[0] = '\0';
   
-  //Check status code
-  if(!error)
-  {
-    //Size of the response buffer
-    n = 0;
-    
-    //Loop as long as necessary
-    while(n < size)
-    {
-      //Wait for a response from the modem
-      error = pppReceiveAtCommand(interface, response + n, size - n);
-      
-      //Check status code
-      if(error)
-      {
-        //Exit immediately
-        break;
-      }
-      
-      //Status string received?
-      if(strstr(response, "OK") ||
-         strstr(response, "CONNECT") ||
-           strstr(response, "RING") ||
-             strstr(response, "NO CARRIER") ||
-               strstr(response, "ERROR") ||
-                 strstr(response, "NO ANSWER"))
-      {
-        if (strstr(response, "OK"))
-          error = NO_ERROR;
-        else if (strstr(response, "ERROR"))
-          error = ERROR_FAILURE; 
-            //Debug message
-            TRACE_INFO("AT response: %s\r\n", response);
-        //Exit immediately
-        break;
-      }
-      
-      //Update the length of the response
-      n = strlen(response);
-    }
-  }
-  
-  //Return status code
-  return error;
+  //Wait for the final result code
+  return modemAtRun(APP_PPP_TIMEOUT);
 }
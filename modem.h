@@ -36,13 +36,35 @@
    extern "C" {
 #endif
 
+/**
+ * @brief State of the module, kept across reconnects
+ **/
+
+typedef struct
+{
+   bool_t powered;        ///<Supply and PWRKEY sequence done
+   bool_t ready;          ///<RDY, Call Ready or an answer to AT received
+   bool_t configured;     ///<Settings applied since power on
+   uint8_t registration;  ///<Last +CREG status
+   uint8_t signal;        ///<Last +CSQN level (0-31, 99 unknown)
+   uint32_t rings;        ///<RING received
+   uint32_t carrierLost;  ///<NO CARRIER outside a command
+   bool_t infoValid;      ///<Static facts below are known
+   char_t model[24];
+   char_t revision[40];
+   char_t iccid[24];
+} ModemState;
+
 //Modem related functions
 void modemInitGPIO();
+void modemInitEngine(NetInterface *interface);
 void modemTurnOn();
 void modemTurnOff();
 error_t modemInit(NetInterface *interface);
 error_t modemConnect(NetInterface *interface);
 error_t modemDisconnect(NetInterface *interface);
+bool_t modemIsRegistered(void);
+const ModemState *modemGetState(void);
 
 error_t modemSendAtCommand(NetInterface *interface,
    const char_t *command, char_t *response, size_t size);
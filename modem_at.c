@@ -0,0 +1,398 @@
+/**
+* @file modem_at.c
+* @brief Non-blocking AT command engine of the modem
+*
+* Commands are queued with their own timeout and sent one at a time. Each
+* call of modemAtPoll reads the lines received so far without waiting: the
+* information lines of the command in progress go to its line callback, its
+* final result code completes it, and every other line is matched against
+* the registered unsolicited result codes. The engine is used by the PPP task
+* only, so it takes no lock of its own
+*
+* @section License
+* ^^(^____^)^^
+*
+**/
+
+//Dependencies
+#include "core/net.h"
+#include "ppp/ppp.h"
+#include "modem_at.h"
+#include "debug.h"
+
+/**
+* @brief Final result code
+**/
+typedef struct
+{
+  const char_t *text;
+  error_t error;
+} ModemAtResult;
+
+//Final result codes, CONNECT leaves the module in data mode
+static const ModemAtResult modemAtResults[] =
+{
+  {"OK", NO_ERROR},
+  {"CONNECT", NO_ERROR},
+  {"ERROR", ERROR_FAILURE},
+  {"+CME ERROR", ERROR_FAILURE},
+  {"+CMS ERROR", ERROR_FAILURE},
+  {"NO CARRIER", ERROR_NO_CARRIER},
+  {"NO ANSWER", ERROR_NO_CARRIER},
+  {"NO DIALTONE", ERROR_NO_CARRIER},
+  {"BUSY", ERROR_NO_CARRIER}
+};
+
+static ModemAtContext modemAtContext;
+
+//========================================
+//Function Implementation
+//========================================
+
+/**
+* @brief Check whether a line starts with the given word
+* @param[in] line Received line
+* @param[in] word Result code or URC prefix
+* @return TRUE if the word is followed by the end of the line, a space or a colon
+**/
+static bool_t modemAtMatch(const char_t *line, const char_t *word)
+{
+  size_t n;
+
+  n = strlen(word);
+  if(strncmp(line, word, n))
+    return FALSE;
+  //A prefix ending with a colon or a space matches by itself
+  if(n > 0 && (word[n - 1] == ':' || word[n - 1] == ' '))
+    return TRUE;
+  return (line[n] == '\0' || line[n] == ' ' || line[n] == ':');
+}
+
+/**
+* @brief Check whether an information line answers the given command
+*
+* Information responses repeat the name of the command, e.g. +CREG: 0,1 for
+* AT+CREG?, whereas the +CREG: 1 URC may arrive in the middle of any command
+*
+* @param[in] command Command in progress
+* @param[in] line Received line
+* @return TRUE if the line belongs to the command
+**/
+static bool_t modemAtAnswers(const char_t *command, const char_t *line)
+{
+  size_t n;
+  char_t c;
+
+  n = strcspn(line, ":");
+  if(line[n] != ':' || strncmp(command + 2, line, n))
+    return FALSE;
+  c = command[2 + n];
+  return (c == '?' || c == '=' || c == '\r' || c == '\0');
+}
+
+/**
+* @brief Complete the command in progress
+* @param[in] error Result of the command
+**/
+static void modemAtComplete(error_t error)
+{
+  ModemAtContext *context = &modemAtContext;
+  ModemAtDoneCallback callback;
+  void *param;
+
+  //The callback may queue the next command, so free the slot first
+  callback = context->queue[context->readIndex].doneCallback;
+  param = context->queue[context->readIndex].param;
+  context->readIndex = (context->readIndex + 1) % MODEM_AT_QUEUE_SIZE;
+  context->count--;
+  context->busy = FALSE;
+
+  if(error)
+  {
+    context->errors++;
+    if(!context->runError)
+      context->runError = error;
+  }
+  if(callback != NULL)
+    callback(error, param);
+}
+
+/**
+* @brief Dispatch a line to the unsolicited result code handlers
+* @param[in] line Received line
+**/
+static void modemAtDispatchUrc(const char_t *line)
+{
+  ModemAtContext *context = &modemAtContext;
+  uint_t i;
+
+  for(i = 0; i < context->urcCount; i++)
+  {
+    if(modemAtMatch(line, context->urc[i].prefix))
+    {
+      context->urcs++;
+      context->urc[i].callback(line, context->urc[i].param);
+      return;
+    }
+  }
+  //Debug message
+  TRACE_DEBUG("AT unhandled: %s\r\n", line);
+}
+
+/**
+* @brief Process a line received from the modem
+* @param[in] line Received line
+**/
+static void modemAtProcessLine(const char_t *line)
+{
+  ModemAtContext *context = &modemAtContext;
+  ModemAtCommand *command;
+  uint_t i;
+
+  //Without a command in progress every line is unsolicited
+  if(!context->busy)
+  {
+    modemAtDispatchUrc(line);
+    return;
+  }
+  command = &context->queue[context->readIndex];
+
+  //Echo of the command
+  if(!strncmp(line, "AT", 2))
+    return;
+
+  //Final result code?
+  for(i = 0; i < arraysize(modemAtResults); i++)
+  {
+    if(modemAtMatch(line, modemAtResults[i].text))
+    {
+      //Debug message
+      TRACE_INFO("AT response: %s\r\n", line);
+      //The bytes that follow CONNECT are PPP frames
+      if(!strcmp(modemAtResults[i].text, "CONNECT"))
+        context->dataMode = TRUE;
+      modemAtComplete(modemAtResults[i].error);
+      return;
+    }
+  }
+
+  //Information line of another command, or URC?
+  if(line[0] == '+' && !modemAtAnswers(command->command, line))
+  {
+    modemAtDispatchUrc(line);
+    return;
+  }
+  //A URC without a leading plus sign cannot be told apart from a response,
+  //except for the ones that never answer a command
+  for(i = 0; i < context->urcCount; i++)
+  {
+    if(context->urc[i].prefix[0] != '+' && modemAtMatch(line, context->urc[i].prefix))
+    {
+      modemAtDispatchUrc(line);
+      return;
+    }
+  }
+
+  if(command->lineCallback != NULL)
+    command->lineCallback(line, command->param);
+}
+
+/**
+* @brief Initialize the AT command engine
+* @param[in] interface PPP interface of the modem
+**/
+void modemAtInit(NetInterface *interface)
+{
+  memset(&modemAtContext, 0, sizeof(ModemAtContext));
+  modemAtContext.interface = interface;
+}
+
+/**
+* @brief Register an unsolicited result code handler
+* @param[in] prefix Start of the URC, e.g. "+CREG:" or "RING"
+* @param[in] callback Called with the whole line
+* @param[in] param Opaque parameter of the callback
+* @return Error code
+**/
+error_t modemAtRegisterUrc(const char_t *prefix, ModemAtUrcCallback callback, void *param)
+{
+  ModemAtContext *context = &modemAtContext;
+
+  if(prefix == NULL || callback == NULL)
+    return ERROR_INVALID_PARAMETER;
+  if(context->urcCount >= MODEM_AT_URC_COUNT)
+    return ERROR_OUT_OF_RESOURCES;
+
+  context->urc[context->urcCount].prefix = prefix;
+  context->urc[context->urcCount].callback = callback;
+  context->urc[context->urcCount].param = param;
+  context->urcCount++;
+  return NO_ERROR;
+}
+
+/**
+* @brief Queue an AT command
+* @param[in] command Command, terminated by a carriage return
+* @param[in] timeout Time allowed for the final result code (ms)
+* @param[in] lineCallback Called for each information line, or NULL
+* @param[in] doneCallback Called with the result, or NULL
+* @param[in] param Opaque parameter of the callbacks
+* @return Error code
+**/
+error_t modemAtQueue(const char_t *command, systime_t timeout,
+  ModemAtLineCallback lineCallback, ModemAtDoneCallback doneCallback, void *param)
+{
+  ModemAtContext *context = &modemAtContext;
+  ModemAtCommand *entry;
+
+  if(command == NULL)
+    return ERROR_INVALID_PARAMETER;
+  if(strlen(command) >= MODEM_AT_MAX_COMMAND_LEN)
+    return ERROR_INVALID_LENGTH;
+  if(context->count >= MODEM_AT_QUEUE_SIZE)
+    return ERROR_OUT_OF_RESOURCES;
+
+  entry = &context->queue[(context->readIndex + context->count) % MODEM_AT_QUEUE_SIZE];
+  strcpy(entry->command, command);
+  entry->timeout = timeout;
+  entry->lineCallback = lineCallback;
+  entry->doneCallback = doneCallback;
+  entry->param = param;
+  context->count++;
+  return NO_ERROR;
+}
+
+/**
+* @brief Process the received lines, the timeout and the next command
+*
+* Never waits. Nothing is read in data mode, the receive buffer then belongs
+* to the PPP driver
+**/
+void modemAtPoll(void)
+{
+  ModemAtContext *context = &modemAtContext;
+  ModemAtCommand *command;
+  error_t error;
+
+  if(context->interface == NULL)
+    return;
+
+  //Received lines
+  while(!context->dataMode)
+  {
+    error = pppReadAtCommand(context->interface, context->line, sizeof(context->line));
+    if(error)
+      break;
+    //Empty lines separate the responses
+    if(context->line[0] != '\0')
+      modemAtProcessLine(context->line);
+  }
+  if(context->dataMode)
+    return;
+
+  //Timeout of the command in progress
+  if(context->busy)
+  {
+    command = &context->queue[context->readIndex];
+    if(timeCompare(osGetSystemTime(), context->startTime + command->timeout) >= 0)
+    {
+      //Debug message
+      TRACE_WARNING("AT timeout: %s\r\n", command->command);
+      context->timeouts++;
+      modemAtComplete(ERROR_TIMEOUT);
+    }
+  }
+
+  //Next command
+  if(!context->busy && context->count > 0)
+  {
+    command = &context->queue[context->readIndex];
+    //Retried on the next poll when the transmitter is full
+    if(!pppWriteAtCommand(context->interface, command->command))
+    {
+      //Debug message
+      TRACE_INFO("\r\nAT command:  %s\r\n", command->command);
+      context->busy = TRUE;
+      context->startTime = osGetSystemTime();
+      context->commands++;
+    }
+  }
+}
+
+/**
+* @brief Check whether all the queued commands are completed
+* @return TRUE if no command is queued or in progress
+**/
+bool_t modemAtIdle(void)
+{
+  return (modemAtContext.count == 0);
+}
+
+/**
+* @brief Poll until the queued commands are completed
+*
+* The first failed command stops the run and drops the commands after it
+*
+* @param[in] timeout Time allowed for the whole queue (ms)
+* @return Result of the first failed command, or ERROR_TIMEOUT
+**/
+error_t modemAtRun(systime_t timeout)
+{
+  ModemAtContext *context = &modemAtContext;
+  systime_t start;
+  error_t error;
+
+  start = osGetSystemTime();
+  context->runError = NO_ERROR;
+
+  while(1)
+  {
+    modemAtPoll();
+    error = context->runError;
+    if(error || modemAtIdle())
+      break;
+    if(timeCompare(osGetSystemTime(), start + timeout) >= 0)
+    {
+      error = ERROR_TIMEOUT;
+      break;
+    }
+    osDelayTask(MODEM_AT_POLL_INTERVAL);
+  }
+
+  if(error)
+    modemAtFlush();
+  return error;
+}
+
+/**
+* @brief Drop the queued commands, without calling their callbacks
+**/
+void modemAtFlush(void)
+{
+  modemAtContext.readIndex = 0;
+  modemAtContext.count = 0;
+  modemAtContext.busy = FALSE;
+}
+
+/**
+* @brief Enter or leave data mode
+*
+* Entered by CONNECT, left by the PPP task once the call has ended
+*
+* @param[in] dataMode TRUE while the link carries PPP frames
+**/
+void modemAtSetDataMode(bool_t dataMode)
+{
+  modemAtContext.dataMode = dataMode;
+  if(!dataMode)
+    modemAtFlush();
+}
+
+/**
+* @brief Get the engine state and counters
+* @return Pointer to the engine context
+**/
+const ModemAtContext *modemAtGetContext(void)
+{
+  return &modemAtContext;
+}
@@ -0,0 +1,110 @@
+/**
+* @file modem_at.h
+* @brief Non-blocking AT command engine of the modem
+*
+* @section License
+* ^^(^____^)^^
+*
+**/
+
+#ifndef __MODEM_AT_H
+#define __MODEM_AT_H
+
+#include "core/net.h"
+
+//Number of commands waiting to be sent
+#ifndef MODEM_AT_QUEUE_SIZE
+#define MODEM_AT_QUEUE_SIZE             12
+#endif
+//Longest command, including the carriage return
+#ifndef MODEM_AT_MAX_COMMAND_LEN
+#define MODEM_AT_MAX_COMMAND_LEN        64
+#endif
+//Longest line received from the modem
+#ifndef MODEM_AT_MAX_LINE_LEN
+#define MODEM_AT_MAX_LINE_LEN           128
+#endif
+//Number of unsolicited result code handlers
+#ifndef MODEM_AT_URC_COUNT
+#define MODEM_AT_URC_COUNT              8
+#endif
+//Interval between two polls of the receive buffer (ms)
+#ifndef MODEM_AT_POLL_INTERVAL
+#define MODEM_AT_POLL_INTERVAL          10
+#endif
+//Timeout of the commands answered by the module itself (ms)
+#define MODEM_AT_SHORT_TIMEOUT          1000
+
+/**
+* @brief Called for each information line of the command in progress
+**/
+typedef void (*ModemAtLineCallback)(const char_t *line, void *param);
+
+/**
+* @brief Called with the final result of a command
+**/
+typedef void (*ModemAtDoneCallback)(error_t error, void *param);
+
+/**
+* @brief Called for an unsolicited result code
+**/
+typedef void (*ModemAtUrcCallback)(const char_t *line, void *param);
+
+/**
+* @brief Queued AT command
+**/
+typedef struct
+{
+  char_t command[MODEM_AT_MAX_COMMAND_LEN];
+  systime_t timeout;
+  ModemAtLineCallback lineCallback;
+  ModemAtDoneCallback doneCallback;
+  void *param;
+} ModemAtCommand;
+
+/**
+* @brief Unsolicited result code handler
+**/
+typedef struct
+{
+  const char_t *prefix;
+  ModemAtUrcCallback callback;
+  void *param;
+} ModemAtUrcHandler;
+
+/**
+* @brief AT command engine
+**/
+typedef struct
+{
+  NetInterface *interface;
+  ModemAtCommand queue[MODEM_AT_QUEUE_SIZE];
+  uint_t readIndex;
+  uint_t count;
+  bool_t busy;
+  systime_t startTime;
+  bool_t dataMode;
+  error_t runError;
+  ModemAtUrcHandler urc[MODEM_AT_URC_COUNT];
+  uint_t urcCount;
+  char_t line[MODEM_AT_MAX_LINE_LEN];
+  uint32_t commands;
+  uint32_t errors;
+  uint32_t timeouts;
+  uint32_t urcs;
+} ModemAtContext;
+
+//=======================================
+//Function declearation
+//=======================================
+void modemAtInit(NetInterface *interface);
+error_t modemAtRegisterUrc(const char_t *prefix, ModemAtUrcCallback callback, void *param);
+error_t modemAtQueue(const char_t *command, systime_t timeout,
+  ModemAtLineCallback lineCallback, ModemAtDoneCallback doneCallback, void *param);
+void modemAtPoll(void);
+bool_t modemAtIdle(void);
+error_t modemAtRun(systime_t timeout);
+void modemAtFlush(void);
+void modemAtSetDataMode(bool_t dataMode);
+const ModemAtContext *modemAtGetContext(void);
+#endif
@@ -1,13 +1,28 @@
 #include "modem_interface.h"
 #include "modem.h"
+#include "modem_at.h"
 #include "uart_driver.h"
 #include "ppp/ppp.h"
+#include "core/tcp.h"
 #include "core/ping.h"
+#include "snmpConnect_manager.h"
 #include "debug.h"
 
 #define PPP_PING_PERIOD         5
+//TCP windows sized for the GPRS round-trip time, in whole segments.
+//A Timestamps option changes in every segment, so the VJ compressor would
+//send each header in full: with VJ the option is left off (MSS 1430),
+//otherwise it is in use (MSS 1430 - 12)
+#if (PPP_VJ_SUPPORT == ENABLED)
+#define PPP_TCP_TX_BUFFER_SIZE  (1430*4)
+#define PPP_TCP_RX_BUFFER_SIZE  (1430*6)
+#else
+#define PPP_TCP_TX_BUFFER_SIZE  (1418*4)
+#define PPP_TCP_RX_BUFFER_SIZE  (1418*6)
+#endif
 PppSettings pppSettings;
 PppContext pppContext;
+TcpProfile pppTcpProfile;
 modem_interface_manage_t interfaceManage;
 
 NetInterface* ModemInterfaceInit()
@@ -49,7 +64,17 @@ NetInterface* ModemInterfaceInit()
     //Debug message
     TRACE_ERROR("Failed to configure interface %s!\r\n", interface->name);
   }
+  
+  //Larger windows, SACK and (without VJ) timestamps for the connections
+  //over the modem, Ethernet sockets keep the default buffers
+  tcpGetDefaultProfile(&pppTcpProfile);
+  pppTcpProfile.txBufferSize = PPP_TCP_TX_BUFFER_SIZE;
+  pppTcpProfile.rxBufferSize = PPP_TCP_RX_BUFFER_SIZE;
+  pppTcpProfile.sackEnabled = TRUE;
+  pppTcpProfile.timestampEnabled = (PPP_VJ_SUPPORT == ENABLED) ? FALSE : TRUE;
+  tcpSetProfile(interface, &pppTcpProfile);
   modemInitGPIO();  
+  modemInitEngine(interface);
   return interface;
 }
 
@@ -59,13 +84,28 @@ error_t ModemInterfaceConnect()
   NetInterface* interface;
   error_t error = ERROR_FAILURE;      
   interface = &netInterface[1];
+  //The module is still on and registered after the call ended, so it is
+  //dialled again without the power sequence
+  if (modemIsRegistered())
+  {
+    TRACE_ERROR("Redial\r\n");
+    error = modemConnect(interface);
+    if (!error)
+    {
+      TRACE_ERROR("Modem connected\r\n");
+      return error;
+    }
+    TRACE_ERROR("Modem redial failed\r\n");
+    modemDisconnect(interface);
+    modemTurnOff();
+    osDelayTask(1000);
+  }
   nRetry = 5;
   while ((error) && (nRetry > 0))
   {   
     nRetry--;
     TRACE_ERROR("Turn on sequence\r\n");
     modemTurnOn();
-    osDelayTask(1000);
     error = modemInit(interface);
     if (error)
     {
@@ -87,7 +127,6 @@ error_t ModemInterfaceConnect()
       }
       else
       {
-        osDelayTask(2000);
         TRACE_ERROR("Modem connected\r\n");
       }
     }
@@ -139,6 +178,20 @@ void ModemInterfaceTask(void* param)
       interfaceManage.currentState = MODEM_INTERFACE_STATE_DISCONNECTED;;
     }
     
+    //The call ended (LCP terminated by the network or NO CARRIER)
+    if ((interfaceManage.currentState == MODEM_INTERFACE_STATE_CONNECTED) && (pppContext.pppPhase == PPP_PHASE_DEAD))
+    {
+      TRACE_ERROR("ppp link down\r\n");
+      modemAtSetDataMode(FALSE);
+      pingCount = 0;
+      pingLostCount = 0;
+      interfaceManage.currentState = MODEM_INTERFACE_STATE_DISCONNECTED;
+      continue;
+    }
+    //URCs received while no call is up
+    if (interfaceManage.currentState == MODEM_INTERFACE_STATE_DISCONNECTED)
+      modemAtPoll();
+    
     if (interfaceManage.currentState == MODEM_INTERFACE_STATE_CONNECTED)
     {
       pingCount++;
@@ -158,7 +211,11 @@ void ModemInterfaceTask(void* param)
           }
         }
         else
+        {
           pingLostCount = 0;
+          //The link check also measures the GPRS round trip time
+          interfaceManagerUpdateRtt(&netInterface[1], rtt_time);
+        }
         pingCount = 0;
       }
     }
@@ -8,6 +8,16 @@
 #define MODEM_UART_IRQn                         UART1_RX_TX_IRQn
 #define MODEM_UART_IRQHandler                   UART1_RX_TX_IRQHandler
 #define MODEM_UART_BAUDRATE                     115200  // chaunm - 172827      
+#define MODEM_UART_DMA                          DMA0
+#define MODEM_UART_DMAMUX                       DMAMUX
+#define MODEM_UART_RX_DMA_CHANNEL               0
+#define MODEM_UART_RX_DMA_REQUEST               kDmaRequestMux0UART1Rx
+#define MODEM_UART_RX_DMA_IRQn                  DMA0_DMA16_IRQn
+#define MODEM_UART_RX_DMA_IRQHandler            DMA0_DMA16_IRQHandler
+#define MODEM_UART_TX_DMA_CHANNEL               1
+#define MODEM_UART_TX_DMA_REQUEST               kDmaRequestMux0UART1Tx
+#define MODEM_UART_TX_DMA_IRQn                  DMA1_DMA17_IRQn
+#define MODEM_UART_TX_DMA_IRQHandler            DMA1_DMA17_IRQHandler
 #define MODEM_EN_INIT                           GPRS_EN_INIT
 #define MODEM_PWR_INIT                          GPRS_PWR_INIT
 #define MODEM_EN_OFF                            GPRS_EN_OFF
@@ -1,6 +1,7 @@
 #include "variables.h"
 #include "debug.h"
 #include "snmpConnect_manager.h"
+#include "private_mib_impl.h"
 #include "cJSON.h"
 
 //network inclusions
@@ -21,6 +22,7 @@
 #include <string.h>
 #include <stdlib.h>
 #include "mallocstats.h"
+#include "data_usage.h"
 
 //Connection states
 #define APP_STATE_NOT_CONNECTED 0
@@ -136,20 +138,36 @@ void mqttPublishMsg(char* topic, char* message, uint16_t msgSize)
     }
 }
 
+/* Number of messages waiting in the publish and receive queues */
+void mqttGetQueueDepth(uint32_t *pubDepth, uint32_t *rcvDepth)
+{
+    *pubDepth = (mqttPubQueue != NULL) ? uxQueueMessagesWaiting(mqttPubQueue) : 0;
+    *rcvDepth = (mqttRcvQueue != NULL) ? uxQueueMessagesWaiting(mqttRcvQueue) : 0;
+}
+
 /* periodically update data task */
 void mqttPeriodicUpdateTask(void *param)
 {
 	char* message;
+	/* static, the base does not fit in the task stack */
+	static PrivateMibBase mqttSnapshot;
+	uint32_t cycle = 0;
+	unsigned int divider = 1;
 	while (1)
 	{   
-        
-        if (mqttConnectionState == APP_STATE_CONNECTED)
+#if (USERDEF_DATA_USAGE == ENABLED)
+        /* over GPRS, telemetry is sent less often as the data budget runs out */
+        divider = dataUsageGetTelemetryDivider();
+#endif
+        if ((mqttConnectionState == APP_STATE_CONNECTED) && ((cycle++ % divider) == 0))
         {            
+            /* all messages of a cycle are built from the same snapshot */
+            privateMibGetSnapshot(&mqttSnapshot);
 #if (defined(SDK_DEBUGCONSOLE) && (SDK_DEBUGCONSOLE==1))
             __iar_dlmalloc_stats();
             TRACE_INFO("Make device info\r\n");
 #endif
-            message = mqtt_json_make_device_info(deviceName, &privateMibBase);
+            message = mqtt_json_make_device_info(deviceName, &mqttSnapshot);
             mqttPublishMsg(MQTT_EVENT_TOPIC, message, strlen(message));
             if (message != NULL)
                 free(message);
@@ -157,7 +175,7 @@ void mqttPeriodicUpdateTask(void *param)
             __iar_dlmalloc_stats();
             TRACE_INFO("Make ac phase\r\n");
 #endif
-            message = mqtt_json_make_ac_phase_info(deviceName, &privateMibBase);
+            message = mqtt_json_make_ac_phase_info(deviceName, &mqttSnapshot);
             mqttPublishMsg(MQTT_EVENT_TOPIC, message, strlen(message));
             if (message != NULL)
                 free(message);         
@@ -165,7 +183,7 @@ void mqttPeriodicUpdateTask(void *param)
             __iar_dlmalloc_stats();
             TRACE_INFO("Make battery\r\n");
 #endif
-            message = mqtt_json_make_battery_message(deviceName, &privateMibBase);
+            message = mqtt_json_make_battery_message(deviceName, &mqttSnapshot);
             mqttPublishMsg(MQTT_EVENT_TOPIC, message, strlen(message));
             if (message != NULL)
                 free(message);
@@ -173,7 +191,7 @@ void mqttPeriodicUpdateTask(void *param)
             __iar_dlmalloc_stats();
             TRACE_INFO("Make alarm\r\n");
 #endif
-            message = mqtt_json_make_alarm_message(deviceName, &privateMibBase);
+            message = mqtt_json_make_alarm_message(deviceName, &mqttSnapshot);
             mqttPublishMsg(MQTT_EVENT_TOPIC, message, strlen(message));
             if (message != NULL)
                 free(message);  
@@ -181,7 +199,7 @@ void mqttPeriodicUpdateTask(void *param)
             __iar_dlmalloc_stats();
             TRACE_INFO("Make accessories\r\n");
 #endif
-            message = mqtt_json_make_accessory_message(deviceName, &privateMibBase);
+            message = mqtt_json_make_accessory_message(deviceName, &mqttSnapshot);
             mqttPublishMsg(MQTT_EVENT_TOPIC, message, strlen(message));
             if (message != NULL)
                 free(message);	 
@@ -192,7 +210,7 @@ void mqttPeriodicUpdateTask(void *param)
         }
         /* Check for OS heap memory use */
         TRACE_INFO("FreeRTOS free heap size: %d\r\n", (uint16_t)xPortGetFreeHeapSize());
-        osDelayTask(30000);
+        osDelayTask(MQTT_UPDATE_PERIOD);
 	}
 }
 
@@ -235,8 +253,9 @@ error_t mqttConnect(NetInterface *interface)
     //Debug message
     TRACE_INFO("\r\n\r\nResolving server name...\r\n");
     
-    //Resolve MQTT server name
-    error = getHostByName(interface, APP_SERVER_NAME, &ipAddr, 0);
+    //Resolve MQTT server name, an expired address is used at once while the
+    //DNS cache refreshes it so that a reconnection does not wait for the server
+    error = getHostByName(interface, APP_SERVER_NAME, &ipAddr, HOST_NAME_ALLOW_STALE);
     //Any error to report?
     if(error)
         return error;
@@ -371,9 +390,9 @@ void mqttClientTask (void *param)
             //Update connection state
             mqttConnectionState = APP_STATE_CONNECTING;
             
-            //Try to connect to the MQTT server using ppp interface
-            if (interfaceManagerGetActiveInterface() != NULL)
-                error = mqttConnect(interfaceManagerGetActiveInterface());
+            //Try to connect to the MQTT server on the telemetry link
+            if (interfaceManagerGetClassInterface(TRAFFIC_CLASS_TELEMETRY) != NULL)
+                error = mqttConnect(interfaceManagerGetClassInterface(TRAFFIC_CLASS_TELEMETRY));
             else
                 error = ERROR_FAILURE;
             
@@ -453,8 +472,8 @@ void mqttClientTask (void *param)
                 osDelayTask(3000);
 #endif            
             }
-			// check if network interface changed then close for fast recovery
-			if (mqttClientContext.interface != interfaceManagerGetActiveInterface())
+			// check if the telemetry link changed then close for fast recovery
+			if (mqttClientContext.interface != interfaceManagerGetClassInterface(TRAFFIC_CLASS_TELEMETRY))
 			{
 				 //Close connection
                 mqttClientClose(&mqttClientContext);
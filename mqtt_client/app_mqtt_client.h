@@ -16,6 +16,9 @@
 #define MQTT_EVENT_TOPIC                "DAQ/event"
 #define MQTT_RESPONSE_TOPIC             "DAQ/response"
 
+//Period of the telemetry messages (ms)
+#define MQTT_UPDATE_PERIOD              30000
+
 #define MQTT_CLIENT_QUEUE_SIZE          8
 #define MQTT_CLIENT_TOPIC_MAX_SIZE      50
 #define MQTT_CLIENT_MSG_MAX_SIZE        1024
@@ -37,4 +40,5 @@ typedef struct {
 error_t mqttConnect(NetInterface *interface);
 void mqttPublishMsg(char* topic, char* message, uint16_t msgSize);
 void mqttClientTask (void *param);
+void mqttGetQueueDepth(uint32_t *pubDepth, uint32_t *rcvDepth);
 #endif
\ No newline at end of file
@@ -14,6 +14,17 @@
 #include "variables.h"
 #include "snmpConnect_manager.h"
 #include "private_mib_module.h"
+#include "data_usage.h"
+
+/* print a message, without indentation once the data budget runs low */
+static char* mqtt_json_print(cJSON* json)
+{
+#if (USERDEF_DATA_USAGE == ENABLED)
+	if (dataUsageCompactJson())
+		return cJSON_PrintUnformatted(json);
+#endif
+	return cJSON_Print(json);
+}
 
 /* Make online message */
 char* mqtt_json_make_online_message(char* boxID)
@@ -33,11 +44,11 @@ char* mqtt_json_make_online_message(char* boxID)
 	cJSON_AddStringToObject(jsonEvent, "build time", __TIME__);
 	cJSON_AddStringToObject(jsonEvent, "MAC", macIdString);
 	cJSON_AddStringToObject(jsonEvent, "status", "online");		
-    if (interfaceManagerGetActiveInterface() == ETH_INTERFACE)
+    if (interfaceManagerGetClassInterface(TRAFFIC_CLASS_TELEMETRY) == ETH_INTERFACE)
         cJSON_AddStringToObject(jsonEvent, "interface", "ethernet");
-    else if (interfaceManagerGetActiveInterface() == GPRS_INTERFACE)
+    else if (interfaceManagerGetClassInterface(TRAFFIC_CLASS_TELEMETRY) == GPRS_INTERFACE)
         cJSON_AddStringToObject(jsonEvent, "interface", "gprs");
-    eventMsg = cJSON_Print(jsonEvent);
+    eventMsg = mqtt_json_print(jsonEvent);
 	cJSON_Delete(jsonEvent);
 	return eventMsg;
 }
@@ -56,7 +67,7 @@ char* mqtt_json_make_response(char* boxID, unsigned int messageID, mqtt_json_res
 	cJSON_AddStringToObject(jsonResponse, "id", boxID);
 	cJSON_AddNumberToObject(jsonResponse, "message_id", messageID);
 	cJSON_AddNumberToObject(jsonResponse, "error_code", errorCode);
-	responseMessage = cJSON_Print(jsonResponse);
+	responseMessage = mqtt_json_print(jsonResponse);
 	cJSON_Delete(jsonResponse);
 	return responseMessage;
 }
@@ -77,11 +88,111 @@ char* mqtt_json_make_fw_update_result(char* boxID, char* serverIP, char* fileNam
 	cJSON_AddStringToObject(jsonMessage, "server", serverIP);
 	cJSON_AddStringToObject(jsonMessage, "file", fileName);			
 	cJSON_AddNumberToObject(jsonMessage, "error_code", result);
-	responseMessage = cJSON_Print(jsonMessage);
+	responseMessage = mqtt_json_print(jsonMessage);
 	cJSON_Delete(jsonMessage);
 	return responseMessage;		
 }
 
+/* Make one chunk of a packet capture published over MQTT */
+char* mqtt_json_make_capture_chunk(char* boxID, char* interfaceName, uint32_t sequence, bool_t last, char* data)
+{
+	cJSON* jsonMessage;
+	char* message;
+	jsonMessage = cJSON_CreateObject();
+	if (jsonMessage == NULL)
+	{
+		TRACE_INFO("Not enough memory to create json message\r\n");
+		return NULL;
+	}
+	cJSON_AddStringToObject(jsonMessage, "id", boxID);
+	cJSON_AddStringToObject(jsonMessage, "type", "capture");
+	cJSON_AddStringToObject(jsonMessage, "interface", interfaceName);
+	cJSON_AddNumberToObject(jsonMessage, "seq", sequence);
+	cJSON_AddBoolToObject(jsonMessage, "last", last);
+	// pcap file bytes, base64 encoded
+	cJSON_AddStringToObject(jsonMessage, "data", data);
+	message = cJSON_PrintUnformatted(jsonMessage);
+	cJSON_Delete(jsonMessage);
+	return message;
+}
+
+/* Make packet capture export report data, serverIP is NULL for an export over MQTT */
+char* mqtt_json_make_capture_result(char* boxID, char* interfaceName, char* serverIP, char* fileName,
+									uint32_t frames, int32_t result)
+{
+	cJSON* jsonMessage;
+	char* responseMessage;
+	jsonMessage = cJSON_CreateObject();
+	if (jsonMessage == NULL)
+	{
+		TRACE_INFO("Not enough memory to create json message\r\n");
+		return NULL;
+	}
+	cJSON_AddStringToObject(jsonMessage, "id", boxID);
+	cJSON_AddStringToObject(jsonMessage, "type", "capture_export");
+	cJSON_AddStringToObject(jsonMessage, "interface", interfaceName);
+	if (serverIP != NULL)
+	{
+		cJSON_AddStringToObject(jsonMessage, "server", serverIP);
+		cJSON_AddStringToObject(jsonMessage, "file", fileName);
+	}
+	cJSON_AddNumberToObject(jsonMessage, "frames", frames);
+	cJSON_AddNumberToObject(jsonMessage, "error_code", result);
+	responseMessage = mqtt_json_print(jsonMessage);
+	cJSON_Delete(jsonMessage);
+	return responseMessage;
+}
+
+#if (USERDEF_DATA_USAGE == ENABLED)
+/* Make data usage report of one interface, classes are [rx bytes, tx bytes, rx packets, tx packets] */
+char* mqtt_json_make_data_usage(char* boxID, unsigned int interfaceIndex, const DataUsageRecord* usage,
+								DataUsageStage stage)
+{
+	cJSON* jsonMessage;
+	cJSON* jsonClasses;
+	cJSON* jsonCounter;
+	const DataUsageCounter* counter;
+	char* message;
+	char period[8];
+	unsigned int i;
+	jsonMessage = cJSON_CreateObject();
+	if (jsonMessage == NULL)
+	{
+		TRACE_INFO("Not enough memory to create json message\r\n");
+		return NULL;
+	}
+	cJSON_AddStringToObject(jsonMessage, "id", boxID);
+	cJSON_AddStringToObject(jsonMessage, "type", "data_usage");
+	cJSON_AddStringToObject(jsonMessage, "interface", (interfaceIndex == DATA_USAGE_IF_GPRS) ? "gprs" : "ethernet");
+	sprintf(period, "20%02u-%02u", usage->year % 100, usage->month % 100);
+	cJSON_AddStringToObject(jsonMessage, "period", period);
+	// the budget only applies to GPRS
+	if (interfaceIndex == DATA_USAGE_IF_GPRS)
+	{
+		cJSON_AddNumberToObject(jsonMessage, "budget_kb", usage->budget);
+		cJSON_AddStringToObject(jsonMessage, "stage", dataUsageGetStageName(stage));
+		cJSON_AddNumberToObject(jsonMessage, "month_bytes", (double)dataUsageGetGprsBytes(usage));
+		cJSON_AddNumberToObject(jsonMessage, "last_month_bytes", (double)usage->lastMonthBytes);
+	}
+	jsonClasses = cJSON_CreateObject();
+	for (i = 0; i < DATA_USAGE_CLASS_COUNT; i++)
+	{
+		counter = &usage->counters[interfaceIndex][i];
+		jsonCounter = cJSON_CreateArray();
+		cJSON_AddItemToArray(jsonCounter, cJSON_CreateNumber((double)counter->bytes[0]));
+		cJSON_AddItemToArray(jsonCounter, cJSON_CreateNumber((double)counter->bytes[1]));
+		cJSON_AddItemToArray(jsonCounter, cJSON_CreateNumber(counter->packets[0]));
+		cJSON_AddItemToArray(jsonCounter, cJSON_CreateNumber(counter->packets[1]));
+		cJSON_AddItemToObject(jsonClasses, dataUsageGetClassName(i), jsonCounter);
+	}
+	cJSON_AddItemToObject(jsonMessage, "classes", jsonClasses);
+	// sent over GPRS whatever the stage
+	message = cJSON_PrintUnformatted(jsonMessage);
+	cJSON_Delete(jsonMessage);
+	return message;
+}
+#endif
+
 /* make periodically report data */
 char* mqtt_json_make_device_info(char* boxID, PrivateMibBase *deviceData)
 {
@@ -101,7 +212,7 @@ char* mqtt_json_make_device_info(char* boxID, PrivateMibBase *deviceData)
 	cJSON_AddNumberToObject(jsonMessage, "temp threshold 4", deviceData->siteInfoGroup.siteInfoThresTemp4);
 	cJSON_AddNumberToObject(jsonMessage, "measured temp", deviceData->siteInfoGroup.siteInfoMeasuredTemp);
 	cJSON_AddNumberToObject(jsonMessage, "measured humi", deviceData->siteInfoGroup.siteInfoMeasuredHumid);
-	message = cJSON_Print(jsonMessage);
+	message = mqtt_json_print(jsonMessage);
 	cJSON_Delete(jsonMessage);
 	return message;;	
 }
@@ -137,7 +248,7 @@ char* mqtt_json_make_ac_phase_info(char* boxID, PrivateMibBase *deviceData)
 		cJSON_AddItemToArray(phaseJsonArray, phaseJson);
 	}
 	cJSON_AddItemToObject(jsonMessage, "phase", phaseJsonArray);
-	message = cJSON_Print(jsonMessage);
+	message = mqtt_json_print(jsonMessage);
 	cJSON_Delete(jsonMessage);
 	return message;
 }
@@ -172,7 +283,7 @@ char* mqtt_json_make_battery_message(char* boxID, PrivateMibBase *deviceData)
 	cJSON_AddNumberToObject(jsonBatterry, "threshold", deviceData->batteryGroup.battery2ThresVolt);
 	cJSON_AddItemToArray(batteryArray, jsonBatterry);
 	cJSON_AddItemToObject(jsonMessage, "batteries", batteryArray);
-	message = cJSON_Print(jsonMessage);
+	message = mqtt_json_print(jsonMessage);
 	cJSON_Delete(jsonMessage);
 	return message;
 }
@@ -200,7 +311,7 @@ char* mqtt_json_make_alarm_message(char* boxID, PrivateMibBase *deviceData)
 	cJSON_AddNumberToObject(jsonMessage, "ac threshold", deviceData->alarmGroup.alarmAcThresAlarms);
 	cJSON_AddNumberToObject(jsonMessage, "dc threshold", deviceData->alarmGroup.alarmDcThresAlarms);
 	cJSON_AddNumberToObject(jsonMessage, "access", deviceData->alarmGroup.alarmAccessAlarms);
-	message = cJSON_Print(jsonMessage);
+	message = mqtt_json_print(jsonMessage);
 	cJSON_Delete(jsonMessage);
 	return message;
 }
@@ -233,7 +344,7 @@ char* mqtt_json_make_accessory_message(char* boxID, PrivateMibBase *deviceData)
 	cJSON_AddNumberToObject(jsonMessage, "outdoor temp", deviceData->accessoriesGroup.siteOutdoorTemp);
 	cJSON_AddNumberToObject(jsonMessage, "led", deviceData->accessoriesGroup.ledControlStatus);
 	cJSON_AddNumberToObject(jsonMessage, "speaker", deviceData->accessoriesGroup.speakerControlStatus);
-	message = cJSON_Print(jsonMessage);
+	message = mqtt_json_print(jsonMessage);
 	cJSON_Delete(jsonMessage);
 	return message;
 }
@@ -255,7 +366,7 @@ char* mqtt_json_make_configuration_message(char* boxID, PrivateMibBase *deviceDa
 	cJSON_AddStringToObject(jsonMessage, "subnet", (char*)sMenu_Variable.ucSN);
 	cJSON_AddStringToObject(jsonMessage, "gateway", (char*)sMenu_Variable.ucGW);
 	cJSON_AddStringToObject(jsonMessage, "server", (char*)sMenu_Variable.ucSIP);
-	message = cJSON_Print(jsonMessage);
+	message = mqtt_json_print(jsonMessage);
 	return message;
 }
 				   
@@ -16,10 +16,18 @@
 #include "oid.h"
 #include "private_mib_module.h"
 #include "private_mib_impl.h"
+#include "data_usage.h"
 
 char* mqtt_json_make_online_message(char* boxID);
 char* mqtt_json_make_response(char* boxID, unsigned int messageID, mqtt_json_result_t errorCode);
 char* mqtt_json_make_fw_update_result(char* boxID, char* serverIP, char* fileName, int32_t result);
+char* mqtt_json_make_capture_chunk(char* boxID, char* interfaceName, uint32_t sequence, bool_t last, char* data);
+char* mqtt_json_make_capture_result(char* boxID, char* interfaceName, char* serverIP, char* fileName,
+									uint32_t frames, int32_t result);
+#if (USERDEF_DATA_USAGE == ENABLED)
+char* mqtt_json_make_data_usage(char* boxID, unsigned int interfaceIndex, const DataUsageRecord* usage,
+								DataUsageStage stage);
+#endif
 char* mqtt_json_make_device_info(char* boxID, PrivateMibBase *deviceData);
 char* mqtt_json_make_ac_phase_info(char* boxID, PrivateMibBase *deviceData);
 char* mqtt_json_make_battery_message(char* boxID, PrivateMibBase *deviceData);
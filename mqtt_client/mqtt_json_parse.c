@@ -19,6 +19,9 @@
 #include "core/net.h"
 #include "core/ethernet.h"
 #include "ftp.h"
+#include "capture.h"
+#include "snmpConnect_manager.h"
+#include "data_usage.h"
 
 /***********************************************************************************************************
 *                                        CONFIGURE MESSAGE PARSING                                        *
@@ -534,6 +537,7 @@ static mqtt_json_result_t mqtt_json_parse_firmware_update_message(cJSON* jsonMes
     cJSON *jsonFileName;
     cJSON *jsonFileSize;
     cJSON *jsonServerIP;
+    cJSON *jsonCrc;
     jsonFileName = cJSON_GetObjectItem(jsonMessage, "file");
     if ((!cJSON_IsString(jsonFileName)) || (jsonFileName->valuestring == NULL))
         return MQTT_PARSE_DATA_ERROR;
@@ -543,9 +547,160 @@ static mqtt_json_result_t mqtt_json_parse_firmware_update_message(cJSON* jsonMes
     jsonFileSize = cJSON_GetObjectItem(jsonMessage, "size");
     if ((!cJSON_IsNumber(jsonFileSize)) || (jsonFileSize->valueint < 0))
         return MQTT_PARSE_BOXID_ERROR;
-    FTP_StartFirmwareUpdate(jsonFileName->valuestring, jsonServerIP->valuestring, jsonFileSize->valueint);
+    /* CRC-32 of the image is optional */
+    jsonCrc = cJSON_GetObjectItem(jsonMessage, "crc");
+    if ((jsonCrc != NULL) && (!cJSON_IsNumber(jsonCrc)))
+        return MQTT_PARSE_DATA_ERROR;
+    FTP_StartFirmwareUpdate(jsonFileName->valuestring, jsonServerIP->valuestring, jsonFileSize->valueint,
+                            (jsonCrc != NULL), (jsonCrc != NULL) ? (uint32_t)jsonCrc->valuedouble : 0);
+    return MQTT_PARSE_SUCCESS;
+}
+#if (NET_CAPTURE_SUPPORT == ENABLED)
+/* parse the optional interface of a capture message, "ethernet" or "gprs" */
+static mqtt_json_result_t mqtt_json_parse_capture_interface(cJSON* jsonMessage, NetInterface** interface)
+{
+    cJSON *jsonInterface;
+    jsonInterface = cJSON_GetObjectItem(jsonMessage, "interface");
+    *interface = NULL;
+    if (jsonInterface == NULL)
+        return MQTT_PARSE_SUCCESS;
+    if ((!cJSON_IsString(jsonInterface)) || (jsonInterface->valuestring == NULL))
+        return MQTT_PARSE_DATA_ERROR;
+    if (!strcmp(jsonInterface->valuestring, "ethernet"))
+        *interface = ETH_INTERFACE;
+    else if (!strcmp(jsonInterface->valuestring, "gprs"))
+        *interface = GPRS_INTERFACE;
+    else
+        return MQTT_PARSE_DATA_ERROR;
+    return MQTT_PARSE_SUCCESS;
+}
+
+/* parse the optional numeric field of a capture filter */
+static mqtt_json_result_t mqtt_json_parse_capture_number(cJSON* jsonMessage, const char* name, int max, int* value)
+{
+    cJSON *jsonValue;
+    jsonValue = cJSON_GetObjectItem(jsonMessage, name);
+    *value = 0;
+    if (jsonValue == NULL)
+        return MQTT_PARSE_SUCCESS;
+    if ((!cJSON_IsNumber(jsonValue)) || (jsonValue->valueint < 0) || (jsonValue->valueint > max))
+        return MQTT_PARSE_DATA_ERROR;
+    *value = jsonValue->valueint;
+    return MQTT_PARSE_SUCCESS;
+}
+
+/* parse packet capture message: start with a filter, stop, or export as pcap over FTP or MQTT */
+static mqtt_json_result_t mqtt_json_parse_capture_message(cJSON* jsonMessage)
+{
+    cJSON *jsonAction;
+    cJSON *jsonDirection;
+    cJSON *jsonServerIP;
+    cJSON *jsonFileName;
+    NetCaptureFilter filter;
+    NetInterface *interface;
+    int protocol, ipProtocol, port;
+    jsonAction = cJSON_GetObjectItem(jsonMessage, "action");
+    if ((!cJSON_IsString(jsonAction)) || (jsonAction->valuestring == NULL))
+        return MQTT_PARSE_DATA_ERROR;
+    if (mqtt_json_parse_capture_interface(jsonMessage, &interface) != MQTT_PARSE_SUCCESS)
+        return MQTT_PARSE_DATA_ERROR;
+    if (!strcmp(jsonAction->valuestring, "start"))
+    {
+        memset(&filter, 0, sizeof(filter));
+        filter.interface = interface;
+        jsonDirection = cJSON_GetObjectItem(jsonMessage, "direction");
+        if (jsonDirection != NULL)
+        {
+            if ((!cJSON_IsString(jsonDirection)) || (jsonDirection->valuestring == NULL))
+                return MQTT_PARSE_DATA_ERROR;
+            if (!strcmp(jsonDirection->valuestring, "rx"))
+                filter.direction = NET_CAPTURE_DIR_RX;
+            else if (!strcmp(jsonDirection->valuestring, "tx"))
+                filter.direction = NET_CAPTURE_DIR_TX;
+            else if (strcmp(jsonDirection->valuestring, "both"))
+                return MQTT_PARSE_DATA_ERROR;
+        }
+        // EtherType or PPP protocol, IP protocol and TCP/UDP port, 0 or missing for any
+        if ((mqtt_json_parse_capture_number(jsonMessage, "protocol", 0xFFFF, &protocol) != MQTT_PARSE_SUCCESS) ||
+            (mqtt_json_parse_capture_number(jsonMessage, "ip_protocol", 0xFF, &ipProtocol) != MQTT_PARSE_SUCCESS) ||
+            (mqtt_json_parse_capture_number(jsonMessage, "port", 0xFFFF, &port) != MQTT_PARSE_SUCCESS))
+            return MQTT_PARSE_DATA_ERROR;
+        filter.protocol = (uint16_t)protocol;
+        filter.ipProtocol = (uint8_t)ipProtocol;
+        filter.port = (uint16_t)port;
+        if (netCaptureStart(&filter) != NO_ERROR)
+            return MQTT_PARSE_DATA_ERROR;
+    }
+    else if (!strcmp(jsonAction->valuestring, "stop"))
+    {
+        netCaptureStop();
+    }
+    else if (!strcmp(jsonAction->valuestring, "export"))
+    {
+        // a pcap file holds a single link type, one interface is exported at a time
+        if (interface == NULL)
+            return MQTT_PARSE_DATA_ERROR;
+        // upload to the FTP server when one is given, publish on the capture topic otherwise
+        jsonServerIP = cJSON_GetObjectItem(jsonMessage, "server");
+        jsonFileName = cJSON_GetObjectItem(jsonMessage, "file");
+        if (jsonServerIP != NULL)
+        {
+            if ((!cJSON_IsString(jsonServerIP)) || (jsonServerIP->valuestring == NULL) ||
+                (!cJSON_IsString(jsonFileName)) || (jsonFileName->valuestring == NULL))
+                return MQTT_PARSE_DATA_ERROR;
+            CAPTURE_StartExport(interface, jsonServerIP->valuestring, jsonFileName->valuestring);
+        }
+        else
+            CAPTURE_StartExport(interface, NULL, NULL);
+    }
+    else
+        return MQTT_PARSE_PARAM_ERROR;
+    return MQTT_PARSE_SUCCESS;
+}
+#endif
+
+#if (USERDEF_DATA_USAGE == ENABLED)
+/* parse data usage message: report the counters, set the monthly GPRS budget (kB, 0 for none) or clear the counters */
+static mqtt_json_result_t mqtt_json_parse_data_usage_message(cJSON* jsonMessage)
+{
+    cJSON *jsonAction;
+    cJSON *jsonMsgData;
+    NetInterface *interface;
+    jsonAction = cJSON_GetObjectItem(jsonMessage, "action");
+    if ((!cJSON_IsString(jsonAction)) || (jsonAction->valuestring == NULL))
+        return MQTT_PARSE_DATA_ERROR;
+    if (!strcmp(jsonAction->valuestring, "get"))
+    {
+        // same optional interface as the capture messages, both when missing
+        jsonMsgData = cJSON_GetObjectItem(jsonMessage, "interface");
+        if (jsonMsgData == NULL)
+            interface = NULL;
+        else if (cJSON_IsString(jsonMsgData) && (jsonMsgData->valuestring != NULL) && !strcmp(jsonMsgData->valuestring, "ethernet"))
+            interface = ETH_INTERFACE;
+        else if (cJSON_IsString(jsonMsgData) && (jsonMsgData->valuestring != NULL) && !strcmp(jsonMsgData->valuestring, "gprs"))
+            interface = GPRS_INTERFACE;
+        else
+            return MQTT_PARSE_DATA_ERROR;
+        dataUsagePublish(interface);
+    }
+    else if (!strcmp(jsonAction->valuestring, "budget"))
+    {
+        jsonMsgData = cJSON_GetObjectItem(jsonMessage, "data");
+        if ((!cJSON_IsNumber(jsonMsgData)) || (jsonMsgData->valuedouble < 0) || (jsonMsgData->valuedouble > 0xFFFFFFFF))
+            return MQTT_PARSE_DATA_ERROR;
+        TRACE_INFO("Data usage budget: %u kB\r\n", (uint32_t)jsonMsgData->valuedouble);
+        dataUsageSetBudget((uint32_t)jsonMsgData->valuedouble);
+    }
+    else if (!strcmp(jsonAction->valuestring, "reset"))
+    {
+        dataUsageReset();
+    }
+    else
+        return MQTT_PARSE_PARAM_ERROR;
     return MQTT_PARSE_SUCCESS;
 }
+#endif
+
 /* Parse message receive from MQTT input topic */
 char* mqtt_json_parse_message(char* message, unsigned int length)
 {
@@ -618,6 +773,10 @@ char* mqtt_json_parse_message(char* message, unsigned int length)
     else if (!strcmp(jsonMsgType->valuestring, "reset"))
     {
         TRACE_INFO("Resetting ...\r\n");
+#if (USERDEF_DATA_USAGE == ENABLED)
+        // keep the usage counted since the last hourly save
+        dataUsageSave();
+#endif
         hal_system_reset();
     }
     else if (!strcmp(jsonMsgType->valuestring, "firmware_update"))
@@ -625,6 +784,20 @@ char* mqtt_json_parse_message(char* message, unsigned int length)
         TRACE_INFO("Parse firmware update message\r\n");
         result = mqtt_json_parse_firmware_update_message(jsonMessage);
     }
+#if (NET_CAPTURE_SUPPORT == ENABLED)
+    else if (!strcmp(jsonMsgType->valuestring, "capture"))
+    {
+        TRACE_INFO("Parse capture message\r\n");
+        result = mqtt_json_parse_capture_message(jsonMessage);
+    }
+#endif
+#if (USERDEF_DATA_USAGE == ENABLED)
+    else if (!strcmp(jsonMsgType->valuestring, "data_usage"))
+    {
+        TRACE_INFO("Parse data usage message\r\n");
+        result = mqtt_json_parse_data_usage_message(jsonMessage);
+    }
+#endif
     else
         result = MQTT_PARSE_TYPE_ERROR;
     
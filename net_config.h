@@ -123,7 +123,9 @@
 //Maximum number of retransmissions
 #define TCP_MAX_RETRIES 5
 //Selective acknowledgment support
-#define TCP_SACK_SUPPORT DISABLED
+#define TCP_SACK_SUPPORT ENABLED
+//Timestamps option support
+#define TCP_TIMESTAMP_SUPPORT ENABLED
 
 //UDP support
 #define UDP_SUPPORT ENABLED
@@ -144,6 +146,10 @@
 #define PAP_SUPPORT ENABLED
 //CHAP authentication support
 #define CHAP_SUPPORT ENABLED
+//VJ TCP/IP header compression support
+#define PPP_VJ_SUPPORT ENABLED
+//Number of VJ connection slots in each direction
+#define PPP_VJ_MAX_SLOTS 8
 
 //Server Side Includes support
 #define HTTP_SERVER_SSI_SUPPORT ENABLED
@@ -154,13 +160,38 @@
 //SNMP agent support
 #define SNMP_AGENT_SUPPORT ENABLED
 //SNMPv3 support
-#define SNMP_V3_SUPPORT DISABLED
+#define SNMP_V3_SUPPORT ENABLED
+//SNMP InformRequest support
+#define SNMP_AGENT_INFORM_SUPPORT ENABLED
+//Largest SNMP message, sized for the combined info trap sent over GPRS
+//(one PPP frame without fragmentation)
+#define SNMP_MAX_MSG_SIZE 1472
 //MIB-II module support
 #define MIB2_SUPPORT ENABLED
 //Netmem pool support
-#define NET_MEM_POOL_SUPPORT DISABLED
+#define NET_MEM_POOL_SUPPORT ENABLED
+//Netmem pool size classes (TCP queue items, short packets, full frames)
+#define NET_MEM_POOL_SMALL_BUFFER_SIZE 128
+#define NET_MEM_POOL_SMALL_BUFFER_COUNT 32
+#define NET_MEM_POOL_MEDIUM_BUFFER_SIZE 512
+#define NET_MEM_POOL_MEDIUM_BUFFER_COUNT 16
+//Full frames also back the larger TCP windows of the PPP sockets
+#define NET_MEM_POOL_BUFFER_SIZE 1536
+#define NET_MEM_POOL_BUFFER_COUNT 30
+//CRC engine: slice-by-8 CRC-32, slice-by-4 CRC-16, CRC module for
+//large CRC-32 blocks (firmware images)
+#define CRC32_SLICE_COUNT 8
+#define CRC16_SLICE_COUNT 4
+#define CRC_HW_SUPPORT ENABLED
+#define CRC_HW_MIN_LENGTH 512
 //Netmem pool support
 #define DNS_CLIENT_SUPPORT ENABLED
+//Packet capture, started and exported over MQTT (64 frames of 96 bytes)
+#define NET_CAPTURE_SUPPORT ENABLED
+#define NET_CAPTURE_RECORD_COUNT 64
+#define NET_CAPTURE_SNAP_LEN 96
+//Per-frame traffic accounting, charged to the traffic classes of data_usage.c
+#define NET_ACCOUNTING_SUPPORT ENABLED
 //SNMP stack size user-defined
 #define SNMP_CLIENT_STACK_SIZE 400
    
@@ -183,6 +214,17 @@
 #define USERDEF_MQTT_CLIENT     ENABLED
 //Connection manager user-defined
 #define USERDEF_SNMPCONNECT_MANAGER ENABLED
+//PPP session kept up behind Ethernet for an immediate failover. Idle on an
+//Ethernet site it costs about 1.5 kB of GPRS a minute, 65 MB a month: the
+//ping of the PPP link check every 5 s, charged to the icmp class of the data
+//usage budget, which its stages do not reduce. Alarms are also sent over GPRS
+//and the telemetry moves to it when its round trip time is lower. Disable it
+//on sites whose GPRS plan cannot carry that
+#define USERDEF_GPRS_WARM_STANDBY   ENABLED
+//Alarm delivery using SNMP InformRequest user-defined
+#define USERDEF_SNMP_ALARM_INFORM ENABLED
+//Monthly data usage per interface and traffic class, with a GPRS budget
+#define USERDEF_DATA_USAGE      ENABLED
 
 // chaunm
 #define USERDEF_CHAUNM_TEST          DISABLED //enable to use specific network configuration for testing purpose
@@ -23,10 +23,25 @@
 #include "freeRTOS.h"
 #include "task.h"
 #include "i2c_lock.h"
+#include "rs485.h"
+#include "mqtt_client/app_mqtt_client.h"
+#include "data_usage.h"
+
+//Sampling period of the DeviceInfo group (ms)
+#define PRIVATE_MIB_DEVICE_SAMPLE_PERIOD 1000
 
 uint32_t setCount_test;
 //Mutex preventing simultaneous access to the private MIB base
 static OsMutex privateMibMutex;
+//Snapshots of the private MIB base published by UpdateInfo. Together with
+//privateMibView and the MQTT copy, the snapshots hold four copies of the
+//base in static RAM (4 x sizeof(PrivateMibBase), about 11 KB). Readers that
+//need a single group copy it with privateMibGetGroupSnapshot instead
+static PrivateMibBase privateMibSnapshot[2];
+//Snapshot sequence number (odd while a snapshot is being published)
+static volatile uint32_t privateMibSnapshotSeq;
+//Consistent view of the private MIB base used by the SNMP agent
+static PrivateMibBase privateMibView;
 
 
 /**
@@ -108,6 +123,9 @@ error_t privateMibInit(void)
     return ERROR_OUT_OF_RESOURCES;
   }
   
+  //Make the default values visible to the readers
+  privateMibPublishSnapshot();
+  
   //Successful processing
   return NO_ERROR;
 }
@@ -121,6 +139,8 @@ void privateMibLock(void)
 {
   //Enter critical section
   osAcquireMutex(&privateMibMutex);
+  //The SNMP agent reads a consistent copy for the whole request
+  privateMibGetSnapshot(&privateMibView);
 }
 
 
@@ -135,6 +155,66 @@ void privateMibUnlock(void)
 }
 
 
+/**
+* @brief Publish a snapshot of the private MIB base
+*
+* Only UpdateInfo publishes. The copy goes to the buffer that readers
+* are not using, then the sequence number makes it the current one, so
+* the writer never waits for a reader
+**/
+
+void privateMibPublishSnapshot(void)
+{
+  uint32_t seq;
+  
+  seq = privateMibSnapshotSeq;
+  //Mark the snapshot as being published
+  privateMibSnapshotSeq = seq + 1;
+  __DMB();
+  //Fill the buffer that is not the current one
+  memcpy(&privateMibSnapshot[((seq >> 1) + 1) & 1], &privateMibBase, sizeof(PrivateMibBase));
+  __DMB();
+  //Switch to the new snapshot
+  privateMibSnapshotSeq = seq + 2;
+}
+
+
+/**
+* @brief Get a consistent copy of the latest snapshot
+* @param[out] snapshot Buffer where to copy the private MIB base
+**/
+
+void privateMibGetSnapshot(PrivateMibBase *snapshot)
+{
+  privateMibGetGroupSnapshot(snapshot, 0, sizeof(PrivateMibBase));
+}
+
+
+/**
+* @brief Get a consistent copy of a part of the latest snapshot
+* @param[out] group Buffer where to copy the part
+* @param[in] offset Offset of the part in the private MIB base
+* @param[in] length Length of the part
+**/
+
+void privateMibGetGroupSnapshot(void *group, size_t offset, size_t length)
+{
+  uint32_t seq1;
+  uint32_t seq2;
+  
+  do
+  {
+    seq1 = privateMibSnapshotSeq;
+    __DMB();
+    memcpy(group, (uint8_t *) &privateMibSnapshot[(seq1 >> 1) & 1] + offset, length);
+    __DMB();
+    seq2 = privateMibSnapshotSeq;
+    //The buffer is reused by the second publication following the current
+    //one (the first one if a publication was already in progress)
+  } while((seq2 - seq1) > ((seq1 & 1) ? 1 : 2));
+}
+
+
 /**
 * @brief Get currentTime object value
 * @param[in] object Pointer to the MIB object descriptor
@@ -303,7 +383,7 @@ error_t privateMibGetLedEntry(const MibObject *object, const uint8_t *oid,
     return ERROR_INSTANCE_NOT_FOUND;
   
   //Point to the LED table entry
-  entry = &privateMibBase.ledTable[index - 1];
+  entry = &privateMibView.ledTable[index - 1];
   
   //ledColor object?
   if(!strcmp(object->name, "ledColor"))
@@ -509,7 +589,7 @@ error_t privateMibGetSiteInfoGroup(const MibObject *object, const uint8_t *oid,
   //	if(n != oidLen)
   //	return ERROR_INSTANCE_NOT_FOUND;
   //	Point to the siteInfoGroup entry
-  entry = &privateMibBase.siteInfoGroup;
+  entry = &privateMibView.siteInfoGroup;
   
   //siteInfoBTSCode object?
   if(!strcmp(object->name, "siteInfoBTSCode"))
@@ -532,37 +612,37 @@ error_t privateMibGetSiteInfoGroup(const MibObject *object, const uint8_t *oid,
   else if(!strcmp(object->name, "siteInfoThresTemp1"))
   {
     //Get object value
-    value->integer = privateMibBase.siteInfoGroup.siteInfoThresTemp1;
+    value->integer = privateMibView.siteInfoGroup.siteInfoThresTemp1;
   }
   //siteInfoThresTemp2 object?
   else if(!strcmp(object->name, "siteInfoThresTemp2"))
   {
     //Get object value
-    value->integer = privateMibBase.siteInfoGroup.siteInfoThresTemp2;
+    value->integer = privateMibView.siteInfoGroup.siteInfoThresTemp2;
   }
   //siteInfoThresTemp3 object?
   else if(!strcmp(object->name, "siteInfoThresTemp3"))
   {
     //Get object value
-    value->integer = privateMibBase.siteInfoGroup.siteInfoThresTemp3;
+    value->integer = privateMibView.siteInfoGroup.siteInfoThresTemp3;
   }
   //siteInfoThresTemp4 object?
   else if(!strcmp(object->name, "siteInfoThresTemp4"))
   {
     //Get object value
-    value->integer = privateMibBase.siteInfoGroup.siteInfoThresTemp4;
+    value->integer = privateMibView.siteInfoGroup.siteInfoThresTemp4;
   }
   //siteInfoMeasuredTemp object?
   else if(!strcmp(object->name, "siteInfoMeasuredTemp"))
   {
     //Get object value
-    value->integer = privateMibBase.siteInfoGroup.siteInfoMeasuredTemp;
+    value->integer = privateMibView.siteInfoGroup.siteInfoMeasuredTemp;
   }
   //siteInfoMeasuredHumid object?
   else if(!strcmp(object->name, "siteInfoMeasuredHumid"))
   {
     //Get object value
-    value->integer = privateMibBase.siteInfoGroup.siteInfoMeasuredHumid;
+    value->integer = privateMibView.siteInfoGroup.siteInfoMeasuredHumid;
   }
   //siteInfoAccessId object?
   else if(!strcmp(object->name, "siteInfoAccessId"))
@@ -585,13 +665,13 @@ error_t privateMibGetSiteInfoGroup(const MibObject *object, const uint8_t *oid,
   else if(!strcmp(object->name, "siteInfoTrapCounter"))
   {
     //Get object value
-    value->integer = privateMibBase.siteInfoGroup.siteInfoTrapCounter;
+    value->integer = privateMibView.siteInfoGroup.siteInfoTrapCounter;
   }
   // siteInfoIpAddress
   else if(!strcmp(object->name, "siteInfoIpAddress"))
   {
     //Get object value
-    value->integer = privateMibBase.siteInfoGroup.siteInfoIpAddress;
+    value->integer = privateMibView.siteInfoGroup.siteInfoIpAddress;
   }
   //Unknown object?
   else
@@ -698,7 +778,7 @@ error_t privateMibGetAcPhaseEntry(const MibObject *object, const uint8_t *oid,
     return ERROR_INSTANCE_NOT_FOUND;
   
   //Point to the interface table entry
-  entry = &privateMibBase.acPhaseGroup.acPhaseTable[index - 1];// &mib2Base.ifGroup.ifTable[index - 1];
+  entry = &privateMibView.acPhaseGroup.acPhaseTable[index - 1];// &mib2Base.ifGroup.ifTable[index - 1];
   
   //ifIndex object?
   if(!strcmp(object->name, "acPhaseIndex"))
@@ -779,7 +859,7 @@ error_t privateMibGetNextAcPhaseEntry(const MibObject *object, const uint8_t *oi
   memcpy(nextOid, object->oid, object->oidLen);
   
   //Loop through network interfaces
-  for(index = 1; index <= privateMibBase.acPhaseGroup.acPhaseNumber; index++)
+  for(index = 1; index <= privateMibView.acPhaseGroup.acPhaseNumber; index++)
   {
     //Append the instance identifier to the OID prefix
     n = object->oidLen;
@@ -893,37 +973,37 @@ error_t privateMibGetBatteryGroup(const MibObject *object, const uint8_t *oid,
   if(!strcmp(object->name, "battery1Voltage"))
   {
     //Get object value
-    value->integer = privateMibBase.batteryGroup.battery1Voltage;
+    value->integer = privateMibView.batteryGroup.battery1Voltage;
   }
   //battery2Voltage object?
   else if(!strcmp(object->name, "battery2Voltage"))
   {
     //Get object value
-    value->integer = privateMibBase.batteryGroup.battery2Voltage;
+    value->integer = privateMibView.batteryGroup.battery2Voltage;
   }
   //battery1AlarmStatus object?
   else if(!strcmp(object->name, "battery1AlarmStatus"))
   {
     //Get object value
-    value->integer = privateMibBase.batteryGroup.battery1AlarmStatus;
+    value->integer = privateMibView.batteryGroup.battery1AlarmStatus;
   }
   //battery2AlarmStatus object?
   else if(!strcmp(object->name, "battery2AlarmStatus"))
   {
     //Get object value
-    value->integer = privateMibBase.batteryGroup.battery2AlarmStatus;
+    value->integer = privateMibView.batteryGroup.battery2AlarmStatus;
   }
   //battery1ThresVolt object?
   else if(!strcmp(object->name, "battery1ThresVolt"))
   {
     //Get object value
-    value->integer = privateMibBase.batteryGroup.battery1ThresVolt;
+    value->integer = privateMibView.batteryGroup.battery1ThresVolt;
   }
   //battery2ThresVolt object?
   else if(!strcmp(object->name, "battery2ThresVolt"))
   {
     //Get object value
-    value->integer = privateMibBase.batteryGroup.battery2ThresVolt;
+    value->integer = privateMibView.batteryGroup.battery2ThresVolt;
   }
   //Unknown object?
   else
@@ -1051,7 +1131,7 @@ error_t privateMibGetAccessoriesGroup(const MibObject *object, const uint8_t *oi
 //  size_t n;
   PrivateMibAccessoriesGroup *entry;
   
-  entry = &privateMibBase.accessoriesGroup;
+  entry = &privateMibView.accessoriesGroup;
   //airCon1Status object?
   if(!strcmp(object->name, "airCon1Status"))
   {
@@ -1185,7 +1265,7 @@ error_t privateMibGetConfigAccEntry(const MibObject *object, const uint8_t *oid,
     return ERROR_INSTANCE_NOT_FOUND;
   
   //Point to the configAcc table entry
-  entry = &privateMibBase.configGroup.configAccTable[index - 1];// &mib2Base.ifGroup.ifTable[index - 1];
+  entry = &privateMibView.configGroup.configAccTable[index - 1];// &mib2Base.ifGroup.ifTable[index - 1];
   
   //configAccIndex object?
   if(!strcmp(object->name, "configAccIndex"))
@@ -1293,7 +1373,7 @@ error_t privateMibGetNextConfigAccEntry(const MibObject *object, const uint8_t *
   memcpy(nextOid, object->oid, object->oidLen);
   
   //Loop through network interfaces
-  for(index = 1; index <= privateMibBase.configGroup.configAccNumber; index++)
+  for(index = 1; index <= privateMibView.configGroup.configAccNumber; index++)
   {
     //Append the instance identifier to the OID prefix
     n = object->oidLen;
@@ -1420,7 +1500,7 @@ error_t privateMibGetConfigAccessIdEntry(const MibObject *object, const uint8_t
     return ERROR_INSTANCE_NOT_FOUND;
   
   //Point to the configAcc table entry
-  entry = &privateMibBase.configGroup.configAccessIdTable[index - 1];// &mib2Base.ifGroup.ifTable[index - 1];
+  entry = &privateMibView.configGroup.configAccessIdTable[index - 1];// &mib2Base.ifGroup.ifTable[index - 1];
   
   //configAccessIdIndex object?
   if(!strcmp(object->name, "configAccessIdIndex"))
@@ -1481,7 +1561,7 @@ error_t privateMibGetNextConfigAccessIdEntry(const MibObject *object, const uint
   memcpy(nextOid, object->oid, object->oidLen);
   
   //Loop through network interfaces
-  for(index = 1; index <= privateMibBase.configGroup.configAccessIdNumber; index++)
+  for(index = 1; index <= privateMibView.configGroup.configAccessIdNumber; index++)
   {
     //Append the instance identifier to the OID prefix
     n = object->oidLen;
@@ -1647,61 +1727,61 @@ error_t privateMibGetAlarmGroup(const MibObject *object, const uint8_t *oid,
   if(!strcmp(object->name, "alarmFireAlarms"))
   {
     //Get object value
-    value->integer = privateMibBase.alarmGroup.alarmFireAlarms;
+    value->integer = privateMibView.alarmGroup.alarmFireAlarms;
   }
   //alarmSmokeAlarms object?
   else if(!strcmp(object->name, "alarmSmokeAlarms"))
   {
     //Get object value
-    value->integer = privateMibBase.alarmGroup.alarmSmokeAlarms;
+    value->integer = privateMibView.alarmGroup.alarmSmokeAlarms;
   }
   //alarmMotionDetectAlarms object?
   else if(!strcmp(object->name, "alarmMotionDetectAlarms"))
   {
     //Get object value
-    value->integer = privateMibBase.alarmGroup.alarmMotionDetectAlarms;
+    value->integer = privateMibView.alarmGroup.alarmMotionDetectAlarms;
   }
   //alarmFloodDetectAlarms object?
   else if(!strcmp(object->name, "alarmFloodDetectAlarms"))
   {
     //Get object value
-    value->integer = privateMibBase.alarmGroup.alarmFloodDetectAlarms;
+    value->integer = privateMibView.alarmGroup.alarmFloodDetectAlarms;
   }
   //alarmDoorOpenAlarms object?
   else if(!strcmp(object->name, "alarmDoorOpenAlarms"))
   {
     //Get object value
-    value->integer = privateMibBase.alarmGroup.alarmDoorOpenAlarms;
+    value->integer = privateMibView.alarmGroup.alarmDoorOpenAlarms;
   }
   //alarmGenFailureAlarms object?
   else if(!strcmp(object->name, "alarmGenFailureAlarms"))
   {
     //Get object value
-    value->integer = privateMibBase.alarmGroup.alarmGenFailureAlarms;
+    value->integer = privateMibView.alarmGroup.alarmGenFailureAlarms;
   }
   //alarmDcThresAlarms object?
   else if(!strcmp(object->name, "alarmDcThresAlarms"))
   {
     //Get object value
-    value->integer = privateMibBase.alarmGroup.alarmDcThresAlarms;
+    value->integer = privateMibView.alarmGroup.alarmDcThresAlarms;
   }
   //alarmMachineStopAlarms object?
   else if(!strcmp(object->name, "alarmMachineStopAlarms"))
   {
     //Get object value
-    value->integer = privateMibBase.alarmGroup.alarmMachineStopAlarms;
+    value->integer = privateMibView.alarmGroup.alarmMachineStopAlarms;
   }
   //alarmAccessAlarms object?
   else if(!strcmp(object->name, "alarmAccessAlarms"))
   {
     //Get object value
-    value->integer = privateMibBase.alarmGroup.alarmAccessAlarms & 0x000000FF; // chaunm - the 8th bit for marking
+    value->integer = privateMibView.alarmGroup.alarmAccessAlarms & 0x000000FF; // chaunm - the 8th bit for marking
   }
   //alarmAcThresAlarms object?
   else if(!strcmp(object->name, "alarmAcThresAlarms"))
   {
     //Get object value
-    value->integer = privateMibBase.alarmGroup.alarmAcThresAlarms;
+    value->integer = privateMibView.alarmGroup.alarmAcThresAlarms;
   }
   //Unknown object?
   else
@@ -1716,6 +1796,588 @@ error_t privateMibGetAlarmGroup(const MibObject *object, const uint8_t *oid,
 //========================================== AlarmInfo Function ==========================================//
 
 
+//========================================== DeviceInfo Function ==========================================//
+/**
+* @brief Get deviceTaskEntry object value
+* @param[in] object Pointer to the MIB object descriptor
+* @param[in] oid Object identifier (object name and instance identifier)
+* @param[in] oidLen Length of the OID, in bytes
+* @param[out] value Object value
+* @param[in,out] valueLen Length of the object value, in bytes
+* @return Error code
+**/
+
+error_t privateMibGetDeviceTaskEntry(const MibObject *object, const uint8_t *oid,
+                                     size_t oidLen, MibVariant *value, size_t *valueLen)
+{
+  error_t error;
+  size_t n;
+  uint_t index;
+  PrivateMibDeviceTaskEntry *entry;
+  
+  //Point to the instance identifier
+  n = object->oidLen;
+  
+  //The deviceTaskIndex is used as instance identifier
+  error = mibDecodeIndex(oid, oidLen, &n, &index);
+  //Invalid instance identifier?
+  if(error) return error;
+  
+  //Sanity check
+  if(n != oidLen)
+    return ERROR_INSTANCE_NOT_FOUND;
+  
+  //Check index range
+  if(index < 1 || index > privateMibView.deviceGroup.deviceTaskNumber)
+    return ERROR_INSTANCE_NOT_FOUND;
+  
+  //Point to the task table entry
+  entry = &privateMibView.deviceGroup.deviceTaskTable[index - 1];
+  
+  //deviceTaskIndex object?
+  if(!strcmp(object->name, "deviceTaskIndex"))
+  {
+    //Get object value
+    value->integer = entry->deviceTaskIndex;
+  }
+  //deviceTaskName object?
+  else if(!strcmp(object->name, "deviceTaskName"))
+  {
+    //Make sure the buffer is large enough to hold the entire object
+    if(*valueLen >= entry->deviceTaskNameLen)
+    {
+      //Copy object value
+      memcpy(value->octetString, entry->deviceTaskName, entry->deviceTaskNameLen);
+      //Return object length
+      *valueLen = entry->deviceTaskNameLen;
+    }
+    else
+    {
+      //Report an error
+      error = ERROR_BUFFER_OVERFLOW;
+    }
+  }
+  //deviceTaskStackFree object?
+  else if(!strcmp(object->name, "deviceTaskStackFree"))
+  {
+    //Get object value
+    value->gauge32 = entry->deviceTaskStackFree;
+  }
+  //deviceTaskCpuShare object?
+  else if(!strcmp(object->name, "deviceTaskCpuShare"))
+  {
+    //Get object value
+    value->gauge32 = entry->deviceTaskCpuShare;
+  }
+  //Unknown object?
+  else
+  {
+    //The specified object does not exist
+    error = ERROR_OBJECT_NOT_FOUND;
+  }
+  
+  //Return status code
+  return error;
+}
+
+
+/**
+* @brief Get next deviceTaskEntry object
+* @param[in] object Pointer to the MIB object descriptor
+* @param[in] oid Object identifier
+* @param[in] oidLen Length of the OID, in bytes
+* @param[out] nextOid OID of the next object in the MIB
+* @param[out] nextOidLen Length of the next object identifier, in bytes
+* @return Error code
+**/
+error_t privateMibGetNextDeviceTaskEntry(const MibObject *object, const uint8_t *oid,
+                                         size_t oidLen, uint8_t *nextOid, size_t *nextOidLen)
+{
+  error_t error;
+  size_t n;
+  uint_t index;
+  
+  //Make sure the buffer is large enough to hold the OID prefix
+  if(*nextOidLen < object->oidLen)
+    return ERROR_BUFFER_OVERFLOW;
+  
+  //Copy OID prefix
+  memcpy(nextOid, object->oid, object->oidLen);
+  
+  //Loop through the sampled tasks
+  for(index = 1; index <= privateMibView.deviceGroup.deviceTaskNumber; index++)
+  {
+    //Append the instance identifier to the OID prefix
+    n = object->oidLen;
+    
+    //The deviceTaskIndex is used as instance identifier
+    error = mibEncodeIndex(nextOid, *nextOidLen, &n, index);
+    //Any error to report?
+    if(error) return error;
+    
+    //Check whether the resulting object identifier lexicographically
+    //follows the specified OID
+    if(oidComp(nextOid, n, oid, oidLen) > 0)
+    {
+      //Save the length of the resulting object identifier
+      *nextOidLen = n;
+      //Next object found
+      return NO_ERROR;
+    }
+  }
+  
+  //The specified OID does not lexicographically precede the name
+  //of some object
+  return ERROR_OBJECT_NOT_FOUND;
+}
+
+
+/**
+* @brief Sample device internals into the DeviceInfo group
+*
+* Runs from UpdateInfo at most once per PRIVATE_MIB_DEVICE_SAMPLE_PERIOD, so
+* that SNMP requests only read stored values. CPU share is the fraction of
+* run time, in tenths of a percent, each task used since the previous sample
+**/
+
+void UpdateDeviceInfo (void)
+{
+  static systime_t sampleTime;
+  static uint32_t prevTotalRunTime;
+  static uint_t prevTaskCount;
+  static UBaseType_t prevTaskNumber[PRIVATE_MIB_DEVICE_TASK_COUNT];
+  static uint32_t prevTaskRunTime[PRIVATE_MIB_DEVICE_TASK_COUNT];
+  static TaskStatus_t taskStatus[PRIVATE_MIB_DEVICE_TASK_COUNT];
+  PrivateMibDeviceGroup *group;
+  TaskStatus_t temp;
+  systime_t time;
+  uint32_t totalRunTime;
+  uint32_t totalDelta;
+  uint32_t taskDelta;
+  uint_t i, j, n;
+  
+  //Rate limit the sampling
+  time = osGetSystemTime();
+  if(sampleTime != 0 && timeCompare(time, sampleTime + PRIVATE_MIB_DEVICE_SAMPLE_PERIOD) < 0)
+    return;
+  sampleTime = time;
+  
+  group = &privateMibBase.deviceGroup;
+  
+  //FreeRTOS heap
+  group->deviceHeapFree = xPortGetFreeHeapSize();
+  group->deviceHeapMinFree = xPortGetMinimumEverFreeHeapSize();
+  
+#if (USERDEF_MQTT_CLIENT == ENABLED)
+  //MQTT message queues
+  mqttGetQueueDepth(&group->deviceMqttPubQueueDepth, &group->deviceMqttRcvQueueDepth);
+#endif
+  
+  //Modbus poll cycle
+  group->deviceModbusCycleTime = Modbus.cycleTime;
+  group->deviceModbusMaxCycleTime = Modbus.maxCycleTime;
+  
+#if (MIB2_SUPPORT == ENABLED)
+  //Interface counters maintained by the TCP/IP stack
+  group->deviceEthInOctets = mib2Base.ifGroup.ifTable[0].ifInOctets;
+  group->deviceEthOutOctets = mib2Base.ifGroup.ifTable[0].ifOutOctets;
+  group->devicePppInOctets = mib2Base.ifGroup.ifTable[1].ifInOctets;
+  group->devicePppOutOctets = mib2Base.ifGroup.ifTable[1].ifOutOctets;
+#endif
+  
+  //Per task statistics (0 if there are more tasks than table entries)
+  n = uxTaskGetSystemState(taskStatus, PRIVATE_MIB_DEVICE_TASK_COUNT, &totalRunTime);
+  if(n == 0)
+    return;
+  
+  //Sort by creation order so that the table rows stay stable
+  for(i = 1; i < n; i++)
+  {
+    temp = taskStatus[i];
+    for(j = i; j > 0 && taskStatus[j - 1].xTaskNumber > temp.xTaskNumber; j--)
+      taskStatus[j] = taskStatus[j - 1];
+    taskStatus[j] = temp;
+  }
+  
+  //The run time counter wraps, only differences are meaningful
+  totalDelta = totalRunTime - prevTotalRunTime;
+  
+  for(i = 0; i < n; i++)
+  {
+    //Run time of this task since the previous sample
+    taskDelta = 0;
+    for(j = 0; j < prevTaskCount; j++)
+    {
+      if(prevTaskNumber[j] == taskStatus[i].xTaskNumber)
+      {
+        taskDelta = taskStatus[i].ulRunTimeCounter - prevTaskRunTime[j];
+        break;
+      }
+    }
+    
+    group->deviceTaskTable[i].deviceTaskIndex = i + 1;
+    strncpy(group->deviceTaskTable[i].deviceTaskName, taskStatus[i].pcTaskName,
+            PRIVATE_MIB_DEVICE_TASK_NAME_SIZE);
+    group->deviceTaskTable[i].deviceTaskNameLen = MIN(strlen(taskStatus[i].pcTaskName),
+                                                      PRIVATE_MIB_DEVICE_TASK_NAME_SIZE);
+    group->deviceTaskTable[i].deviceTaskStackFree = taskStatus[i].usStackHighWaterMark * sizeof(StackType_t);
+    if(totalDelta != 0)
+      group->deviceTaskTable[i].deviceTaskCpuShare = (uint32_t) ((uint64_t) taskDelta * 1000 / totalDelta);
+    else
+      group->deviceTaskTable[i].deviceTaskCpuShare = 0;
+  }
+  group->deviceTaskNumber = n;
+  
+  //Save the counters for the next sample
+  for(i = 0; i < n; i++)
+  {
+    prevTaskNumber[i] = taskStatus[i].xTaskNumber;
+    prevTaskRunTime[i] = taskStatus[i].ulRunTimeCounter;
+  }
+  prevTaskCount = n;
+  prevTotalRunTime = totalRunTime;
+}
+//========================================== DeviceInfo Function ==========================================//
+//========================================== TrapLimit Function ==========================================//
+/**
+* @brief Get TrapLimit object value
+* @param[in] object Pointer to the MIB object descriptor
+* @param[in] oid Object identifier (object name and instance identifier)
+* @param[in] oidLen Length of the OID, in bytes
+* @param[out] value Object value
+* @param[in,out] valueLen Length of the object value, in bytes
+* @return Error code
+**/
+
+error_t privateMibGetTrapLimitGroup(const MibObject *object, const uint8_t *oid,
+                                    size_t oidLen, MibVariant *value, size_t *valueLen)
+{
+  PrivateMibTrapLimitGroup *group;
+  
+  //Point to the trapLimitGroup of the snapshot
+  group = &privateMibView.trapLimitGroup;
+  
+  //trapLimitSuppressedCount object?
+  if(!strcmp(object->name, "trapLimitSuppressedCount"))
+  {
+    //Get object value
+    value->counter32 = group->trapLimitSuppressedCount;
+  }
+  //trapLimitSummaryCount object?
+  else if(!strcmp(object->name, "trapLimitSummaryCount"))
+  {
+    //Get object value
+    value->counter32 = group->trapLimitSummaryCount;
+  }
+  //trapLimitCombinedInfoCount object?
+  else if(!strcmp(object->name, "trapLimitCombinedInfoCount"))
+  {
+    //Get object value
+    value->counter32 = group->trapLimitCombinedInfoCount;
+  }
+  //trapLimitSummaryCounts object?
+  else if(!strcmp(object->name, "trapLimitSummaryCounts"))
+  {
+    //Make sure the buffer is large enough to hold the entire object
+    if(*valueLen < group->trapLimitSummaryCountsLen)
+      return ERROR_BUFFER_OVERFLOW;
+    //Copy object value
+    memcpy(value->octetString, group->trapLimitSummaryCounts, group->trapLimitSummaryCountsLen);
+    //Return object length
+    *valueLen = group->trapLimitSummaryCountsLen;
+  }
+  //trapLimitSummaryStates object?
+  else if(!strcmp(object->name, "trapLimitSummaryStates"))
+  {
+    //Make sure the buffer is large enough to hold the entire object
+    if(*valueLen < group->trapLimitSummaryStatesLen)
+      return ERROR_BUFFER_OVERFLOW;
+    //Copy object value
+    memcpy(value->octetString, group->trapLimitSummaryStates, group->trapLimitSummaryStatesLen);
+    //Return object length
+    *valueLen = group->trapLimitSummaryStatesLen;
+  }
+  //Unknown object?
+  else
+  {
+    //The specified object does not exist
+    return ERROR_OBJECT_NOT_FOUND;
+  }
+  
+  //Successful processing
+  return NO_ERROR;
+}
+//========================================== TrapLimit Function ==========================================//
+//========================================== DataUsage Function ==========================================//
+#if (USERDEF_DATA_USAGE == ENABLED)
+/**
+* @brief Set DataUsage object value
+* @param[in] object Pointer to the MIB object descriptor
+* @param[in] oid Object identifier (object name and instance identifier)
+* @param[in] oidLen Length of the OID, in bytes
+* @param[in] value Object value
+* @param[in] valueLen Length of the object value, in bytes
+* @return Error code
+**/
+
+error_t privateMibSetDataUsageGroup(const MibObject *object, const uint8_t *oid,
+                                    size_t oidLen, const MibVariant *value, size_t valueLen)
+{
+  //dataUsageBudget object?
+  if(!strcmp(object->name, "dataUsageBudget"))
+  {
+    //Monthly GPRS budget in kB, 0 for none
+    if(value->integer < 0)
+      return ERROR_WRONG_VALUE;
+    //Saved to EEPROM by the data usage task
+    dataUsageSetBudget(value->integer);
+  }
+  //Unknown object?
+  else
+  {
+    //The specified object does not exist
+    return ERROR_OBJECT_NOT_FOUND;
+  }
+  
+  //Successful processing
+  return NO_ERROR;
+}
+
+
+/**
+* @brief Get DataUsage object value
+* @param[in] object Pointer to the MIB object descriptor
+* @param[in] oid Object identifier (object name and instance identifier)
+* @param[in] oidLen Length of the OID, in bytes
+* @param[out] value Object value
+* @param[in,out] valueLen Length of the object value, in bytes
+* @return Error code
+**/
+
+error_t privateMibGetDataUsageGroup(const MibObject *object, const uint8_t *oid,
+                                    size_t oidLen, MibVariant *value, size_t *valueLen)
+{
+  //dataUsageBudget object?
+  if(!strcmp(object->name, "dataUsageBudget"))
+  {
+    //Get object value
+    value->integer = privateMibView.dataUsageGroup.dataUsageBudget;
+  }
+  //Unknown object?
+  else
+  {
+    //The specified object does not exist
+    return ERROR_OBJECT_NOT_FOUND;
+  }
+  
+  //Successful processing
+  return NO_ERROR;
+}
+
+
+/**
+* @brief Get dataUsageEntry object value
+* @param[in] object Pointer to the MIB object descriptor
+* @param[in] oid Object identifier (object name and instance identifier)
+* @param[in] oidLen Length of the OID, in bytes
+* @param[out] value Object value
+* @param[in,out] valueLen Length of the object value, in bytes
+* @return Error code
+**/
+
+error_t privateMibGetDataUsageEntry(const MibObject *object, const uint8_t *oid,
+                                    size_t oidLen, MibVariant *value, size_t *valueLen)
+{
+  error_t error;
+  size_t n;
+  uint_t index;
+  PrivateMibDataUsageEntry *entry;
+  
+  //Point to the instance identifier
+  n = object->oidLen;
+  
+  //The dataUsageIndex is used as instance identifier
+  error = mibDecodeIndex(oid, oidLen, &n, &index);
+  //Invalid instance identifier?
+  if(error) return error;
+  
+  //Sanity check
+  if(n != oidLen)
+    return ERROR_INSTANCE_NOT_FOUND;
+  
+  //Check index range
+  if(index < 1 || index > privateMibView.dataUsageGroup.dataUsageNumber)
+    return ERROR_INSTANCE_NOT_FOUND;
+  
+  //Point to the data usage table entry
+  entry = &privateMibView.dataUsageGroup.dataUsageTable[index - 1];
+  
+  //dataUsageIndex object?
+  if(!strcmp(object->name, "dataUsageIndex"))
+  {
+    //Get object value
+    value->integer = entry->dataUsageIndex;
+  }
+  //dataUsageIfIndex object?
+  else if(!strcmp(object->name, "dataUsageIfIndex"))
+  {
+    //Get object value
+    value->integer = entry->dataUsageIfIndex;
+  }
+  //dataUsageClassName object?
+  else if(!strcmp(object->name, "dataUsageClassName"))
+  {
+    //Make sure the buffer is large enough to hold the entire object
+    if(*valueLen >= entry->dataUsageClassNameLen)
+    {
+      //Copy object value
+      memcpy(value->octetString, entry->dataUsageClassName, entry->dataUsageClassNameLen);
+      //Return object length
+      *valueLen = entry->dataUsageClassNameLen;
+    }
+    else
+    {
+      //Report an error
+      error = ERROR_BUFFER_OVERFLOW;
+    }
+  }
+  //dataUsageInOctets object?
+  else if(!strcmp(object->name, "dataUsageInOctets"))
+  {
+    //Get object value
+    value->gauge32 = entry->dataUsageInOctets;
+  }
+  //dataUsageOutOctets object?
+  else if(!strcmp(object->name, "dataUsageOutOctets"))
+  {
+    //Get object value
+    value->gauge32 = entry->dataUsageOutOctets;
+  }
+  //dataUsageInPkts object?
+  else if(!strcmp(object->name, "dataUsageInPkts"))
+  {
+    //Get object value
+    value->gauge32 = entry->dataUsageInPkts;
+  }
+  //dataUsageOutPkts object?
+  else if(!strcmp(object->name, "dataUsageOutPkts"))
+  {
+    //Get object value
+    value->gauge32 = entry->dataUsageOutPkts;
+  }
+  //Unknown object?
+  else
+  {
+    //The specified object does not exist
+    error = ERROR_OBJECT_NOT_FOUND;
+  }
+  
+  //Return status code
+  return error;
+}
+
+
+/**
+* @brief Get next dataUsageEntry object
+* @param[in] object Pointer to the MIB object descriptor
+* @param[in] oid Object identifier
+* @param[in] oidLen Length of the OID, in bytes
+* @param[out] nextOid OID of the next object in the MIB
+* @param[out] nextOidLen Length of the next object identifier, in bytes
+* @return Error code
+**/
+error_t privateMibGetNextDataUsageEntry(const MibObject *object, const uint8_t *oid,
+                                        size_t oidLen, uint8_t *nextOid, size_t *nextOidLen)
+{
+  error_t error;
+  size_t n;
+  uint_t index;
+  
+  //Make sure the buffer is large enough to hold the OID prefix
+  if(*nextOidLen < object->oidLen)
+    return ERROR_BUFFER_OVERFLOW;
+  
+  //Copy OID prefix
+  memcpy(nextOid, object->oid, object->oidLen);
+  
+  //Loop through the table rows
+  for(index = 1; index <= privateMibView.dataUsageGroup.dataUsageNumber; index++)
+  {
+    //Append the instance identifier to the OID prefix
+    n = object->oidLen;
+    
+    //The dataUsageIndex is used as instance identifier
+    error = mibEncodeIndex(nextOid, *nextOidLen, &n, index);
+    //Any error to report?
+    if(error) return error;
+    
+    //Check whether the resulting object identifier lexicographically
+    //follows the specified OID
+    if(oidComp(nextOid, n, oid, oidLen) > 0)
+    {
+      //Save the length of the resulting object identifier
+      *nextOidLen = n;
+      //Next object found
+      return NO_ERROR;
+    }
+  }
+  
+  //The specified OID does not lexicographically precede the name
+  //of some object
+  return ERROR_OBJECT_NOT_FOUND;
+}
+
+
+/**
+* @brief Copy the data usage counters into the DataUsage group
+*
+* One row per interface and traffic class. The 64-bit counters saturate at
+* the Gauge32 maximum, the GPRS usage is given in kB
+**/
+
+void UpdateDataUsageInfo (void)
+{
+  static DataUsageRecord record;
+  PrivateMibDataUsageGroup *group;
+  PrivateMibDataUsageEntry *entry;
+  const DataUsageCounter *counter;
+  const char_t *name;
+  uint_t i, j, n;
+  
+  group = &privateMibBase.dataUsageGroup;
+  dataUsageGetRecord(&record);
+  
+  group->dataUsageBudget = MIN(record.budget, INT32_MAX);
+  group->dataUsageStage = dataUsageGetStage();
+  group->dataUsageGprsUsed = (uint32_t) MIN(dataUsageGetGprsBytes(&record) / 1024, UINT32_MAX);
+  group->dataUsageLastMonthUsed = (uint32_t) MIN(record.lastMonthBytes / 1024, UINT32_MAX);
+  
+  n = 0;
+  for(i = 0; i < DATA_USAGE_IF_COUNT; i++)
+  {
+    for(j = 0; j < DATA_USAGE_CLASS_COUNT && n < PRIVATE_MIB_DATA_USAGE_ENTRY_COUNT; j++)
+    {
+      entry = &group->dataUsageTable[n];
+      counter = &record.counters[i][j];
+      name = dataUsageGetClassName(j);
+      entry->dataUsageIndex = n + 1;
+      //Same numbering as ifIndex
+      entry->dataUsageIfIndex = i + 1;
+      strncpy(entry->dataUsageClassName, name, PRIVATE_MIB_DATA_USAGE_CLASS_NAME_SIZE);
+      entry->dataUsageClassNameLen = MIN(strlen(name), PRIVATE_MIB_DATA_USAGE_CLASS_NAME_SIZE);
+      entry->dataUsageInOctets = (uint32_t) MIN(counter->bytes[0], UINT32_MAX);
+      entry->dataUsageOutOctets = (uint32_t) MIN(counter->bytes[1], UINT32_MAX);
+      entry->dataUsageInPkts = counter->packets[0];
+      entry->dataUsageOutPkts = counter->packets[1];
+      n++;
+    }
+  }
+  group->dataUsageNumber = n;
+}
+#endif
+//========================================== DataUsage Function ==========================================//
+
+
 void UpdateInfo (void)
 {
   uint8_t i,j;
@@ -1927,6 +2589,12 @@ void UpdateInfo (void)
   
   Alarm_Control();
   Relay_Output();
+  UpdateDeviceInfo();
+#if (USERDEF_DATA_USAGE == ENABLED)
+  UpdateDataUsageInfo();
+#endif
+  //Publish the updated values at once
+  privateMibPublishSnapshot();
 }
 
 void Alarm_Control(void)
@@ -13,12 +13,18 @@
 //Dependencies
 #include "mibs/mib_common.h"
 #include "snmp/snmp_agent.h"
+#include "private_mib_module.h"
 
 //Private MIB related functions
 error_t privateMibInit(void);
 void privateMibLock(void);
 void privateMibUnlock(void);
+void privateMibPublishSnapshot(void);
+void privateMibGetSnapshot(PrivateMibBase *snapshot);
+void privateMibGetGroupSnapshot(void *group, size_t offset, size_t length);
 void UpdateInfo (void);
+void UpdateDeviceInfo (void);
+void UpdateDataUsageInfo (void);
 void Alarm_Control(void);
 void Relay_Output(void);
 uint8_t IsAnyAlarm();
@@ -88,4 +94,25 @@ error_t privateMibSetBatteryGroup(const MibObject *object, const uint8_t *oid,
 error_t privateMibGetBatteryGroup(const MibObject *object, const uint8_t *oid,
    size_t oidLen, MibVariant *value, size_t *valueLen);
 
+error_t privateMibGetDeviceTaskEntry(const MibObject *object, const uint8_t *oid,
+   size_t oidLen, MibVariant *value, size_t *valueLen);
+
+error_t privateMibGetNextDeviceTaskEntry(const MibObject *object, const uint8_t *oid,
+   size_t oidLen, uint8_t *nextOid, size_t *nextOidLen);
+
+error_t privateMibGetTrapLimitGroup(const MibObject *object, const uint8_t *oid,
+   size_t oidLen, MibVariant *value, size_t *valueLen);
+
+error_t privateMibSetDataUsageGroup(const MibObject *object, const uint8_t *oid,
+   size_t oidLen, const MibVariant *value, size_t valueLen);
+
+error_t privateMibGetDataUsageGroup(const MibObject *object, const uint8_t *oid,
+   size_t oidLen, MibVariant *value, size_t *valueLen);
+
+error_t privateMibGetDataUsageEntry(const MibObject *object, const uint8_t *oid,
+   size_t oidLen, MibVariant *value, size_t *valueLen);
+
+error_t privateMibGetNextDataUsageEntry(const MibObject *object, const uint8_t *oid,
+   size_t oidLen, uint8_t *nextOid, size_t *nextOidLen);
+
 #endif
@@ -981,6 +981,558 @@ const MibObject privateMibObjects[] =
 		privateMibGetAlarmGroup,
 		NULL
 	},
+	//InformInfo group
+	{
+		"informQueueLength",
+		{43, 6, 1, 4, 1, 130, 229, 100, 1, 17, 1},
+		11,
+		ASN1_CLASS_APPLICATION,
+		MIB_TYPE_GAUGE32,
+		MIB_ACCESS_READ_ONLY,
+		&privateMibBase.informGroup.informQueueLength,
+		NULL,
+		sizeof(uint32_t),
+		NULL,
+		NULL,
+		NULL
+	},
+	{
+		"informSentCount",
+		{43, 6, 1, 4, 1, 130, 229, 100, 1, 17, 2},
+		11,
+		ASN1_CLASS_APPLICATION,
+		MIB_TYPE_COUNTER32,
+		MIB_ACCESS_READ_ONLY,
+		&privateMibBase.informGroup.informSentCount,
+		NULL,
+		sizeof(uint32_t),
+		NULL,
+		NULL,
+		NULL
+	},
+	{
+		"informRetryCount",
+		{43, 6, 1, 4, 1, 130, 229, 100, 1, 17, 3},
+		11,
+		ASN1_CLASS_APPLICATION,
+		MIB_TYPE_COUNTER32,
+		MIB_ACCESS_READ_ONLY,
+		&privateMibBase.informGroup.informRetryCount,
+		NULL,
+		sizeof(uint32_t),
+		NULL,
+		NULL,
+		NULL
+	},
+	{
+		"informAckCount",
+		{43, 6, 1, 4, 1, 130, 229, 100, 1, 17, 4},
+		11,
+		ASN1_CLASS_APPLICATION,
+		MIB_TYPE_COUNTER32,
+		MIB_ACCESS_READ_ONLY,
+		&privateMibBase.informGroup.informAckCount,
+		NULL,
+		sizeof(uint32_t),
+		NULL,
+		NULL,
+		NULL
+	},
+	{
+		"informDropCount",
+		{43, 6, 1, 4, 1, 130, 229, 100, 1, 17, 5},
+		11,
+		ASN1_CLASS_APPLICATION,
+		MIB_TYPE_COUNTER32,
+		MIB_ACCESS_READ_ONLY,
+		&privateMibBase.informGroup.informDropCount,
+		NULL,
+		sizeof(uint32_t),
+		NULL,
+		NULL,
+		NULL
+	},
+	{
+		"informLastLatency",
+		{43, 6, 1, 4, 1, 130, 229, 100, 1, 17, 6},
+		11,
+		ASN1_CLASS_APPLICATION,
+		MIB_TYPE_GAUGE32,
+		MIB_ACCESS_READ_ONLY,
+		&privateMibBase.informGroup.informLastLatency,
+		NULL,
+		sizeof(uint32_t),
+		NULL,
+		NULL,
+		NULL
+	},
+	{
+		"informMaxLatency",
+		{43, 6, 1, 4, 1, 130, 229, 100, 1, 17, 7},
+		11,
+		ASN1_CLASS_APPLICATION,
+		MIB_TYPE_GAUGE32,
+		MIB_ACCESS_READ_ONLY,
+		&privateMibBase.informGroup.informMaxLatency,
+		NULL,
+		sizeof(uint32_t),
+		NULL,
+		NULL,
+		NULL
+	},
+	//DeviceInfo group
+	{
+		"deviceHeapFree",
+		{43, 6, 1, 4, 1, 130, 229, 100, 1, 18, 1},
+		11,
+		ASN1_CLASS_APPLICATION,
+		MIB_TYPE_GAUGE32,
+		MIB_ACCESS_READ_ONLY,
+		&privateMibBase.deviceGroup.deviceHeapFree,
+		NULL,
+		sizeof(uint32_t),
+		NULL,
+		NULL,
+		NULL
+	},
+	{
+		"deviceHeapMinFree",
+		{43, 6, 1, 4, 1, 130, 229, 100, 1, 18, 2},
+		11,
+		ASN1_CLASS_APPLICATION,
+		MIB_TYPE_GAUGE32,
+		MIB_ACCESS_READ_ONLY,
+		&privateMibBase.deviceGroup.deviceHeapMinFree,
+		NULL,
+		sizeof(uint32_t),
+		NULL,
+		NULL,
+		NULL
+	},
+	{
+		"deviceMqttPubQueueDepth",
+		{43, 6, 1, 4, 1, 130, 229, 100, 1, 18, 3},
+		11,
+		ASN1_CLASS_APPLICATION,
+		MIB_TYPE_GAUGE32,
+		MIB_ACCESS_READ_ONLY,
+		&privateMibBase.deviceGroup.deviceMqttPubQueueDepth,
+		NULL,
+		sizeof(uint32_t),
+		NULL,
+		NULL,
+		NULL
+	},
+	{
+		"deviceMqttRcvQueueDepth",
+		{43, 6, 1, 4, 1, 130, 229, 100, 1, 18, 4},
+		11,
+		ASN1_CLASS_APPLICATION,
+		MIB_TYPE_GAUGE32,
+		MIB_ACCESS_READ_ONLY,
+		&privateMibBase.deviceGroup.deviceMqttRcvQueueDepth,
+		NULL,
+		sizeof(uint32_t),
+		NULL,
+		NULL,
+		NULL
+	},
+	{
+		"deviceModbusCycleTime",
+		{43, 6, 1, 4, 1, 130, 229, 100, 1, 18, 5},
+		11,
+		ASN1_CLASS_APPLICATION,
+		MIB_TYPE_GAUGE32,
+		MIB_ACCESS_READ_ONLY,
+		&privateMibBase.deviceGroup.deviceModbusCycleTime,
+		NULL,
+		sizeof(uint32_t),
+		NULL,
+		NULL,
+		NULL
+	},
+	{
+		"deviceModbusMaxCycleTime",
+		{43, 6, 1, 4, 1, 130, 229, 100, 1, 18, 6},
+		11,
+		ASN1_CLASS_APPLICATION,
+		MIB_TYPE_GAUGE32,
+		MIB_ACCESS_READ_ONLY,
+		&privateMibBase.deviceGroup.deviceModbusMaxCycleTime,
+		NULL,
+		sizeof(uint32_t),
+		NULL,
+		NULL,
+		NULL
+	},
+	{
+		"deviceEthInOctets",
+		{43, 6, 1, 4, 1, 130, 229, 100, 1, 18, 7},
+		11,
+		ASN1_CLASS_APPLICATION,
+		MIB_TYPE_COUNTER32,
+		MIB_ACCESS_READ_ONLY,
+		&privateMibBase.deviceGroup.deviceEthInOctets,
+		NULL,
+		sizeof(uint32_t),
+		NULL,
+		NULL,
+		NULL
+	},
+	{
+		"deviceEthOutOctets",
+		{43, 6, 1, 4, 1, 130, 229, 100, 1, 18, 8},
+		11,
+		ASN1_CLASS_APPLICATION,
+		MIB_TYPE_COUNTER32,
+		MIB_ACCESS_READ_ONLY,
+		&privateMibBase.deviceGroup.deviceEthOutOctets,
+		NULL,
+		sizeof(uint32_t),
+		NULL,
+		NULL,
+		NULL
+	},
+	{
+		"devicePppInOctets",
+		{43, 6, 1, 4, 1, 130, 229, 100, 1, 18, 9},
+		11,
+		ASN1_CLASS_APPLICATION,
+		MIB_TYPE_COUNTER32,
+		MIB_ACCESS_READ_ONLY,
+		&privateMibBase.deviceGroup.devicePppInOctets,
+		NULL,
+		sizeof(uint32_t),
+		NULL,
+		NULL,
+		NULL
+	},
+	{
+		"devicePppOutOctets",
+		{43, 6, 1, 4, 1, 130, 229, 100, 1, 18, 10},
+		11,
+		ASN1_CLASS_APPLICATION,
+		MIB_TYPE_COUNTER32,
+		MIB_ACCESS_READ_ONLY,
+		&privateMibBase.deviceGroup.devicePppOutOctets,
+		NULL,
+		sizeof(uint32_t),
+		NULL,
+		NULL,
+		NULL
+	},
+	{
+		"deviceTaskNumber",
+		{43, 6, 1, 4, 1, 130, 229, 100, 1, 18, 11},
+		11,
+		ASN1_CLASS_UNIVERSAL,
+		ASN1_TYPE_INTEGER,
+		MIB_ACCESS_READ_ONLY,
+		&privateMibBase.deviceGroup.deviceTaskNumber,
+		NULL,
+		sizeof(int32_t),
+		NULL,
+		NULL,
+		NULL
+	},
+	//DeviceTask table
+	{
+		"deviceTaskIndex",
+		{43, 6, 1, 4, 1, 130, 229, 100, 1, 18, 12, 1, 1},
+		13,
+		ASN1_CLASS_UNIVERSAL,
+		ASN1_TYPE_INTEGER,
+		MIB_ACCESS_READ_ONLY,
+		NULL,
+		NULL,
+		sizeof(int32_t),
+		NULL,
+		privateMibGetDeviceTaskEntry,
+		privateMibGetNextDeviceTaskEntry
+	},
+	{
+		"deviceTaskName",
+		{43, 6, 1, 4, 1, 130, 229, 100, 1, 18, 12, 1, 2},
+		13,
+		ASN1_CLASS_UNIVERSAL,
+		ASN1_TYPE_OCTET_STRING,
+		MIB_ACCESS_READ_ONLY,
+		NULL,
+		NULL,
+		PRIVATE_MIB_DEVICE_TASK_NAME_SIZE,
+		NULL,
+		privateMibGetDeviceTaskEntry,
+		privateMibGetNextDeviceTaskEntry
+	},
+	{
+		"deviceTaskStackFree",
+		{43, 6, 1, 4, 1, 130, 229, 100, 1, 18, 12, 1, 3},
+		13,
+		ASN1_CLASS_APPLICATION,
+		MIB_TYPE_GAUGE32,
+		MIB_ACCESS_READ_ONLY,
+		NULL,
+		NULL,
+		sizeof(uint32_t),
+		NULL,
+		privateMibGetDeviceTaskEntry,
+		privateMibGetNextDeviceTaskEntry
+	},
+	{
+		"deviceTaskCpuShare",
+		{43, 6, 1, 4, 1, 130, 229, 100, 1, 18, 12, 1, 4},
+		13,
+		ASN1_CLASS_APPLICATION,
+		MIB_TYPE_GAUGE32,
+		MIB_ACCESS_READ_ONLY,
+		NULL,
+		NULL,
+		sizeof(uint32_t),
+		NULL,
+		privateMibGetDeviceTaskEntry,
+		privateMibGetNextDeviceTaskEntry
+	},
+	//TrapLimit group
+	{
+		"trapLimitSuppressedCount",
+		{43, 6, 1, 4, 1, 130, 229, 100, 1, 19, 1},
+		11,
+		ASN1_CLASS_APPLICATION,
+		MIB_TYPE_COUNTER32,
+		MIB_ACCESS_READ_ONLY,
+		NULL,
+		NULL,
+		sizeof(uint32_t),
+		NULL,
+		privateMibGetTrapLimitGroup,
+		NULL
+	},
+	{
+		"trapLimitSummaryCount",
+		{43, 6, 1, 4, 1, 130, 229, 100, 1, 19, 2},
+		11,
+		ASN1_CLASS_APPLICATION,
+		MIB_TYPE_COUNTER32,
+		MIB_ACCESS_READ_ONLY,
+		NULL,
+		NULL,
+		sizeof(uint32_t),
+		NULL,
+		privateMibGetTrapLimitGroup,
+		NULL
+	},
+	{
+		"trapLimitCombinedInfoCount",
+		{43, 6, 1, 4, 1, 130, 229, 100, 1, 19, 3},
+		11,
+		ASN1_CLASS_APPLICATION,
+		MIB_TYPE_COUNTER32,
+		MIB_ACCESS_READ_ONLY,
+		NULL,
+		NULL,
+		sizeof(uint32_t),
+		NULL,
+		privateMibGetTrapLimitGroup,
+		NULL
+	},
+	{
+		"trapLimitSummaryCounts",
+		{43, 6, 1, 4, 1, 130, 229, 100, 1, 19, 4},
+		11,
+		ASN1_CLASS_UNIVERSAL,
+		ASN1_TYPE_OCTET_STRING,
+		MIB_ACCESS_READ_ONLY,
+		NULL,
+		NULL,
+		PRIVATE_MIB_TRAP_LIMIT_ALARM_COUNT,
+		NULL,
+		privateMibGetTrapLimitGroup,
+		NULL
+	},
+	{
+		"trapLimitSummaryStates",
+		{43, 6, 1, 4, 1, 130, 229, 100, 1, 19, 5},
+		11,
+		ASN1_CLASS_UNIVERSAL,
+		ASN1_TYPE_OCTET_STRING,
+		MIB_ACCESS_READ_ONLY,
+		NULL,
+		NULL,
+		PRIVATE_MIB_TRAP_LIMIT_ALARM_COUNT,
+		NULL,
+		privateMibGetTrapLimitGroup,
+		NULL
+	},
+	//DataUsage group
+	{
+		"dataUsageBudget",
+		{43, 6, 1, 4, 1, 130, 229, 100, 1, 20, 1},
+		11,
+		ASN1_CLASS_UNIVERSAL,
+		ASN1_TYPE_INTEGER,
+		MIB_ACCESS_READ_WRITE,
+		NULL,
+		NULL,
+		sizeof(int32_t),
+		privateMibSetDataUsageGroup,
+		privateMibGetDataUsageGroup,
+		NULL
+	},
+	{
+		"dataUsageStage",
+		{43, 6, 1, 4, 1, 130, 229, 100, 1, 20, 2},
+		11,
+		ASN1_CLASS_UNIVERSAL,
+		ASN1_TYPE_INTEGER,
+		MIB_ACCESS_READ_ONLY,
+		&privateMibBase.dataUsageGroup.dataUsageStage,
+		NULL,
+		sizeof(int32_t),
+		NULL,
+		NULL,
+		NULL
+	},
+	{
+		"dataUsageGprsUsed",
+		{43, 6, 1, 4, 1, 130, 229, 100, 1, 20, 3},
+		11,
+		ASN1_CLASS_APPLICATION,
+		MIB_TYPE_GAUGE32,
+		MIB_ACCESS_READ_ONLY,
+		&privateMibBase.dataUsageGroup.dataUsageGprsUsed,
+		NULL,
+		sizeof(uint32_t),
+		NULL,
+		NULL,
+		NULL
+	},
+	{
+		"dataUsageLastMonthUsed",
+		{43, 6, 1, 4, 1, 130, 229, 100, 1, 20, 4},
+		11,
+		ASN1_CLASS_APPLICATION,
+		MIB_TYPE_GAUGE32,
+		MIB_ACCESS_READ_ONLY,
+		&privateMibBase.dataUsageGroup.dataUsageLastMonthUsed,
+		NULL,
+		sizeof(uint32_t),
+		NULL,
+		NULL,
+		NULL
+	},
+	{
+		"dataUsageNumber",
+		{43, 6, 1, 4, 1, 130, 229, 100, 1, 20, 5},
+		11,
+		ASN1_CLASS_UNIVERSAL,
+		ASN1_TYPE_INTEGER,
+		MIB_ACCESS_READ_ONLY,
+		&privateMibBase.dataUsageGroup.dataUsageNumber,
+		NULL,
+		sizeof(int32_t),
+		NULL,
+		NULL,
+		NULL
+	},
+	//DataUsage table
+	{
+		"dataUsageIndex",
+		{43, 6, 1, 4, 1, 130, 229, 100, 1, 20, 6, 1, 1},
+		13,
+		ASN1_CLASS_UNIVERSAL,
+		ASN1_TYPE_INTEGER,
+		MIB_ACCESS_READ_ONLY,
+		NULL,
+		NULL,
+		sizeof(int32_t),
+		NULL,
+		privateMibGetDataUsageEntry,
+		privateMibGetNextDataUsageEntry
+	},
+	{
+		"dataUsageIfIndex",
+		{43, 6, 1, 4, 1, 130, 229, 100, 1, 20, 6, 1, 2},
+		13,
+		ASN1_CLASS_UNIVERSAL,
+		ASN1_TYPE_INTEGER,
+		MIB_ACCESS_READ_ONLY,
+		NULL,
+		NULL,
+		sizeof(int32_t),
+		NULL,
+		privateMibGetDataUsageEntry,
+		privateMibGetNextDataUsageEntry
+	},
+	{
+		"dataUsageClassName",
+		{43, 6, 1, 4, 1, 130, 229, 100, 1, 20, 6, 1, 3},
+		13,
+		ASN1_CLASS_UNIVERSAL,
+		ASN1_TYPE_OCTET_STRING,
+		MIB_ACCESS_READ_ONLY,
+		NULL,
+		NULL,
+		PRIVATE_MIB_DATA_USAGE_CLASS_NAME_SIZE,
+		NULL,
+		privateMibGetDataUsageEntry,
+		privateMibGetNextDataUsageEntry
+	},
+	{
+		"dataUsageInOctets",
+		{43, 6, 1, 4, 1, 130, 229, 100, 1, 20, 6, 1, 4},
+		13,
+		ASN1_CLASS_APPLICATION,
+		MIB_TYPE_GAUGE32,
+		MIB_ACCESS_READ_ONLY,
+		NULL,
+		NULL,
+		sizeof(uint32_t),
+		NULL,
+		privateMibGetDataUsageEntry,
+		privateMibGetNextDataUsageEntry
+	},
+	{
+		"dataUsageOutOctets",
+		{43, 6, 1, 4, 1, 130, 229, 100, 1, 20, 6, 1, 5},
+		13,
+		ASN1_CLASS_APPLICATION,
+		MIB_TYPE_GAUGE32,
+		MIB_ACCESS_READ_ONLY,
+		NULL,
+		NULL,
+		sizeof(uint32_t),
+		NULL,
+		privateMibGetDataUsageEntry,
+		privateMibGetNextDataUsageEntry
+	},
+	{
+		"dataUsageInPkts",
+		{43, 6, 1, 4, 1, 130, 229, 100, 1, 20, 6, 1, 6},
+		13,
+		ASN1_CLASS_APPLICATION,
+		MIB_TYPE_GAUGE32,
+		MIB_ACCESS_READ_ONLY,
+		NULL,
+		NULL,
+		sizeof(uint32_t),
+		NULL,
+		privateMibGetDataUsageEntry,
+		privateMibGetNextDataUsageEntry
+	},
+	{
+		"dataUsageOutPkts",
+		{43, 6, 1, 4, 1, 130, 229, 100, 1, 20, 6, 1, 7},
+		13,
+		ASN1_CLASS_APPLICATION,
+		MIB_TYPE_GAUGE32,
+		MIB_ACCESS_READ_ONLY,
+		NULL,
+		NULL,
+		sizeof(uint32_t),
+		NULL,
+		privateMibGetDataUsageEntry,
+		privateMibGetNextDataUsageEntry
+	},
 	//testString object (1.3.6.1.4.1.8072.9999.9999.1.1)
 	{
 		"testString",
@@ -19,6 +19,16 @@
 #define PRIVATE_MIB_LED_COUNT 3
 //Size of ledColor object
 #define PRIVATE_MIB_LED_COLOR_SIZE 8
+//Maximum number of tasks reported in deviceTaskTable
+#define PRIVATE_MIB_DEVICE_TASK_COUNT 20
+//Size of deviceTaskName object
+#define PRIVATE_MIB_DEVICE_TASK_NAME_SIZE 16
+//Number of alarms reported in the trapLimitSummary objects
+#define PRIVATE_MIB_TRAP_LIMIT_ALARM_COUNT 10
+//Number of rows of dataUsageTable (interfaces times traffic classes)
+#define PRIVATE_MIB_DATA_USAGE_ENTRY_COUNT 16
+//Size of dataUsageClassName object
+#define PRIVATE_MIB_DATA_USAGE_CLASS_NAME_SIZE 16
 
 
 /**
@@ -188,6 +198,96 @@ typedef struct
 	uint32_t alarmAcThresAlarms_old;
 } PrivateMibAlarmGroup;
 /**
+* @brief InformInfo group
+**/
+
+typedef struct
+{
+	uint32_t informQueueLength;
+	uint32_t informSentCount;
+	uint32_t informRetryCount;
+	uint32_t informAckCount;
+	uint32_t informDropCount;
+	uint32_t informLastLatency;
+	uint32_t informMaxLatency;
+} PrivateMibInformGroup;
+
+/**
+* @brief deviceTask table entry
+**/
+
+typedef struct
+{
+	int32_t deviceTaskIndex;
+	char_t deviceTaskName[PRIVATE_MIB_DEVICE_TASK_NAME_SIZE];
+	size_t deviceTaskNameLen;
+	uint32_t deviceTaskStackFree;
+	uint32_t deviceTaskCpuShare;
+} PrivateMibDeviceTaskEntry;
+
+/**
+* @brief DeviceInfo group
+**/
+
+typedef struct
+{
+	uint32_t deviceHeapFree;
+	uint32_t deviceHeapMinFree;
+	uint32_t deviceMqttPubQueueDepth;
+	uint32_t deviceMqttRcvQueueDepth;
+	uint32_t deviceModbusCycleTime;
+	uint32_t deviceModbusMaxCycleTime;
+	uint32_t deviceEthInOctets;
+	uint32_t deviceEthOutOctets;
+	uint32_t devicePppInOctets;
+	uint32_t devicePppOutOctets;
+	int32_t deviceTaskNumber;
+	PrivateMibDeviceTaskEntry deviceTaskTable[PRIVATE_MIB_DEVICE_TASK_COUNT];
+} PrivateMibDeviceGroup;
+/**
+* @brief TrapLimit group
+**/
+
+typedef struct
+{
+	uint32_t trapLimitSuppressedCount;
+	uint32_t trapLimitSummaryCount;
+	uint32_t trapLimitCombinedInfoCount;
+	uint8_t trapLimitSummaryCounts[PRIVATE_MIB_TRAP_LIMIT_ALARM_COUNT];
+	size_t trapLimitSummaryCountsLen;
+	uint8_t trapLimitSummaryStates[PRIVATE_MIB_TRAP_LIMIT_ALARM_COUNT];
+	size_t trapLimitSummaryStatesLen;
+} PrivateMibTrapLimitGroup;
+/**
+* @brief dataUsage table entry
+**/
+
+typedef struct
+{
+	int32_t dataUsageIndex;
+	int32_t dataUsageIfIndex;
+	char_t dataUsageClassName[PRIVATE_MIB_DATA_USAGE_CLASS_NAME_SIZE];
+	size_t dataUsageClassNameLen;
+	uint32_t dataUsageInOctets;
+	uint32_t dataUsageOutOctets;
+	uint32_t dataUsageInPkts;
+	uint32_t dataUsageOutPkts;
+} PrivateMibDataUsageEntry;
+
+/**
+* @brief DataUsage group
+**/
+
+typedef struct
+{
+	int32_t dataUsageBudget;
+	int32_t dataUsageStage;
+	uint32_t dataUsageGprsUsed;
+	uint32_t dataUsageLastMonthUsed;
+	int32_t dataUsageNumber;
+	PrivateMibDataUsageEntry dataUsageTable[PRIVATE_MIB_DATA_USAGE_ENTRY_COUNT];
+} PrivateMibDataUsageGroup;
+/**
 * @brief Private MIB base
 **/
 
@@ -205,6 +305,10 @@ typedef struct
 	PrivateMibConfigGroup configGroup;
 	PrivateMibAlarmGroup alarmGroup;
 	PrivateMibBatteryGroup batteryGroup;
+	PrivateMibInformGroup informGroup;
+	PrivateMibDeviceGroup deviceGroup;
+	PrivateMibTrapLimitGroup trapLimitGroup;
+	PrivateMibDataUsageGroup dataUsageGroup;
 } PrivateMibBase;
 
 
@@ -8,42 +8,7 @@
 #include "eeprom_rtc.h"
 #include "variables.h"
 #include "access_control.h"
-static const unsigned char CRCHighTable[] = {
-    0x00, 0xC1, 0x81, 0x40, 0x01, 0xC0, 0x80, 0x41, 0x01, 0xC0, 0x80, 0x41, 0x00, 0xC1, 0x81, 0x40,
-    0x01, 0xC0, 0x80, 0x41, 0x00, 0xC1, 0x81, 0x40, 0x00, 0xC1, 0x81, 0x40, 0x01, 0xC0, 0x80, 0x41,
-    0x01, 0xC0, 0x80, 0x41, 0x00, 0xC1, 0x81, 0x40, 0x00, 0xC1, 0x81, 0x40, 0x01, 0xC0, 0x80, 0x41,
-    0x00, 0xC1, 0x81, 0x40, 0x01, 0xC0, 0x80, 0x41, 0x01, 0xC0, 0x80, 0x41, 0x00, 0xC1, 0x81, 0x40,
-    0x01, 0xC0, 0x80, 0x41, 0x00, 0xC1, 0x81, 0x40, 0x00, 0xC1, 0x81, 0x40, 0x01, 0xC0, 0x80, 0x41,
-    0x00, 0xC1, 0x81, 0x40, 0x01, 0xC0, 0x80, 0x41, 0x01, 0xC0, 0x80, 0x41, 0x00, 0xC1, 0x81, 0x40,
-    0x00, 0xC1, 0x81, 0x40, 0x01, 0xC0, 0x80, 0x41, 0x01, 0xC0, 0x80, 0x41, 0x00, 0xC1, 0x81, 0x40,
-    0x01, 0xC0, 0x80, 0x41, 0x00, 0xC1, 0x81, 0x40, 0x00, 0xC1, 0x81, 0x40, 0x01, 0xC0, 0x80, 0x41,
-    0x01, 0xC0, 0x80, 0x41, 0x00, 0xC1, 0x81, 0x40, 0x00, 0xC1, 0x81, 0x40, 0x01, 0xC0, 0x80, 0x41,
-    0x00, 0xC1, 0x81, 0x40, 0x01, 0xC0, 0x80, 0x41, 0x01, 0xC0, 0x80, 0x41, 0x00, 0xC1, 0x81, 0x40,
-    0x00, 0xC1, 0x81, 0x40, 0x01, 0xC0, 0x80, 0x41, 0x01, 0xC0, 0x80, 0x41, 0x00, 0xC1, 0x81, 0x40,
-    0x01, 0xC0, 0x80, 0x41, 0x00, 0xC1, 0x81, 0x40, 0x00, 0xC1, 0x81, 0x40, 0x01, 0xC0, 0x80, 0x41,
-    0x00, 0xC1, 0x81, 0x40, 0x01, 0xC0, 0x80, 0x41, 0x01, 0xC0, 0x80, 0x41, 0x00, 0xC1, 0x81, 0x40,
-    0x01, 0xC0, 0x80, 0x41, 0x00, 0xC1, 0x81, 0x40, 0x00, 0xC1, 0x81, 0x40, 0x01, 0xC0, 0x80, 0x41,
-    0x01, 0xC0, 0x80, 0x41, 0x00, 0xC1, 0x81, 0x40, 0x00, 0xC1, 0x81, 0x40, 0x01, 0xC0, 0x80, 0x41,
-    0x00, 0xC1, 0x81, 0x40, 0x01, 0xC0, 0x80, 0x41, 0x01, 0xC0, 0x80, 0x41, 0x00, 0xC1, 0x81, 0x40 };
-
-static const unsigned char CRCLowTable[] = {
-    0x00, 0xC0, 0xC1, 0x01, 0xC3, 0x03, 0x02, 0xC2, 0xC6, 0x06, 0x07, 0xC7, 0x05, 0xC5, 0xC4, 0x04,
-    0xCC, 0x0C, 0x0D, 0xCD, 0x0F, 0xCF, 0xCE, 0x0E, 0x0A, 0xCA, 0xCB, 0x0B, 0xC9, 0x09, 0x08, 0xC8,
-    0xD8, 0x18, 0x19, 0xD9, 0x1B, 0xDB, 0xDA, 0x1A, 0x1E, 0xDE, 0xDF, 0x1F, 0xDD, 0x1D, 0x1C, 0xDC,
-    0x14, 0xD4, 0xD5, 0x15, 0xD7, 0x17, 0x16, 0xD6, 0xD2, 0x12, 0x13, 0xD3, 0x11, 0xD1, 0xD0, 0x10,
-    0xF0, 0x30, 0x31, 0xF1, 0x33, 0xF3, 0xF2, 0x32, 0x36, 0xF6, 0xF7, 0x37, 0xF5, 0x35, 0x34, 0xF4,
-    0x3C, 0xFC, 0xFD, 0x3D, 0xFF, 0x3F, 0x3E, 0xFE, 0xFA, 0x3A, 0x3B, 0xFB, 0x39, 0xF9, 0xF8, 0x38,
-    0x28, 0xE8, 0xE9, 0x29, 0xEB, 0x2B, 0x2A, 0xEA, 0xEE, 0x2E, 0x2F, 0xEF, 0x2D, 0xED, 0xEC, 0x2C,
-    0xE4, 0x24, 0x25, 0xE5, 0x27, 0xE7, 0xE6, 0x26, 0x22, 0xE2, 0xE3, 0x23, 0xE1, 0x21, 0x20, 0xE0,
-    0xA0, 0x60, 0x61, 0xA1, 0x63, 0xA3, 0xA2, 0x62, 0x66, 0xA6, 0xA7, 0x67, 0xA5, 0x65, 0x64, 0xA4,
-    0x6C, 0xAC, 0xAD, 0x6D, 0xAF, 0x6F, 0x6E, 0xAE, 0xAA, 0x6A, 0x6B, 0xAB, 0x69, 0xA9, 0xA8, 0x68,
-    0x78, 0xB8, 0xB9, 0x79, 0xBB, 0x7B, 0x7A, 0xBA, 0xBE, 0x7E, 0x7F, 0xBF, 0x7D, 0xBD, 0xBC, 0x7C,
-    0xB4, 0x74, 0x75, 0xB5, 0x77, 0xB7, 0xB6, 0x76, 0x72, 0xB2, 0xB3, 0x73, 0xB1, 0x71, 0x70, 0xB0,
-    0x50, 0x90, 0x91, 0x51, 0x93, 0x53, 0x52, 0x92, 0x96, 0x56, 0x57, 0x97, 0x55, 0x95, 0x94, 0x54,
-    0x9C, 0x5C, 0x5D, 0x9D, 0x5F, 0x9F, 0x9E, 0x5E, 0x5A, 0x9A, 0x9B, 0x5B, 0x99, 0x59, 0x58, 0x98,
-    0x88, 0x48, 0x49, 0x89, 0x4B, 0x8B, 0x8A, 0x4A, 0x4E, 0x8E, 0x8F, 0x4F, 0x8D, 0x4D, 0x4C, 0x8C,
-    0x44, 0x84, 0x85, 0x45, 0x87, 0x47, 0x46, 0x86, 0x82, 0x42, 0x43, 0x83, 0x41, 0x81, 0x80, 0x40
-};
+#include "crc.h"
 
 sMODBUSRTU_struct Modbus;
 sMODBUSRTU_struct DoorAccess;
@@ -154,12 +119,10 @@ int8_t RS4851_Check_Respond_Data (void)
     
     if(Modbus.u8MosbusEn==2)
     {
-        Modbus.u8CRCHighRead = Modbus.u8BuffRead[Modbus.u8ByteCount-2];
-        Modbus.u8CRCLowRead  = Modbus.u8BuffRead[Modbus.u8ByteCount-1];
-        
-        ModbusCRC(&Modbus.u8BuffRead[0],Modbus.u8ByteCount-2);
-        
-        if(Modbus.u8CRCHigh == Modbus.u8CRCHighRead && Modbus.u8CRCLow==Modbus.u8CRCLowRead)
+        // CRC is sent low byte first, running it over the whole frame
+        // including the CRC field leaves a zero remainder
+        if(Modbus.u8ByteCount >= 4 &&
+           crc16ModbusCalc(&Modbus.u8BuffRead[0], Modbus.u8ByteCount) == 0)
         {
             Modbus.u8FunctionCode 	= Modbus.u8BuffRead[1];
             
@@ -280,6 +243,8 @@ void Extract_Holding_Regs_Data_DOOR (void)
 
 void Read_Holding_Regs_Query (uint8_t slaveAddr, uint16_t startingAddr, uint16_t noPoint)
 {
+    uint16_t crc;
+    
     Modbus.u8SlaveID = slaveAddr;
     Modbus.u8FunctionCode = 0x03;
     Modbus.u8StartHigh = (uint8_t)(startingAddr>>8);
@@ -294,16 +259,18 @@ void Read_Holding_Regs_Query (uint8_t slaveAddr, uint16_t startingAddr, uint16_t
     Modbus.u8BuffWrite[4] = Modbus.u8NumberRegHigh;
     Modbus.u8BuffWrite[5] = Modbus.u8NumberRegLow;
     
-    ModbusCRC(&Modbus.u8BuffWrite[0],6);
+    crc = crc16ModbusCalc(&Modbus.u8BuffWrite[0], 6);
     
-    Modbus.u8BuffWrite[6] = Modbus.u8CRCHigh;
-    Modbus.u8BuffWrite[7] = Modbus.u8CRCLow;
+    Modbus.u8BuffWrite[6] = (uint8_t)(crc);
+    Modbus.u8BuffWrite[7] = (uint8_t)(crc>>8);
     
     UART_WriteBlocking(RS4851_UART, Modbus.u8BuffWrite, 8);
 }
 
 void Write_Single_Reg (uint8_t slaveAddr, uint16_t regAddr, uint16_t writeVal)
 {
+    uint16_t crc;
+    
     Modbus.u8SlaveID = slaveAddr;
     Modbus.u8FunctionCode = 0x06;
     Modbus.u8StartHigh = (uint8_t)(regAddr>>8);
@@ -318,16 +285,18 @@ void Write_Single_Reg (uint8_t slaveAddr, uint16_t regAddr, uint16_t writeVal)
     Modbus.u8BuffWrite[4] = Modbus.u8NumberRegHigh;
     Modbus.u8BuffWrite[5] = Modbus.u8NumberRegLow;
     
-    ModbusCRC(&Modbus.u8BuffWrite[0],6);
+    crc = crc16ModbusCalc(&Modbus.u8BuffWrite[0], 6);
     
-    Modbus.u8BuffWrite[6] = Modbus.u8CRCHigh;
-    Modbus.u8BuffWrite[7] = Modbus.u8CRCLow;
+    Modbus.u8BuffWrite[6] = (uint8_t)(crc);
+    Modbus.u8BuffWrite[7] = (uint8_t)(crc>>8);
     
     UART_WriteBlocking(RS4851_UART, Modbus.u8BuffWrite, 8);  
 }
 
 void Write_Time_Reg (uint8_t slaveAddr, uint16_t regAddr, uint16_t writeVal)
 {
+    uint16_t crc;
+    
     Modbus.u8SlaveID = slaveAddr;
     Modbus.u8FunctionCode = 50;
     Modbus.u8StartHigh = (uint8_t)(regAddr>>8);
@@ -344,23 +313,10 @@ void Write_Time_Reg (uint8_t slaveAddr, uint16_t regAddr, uint16_t writeVal)
     Modbus.u8BuffWrite[8] = GTime.min;
     Modbus.u8BuffWrite[9] = GTime.sec;
     
-    ModbusCRC(&Modbus.u8BuffWrite[0],20);
+    crc = crc16ModbusCalc(&Modbus.u8BuffWrite[0], 20);
     
-    Modbus.u8BuffWrite[20] = Modbus.u8CRCHigh;
-    Modbus.u8BuffWrite[21] = Modbus.u8CRCLow;
+    Modbus.u8BuffWrite[20] = (uint8_t)(crc);
+    Modbus.u8BuffWrite[21] = (uint8_t)(crc>>8);
     
     UART_WriteBlocking(RS4851_UART, Modbus.u8BuffWrite, 22);
 }
-
-void ModbusCRC(unsigned char *str, unsigned char len)
-{
-    unsigned char temp;
-    Modbus.u8CRCHigh = 0xFF; Modbus.u8CRCLow = 0xFF;
-    
-    while( len--)
-    {
-        temp = *str++ ^ Modbus.u8CRCHigh;
-        Modbus.u8CRCHigh = CRCHighTable[temp] ^ Modbus.u8CRCLow;
-        Modbus.u8CRCLow  = CRCLowTable[temp];
-    }
-}
\ No newline at end of file
@@ -68,12 +68,6 @@ typedef struct {
     uint8_t u8BuffWrite[128];
     uint8_t u8BuffRead[128];
     
-    uint8_t u8CRCHigh;
-    uint8_t u8CRCLow;
-    
-    uint8_t u8CRCHighRead;
-    uint8_t u8CRCLowRead;
-    
     uint8_t u8SlaveID;
     uint8_t u8FunctionCode;
     
@@ -91,12 +85,15 @@ typedef struct {
     
     uint8_t u8MosbusEn;
     uint8_t u8DataPointer;
+    
+    uint32_t cycleStartTime;
+    uint32_t cycleTime;
+    uint32_t maxCycleTime;
 }sMODBUSRTU_struct;
 extern sMODBUSRTU_struct Modbus;
 extern sMODBUSRTU_struct DoorAccess;
 
 void Init_RS485_UART (void);
-void ModbusCRC(unsigned char *str, unsigned char len);
 int8_t RS4851_Check_Respond_Data (void);
 void Read_Holding_Regs_Query (uint8_t slaveAddr, uint16_t startingAddr, uint16_t noPoint);
 void Write_Single_Reg (uint8_t slaveAddr, uint16_t regAddr, uint16_t writeVal);
@@ -0,0 +1,651 @@
+/*
+    FreeRTOS V9.0.0 - Copyright (C) 2016 Real Time Engineers Ltd.
+    All rights reserved
+
+    VISIT http://www.FreeRTOS.org TO ENSURE YOU ARE USING THE LATEST VERSION.
+
+    This file is part of the FreeRTOS distribution.
+
+    FreeRTOS is free software; you can redistribute it and/or modify it under
+    the terms of the GNU General Public License (version 2) as published by the
+    Free Software Foundation >>>> AND MODIFIED BY <<<< the FreeRTOS exception.
+
+    ***************************************************************************
+    >>!   NOTE: The modification to the GPL is included to allow you to     !<<
+    >>!   distribute a combined work that includes FreeRTOS without being   !<<
+    >>!   obliged to provide the source code for proprietary components     !<<
+    >>!   outside of the FreeRTOS kernel.                                   !<<
+    ***************************************************************************
+
+    FreeRTOS is distributed in the hope that it will be useful, but WITHOUT ANY
+    WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+    FOR A PARTICULAR PURPOSE.  Full license text is available on the following
+    link: http://www.freertos.org/a00114.html
+
+    ***************************************************************************
+     *                                                                       *
+     *    FreeRTOS provides completely free yet professionally developed,    *
+     *    robust, strictly quality controlled, supported, and cross          *
+     *    platform software that is more than just the market leader, it     *
+     *    is the industry's de facto standard.                               *
+     *                                                                       *
+     *    Help yourself get started quickly while simultaneously helping     *
+     *    to support the FreeRTOS project by purchasing a FreeRTOS           *
+     *    tutorial book, reference manual, or both:                          *
+     *    http://www.FreeRTOS.org/Documentation                              *
+     *                                                                       *
+    ***************************************************************************
+
+    http://www.FreeRTOS.org/FAQHelp.html - Having a problem?  Start by reading
+    the FAQ page "My application does not run, what could be wrong?".  Have you
+    defined configASSERT()?
+
+    http://www.FreeRTOS.org/support - In return for receiving this top quality
+    embedded software for free we request you assist our global community by
+    participating in the support forum.
+
+    http://www.FreeRTOS.org/training - Investing in training allows your team to
+    be as productive as possible as early as possible.  Now you can receive
+    FreeRTOS training directly from Richard Barry, CEO of Real Time Engineers
+    Ltd, and the world's leading authority on the world's leading RTOS.
+
+    http://www.FreeRTOS.org/plus - A selection of FreeRTOS ecosystem products,
+    including FreeRTOS+Trace - an indispensable productivity tool, a DOS
+    compatible FAT file system, and our tiny thread aware UDP/IP stack.
+
+    http://www.FreeRTOS.org/labs - Where new FreeRTOS products go to incubate.
+    Come and try FreeRTOS+TCP, our new open source TCP/IP stack for FreeRTOS.
+
+    http://www.OpenRTOS.com - Real Time Engineers ltd. license FreeRTOS to High
+    Integrity Systems ltd. to sell under the OpenRTOS brand.  Low cost OpenRTOS
+    licenses offer ticketed support, indemnification and commercial middleware.
+
+    http://www.SafeRTOS.com - High Integrity Systems also provide a safety
+    engineered and independently SIL3 certified version for use in safety and
+    mission critical applications that require provable dependability.
+
+    1 tab == 4 spaces!
+*/
+
+/*-----------------------------------------------------------
+ * Implementation of functions defined in portable.h for the Linux (POSIX
+ * threads) simulator port.
+ *
+ * Every task owns a pthread, created blocked when the task is created.  A
+ * context switch resumes the thread of the next task and suspends the thread
+ * of the previous one, so exactly one task thread runs at any time and the
+ * kernel data is never accessed concurrently.
+ *
+ * Interrupts are signals, delivered to the only thread that leaves them
+ * unmasked: the running task.  The tick is SIGALRM from a periodic interval
+ * timer.  Simulated interrupt lines are flagged in a bit field and SIGUSR1 is
+ * raised, so threads outside the scheduler (device models, I/O threads) can
+ * interrupt the running task like a peripheral would.  All threads other than
+ * the running task keep both signals masked.
+ *----------------------------------------------------------*/
+
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <time.h>
+#include <unistd.h>
+
+/* Scheduler includes. */
+#include "FreeRTOS.h"
+#include "task.h"
+
+#define portSIG_TICK						SIGALRM
+#define portSIG_INTERRUPT					SIGUSR1
+
+/* Host stack given to each task thread.  The FreeRTOS stack of the task is
+not used for execution, only to hold the thread descriptor, so the stack
+depths passed to xTaskCreate() still account for the same heap as on the
+target. */
+#define portTHREAD_STACK_SIZE				( 512 * 1024 )
+
+/* Ticks processed at once when the host could not deliver the timer signal
+on time, so the tick count keeps up with the wall clock. */
+#define portMAX_TICKS_CATCH_UP				( 100 )
+
+/* Thread descriptor of a task, pointed to by the top of its stack. */
+typedef struct xTHREAD
+{
+	pthread_t xThread;
+	pthread_mutex_t xMutex;
+	pthread_cond_t xCond;
+	BaseType_t xResume;
+	BaseType_t xDying;
+	UBaseType_t uxCriticalNesting;
+	TaskFunction_t pxCode;
+	void *pvParameters;
+} Thread_t;
+
+/* Each task maintains its own interrupt status in the critical nesting
+variable.  The value is not zero until the first task starts, so the thread
+that starts the scheduler never unmasks the signals. */
+static UBaseType_t uxCriticalNesting = 0xaaaaaaaa;
+
+/* Signals that stand for the interrupts. */
+static sigset_t xInterruptSignals;
+
+/* Simulated interrupt lines. */
+static void ( *pvInterruptHandlers[ portMAX_INTERRUPTS ] )( void );
+static volatile uint32_t ulPendingInterrupts = 0;
+
+/* Set while an interrupt handler runs, and when a handler asked for a context
+switch on exit. */
+static BaseType_t xInsideInterrupt = pdFALSE;
+static BaseType_t xSwitchRequired = pdFALSE;
+
+/* Interrupts held off by vPortHoldInterrupts() on this thread, and the
+signals that came in meanwhile. */
+static __thread volatile sig_atomic_t xHoldDepth = 0;
+static __thread volatile sig_atomic_t xHeldTick = pdFALSE;
+static __thread volatile sig_atomic_t xHeldInterrupt = pdFALSE;
+
+static volatile BaseType_t xSchedulerStarted = pdFALSE;
+static pthread_mutex_t xSchedulerEndMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t xSchedulerEndCond = PTHREAD_COND_INITIALIZER;
+static BaseType_t xSchedulerEnded = pdFALSE;
+
+/* Wall clock reference of the tick count. */
+static struct timespec xTickStartTime;
+static uint64_t ullTicksProcessed = 0;
+
+/*
+ * Thread of a task, stored at the top of its stack by pxPortInitialiseStack().
+ * pxTopOfStack is the first member of the TCB and is never changed by this
+ * port.
+ */
+static Thread_t *prvGetThreadFromTask( void *pxTCB );
+
+/*
+ * Thread entry, waits to be scheduled for the first time.
+ */
+static void *prvThreadEntry( void *pvParameters );
+
+/*
+ * Block the calling thread until it is resumed, and end it if its task was
+ * deleted in the meantime.
+ */
+static void prvSuspendSelf( Thread_t *pxThread );
+static void prvResumeThread( Thread_t *pxThread );
+
+/*
+ * Select the next task and hand the processor to its thread.
+ */
+static void prvSwitchContext( void );
+
+/*
+ * Handler of the tick and simulated interrupt signals.
+ */
+static void prvSignalHandler( int iSignal );
+static void prvProcessTicks( void );
+
+/*
+ * Used to catch tasks that attempt to return from their implementing function.
+ */
+static void prvTaskExitError( void );
+
+/*-----------------------------------------------------------*/
+
+static Thread_t *prvGetThreadFromTask( void *pxTCB )
+{
+StackType_t *pxTopOfStack = *( StackType_t ** ) pxTCB;
+
+	return *( Thread_t ** ) pxTopOfStack;
+}
+/*-----------------------------------------------------------*/
+
+static void prvTaskExitError( void )
+{
+	/* A function that implements a task must not exit or attempt to return to
+	its caller as there is nothing to return to.  If a task wants to exit it
+	should instead call vTaskDelete( NULL ). */
+	configASSERT( uxCriticalNesting == ~0UL );
+	vTaskDelete( NULL );
+}
+/*-----------------------------------------------------------*/
+
+static void *prvThreadEntry( void *pvParameters )
+{
+Thread_t *pxThread = ( Thread_t * ) pvParameters;
+
+	prvSuspendSelf( pxThread );
+
+	/* Tasks start with interrupts enabled. */
+	vPortEnableInterrupts();
+	pxThread->pxCode( pxThread->pvParameters );
+	prvTaskExitError();
+
+	return NULL;
+}
+/*-----------------------------------------------------------*/
+
+static void prvSuspendSelf( Thread_t *pxThread )
+{
+	pthread_mutex_lock( &pxThread->xMutex );
+	while( pxThread->xResume == pdFALSE )
+	{
+		pthread_cond_wait( &pxThread->xCond, &pxThread->xMutex );
+	}
+	pxThread->xResume = pdFALSE;
+	pthread_mutex_unlock( &pxThread->xMutex );
+
+	if( pxThread->xDying != pdFALSE )
+	{
+		/* The TCB was freed, vPortCleanUpTCB() waits for the thread to end. */
+		pthread_exit( NULL );
+	}
+
+	uxCriticalNesting = pxThread->uxCriticalNesting;
+}
+/*-----------------------------------------------------------*/
+
+static void prvResumeThread( Thread_t *pxThread )
+{
+	pthread_mutex_lock( &pxThread->xMutex );
+	pxThread->xResume = pdTRUE;
+	pthread_cond_signal( &pxThread->xCond );
+	pthread_mutex_unlock( &pxThread->xMutex );
+}
+/*-----------------------------------------------------------*/
+
+static void prvSwitchContext( void )
+{
+Thread_t *pxPrevious, *pxNext;
+
+	/* Called with the signals masked. */
+	pxPrevious = prvGetThreadFromTask( xTaskGetCurrentTaskHandle() );
+	vTaskSwitchContext();
+	pxNext = prvGetThreadFromTask( xTaskGetCurrentTaskHandle() );
+
+	if( pxNext != pxPrevious )
+	{
+		pxPrevious->uxCriticalNesting = uxCriticalNesting;
+		prvResumeThread( pxNext );
+		prvSuspendSelf( pxPrevious );
+	}
+}
+/*-----------------------------------------------------------*/
+
+/*
+ * See header file for description.
+ */
+StackType_t *pxPortInitialiseStack( StackType_t *pxTopOfStack, TaskFunction_t pxCode, void *pvParameters )
+{
+Thread_t *pxThread;
+pthread_attr_t xAttr;
+sigset_t xThreadMask, xPreviousMask;
+int iResult;
+
+	/* Room for the thread descriptor pointer, keeping the stack aligned. */
+	pxTopOfStack -= ( sizeof( Thread_t * ) + portBYTE_ALIGNMENT - 1 ) / portBYTE_ALIGNMENT * ( portBYTE_ALIGNMENT / sizeof( StackType_t ) );
+
+	pxThread = ( Thread_t * ) malloc( sizeof( Thread_t ) );
+	configASSERT( pxThread != NULL );
+	memset( pxThread, 0, sizeof( Thread_t ) );
+	pthread_mutex_init( &pxThread->xMutex, NULL );
+	pthread_cond_init( &pxThread->xCond, NULL );
+	pxThread->pxCode = pxCode;
+	pxThread->pvParameters = pvParameters;
+	*( Thread_t ** ) pxTopOfStack = pxThread;
+
+	/* The thread inherits the signal mask of its creator, so it is created
+	with the interrupt signals masked and only unmasks them once scheduled.
+	Faults stay deliverable. */
+	pthread_sigmask( SIG_SETMASK, NULL, &xPreviousMask );
+	xThreadMask = xPreviousMask;
+	sigaddset( &xThreadMask, portSIG_TICK );
+	sigaddset( &xThreadMask, portSIG_INTERRUPT );
+	pthread_sigmask( SIG_SETMASK, &xThreadMask, NULL );
+
+	pthread_attr_init( &xAttr );
+	pthread_attr_setstacksize( &xAttr, portTHREAD_STACK_SIZE );
+	iResult = pthread_create( &pxThread->xThread, &xAttr, prvThreadEntry, pxThread );
+	pthread_attr_destroy( &xAttr );
+
+	pthread_sigmask( SIG_SETMASK, &xPreviousMask, NULL );
+	configASSERT( iResult == 0 );
+	( void ) iResult;
+
+	return pxTopOfStack;
+}
+/*-----------------------------------------------------------*/
+
+/*
+ * See header file for description.
+ */
+BaseType_t xPortStartScheduler( void )
+{
+struct sigaction xAction;
+struct itimerval xTimer;
+
+	sigemptyset( &xInterruptSignals );
+	sigaddset( &xInterruptSignals, portSIG_TICK );
+	sigaddset( &xInterruptSignals, portSIG_INTERRUPT );
+
+	/* This thread never runs a task, the signals stay masked here. */
+	pthread_sigmask( SIG_BLOCK, &xInterruptSignals, NULL );
+
+	/* Interrupts do not nest: both signals are masked while either handler
+	runs. */
+	memset( &xAction, 0, sizeof( xAction ) );
+	xAction.sa_handler = prvSignalHandler;
+	xAction.sa_mask = xInterruptSignals;
+	xAction.sa_flags = SA_RESTART;
+	sigaction( portSIG_TICK, &xAction, NULL );
+	sigaction( portSIG_INTERRUPT, &xAction, NULL );
+
+	/* Start the tick. */
+	clock_gettime( CLOCK_MONOTONIC, &xTickStartTime );
+	ullTicksProcessed = 0;
+	xTimer.it_interval.tv_sec = 0;
+	xTimer.it_interval.tv_usec = 1000000L / configTICK_RATE_HZ;
+	xTimer.it_value = xTimer.it_interval;
+	setitimer( ITIMER_REAL, &xTimer, NULL );
+
+	/* Start the first task. */
+	__atomic_store_n( &xSchedulerStarted, pdTRUE, __ATOMIC_SEQ_CST );
+	prvResumeThread( prvGetThreadFromTask( xTaskGetCurrentTaskHandle() ) );
+
+	/* Interrupts raised before the scheduler started. */
+	if( __atomic_load_n( &ulPendingInterrupts, __ATOMIC_SEQ_CST ) != 0 )
+	{
+		kill( getpid(), portSIG_INTERRUPT );
+	}
+
+	pthread_mutex_lock( &xSchedulerEndMutex );
+	while( xSchedulerEnded == pdFALSE )
+	{
+		pthread_cond_wait( &xSchedulerEndCond, &xSchedulerEndMutex );
+	}
+	pthread_mutex_unlock( &xSchedulerEndMutex );
+
+	return 0;
+}
+/*-----------------------------------------------------------*/
+
+void vPortEndScheduler( void )
+{
+struct itimerval xTimer;
+
+	memset( &xTimer, 0, sizeof( xTimer ) );
+	setitimer( ITIMER_REAL, &xTimer, NULL );
+
+	/* Tasks threads are left blocked, the thread that started the scheduler
+	returns from vTaskStartScheduler(). */
+	pthread_mutex_lock( &xSchedulerEndMutex );
+	xSchedulerEnded = pdTRUE;
+	pthread_cond_signal( &xSchedulerEndCond );
+	pthread_mutex_unlock( &xSchedulerEndMutex );
+
+	vPortDisableInterrupts();
+	for( ;; )
+	{
+		pause();
+	}
+}
+/*-----------------------------------------------------------*/
+
+void vPortYield( void )
+{
+	vPortEnterCritical();
+	prvSwitchContext();
+	vPortExitCritical();
+}
+/*-----------------------------------------------------------*/
+
+void vPortYieldFromISR( void )
+{
+	if( xInsideInterrupt != pdFALSE )
+	{
+		/* The switch happens when the handler exits. */
+		xSwitchRequired = pdTRUE;
+	}
+	else
+	{
+		vPortYield();
+	}
+}
+/*-----------------------------------------------------------*/
+
+void vPortDisableInterrupts( void )
+{
+	pthread_sigmask( SIG_BLOCK, &xInterruptSignals, NULL );
+}
+/*-----------------------------------------------------------*/
+
+void vPortEnableInterrupts( void )
+{
+	pthread_sigmask( SIG_UNBLOCK, &xInterruptSignals, NULL );
+}
+/*-----------------------------------------------------------*/
+
+UBaseType_t uxPortSetInterruptMask( void )
+{
+sigset_t xPreviousMask;
+
+	pthread_sigmask( SIG_BLOCK, &xInterruptSignals, &xPreviousMask );
+	return ( UBaseType_t ) sigismember( &xPreviousMask, portSIG_TICK );
+}
+/*-----------------------------------------------------------*/
+
+void vPortClearInterruptMask( UBaseType_t uxMask )
+{
+	if( uxMask == 0 )
+	{
+		vPortEnableInterrupts();
+	}
+}
+/*-----------------------------------------------------------*/
+
+void vPortEnterCritical( void )
+{
+	vPortDisableInterrupts();
+	uxCriticalNesting++;
+
+	/* This is not the interrupt safe version of the enter critical function so
+	assert() if it is being called from an interrupt context.  Only assert if
+	the critical nesting count is 1 to protect against recursive calls if the
+	assert function also uses a critical section. */
+	if( uxCriticalNesting == 1 )
+	{
+		configASSERT( xInsideInterrupt == pdFALSE );
+	}
+}
+/*-----------------------------------------------------------*/
+
+void vPortExitCritical( void )
+{
+	configASSERT( uxCriticalNesting );
+	uxCriticalNesting--;
+	if( uxCriticalNesting == 0 )
+	{
+		/* Interrupts raised in the critical section are taken now. */
+		vPortEnableInterrupts();
+	}
+}
+/*-----------------------------------------------------------*/
+
+BaseType_t xPortIsInsideInterrupt( void )
+{
+	return xInsideInterrupt;
+}
+/*-----------------------------------------------------------*/
+
+static void prvProcessTicks( void )
+{
+struct timespec xNow;
+uint64_t ullElapsedTicks;
+uint32_t ulCount = 0;
+
+	/* Timer signals do not queue, so the ticks are counted from the wall
+	clock to make up for the signals merged while the host was busy or the
+	interrupts were masked. */
+	clock_gettime( CLOCK_MONOTONIC, &xNow );
+	ullElapsedTicks = ( ( uint64_t ) ( xNow.tv_sec - xTickStartTime.tv_sec ) * 1000000000ULL +
+		( uint64_t ) xNow.tv_nsec - ( uint64_t ) xTickStartTime.tv_nsec ) / ( 1000000000ULL / configTICK_RATE_HZ );
+
+	while( ( ullTicksProcessed < ullElapsedTicks ) && ( ulCount < portMAX_TICKS_CATCH_UP ) )
+	{
+		if( xTaskIncrementTick() != pdFALSE )
+		{
+			xSwitchRequired = pdTRUE;
+		}
+		ullTicksProcessed++;
+		ulCount++;
+	}
+
+	/* Give up on a backlog the host will never make up (process stopped in
+	a debugger...). */
+	if( ullTicksProcessed < ullElapsedTicks )
+	{
+		ullTicksProcessed = ullElapsedTicks;
+	}
+}
+/*-----------------------------------------------------------*/
+
+static void prvSignalHandler( int iSignal )
+{
+int iSavedErrno = errno;
+uint32_t ulPending, ulLine;
+
+	if( xHoldDepth != 0 )
+	{
+		/* Taken again by vPortReleaseInterrupts(). */
+		if( iSignal == portSIG_TICK )
+		{
+			xHeldTick = pdTRUE;
+		}
+		else
+		{
+			xHeldInterrupt = pdTRUE;
+		}
+		return;
+	}
+
+	/* Only the running task has the signals unmasked, so the handler runs on
+	its thread, with both signals masked. */
+	uxCriticalNesting++;
+	xInsideInterrupt = pdTRUE;
+
+	if( iSignal == portSIG_TICK )
+	{
+		prvProcessTicks();
+	}
+
+	/* A pending line is serviced by whichever signal comes first. */
+	while( ( ulPending = __atomic_exchange_n( &ulPendingInterrupts, 0, __ATOMIC_SEQ_CST ) ) != 0 )
+	{
+		for( ulLine = 0; ulLine < portMAX_INTERRUPTS; ulLine++ )
+		{
+			if( ( ( ulPending & ( 1UL << ulLine ) ) != 0 ) && ( pvInterruptHandlers[ ulLine ] != NULL ) )
+			{
+				pvInterruptHandlers[ ulLine ]();
+			}
+		}
+	}
+
+	xInsideInterrupt = pdFALSE;
+	uxCriticalNesting--;
+
+	if( xSwitchRequired != pdFALSE )
+	{
+		xSwitchRequired = pdFALSE;
+		prvSwitchContext();
+	}
+
+	errno = iSavedErrno;
+}
+/*-----------------------------------------------------------*/
+
+void vPortHoldInterrupts( void )
+{
+	xHoldDepth++;
+}
+/*-----------------------------------------------------------*/
+
+void vPortReleaseInterrupts( void )
+{
+	configASSERT( xHoldDepth );
+	if( --xHoldDepth == 0 )
+	{
+		/* A signal directed at the thread is delivered before pthread_kill()
+		returns unless the thread masks it, then once it unmasks it. */
+		if( xHeldTick != pdFALSE )
+		{
+			xHeldTick = pdFALSE;
+			pthread_kill( pthread_self(), portSIG_TICK );
+		}
+		if( xHeldInterrupt != pdFALSE )
+		{
+			xHeldInterrupt = pdFALSE;
+			pthread_kill( pthread_self(), portSIG_INTERRUPT );
+		}
+	}
+}
+/*-----------------------------------------------------------*/
+
+void vPortSetInterruptHandler( uint32_t ulInterruptNumber, void ( *pvHandler )( void ) )
+{
+	configASSERT( ulInterruptNumber < portMAX_INTERRUPTS );
+	pvInterruptHandlers[ ulInterruptNumber ] = pvHandler;
+}
+/*-----------------------------------------------------------*/
+
+void vPortGenerateSimulatedInterrupt( uint32_t ulInterruptNumber )
+{
+	configASSERT( ulInterruptNumber < portMAX_INTERRUPTS );
+	__atomic_fetch_or( &ulPendingInterrupts, 1UL << ulInterruptNumber, __ATOMIC_SEQ_CST );
+
+	/* Before the scheduler starts the line stays pending, it is serviced
+	once the first task runs. */
+	if( __atomic_load_n( &xSchedulerStarted, __ATOMIC_SEQ_CST ) != pdFALSE )
+	{
+		kill( getpid(), portSIG_INTERRUPT );
+	}
+}
+/*-----------------------------------------------------------*/
+
+void vPortSuppressTicksAndSleep( TickType_t xExpectedIdleTime )
+{
+sigset_t xPreviousMask;
+
+	( void ) xExpectedIdleTime;
+
+	/* The tick is not stopped, the host timer costs nothing while the process
+	sleeps.  The signals are masked so no interrupt is missed between the
+	check and the wait, sigsuspend() then unmasks them atomically, like WFI
+	with PRIMASK set. */
+	pthread_sigmask( SIG_BLOCK, &xInterruptSignals, &xPreviousMask );
+	if( eTaskConfirmSleepModeStatus() != eAbortSleep )
+	{
+		sigsuspend( &xPreviousMask );
+	}
+	pthread_sigmask( SIG_SETMASK, &xPreviousMask, NULL );
+}
+/*-----------------------------------------------------------*/
+
+void vPortCleanUpTCB( void *pxTCB )
+{
+Thread_t *pxThread = prvGetThreadFromTask( pxTCB );
+
+	/* The thread of the deleted task is blocked in prvSuspendSelf(), wake it
+	up so it ends, then release its descriptor. */
+	pthread_mutex_lock( &pxThread->xMutex );
+	pxThread->xDying = pdTRUE;
+	pxThread->xResume = pdTRUE;
+	pthread_cond_signal( &pxThread->xCond );
+	pthread_mutex_unlock( &pxThread->xMutex );
+
+	pthread_join( pxThread->xThread, NULL );
+	pthread_cond_destroy( &pxThread->xCond );
+	pthread_mutex_destroy( &pxThread->xMutex );
+	free( pxThread );
+}
+/*-----------------------------------------------------------*/
+
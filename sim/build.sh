@@ -0,0 +1,105 @@
+#!/bin/sh
+# build.sh
+# Builds the Linux simulation of the firmware (sim/build/daq-sim): every source
+# of the IAR project, except the KSDK drivers, the Cortex-M port of FreeRTOS and
+# the Ethernet MAC driver that the simulated peripherals replace, plus sim/*.c
+#
+#   sim/build.sh            build
+#   sim/build.sh clean      remove sim/build
+#
+# CC, CFLAGS_EXTRA and JOBS can be set in the environment.
+set -e
+
+cd "$(dirname "$0")/.."
+OUT=sim/build
+CC=${CC:-gcc}
+JOBS=${JOBS:-$(nproc 2>/dev/null || echo 2)}
+
+if [ "$1" = "clean" ]; then
+	rm -rf "$OUT"
+	exit 0
+fi
+
+# Source list of the Debug configuration of the IAR project
+SOURCES=$(awk '
+	/<file>/ { name = ""; excluded = 0 }
+	/<name>.*\.c<\/name>/ { name = $0; sub(/.*<name>\$PROJ_DIR\$\\\.\.\\/, "", name); sub(/<\/name>.*/, "", name); gsub(/\\/, "/", name) }
+	/<configuration>Debug<\/configuration>/ { excluded = 1 }
+	/<\/file>/ { if (name != "" && !excluded) print name }
+' iar/FRDM-K66F-DAQ.ewp | grep -v \
+	-e '^devices/MK66F18/drivers/' \
+	-e '^devices/MK66F18/utilities/' \
+	-e '^rtos/freertos_9.0.0/Source/portable/IAR/' \
+	-e '^tcp stack/cyclone_tcp/drivers/mk6x_eth\.c$' \
+	-e '^board\.c$' \
+	-e '^clock_config\.c$' \
+	-e '^retarget\.c$')
+SOURCES="$SOURCES
+rtos/freertos_9.0.0/Source/portable/GCC/Posix/port.c
+$(ls sim/*.c)"
+
+# Same defines and include paths as the IAR project, the simulation headers
+# first so they shadow the target ones
+CFLAGS="-std=gnu99 -g -O1 -funsigned-char -fno-strict-aliasing -fcommon -fno-pie -pthread
+	-ffunction-sections -fdata-sections
+	-Wall -Wno-unused -Wno-pointer-sign -Wno-char-subscripts -Wno-missing-braces
+	-Wno-int-to-pointer-cast
+	-include sim/include/sim_target.h
+	-DSDK_OS_FREE_RTOS -DFSL_RTOS_FREE_RTOS -DCPU_MK66FN2M0VLQ18 -DUSE_FRDM_K66F -DMK66F18
+	-DEVAL_LICENSE_TERMS_ACCEPTED -DHAVE_CONFIG_H -DHAVE_STDINT_H
+	$CFLAGS_EXTRA"
+INCLUDES="sim/include
+rtos/freertos_9.0.0/Source/portable/GCC/Posix
+rtos/freertos_9.0.0/Source/portable/MemMang
+rtos/freertos_9.0.0/Source
+rtos/freertos_9.0.0/Source/include
+devices/MK66F18/drivers
+CMSIS/Include
+devices/MK66F18
+devices/MK66F18/utilities
+.
+tcp stack/common
+tcp stack/cyclone_crypto
+tcp stack/cyclone_tcp
+cJSON-1.7.7"
+
+mkdir -p "$OUT"
+: > "$OUT/objects"
+echo "$SOURCES" | while IFS= read -r src; do
+	[ -n "$src" ] || continue
+	obj="$OUT/obj/$(echo "$src" | sed 's/ /_/g; s/\.c$/.o/')"
+	echo "$obj" >> "$OUT/objects"
+	printf '%s\t%s\n' "$src" "$obj"
+done > "$OUT/sources"
+
+# Any header change rebuilds everything, otherwise only the sources newer than
+# their object
+if [ -f "$OUT/headers.stamp" ] && [ -n "$(find . -name '*.h' -newer "$OUT/headers.stamp" | head -1)" ]; then
+	rm -rf "$OUT/obj"
+fi
+touch "$OUT/headers.stamp"
+
+# Compile in parallel
+export CC CFLAGS INCLUDES
+tr '\n' '\0' < "$OUT/sources" | xargs -0 -P "$JOBS" -n 1 sh -c '
+	src=$(printf "%s" "$1" | cut -f1)
+	obj=$(printf "%s" "$1" | cut -f2)
+	[ -f "$obj" ] && [ "$obj" -nt "$src" ] && exit 0
+	mkdir -p "$(dirname "$obj")"
+	set -f
+	set --
+	IFS="
+"
+	for i in $INCLUDES; do set -- "$@" "-iquote$i"; done
+	unset IFS
+	[ "$src" = "main.c" ] && set -- "$@" -Dmain=SIM_FirmwareMain
+	echo "CC $src"
+	$CC $CFLAGS "$@" -c "$src" -o "$obj"
+' sh
+
+# The allocator and the console of the firmware go through sim_cpu.c, the
+# unused code of the project (as the IAR linker drops it) is left out
+tr '\n' '\0' < "$OUT/objects" | xargs -0 $CC -no-pie -pthread -o "$OUT/daq-sim" -Wl,--gc-sections \
+	-Wl,--wrap=malloc,--wrap=free,--wrap=calloc,--wrap=realloc \
+	-Wl,--wrap=printf,--wrap=vprintf,--wrap=puts,--wrap=putchar -lm
+echo "$OUT/daq-sim"
@@ -0,0 +1,40 @@
+/* FreeRTOSConfig.h
+* Simulation build: the firmware configuration with the settings that only
+* make sense on the Cortex-M replaced for the FreeRTOS POSIX port
+*/
+#ifndef SIM_FREERTOS_CONFIG_H
+#define SIM_FREERTOS_CONFIG_H
+
+#include "../../FreeRTOSConfig.h"
+
+/* the idle task sleeps until the next tick or interrupt instead of spinning */
+#undef configUSE_TICKLESS_IDLE
+#define configUSE_TICKLESS_IDLE 1
+
+/* TCBs, queues and lists hold 64-bit pointers on the host */
+#undef configTOTAL_HEAP_SIZE
+#define configTOTAL_HEAP_SIZE ((size_t)(96*1024))
+
+/* the run time counter counts target cycles from the host monotonic clock */
+extern uint32_t SIM_GetCycleCount(void);
+#undef portCONFIGURE_TIMER_FOR_RUN_TIME_STATS
+#define portCONFIGURE_TIMER_FOR_RUN_TIME_STATS()
+#undef portGET_RUN_TIME_COUNTER_VALUE
+#define portGET_RUN_TIME_COUNTER_VALUE() SIM_GetCycleCount()
+
+/* counts the times each task is switched in, for the wake-up figures of
+* the benchmarks */
+extern void SIM_TaskSwitchedIn(void* task);
+#define traceTASK_SWITCHED_IN() SIM_TaskSwitchedIn(pxCurrentTCB)
+
+/* stop with a message instead of spinning */
+extern void SIM_AssertFailed(const char* file, int line);
+#undef configASSERT
+#define configASSERT(x) if((x) == 0) {SIM_AssertFailed(__FILE__, __LINE__);}
+
+/* the POSIX port has no SVC, PendSV or SysTick handler */
+#undef vPortSVCHandler
+#undef xPortPendSVHandler
+#undef xPortSysTickHandler
+
+#endif
@@ -0,0 +1,18 @@
+/* core_cm4.h
+* Simulation shadow of the CMSIS core header: the NVIC ISER/ICER registers are
+* write-one-to-set/clear, which plain memory cannot model, so enabling and
+* disabling an interrupt goes to the simulated interrupt controller
+*/
+#ifndef __SIM_CORE_CM4_H__
+#define __SIM_CORE_CM4_H__
+
+#define NVIC_EnableIRQ NVIC_EnableIRQ_Target
+#define NVIC_DisableIRQ NVIC_DisableIRQ_Target
+#include "../../CMSIS/Include/core_cm4.h"
+#undef NVIC_EnableIRQ
+#undef NVIC_DisableIRQ
+
+void NVIC_EnableIRQ(IRQn_Type IRQn);
+void NVIC_DisableIRQ(IRQn_Type IRQn);
+
+#endif
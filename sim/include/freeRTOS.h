@@ -0,0 +1,5 @@
+/* freeRTOS.h
+* Case shim: the firmware includes freeRTOS.h, the file is FreeRTOS.h on a case
+* sensitive file system
+*/
+#include "FreeRTOS.h"
@@ -0,0 +1,25 @@
+/* fsl_edma.h
+* Simulation shadow of the KSDK eDMA header: the channel request controls are
+* inline register writes on the target, here they go to the eDMA model
+*/
+#ifndef __SIM_FSL_EDMA_H__
+#define __SIM_FSL_EDMA_H__
+
+#define EDMA_EnableChannelRequest EDMA_EnableChannelRequest_Target
+#define EDMA_DisableChannelRequest EDMA_DisableChannelRequest_Target
+#define EDMA_EnableAutoStopRequest EDMA_EnableAutoStopRequest_Target
+//The register addresses are 32-bit on the target, the simulated
+//peripherals are in the low 4 GB of the non-PIE binary
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpointer-to-int-cast"
+#include "../../devices/MK66F18/drivers/fsl_edma.h"
+#pragma GCC diagnostic pop
+#undef EDMA_EnableChannelRequest
+#undef EDMA_DisableChannelRequest
+#undef EDMA_EnableAutoStopRequest
+
+void EDMA_EnableChannelRequest(DMA_Type* base, uint32_t channel);
+void EDMA_DisableChannelRequest(DMA_Type* base, uint32_t channel);
+void EDMA_EnableAutoStopRequest(DMA_Type* base, uint32_t channel, bool enable);
+
+#endif
@@ -0,0 +1,27 @@
+/* fsl_gpio.h
+* Simulation shadow of the KSDK GPIO header: the pin accessors go to the
+* simulated ports, which follow the bit-banged I2C bus, the input multiplexer
+* and the keys
+*/
+#ifndef __SIM_FSL_GPIO_H__
+#define __SIM_FSL_GPIO_H__
+
+#define GPIO_WritePinOutput GPIO_WritePinOutput_Target
+#define GPIO_SetPinsOutput GPIO_SetPinsOutput_Target
+#define GPIO_ClearPinsOutput GPIO_ClearPinsOutput_Target
+#define GPIO_TogglePinsOutput GPIO_TogglePinsOutput_Target
+#define GPIO_ReadPinInput GPIO_ReadPinInput_Target
+#include "../../devices/MK66F18/drivers/fsl_gpio.h"
+#undef GPIO_WritePinOutput
+#undef GPIO_SetPinsOutput
+#undef GPIO_ClearPinsOutput
+#undef GPIO_TogglePinsOutput
+#undef GPIO_ReadPinInput
+
+void GPIO_WritePinOutput(GPIO_Type* base, uint32_t pin, uint8_t output);
+void GPIO_SetPinsOutput(GPIO_Type* base, uint32_t mask);
+void GPIO_ClearPinsOutput(GPIO_Type* base, uint32_t mask);
+void GPIO_TogglePinsOutput(GPIO_Type* base, uint32_t mask);
+uint32_t GPIO_ReadPinInput(GPIO_Type* base, uint32_t pin);
+
+#endif
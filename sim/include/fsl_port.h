@@ -0,0 +1,14 @@
+/* fsl_port.h
+* Simulation shadow of the KSDK PORT header: the pin control registers are
+* addressed as 32-bit integers, the simulated ports are in the low 4 GB of the
+* non-PIE binary
+*/
+#ifndef __SIM_FSL_PORT_H__
+#define __SIM_FSL_PORT_H__
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpointer-to-int-cast"
+#include "../../devices/MK66F18/drivers/fsl_port.h"
+#pragma GCC diagnostic pop
+
+#endif
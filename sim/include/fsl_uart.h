@@ -0,0 +1,22 @@
+/* fsl_uart.h
+* Simulation shadow of the KSDK UART header: reading the data register clears
+* the receive flags of the simulated UART
+*/
+#ifndef __SIM_FSL_UART_H__
+#define __SIM_FSL_UART_H__
+
+#define UART_WriteByte UART_WriteByte_Target
+#define UART_ReadByte UART_ReadByte_Target
+//The register addresses are 32-bit on the target, the simulated
+//peripherals are in the low 4 GB of the non-PIE binary
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpointer-to-int-cast"
+#include "../../devices/MK66F18/drivers/fsl_uart.h"
+#pragma GCC diagnostic pop
+#undef UART_WriteByte
+#undef UART_ReadByte
+
+void UART_WriteByte(UART_Type* base, uint8_t data);
+uint8_t UART_ReadByte(UART_Type* base);
+
+#endif
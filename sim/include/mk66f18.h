@@ -0,0 +1,5 @@
+/* mk66f18.h
+* Case shim: the firmware includes mk66f18.h, the file is MK66F18.h on a case
+* sensitive file system
+*/
+#include "MK66F18.h"
@@ -0,0 +1,5 @@
+/* modem_Interface.h
+* Case shim: the firmware includes modem_Interface.h, the file is modem_interface.h on a case
+* sensitive file system
+*/
+#include "modem_interface.h"
@@ -0,0 +1,86 @@
+/* sim_target.h
+* Forced into every file of the simulation build (gcc -include). Replaces the
+* Cortex-M intrinsics of cmsis_gcc.h with host versions, the rest of CMSIS and
+* the device header are used as they are
+*/
+#ifndef __SIM_TARGET_H__
+#define __SIM_TARGET_H__
+
+#include <stdint.h>
+/* the byte order header of the TCP stack has the same include guard as the
+* glibc one, so the C library headers that include it come first */
+#include <endian.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#undef _ENDIAN_H
+
+/* cmsis_gcc.h is skipped, core_cmInstr.h, core_cmFunc.h and core_cmSimd.h
+* include it for GCC */
+#define __CMSIS_GCC_H
+
+/* PRIMASK, backed by the signal mask of the FreeRTOS POSIX port */
+void SIM_DisableIrq(void);
+void SIM_EnableIrq(void);
+uint32_t SIM_GetPrimask(void);
+/* a write to SCB->AIRCR with SYSRESETREQ resets the simulated target */
+void SIM_DataSyncBarrier(void);
+void SIM_WaitForInterrupt(void);
+
+static inline void __enable_irq(void) { SIM_EnableIrq(); }
+static inline void __disable_irq(void) { SIM_DisableIrq(); }
+static inline uint32_t __get_PRIMASK(void) { return SIM_GetPrimask(); }
+static inline void __set_PRIMASK(uint32_t priMask) { if (priMask) SIM_DisableIrq(); else SIM_EnableIrq(); }
+static inline void __enable_fault_irq(void) { }
+static inline void __disable_fault_irq(void) { }
+static inline uint32_t __get_FAULTMASK(void) { return 0; }
+static inline void __set_FAULTMASK(uint32_t faultMask) { (void)faultMask; }
+static inline uint32_t __get_BASEPRI(void) { return 0; }
+static inline void __set_BASEPRI(uint32_t value) { (void)value; }
+static inline void __set_BASEPRI_MAX(uint32_t value) { (void)value; }
+static inline uint32_t __get_CONTROL(void) { return 0; }
+static inline void __set_CONTROL(uint32_t control) { (void)control; }
+static inline uint32_t __get_IPSR(void) { return 0; }
+static inline uint32_t __get_APSR(void) { return 0; }
+static inline uint32_t __get_xPSR(void) { return 0; }
+static inline uint32_t __get_PSP(void) { return 0; }
+static inline void __set_PSP(uint32_t topOfProcStack) { (void)topOfProcStack; }
+static inline uint32_t __get_MSP(void) { return 0; }
+static inline void __set_MSP(uint32_t topOfMainStack) { (void)topOfMainStack; }
+static inline uint32_t __get_FPSCR(void) { return 0; }
+static inline void __set_FPSCR(uint32_t fpscr) { (void)fpscr; }
+
+static inline void __NOP(void) { __asm__ volatile ("nop"); }
+static inline void __WFI(void) { SIM_WaitForInterrupt(); }
+static inline void __WFE(void) { SIM_WaitForInterrupt(); }
+static inline void __SEV(void) { }
+static inline void __ISB(void) { __sync_synchronize(); }
+static inline void __DSB(void) { __sync_synchronize(); SIM_DataSyncBarrier(); }
+static inline void __DMB(void) { __sync_synchronize(); }
+static inline void __CLREX(void) { }
+#define __BKPT(value) __builtin_trap()
+
+static inline uint32_t __REV(uint32_t value) { return __builtin_bswap32(value); }
+static inline uint32_t __REV16(uint32_t value) { return ((value & 0xFF00FF00u) >> 8) | ((value & 0x00FF00FFu) << 8); }
+static inline int32_t __REVSH(int32_t value) { return (int16_t)__builtin_bswap16((uint16_t)value); }
+static inline uint32_t __ROR(uint32_t op1, uint32_t op2) { op2 &= 31u; return op2 ? (op1 >> op2) | (op1 << (32u - op2)) : op1; }
+static inline uint32_t __RBIT(uint32_t value)
+{
+	uint32_t result = 0;
+	int i;
+	for (i = 0; i < 32; i++, value >>= 1)
+		result = (result << 1) | (value & 1u);
+	return result;
+}
+#define __CLZ(value) ((uint8_t)((value) ? __builtin_clz(value) : 32))
+
+/* exclusive accesses always succeed, only one task runs at a time */
+static inline uint8_t __LDREXB(volatile uint8_t* addr) { return *addr; }
+static inline uint16_t __LDREXH(volatile uint16_t* addr) { return *addr; }
+static inline uint32_t __LDREXW(volatile uint32_t* addr) { return *addr; }
+static inline uint32_t __STREXB(uint8_t value, volatile uint8_t* addr) { *addr = value; return 0; }
+static inline uint32_t __STREXH(uint16_t value, volatile uint16_t* addr) { *addr = value; return 0; }
+static inline uint32_t __STREXW(uint32_t value, volatile uint32_t* addr) { *addr = value; return 0; }
+
+#endif
@@ -0,0 +1,178 @@
+/* sim.h
+* Internals of the Linux simulation of the firmware, shared by the simulated
+* peripherals, the scenario engine and the startup code
+*/
+#ifndef __SIM_H__
+#define __SIM_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* interrupt lines of the FreeRTOS POSIX port */
+#define SIM_IRQ_UART1			0	/* modem */
+#define SIM_IRQ_UART3			1	/* RS-485 Modbus bus */
+#define SIM_IRQ_UART4			2	/* RS-485 door bus */
+#define SIM_IRQ_ENET			3
+#define SIM_IRQ_REQUEST			4	/* wakes the SIM task for the scenario engine */
+#define SIM_IRQ_DMA0			5	/* eDMA channels 0 to 3 */
+#define SIM_IRQ_COUNT			(SIM_IRQ_DMA0 + SIM_EDMA_CHANNELS)
+#define SIM_EDMA_CHANNELS		4
+
+#define SIM_CORE_CLOCK			180000000UL
+#define SIM_BUS_CLOCK			60000000UL
+
+/* uncached time since the start of the simulation */
+uint64_t SIM_Now(void);
+void SIM_SleepUntil(uint64_t ns);
+void SIM_SleepFor(uint64_t ns);
+#define SIM_MS(milliseconds)	((uint64_t)(milliseconds) * 1000000ULL)
+#define SIM_US(us)				((uint64_t)(us) * 1000ULL)
+
+/* the simulation output goes to stdout, the firmware console to stderr */
+void SIM_Log(const char* format, ...) __attribute__((format(printf, 1, 2)));
+void SIM_Fatal(const char* format, ...) __attribute__((format(printf, 1, 2), noreturn));
+void SIM_Exit(int code) __attribute__((noreturn));
+
+/* Device state is shared by the task threads, the interrupt handlers (which
+* run on the thread of the interrupted task) and the device threads, the lock
+* keeps the interrupts off while it is held so a handler never waits for the
+* task it interrupted. It nests */
+void SIM_Lock(void);
+void SIM_Unlock(void);
+/* host threads (main and the device threads) never run as a FreeRTOS task */
+void SIM_SetHostThread(void);
+bool SIM_IsHostThread(void);
+/* the main thread runs main() of the firmware, its output is the console */
+void SIM_EnterFirmware(void);
+int SIM_StartThread(void* (*entry)(void*), void* param);
+
+/* cpu: interrupt lines, halt and SIM task */
+void SIM_CpuInit(void);
+void SIM_RaiseIrq(uint32_t line);
+void SIM_CreateTask(void);
+/* runs a function on the SIM task, the highest priority task, and waits */
+void SIM_RunOnTarget(void (*function)(void*), void* param);
+bool SIM_TargetStarted(void);
+bool SIM_TargetStopped(void);
+void SIM_SampleTasks(void);
+void SIM_ReportTasks(void);
+uint32_t SIM_TaskSwitches(void* task);
+
+/* gpio */
+void SIM_GpioInit(void);
+void SIM_SetDigitalInput(uint32_t channel, uint8_t state);
+void SIM_SetKey(uint32_t key, bool pressed);
+uint32_t SIM_GetLedToggles(void);
+
+/* bit-banged I2C bus and its devices */
+void SIM_I2cBusChanged(bool scl, bool sda);
+bool SIM_I2cSdaDrive(void);
+int SIM_EepromOpen(const char* path);
+void SIM_RtcSet(int year, int month, int date, int hour, int min, int sec);
+void SIM_Am2320Set(int16_t temperature, uint16_t humidity);
+void SIM_Am2320SetOnline(bool online);
+void SIM_I2cReport(void);
+
+/* uarts: 0 modem (UART1), 1 Modbus (UART3), 2 door (UART4) */
+#define SIM_UART_MODEM			0
+#define SIM_UART_MODBUS			1
+#define SIM_UART_DOOR			2
+#define SIM_UART_COUNT			3
+typedef void (*SimUartTxHook)(uint32_t uart, const uint8_t* data, size_t length);
+void SIM_UartInit(void);
+void SIM_UartSetTxHook(uint32_t uart, SimUartTxHook hook);
+/* paced at the configured baud rate, blocks the caller until the last byte */
+void SIM_UartReceive(uint32_t uart, const uint8_t* data, size_t length);
+void SIM_UartIsr(uint32_t uart);
+void SIM_UartService(void);
+void SIM_UartReport(void);
+
+/* eDMA channels 0 to 3 behind the DMAMUX, a peripheral request runs one
+* minor loop of the channel routed to the source, false when none is */
+bool SIM_EdmaRequest(uint32_t source);
+void SIM_EdmaIsr(uint32_t channel);
+void SIM_EdmaReport(void);
+
+/* Modbus slaves on the RS-485 bus, their CRC is computed bit by bit so it
+* does not share the table of the firmware */
+uint16_t SIM_Crc16Modbus(const uint8_t* data, size_t length);
+void SIM_ModbusInit(void);
+bool SIM_ModbusSetReg(uint8_t slave, uint16_t reg, uint16_t value);
+bool SIM_ModbusSetOnline(uint8_t slave, bool online);
+bool SIM_ModbusSetDelay(uint8_t slave, uint32_t delayMs);
+void SIM_ModbusReport(void);
+
+/* GPRS modem on UART1, AT commands then the PPP peer of the network */
+void SIM_ModemInit(void);
+void SIM_ModemPins(bool supply, bool key);
+void SIM_ModemSetOnline(bool online);
+void SIM_ModemSetDelay(uint32_t delayMs);
+void SIM_ModemSetRegisterDelay(uint32_t delayMs);
+void SIM_ModemSetSignal(int rssi);
+bool SIM_ModemHangup(void);
+uint32_t SIM_ModemPower(void);
+uint32_t SIM_ModemNetworkUp(void);
+uint32_t SIM_ModemPingsReceived(void);
+bool SIM_ModemPing(uint32_t count, uint32_t size);
+void SIM_ModemSetVj(bool enabled);
+void SIM_ModemSetLatency(uint32_t milliseconds);
+void SIM_ModemSetLoss(uint32_t permille);
+int SIM_ModemOpenTun(const char* name);
+void SIM_ModemReport(void);
+
+/* VJ TCP/IP header compression of the modem (RFC 1144) */
+#define SIM_PPP_IP				0x0021
+#define SIM_PPP_VJ_COMP			0x002D
+#define SIM_PPP_VJ_UNCOMP		0x002F
+#define SIM_VJ_SLOTS			16
+#define SIM_VJ_HEADER			128
+typedef struct {
+	uint8_t header[SIM_VJ_HEADER];
+	size_t length;
+	bool valid;
+} SimVjSlot_t;
+typedef struct {
+	SimVjSlot_t tx[SIM_VJ_SLOTS];
+	uint32_t txSlots;
+	uint32_t txNext;
+	uint32_t txLast;
+	bool txCompSlot;
+	SimVjSlot_t rx[SIM_VJ_SLOTS];
+	uint32_t rxLast;
+	bool rxToss;
+	uint64_t txTcp, txCompressed, txSaved;
+	uint64_t rxCompressed, rxUncompressed, rxErrors, rxSaved;
+} SimVj_t;
+void SIM_VjInit(SimVj_t* vj, uint32_t maxSlotId, bool compSlot);
+uint16_t SIM_VjCompress(SimVj_t* vj, uint8_t* packet, size_t* length);
+size_t SIM_VjDecompress(SimVj_t* vj, uint16_t protocol, const uint8_t* in, size_t length, uint8_t* out, size_t size);
+void SIM_VjLost(SimVj_t* vj);
+
+/* adc, flash */
+void SIM_AdcSet(uint32_t instance, uint32_t channel, uint16_t value);
+int SIM_FlashMap(const char* path);
+void SIM_FlashReport(void);
+
+/* Ethernet MAC, KSZ8081 PHY and TAP interface */
+int SIM_EthOpenTap(const char* name);
+int SIM_EthOpenPcap(const char* path);
+void SIM_EthSetLink(bool up);
+void SIM_EthSetServer(bool online);
+void SIM_EthSetServerDelay(uint32_t delayMs);
+void SIM_EthIsr(void);
+void SIM_EthReport(void);
+
+/* scenarios */
+int SIM_ScenarioStart(const char* path, uint32_t durationMs);
+void SIM_ScenarioReport(void);
+int SIM_ScenarioResult(void);
+void SIM_ScenarioCheck(bool passed, int64_t value, const char* format, ...) __attribute__((format(printf, 3, 4)));
+/* export of the packet capture of a NetInterface, checked like a benchmark */
+struct _NetInterface;
+void SIM_CaptureCheck(struct _NetInterface* interface, const char* name, const char* op, int64_t expected);
+
+/* benchmarks and soak tests of the stack modules, false on bad arguments */
+bool SIM_Bench(char** argv, int argc);
+
+#endif
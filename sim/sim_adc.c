@@ -0,0 +1,71 @@
+/* sim_adc.c
+* ADC0 and ADC1 with software triggered conversions that complete at once,
+* each channel reads the value the scenario set (mid scale by default)
+*/
+#include "fsl_adc16.h"
+#include "sim.h"
+
+#define SIM_ADC_INSTANCES		2
+#define SIM_ADC_CHANNELS		32
+
+static uint16_t values[SIM_ADC_INSTANCES][SIM_ADC_CHANNELS];
+static bool valueSet[SIM_ADC_INSTANCES][SIM_ADC_CHANNELS];
+
+static int SIM_AdcInstance(ADC_Type* base)
+{
+	if (base == ADC0)
+		return 0;
+	if (base == ADC1)
+		return 1;
+	return -1;
+}
+
+void ADC16_GetDefaultConfig(adc16_config_t* config)
+{
+	memset(config, 0, sizeof(*config));
+	config->referenceVoltageSource = kADC16_ReferenceVoltageSourceVref;
+	config->clockSource = kADC16_ClockSourceAsynchronousClock;
+	config->clockDivider = kADC16_ClockDivider8;
+	config->resolution = kADC16_ResolutionSE12Bit;
+	config->longSampleMode = kADC16_LongSampleDisabled;
+}
+
+void ADC16_Init(ADC_Type* base, const adc16_config_t* config)
+{
+	(void)config;
+	base->SC1[0] = ADC_SC1_ADCH_MASK;
+}
+
+status_t ADC16_DoAutoCalibration(ADC_Type* base)
+{
+	(void)base;
+	return kStatus_Success;
+}
+
+void ADC16_SetChannelConfig(ADC_Type* base, uint32_t channelGroup, const adc16_channel_config_t* config)
+{
+	int instance = SIM_AdcInstance(base);
+	uint32_t channel = config->channelNumber & (SIM_ADC_CHANNELS - 1);
+	uint16_t value = 0x800;
+	SIM_Lock();
+	if ((instance >= 0) && valueSet[instance][channel])
+		value = values[instance][channel];
+	*(volatile uint32_t*)&base->R[channelGroup] = value;
+	base->SC1[channelGroup] = ADC_SC1_ADCH(channel) | ADC_SC1_COCO_MASK;
+	SIM_Unlock();
+}
+
+uint32_t ADC16_GetChannelStatusFlags(ADC_Type* base, uint32_t channelGroup)
+{
+	return (base->SC1[channelGroup] & ADC_SC1_COCO_MASK) ? kADC16_ChannelConversionDoneFlag : 0;
+}
+
+void SIM_AdcSet(uint32_t instance, uint32_t channel, uint16_t value)
+{
+	if ((instance >= SIM_ADC_INSTANCES) || (channel >= SIM_ADC_CHANNELS))
+		return;
+	SIM_Lock();
+	values[instance][channel] = value & 0xFFF;
+	valueSet[instance][channel] = true;
+	SIM_Unlock();
+}
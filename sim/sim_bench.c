@@ -0,0 +1,2396 @@
+/* sim_bench.c
+* Benchmarks and soak tests of the stack modules, for the "bench" scenario
+* command. The work runs on the SIM task, the highest priority task, so the
+* other tasks wait while it is measured, unless it blocks on the stack like
+* the TCP transfer; the results are printed and checked from the scenario
+* thread. The times are host times: they compare the implementations and
+* catch regressions, they are not target cycle counts
+*/
+#include "core/net.h"
+#include "core/net_mem.h"
+#include "core/ip.h"
+#include "core/net_timer.h"
+#include "core/net_capture.h"
+#include "core/tcp_misc.h"
+#include "ipv4/ipv4_frag.h"
+#include "ppp/ppp.h"
+#include "ppp/ppp_hdlc.h"
+#include "crc.h"
+#include "oid.h"
+#include "snmp/snmp_agent.h"
+#include "snmp/snmp_agent_misc.h"
+#include "snmp/snmp_usm.h"
+#include "hmac.h"
+#include "private_mib_impl.h"
+#include "snmp_key_cache.h"
+#include "variables.h"
+#include "eeprom_rtc.h"
+#include "i2c_lock.h"
+/* a unit of the delays of eeprom_rtc.h */
+#undef ms
+#include "FreeRTOS.h"
+#include "task.h"
+/* after the stack headers, see sim_eth.c */
+#include <stdlib.h>
+#include "sim.h"
+
+#define SIM_BENCH_MEM_SLOTS		24
+#define SIM_BENCH_CHECKSUM_SIZE	1600
+#define SIM_BENCH_CHECKSUM_BYTES	(64UL << 20)
+#define SIM_BENCH_CHUNKS		4
+#define SIM_BENCH_TCP_PORT		5001
+#define SIM_BENCH_TCP_TIMEOUT_MS	120000
+#define SIM_BENCH_TCP_BLOCK		1024
+#define SIM_BENCH_TIMERS_PORT	5101
+#define SIM_BENCH_TIMERS_COUNT	64
+#define SIM_BENCH_DEMUX_SOCKETS	64
+#define SIM_BENCH_DEMUX_TARGETS	(SIM_BENCH_DEMUX_SOCKETS + 8)
+#define SIM_BENCH_FRAG_PORT		5201
+#define SIM_BENCH_FRAG_GROUP	4
+#define SIM_BENCH_FRAG_CASES	5
+#define SIM_BENCH_FRAG_MAX		(SIM_BENCH_FRAG_GROUP * 40)
+#define SIM_BENCH_HDLC_MAX		(2 * PPP_MAX_FRAME_SIZE + 2)
+#define SIM_BENCH_CRC_SIZE		1460
+#define SIM_BENCH_CRC_ROUNDS	20000
+#define SIM_BENCH_USM_SLOT		(SNMP_KEY_CACHE_SIZE - 1)
+#define SIM_BENCH_USM_PDU		200
+#define SIM_BENCH_USM_AUTH_OFFSET	60
+#define SIM_BENCH_USM_MAC_SIZE	12
+#define SIM_BENCH_USM_EEPROM_WRITE_MS	20
+#define SIM_BENCH_SNAPSHOT_READERS	8
+#define SIM_BENCH_MIB_STEPS		2048
+#define SIM_BENCH_MIB_OID		64
+#define SIM_BENCH_CAPTURE_FRAME	1000
+#define SIM_BENCH_CAPTURE_PORT	5301
+#define SIM_BENCH_SNAPSHOT_WORDS	(sizeof(PrivateMibBase) / sizeof(uint32_t))
+
+typedef struct {
+	uint32_t pairs;
+	uint64_t poolNs[NET_MEM_POOL_CLASS_COUNT];
+	uint64_t fullNs[NET_MEM_POOL_CLASS_COUNT];
+	uint64_t heapNs[NET_MEM_POOL_CLASS_COUNT];
+	size_t blockSize[NET_MEM_POOL_CLASS_COUNT];
+	uint32_t failures;
+} SimBenchMem_t;
+
+typedef struct {
+	uint32_t operations;
+	uint32_t seed;
+	uint64_t ns;
+	uint32_t allocations;
+	uint32_t exhausted;
+	uint32_t corrupted;
+	uint32_t leaked;
+	uint32_t lost;
+	uint32_t duplicated;
+	uint32_t peak[NET_MEM_POOL_CLASS_COUNT];
+} SimBenchMemSoak_t;
+
+typedef struct {
+	uint32_t cases;
+	uint32_t seed;
+	uint32_t errors[5];
+	double mbps[3][4];
+} SimBenchChecksum_t;
+
+typedef struct {
+	uint32_t bytes;
+	uint32_t minRate;
+	error_t error;
+	uint32_t received;
+	uint32_t corrupted;
+	uint64_t connectNs;
+	uint64_t transferNs;
+} SimBenchTcp_t;
+
+typedef struct {
+	Socket* sockets[SOCKET_MAX_COUNT];
+	uint32_t armed;
+	NetTimer timers[SIM_BENCH_TIMERS_COUNT];
+	uint32_t sampled;
+	uint32_t switches;
+	uint32_t cycles;
+} SimBenchTimers_t;
+
+/* one segment or datagram of the demux bench and the socket it belongs to */
+typedef struct {
+	NetInterface* interface;
+	IpPseudoHeader pseudoHeader;
+	TcpHeader header;
+	Socket* socket;
+} SimBenchDemuxTarget_t;
+
+typedef struct {
+	uint32_t lookups;
+	uint32_t sockets;
+	uint32_t live;
+	uint32_t mismatches;
+	double hashNs[3];
+	double scanNs[3];
+} SimBenchDemux_t;
+
+/* datagrams of <size> payload bytes cut into fragments of <mtu> bytes,
+* <interleaved> at a time with their fragments shuffled together */
+typedef struct {
+	uint16_t size;
+	uint16_t mtu;
+	uint16_t interleaved;
+	bool evicting;
+} SimBenchFragCase_t;
+
+typedef struct {
+	uint16_t datagram;
+	uint16_t first;
+	uint16_t last;
+} SimBenchFragment_t;
+
+typedef struct {
+	uint32_t datagrams;
+	uint32_t seed;
+	uint32_t completed[SIM_BENCH_FRAG_CASES];
+	uint32_t corrupted[SIM_BENCH_FRAG_CASES];
+	uint32_t leaked[SIM_BENCH_FRAG_CASES];
+	size_t fragPeak[SIM_BENCH_FRAG_CASES];
+	size_t poolPeak[SIM_BENCH_FRAG_CASES];
+	uint64_t ns[SIM_BENCH_FRAG_CASES];
+} SimBenchFrag_t;
+
+typedef struct {
+	uint32_t frames;
+	uint32_t seed;
+	uint32_t mismatches;
+	uint32_t delivered;
+	uint32_t corrupted;
+	uint32_t flipped;
+	uint32_t flippedDelivered;
+	uint32_t inErrors;
+	uint32_t txWrapped;
+	uint32_t rxWrapped;
+	double mbps[2][4];
+} SimBenchHdlc_t;
+
+/* what one reader of the snapshot bench saw */
+typedef struct {
+	uint32_t reads;
+	uint32_t groupReads;
+	uint32_t torn;
+	uint32_t backwards;
+	uint32_t versions;
+} SimBenchSnapshotReader_t;
+
+typedef struct {
+	uint32_t ms;
+	uint32_t readers;
+	uint32_t published;
+	SimBenchSnapshotReader_t reader[SIM_BENCH_SNAPSHOT_READERS];
+	SimBenchSnapshotReader_t unprotected;
+} SimBenchSnapshot_t;
+
+/* an OID returned by GetNext */
+typedef struct {
+	uint8_t oid[SIM_BENCH_MIB_OID];
+	size_t oidLen;
+} SimBenchMibStep_t;
+
+typedef struct {
+	uint32_t walks;
+	uint32_t seed;
+	uint32_t lookups;
+	uint32_t objects;
+	uint32_t steps;
+	uint32_t unordered;
+	uint32_t endErrors;
+	uint32_t mismatches;
+	uint32_t lookupMismatches;
+	uint64_t oldNs;
+	uint64_t newNs;
+} SimBenchMib_t;
+
+/* CRC-32, FCS-16, Modbus CRC-16, CRC-8 */
+typedef struct {
+	uint32_t cases;
+	uint32_t seed;
+	uint32_t check[4];
+	uint32_t mismatches[4];
+	double mbps[4][2];
+} SimBenchCrc_t;
+
+typedef struct {
+	uint32_t pdus;
+	uint32_t seed;
+	error_t coldError;
+	error_t cachedError;
+	error_t outError;
+	error_t inError;
+	error_t tamperedError;
+	bool keysDiffer;
+	bool macDiffers;
+	uint32_t slotChanged;
+	uint64_t localizeNs;
+	uint64_t coldNs;
+	uint64_t cachedNs;
+	uint64_t padsNs;
+	uint64_t hmacNs;
+} SimBenchUsm_t;
+
+/* disabled, kept, dropped by the port filter, other interface; received, sent */
+typedef struct {
+	uint32_t packets;
+	error_t error;
+	double ns[4][2];
+} SimBenchCapture_t;
+
+/* a multi-part buffer of up to SIM_BENCH_CHUNKS chunks */
+typedef struct {
+	uint_t chunkCount;
+	uint_t maxChunkCount;
+	ChunkDesc chunk[SIM_BENCH_CHUNKS];
+} SimBenchBuffer_t;
+
+static const size_t checksumSizes[3] = {20, 256, 1460};
+static const char* const checksumKernels[4] = {"byte pairs", "ipCalcChecksum", "memcpy + ipCalcChecksum",
+												"ipCopyChecksum"};
+static const char* const checksumChecks[5] = {"ipCalcChecksum", "ipCalcChecksumEx", "ipCopyChecksum",
+											   "ipCopyChecksumToBuffer", "ipCopyChecksumFromBuffer"};
+static const char* const crcNames[4] = {"CRC-32", "FCS-16", "CRC-16/MODBUS", "CRC-8"};
+static const uint32_t crcChecks[4] = {0xCBF43926, 0x906E, 0x4B37, 0xF4};
+static const char* const captureCases[4] = {"disabled", "kept", "port filtered", "other interface"};
+static uint32_t benchRandom;
+static uint32_t benchExpired;
+
+extern SnmpAgentContext snmpAgentContext;
+
+/* xorshift32, the runs repeat for a given seed */
+static uint32_t SIM_BenchRandom(void)
+{
+	benchRandom ^= benchRandom << 13;
+	benchRandom ^= benchRandom >> 17;
+	benchRandom ^= benchRandom << 5;
+	return benchRandom;
+}
+
+static long SIM_BenchNumber(const char* token, long fallback)
+{
+	char* end;
+	long value;
+	if (token == NULL)
+		return fallback;
+	value = strtol(token, &end, 0);
+	return (*end == '\0') ? value : -1;
+}
+
+/*=============================== memory pool ==================================*/
+
+/* takes the free blocks of a class but the last ones, the block size is
+* served by the class while it has some */
+static uint32_t SIM_BenchMemTake(uint32_t c, void** blocks, uint32_t keep)
+{
+	MemPoolStats stats;
+	uint32_t count = 0;
+	uint32_t usage;
+	void* p;
+	memPoolGetStats(c, &stats);
+	for (usage = stats.currentUsage; usage + keep < stats.blockCount; usage = stats.currentUsage)
+	{
+		p = memPoolAlloc(stats.blockSize);
+		memPoolGetStats(c, &stats);
+		if (stats.currentUsage == usage)
+		{
+			/* served by a larger class */
+			if (p != NULL)
+				memPoolFree(p);
+			break;
+		}
+		blocks[count++] = p;
+	}
+	return count;
+}
+
+static uint64_t SIM_BenchMemPairs(size_t size, uint32_t pairs, uint32_t* failures)
+{
+	uint64_t start = SIM_Now();
+	uint32_t i;
+	void* p;
+	for (i = 0; i < pairs; i++)
+	{
+		p = memPoolAlloc(size);
+		if (p == NULL)
+			(*failures)++;
+		else
+			memPoolFree(p);
+	}
+	return SIM_Now() - start;
+}
+
+/* alloc/free pairs of one block of each class with the class unused and with
+* a single block left, then from the heap */
+static void SIM_BenchMemRun(void* param)
+{
+	SimBenchMem_t* bench = param;
+	MemPoolStats stats;
+	void* blocks[NET_MEM_POOL_BUFFER_COUNT + NET_MEM_POOL_SMALL_BUFFER_COUNT + NET_MEM_POOL_MEDIUM_BUFFER_COUNT];
+	uint64_t start;
+	uint32_t i, c, n;
+	void* p;
+	for (c = 0; c < NET_MEM_POOL_CLASS_COUNT; c++)
+	{
+		memPoolGetStats(c, &stats);
+		bench->blockSize[c] = stats.blockSize;
+		bench->poolNs[c] = SIM_BenchMemPairs(stats.blockSize, bench->pairs, &bench->failures);
+		n = SIM_BenchMemTake(c, blocks, 1);
+		bench->fullNs[c] = SIM_BenchMemPairs(stats.blockSize, bench->pairs, &bench->failures);
+		while (n > 0)
+			memPoolFree(blocks[--n]);
+		start = SIM_Now();
+		for (i = 0; i < bench->pairs; i++)
+		{
+			p = osAllocMem(stats.blockSize);
+			if (p == NULL)
+				bench->failures++;
+			else
+				osFreeMem(p);
+		}
+		bench->heapNs[c] = SIM_Now() - start;
+	}
+}
+
+static bool SIM_BenchMem(char** argv, int argc)
+{
+	SimBenchMem_t bench = {0};
+	uint32_t c;
+	bench.pairs = SIM_BenchNumber(argc > 1 ? argv[1] : NULL, 100000);
+	if ((argc > 2) || ((int32_t)bench.pairs <= 0))
+		return false;
+	SIM_RunOnTarget(SIM_BenchMemRun, &bench);
+	for (c = 0; c < NET_MEM_POOL_CLASS_COUNT; c++)
+	{
+		SIM_Log("bench mem: %4u B blocks  pool %6.1f ns, %6.1f ns with one block left  heap %6.1f ns per alloc/free",
+				(unsigned)bench.blockSize[c], (double)bench.poolNs[c] / bench.pairs,
+				(double)bench.fullNs[c] / bench.pairs, (double)bench.heapNs[c] / bench.pairs);
+		/* constant time: no slower with the class used up, with room for noise */
+		SIM_ScenarioCheck(bench.fullNs[c] < 2 * bench.poolNs[c], bench.fullNs[c] * 100 / bench.poolNs[c],
+						  "mem: %u B one left / unused < 200%%", (unsigned)bench.blockSize[c]);
+	}
+	SIM_ScenarioCheck(bench.failures == 0, bench.failures, "mem: failed allocations == 0");
+	return true;
+}
+
+/* The soak test holds up to SIM_BENCH_MEM_SLOTS blocks of random sizes, each
+* filled with its own pattern that is checked when it is freed. At the end
+* every class is drained: the blocks it gives must be all the free blocks of
+* the class, each once, so a lost or doubly linked block shows */
+static uint32_t SIM_BenchMemSoakClass(uint32_t c, uint32_t* duplicated)
+{
+	void* blocks[NET_MEM_POOL_BUFFER_COUNT + NET_MEM_POOL_SMALL_BUFFER_COUNT + NET_MEM_POOL_MEDIUM_BUFFER_COUNT];
+	uint32_t count, i;
+	count = SIM_BenchMemTake(c, blocks, 0);
+	for (i = 0; i < count; i++)
+		*(uint32_t*)blocks[i] = i;
+	for (i = 0; i < count; i++)
+	{
+		if (*(uint32_t*)blocks[i] != i)
+			(*duplicated)++;
+	}
+	for (i = 0; i < count; i++)
+		memPoolFree(blocks[i]);
+	return count;
+}
+
+static void SIM_BenchMemSoakRun(void* param)
+{
+	SimBenchMemSoak_t* bench = param;
+	struct {
+		uint8_t* p;
+		size_t size;
+		uint8_t pattern;
+	} slots[SIM_BENCH_MEM_SLOTS] = {0};
+	MemPoolStats before[NET_MEM_POOL_CLASS_COUNT];
+	MemPoolStats stats;
+	uint64_t start;
+	uint32_t i, c, n, r;
+	size_t k;
+	benchRandom = bench->seed ? bench->seed : 1;
+	for (c = 0; c < NET_MEM_POOL_CLASS_COUNT; c++)
+		memPoolGetStats(c, &before[c]);
+	start = SIM_Now();
+	for (i = 0; i < bench->operations; i++)
+	{
+		r = SIM_BenchRandom();
+		n = r % SIM_BENCH_MEM_SLOTS;
+		if (slots[n].p == NULL)
+		{
+			/* headers, small segments and full frames in equal parts */
+			switch ((r >> 8) % 3)
+			{
+			case 0:
+				slots[n].size = 1 + (r >> 12) % NET_MEM_POOL_SMALL_BUFFER_SIZE;
+				break;
+			case 1:
+				slots[n].size = 1 + (r >> 12) % NET_MEM_POOL_MEDIUM_BUFFER_SIZE;
+				break;
+			default:
+				slots[n].size = 1 + (r >> 12) % NET_MEM_POOL_BUFFER_SIZE;
+				break;
+			}
+			slots[n].p = memPoolAlloc(slots[n].size);
+			if (slots[n].p == NULL)
+			{
+				bench->exhausted++;
+				continue;
+			}
+			slots[n].pattern = (uint8_t)(r >> 24);
+			memset(slots[n].p, slots[n].pattern, slots[n].size);
+			bench->allocations++;
+		}
+		else
+		{
+			for (k = 0; k < slots[n].size; k++)
+			{
+				if (slots[n].p[k] != slots[n].pattern)
+				{
+					bench->corrupted++;
+					break;
+				}
+			}
+			memPoolFree(slots[n].p);
+			slots[n].p = NULL;
+		}
+	}
+	for (n = 0; n < SIM_BENCH_MEM_SLOTS; n++)
+	{
+		if (slots[n].p != NULL)
+			memPoolFree(slots[n].p);
+	}
+	bench->ns = SIM_Now() - start;
+	for (c = 0; c < NET_MEM_POOL_CLASS_COUNT; c++)
+	{
+		memPoolGetStats(c, &stats);
+		bench->peak[c] = stats.maxUsage;
+		if (stats.currentUsage != before[c].currentUsage)
+			bench->leaked++;
+		if (SIM_BenchMemSoakClass(c, &bench->duplicated) != stats.blockCount - stats.currentUsage)
+			bench->lost++;
+	}
+}
+
+static bool SIM_BenchMemSoak(char** argv, int argc)
+{
+	SimBenchMemSoak_t bench = {0};
+	bench.operations = SIM_BenchNumber(argc > 1 ? argv[1] : NULL, 1000000);
+	bench.seed = SIM_BenchNumber(argc > 2 ? argv[2] : NULL, 1);
+	if ((argc > 3) || ((int32_t)bench.operations <= 0))
+		return false;
+	SIM_RunOnTarget(SIM_BenchMemSoakRun, &bench);
+	SIM_Log("bench memsoak: %u operations in %.1f ms, %u allocations, %u refused, high-water marks %u/%u/%u",
+			(unsigned)bench.operations, bench.ns / 1e6, (unsigned)bench.allocations, (unsigned)bench.exhausted,
+			(unsigned)bench.peak[0], (unsigned)bench.peak[1], (unsigned)bench.peak[2]);
+	SIM_ScenarioCheck(bench.corrupted == 0, bench.corrupted, "memsoak: overwritten blocks == 0");
+	SIM_ScenarioCheck(bench.leaked == 0, bench.leaked, "memsoak: classes with blocks left in use == 0");
+	SIM_ScenarioCheck(bench.lost + bench.duplicated == 0, bench.lost + bench.duplicated,
+					  "memsoak: classes with lost or repeated blocks == 0");
+	return true;
+}
+
+/*================================== checksum ==================================*/
+
+/* RFC 1071 over big-endian 16-bit words, one byte pair at a time */
+static uint16_t SIM_BenchSum(const uint8_t* data, size_t length)
+{
+	uint32_t sum = 0;
+	size_t i;
+	for (i = 0; i + 1 < length; i += 2)
+		sum += (data[i] << 8) | data[i + 1];
+	if (length & 1)
+		sum += data[length - 1] << 8;
+	while (sum >> 16)
+		sum = (sum & 0xFFFF) + (sum >> 16);
+	return (uint16_t)sum;
+}
+
+/* the stack sums words in memory order, 0 and 0xFFFF are both zero */
+static bool SIM_BenchSumEqual(uint16_t stackSum, uint16_t sum)
+{
+	stackSum = ntohs(stackSum);
+	return (stackSum == sum) || ((stackSum % 0xFFFF) == 0 && (sum % 0xFFFF) == 0);
+}
+
+/* splits a flat area into a multi-part buffer at random points */
+static void SIM_BenchSplit(SimBenchBuffer_t* buffer, uint8_t* data, size_t length)
+{
+	size_t n;
+	buffer->maxChunkCount = SIM_BENCH_CHUNKS;
+	for (buffer->chunkCount = 0; buffer->chunkCount < SIM_BENCH_CHUNKS; buffer->chunkCount++)
+	{
+		n = (buffer->chunkCount + 1 < SIM_BENCH_CHUNKS) ? SIM_BenchRandom() % (length + 1) : length;
+		buffer->chunk[buffer->chunkCount].address = data;
+		buffer->chunk[buffer->chunkCount].length = n;
+		buffer->chunk[buffer->chunkCount].size = 0;
+		data += n;
+		length -= n;
+	}
+}
+
+static void SIM_BenchChecksumRun(void* param)
+{
+	static uint8_t src[SIM_BENCH_CHECKSUM_SIZE + 8];
+	static uint8_t dest[SIM_BENCH_CHECKSUM_SIZE + 8];
+	static uint8_t copy[SIM_BENCH_CHECKSUM_SIZE + 8];
+	SimBenchChecksum_t* bench = param;
+	SimBenchBuffer_t buffer;
+	volatile uint16_t sink = 0;
+	uint64_t start;
+	size_t length, offset, size, i, n, rounds;
+	uint16_t sum;
+	uint32_t k;
+	benchRandom = bench->seed ? bench->seed : 1;
+	/* random lengths, alignments and chunk splits against the byte pair sum */
+	for (k = 0; k < bench->cases; k++)
+	{
+		for (i = 0; i < sizeof(src); i++)
+			src[i] = (uint8_t)SIM_BenchRandom();
+		offset = SIM_BenchRandom() % 8;
+		length = SIM_BenchRandom() % (SIM_BENCH_CHECKSUM_SIZE + 1);
+		sum = SIM_BenchSum(src + offset, length);
+		if (!SIM_BenchSumEqual(ipCalcChecksum(src + offset, length), sum ^ 0xFFFF))
+			bench->errors[0]++;
+		SIM_BenchSplit(&buffer, src + offset, length);
+		n = SIM_BenchRandom() % (length + 1);
+		if (!SIM_BenchSumEqual(ipCalcChecksumEx((NetBuffer*)&buffer, n, length - n),
+							   SIM_BenchSum(src + offset + n, length - n) ^ 0xFFFF))
+			bench->errors[1]++;
+		n = SIM_BenchRandom() % 8;
+		if (!SIM_BenchSumEqual(ipCopyChecksum(dest + n, src + offset, length), sum) ||
+			memcmp(dest + n, src + offset, length))
+			bench->errors[2]++;
+		SIM_BenchSplit(&buffer, dest + n, length);
+		if (!SIM_BenchSumEqual(ipCopyChecksumToBuffer((NetBuffer*)&buffer, 0, src + offset, length), sum) ||
+			memcmp(dest + n, src + offset, length))
+			bench->errors[3]++;
+		SIM_BenchSplit(&buffer, src + offset, length);
+		if (!SIM_BenchSumEqual(ipCopyChecksumFromBuffer(copy + n, (NetBuffer*)&buffer, 0, length), sum) ||
+			memcmp(copy + n, src + offset, length))
+			bench->errors[4]++;
+	}
+	/* throughput of each kernel over SIM_BENCH_CHECKSUM_BYTES */
+	for (i = 0; i < 3; i++)
+	{
+		size = checksumSizes[i];
+		rounds = SIM_BENCH_CHECKSUM_BYTES / size;
+		for (k = 0; k < 4; k++)
+		{
+			start = SIM_Now();
+			for (n = 0; n < rounds; n++)
+			{
+				switch (k)
+				{
+				case 0:
+					sink += SIM_BenchSum(src, size);
+					break;
+				case 1:
+					sink += ipCalcChecksum(src, size);
+					break;
+				case 2:
+					memcpy(dest, src, size);
+					sink += ipCalcChecksum(dest, size);
+					break;
+				default:
+					sink += ipCopyChecksum(dest, src, size);
+					break;
+				}
+			}
+			bench->mbps[i][k] = (double)(rounds * size) / ((SIM_Now() - start) / 1e3);
+		}
+	}
+}
+
+static bool SIM_BenchChecksum(char** argv, int argc)
+{
+	SimBenchChecksum_t bench = {0};
+	uint32_t i;
+	bench.cases = SIM_BenchNumber(argc > 1 ? argv[1] : NULL, 100000);
+	bench.seed = SIM_BenchNumber(argc > 2 ? argv[2] : NULL, 1);
+	if ((argc > 3) || ((int32_t)bench.cases < 0))
+		return false;
+	SIM_RunOnTarget(SIM_BenchChecksumRun, &bench);
+	for (i = 0; i < 3; i++)
+	{
+		SIM_Log("bench checksum: %4u B  %s %6.0f MB/s  %s %6.0f MB/s  %s %6.0f MB/s  %s %6.0f MB/s",
+				(unsigned)checksumSizes[i], checksumKernels[0], bench.mbps[i][0], checksumKernels[1],
+				bench.mbps[i][1], checksumKernels[2], bench.mbps[i][2], checksumKernels[3], bench.mbps[i][3]);
+	}
+	for (i = 0; i < 5; i++)
+		SIM_ScenarioCheck(bench.errors[i] == 0, bench.errors[i], "checksum: %s mismatches == 0", checksumChecks[i]);
+	/* the word-wise kernel against the byte pair loop it replaced */
+	SIM_ScenarioCheck(bench.mbps[2][1] > bench.mbps[2][0], bench.mbps[2][1] * 100 / bench.mbps[2][0],
+					  "checksum: 1460 B ipCalcChecksum / byte pairs > 100%%");
+	return true;
+}
+
+/*===================================== TCP ====================================*/
+
+/* byte k of the stream, a prime period shows a segment in the wrong place */
+static uint8_t SIM_BenchTcpByte(uint32_t k)
+{
+	return (uint8_t)(k % 251);
+}
+
+/* connects a socket to a listener of its own through the reflector of the
+* modem and streams the bytes across, both sockets served from this task */
+static void SIM_BenchTcpRun(void* param)
+{
+	static uint8_t data[SIM_BENCH_TCP_BLOCK];
+	SimBenchTcp_t* bench = param;
+	/* the modem interface, see modem_interface.c */
+	NetInterface* interface = &netInterface[1];
+	Socket* listener = socketOpen(SOCKET_TYPE_STREAM, SOCKET_IP_PROTO_TCP);
+	Socket* client = socketOpen(SOCKET_TYPE_STREAM, SOCKET_IP_PROTO_TCP);
+	Socket* server = NULL;
+	SocketEventDesc events[2];
+	IpAddr address;
+	uint32_t sent = 0;
+	uint64_t start;
+	size_t n, i;
+	bool progress;
+	if ((listener == NULL) || (client == NULL))
+	{
+		bench->error = ERROR_OUT_OF_RESOURCES;
+		goto end;
+	}
+	socketBindToInterface(listener, interface);
+	socketBind(listener, &IP_ADDR_ANY, SIM_BENCH_TCP_PORT);
+	socketListen(listener, 1);
+	socketSetTimeout(listener, SIM_BENCH_TCP_TIMEOUT_MS);
+	socketBindToInterface(client, interface);
+	socketSetTimeout(client, 0);
+	address.length = sizeof(Ipv4Addr);
+	address.ipv4Addr = IPV4_ADDR(10, 64, 64, 9);
+	/* the listener answers the SYN once accepted, so the connect only sends
+	* it and the handshake completes after the accept */
+	start = SIM_Now();
+	bench->error = socketConnect(client, &address, SIM_BENCH_TCP_PORT);
+	if (bench->error != ERROR_TIMEOUT)
+		goto end;
+	server = socketAccept(listener, NULL, NULL);
+	events[0].socket = client;
+	events[0].eventMask = SOCKET_EVENT_CONNECTED;
+	if ((server == NULL) || socketPoll(events, 1, NULL, SIM_BENCH_TCP_TIMEOUT_MS))
+		goto end;
+	bench->error = NO_ERROR;
+	bench->connectNs = SIM_Now() - start;
+	start = SIM_Now();
+	while ((bench->received < bench->bytes) && (SIM_Now() - start < SIM_MS(SIM_BENCH_TCP_TIMEOUT_MS)))
+	{
+		progress = false;
+		if (sent < bench->bytes)
+		{
+			n = MIN(sizeof(data), bench->bytes - sent);
+			for (i = 0; i < n; i++)
+				data[i] = SIM_BenchTcpByte(sent + i);
+			socketSend(client, data, n, &n, 0);
+			sent += n;
+			progress |= (n != 0);
+		}
+		socketReceive(server, data, sizeof(data), &n, SOCKET_FLAG_DONT_WAIT);
+		for (i = 0; i < n; i++)
+			bench->corrupted += (data[i] != SIM_BenchTcpByte(bench->received + i));
+		bench->received += n;
+		progress |= (n != 0);
+		if (progress)
+			continue;
+		events[0].socket = server;
+		events[0].eventMask = SOCKET_EVENT_RX_READY;
+		events[1].socket = client;
+		events[1].eventMask = SOCKET_EVENT_TX_READY;
+		socketPoll(events, (sent < bench->bytes) ? 2 : 1, NULL, 100);
+	}
+	bench->transferNs = SIM_Now() - start;
+end:
+	if (server != NULL)
+		socketClose(server);
+	if (client != NULL)
+		socketClose(client);
+	if (listener != NULL)
+		socketClose(listener);
+}
+
+static bool SIM_BenchTcp(char** argv, int argc)
+{
+	SimBenchTcp_t bench = {0};
+	bench.bytes = SIM_BenchNumber(argc > 1 ? argv[1] : NULL, 64) * 1024;
+	bench.minRate = SIM_BenchNumber(argc > 2 ? argv[2] : NULL, 0);
+	if ((argc > 3) || (bench.bytes == 0))
+		return false;
+	SIM_RunOnTarget(SIM_BenchTcpRun, &bench);
+	if (bench.error)
+	{
+		SIM_ScenarioCheck(false, bench.error, "tcp: connection through the reflector");
+		return true;
+	}
+	SIM_Log("bench tcp: %u of %u bytes in %.2f s, %.0f B/s, connect %.0f ms", (unsigned)bench.received,
+			(unsigned)bench.bytes, bench.transferNs / 1e9, bench.received / (bench.transferNs / 1e9),
+			bench.connectNs / 1e6);
+	SIM_ScenarioCheck(bench.received == bench.bytes, bench.received, "tcp: bytes received == %u",
+					  (unsigned)bench.bytes);
+	SIM_ScenarioCheck(bench.corrupted == 0, bench.corrupted, "tcp: corrupted bytes == 0");
+	if (bench.minRate != 0)
+	{
+		SIM_ScenarioCheck(bench.received / (bench.transferNs / 1e9) >= bench.minRate,
+						  (int64_t)(bench.received / (bench.transferNs / 1e9)), "tcp: B/s >= %u",
+						  (unsigned)bench.minRate);
+	}
+	return true;
+}
+
+/*=================================== timers ===================================*/
+
+/* netTask counters: times switched in, which is at least once per wake-up,
+* and its run time */
+static void SIM_BenchTimersSample(void* param)
+{
+	SimBenchTimers_t* bench = param;
+	TaskStatus_t status;
+	vTaskGetInfo(netTaskHandle, &status, pdFALSE, eInvalid);
+	bench->switches = SIM_TaskSwitches(netTaskHandle);
+	bench->cycles = status.ulRunTimeCounter;
+	bench->sampled = benchExpired;
+}
+
+/* every free socket sends a SYN to an address nobody answers, so each one
+* keeps a retransmission timer armed on the wheel */
+static void SIM_BenchTimersOpen(void* param)
+{
+	SimBenchTimers_t* bench = param;
+	IpAddr address;
+	uint32_t i;
+	address.length = sizeof(Ipv4Addr);
+	address.ipv4Addr = IPV4_ADDR(10, 64, 64, 10);
+	for (i = 0; i < SOCKET_MAX_COUNT; i++)
+	{
+		bench->sockets[i] = socketOpen(SOCKET_TYPE_STREAM, SOCKET_IP_PROTO_TCP);
+		if (bench->sockets[i] == NULL)
+			break;
+		socketBindToInterface(bench->sockets[i], &netInterface[1]);
+		socketSetTimeout(bench->sockets[i], 0);
+		if (socketConnect(bench->sockets[i], &address, SIM_BENCH_TIMERS_PORT + i) == ERROR_TIMEOUT)
+			bench->armed++;
+	}
+}
+
+static void SIM_BenchTimersClose(void* param)
+{
+	SimBenchTimers_t* bench = param;
+	uint32_t i;
+	for (i = 0; (i < SOCKET_MAX_COUNT) && (bench->sockets[i] != NULL); i++)
+		socketClose(bench->sockets[i]);
+}
+
+/* a retransmission of a busy connection, due again after a 1-3 s RTO */
+static void SIM_BenchTimersExpired(void* param)
+{
+	benchExpired++;
+	netTimerStart(param, 1000 + SIM_BenchRandom() % 2000);
+}
+
+/* the socket table holds SOCKET_MAX_COUNT sockets, the timers of more
+* connections with data in flight go on the wheel directly */
+static void SIM_BenchTimersStart(void* param)
+{
+	SimBenchTimers_t* bench = param;
+	uint32_t i;
+	benchRandom = 1;
+	osAcquireMutex(&netMutex);
+	for (i = 0; i < SIM_BENCH_TIMERS_COUNT; i++)
+	{
+		netTimerInit(&bench->timers[i], SIM_BenchTimersExpired, &bench->timers[i]);
+		netTimerStart(&bench->timers[i], 1000 + SIM_BenchRandom() % 2000);
+	}
+	osReleaseMutex(&netMutex);
+}
+
+static void SIM_BenchTimersStop(void* param)
+{
+	SimBenchTimers_t* bench = param;
+	uint32_t i;
+	osAcquireMutex(&netMutex);
+	for (i = 0; i < SIM_BENCH_TIMERS_COUNT; i++)
+		netTimerStop(&bench->timers[i]);
+	osReleaseMutex(&netMutex);
+}
+
+/* wake-ups per minute and run time of netTask over the window, and the
+* expirations of the bench timers */
+static double SIM_BenchTimersWindow(SimBenchTimers_t* bench, uint32_t ms, const char* name, uint32_t* expired)
+{
+	uint32_t switches, cycles;
+	double minutes = ms / 60000.0;
+	SIM_RunOnTarget(SIM_BenchTimersSample, bench);
+	switches = bench->switches;
+	cycles = bench->cycles;
+	*expired = bench->sampled;
+	SIM_SleepFor(SIM_MS(ms));
+	SIM_RunOnTarget(SIM_BenchTimersSample, bench);
+	switches = bench->switches - switches;
+	cycles = bench->cycles - cycles;
+	*expired = bench->sampled - *expired;
+	SIM_Log("bench timers: %-24s %6.0f wake-ups/min  netTask %6.0f us/min, %5.1f us per wake-up", name,
+			switches / minutes, cycles / (SIM_CORE_CLOCK / 1e6) / minutes,
+			switches ? cycles / (SIM_CORE_CLOCK / 1e6) / switches : 0.0);
+	return switches / minutes;
+}
+
+static bool SIM_BenchTimers(char** argv, int argc)
+{
+	static SimBenchTimers_t bench;
+	char name[32];
+	double idle, rate;
+	uint32_t expired;
+	uint32_t ms = SIM_BenchNumber(argc > 1 ? argv[1] : NULL, 10000);
+	/* the run time counter wraps after 23 s */
+	if ((argc > 2) || (ms == 0) || (ms > 20000))
+		return false;
+	memset(&bench, 0, sizeof(bench));
+	/* netTask woke every 100 ms before the timer wheel */
+	idle = SIM_BenchTimersWindow(&bench, ms, "idle", &expired);
+	SIM_ScenarioCheck(idle < 600, (int64_t)idle, "timers: idle wake-ups/min < 600");
+	SIM_RunOnTarget(SIM_BenchTimersOpen, &bench);
+	snprintf(name, sizeof(name), "%u sockets in SYN-SENT", (unsigned)bench.armed);
+	rate = SIM_BenchTimersWindow(&bench, ms, name, &expired);
+	SIM_RunOnTarget(SIM_BenchTimersClose, &bench);
+	SIM_ScenarioCheck(bench.armed != 0, bench.armed, "timers: sockets in SYN-SENT != 0");
+	SIM_ScenarioCheck(rate < 600, (int64_t)rate, "timers: wake-ups/min with sockets in SYN-SENT < 600");
+	/* the wheel only wakes for deadlines: the expirations on top of idle */
+	SIM_RunOnTarget(SIM_BenchTimersStart, &bench);
+	snprintf(name, sizeof(name), "%u busy connections", SIM_BENCH_TIMERS_COUNT);
+	rate = SIM_BenchTimersWindow(&bench, ms, name, &expired);
+	SIM_RunOnTarget(SIM_BenchTimersStop, &bench);
+	SIM_Log("bench timers: %.0f expirations/min", expired * 60000.0 / ms);
+	SIM_ScenarioCheck(rate <= idle + expired * 60000.0 / ms, (int64_t)(rate - idle),
+					  "timers: busy wake-ups/min <= idle + expirations");
+	return true;
+}
+
+/*==================================== demux ===================================*/
+
+static Socket demuxSockets[SIM_BENCH_DEMUX_SOCKETS];
+static SimBenchDemuxTarget_t demuxTargets[3][SIM_BENCH_DEMUX_TARGETS];
+static uint32_t demuxTargetCount[3];
+static const char* const demuxKinds[3] = {"established", "SYN to listener", "UDP to 1161"};
+
+/* the address and port checks of the stack, IPv4 only like this firmware */
+static bool SIM_BenchDemuxMatch(Socket* socket, const SimBenchDemuxTarget_t* target, uint_t type)
+{
+	const Ipv4PseudoHeader* pseudoHeader = &target->pseudoHeader.ipv4Data;
+	if (socket->type != type)
+		return false;
+	if (socket->interface && (socket->interface != target->interface))
+		return false;
+	if (socket->localPort != ntohs(target->header.destPort))
+		return false;
+	if (socket->localIpAddr.length && (socket->localIpAddr.ipv4Addr != pseudoHeader->destAddr))
+		return false;
+	if (socket->remoteIpAddr.length && (socket->remoteIpAddr.ipv4Addr != pseudoHeader->srcAddr))
+		return false;
+	return true;
+}
+
+/* the former scan of tcpProcessSegment, over the socket table and then the
+* bench sockets, whose descriptors follow */
+static Socket* SIM_BenchDemuxScanTcp(const SimBenchDemuxTarget_t* target, uint32_t sockets)
+{
+	Socket* passiveSocket = NULL;
+	Socket* socket;
+	uint32_t i;
+	for (i = 0; i < SOCKET_MAX_COUNT + sockets; i++)
+	{
+		socket = (i < SOCKET_MAX_COUNT) ? &socketTable[i] : &demuxSockets[i - SOCKET_MAX_COUNT];
+		if (!SIM_BenchDemuxMatch(socket, target, SOCKET_TYPE_STREAM))
+			continue;
+		if ((socket->state == TCP_STATE_LISTEN) && (passiveSocket == NULL))
+			passiveSocket = socket;
+		if (socket->remotePort == ntohs(target->header.srcPort))
+			return socket;
+	}
+	return passiveSocket;
+}
+
+/* the UDP match of udpProcessDatagram, over the whole table */
+static Socket* SIM_BenchDemuxScanUdp(const SimBenchDemuxTarget_t* target, uint32_t sockets)
+{
+	Socket* socket;
+	uint32_t i;
+	for (i = 0; i < SOCKET_MAX_COUNT + sockets; i++)
+	{
+		socket = (i < SOCKET_MAX_COUNT) ? &socketTable[i] : &demuxSockets[i - SOCKET_MAX_COUNT];
+		if (SIM_BenchDemuxMatch(socket, target, SOCKET_TYPE_DGRAM) &&
+			(!socket->remotePort || (socket->remotePort == ntohs(target->header.srcPort))))
+			return socket;
+	}
+	return NULL;
+}
+
+/* and over the port bucket only, as it does now */
+static Socket* SIM_BenchDemuxHashUdp(const SimBenchDemuxTarget_t* target)
+{
+	Socket* socket;
+	for (socket = socketGetPortBucket(ntohs(target->header.destPort)); socket != NULL; socket = socket->hashNext)
+	{
+		if (SIM_BenchDemuxMatch(socket, target, SOCKET_TYPE_DGRAM) &&
+			(!socket->remotePort || (socket->remotePort == ntohs(target->header.srcPort))))
+			return socket;
+	}
+	return NULL;
+}
+
+static void SIM_BenchDemuxTarget(uint32_t kind, uint32_t remote, uint16_t srcPort, uint16_t destPort,
+								 NetInterface* interface, Socket* socket)
+{
+	SimBenchDemuxTarget_t* target = &demuxTargets[kind][demuxTargetCount[kind]++];
+	memset(target, 0, sizeof(*target));
+	target->interface = interface;
+	target->pseudoHeader.length = sizeof(Ipv4PseudoHeader);
+	target->pseudoHeader.ipv4Data.srcAddr = remote;
+	target->pseudoHeader.ipv4Data.destAddr = interface->ipv4Context.addr;
+	target->header.srcPort = htons(srcPort);
+	target->header.destPort = htons(destPort);
+	target->socket = socket;
+}
+
+/* the services of the firmware on ports of their own: 3 TCP listeners, SNMP
+* bound on both interfaces, then Modbus/TCP and HTTP connections and MQTT
+* clients. Each gets a segment or datagram that belongs to it */
+static void SIM_BenchDemuxSetup(uint32_t sockets)
+{
+	static const uint16_t listenPorts[3] = {1502, 1080, 1021};
+	Socket* socket;
+	uint32_t i, remote;
+	memset(demuxSockets, 0, sizeof(demuxSockets));
+	memset(demuxTargetCount, 0, sizeof(demuxTargetCount));
+	for (i = 0; i < sockets; i++)
+	{
+		socket = &demuxSockets[i];
+		socket->descriptor = SOCKET_MAX_COUNT + i;
+		/* 198.51.100.0/24, documentation addresses */
+		remote = htonl(0xC6336400 | (i + 1));
+		if (i < 3)
+		{
+			socket->type = SOCKET_TYPE_STREAM;
+			socket->state = TCP_STATE_LISTEN;
+			socket->localPort = listenPorts[i];
+			SIM_BenchDemuxTarget(1, remote, 40000 + i, socket->localPort, &netInterface[0], socket);
+		}
+		else if (i < 5)
+		{
+			socket->type = SOCKET_TYPE_DGRAM;
+			socket->interface = &netInterface[i - 3];
+			socket->localPort = 1161;
+			SIM_BenchDemuxTarget(2, remote, 40000 + i, socket->localPort, socket->interface, socket);
+		}
+		else
+		{
+			socket->type = SOCKET_TYPE_STREAM;
+			socket->state = TCP_STATE_ESTABLISHED;
+			socket->remoteIpAddr.length = sizeof(Ipv4Addr);
+			socket->remoteIpAddr.ipv4Addr = remote;
+			if (i % 3 == 2)
+			{
+				socket->localPort = 50000 + i;
+				socket->remotePort = 1883;
+			}
+			else
+			{
+				socket->localPort = listenPorts[i % 2];
+				socket->remotePort = 40000 + i;
+			}
+			SIM_BenchDemuxTarget(0, remote, socket->remotePort, socket->localPort, &netInterface[0], socket);
+		}
+		socketHashUpdate(socket);
+	}
+}
+
+static void SIM_BenchDemuxRun(void* param)
+{
+	SimBenchDemux_t* bench = param;
+	const SimBenchDemuxTarget_t* target;
+	Socket* volatile sink;
+	Socket* found;
+	uint64_t start;
+	uint32_t kind, i, k, rounds;
+	osAcquireMutex(&netMutex);
+	SIM_BenchDemuxSetup(bench->sockets);
+	for (i = 0; i < SOCKET_MAX_COUNT; i++)
+		bench->live += (socketTable[i].type != SOCKET_TYPE_UNUSED);
+	for (kind = 0; kind < 3; kind++)
+	{
+		/* the socket the target belongs to, and the one the scan finds: the
+		* ports are not used by the firmware */
+		for (k = 0; k < demuxTargetCount[kind]; k++)
+		{
+			target = &demuxTargets[kind][k];
+			found = (kind < 2) ? tcpFindSocket(target->interface, &target->pseudoHeader, &target->header)
+							   : SIM_BenchDemuxHashUdp(target);
+			if ((found != target->socket) ||
+				(found != ((kind < 2) ? SIM_BenchDemuxScanTcp(target, bench->sockets)
+									  : SIM_BenchDemuxScanUdp(target, bench->sockets))))
+				bench->mismatches++;
+		}
+		rounds = bench->lookups / demuxTargetCount[kind] + 1;
+		start = SIM_Now();
+		for (i = 0; i < rounds; i++)
+		{
+			for (k = 0; k < demuxTargetCount[kind]; k++)
+			{
+				target = &demuxTargets[kind][k];
+				sink = (kind < 2) ? tcpFindSocket(target->interface, &target->pseudoHeader, &target->header)
+								  : SIM_BenchDemuxHashUdp(target);
+			}
+		}
+		bench->hashNs[kind] = (double)(SIM_Now() - start) / (rounds * demuxTargetCount[kind]);
+		start = SIM_Now();
+		for (i = 0; i < rounds; i++)
+		{
+			for (k = 0; k < demuxTargetCount[kind]; k++)
+			{
+				target = &demuxTargets[kind][k];
+				sink = (kind < 2) ? SIM_BenchDemuxScanTcp(target, bench->sockets)
+								  : SIM_BenchDemuxScanUdp(target, bench->sockets);
+			}
+		}
+		bench->scanNs[kind] = (double)(SIM_Now() - start) / (rounds * demuxTargetCount[kind]);
+	}
+	(void)sink;
+	for (i = 0; i < bench->sockets; i++)
+		socketHashRemove(&demuxSockets[i]);
+	osReleaseMutex(&netMutex);
+}
+
+static bool SIM_BenchDemux(char** argv, int argc)
+{
+	static const uint32_t sockets[3] = {10, 32, 64};
+	SimBenchDemux_t bench;
+	uint32_t lookups, i, kind;
+	lookups = SIM_BenchNumber(argc > 1 ? argv[1] : NULL, 1000000);
+	if ((argc > 2) || (lookups == 0))
+		return false;
+	for (i = 0; i < 3; i++)
+	{
+		memset(&bench, 0, sizeof(bench));
+		bench.lookups = lookups;
+		bench.sockets = sockets[i];
+		SIM_RunOnTarget(SIM_BenchDemuxRun, &bench);
+		for (kind = 0; kind < 3; kind++)
+		{
+			SIM_Log("bench demux: %2u sockets + %u of the firmware  %-15s  hash %5.1f ns  scan %5.1f ns",
+					(unsigned)bench.sockets, (unsigned)bench.live, demuxKinds[kind], bench.hashNs[kind],
+					bench.scanNs[kind]);
+		}
+		SIM_ScenarioCheck(bench.mismatches == 0, bench.mismatches, "demux: %u sockets, hash != scan == 0",
+						  (unsigned)bench.sockets);
+	}
+	/* the hash lookup does not grow with the table */
+	SIM_ScenarioCheck(bench.hashNs[0] < bench.scanNs[0], (int64_t)(100 * bench.hashNs[0] / bench.scanNs[0]),
+					  "demux: 64 sockets established hash / scan < 100%%");
+	return true;
+}
+
+/*=============================== IPv4 reassembly ==============================*/
+
+/* 4 interleaved 8000 byte datagrams need more than the budget of 2 x
+* IPV4_MAX_FRAG_DATAGRAM_SIZE, the oldest ones are evicted */
+static const SimBenchFragCase_t fragCases[SIM_BENCH_FRAG_CASES] = {
+	{3000, 1480, 2, false}, {8000, 1480, 1, false}, {8000, 1480, 4, true}, {4000, 552, 1, false},
+	{1200, 256, 3, false}
+};
+
+static uint8_t SIM_BenchFragByte(uint32_t datagram, uint32_t k)
+{
+	return (uint8_t)((datagram * 7 + k) % 251);
+}
+
+/* bytes of the pool in use */
+static size_t SIM_BenchPoolUsage(void)
+{
+	MemPoolStats stats;
+	size_t usage = 0;
+	uint_t c;
+	for (c = 0; c < NET_MEM_POOL_CLASS_COUNT; c++)
+	{
+		memPoolGetStats(c, &stats);
+		usage += stats.currentUsage * stats.blockSize;
+	}
+	return usage;
+}
+
+/* the UDP datagram <id>, header and payload */
+static void SIM_BenchFragDatagram(uint8_t* data, uint32_t id, uint16_t size)
+{
+	uint32_t k;
+	data[0] = (uint8_t)(SIM_BENCH_FRAG_PORT >> 8);
+	data[1] = (uint8_t)SIM_BENCH_FRAG_PORT;
+	data[2] = (uint8_t)(SIM_BENCH_FRAG_PORT >> 8);
+	data[3] = (uint8_t)SIM_BENCH_FRAG_PORT;
+	data[4] = (uint8_t)((size + 8) >> 8);
+	data[5] = (uint8_t)(size + 8);
+	/* no checksum, IPv4 allows it */
+	data[6] = 0;
+	data[7] = 0;
+	for (k = 0; k < size; k++)
+		data[8 + k] = SIM_BenchFragByte(id, k);
+}
+
+/* one case: the fragments of each group go through ipv4ReassembleDatagram in
+* random order, the completed datagrams are read back from a UDP socket */
+static void SIM_BenchFragCase(SimBenchFrag_t* bench, uint32_t index, Socket* socket)
+{
+	static uint8_t datagrams[SIM_BENCH_FRAG_GROUP][IPV4_MAX_FRAG_DATAGRAM_SIZE];
+	static uint8_t packet[20 + IPV4_MAX_FRAG_DATAGRAM_SIZE];
+	static uint8_t received[IPV4_MAX_FRAG_DATAGRAM_SIZE];
+	static SimBenchFragment_t fragments[SIM_BENCH_FRAG_MAX];
+	const SimBenchFragCase_t* c = &fragCases[index];
+	NetInterface* interface = &netInterface[0];
+	SimBenchFragment_t swap;
+	Ipv4Header* header = (Ipv4Header*)packet;
+	uint32_t base, id, d, n, count, k;
+	uint16_t length = c->size + 8, step = (c->mtu - 20) & ~7;
+	size_t pool, size;
+	uint64_t start;
+	base = SIM_BenchPoolUsage();
+	start = SIM_Now();
+	for (id = 0; id < bench->datagrams; id += c->interleaved)
+	{
+		/* the fragments of the group, shuffled */
+		count = 0;
+		for (d = 0; d < c->interleaved; d++)
+		{
+			SIM_BenchFragDatagram(datagrams[d], id + d, c->size);
+			for (k = 0; k < length; k += step)
+			{
+				fragments[count].datagram = d;
+				fragments[count].first = k;
+				fragments[count].last = MIN(k + step, length);
+				count++;
+			}
+		}
+		for (k = count - 1; k > 0; k--)
+		{
+			n = SIM_BenchRandom() % (k + 1);
+			swap = fragments[k];
+			fragments[k] = fragments[n];
+			fragments[n] = swap;
+		}
+		osAcquireMutex(&netMutex);
+		for (k = 0; k < count; k++)
+		{
+			d = fragments[k].datagram;
+			memset(packet, 0, 20);
+			packet[0] = 0x45;
+			header->totalLength = htons(20 + fragments[k].last - fragments[k].first);
+			header->identification = htons((uint16_t)(bench->seed + id + d));
+			header->fragmentOffset = htons((fragments[k].first / 8) |
+										   ((fragments[k].last < length) ? IPV4_FLAG_MF : 0));
+			header->timeToLive = 64;
+			header->protocol = IPV4_PROTOCOL_UDP;
+			header->srcAddr = IPV4_ADDR(192, 168, 1, 206);
+			header->destAddr = interface->ipv4Context.addr;
+			memcpy(packet + 20, datagrams[d] + fragments[k].first, fragments[k].last - fragments[k].first);
+			ipv4ReassembleDatagram(interface, header, 20 + fragments[k].last - fragments[k].first);
+			bench->fragPeak[index] = MAX(bench->fragPeak[index], ipv4FragMemUsage);
+			pool = SIM_BenchPoolUsage() - base;
+			bench->poolPeak[index] = MAX(bench->poolPeak[index], pool);
+		}
+		osReleaseMutex(&netMutex);
+		/* byte for byte, a datagram of the group in any order */
+		while (socketReceiveFrom(socket, NULL, NULL, received, sizeof(received), &size, SOCKET_FLAG_DONT_WAIT) ==
+			   NO_ERROR)
+		{
+			bench->completed[index]++;
+			for (d = 0; d < c->interleaved; d++)
+			{
+				if ((size == c->size) && (memcmp(received, datagrams[d] + 8, size) == 0))
+					break;
+			}
+			bench->corrupted[index] += (d == c->interleaved);
+		}
+	}
+	bench->ns[index] = SIM_Now() - start;
+	/* evicted and unfinished datagrams give back their blocks */
+	osAcquireMutex(&netMutex);
+	ipv4FlushFragQueue(interface);
+	osReleaseMutex(&netMutex);
+	bench->leaked[index] = (SIM_BenchPoolUsage() - base) / NET_MEM_POOL_SMALL_BUFFER_SIZE;
+}
+
+static void SIM_BenchFragRun(void* param)
+{
+	SimBenchFrag_t* bench = param;
+	Socket* socket = socketOpen(SOCKET_TYPE_DGRAM, SOCKET_IP_PROTO_UDP);
+	uint32_t i;
+	if (socket == NULL)
+		return;
+	benchRandom = bench->seed ? bench->seed : 1;
+	socketBind(socket, &IP_ADDR_ANY, SIM_BENCH_FRAG_PORT);
+	for (i = 0; i < SIM_BENCH_FRAG_CASES; i++)
+		SIM_BenchFragCase(bench, i, socket);
+	socketClose(socket);
+}
+
+static bool SIM_BenchFrag(char** argv, int argc)
+{
+	SimBenchFrag_t bench = {0};
+	const SimBenchFragCase_t* c;
+	uint32_t i;
+	bench.datagrams = SIM_BenchNumber(argc > 1 ? argv[1] : NULL, 2000);
+	bench.seed = SIM_BenchNumber(argc > 2 ? argv[2] : NULL, 1);
+	if ((argc > 3) || (bench.datagrams == 0))
+		return false;
+	/* whole groups */
+	bench.datagrams = (bench.datagrams + 11) / 12 * 12;
+	SIM_RunOnTarget(SIM_BenchFragRun, &bench);
+	for (i = 0; i < SIM_BENCH_FRAG_CASES; i++)
+	{
+		c = &fragCases[i];
+		SIM_Log("bench frag: %4u/%-4u x%u  %5u of %5u complete  frag %5u B  pool %5u B peak  %5.1f us/datagram",
+				c->size, c->mtu, c->interleaved, (unsigned)bench.completed[i], (unsigned)bench.datagrams,
+				(unsigned)bench.fragPeak[i], (unsigned)bench.poolPeak[i], bench.ns[i] / 1e3 / bench.datagrams);
+		SIM_ScenarioCheck(bench.corrupted[i] == 0, bench.corrupted[i], "frag: %u/%u x%u corrupted == 0", c->size,
+						  c->mtu, c->interleaved);
+		SIM_ScenarioCheck(bench.fragPeak[i] <= IPV4_FRAG_MEM_BUDGET, bench.fragPeak[i],
+						  "frag: %u/%u x%u peak <= budget", c->size, c->mtu, c->interleaved);
+		SIM_ScenarioCheck(bench.leaked[i] == 0, bench.leaked[i], "frag: %u/%u x%u pool blocks leaked == 0",
+						  c->size, c->mtu, c->interleaved);
+		if (c->evicting)
+		{
+			SIM_ScenarioCheck(bench.completed[i] < bench.datagrams, bench.completed[i],
+							  "frag: %u/%u x%u evicted, complete < %u", c->size, c->mtu, c->interleaved,
+							  (unsigned)bench.datagrams);
+		}
+		else
+		{
+			SIM_ScenarioCheck(bench.completed[i] == bench.datagrams, bench.completed[i],
+							  "frag: %u/%u x%u complete == %u", c->size, c->mtu, c->interleaved,
+							  (unsigned)bench.datagrams);
+		}
+	}
+	return true;
+}
+
+/*================================= HDLC framing ===============================*/
+
+/* a PPP context of its own on an interface the stack does not know: the
+* driver type makes nicProcessPacket stop after enableIrq (no IPv6 in this
+* build), which the bench takes as the delivery of the frame */
+static PppContext hdlcContext;
+static NetInterface hdlcInterface;
+static NicDriver hdlcDriver;
+static Mib2IfEntry hdlcIfEntry;
+static const uint8_t* hdlcExpected;
+static size_t hdlcExpectedLength;
+static uint32_t hdlcDelivered;
+static uint32_t hdlcCorrupted;
+static const uint32_t hdlcAccms[2] = {0x00000000, 0xFFFFFFFF};
+
+static error_t SIM_BenchHdlcUartInit(void)
+{
+	return NO_ERROR;
+}
+
+static void SIM_BenchHdlcUartNothing(void)
+{
+}
+
+static const UartDriver hdlcUartDriver = {SIM_BenchHdlcUartInit, SIM_BenchHdlcUartNothing,
+										  SIM_BenchHdlcUartNothing, SIM_BenchHdlcUartNothing};
+
+/* a frame that passed the FCS check of the driver */
+static void SIM_BenchHdlcDeliver(NetInterface* interface)
+{
+	hdlcDelivered++;
+	if (memcmp(interface->pppContext->frame, hdlcExpected, hdlcExpectedLength))
+		hdlcCorrupted++;
+}
+
+static void SIM_BenchHdlcNothing(NetInterface* interface)
+{
+}
+
+/* RFC 1662 FCS-16 bit by bit */
+static uint16_t SIM_BenchFcs(const uint8_t* data, size_t length)
+{
+	uint16_t fcs = 0xFFFF;
+	size_t i;
+	int b;
+	for (i = 0; i < length; i++)
+	{
+		fcs ^= data[i];
+		for (b = 0; b < 8; b++)
+			fcs = (fcs & 1) ? (fcs >> 1) ^ 0x8408 : fcs >> 1;
+	}
+	return fcs ^ 0xFFFF;
+}
+
+/* the characters sent escaped, and removed or taken as framing on reception */
+static bool SIM_BenchHdlcSpecial(uint8_t c, uint32_t accm)
+{
+	return (c == PPP_FLAG_CHAR) || (c == PPP_ESC_CHAR) || ((c < PPP_MASK_CHAR) && (accm & (1UL << c)));
+}
+
+/* a frame of <size> payload bytes with a fair share of characters to escape,
+* followed by its FCS, least significant octet first; returns the frame length
+* without the FCS */
+static size_t SIM_BenchHdlcFrame(uint8_t* frame, size_t size, uint16_t protocol)
+{
+	static const uint8_t specials[4] = {PPP_FLAG_CHAR, PPP_ESC_CHAR, 0x00, 0x11};
+	size_t k;
+	uint16_t fcs;
+	frame[0] = 0xFF;
+	frame[1] = 0x03;
+	frame[2] = (uint8_t)(protocol >> 8);
+	frame[3] = (uint8_t)protocol;
+	for (k = 0; k < size; k++)
+	{
+		frame[4 + k] = (uint8_t)SIM_BenchRandom();
+		if ((frame[4 + k] & 7) == 0)
+			frame[4 + k] = specials[frame[4 + k] >> 6];
+	}
+	fcs = SIM_BenchFcs(frame, size + 4);
+	frame[size + 4] = (uint8_t)fcs;
+	frame[size + 5] = (uint8_t)(fcs >> 8);
+	return size + 4;
+}
+
+/* the byte stream of RFC 1662 for a frame and its FCS */
+static size_t SIM_BenchHdlcEncode(uint8_t* out, const uint8_t* frame, size_t length, uint32_t accm)
+{
+	size_t i, n = 0;
+	out[n++] = PPP_FLAG_CHAR;
+	for (i = 0; i < length; i++)
+	{
+		if (SIM_BenchHdlcSpecial(frame[i], accm))
+		{
+			out[n++] = PPP_ESC_CHAR;
+			out[n++] = frame[i] ^ PPP_MASK_CHAR;
+		}
+		else
+			out[n++] = frame[i];
+	}
+	out[n++] = PPP_FLAG_CHAR;
+	return n;
+}
+
+/* takes the TX queue out as the UART would */
+static size_t SIM_BenchHdlcTake(uint8_t* out)
+{
+	const uint8_t* data;
+	size_t n, length = 0;
+	while ((n = pppHdlcDriverGetTxBlock(&hdlcInterface, &data)) > 0)
+	{
+		memcpy(out + length, data, n);
+		length += n;
+		pppHdlcDriverReleaseTxBlock(&hdlcInterface, n);
+	}
+	return length;
+}
+
+/* puts a byte stream in the RX queue and decodes all of it */
+static void SIM_BenchHdlcGive(const uint8_t* data, size_t length)
+{
+	pppHdlcDriverWriteRxBlock(&hdlcInterface, data, length);
+	while (hdlcContext.rxBufferLen > 0)
+		pppHdlcDriverReceivePacket(&hdlcInterface);
+}
+
+/* the driver before the block framing: one queue call, each with the
+* interrupt lock, per character, and the FCS in a pass of its own as
+* pppSendFrame made it */
+static void SIM_BenchHdlcOldEncode(uint8_t* frame, size_t length, uint32_t accm)
+{
+	uint16_t fcs = pppCalcFcs(frame, length);
+	size_t j;
+	frame[length] = (uint8_t)fcs;
+	frame[length + 1] = (uint8_t)(fcs >> 8);
+	pppHdlcDriverWriteTxQueue(&hdlcContext, PPP_FLAG_CHAR);
+	for (j = 0; j < length + 2; j++)
+	{
+		if (SIM_BenchHdlcSpecial(frame[j], accm))
+		{
+			pppHdlcDriverWriteTxQueue(&hdlcContext, PPP_ESC_CHAR);
+			pppHdlcDriverWriteTxQueue(&hdlcContext, frame[j] ^ PPP_MASK_CHAR);
+		}
+		else
+			pppHdlcDriverWriteTxQueue(&hdlcContext, frame[j]);
+	}
+	pppHdlcDriverWriteTxQueue(&hdlcContext, PPP_FLAG_CHAR);
+}
+
+/* the same for the reception, with the FCS check pppProcessFrame made;
+* returns the number of good frames */
+static uint32_t SIM_BenchHdlcOldDecode(uint32_t accm)
+{
+	static uint8_t frame[PPP_MAX_FRAME_SIZE];
+	uint32_t good = 0;
+	size_t n = 0;
+	bool escFlag = false;
+	uint8_t c;
+	while (hdlcContext.rxBufferLen > 0)
+	{
+		c = pppHdlcDriverReadRxQueue(&hdlcContext);
+		if ((c < PPP_MASK_CHAR) && (accm & (1UL << c)))
+			continue;
+		if (c == PPP_ESC_CHAR)
+			escFlag = true;
+		else if (c == PPP_FLAG_CHAR)
+		{
+			good += (n >= PPP_FCS_SIZE) && (crc16FcsUpdate(0, frame, n) == 0x0F47);
+			n = 0;
+		}
+		else if (n < sizeof(frame))
+		{
+			frame[n++] = escFlag ? c ^ PPP_MASK_CHAR : c;
+			escFlag = false;
+		}
+	}
+	return good;
+}
+
+static void SIM_BenchHdlcRun(void* param)
+{
+	static uint8_t raw[8 + PPP_MAX_FRAME_SIZE];
+	static uint8_t encoded[SIM_BENCH_HDLC_MAX];
+	static uint8_t reference[SIM_BENCH_HDLC_MAX];
+	SimBenchHdlc_t* bench = param;
+	SimBenchBuffer_t buffer;
+	uint64_t ns[4], start;
+	uint32_t a, k, before, good;
+	uint32_t accm;
+	size_t offset, length, n, i;
+	uint16_t protocol;
+	uint8_t c;
+	benchRandom = bench->seed ? bench->seed : 1;
+	/* the driver as pppInit sets it up, on the bench interface */
+	memset(&hdlcContext, 0, sizeof(hdlcContext));
+	memset(&hdlcInterface, 0, sizeof(hdlcInterface));
+	hdlcDriver = pppHdlcDriver;
+	hdlcDriver.type = NIC_TYPE_6LOWPAN;
+	hdlcDriver.enableIrq = SIM_BenchHdlcDeliver;
+	hdlcDriver.disableIrq = SIM_BenchHdlcNothing;
+	hdlcInterface.nicDriver = &hdlcDriver;
+	hdlcInterface.uartDriver = &hdlcUartDriver;
+	hdlcInterface.pppContext = &hdlcContext;
+	hdlcInterface.mibIfEntry = &hdlcIfEntry;
+	hdlcInterface.configured = TRUE;
+	hdlcIfEntry.ifInErrors = 0;
+	hdlcDelivered = 0;
+	hdlcCorrupted = 0;
+	if (!osCreateEvent(&hdlcInterface.nicTxEvent))
+		return;
+	pppHdlcDriverInit(&hdlcInterface);
+	for (a = 0; a < 2; a++)
+	{
+		hdlcContext.peerConfig.accm = hdlcAccms[a];
+		hdlcContext.localConfig.accm = hdlcAccms[a];
+		/* random sizes, protocols, chunk splits and ring positions against
+		* the reference stream, decoded back, then again with one bit flipped */
+		for (k = 0; k < bench->frames; k++)
+		{
+			offset = SIM_BenchRandom() % 8;
+			protocol = (SIM_BenchRandom() % 4) ? PPP_PROTOCOL_IP : PPP_PROTOCOL_LCP;
+			length = SIM_BenchHdlcFrame(raw + offset, 1 + SIM_BenchRandom() % PPP_DEFAULT_MRU, protocol);
+			accm = (protocol == PPP_PROTOCOL_IP) ? hdlcAccms[a] : PPP_DEFAULT_ACCM;
+			hdlcExpected = raw + offset;
+			hdlcExpectedLength = length + PPP_FCS_SIZE;
+			n = SIM_BenchHdlcEncode(reference, raw + offset, length + PPP_FCS_SIZE, accm);
+			SIM_BenchSplit(&buffer, raw, offset + length);
+			bench->txWrapped += (hdlcContext.txWriteIndex + n > PPP_TX_BUFFER_SIZE);
+			bench->rxWrapped += (hdlcContext.rxWriteIndex + n > PPP_RX_BUFFER_SIZE);
+			pppHdlcDriverSendPacket(&hdlcInterface, (NetBuffer*)&buffer, offset);
+			if ((SIM_BenchHdlcTake(encoded) != n) || memcmp(encoded, reference, n))
+				bench->mismatches++;
+			SIM_BenchHdlcGive(reference, n);
+			/* a single bit error in the decoded frame, which the FCS always
+			* catches: neither the character nor the flipped one is special */
+			do
+			{
+				i = 1 + SIM_BenchRandom() % (n - 2);
+				c = reference[i] ^ (1 << (SIM_BenchRandom() % 8));
+			} while (SIM_BenchHdlcSpecial(reference[i], hdlcAccms[a]) || SIM_BenchHdlcSpecial(c, hdlcAccms[a]));
+			reference[i] = c;
+			before = hdlcDelivered;
+			SIM_BenchHdlcGive(reference, n);
+			bench->flippedDelivered += hdlcDelivered - before;
+			bench->flipped++;
+		}
+		/* MB/s of PPP frames of the MRU through each path */
+		length = SIM_BenchHdlcFrame(raw, PPP_DEFAULT_MRU, PPP_PROTOCOL_IP);
+		hdlcExpected = raw;
+		hdlcExpectedLength = length + PPP_FCS_SIZE;
+		SIM_BenchSplit(&buffer, raw, length);
+		memset(ns, 0, sizeof(ns));
+		for (k = 0; k < bench->frames; k++)
+		{
+			start = SIM_Now();
+			SIM_BenchHdlcOldEncode(raw, length, hdlcAccms[a]);
+			ns[0] += SIM_Now() - start;
+			n = SIM_BenchHdlcTake(encoded);
+			start = SIM_Now();
+			pppHdlcDriverSendPacket(&hdlcInterface, (NetBuffer*)&buffer, 0);
+			ns[1] += SIM_Now() - start;
+			SIM_BenchHdlcTake(reference);
+			pppHdlcDriverWriteRxBlock(&hdlcInterface, encoded, n);
+			start = SIM_Now();
+			good = SIM_BenchHdlcOldDecode(hdlcAccms[a]);
+			ns[2] += SIM_Now() - start;
+			bench->corrupted += (good != 1);
+			pppHdlcDriverWriteRxBlock(&hdlcInterface, reference, n);
+			start = SIM_Now();
+			while (hdlcContext.rxBufferLen > 0)
+				pppHdlcDriverReceivePacket(&hdlcInterface);
+			ns[3] += SIM_Now() - start;
+		}
+		for (i = 0; i < 4; i++)
+			bench->mbps[a][i] = (double)bench->frames * length / (ns[i] / 1e3);
+	}
+	bench->delivered = hdlcDelivered;
+	bench->corrupted += hdlcCorrupted;
+	bench->inErrors = hdlcIfEntry.ifInErrors;
+	osDeleteEvent(&hdlcInterface.nicTxEvent);
+}
+
+static bool SIM_BenchHdlc(char** argv, int argc)
+{
+	SimBenchHdlc_t bench = {0};
+	uint32_t a;
+	bench.frames = SIM_BenchNumber(argc > 1 ? argv[1] : NULL, 2000);
+	bench.seed = SIM_BenchNumber(argc > 2 ? argv[2] : NULL, 1);
+	if ((argc > 3) || ((int32_t)bench.frames <= 0))
+		return false;
+	SIM_RunOnTarget(SIM_BenchHdlcRun, &bench);
+	for (a = 0; a < 2; a++)
+	{
+		SIM_Log("bench hdlc: ACCM %08X  encode %6.1f MB/s (per character %5.1f)  decode %6.1f MB/s (per character %5.1f)",
+				(unsigned)hdlcAccms[a], bench.mbps[a][1], bench.mbps[a][0], bench.mbps[a][3], bench.mbps[a][2]);
+	}
+	SIM_Log("bench hdlc: %u random frames, as many with a bit flipped, %u across the end of the TX queue, %u of the RX queue",
+			(unsigned)(2 * bench.frames), (unsigned)bench.txWrapped, (unsigned)bench.rxWrapped);
+	SIM_ScenarioCheck(bench.mismatches == 0, bench.mismatches, "hdlc: encoded frames != RFC 1662 == 0");
+	SIM_ScenarioCheck(bench.delivered == 4 * bench.frames, bench.delivered, "hdlc: frames delivered == %u",
+					  (unsigned)(4 * bench.frames));
+	SIM_ScenarioCheck(bench.corrupted == 0, bench.corrupted, "hdlc: frames decoded wrong == 0");
+	SIM_ScenarioCheck(bench.flippedDelivered == 0, bench.flippedDelivered, "hdlc: frames with a flipped bit delivered == 0");
+	SIM_ScenarioCheck(bench.inErrors == bench.flipped, bench.inErrors, "hdlc: ifInErrors == %u",
+					  (unsigned)bench.flipped);
+	SIM_ScenarioCheck(bench.txWrapped > 0 && bench.rxWrapped > 0, MIN(bench.txWrapped, bench.rxWrapped),
+					  "hdlc: frames across the end of both queues > 0");
+	for (a = 0; a < 2; a++)
+	{
+		SIM_ScenarioCheck(bench.mbps[a][1] > bench.mbps[a][0], bench.mbps[a][1] * 100 / bench.mbps[a][0],
+						  "hdlc: ACCM %08X encode / per character > 100%%", (unsigned)hdlcAccms[a]);
+		SIM_ScenarioCheck(bench.mbps[a][3] > bench.mbps[a][2], bench.mbps[a][3] * 100 / bench.mbps[a][2],
+						  "hdlc: ACCM %08X decode / per character > 100%%", (unsigned)hdlcAccms[a]);
+	}
+	return true;
+}
+
+/*============================ private MIB snapshot ============================*/
+
+static SimBenchSnapshot_t* snapshotBench;
+static PrivateMibBase snapshotSaved;
+static PrivateMibBase snapshotCopies[SIM_BENCH_SNAPSHOT_READERS + 1];
+static volatile bool snapshotStop;
+static volatile uint32_t snapshotThreads;
+
+/* the writer fills every word of the base with the number of its version, so
+* a copy is whole when all its words are equal */
+static void SIM_BenchSnapshotFill(uint32_t version)
+{
+	volatile uint32_t* words = (volatile uint32_t*)&privateMibBase;
+	size_t i;
+	for (i = 0; i < SIM_BENCH_SNAPSHOT_WORDS; i++)
+		words[i] = version;
+}
+
+static void SIM_BenchSnapshotSeen(SimBenchSnapshotReader_t* reader, const uint32_t* words, size_t count,
+								  uint32_t* last)
+{
+	size_t i;
+	for (i = 1; i < count; i++)
+	{
+		if (words[i] != words[0])
+		{
+			reader->torn++;
+			return;
+		}
+	}
+	if (words[0] < *last)
+		reader->backwards++;
+	else if (words[0] > *last)
+		reader->versions++;
+	*last = MAX(*last, words[0]);
+}
+
+/* stands for UpdateInfo, the only writer */
+static void* SIM_BenchSnapshotWriter(void* param)
+{
+	uint32_t version = 1;
+	while (!snapshotStop)
+	{
+		SIM_BenchSnapshotFill(++version);
+		privateMibPublishSnapshot();
+	}
+	snapshotBench->published = version - 1;
+	__sync_fetch_and_sub(&snapshotThreads, 1);
+	return NULL;
+}
+
+/* a whole copy like the SNMP agent and MQTT, then the alarm group alone like
+* the trap task */
+static void* SIM_BenchSnapshotReader(void* param)
+{
+	uint32_t n = (uintptr_t)param;
+	SimBenchSnapshotReader_t* reader = &snapshotBench->reader[n];
+	PrivateMibAlarmGroup group;
+	uint32_t last = 0;
+	while (!snapshotStop)
+	{
+		privateMibGetSnapshot(&snapshotCopies[n]);
+		reader->reads++;
+		SIM_BenchSnapshotSeen(reader, (uint32_t*)&snapshotCopies[n], SIM_BENCH_SNAPSHOT_WORDS, &last);
+		privateMibGetGroupSnapshot(&group, offsetof(PrivateMibBase, alarmGroup), sizeof(group));
+		reader->groupReads++;
+		SIM_BenchSnapshotSeen(reader, (uint32_t*)&group, sizeof(group) / sizeof(uint32_t), &last);
+	}
+	__sync_fetch_and_sub(&snapshotThreads, 1);
+	return NULL;
+}
+
+/* copies the base the writer is filling, as the readers did before the
+* snapshots: shows that the check catches torn copies */
+static void* SIM_BenchSnapshotUnprotected(void* param)
+{
+	SimBenchSnapshotReader_t* reader = &snapshotBench->unprotected;
+	PrivateMibBase* copy = &snapshotCopies[SIM_BENCH_SNAPSHOT_READERS];
+	uint32_t last = 0;
+	while (!snapshotStop)
+	{
+		memcpy(copy, (void*)&privateMibBase, sizeof(PrivateMibBase));
+		reader->reads++;
+		SIM_BenchSnapshotSeen(reader, (uint32_t*)copy, SIM_BENCH_SNAPSHOT_WORDS, &last);
+	}
+	__sync_fetch_and_sub(&snapshotThreads, 1);
+	return NULL;
+}
+
+/* the scheduler is suspended, as Hello_task, which runs UpdateInfo, has the
+* priority of the SIM task: only the bench publishes. The writer and the
+* readers are host threads, which the scheduler does not serialize */
+static void SIM_BenchSnapshotRun(void* param)
+{
+	uint32_t i;
+	snapshotBench = param;
+	vTaskSuspendAll();
+	memcpy(&snapshotSaved, &privateMibBase, sizeof(PrivateMibBase));
+	SIM_BenchSnapshotFill(1);
+	privateMibPublishSnapshot();
+	snapshotStop = false;
+	snapshotThreads = snapshotBench->readers + 2;
+	SIM_StartThread(SIM_BenchSnapshotWriter, NULL);
+	SIM_StartThread(SIM_BenchSnapshotUnprotected, NULL);
+	for (i = 0; i < snapshotBench->readers; i++)
+		SIM_StartThread(SIM_BenchSnapshotReader, (void*)(uintptr_t)i);
+	SIM_SleepFor(SIM_MS(snapshotBench->ms));
+	snapshotStop = true;
+	while (snapshotThreads > 0)
+		SIM_SleepFor(SIM_MS(1));
+	memcpy(&privateMibBase, &snapshotSaved, sizeof(PrivateMibBase));
+	privateMibPublishSnapshot();
+	xTaskResumeAll();
+}
+
+static bool SIM_BenchSnapshot(char** argv, int argc)
+{
+	SimBenchSnapshot_t bench = {0};
+	SimBenchSnapshotReader_t total = {0};
+	uint32_t i, fewest = UINT32_MAX;
+	bench.ms = SIM_BenchNumber(argc > 1 ? argv[1] : NULL, 1000);
+	bench.readers = SIM_BenchNumber(argc > 2 ? argv[2] : NULL, 3);
+	if ((argc > 3) || ((int32_t)bench.ms <= 0) || (bench.readers < 1) || (bench.readers > SIM_BENCH_SNAPSHOT_READERS))
+		return false;
+	SIM_RunOnTarget(SIM_BenchSnapshotRun, &bench);
+	for (i = 0; i < bench.readers; i++)
+	{
+		total.reads += bench.reader[i].reads;
+		total.groupReads += bench.reader[i].groupReads;
+		total.torn += bench.reader[i].torn;
+		total.backwards += bench.reader[i].backwards;
+		total.versions += bench.reader[i].versions;
+		fewest = MIN(fewest, bench.reader[i].reads);
+	}
+	SIM_Log("bench snapshot: %u versions of %u bytes published in %u ms, %u readers", (unsigned)bench.published,
+			(unsigned)sizeof(PrivateMibBase), (unsigned)bench.ms, (unsigned)bench.readers);
+	SIM_Log("bench snapshot: %u whole and %u alarm group copies, %u new versions seen, %u torn, %u older than the last",
+			(unsigned)total.reads, (unsigned)total.groupReads, (unsigned)total.versions, (unsigned)total.torn,
+			(unsigned)total.backwards);
+	SIM_Log("bench snapshot: without the snapshots %u copies, %u torn", (unsigned)bench.unprotected.reads,
+			(unsigned)bench.unprotected.torn);
+	SIM_ScenarioCheck(bench.published > 0, bench.published, "snapshot: versions published > 0");
+	SIM_ScenarioCheck(fewest > 0, fewest, "snapshot: copies of each reader > 0");
+	SIM_ScenarioCheck(total.versions > bench.readers, total.versions, "snapshot: new versions seen > %u",
+					  (unsigned)bench.readers);
+	SIM_ScenarioCheck(total.torn == 0, total.torn, "snapshot: torn copies == 0");
+	SIM_ScenarioCheck(total.backwards == 0, total.backwards, "snapshot: copies older than the last == 0");
+	SIM_ScenarioCheck(bench.unprotected.torn > 0, bench.unprotected.torn, "snapshot: torn copies without the snapshots > 0");
+	return true;
+}
+
+/*================================== MIB walk ==================================*/
+
+typedef error_t (*SimBenchGetNext_t)(SnmpAgentContext* context, SnmpVarBind* var);
+
+static SimBenchMibStep_t mibSteps[SIM_BENCH_MIB_STEPS];
+static SnmpMessage mibSavedResponse;
+static uint8_t mibVarBindList[SNMP_MAX_MSG_SIZE];
+
+/* snmpGetNextObject before the merged index: every object of every MIB, in
+* load order, until one follows the OID */
+static error_t SIM_BenchMibOldGetNext(SnmpAgentContext* context, SnmpVarBind* var)
+{
+	uint8_t* nextOid = context->response.varBindList + context->response.varBindListLen;
+	const MibObject* object;
+	size_t nextOidLen;
+	error_t error;
+	uint_t i, j;
+	for (i = 0; i < context->mibModuleCount; i++)
+	{
+		for (j = 0; j < context->mibModule[i]->numObjects; j++)
+		{
+			object = &context->mibModule[i]->objects[j];
+			if (object->getNext == NULL)
+			{
+				nextOidLen = object->oidLen + 1;
+				if ((context->response.varBindListLen + nextOidLen) > context->response.varBindListMaxLen)
+					return ERROR_BUFFER_OVERFLOW;
+				memcpy(nextOid, object->oid, object->oidLen);
+				nextOid[nextOidLen - 1] = 0;
+				if (oidComp(var->oid, var->oidLen, nextOid, nextOidLen) < 0)
+					break;
+			}
+			else
+			{
+				nextOidLen = context->response.varBindListMaxLen - context->response.varBindListLen;
+				error = object->getNext(object, var->oid, var->oidLen, nextOid, &nextOidLen);
+				if (error == NO_ERROR)
+					break;
+				if (error != ERROR_OBJECT_NOT_FOUND)
+					return error;
+			}
+		}
+		if (j < context->mibModule[i]->numObjects)
+		{
+			var->oid = nextOid;
+			var->oidLen = nextOidLen;
+			context->response.oidLen = nextOidLen;
+			return NO_ERROR;
+		}
+	}
+	return ERROR_OBJECT_NOT_FOUND;
+}
+
+/* one GetNext from <oid>, into <next>; the error ends the walk */
+static error_t SIM_BenchMibNext(SimBenchGetNext_t getNext, const uint8_t* oid, size_t oidLen, SimBenchMibStep_t* next)
+{
+	SnmpVarBind var;
+	error_t error;
+	memset(&var, 0, sizeof(var));
+	var.oid = oid;
+	var.oidLen = oidLen;
+	snmpAgentContext.response.varBindListLen = 0;
+	error = getNext(&snmpAgentContext, &var);
+	if (error != NO_ERROR)
+		return error;
+	if (var.oidLen > SIM_BENCH_MIB_OID)
+		return ERROR_BUFFER_OVERFLOW;
+	memcpy(next->oid, var.oid, var.oidLen);
+	next->oidLen = var.oidLen;
+	return NO_ERROR;
+}
+
+/* walks the whole tree from the empty OID like snmpwalk does from a subtree;
+* the first walk records the OIDs, the others compare against them */
+static uint32_t SIM_BenchMibWalk(SimBenchMib_t* bench, SimBenchGetNext_t getNext, bool record)
+{
+	SimBenchMibStep_t step = {{0}, 0};
+	uint32_t n = 0;
+	error_t error;
+	while (n < SIM_BENCH_MIB_STEPS)
+	{
+		error = SIM_BenchMibNext(getNext, step.oid, step.oidLen, &step);
+		if (error != NO_ERROR)
+		{
+			bench->endErrors += (error != ERROR_OBJECT_NOT_FOUND);
+			return n;
+		}
+		if (record)
+		{
+			if ((n > 0) && (oidComp(mibSteps[n - 1].oid, mibSteps[n - 1].oidLen, step.oid, step.oidLen) >= 0))
+				bench->unordered++;
+			mibSteps[n] = step;
+		}
+		else if ((step.oidLen != mibSteps[n].oidLen) || memcmp(step.oid, mibSteps[n].oid, step.oidLen))
+		{
+			bench->mismatches++;
+		}
+		n++;
+	}
+	bench->endErrors++;
+	return n;
+}
+
+/* on the firmware's agent, with its mutex and the MIB locks held like for a
+* request; the agent's response is put back after */
+static void SIM_BenchMibRun(void* param)
+{
+	SimBenchMib_t* bench = param;
+	SimBenchMibStep_t oldNext, newNext, from;
+	error_t oldError, newError;
+	uint64_t start;
+	uint32_t i, n;
+	benchRandom = bench->seed;
+	osAcquireMutex(&snmpAgentContext.mutex);
+	snmpLockMib(&snmpAgentContext);
+	mibSavedResponse = snmpAgentContext.response;
+	snmpAgentContext.response.varBindList = mibVarBindList;
+	snmpAgentContext.response.varBindListMaxLen = sizeof(mibVarBindList);
+	bench->objects = snmpAgentContext.mibObjectCount;
+	bench->steps = SIM_BenchMibWalk(bench, SIM_BenchMibOldGetNext, true);
+	if (SIM_BenchMibWalk(bench, snmpGetNextObject, false) != bench->steps)
+		bench->mismatches++;
+	/* GetNext from anywhere: a random walk OID cut short and nudged, which the
+	* cursor does not hold, so the binary search runs */
+	for (i = 0; (i < bench->lookups) && (bench->steps > 0); i++)
+	{
+		from = mibSteps[SIM_BenchRandom() % bench->steps];
+		from.oidLen = 1 + SIM_BenchRandom() % from.oidLen;
+		from.oid[from.oidLen - 1] += (int)(SIM_BenchRandom() % 3) - 1;
+		snmpAgentContext.walkCursorOidLen = 0;
+		oldError = SIM_BenchMibNext(SIM_BenchMibOldGetNext, from.oid, from.oidLen, &oldNext);
+		newError = SIM_BenchMibNext(snmpGetNextObject, from.oid, from.oidLen, &newNext);
+		if ((oldError != newError) || ((oldError == NO_ERROR) && ((oldNext.oidLen != newNext.oidLen) ||
+			memcmp(oldNext.oid, newNext.oid, oldNext.oidLen))))
+		{
+			bench->lookupMismatches++;
+		}
+	}
+	start = SIM_Now();
+	for (i = 0; i < bench->walks; i++)
+		n = SIM_BenchMibWalk(bench, SIM_BenchMibOldGetNext, false);
+	bench->oldNs = SIM_Now() - start;
+	start = SIM_Now();
+	for (i = 0; i < bench->walks; i++)
+		n = SIM_BenchMibWalk(bench, snmpGetNextObject, false);
+	bench->newNs = SIM_Now() - start;
+	snmpAgentContext.walkCursorOidLen = 0;
+	snmpAgentContext.response = mibSavedResponse;
+	snmpUnlockMib(&snmpAgentContext);
+	osReleaseMutex(&snmpAgentContext.mutex);
+}
+
+static bool SIM_BenchMib(char** argv, int argc)
+{
+	SimBenchMib_t bench = {0};
+	double oldUs, newUs;
+	bench.walks = SIM_BenchNumber(argc > 1 ? argv[1] : NULL, 100);
+	bench.seed = SIM_BenchNumber(argc > 2 ? argv[2] : NULL, 1);
+	bench.lookups = 10000;
+	if ((argc > 3) || ((int32_t)bench.walks <= 0))
+		return false;
+	SIM_RunOnTarget(SIM_BenchMibRun, &bench);
+	oldUs = bench.oldNs / 1e3 / bench.walks;
+	newUs = bench.newNs / 1e3 / bench.walks;
+	SIM_Log("bench mib: %u objects, %u GetNext steps per walk", (unsigned)bench.objects, (unsigned)bench.steps);
+	SIM_Log("bench mib: walk %9.1f us linear, %7.1f us merged index (%.2f us per step)", oldUs, newUs,
+			bench.steps ? newUs / bench.steps : 0.0);
+	SIM_ScenarioCheck(bench.steps > bench.objects, bench.steps, "mib: GetNext steps per walk > %u",
+					  (unsigned)bench.objects);
+	SIM_ScenarioCheck(bench.unordered == 0, bench.unordered, "mib: OIDs not increasing == 0");
+	SIM_ScenarioCheck(bench.endErrors == 0, bench.endErrors, "mib: walks not ended by the end of the MIB == 0");
+	SIM_ScenarioCheck(bench.mismatches == 0, bench.mismatches, "mib: steps of the two walks that differ == 0");
+	SIM_ScenarioCheck(bench.lookupMismatches == 0, bench.lookupMismatches, "mib: random GetNext that differ == 0");
+	SIM_ScenarioCheck(newUs < oldUs, bench.newNs * 100 / MAX(bench.oldNs, 1), "mib: merged index / linear < 100%%");
+	return true;
+}
+
+/*==================================== CRC =====================================*/
+
+static uint32_t crcOld32Table[256];
+static uint16_t crcOldFcsTable[256];
+static uint8_t crcOldModbusHigh[256];
+static uint8_t crcOldModbusLow[256];
+static uint8_t crcData[SIM_BENCH_CRC_SIZE + 8];
+
+/* the byte tables of the former code: the same values, built here instead of
+* copied */
+static void SIM_BenchCrcOldTables(void)
+{
+	uint32_t i, j, c32, c16, cm;
+	for (i = 0; i < 256; i++)
+	{
+		c32 = c16 = cm = i;
+		for (j = 0; j < 8; j++)
+		{
+			c32 = (c32 & 1) ? (c32 >> 1) ^ 0xEDB88320 : c32 >> 1;
+			c16 = (c16 & 1) ? (c16 >> 1) ^ 0x8408 : c16 >> 1;
+			cm = (cm & 1) ? (cm >> 1) ^ 0xA001 : cm >> 1;
+		}
+		crcOld32Table[i] = c32;
+		crcOldFcsTable[i] = c16;
+		crcOldModbusHigh[i] = cm & 0xFF;
+		crcOldModbusLow[i] = cm >> 8;
+	}
+}
+
+/* ethCalcCrc with ETH_FAST_CRC_SUPPORT */
+static uint32_t SIM_BenchCrcOld32(const uint8_t* p, size_t length)
+{
+	uint32_t crc = 0xFFFFFFFF;
+	size_t i;
+	for (i = 0; i < length; i++)
+		crc = (crc >> 8) ^ crcOld32Table[(crc & 0xFF) ^ p[i]];
+	return ~crc;
+}
+
+/* pppCalcFcs */
+static uint16_t SIM_BenchCrcOldFcs(const uint8_t* p, size_t length)
+{
+	uint16_t fcs = 0xFFFF;
+	size_t i;
+	for (i = 0; i < length; i++)
+		fcs = (fcs >> 8) ^ crcOldFcsTable[(fcs & 0xFF) ^ p[i]];
+	return ~fcs;
+}
+
+/* ModbusCRC of rs485.c, the high byte is the one sent first */
+static uint16_t SIM_BenchCrcOldModbus(const uint8_t* p, size_t length)
+{
+	uint8_t high = 0xFF, low = 0xFF, index;
+	while (length--)
+	{
+		index = *p++ ^ high;
+		high = crcOldModbusHigh[index] ^ low;
+		low = crcOldModbusLow[index];
+	}
+	return high | (low << 8);
+}
+
+/* no former CRC-8, bit by bit */
+static uint8_t SIM_BenchCrcBitwise8(const uint8_t* p, size_t length)
+{
+	uint8_t crc = 0;
+	uint32_t j;
+	while (length--)
+	{
+		crc ^= *p++;
+		for (j = 0; j < 8; j++)
+			crc = (crc & 0x80) ? (crc << 1) ^ 0x07 : crc << 1;
+	}
+	return crc;
+}
+
+/* random offset and length, the new CRC in two Update calls split at a random
+* point against the former one in a single call */
+static void SIM_BenchCrcCompare(SimBenchCrc_t* bench, const uint8_t* p, size_t length, size_t split)
+{
+	if (crc32Update(crc32Calc(p, split), p + split, length - split) != SIM_BenchCrcOld32(p, length))
+		bench->mismatches[0]++;
+	if (crc16FcsUpdate(crc16FcsCalc(p, split), p + split, length - split) != SIM_BenchCrcOldFcs(p, length))
+		bench->mismatches[1]++;
+	if (crc16ModbusUpdate(crc16ModbusCalc(p, split), p + split, length - split) != SIM_BenchCrcOldModbus(p, length))
+		bench->mismatches[2]++;
+	if (crc8Update(crc8Calc(p, split), p + split, length - split) != SIM_BenchCrcBitwise8(p, length))
+		bench->mismatches[3]++;
+}
+
+static void SIM_BenchCrcRun(void* param)
+{
+	SimBenchCrc_t* bench = param;
+	static const char check[] = "123456789";
+	volatile uint32_t sink = 0;
+	uint64_t start, ns[4][2];
+	size_t length, offset;
+	uint32_t i, k;
+	benchRandom = bench->seed;
+	SIM_BenchCrcOldTables();
+	bench->check[0] = crc32Calc(check, 9);
+	bench->check[1] = crc16FcsCalc(check, 9);
+	bench->check[2] = crc16ModbusCalc(check, 9);
+	bench->check[3] = crc8Calc(check, 9);
+	for (i = 0; i < sizeof(crcData); i++)
+		crcData[i] = SIM_BenchRandom();
+	for (i = 0; i < bench->cases; i++)
+	{
+		offset = SIM_BenchRandom() % 8;
+		length = SIM_BenchRandom() % (SIM_BENCH_CRC_SIZE + 1);
+		SIM_BenchCrcCompare(bench, crcData + offset, length, length ? SIM_BenchRandom() % (length + 1) : 0);
+	}
+	/* MB/s over an Ethernet payload; CRC-32 is continued after the first
+	* word so that the tables run rather than the simulated CRC module */
+	memset(ns, 0, sizeof(ns));
+	for (k = 0; k < SIM_BENCH_CRC_ROUNDS; k++)
+	{
+		start = SIM_Now();
+		sink += SIM_BenchCrcOld32(crcData, SIM_BENCH_CRC_SIZE);
+		ns[0][0] += SIM_Now() - start;
+		start = SIM_Now();
+		sink += crc32Update(crc32Calc(crcData, 4), crcData + 4, SIM_BENCH_CRC_SIZE - 4);
+		ns[0][1] += SIM_Now() - start;
+		start = SIM_Now();
+		sink += SIM_BenchCrcOldFcs(crcData, SIM_BENCH_CRC_SIZE);
+		ns[1][0] += SIM_Now() - start;
+		start = SIM_Now();
+		sink += crc16FcsCalc(crcData, SIM_BENCH_CRC_SIZE);
+		ns[1][1] += SIM_Now() - start;
+		start = SIM_Now();
+		sink += SIM_BenchCrcOldModbus(crcData, SIM_BENCH_CRC_SIZE);
+		ns[2][0] += SIM_Now() - start;
+		start = SIM_Now();
+		sink += crc16ModbusCalc(crcData, SIM_BENCH_CRC_SIZE);
+		ns[2][1] += SIM_Now() - start;
+		start = SIM_Now();
+		sink += SIM_BenchCrcBitwise8(crcData, SIM_BENCH_CRC_SIZE);
+		ns[3][0] += SIM_Now() - start;
+		start = SIM_Now();
+		sink += crc8Calc(crcData, SIM_BENCH_CRC_SIZE);
+		ns[3][1] += SIM_Now() - start;
+	}
+	for (i = 0; i < 4; i++)
+	{
+		for (k = 0; k < 2; k++)
+			bench->mbps[i][k] = (double)SIM_BENCH_CRC_ROUNDS * SIM_BENCH_CRC_SIZE / (ns[i][k] / 1e3);
+	}
+}
+
+static bool SIM_BenchCrc(char** argv, int argc)
+{
+	SimBenchCrc_t bench = {0};
+	uint32_t i;
+	bench.cases = SIM_BenchNumber(argc > 1 ? argv[1] : NULL, 100000);
+	bench.seed = SIM_BenchNumber(argc > 2 ? argv[2] : NULL, 1);
+	if ((argc > 3) || ((int32_t)bench.cases <= 0))
+		return false;
+	SIM_RunOnTarget(SIM_BenchCrcRun, &bench);
+	for (i = 0; i < 4; i++)
+	{
+		SIM_Log("bench crc: %-13s %6.1f MB/s (%s %6.1f)", crcNames[i], bench.mbps[i][1], i < 3 ? "former" : "bitwise",
+				bench.mbps[i][0]);
+	}
+	for (i = 0; i < 4; i++)
+	{
+		SIM_ScenarioCheck(bench.check[i] == crcChecks[i], bench.check[i], "crc: %s of \"123456789\" == %X", crcNames[i],
+						  (unsigned)crcChecks[i]);
+		SIM_ScenarioCheck(bench.mismatches[i] == 0, bench.mismatches[i], "crc: %s split != %s == 0", crcNames[i],
+						  i < 3 ? "former" : "bitwise");
+	}
+	for (i = 0; i < 3; i++)
+	{
+		SIM_ScenarioCheck(bench.mbps[i][1] > bench.mbps[i][0], bench.mbps[i][1] * 100 / bench.mbps[i][0],
+						  "crc: %s / former > 100%%", crcNames[i]);
+	}
+	return true;
+}
+
+/*================================ SNMPv3 USM ==================================*/
+
+static SnmpAgentContext usmContexts[2];
+static uint8_t usmSavedSlot[SNMP_KEY_CACHE_ENTRY_SIZE];
+static uint8_t usmPdu[SIM_BENCH_USM_PDU];
+
+static uint16_t SIM_BenchUsmSlotAddr(uint_t i)
+{
+	return SNMP_KEY_CACHE_EEPROM_ADDR + SIM_BENCH_USM_SLOT * SNMP_KEY_CACHE_ENTRY_SIZE + i;
+}
+
+/* a booting agent: a context of its own with the firmware's engine ID, whose
+* user is created from the cache slot */
+static error_t SIM_BenchUsmBoot(SnmpAgentContext* context, SnmpUserInfo** user)
+{
+	error_t error;
+	memset(context, 0, sizeof(SnmpAgentContext));
+	if (!osCreateMutex(&context->mutex))
+		return ERROR_OUT_OF_RESOURCES;
+	snmpAgentSetContextEngine(context, snmpAgentContext.contextEngine, snmpAgentContext.contextEngineLen);
+	/* the cache is read before the scheduler starts, here the I2C bus is
+	* taken like at run time; the scheduler stays on for the agent mutex */
+	I2C_Get_Lock();
+	error = SnmpKeyCacheCreateUser(context, SIM_BENCH_USM_SLOT, "usr-bench", SNMP_ACCESS_READ_WRITE,
+								   SNMP_AUTH_PROTOCOL_MD5, "authbench", SNMP_PRIV_PROTOCOL_AES, "privbench");
+	I2C_Release_Lock();
+	*user = snmpFindUser(context, "usr-bench", 9);
+	return (!error && (*user == NULL)) ? ERROR_FAILURE : error;
+}
+
+/* msgAuthenticationParameters of a PDU of random bytes */
+static void SIM_BenchUsmMessage(SnmpMessage* message)
+{
+	memset(message, 0, sizeof(SnmpMessage));
+	message->pos = usmPdu;
+	message->length = sizeof(usmPdu);
+	memcpy(message->buffer, usmPdu, sizeof(usmPdu));
+	message->bufferLen = sizeof(usmPdu);
+	message->msgAuthParameters = message->buffer + SIM_BENCH_USM_AUTH_OFFSET;
+	message->msgAuthParametersLen = SIM_BENCH_USM_MAC_SIZE;
+	memset(message->msgAuthParameters, 0, SIM_BENCH_USM_MAC_SIZE);
+	message->pos = message->buffer;
+}
+
+static void SIM_BenchUsmRun(void* param)
+{
+	SimBenchUsm_t* bench = param;
+	static SnmpMessage message;
+	SnmpUserInfo *cold = NULL, *cached = NULL;
+	HmacContext hmacContext;
+	SnmpKey key;
+	uint64_t start;
+	uint32_t i;
+	benchRandom = bench->seed;
+	for (i = 0; i < sizeof(usmPdu); i++)
+		usmPdu[i] = SIM_BenchRandom();
+	/* the slot is the firmware's, it is put back after */
+	I2C_Get_Lock();
+	vTaskSuspendAll();
+	for (i = 0; i < SNMP_KEY_CACHE_ENTRY_SIZE; i++)
+		usmSavedSlot[i] = ReadEEPROM_Byte(SIM_BenchUsmSlotAddr(i));
+	WriteEEPROM_Byte(SIM_BenchUsmSlotAddr(0), ~usmSavedSlot[0]);
+	xTaskResumeAll();
+	I2C_Release_Lock();
+	/* the two keys computed from the passwords, the cost of a cold boot
+	* without its EEPROM writes; the best of a few, the scheduler runs */
+	bench->localizeNs = UINT64_MAX;
+	for (i = 0; i < 3; i++)
+	{
+		start = SIM_Now();
+		snmpGenerateKey(SNMP_AUTH_PROTOCOL_MD5, "authbench", snmpAgentContext.contextEngine,
+						snmpAgentContext.contextEngineLen, &key);
+		snmpGenerateKey(SNMP_AUTH_PROTOCOL_MD5, "privbench", snmpAgentContext.contextEngine,
+						snmpAgentContext.contextEngineLen, &key);
+		bench->localizeNs = MIN(bench->localizeNs, SIM_Now() - start);
+	}
+	start = SIM_Now();
+	bench->coldError = SIM_BenchUsmBoot(&usmContexts[0], &cold);
+	bench->coldNs = SIM_Now() - start;
+	start = SIM_Now();
+	bench->cachedError = SIM_BenchUsmBoot(&usmContexts[1], &cached);
+	bench->cachedNs = SIM_Now() - start;
+	if ((cold != NULL) && (cached != NULL))
+	{
+		bench->keysDiffer = memcmp(&cold->authKey, &cached->authKey, sizeof(SnmpKey)) ||
+			memcmp(&cold->privKey, &cached->privKey, sizeof(SnmpKey));
+		/* a PDU signed with the keys of the cold boot is accepted with the
+		* cached ones, and refused once a byte changes */
+		SIM_BenchUsmMessage(&message);
+		hmacInit(&hmacContext, MD5_HASH_ALGO, cold->authKey.b, MD5_DIGEST_SIZE);
+		hmacUpdate(&hmacContext, message.buffer, message.bufferLen);
+		hmacFinal(&hmacContext, NULL);
+		bench->outError = snmpAuthOutgoingMessage(cold, &message);
+		bench->macDiffers = memcmp(hmacContext.digest, message.msgAuthParameters, SIM_BENCH_USM_MAC_SIZE) != 0;
+		bench->inError = snmpAuthIncomingMessage(cached, &message);
+		message.buffer[SIM_BenchRandom() % SIM_BENCH_USM_AUTH_OFFSET] ^= 1 << (SIM_BenchRandom() % 8);
+		bench->tamperedError = snmpAuthIncomingMessage(cached, &message);
+		/* per PDU, from the saved pad states and with hmacInit as before */
+		SIM_BenchUsmMessage(&message);
+		start = SIM_Now();
+		for (i = 0; i < bench->pdus; i++)
+			snmpAuthOutgoingMessage(cold, &message);
+		bench->padsNs = SIM_Now() - start;
+		start = SIM_Now();
+		for (i = 0; i < bench->pdus; i++)
+		{
+			hmacInit(&hmacContext, MD5_HASH_ALGO, cold->authKey.b, MD5_DIGEST_SIZE);
+			hmacUpdate(&hmacContext, message.pos, message.length);
+			hmacFinal(&hmacContext, NULL);
+			memcpy(message.msgAuthParameters, hmacContext.digest, SIM_BENCH_USM_MAC_SIZE);
+		}
+		bench->hmacNs = SIM_Now() - start;
+	}
+	osDeleteMutex(&usmContexts[0].mutex);
+	osDeleteMutex(&usmContexts[1].mutex);
+	memset(usmContexts, 0, sizeof(usmContexts));
+	I2C_Get_Lock();
+	vTaskSuspendAll();
+	for (i = 0; i < sizeof(SnmpKeyCacheEntry); i++)
+		WriteEEPROM_Byte(SIM_BenchUsmSlotAddr(i), usmSavedSlot[i]);
+	for (i = 0; i < SNMP_KEY_CACHE_ENTRY_SIZE; i++)
+		bench->slotChanged += (ReadEEPROM_Byte(SIM_BenchUsmSlotAddr(i)) != usmSavedSlot[i]);
+	xTaskResumeAll();
+	I2C_Release_Lock();
+}
+
+static bool SIM_BenchUsm(char** argv, int argc)
+{
+	SimBenchUsm_t bench = {0};
+	bench.pdus = SIM_BenchNumber(argc > 1 ? argv[1] : NULL, 100000);
+	bench.seed = SIM_BenchNumber(argc > 2 ? argv[2] : NULL, 1);
+	if ((argc > 3) || ((int32_t)bench.pdus <= 0))
+		return false;
+	SIM_RunOnTarget(SIM_BenchUsmRun, &bench);
+	SIM_Log("bench usm: boot %.1f ms cold (localization %.1f ms), %.1f ms cached", bench.coldNs / 1e6,
+			bench.localizeNs / 1e6, bench.cachedNs / 1e6);
+	SIM_Log("bench usm: the cold boot also writes %u EEPROM bytes, %u ms on the target", (unsigned)sizeof(SnmpKeyCacheEntry),
+			(unsigned)(sizeof(SnmpKeyCacheEntry) * SIM_BENCH_USM_EEPROM_WRITE_MS));
+	SIM_Log("bench usm: HMAC-MD5 of a %u byte PDU %.2f us from the pad states, %.2f us with hmacInit",
+			(unsigned)SIM_BENCH_USM_PDU, bench.padsNs / 1e3 / bench.pdus, bench.hmacNs / 1e3 / bench.pdus);
+	SIM_ScenarioCheck(bench.coldError == NO_ERROR, bench.coldError, "usm: cold boot error == 0");
+	SIM_ScenarioCheck(bench.cachedError == NO_ERROR, bench.cachedError, "usm: cached boot error == 0");
+	SIM_ScenarioCheck(bench.cachedNs < bench.localizeNs, bench.cachedNs * 100 / MAX(bench.localizeNs, 1),
+					  "usm: cached boot / localization < 100%%");
+	SIM_ScenarioCheck(!bench.keysDiffer, bench.keysDiffer, "usm: cached keys != localized keys == 0");
+	SIM_ScenarioCheck(bench.outError == NO_ERROR && !bench.macDiffers, bench.outError ? bench.outError : bench.macDiffers,
+					  "usm: MAC from the pad states != HMAC == 0");
+	SIM_ScenarioCheck(bench.inError == NO_ERROR, bench.inError, "usm: PDU authenticated with the cached keys, error == 0");
+	SIM_ScenarioCheck(bench.tamperedError == ERROR_AUTHENTICATION_FAILED, bench.tamperedError,
+					  "usm: PDU with a flipped bit, error == %u", ERROR_AUTHENTICATION_FAILED);
+	SIM_ScenarioCheck(bench.slotChanged == 0, bench.slotChanged, "usm: bytes of the cache slot not restored == 0");
+	SIM_ScenarioCheck(bench.padsNs < bench.hmacNs, bench.padsNs * 100 / MAX(bench.hmacNs, 1),
+					  "usm: pad states / hmacInit < 100%%");
+	return true;
+}
+
+/*=============================== packet capture ===============================*/
+
+/* an Ethernet interface the stack does not know, so that the frames the
+* firmware exchanges meanwhile stay out of the ring */
+static NetInterface captureInterface;
+static NicDriver captureDriver;
+static uint8_t captureFrame[SIM_BENCH_CAPTURE_FRAME];
+
+/* a UDP datagram from and to SIM_BENCH_CAPTURE_PORT */
+static void SIM_BenchCaptureFrame(void)
+{
+	uint8_t* ip = captureFrame + sizeof(EthHeader);
+	uint32_t i;
+	for (i = 0; i < sizeof(captureFrame); i++)
+		captureFrame[i] = SIM_BenchRandom();
+	STORE16BE(ETH_TYPE_IPV4, captureFrame + 12);
+	memset(ip, 0, sizeof(Ipv4Header));
+	ip[0] = 0x45;
+	STORE16BE(sizeof(captureFrame) - sizeof(EthHeader), ip + 2);
+	ip[8] = 64;
+	ip[9] = IPV4_PROTOCOL_UDP;
+	STORE16BE(SIM_BENCH_CAPTURE_PORT, ip + sizeof(Ipv4Header));
+	STORE16BE(SIM_BENCH_CAPTURE_PORT, ip + sizeof(Ipv4Header) + 2);
+}
+
+/* the hooks as nicProcessPacket and nicSendPacket call them, under the
+* stack mutex like in netTask */
+static void SIM_BenchCaptureCase(SimBenchCapture_t* bench, uint32_t c, NetInterface* interface,
+								 const NetBuffer* buffer)
+{
+	uint64_t start;
+	uint32_t i;
+	osAcquireMutex(&netMutex);
+	start = SIM_Now();
+	for (i = 0; i < bench->packets; i++)
+	{
+		if (netCaptureRunning)
+			netCaptureRxPacket(interface, captureFrame, sizeof(captureFrame));
+	}
+	bench->ns[c][0] = (double)(SIM_Now() - start) / bench->packets;
+	start = SIM_Now();
+	for (i = 0; i < bench->packets; i++)
+	{
+		if (netCaptureRunning)
+			netCaptureTxPacket(interface, buffer, 0);
+	}
+	bench->ns[c][1] = (double)(SIM_Now() - start) / bench->packets;
+	osReleaseMutex(&netMutex);
+}
+
+static void SIM_BenchCaptureRun(void* param)
+{
+	SimBenchCapture_t* bench = param;
+	NetCaptureFilter filter;
+	NetBuffer* buffer;
+	benchRandom = 1;
+	memset(&captureInterface, 0, sizeof(captureInterface));
+	memset(&captureDriver, 0, sizeof(captureDriver));
+	captureDriver.type = NIC_TYPE_ETHERNET;
+	captureInterface.nicDriver = &captureDriver;
+	SIM_BenchCaptureFrame();
+	buffer = netBufferAlloc(sizeof(captureFrame));
+	if (buffer == NULL)
+	{
+		bench->error = ERROR_OUT_OF_MEMORY;
+		return;
+	}
+	netBufferWrite(buffer, 0, captureFrame, sizeof(captureFrame));
+	netCaptureStop();
+	SIM_BenchCaptureCase(bench, 0, &captureInterface, buffer);
+	memset(&filter, 0, sizeof(filter));
+	filter.interface = &captureInterface;
+	bench->error = netCaptureStart(&filter);
+	SIM_BenchCaptureCase(bench, 3, &netInterface[0], buffer);
+	filter.port = SIM_BENCH_CAPTURE_PORT + 1;
+	if (!bench->error)
+		bench->error = netCaptureStart(&filter);
+	SIM_BenchCaptureCase(bench, 2, &captureInterface, buffer);
+	/* last, so that the ring holds the frames of this one for the export */
+	filter.port = 0;
+	if (!bench->error)
+		bench->error = netCaptureStart(&filter);
+	SIM_BenchCaptureCase(bench, 1, &captureInterface, buffer);
+	netCaptureStop();
+	netBufferFree(buffer);
+}
+
+static bool SIM_BenchCapture(char** argv, int argc)
+{
+	SimBenchCapture_t bench = {0};
+	uint32_t c;
+	bench.packets = SIM_BenchNumber(argc > 1 ? argv[1] : NULL, 1000000);
+	if ((argc > 2) || ((int32_t)bench.packets <= 0))
+		return false;
+	SIM_RunOnTarget(SIM_BenchCaptureRun, &bench);
+	for (c = 0; c < 4; c++)
+	{
+		SIM_Log("bench capture: %-15s %6.1f ns received, %6.1f ns sent per %u byte frame", captureCases[c],
+				bench.ns[c][0], bench.ns[c][1], (unsigned)SIM_BENCH_CAPTURE_FRAME);
+	}
+	SIM_ScenarioCheck(bench.error == NO_ERROR, bench.error, "capture: start error == 0");
+	for (c = 0; c < 2; c++)
+	{
+		SIM_ScenarioCheck(bench.ns[0][c] < bench.ns[1][c], bench.ns[0][c] * 100 / MAX(bench.ns[1][c], 1),
+						  "capture: %s disabled / kept < 100%%", c ? "sent" : "received");
+	}
+	/* received and sent frames of the last case, the oldest overwritten */
+	SIM_CaptureCheck(&captureInterface, "bench", "==", MIN(2 * (uint64_t)bench.packets, NET_CAPTURE_RECORD_COUNT));
+	return true;
+}
+
+/*=================================== command ==================================*/
+
+bool SIM_Bench(char** argv, int argc)
+{
+	if (strcmp(argv[0], "mem") == 0)
+		return SIM_BenchMem(argv, argc);
+	if (strcmp(argv[0], "memsoak") == 0)
+		return SIM_BenchMemSoak(argv, argc);
+	if (strcmp(argv[0], "checksum") == 0)
+		return SIM_BenchChecksum(argv, argc);
+	if (strcmp(argv[0], "tcp") == 0)
+		return SIM_BenchTcp(argv, argc);
+	if (strcmp(argv[0], "timers") == 0)
+		return SIM_BenchTimers(argv, argc);
+	if (strcmp(argv[0], "demux") == 0)
+		return SIM_BenchDemux(argv, argc);
+	if (strcmp(argv[0], "frag") == 0)
+		return SIM_BenchFrag(argv, argc);
+	if (strcmp(argv[0], "hdlc") == 0)
+		return SIM_BenchHdlc(argv, argc);
+	if (strcmp(argv[0], "snapshot") == 0)
+		return SIM_BenchSnapshot(argv, argc);
+	if (strcmp(argv[0], "mib") == 0)
+		return SIM_BenchMib(argv, argc);
+	if (strcmp(argv[0], "crc") == 0)
+		return SIM_BenchCrc(argv, argc);
+	if (strcmp(argv[0], "usm") == 0)
+		return SIM_BenchUsm(argv, argc);
+	if (strcmp(argv[0], "capture") == 0)
+		return SIM_BenchCapture(argv, argc);
+	return false;
+}
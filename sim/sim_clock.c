@@ -0,0 +1,24 @@
+/* sim_clock.c
+* Clock setup of the board, the simulated core runs at the frequency
+* BOARD_BootClockRUN sets on the target
+*/
+#include "fsl_clock.h"
+#include "clock_config.h"
+#include "sim.h"
+
+void BOARD_BootClockRUN(void)
+{
+	SystemCoreClock = SIM_CORE_CLOCK;
+}
+
+uint32_t CLOCK_GetFreq(clock_name_t clockName)
+{
+	switch (clockName)
+	{
+	case kCLOCK_CoreSysClk:
+	case kCLOCK_PlatClk:
+		return SIM_CORE_CLOCK;
+	default:
+		return SIM_BUS_CLOCK;
+	}
+}
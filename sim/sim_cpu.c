@@ -0,0 +1,599 @@
+/* sim_cpu.c
+* The parts of the Cortex-M that the FreeRTOS POSIX port does not cover:
+* PRIMASK, the NVIC enable bits, system reset, the DWT cycle counter, and the
+* SIM task through which the scenario engine reads the kernel state
+*/
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "MK66F18.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "sim.h"
+
+#define SIM_TASK_STACK_SIZE			256
+#define SIM_TASK_SAMPLE_PERIOD		1000	/* run time counters wrap after 23 s at 180 MHz */
+#define SIM_TASK_MAX				32
+
+typedef struct {
+	UBaseType_t number;
+	char name[configMAX_TASK_NAME_LEN];
+	UBaseType_t priority;
+	uint32_t lastCounter;
+	uint64_t cycles;
+	bool alive;
+} SimTaskStat_t;
+
+static const IRQn_Type irqNumbers[SIM_IRQ_COUNT] = {
+	UART1_RX_TX_IRQn, UART3_RX_TX_IRQn, UART4_RX_TX_IRQn, ENET_Receive_IRQn, NotAvail_IRQn,
+	DMA0_DMA16_IRQn, DMA1_DMA17_IRQn, DMA2_DMA18_IRQn, DMA3_DMA19_IRQn
+};
+
+static struct timespec startTime;
+static __thread bool hostThread;
+static __thread bool firmwareThread;
+static __thread int lockDepth;
+static pthread_mutex_t simMutex = PTHREAD_MUTEX_INITIALIZER;
+static volatile bool targetStopped;
+
+static volatile uint32_t irqEnabled = 1u << SIM_IRQ_REQUEST;
+static volatile uint32_t irqPending;
+
+static TaskHandle_t simTask;
+static pthread_mutex_t requestMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t requestCond = PTHREAD_COND_INITIALIZER;
+static void (*requestFunction)(void*);
+static void* requestParam;
+static bool requestDone;
+
+static TaskStatus_t taskStatus[SIM_TASK_MAX];
+static SimTaskStat_t taskStats[SIM_TASK_MAX];
+static uint32_t taskStatCount;
+static uint32_t lastTotalCounter;
+static uint64_t totalCycles;
+static void* switchTasks[SIM_TASK_MAX];
+static uint32_t switchCounts[SIM_TASK_MAX];
+
+/*============================== time and output ===============================*/
+
+uint64_t SIM_Now(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)(now.tv_sec - startTime.tv_sec) * 1000000000ULL + now.tv_nsec - startTime.tv_nsec;
+}
+
+void SIM_SleepUntil(uint64_t ns)
+{
+	struct timespec deadline;
+	ns += (uint64_t)startTime.tv_sec * 1000000000ULL + startTime.tv_nsec;
+	deadline.tv_sec = ns / 1000000000ULL;
+	deadline.tv_nsec = ns % 1000000000ULL;
+	/* the tick interrupts a task thread, which may be switched out and come
+	* back later, the deadline stays the same */
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL) == EINTR)
+	{
+	}
+}
+
+void SIM_SleepFor(uint64_t ns)
+{
+	SIM_SleepUntil(SIM_Now() + ns);
+}
+
+/* formatted without stdio locks and written at once, so a task switched out
+* in the middle of a printf never blocks the simulation output */
+static void SIM_VLog(const char* prefix, const char* format, va_list args)
+{
+	char buffer[512];
+	uint64_t now = SIM_Now();
+	int n = snprintf(buffer, sizeof(buffer), "[%5u.%06u] %s", (unsigned)(now / 1000000000ULL),
+					 (unsigned)(now / 1000ULL % 1000000ULL), prefix);
+	n += vsnprintf(buffer + n, sizeof(buffer) - n - 1, format, args);
+	if (n > (int)sizeof(buffer) - 2)
+		n = sizeof(buffer) - 2;
+	buffer[n++] = '\n';
+	if (write(STDOUT_FILENO, buffer, n) < 0)
+		return;
+}
+
+void SIM_Log(const char* format, ...)
+{
+	va_list args;
+	va_start(args, format);
+	SIM_VLog("sim: ", format, args);
+	va_end(args);
+}
+
+void SIM_Fatal(const char* format, ...)
+{
+	va_list args;
+	va_start(args, format);
+	SIM_VLog("sim: fatal: ", format, args);
+	va_end(args);
+	_exit(2);
+}
+
+/* stdio is not flushed, a suspended task may hold its lock */
+void SIM_Exit(int code)
+{
+	_exit(code);
+}
+
+/*================================== threads ===================================*/
+
+/* the host threads keep the signals masked, on a task thread the interrupts
+* are held off rather than masked, which costs no system call on every pin
+* access of the bit-banged buses */
+void SIM_Lock(void)
+{
+	if (lockDepth++ > 0)
+		return;
+	vPortHoldInterrupts();
+	pthread_mutex_lock(&simMutex);
+}
+
+void SIM_Unlock(void)
+{
+	if (--lockDepth > 0)
+		return;
+	pthread_mutex_unlock(&simMutex);
+	vPortReleaseInterrupts();
+}
+
+void SIM_SetHostThread(void)
+{
+	hostThread = true;
+}
+
+void SIM_EnterFirmware(void)
+{
+	firmwareThread = true;
+}
+
+bool SIM_IsHostThread(void)
+{
+	return hostThread;
+}
+
+typedef struct {
+	void* (*entry)(void*);
+	void* param;
+} SimThreadStart_t;
+
+static void* SIM_ThreadEntry(void* param)
+{
+	SimThreadStart_t start = *(SimThreadStart_t*)param;
+	/* before the first C library call: on a thread taken for a task the
+	* locks suspend the scheduler, whose critical section unmasks the
+	* interrupt signals and lets the tick run on this thread */
+	SIM_SetHostThread();
+	free(param);
+	return start.entry(start.param);
+}
+
+/* device threads never take the interrupt signals */
+int SIM_StartThread(void* (*entry)(void*), void* param)
+{
+	pthread_t thread;
+	sigset_t all, saved;
+	SimThreadStart_t* start = malloc(sizeof(SimThreadStart_t));
+	int error;
+	if (start == NULL)
+		return -1;
+	start->entry = entry;
+	start->param = param;
+	sigfillset(&all);
+	pthread_sigmask(SIG_BLOCK, &all, &saved);
+	error = pthread_create(&thread, NULL, SIM_ThreadEntry, start);
+	pthread_sigmask(SIG_SETMASK, &saved, NULL);
+	if (error)
+	{
+		free(start);
+		return -1;
+	}
+	pthread_detach(thread);
+	return 0;
+}
+
+bool SIM_TargetStarted(void)
+{
+	return xTaskGetSchedulerState() == taskSCHEDULER_RUNNING;
+}
+
+/* stopped for good by a reset request, the SIM task no longer runs */
+bool SIM_TargetStopped(void)
+{
+	return targetStopped;
+}
+
+/* firmware code running as a FreeRTOS task, as opposed to the startup code,
+* the device threads and the interrupt handlers */
+static bool SIM_InTask(void)
+{
+	return !hostThread && SIM_TargetStarted() && !xPortIsInsideInterrupt();
+}
+
+/*=========================== PRIMASK, reset, counters ===========================*/
+
+void SIM_DisableIrq(void)
+{
+	if (SIM_InTask())
+		vPortDisableInterrupts();
+}
+
+void SIM_EnableIrq(void)
+{
+	if (SIM_InTask())
+		vPortEnableInterrupts();
+}
+
+uint32_t SIM_GetPrimask(void)
+{
+	sigset_t mask;
+	if (!SIM_InTask())
+		return 0;
+	pthread_sigmask(SIG_BLOCK, NULL, &mask);
+	return sigismember(&mask, SIGALRM) ? 1 : 0;
+}
+
+void SIM_DataSyncBarrier(void)
+{
+	if ((SCB->AIRCR & SCB_AIRCR_SYSRESETREQ_Msk) == 0)
+		return;
+	/* the task stops here, the report runs on its thread as a host thread */
+	vTaskSuspendAll();
+	targetStopped = true;
+	SIM_SetHostThread();
+	SIM_Log("target reset requested");
+	SIM_ScenarioReport();
+	SIM_Exit(3);
+}
+
+void SIM_WaitForInterrupt(void)
+{
+	SIM_SleepFor(SIM_US(100));
+}
+
+uint32_t SIM_GetCycleCount(void)
+{
+	return (uint32_t)(SIM_Now() * (SIM_CORE_CLOCK / 1000000UL) / 1000ULL);
+}
+
+void SIM_AssertFailed(const char* file, int line)
+{
+	SIM_Log("assertion failed in %s:%d", file, line);
+	abort();
+}
+
+/*=============================== C library locks ================================*/
+
+/* The C library allocator and stdio lock a mutex. A task switched out by the
+* tick while it holds one would block every other task that needs it, so the
+* scheduler is suspended around the calls made by the tasks, as the target
+* would with its own allocator lock */
+void* __real_malloc(size_t size);
+void __real_free(void* ptr);
+void* __real_calloc(size_t count, size_t size);
+void* __real_realloc(void* ptr, size_t size);
+
+#define SIM_LIBC_CALL(result, call)			\
+	do {									\
+		if (SIM_InTask())					\
+		{									\
+			vTaskSuspendAll();				\
+			result = call;					\
+			(void)xTaskResumeAll();			\
+		}									\
+		else								\
+			result = call;					\
+	} while (0)
+
+void* __wrap_malloc(size_t size)
+{
+	void* p;
+	SIM_LIBC_CALL(p, __real_malloc(size));
+	return p;
+}
+
+void __wrap_free(void* ptr)
+{
+	int dummy;
+	SIM_LIBC_CALL(dummy, (__real_free(ptr), 0));
+	(void)dummy;
+}
+
+void* __wrap_calloc(size_t count, size_t size)
+{
+	void* p;
+	SIM_LIBC_CALL(p, __real_calloc(count, size));
+	return p;
+}
+
+void* __wrap_realloc(void* ptr, size_t size)
+{
+	void* p;
+	SIM_LIBC_CALL(p, __real_realloc(ptr, size));
+	return p;
+}
+
+/* the console of the firmware (its printf and the TRACE macros) is stderr,
+* stdout carries the output of the simulation */
+static FILE* SIM_Console(void)
+{
+	return (hostThread && !firmwareThread) ? stdout : stderr;
+}
+
+int __wrap_vprintf(const char* format, va_list args)
+{
+	int n;
+	SIM_LIBC_CALL(n, vfprintf(SIM_Console(), format, args));
+	return n;
+}
+
+int __wrap_printf(const char* format, ...)
+{
+	va_list args;
+	int n;
+	va_start(args, format);
+	n = __wrap_vprintf(format, args);
+	va_end(args);
+	return n;
+}
+
+int __wrap_puts(const char* s)
+{
+	int n;
+	SIM_LIBC_CALL(n, (fputs(s, SIM_Console()), fputc('\n', SIM_Console())));
+	return n;
+}
+
+int __wrap_putchar(int c)
+{
+	int n;
+	SIM_LIBC_CALL(n, fputc(c, SIM_Console()));
+	return n;
+}
+
+/*============================ interrupt controller ============================*/
+
+static int SIM_IrqLine(IRQn_Type irq)
+{
+	int line;
+	for (line = 0; line < SIM_IRQ_COUNT; line++)
+	{
+		if (irqNumbers[line] == irq)
+			return line;
+	}
+	return -1;
+}
+
+void NVIC_EnableIRQ(IRQn_Type IRQn)
+{
+	int line = SIM_IrqLine(IRQn);
+	if (line < 0)
+		return;
+	__atomic_fetch_or(&irqEnabled, 1u << line, __ATOMIC_SEQ_CST);
+	/* an interrupt raised while the line was off is taken now */
+	if (__atomic_load_n(&irqPending, __ATOMIC_SEQ_CST) & (1u << line))
+		vPortGenerateSimulatedInterrupt(line);
+}
+
+void NVIC_DisableIRQ(IRQn_Type IRQn)
+{
+	int line = SIM_IrqLine(IRQn);
+	if (line >= 0)
+		__atomic_fetch_and(&irqEnabled, ~(1u << line), __ATOMIC_SEQ_CST);
+}
+
+void SIM_RaiseIrq(uint32_t line)
+{
+	__atomic_fetch_or(&irqPending, 1u << line, __ATOMIC_SEQ_CST);
+	if (__atomic_load_n(&irqEnabled, __ATOMIC_SEQ_CST) & (1u << line))
+		vPortGenerateSimulatedInterrupt(line);
+}
+
+/* takes the pending interrupt of a line, it stays pending while the line is
+* disabled */
+static bool SIM_IrqTake(uint32_t line)
+{
+	if ((__atomic_load_n(&irqEnabled, __ATOMIC_SEQ_CST) & (1u << line)) == 0)
+		return false;
+	return (__atomic_fetch_and(&irqPending, ~(1u << line), __ATOMIC_SEQ_CST) & (1u << line)) != 0;
+}
+
+static void SIM_IsrUart1(void)
+{
+	if (SIM_IrqTake(SIM_IRQ_UART1))
+		SIM_UartIsr(SIM_UART_MODEM);
+}
+
+static void SIM_IsrUart3(void)
+{
+	if (SIM_IrqTake(SIM_IRQ_UART3))
+		SIM_UartIsr(SIM_UART_MODBUS);
+}
+
+static void SIM_IsrUart4(void)
+{
+	if (SIM_IrqTake(SIM_IRQ_UART4))
+		SIM_UartIsr(SIM_UART_DOOR);
+}
+
+static void SIM_IsrEnet(void)
+{
+	if (SIM_IrqTake(SIM_IRQ_ENET))
+		SIM_EthIsr();
+}
+
+static void SIM_IsrDma(void)
+{
+	uint32_t channel;
+	for (channel = 0; channel < SIM_EDMA_CHANNELS; channel++)
+	{
+		if (SIM_IrqTake(SIM_IRQ_DMA0 + channel))
+			SIM_EdmaIsr(channel);
+	}
+}
+
+static void SIM_IsrRequest(void)
+{
+	BaseType_t woken = pdFALSE;
+	if (SIM_IrqTake(SIM_IRQ_REQUEST) && (simTask != NULL))
+	{
+		vTaskNotifyGiveFromISR(simTask, &woken);
+		portYIELD_FROM_ISR(woken);
+	}
+}
+
+void SIM_CpuInit(void)
+{
+	uint32_t line;
+	clock_gettime(CLOCK_MONOTONIC, &startTime);
+	vPortSetInterruptHandler(SIM_IRQ_UART1, SIM_IsrUart1);
+	vPortSetInterruptHandler(SIM_IRQ_UART3, SIM_IsrUart3);
+	vPortSetInterruptHandler(SIM_IRQ_UART4, SIM_IsrUart4);
+	vPortSetInterruptHandler(SIM_IRQ_ENET, SIM_IsrEnet);
+	vPortSetInterruptHandler(SIM_IRQ_REQUEST, SIM_IsrRequest);
+	for (line = SIM_IRQ_DMA0; line < SIM_IRQ_DMA0 + SIM_EDMA_CHANNELS; line++)
+		vPortSetInterruptHandler(line, SIM_IsrDma);
+}
+
+/*================================== SIM task ==================================*/
+
+/* accumulates the run time of every task, the 32-bit counters wrap */
+void SIM_SampleTasks(void)
+{
+	uint32_t total;
+	UBaseType_t n, i, j;
+	n = uxTaskGetSystemState(taskStatus, SIM_TASK_MAX, &total);
+	if (n == 0)
+		return;
+	totalCycles += (uint32_t)(total - lastTotalCounter);
+	lastTotalCounter = total;
+	for (j = 0; j < taskStatCount; j++)
+		taskStats[j].alive = false;
+	for (i = 0; i < n; i++)
+	{
+		for (j = 0; j < taskStatCount; j++)
+		{
+			if (taskStats[j].number == taskStatus[i].xTaskNumber)
+				break;
+		}
+		if (j == taskStatCount)
+		{
+			if (taskStatCount == SIM_TASK_MAX)
+				continue;
+			taskStatCount++;
+			taskStats[j].number = taskStatus[i].xTaskNumber;
+			strncpy(taskStats[j].name, taskStatus[i].pcTaskName, sizeof(taskStats[j].name) - 1);
+			taskStats[j].lastCounter = 0;
+			taskStats[j].cycles = 0;
+		}
+		taskStats[j].priority = taskStatus[i].uxCurrentPriority;
+		taskStats[j].cycles += (uint32_t)(taskStatus[i].ulRunTimeCounter - taskStats[j].lastCounter);
+		taskStats[j].lastCounter = taskStatus[i].ulRunTimeCounter;
+		taskStats[j].alive = true;
+	}
+}
+
+static void SIM_Task(void* param)
+{
+	void (*function)(void*);
+	(void)param;
+	for (;;)
+	{
+		ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(SIM_TASK_SAMPLE_PERIOD));
+		SIM_SampleTasks();
+		SIM_Lock();
+		pthread_mutex_lock(&requestMutex);
+		function = requestFunction;
+		pthread_mutex_unlock(&requestMutex);
+		SIM_Unlock();
+		if (function == NULL)
+			continue;
+		function(requestParam);
+		SIM_Lock();
+		pthread_mutex_lock(&requestMutex);
+		requestFunction = NULL;
+		requestDone = true;
+		pthread_cond_broadcast(&requestCond);
+		pthread_mutex_unlock(&requestMutex);
+		SIM_Unlock();
+	}
+}
+
+void SIM_CreateTask(void)
+{
+	if (xTaskCreate(SIM_Task, "SIM", SIM_TASK_STACK_SIZE, NULL, configMAX_PRIORITIES - 1, &simTask) != pdPASS)
+		SIM_Fatal("cannot create the SIM task");
+}
+
+/* only from a device thread, the function runs while every other task waits */
+void SIM_RunOnTarget(void (*function)(void*), void* param)
+{
+	/* a task may hold the scheduler suspended for a moment (see the C library
+	* locks), the SIM task runs the request once it resumes */
+	if (xTaskGetSchedulerState() == taskSCHEDULER_NOT_STARTED)
+	{
+		function(param);
+		return;
+	}
+	pthread_mutex_lock(&requestMutex);
+	requestFunction = function;
+	requestParam = param;
+	requestDone = false;
+	pthread_mutex_unlock(&requestMutex);
+	SIM_RaiseIrq(SIM_IRQ_REQUEST);
+	pthread_mutex_lock(&requestMutex);
+	while (!requestDone)
+		pthread_cond_wait(&requestCond, &requestMutex);
+	pthread_mutex_unlock(&requestMutex);
+}
+
+/* called by the kernel with the next task, the table keeps the first
+* SIM_TASK_MAX tasks */
+void SIM_TaskSwitchedIn(void* task)
+{
+	uint32_t i;
+	for (i = 0; i < SIM_TASK_MAX; i++)
+	{
+		if (switchTasks[i] == NULL)
+			switchTasks[i] = task;
+		if (switchTasks[i] == task)
+		{
+			switchCounts[i]++;
+			return;
+		}
+	}
+}
+
+/* times the task was switched in since the start */
+uint32_t SIM_TaskSwitches(void* task)
+{
+	uint32_t i;
+	for (i = 0; (i < SIM_TASK_MAX) && (switchTasks[i] != NULL); i++)
+	{
+		if (switchTasks[i] == task)
+			return switchCounts[i];
+	}
+	return 0;
+}
+
+/* run time of each task, the SIM task included, since the start */
+void SIM_ReportTasks(void)
+{
+	uint32_t i;
+	printf("tasks (run time on the wall clock, the idle task holds the time the target slept)\n");
+	printf("  %-20s %4s %8s %7s\n", "name", "prio", "ms", "share");
+	for (i = 0; i < taskStatCount; i++)
+	{
+		printf("  %-20s %4u %8llu %6.2f%%%s\n", taskStats[i].name, (unsigned)taskStats[i].priority,
+			   (unsigned long long)(taskStats[i].cycles / (SIM_CORE_CLOCK / 1000UL)),
+			   totalCycles ? 100.0 * taskStats[i].cycles / totalCycles : 0.0, taskStats[i].alive ? "" : " (deleted)");
+	}
+}
@@ -0,0 +1,77 @@
+/* sim_crc.c
+* CRC module, the checksum is computed bit by bit with the configured
+* polynomial, seed and reflections
+*/
+#include "fsl_crc.h"
+#include "sim.h"
+
+static crc_config_t crcConfig;
+static uint32_t crcValue;
+
+static uint32_t SIM_Reflect(uint32_t value, uint32_t bits)
+{
+	uint32_t result = 0;
+	uint32_t i;
+	for (i = 0; i < bits; i++, value >>= 1)
+		result = (result << 1) | (value & 1u);
+	return result;
+}
+
+static uint32_t SIM_CrcWidth(void)
+{
+	return (crcConfig.crcBits == kCrcBits32) ? 32 : 16;
+}
+
+void CRC_GetDefaultConfig(crc_config_t* config)
+{
+	memset(config, 0, sizeof(*config));
+	config->polynomial = 0x1021U;
+	config->seed = 0xFFFFU;
+	config->crcBits = kCrcBits16;
+	config->crcResult = kCrcFinalChecksum;
+}
+
+void CRC_Init(CRC_Type* base, const crc_config_t* config)
+{
+	(void)base;
+	crcConfig = *config;
+	crcValue = config->seed;
+}
+
+void CRC_WriteData(CRC_Type* base, const uint8_t* data, size_t dataSize)
+{
+	uint32_t width = SIM_CrcWidth();
+	uint32_t top = 1u << (width - 1);
+	uint32_t mask = (width == 32) ? 0xFFFFFFFFu : 0xFFFFu;
+	uint32_t byte;
+	int bit;
+	(void)base;
+	while (dataSize--)
+	{
+		byte = *data++;
+		if (crcConfig.reflectIn)
+			byte = SIM_Reflect(byte, 8);
+		crcValue ^= byte << (width - 8);
+		for (bit = 0; bit < 8; bit++)
+			crcValue = (crcValue & top) ? (crcValue << 1) ^ crcConfig.polynomial : crcValue << 1;
+		crcValue &= mask;
+	}
+}
+
+uint32_t CRC_Get32bitResult(CRC_Type* base)
+{
+	uint32_t result = crcValue;
+	(void)base;
+	if (crcConfig.crcResult == kCrcIntermediateChecksum)
+		return result;
+	if (crcConfig.reflectOut)
+		result = SIM_Reflect(result, SIM_CrcWidth());
+	if (crcConfig.complementChecksum)
+		result = ~result;
+	return (SIM_CrcWidth() == 32) ? result : result & 0xFFFFu;
+}
+
+uint16_t CRC_Get16bitResult(CRC_Type* base)
+{
+	return (uint16_t)CRC_Get32bitResult(base);
+}
@@ -0,0 +1,266 @@
+/* sim_edma.c
+* DMAMUX and eDMA of the simulated board. A channel is a transfer control
+* descriptor in the model: a peripheral request runs one minor loop, copying
+* between the mapped register and the memory of the firmware, and the half
+* and major loop interrupts are raised on the channel's interrupt line. The
+* request routing is read from the DMAMUX registers the firmware writes
+*/
+#include "fsl_edma.h"
+#include "fsl_dmamux.h"
+#include "sim.h"
+
+typedef struct {
+	uint32_t saddr;
+	uint32_t daddr;
+	int16_t soff;
+	int16_t doff;
+	uint32_t nbytes;
+	uint16_t citer;
+	uint16_t biter;
+	uint32_t smod;
+	uint32_t dmod;
+	uint32_t interruptMask;
+	bool request;
+	bool autoStop;
+	bool done;
+	bool interrupt;
+	uint64_t requests;
+	uint64_t majorLoops;
+	uint32_t interrupts;
+} SimEdmaChannel_t;
+
+/* the handlers of the channels with an interrupt line in the simulation */
+extern void DMA0_DMA16_IRQHandler(void) __attribute__((weak));
+extern void DMA1_DMA17_IRQHandler(void) __attribute__((weak));
+extern void DMA2_DMA18_IRQHandler(void) __attribute__((weak));
+extern void DMA3_DMA19_IRQHandler(void) __attribute__((weak));
+
+static SimEdmaChannel_t channels[SIM_EDMA_CHANNELS];
+
+static SimEdmaChannel_t* SIM_EdmaChannel(DMA_Type* base, uint32_t channel)
+{
+	if ((base != DMA0) || (channel >= SIM_EDMA_CHANNELS))
+		SIM_Fatal("eDMA channel %u is not simulated", (unsigned)channel);
+	return &channels[channel];
+}
+
+/* next address, the low bits wrap around with the modulo feature */
+static uint32_t SIM_EdmaNext(uint32_t address, int16_t offset, uint32_t modulo)
+{
+	uint32_t mask = modulo ? (1u << modulo) - 1 : 0xFFFFFFFFu;
+	return (address & ~mask) | ((address + offset) & mask);
+}
+
+/*=============================== device side ==================================*/
+
+bool SIM_EdmaRequest(uint32_t source)
+{
+	SimEdmaChannel_t* channel;
+	uint32_t i, n;
+	bool raise = false;
+	uint8_t chcfg;
+	SIM_Lock();
+	for (i = 0; i < SIM_EDMA_CHANNELS; i++)
+	{
+		chcfg = DMAMUX->CHCFG[i];
+		if ((chcfg & DMAMUX_CHCFG_ENBL_MASK) && ((chcfg & DMAMUX_CHCFG_SOURCE_MASK) == (source & DMAMUX_CHCFG_SOURCE_MASK)) &&
+			channels[i].request)
+			break;
+	}
+	if (i == SIM_EDMA_CHANNELS)
+	{
+		SIM_Unlock();
+		return false;
+	}
+	channel = &channels[i];
+	channel->requests++;
+	/* the minor loop, byte by byte whatever the transfer size */
+	for (n = 0; n < channel->nbytes; n++)
+	{
+		*(volatile uint8_t*)(uintptr_t)channel->daddr = *(volatile uint8_t*)(uintptr_t)channel->saddr;
+		channel->saddr = SIM_EdmaNext(channel->saddr, channel->soff, channel->smod);
+		channel->daddr = SIM_EdmaNext(channel->daddr, channel->doff, channel->dmod);
+	}
+	channel->citer--;
+	if ((channel->citer == channel->biter / 2) && (channel->interruptMask & kEDMA_HalfInterruptEnable))
+		raise = true;
+	if (channel->citer == 0)
+	{
+		/* the counter reloads, the channel goes on unless it stops itself */
+		channel->citer = channel->biter;
+		channel->done = true;
+		channel->majorLoops++;
+		if (channel->autoStop)
+			channel->request = false;
+		if (channel->interruptMask & kEDMA_MajorInterruptEnable)
+			raise = true;
+	}
+	if (raise)
+		channel->interrupt = true;
+	SIM_Unlock();
+	if (raise)
+		SIM_RaiseIrq(SIM_IRQ_DMA0 + i);
+	return true;
+}
+
+/* Runs in interrupt context */
+void SIM_EdmaIsr(uint32_t channel)
+{
+	static void (*const handlers[SIM_EDMA_CHANNELS])(void) = {
+		DMA0_DMA16_IRQHandler, DMA1_DMA17_IRQHandler, DMA2_DMA18_IRQHandler, DMA3_DMA19_IRQHandler
+	};
+	if (handlers[channel] == NULL)
+		return;
+	channels[channel].interrupts++;
+	handlers[channel]();
+}
+
+/*============================== KSDK driver API ===============================*/
+
+void DMAMUX_Init(DMAMUX_Type* base)
+{
+	(void)base;
+}
+
+void EDMA_GetDefaultConfig(edma_config_t* config)
+{
+	memset(config, 0, sizeof(*config));
+	config->enableHaltOnError = true;
+}
+
+void EDMA_Init(DMA_Type* base, const edma_config_t* config)
+{
+	(void)base;
+	(void)config;
+}
+
+void EDMA_ResetChannel(DMA_Type* base, uint32_t channel)
+{
+	SimEdmaChannel_t* ch = SIM_EdmaChannel(base, channel);
+	SIM_Lock();
+	ch->saddr = ch->daddr = 0;
+	ch->soff = ch->doff = 0;
+	ch->nbytes = 0;
+	ch->citer = ch->biter = 0;
+	ch->smod = ch->dmod = 0;
+	ch->interruptMask = 0;
+	ch->request = false;
+	ch->autoStop = false;
+	ch->done = false;
+	ch->interrupt = false;
+	SIM_Unlock();
+}
+
+void EDMA_PrepareTransfer(edma_transfer_config_t* config, void* srcAddr, uint32_t srcWidth, void* destAddr,
+						  uint32_t destWidth, uint32_t bytesEachRequest, uint32_t transferBytes,
+						  edma_transfer_type_t type)
+{
+	memset(config, 0, sizeof(*config));
+	config->srcAddr = (uint32_t)(uintptr_t)srcAddr;
+	config->destAddr = (uint32_t)(uintptr_t)destAddr;
+	config->minorLoopBytes = bytesEachRequest;
+	config->majorLoopCounts = transferBytes / bytesEachRequest;
+	config->srcOffset = (type == kEDMA_PeripheralToMemory) ? 0 : (int16_t)srcWidth;
+	config->destOffset = (type == kEDMA_MemoryToPeripheral) ? 0 : (int16_t)destWidth;
+}
+
+void EDMA_SetTransferConfig(DMA_Type* base, uint32_t channel, const edma_transfer_config_t* config,
+							edma_tcd_t* nextTcd)
+{
+	SimEdmaChannel_t* ch = SIM_EdmaChannel(base, channel);
+	if (nextTcd != NULL)
+		SIM_Fatal("eDMA scatter/gather is not simulated");
+	SIM_Lock();
+	ch->saddr = config->srcAddr;
+	ch->daddr = config->destAddr;
+	ch->soff = config->srcOffset;
+	ch->doff = config->destOffset;
+	ch->nbytes = config->minorLoopBytes;
+	ch->citer = ch->biter = (uint16_t)config->majorLoopCounts;
+	ch->done = false;
+	SIM_Unlock();
+}
+
+void EDMA_SetModulo(DMA_Type* base, uint32_t channel, edma_modulo_t srcModulo, edma_modulo_t destModulo)
+{
+	SimEdmaChannel_t* ch = SIM_EdmaChannel(base, channel);
+	ch->smod = srcModulo;
+	ch->dmod = destModulo;
+}
+
+void EDMA_EnableChannelInterrupts(DMA_Type* base, uint32_t channel, uint32_t mask)
+{
+	SimEdmaChannel_t* ch = SIM_EdmaChannel(base, channel);
+	SIM_Lock();
+	ch->interruptMask |= mask;
+	SIM_Unlock();
+}
+
+void EDMA_DisableChannelInterrupts(DMA_Type* base, uint32_t channel, uint32_t mask)
+{
+	SimEdmaChannel_t* ch = SIM_EdmaChannel(base, channel);
+	SIM_Lock();
+	ch->interruptMask &= ~mask;
+	SIM_Unlock();
+}
+
+void EDMA_EnableAutoStopRequest(DMA_Type* base, uint32_t channel, bool enable)
+{
+	SIM_EdmaChannel(base, channel)->autoStop = enable;
+}
+
+void EDMA_EnableChannelRequest(DMA_Type* base, uint32_t channel)
+{
+	SimEdmaChannel_t* ch = SIM_EdmaChannel(base, channel);
+	SIM_Lock();
+	ch->request = true;
+	SIM_Unlock();
+	/* a peripheral that already requests is served at its next service */
+}
+
+void EDMA_DisableChannelRequest(DMA_Type* base, uint32_t channel)
+{
+	SimEdmaChannel_t* ch = SIM_EdmaChannel(base, channel);
+	SIM_Lock();
+	ch->request = false;
+	SIM_Unlock();
+}
+
+uint32_t EDMA_GetRemainingMajorLoopCount(DMA_Type* base, uint32_t channel)
+{
+	return SIM_EdmaChannel(base, channel)->citer;
+}
+
+uint32_t EDMA_GetChannelStatusFlags(DMA_Type* base, uint32_t channel)
+{
+	SimEdmaChannel_t* ch = SIM_EdmaChannel(base, channel);
+	return (ch->done ? kEDMA_DoneFlag : 0) | (ch->interrupt ? kEDMA_InterruptFlag : 0);
+}
+
+void EDMA_ClearChannelStatusFlags(DMA_Type* base, uint32_t channel, uint32_t mask)
+{
+	SimEdmaChannel_t* ch = SIM_EdmaChannel(base, channel);
+	SIM_Lock();
+	if (mask & kEDMA_DoneFlag)
+		ch->done = false;
+	if (mask & kEDMA_InterruptFlag)
+		ch->interrupt = false;
+	SIM_Unlock();
+}
+
+void SIM_EdmaReport(void)
+{
+	uint32_t i;
+	bool any = false;
+	for (i = 0; i < SIM_EDMA_CHANNELS; i++)
+	{
+		if (channels[i].requests == 0)
+			continue;
+		if (!any)
+			printf("edma\n");
+		any = true;
+		printf("  channel %u  source %2u  requests %8llu  major loops %6llu  interrupts %u\n", (unsigned)i,
+			   (unsigned)(DMAMUX->CHCFG[i] & DMAMUX_CHCFG_SOURCE_MASK), (unsigned long long)channels[i].requests,
+			   (unsigned long long)channels[i].majorLoops, (unsigned)channels[i].interrupts);
+	}
+}
@@ -0,0 +1,529 @@
+/* sim_eth.c
+* Ethernet MAC and KSZ8081 PHY of the simulated board. Replaces mk6xEthDriver,
+* frames go to a TAP interface of the host and both directions can be written
+* to a pcap file. The PHY reports the link up at 100 Mbit/s full duplex when
+* the simulation has a TAP interface or a capture file, the scenario can pull
+* the cable. Without a TAP interface the scenario can put the server of the
+* firmware on the segment: it answers ARP and ICMP echo requests, after a
+* delay the scenario can set
+*/
+#include <fcntl.h>
+#include <semaphore.h>
+#include <net/if.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include <linux/if_tun.h>
+#include "core/net.h"
+#include "core/nic.h"
+#include "drivers/mk6x_eth.h"
+#include "drivers/ksz8081.h"
+#include "debug.h"
+/* the socket structure of the stack has a member named errno, the macro
+* comes after its headers */
+#include <errno.h>
+#include "sim.h"
+
+#define SIM_ETH_FRAME			1536
+#define SIM_ETH_RX_FRAMES		16
+
+/* default server of the firmware, 192.168.1.206 */
+#define SIM_ETH_SERVER_ADDRESS	0xC0A801CE
+#define SIM_ETH_SERVER_QUEUE	4
+
+typedef struct {
+	uint8_t data[SIM_ETH_FRAME];
+	size_t length;
+} SimEthFrame_t;
+
+static NetInterface* ethInterface;
+static int tapFd = -1;
+static int pcapFd = -1;
+static bool linkUp;
+static SimEthFrame_t rxRing[SIM_ETH_RX_FRAMES];
+static uint32_t rxHead;
+static uint32_t rxTail;
+static uint8_t rxFrame[SIM_ETH_FRAME];
+static uint8_t txFrame[SIM_ETH_FRAME];
+
+/* PHY registers */
+static uint16_t phyBmcr;
+static uint16_t phyIcsr;
+
+/* simulated server */
+static const uint8_t serverMac[6] = {0x02, 0x53, 0x49, 0x4D, 0x00, 0x01};
+static volatile bool serverOnline;
+static volatile uint32_t serverDelayMs;
+static bool serverStarted;
+static SimEthFrame_t serverQueue[SIM_ETH_SERVER_QUEUE];
+static uint32_t serverHead;
+static uint32_t serverTail;
+static sem_t serverSem;
+static uint32_t serverArp, serverEcho;
+
+static uint64_t rxFrames, rxBytes, rxDropped;
+static uint64_t txFrames, txBytes, txDropped;
+static uint32_t linkChanges;
+
+static error_t SIM_EthInit(NetInterface* interface);
+static void SIM_EthTick(NetInterface* interface);
+static void SIM_EthEnableIrq(NetInterface* interface);
+static void SIM_EthDisableIrq(NetInterface* interface);
+static void SIM_EthEventHandler(NetInterface* interface);
+static error_t SIM_EthSendPacket(NetInterface* interface, const NetBuffer* buffer, size_t offset);
+static error_t SIM_EthSetMulticastFilter(NetInterface* interface);
+static error_t SIM_EthUpdateMacConfig(NetInterface* interface);
+static void SIM_EthWritePhyReg(uint8_t phyAddr, uint8_t regAddr, uint16_t data);
+static uint16_t SIM_EthReadPhyReg(uint8_t phyAddr, uint8_t regAddr);
+
+/* the host side neither adds nor expects a frame check sequence, so unlike
+* the MAC of the target the driver strips it on reception */
+const NicDriver mk6xEthDriver =
+{
+	NIC_TYPE_ETHERNET,
+	ETH_MTU,
+	SIM_EthInit,
+	SIM_EthTick,
+	SIM_EthEnableIrq,
+	SIM_EthDisableIrq,
+	SIM_EthEventHandler,
+	SIM_EthSendPacket,
+	SIM_EthSetMulticastFilter,
+	SIM_EthUpdateMacConfig,
+	SIM_EthWritePhyReg,
+	SIM_EthReadPhyReg,
+	TRUE,
+	TRUE,
+	TRUE,
+	TRUE
+};
+
+/*================================== capture ===================================*/
+
+static void SIM_PcapWrite(const uint8_t* data, size_t length)
+{
+	struct timeval now;
+	uint32_t record[4];
+	if (pcapFd < 0)
+		return;
+	gettimeofday(&now, NULL);
+	record[0] = (uint32_t)now.tv_sec;
+	record[1] = (uint32_t)now.tv_usec;
+	record[2] = (uint32_t)length;
+	record[3] = (uint32_t)length;
+	SIM_Lock();
+	if ((write(pcapFd, record, sizeof(record)) != sizeof(record)) ||
+		(write(pcapFd, data, length) != (ssize_t)length))
+	{
+		close(pcapFd);
+		pcapFd = -1;
+	}
+	SIM_Unlock();
+}
+
+int SIM_EthOpenPcap(const char* path)
+{
+	/* libpcap file header, microsecond timestamps, Ethernet link type */
+	static const uint32_t header[6] = {0xA1B2C3D4, 0x00040002, 0, 0, 65535, 1};
+	pcapFd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (pcapFd < 0)
+		return -1;
+	if (write(pcapFd, header, sizeof(header)) != sizeof(header))
+	{
+		close(pcapFd);
+		pcapFd = -1;
+		return -1;
+	}
+	linkUp = true;
+	return 0;
+}
+
+/*================================= TAP device =================================*/
+
+static void* SIM_EthRxThread(void* param)
+{
+	SimEthFrame_t* frame;
+	uint8_t data[SIM_ETH_FRAME];
+	ssize_t length;
+	bool accepted;
+	(void)param;
+	for (;;)
+	{
+		length = read(tapFd, data, sizeof(data));
+		if (length < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			SIM_Log("tap read failed: %s", strerror(errno));
+			return NULL;
+		}
+		if (length < 14)
+			continue;
+		/* with the cable pulled nothing reaches the MAC */
+		SIM_Lock();
+		accepted = linkUp && (rxHead - rxTail < SIM_ETH_RX_FRAMES);
+		if (accepted)
+		{
+			frame = &rxRing[rxHead % SIM_ETH_RX_FRAMES];
+			memcpy(frame->data, data, length);
+			frame->length = length;
+			rxHead++;
+		}
+		else if (linkUp)
+		{
+			rxDropped++;
+		}
+		SIM_Unlock();
+		if (accepted)
+			SIM_RaiseIrq(SIM_IRQ_ENET);
+	}
+	return NULL;
+}
+
+int SIM_EthOpenTap(const char* name)
+{
+	struct ifreq ifr;
+	int sock;
+	tapFd = open("/dev/net/tun", O_RDWR);
+	if (tapFd < 0)
+		return -1;
+	memset(&ifr, 0, sizeof(ifr));
+	ifr.ifr_flags = IFF_TAP | IFF_NO_PI;
+	strncpy(ifr.ifr_name, name, IFNAMSIZ - 1);
+	if (ioctl(tapFd, TUNSETIFF, &ifr) < 0)
+		goto fail;
+	sock = socket(AF_INET, SOCK_DGRAM, 0);
+	if (sock < 0)
+		goto fail;
+	if (ioctl(sock, SIOCGIFFLAGS, &ifr) == 0)
+	{
+		ifr.ifr_flags |= IFF_UP;
+		ioctl(sock, SIOCSIFFLAGS, &ifr);
+	}
+	close(sock);
+	linkUp = true;
+	SIM_StartThread(SIM_EthRxThread, NULL);
+	return 0;
+fail:
+	close(tapFd);
+	tapFd = -1;
+	return -1;
+}
+
+void SIM_EthSetLink(bool up)
+{
+	SIM_Lock();
+	if (up != linkUp)
+	{
+		linkUp = up;
+		phyIcsr |= up ? ICSR_LINK_UP_IF : ICSR_LINK_DOWN_IF;
+		linkChanges++;
+	}
+	SIM_Unlock();
+}
+
+/*=================================== server ===================================*/
+
+static uint16_t SIM_EthChecksum(const uint8_t* data, size_t length)
+{
+	uint32_t sum = 0;
+	size_t i;
+	for (i = 0; i + 1 < length; i += 2)
+		sum += (data[i] << 8) | data[i + 1];
+	if (length & 1)
+		sum += data[length - 1] << 8;
+	while (sum >> 16)
+		sum = (sum & 0xFFFF) + (sum >> 16);
+	return (uint16_t)~sum;
+}
+
+static bool SIM_EthIsServer(const uint8_t* address)
+{
+	return (((uint32_t)address[0] << 24) | (address[1] << 16) | (address[2] << 8) | address[3]) ==
+		   SIM_ETH_SERVER_ADDRESS;
+}
+
+/* builds the answer of the server in place, false when there is none */
+static bool SIM_EthServerAnswer(uint8_t* frame, size_t length)
+{
+	uint8_t address[4];
+	size_t headerLength;
+	uint16_t type = (frame[12] << 8) | frame[13];
+	/* ARP request for the server address */
+	if ((type == 0x0806) && (length >= 42) && (frame[21] == 1) && SIM_EthIsServer(frame + 38))
+	{
+		memcpy(frame, frame + 6, 6);
+		memcpy(frame + 6, serverMac, 6);
+		frame[21] = 2;
+		/* the sender becomes the target, the server the sender */
+		memcpy(address, frame + 38, 4);
+		memcpy(frame + 32, frame + 22, 10);
+		memcpy(frame + 22, serverMac, 6);
+		memcpy(frame + 28, address, 4);
+		serverArp++;
+		return true;
+	}
+	if ((type != 0x0800) || (length < 34))
+		return false;
+	headerLength = (frame[14] & 0x0F) * 4;
+	/* ICMP echo request to the server */
+	if ((frame[23] != 1) || !SIM_EthIsServer(frame + 30) || (length < 14 + headerLength + 8) ||
+		(frame[14 + headerLength] != 8))
+		return false;
+	memcpy(frame, frame + 6, 6);
+	memcpy(frame + 6, serverMac, 6);
+	memcpy(address, frame + 26, 4);
+	memcpy(frame + 26, frame + 30, 4);
+	memcpy(frame + 30, address, 4);
+	frame[14 + headerLength] = 0;
+	frame[14 + headerLength + 2] = 0;
+	frame[14 + headerLength + 3] = 0;
+	type = SIM_EthChecksum(frame + 14 + headerLength, length - 14 - headerLength);
+	frame[14 + headerLength + 2] = (uint8_t)(type >> 8);
+	frame[14 + headerLength + 3] = (uint8_t)type;
+	serverEcho++;
+	return true;
+}
+
+/* answers on its own thread, like a host on the segment */
+static void* SIM_EthServerThread(void* param)
+{
+	SimEthFrame_t request;
+	SimEthFrame_t* frame;
+	bool accepted;
+	(void)param;
+	for (;;)
+	{
+		while (sem_wait(&serverSem) != 0)
+			;
+		SIM_Lock();
+		request = serverQueue[serverTail++ % SIM_ETH_SERVER_QUEUE];
+		SIM_Unlock();
+		if (!SIM_EthServerAnswer(request.data, request.length))
+			continue;
+		/* round trip of the path behind the segment */
+		if (serverDelayMs != 0)
+			SIM_SleepFor(SIM_MS(serverDelayMs));
+		SIM_Lock();
+		accepted = linkUp && serverOnline && (rxHead - rxTail < SIM_ETH_RX_FRAMES);
+		if (accepted)
+		{
+			frame = &rxRing[rxHead % SIM_ETH_RX_FRAMES];
+			*frame = request;
+			rxHead++;
+		}
+		SIM_Unlock();
+		if (accepted)
+			SIM_RaiseIrq(SIM_IRQ_ENET);
+	}
+	return NULL;
+}
+
+void SIM_EthSetServer(bool online)
+{
+	if (!serverStarted)
+	{
+		serverStarted = true;
+		sem_init(&serverSem, 0, 0);
+		SIM_StartThread(SIM_EthServerThread, NULL);
+	}
+	serverOnline = online;
+}
+
+void SIM_EthSetServerDelay(uint32_t delayMs)
+{
+	serverDelayMs = delayMs;
+}
+
+/* a frame sent by the firmware, under the lock */
+static void SIM_EthServerRequest(const uint8_t* data, size_t length)
+{
+	if (!serverOnline || (serverHead - serverTail >= SIM_ETH_SERVER_QUEUE))
+		return;
+	memcpy(serverQueue[serverHead % SIM_ETH_SERVER_QUEUE].data, data, length);
+	serverQueue[serverHead % SIM_ETH_SERVER_QUEUE].length = length;
+	serverHead++;
+	sem_post(&serverSem);
+}
+
+/*================================= NIC driver =================================*/
+
+static error_t SIM_EthInit(NetInterface* interface)
+{
+	error_t error;
+	TRACE_INFO("Initializing simulated Ethernet MAC...\r\n");
+	ethInterface = interface;
+	error = interface->phyDriver->init(interface);
+	if (error)
+		return error;
+	osSetEvent(&interface->nicTxEvent);
+	return NO_ERROR;
+}
+
+static void SIM_EthTick(NetInterface* interface)
+{
+	interface->phyDriver->tick(interface);
+}
+
+static void SIM_EthEnableIrq(NetInterface* interface)
+{
+	NVIC_EnableIRQ(ENET_Receive_IRQn);
+	interface->phyDriver->enableIrq(interface);
+}
+
+static void SIM_EthDisableIrq(NetInterface* interface)
+{
+	NVIC_DisableIRQ(ENET_Receive_IRQn);
+	interface->phyDriver->disableIrq(interface);
+}
+
+/* receive interrupt, runs in interrupt context */
+void SIM_EthIsr(void)
+{
+	bool_t flag = FALSE;
+	osEnterIsr();
+	if ((ethInterface != NULL) && (rxHead != rxTail))
+	{
+		ethInterface->nicEvent = TRUE;
+		flag = osSetEventFromIsr(&netEvent);
+	}
+	osExitIsr(flag);
+}
+
+static void SIM_EthEventHandler(NetInterface* interface)
+{
+	SimEthFrame_t* frame;
+	size_t length;
+	for (;;)
+	{
+		SIM_Lock();
+		if (rxHead == rxTail)
+		{
+			SIM_Unlock();
+			break;
+		}
+		frame = &rxRing[rxTail % SIM_ETH_RX_FRAMES];
+		length = frame->length;
+		memcpy(rxFrame, frame->data, length);
+		rxTail++;
+		rxFrames++;
+		rxBytes += length;
+		SIM_Unlock();
+		SIM_PcapWrite(rxFrame, length);
+		nicProcessPacket(interface, rxFrame, length);
+	}
+}
+
+static error_t SIM_EthSendPacket(NetInterface* interface, const NetBuffer* buffer, size_t offset)
+{
+	size_t length = netBufferGetLength(buffer) - offset;
+	if (length > SIM_ETH_FRAME)
+	{
+		osSetEvent(&interface->nicTxEvent);
+		return ERROR_INVALID_LENGTH;
+	}
+	netBufferRead(txFrame, buffer, offset, length);
+	if (linkUp)
+	{
+		if ((tapFd >= 0) && (write(tapFd, txFrame, length) != (ssize_t)length))
+			txDropped++;
+		SIM_PcapWrite(txFrame, length);
+		SIM_Lock();
+		SIM_EthServerRequest(txFrame, length);
+		SIM_Unlock();
+		txFrames++;
+		txBytes += length;
+	}
+	else
+	{
+		txDropped++;
+	}
+	osSetEvent(&interface->nicTxEvent);
+	return NO_ERROR;
+}
+
+static error_t SIM_EthSetMulticastFilter(NetInterface* interface)
+{
+	(void)interface;
+	return NO_ERROR;
+}
+
+static error_t SIM_EthUpdateMacConfig(NetInterface* interface)
+{
+	(void)interface;
+	return NO_ERROR;
+}
+
+/*==================================== PHY =====================================*/
+
+static void SIM_EthWritePhyReg(uint8_t phyAddr, uint8_t regAddr, uint16_t data)
+{
+	(void)phyAddr;
+	SIM_Lock();
+	switch (regAddr)
+	{
+	case KSZ8081_PHY_REG_BMCR:
+		/* the reset completes at once and reports the current link */
+		phyBmcr = data & ~BMCR_RESET;
+		if ((data & BMCR_RESET) && linkUp)
+			phyIcsr |= ICSR_LINK_UP_IF;
+		break;
+	case KSZ8081_PHY_REG_ICSR:
+		/* the enable bits are kept, the flags are read only */
+		phyIcsr = (phyIcsr & 0x00FF) | (data & 0xFF00);
+		break;
+	default:
+		break;
+	}
+	SIM_Unlock();
+}
+
+static uint16_t SIM_EthReadPhyReg(uint8_t phyAddr, uint8_t regAddr)
+{
+	uint16_t value = 0;
+	(void)phyAddr;
+	SIM_Lock();
+	switch (regAddr)
+	{
+	case KSZ8081_PHY_REG_BMCR:
+		value = phyBmcr;
+		break;
+	case KSZ8081_PHY_REG_BMSR:
+		value = BMSR_100BTX_FD | BMSR_100BTX | BMSR_10BT_FD | BMSR_10BT | BMSR_AN_ABLE | BMSR_EXTENDED_CAP;
+		if (linkUp)
+			value |= BMSR_LINK_STATUS | BMSR_AN_COMPLETE;
+		break;
+	case KSZ8081_PHY_REG_PHYIDR1:
+		value = 0x0022;
+		break;
+	case KSZ8081_PHY_REG_PHYIDR2:
+		value = 0x1560;
+		break;
+	case KSZ8081_PHY_REG_ICSR:
+		/* clear on read */
+		value = phyIcsr;
+		phyIcsr &= 0xFF00;
+		break;
+	case KSZ8081_PHY_REG_PHYCON1:
+		value = PHYCON1_OP_MODE_100BTX_FD;
+		break;
+	default:
+		break;
+	}
+	SIM_Unlock();
+	return value;
+}
+
+void SIM_EthReport(void)
+{
+	printf("ethernet (%s%s%s)\n", tapFd >= 0 ? "tap" : "no tap", pcapFd >= 0 ? ", pcap" : "",
+		   linkUp ? ", link up" : ", link down");
+	printf("  rx %8llu frames %10llu B  dropped %llu\n", (unsigned long long)rxFrames,
+		   (unsigned long long)rxBytes, (unsigned long long)rxDropped);
+	printf("  tx %8llu frames %10llu B  dropped %llu  link changes %u\n", (unsigned long long)txFrames,
+		   (unsigned long long)txBytes, (unsigned long long)txDropped, (unsigned)linkChanges);
+	if (serverStarted)
+		printf("  server %s  arp replies %u  echo replies %u\n", serverOnline ? "online" : "offline",
+			   (unsigned)serverArp, (unsigned)serverEcho);
+}
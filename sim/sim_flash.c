@@ -0,0 +1,188 @@
+/* sim_flash.c
+* Program flash. The application, image and information partitions are mapped
+* at their target addresses so the firmware reads them through plain pointers
+* as it does on the target, the bootloader partition below 0x10000 is not (the
+* host does not map the first pages of the address space). With a backing
+* file the contents survive the run, an image written by an FTP update can be
+* checked on the host
+*/
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "fsl_flash.h"
+#include "partition.h"
+#include "sim.h"
+
+#define SIM_FLASH_SIZE			0x00200000
+#define SIM_FLASH_SECTOR		0x1000
+#define SIM_FLASH_BASE			APPLICATION_START_ADDR
+#define SIM_FLASH_PHRASE		8
+
+#ifndef MAP_FIXED_NOREPLACE
+#define MAP_FIXED_NOREPLACE		0x100000
+#endif
+
+static uint32_t erases;
+static uint32_t programs;
+static uint32_t errors;
+
+int SIM_FlashMap(const char* path)
+{
+	void* address = (void*)(uintptr_t)SIM_FLASH_BASE;
+	size_t length = SIM_FLASH_SIZE - SIM_FLASH_BASE;
+	void* map;
+	int fd;
+	if (path == NULL)
+	{
+		map = mmap(address, length, PROT_READ | PROT_WRITE,
+				   MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+		if (map == address)
+			memset(map, 0xFF, length);
+	}
+	else
+	{
+		fd = open(path, O_RDWR | O_CREAT, 0644);
+		if (fd < 0)
+			return -1;
+		/* a new file is an erased device */
+		if (lseek(fd, 0, SEEK_END) == 0)
+		{
+			static const uint8_t erased[SIM_FLASH_SECTOR] = {[0 ... SIM_FLASH_SECTOR - 1] = 0xFF};
+			uint32_t offset;
+			for (offset = 0; offset < SIM_FLASH_SIZE; offset += SIM_FLASH_SECTOR)
+			{
+				if (write(fd, erased, sizeof(erased)) != sizeof(erased))
+				{
+					close(fd);
+					return -1;
+				}
+			}
+		}
+		if (ftruncate(fd, SIM_FLASH_SIZE) != 0)
+		{
+			close(fd);
+			return -1;
+		}
+		map = mmap(address, length, PROT_READ | PROT_WRITE,
+				   MAP_SHARED | MAP_FIXED_NOREPLACE, fd, SIM_FLASH_BASE);
+		close(fd);
+	}
+	if (map != address)
+	{
+		if (map != MAP_FAILED)
+			munmap(map, length);
+		errno = EADDRINUSE;
+		return -1;
+	}
+	return 0;
+}
+
+static status_t SIM_FlashCheck(uint32_t start, uint32_t length, uint32_t alignment)
+{
+	if ((start % alignment) || (length % alignment))
+		return kStatus_FLASH_AlignmentError;
+	if ((start < SIM_FLASH_BASE) || (start + length > SIM_FLASH_SIZE) || (start + length < start))
+	{
+		errors++;
+		return kStatus_FLASH_ProtectionViolation;
+	}
+	return kStatus_FLASH_Success;
+}
+
+status_t FLASH_Init(flash_config_t* config)
+{
+	memset(config, 0, sizeof(*config));
+	config->PFlashBlockBase = 0;
+	config->PFlashTotalSize = SIM_FLASH_SIZE;
+	config->PFlashBlockCount = 4;
+	config->PFlashSectorSize = SIM_FLASH_SECTOR;
+	return kStatus_FLASH_Success;
+}
+
+status_t FLASH_GetProperty(flash_config_t* config, flash_property_tag_t whichProperty, uint32_t* value)
+{
+	switch (whichProperty)
+	{
+	case kFLASH_PropertyPflashSectorSize:
+		*value = config->PFlashSectorSize;
+		break;
+	case kFLASH_PropertyPflashTotalSize:
+		*value = config->PFlashTotalSize;
+		break;
+	case kFLASH_PropertyPflashBlockSize:
+		*value = config->PFlashTotalSize / config->PFlashBlockCount;
+		break;
+	case kFLASH_PropertyPflashBlockCount:
+		*value = config->PFlashBlockCount;
+		break;
+	case kFLASH_PropertyPflashBlockBaseAddr:
+		*value = config->PFlashBlockBase;
+		break;
+	default:
+		return kStatus_FLASH_UnknownProperty;
+	}
+	return kStatus_FLASH_Success;
+}
+
+status_t FLASH_GetSecurityState(flash_config_t* config, flash_security_state_t* state)
+{
+	(void)config;
+	*state = kFLASH_SecurityStateNotSecure;
+	return kStatus_FLASH_Success;
+}
+
+status_t FLASH_Erase(flash_config_t* config, uint32_t start, uint32_t lengthInBytes, uint32_t key)
+{
+	status_t status;
+	(void)config;
+	if (key != kFLASH_ApiEraseKey)
+		return kStatus_FLASH_EraseKeyError;
+	status = SIM_FlashCheck(start, lengthInBytes, SIM_FLASH_SECTOR);
+	if (status != kStatus_FLASH_Success)
+		return status;
+	memset((void*)(uintptr_t)start, 0xFF, lengthInBytes);
+	erases += lengthInBytes / SIM_FLASH_SECTOR;
+	return kStatus_FLASH_Success;
+}
+
+status_t FLASH_VerifyErase(flash_config_t* config, uint32_t start, uint32_t lengthInBytes, flash_margin_value_t margin)
+{
+	const uint8_t* data = (const uint8_t*)(uintptr_t)start;
+	status_t status;
+	uint32_t i;
+	(void)config;
+	(void)margin;
+	status = SIM_FlashCheck(start, lengthInBytes, 4);
+	if (status != kStatus_FLASH_Success)
+		return status;
+	for (i = 0; i < lengthInBytes; i++)
+	{
+		if (data[i] != 0xFF)
+			return kStatus_FLASH_CommandFailure;
+	}
+	return kStatus_FLASH_Success;
+}
+
+/* programming can only clear bits */
+status_t FLASH_Program(flash_config_t* config, uint32_t start, uint32_t* src, uint32_t lengthInBytes)
+{
+	uint8_t* data = (uint8_t*)(uintptr_t)start;
+	const uint8_t* source = (const uint8_t*)src;
+	status_t status;
+	uint32_t i;
+	(void)config;
+	status = SIM_FlashCheck(start, lengthInBytes, SIM_FLASH_PHRASE);
+	if (status != kStatus_FLASH_Success)
+		return status;
+	for (i = 0; i < lengthInBytes; i++)
+		data[i] &= source[i];
+	programs += lengthInBytes / SIM_FLASH_PHRASE;
+	return kStatus_FLASH_Success;
+}
+
+void SIM_FlashReport(void)
+{
+	printf("flash\n  sectors erased %u  phrases programmed %u  protection errors %u\n",
+		   (unsigned)erases, (unsigned)programs, (unsigned)errors);
+}
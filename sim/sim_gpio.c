@@ -0,0 +1,222 @@
+/* sim_gpio.c
+* GPIO ports of the simulated board. The data registers stay in the mapped
+* peripheral space, the input levels come from what is wired to the pins: the
+* I2C devices on SDA, the 16 channel multiplexer of the digital inputs and the
+* four keys. The power pins of the modem are followed by sim_modem.c
+*/
+#include "board.h"
+#include "pin_mux.h"
+#include "menu.h"
+#include "eeprom_rtc.h"
+#include "sim.h"
+
+#define SIM_DI_CHANNELS		16
+
+/* states of a digital input as IOsTask decodes them */
+enum {
+	SIM_DI_CLOSE = 0,
+	SIM_DI_OPEN,
+	SIM_DI_CUTOFF,
+};
+
+typedef struct {
+	GPIO_Type* port;
+	uint32_t pin;
+} SimPin_t;
+
+static const SimPin_t muxPins[4] = {
+	{BOARD_INITIOS_MUX_S0_GPIO, BOARD_INITIOS_MUX_S0_GPIO_PIN},
+	{BOARD_INITIOS_MUX_S1_GPIO, BOARD_INITIOS_MUX_S1_GPIO_PIN},
+	{BOARD_INITIOS_MUX_S2_GPIO, BOARD_INITIOS_MUX_S2_GPIO_PIN},
+	{BOARD_INITIOS_MUX_S3_GPIO, BOARD_INITIOS_MUX_S3_GPIO_PIN},
+};
+
+static const SimPin_t keyPins[4] = {
+	{KEY_1_PORT, KEY_1_PIN},
+	{KEY_2_PORT, KEY_2_PIN},
+	{KEY_3_PORT, KEY_3_PIN},
+	{KEY_4_PORT, KEY_4_PIN},
+};
+
+static uint8_t diState[SIM_DI_CHANNELS];
+static bool keyPressed[4];
+static bool busScl = true;
+static bool busSda = true;
+static uint32_t ledToggles;
+static uint32_t lastLed;
+
+static bool SIM_PinIs(GPIO_Type* base, uint32_t pin, GPIO_Type* port, uint32_t portPin)
+{
+	return (base == port) && (pin == portPin);
+}
+
+static bool SIM_Driven(GPIO_Type* base, uint32_t pin)
+{
+	return (base->PDDR >> pin) & 1u;
+}
+
+static bool SIM_Output(GPIO_Type* base, uint32_t pin)
+{
+	return (base->PDOR >> pin) & 1u;
+}
+
+/* an undriven bus line is pulled up */
+static bool SIM_BusLevel(GPIO_Type* base, uint32_t pin)
+{
+	return SIM_Driven(base, pin) ? SIM_Output(base, pin) : true;
+}
+
+/* the multiplexer select lines are active low */
+static uint32_t SIM_MuxChannel(void)
+{
+	uint32_t channel = 0;
+	uint32_t i;
+	for (i = 0; i < 4; i++)
+	{
+		if (!SIM_Output(muxPins[i].port, muxPins[i].pin))
+			channel |= 1u << i;
+	}
+	return channel;
+}
+
+static uint32_t SIM_PinLevel(GPIO_Type* base, uint32_t pin)
+{
+	uint32_t i;
+	if (SIM_PinIs(base, pin, SDA_PORT, SDA_PIN))
+		return SIM_BusLevel(base, pin) && SIM_I2cSdaDrive();
+	if (SIM_Driven(base, pin))
+		return SIM_Output(base, pin);
+	if (SIM_PinIs(base, pin, BOARD_INITIOS_DI1_GPIO, BOARD_INITIOS_DI1_GPIO_PIN))
+		return diState[SIM_MuxChannel()] != SIM_DI_CLOSE;
+	if (SIM_PinIs(base, pin, BOARD_INITIOS_DI2_GPIO, BOARD_INITIOS_DI2_GPIO_PIN))
+		return diState[SIM_MuxChannel()] == SIM_DI_CUTOFF;
+	for (i = 0; i < 4; i++)
+	{
+		if (SIM_PinIs(base, pin, keyPins[i].port, keyPins[i].pin))
+			return keyPressed[i] ? 0 : 1;
+	}
+	return 1;
+}
+
+/* follows the lines wired to something after the firmware touched a port */
+static void SIM_GpioChanged(GPIO_Type* base)
+{
+	bool scl, sda;
+	uint32_t led;
+	if (base == SDA_PORT)
+	{
+		scl = SIM_BusLevel(SCL_PORT, SCL_PIN);
+		sda = SIM_BusLevel(SDA_PORT, SDA_PIN) && SIM_I2cSdaDrive();
+		if ((scl != busScl) || (sda != busSda))
+		{
+			SIM_I2cBusChanged(scl, sda);
+			/* the devices only change SDA while SCL is low */
+			busScl = scl;
+			busSda = SIM_BusLevel(SDA_PORT, SDA_PIN) && SIM_I2cSdaDrive();
+		}
+	}
+	if ((base == BOARD_GPRS_PWR_GPIO) || (base == BOARD_GPRS_EN_GPIO))
+	{
+		SIM_ModemPins(SIM_Driven(BOARD_GPRS_PWR_GPIO, BOARD_GPRS_PWR_GPIO_PIN) &&
+						  SIM_Output(BOARD_GPRS_PWR_GPIO, BOARD_GPRS_PWR_GPIO_PIN),
+					  SIM_Driven(BOARD_GPRS_EN_GPIO, BOARD_GPRS_EN_GPIO_PIN) &&
+						  SIM_Output(BOARD_GPRS_EN_GPIO, BOARD_GPRS_EN_GPIO_PIN));
+	}
+	if (base == BOARD_INITLEDS_LED_STATUS_GPIO)
+	{
+		led = SIM_Output(base, BOARD_INITLEDS_LED_STATUS_GPIO_PIN);
+		if (led != lastLed)
+			ledToggles++;
+		lastLed = led;
+	}
+}
+
+void GPIO_PinInit(GPIO_Type* base, uint32_t pin, const gpio_pin_config_t* config)
+{
+	SIM_Lock();
+	if (config->pinDirection == kGPIO_DigitalInput)
+	{
+		base->PDDR &= ~(1u << pin);
+	}
+	else
+	{
+		if (config->outputLogic)
+			base->PDOR |= 1u << pin;
+		else
+			base->PDOR &= ~(1u << pin);
+		base->PDDR |= 1u << pin;
+	}
+	SIM_GpioChanged(base);
+	SIM_Unlock();
+}
+
+void GPIO_WritePinOutput(GPIO_Type* base, uint32_t pin, uint8_t output)
+{
+	if (output)
+		GPIO_SetPinsOutput(base, 1u << pin);
+	else
+		GPIO_ClearPinsOutput(base, 1u << pin);
+}
+
+void GPIO_SetPinsOutput(GPIO_Type* base, uint32_t mask)
+{
+	SIM_Lock();
+	base->PDOR |= mask;
+	SIM_GpioChanged(base);
+	SIM_Unlock();
+}
+
+void GPIO_ClearPinsOutput(GPIO_Type* base, uint32_t mask)
+{
+	SIM_Lock();
+	base->PDOR &= ~mask;
+	SIM_GpioChanged(base);
+	SIM_Unlock();
+}
+
+void GPIO_TogglePinsOutput(GPIO_Type* base, uint32_t mask)
+{
+	SIM_Lock();
+	base->PDOR ^= mask;
+	SIM_GpioChanged(base);
+	SIM_Unlock();
+}
+
+uint32_t GPIO_ReadPinInput(GPIO_Type* base, uint32_t pin)
+{
+	uint32_t level;
+	SIM_Lock();
+	level = SIM_PinLevel(base, pin);
+	SIM_Unlock();
+	return level;
+}
+
+void SIM_GpioInit(void)
+{
+	uint32_t i;
+	for (i = 0; i < SIM_DI_CHANNELS; i++)
+		diState[i] = SIM_DI_CLOSE;
+}
+
+void SIM_SetDigitalInput(uint32_t channel, uint8_t state)
+{
+	if (channel >= SIM_DI_CHANNELS)
+		return;
+	SIM_Lock();
+	diState[channel] = state;
+	SIM_Unlock();
+}
+
+void SIM_SetKey(uint32_t key, bool pressed)
+{
+	if ((key < 1) || (key > 4))
+		return;
+	SIM_Lock();
+	keyPressed[key - 1] = pressed;
+	SIM_Unlock();
+}
+
+uint32_t SIM_GetLedToggles(void)
+{
+	return ledToggles;
+}
@@ -0,0 +1,495 @@
+/* sim_i2c.c
+* Bit level model of the bit-banged I2C bus on PTD8/PTD9 and of the devices
+* on it: the BQ32000 RTC, the 24C256 EEPROM and the AM2320 sensor. The bus is
+* sampled on every pin change, the devices drive SDA while SCL is low
+*/
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "sim.h"
+
+#define SIM_RTC_ADDR			0xD0
+#define SIM_EEPROM_ADDR			0xA0
+#define SIM_AM2320_ADDR			0xB8
+
+#define SIM_EEPROM_SIZE			32768
+#define SIM_EEPROM_PAGE			64
+
+typedef struct {
+	const char* name;
+	uint8_t address;					/* write address, the read address is +1 */
+	bool (*start)(bool read);			/* addressed, returns the ACK */
+	bool (*write)(uint8_t data);		/* returns the ACK */
+	uint8_t (*read)(void);
+	void (*stop)(void);
+	uint32_t transfers;
+	uint32_t nacks;
+} SimI2cDevice_t;
+
+enum {
+	SIM_I2C_IDLE = 0,
+	SIM_I2C_ADDRESS,
+	SIM_I2C_WRITE,
+	SIM_I2C_READ,
+	SIM_I2C_IGNORE,
+};
+
+/*================================== BQ32000 ===================================*/
+
+static int32_t rtcOffset;				/* seconds ahead of the host clock */
+static uint8_t rtcRegs[16];
+static uint8_t rtcPointer;
+static bool rtcPointerNext;
+
+static uint8_t SIM_Bcd(int value)
+{
+	return (uint8_t)(((value / 10) << 4) | (value % 10));
+}
+
+static int SIM_Dec(uint8_t value)
+{
+	return (value >> 4) * 10 + (value & 0x0F);
+}
+
+static void SIM_RtcTime(struct tm* tm)
+{
+	time_t now = time(NULL) + rtcOffset;
+	gmtime_r(&now, tm);
+}
+
+static bool SIM_RtcStart(bool read)
+{
+	rtcPointerNext = !read;
+	return true;
+}
+
+/* the time registers are counted from the host clock, a write moves it */
+static bool SIM_RtcWrite(uint8_t data)
+{
+	struct tm tm;
+	if (rtcPointerNext)
+	{
+		rtcPointer = data & 0x0F;
+		rtcPointerNext = false;
+		return true;
+	}
+	SIM_RtcTime(&tm);
+	switch (rtcPointer)
+	{
+	case 0:
+		tm.tm_sec = SIM_Dec(data & 0x7F);
+		break;
+	case 1:
+		tm.tm_min = SIM_Dec(data & 0x7F);
+		break;
+	case 2:
+		tm.tm_hour = SIM_Dec(data & 0x3F);
+		break;
+	case 3:
+		break;
+	case 4:
+		tm.tm_mday = SIM_Dec(data & 0x3F);
+		break;
+	case 5:
+		tm.tm_mon = SIM_Dec(data & 0x1F) - 1;
+		break;
+	case 6:
+		tm.tm_year = SIM_Dec(data) + 100;
+		break;
+	default:
+		rtcRegs[rtcPointer] = data;
+		break;
+	}
+	if (rtcPointer <= 6)
+		rtcOffset = (int32_t)(timegm(&tm) - time(NULL));
+	rtcPointer = (rtcPointer + 1) & 0x0F;
+	return true;
+}
+
+static uint8_t SIM_RtcRead(void)
+{
+	struct tm tm;
+	uint8_t value;
+	SIM_RtcTime(&tm);
+	switch (rtcPointer)
+	{
+	case 0:
+		value = SIM_Bcd(tm.tm_sec);
+		break;
+	case 1:
+		value = SIM_Bcd(tm.tm_min);
+		break;
+	case 2:
+		value = SIM_Bcd(tm.tm_hour);
+		break;
+	case 3:
+		value = (uint8_t)(tm.tm_wday + 1);
+		break;
+	case 4:
+		value = SIM_Bcd(tm.tm_mday);
+		break;
+	case 5:
+		value = SIM_Bcd(tm.tm_mon + 1);
+		break;
+	case 6:
+		value = SIM_Bcd(tm.tm_year % 100);
+		break;
+	default:
+		value = rtcRegs[rtcPointer];
+		break;
+	}
+	rtcPointer = (rtcPointer + 1) & 0x0F;
+	return value;
+}
+
+static void SIM_RtcStop(void)
+{
+}
+
+void SIM_RtcSet(int year, int month, int date, int hour, int min, int sec)
+{
+	struct tm tm;
+	memset(&tm, 0, sizeof(tm));
+	tm.tm_year = year - 1900;
+	tm.tm_mon = month - 1;
+	tm.tm_mday = date;
+	tm.tm_hour = hour;
+	tm.tm_min = min;
+	tm.tm_sec = sec;
+	SIM_Lock();
+	rtcOffset = (int32_t)(timegm(&tm) - time(NULL));
+	SIM_Unlock();
+}
+
+/*================================== 24C256 ====================================*/
+
+static uint8_t eepromData[SIM_EEPROM_SIZE];
+static uint16_t eepromAddress;
+static uint8_t eepromAddressBytes;
+static bool eepromDirty;
+static int eepromFile = -1;
+static uint32_t eepromWriteCycles;
+
+static bool SIM_EepromStart(bool read)
+{
+	if (!read)
+		eepromAddressBytes = 0;
+	return true;
+}
+
+/* a write wraps inside its 64-byte page */
+static bool SIM_EepromWrite(uint8_t data)
+{
+	if (eepromAddressBytes < 2)
+	{
+		eepromAddress = (uint16_t)(((eepromAddress << 8) | data) % SIM_EEPROM_SIZE);
+		eepromAddressBytes++;
+		return true;
+	}
+	eepromData[eepromAddress] = data;
+	eepromAddress = (eepromAddress & ~(SIM_EEPROM_PAGE - 1)) | ((eepromAddress + 1) & (SIM_EEPROM_PAGE - 1));
+	eepromDirty = true;
+	return true;
+}
+
+static uint8_t SIM_EepromRead(void)
+{
+	uint8_t value = eepromData[eepromAddress];
+	eepromAddress = (eepromAddress + 1) % SIM_EEPROM_SIZE;
+	return value;
+}
+
+/* the write cycle starts at the STOP condition */
+static void SIM_EepromStop(void)
+{
+	if (!eepromDirty)
+		return;
+	eepromDirty = false;
+	eepromWriteCycles++;
+	if (eepromFile >= 0)
+	{
+		if (pwrite(eepromFile, eepromData, SIM_EEPROM_SIZE, 0) != SIM_EEPROM_SIZE)
+			SIM_Log("eeprom: cannot write the backing file");
+	}
+}
+
+/* a new file starts blank */
+int SIM_EepromOpen(const char* path)
+{
+	ssize_t n;
+	memset(eepromData, 0xFF, sizeof(eepromData));
+	if (path == NULL)
+		return 0;
+	eepromFile = open(path, O_RDWR | O_CREAT, 0644);
+	if (eepromFile < 0)
+		return -1;
+	n = pread(eepromFile, eepromData, SIM_EEPROM_SIZE, 0);
+	if (n < SIM_EEPROM_SIZE)
+	{
+		if (n < 0)
+			n = 0;
+		memset(eepromData + n, 0xFF, SIM_EEPROM_SIZE - n);
+		if (pwrite(eepromFile, eepromData, SIM_EEPROM_SIZE, 0) != SIM_EEPROM_SIZE)
+			return -1;
+	}
+	return 0;
+}
+
+/*================================== AM2320 ====================================*/
+
+static bool am2320Online = true;
+static int16_t am2320Temperature = 275;		/* 0.1 degree C */
+static uint16_t am2320Humidity = 650;		/* 0.1 %RH */
+static uint8_t am2320Request[4];
+static uint8_t am2320RequestLength;
+static uint8_t am2320Frame[8];
+static uint8_t am2320FramePos;
+static uint32_t am2320Readings;
+
+static bool SIM_Am2320Start(bool read)
+{
+	if (!am2320Online)
+		return false;
+	if (read)
+		am2320FramePos = 0;
+	else
+		am2320RequestLength = 0;
+	return true;
+}
+
+static bool SIM_Am2320Write(uint8_t data)
+{
+	if (am2320RequestLength < sizeof(am2320Request))
+		am2320Request[am2320RequestLength++] = data;
+	return true;
+}
+
+static uint8_t SIM_Am2320Read(void)
+{
+	if (am2320FramePos >= sizeof(am2320Frame))
+		return 0xFF;
+	return am2320Frame[am2320FramePos++];
+}
+
+/* a read of the four registers from 0 is answered with a fresh measurement,
+* the temperature is sign and magnitude */
+static void SIM_Am2320Stop(void)
+{
+	uint16_t temperature, crc;
+	if ((am2320RequestLength != 3) || (am2320Request[0] != 0x03) || (am2320Request[1] != 0x00) ||
+		(am2320Request[2] != 0x04))
+		return;
+	am2320RequestLength = 0;
+	temperature = (am2320Temperature < 0) ? (uint16_t)(0x8000 | -am2320Temperature) : (uint16_t)am2320Temperature;
+	am2320Frame[0] = 0x03;
+	am2320Frame[1] = 0x04;
+	am2320Frame[2] = (uint8_t)(am2320Humidity >> 8);
+	am2320Frame[3] = (uint8_t)am2320Humidity;
+	am2320Frame[4] = (uint8_t)(temperature >> 8);
+	am2320Frame[5] = (uint8_t)temperature;
+	crc = SIM_Crc16Modbus(am2320Frame, 6);
+	am2320Frame[6] = (uint8_t)crc;
+	am2320Frame[7] = (uint8_t)(crc >> 8);
+	am2320Readings++;
+}
+
+void SIM_Am2320Set(int16_t temperature, uint16_t humidity)
+{
+	SIM_Lock();
+	am2320Temperature = temperature;
+	am2320Humidity = humidity;
+	SIM_Unlock();
+}
+
+void SIM_Am2320SetOnline(bool online)
+{
+	SIM_Lock();
+	am2320Online = online;
+	SIM_Unlock();
+}
+
+/*==================================== bus =====================================*/
+
+static SimI2cDevice_t devices[] = {
+	{"BQ32000 RTC", SIM_RTC_ADDR, SIM_RtcStart, SIM_RtcWrite, SIM_RtcRead, SIM_RtcStop},
+	{"24C256 EEPROM", SIM_EEPROM_ADDR, SIM_EepromStart, SIM_EepromWrite, SIM_EepromRead, SIM_EepromStop},
+	{"AM2320 sensor", SIM_AM2320_ADDR, SIM_Am2320Start, SIM_Am2320Write, SIM_Am2320Read, SIM_Am2320Stop},
+};
+
+static uint8_t busState;
+static uint8_t busBit;				/* SCL rising edges in the current byte, 9 with the ACK */
+static uint8_t busShift;
+static bool busRead;
+static bool busMasterAck;
+static bool busSdaDrive = true;
+static bool busScl = true;
+static bool busSda = true;
+static SimI2cDevice_t* busDevice;
+static uint32_t busStarts;
+
+static void SIM_I2cStart(void)
+{
+	busState = SIM_I2C_ADDRESS;
+	busDevice = NULL;
+	busBit = 0;
+	busShift = 0;
+	busSdaDrive = true;
+	busStarts++;
+}
+
+static void SIM_I2cStop(void)
+{
+	if ((busDevice != NULL) && (busState != SIM_I2C_IDLE))
+		busDevice->stop();
+	busState = SIM_I2C_IDLE;
+	busDevice = NULL;
+	busSdaDrive = true;
+}
+
+static void SIM_I2cRising(bool sda)
+{
+	switch (busState)
+	{
+	case SIM_I2C_ADDRESS:
+	case SIM_I2C_WRITE:
+		if (busBit < 8)
+			busShift = (uint8_t)((busShift << 1) | sda);
+		busBit++;
+		break;
+	case SIM_I2C_READ:
+		if (busBit == 8)
+			busMasterAck = !sda;
+		busBit++;
+		break;
+	default:
+		break;
+	}
+}
+
+static void SIM_I2cFalling(void)
+{
+	uint32_t i;
+	bool ack;
+	switch (busState)
+	{
+	case SIM_I2C_ADDRESS:
+		if (busBit == 8)
+		{
+			busDevice = NULL;
+			for (i = 0; i < sizeof(devices) / sizeof(devices[0]); i++)
+			{
+				if (devices[i].address == (busShift & 0xFE))
+					busDevice = &devices[i];
+			}
+			busRead = busShift & 1;
+			ack = (busDevice != NULL) && busDevice->start(busRead);
+			if (busDevice != NULL)
+			{
+				busDevice->transfers++;
+				if (!ack)
+					busDevice->nacks++;
+			}
+			if (ack)
+				busSdaDrive = false;
+			else
+				busState = SIM_I2C_IGNORE;
+		}
+		else if (busBit == 9)
+		{
+			busBit = 0;
+			busShift = 0;
+			if (busRead)
+			{
+				busState = SIM_I2C_READ;
+				busShift = busDevice->read();
+				busSdaDrive = (busShift >> 7) & 1;
+			}
+			else
+			{
+				busState = SIM_I2C_WRITE;
+				busSdaDrive = true;
+			}
+		}
+		break;
+	case SIM_I2C_WRITE:
+		if (busBit == 8)
+		{
+			busSdaDrive = !busDevice->write(busShift);
+		}
+		else if (busBit == 9)
+		{
+			busBit = 0;
+			busShift = 0;
+			busSdaDrive = true;
+		}
+		break;
+	case SIM_I2C_READ:
+		if ((busBit >= 1) && (busBit <= 7))
+		{
+			busSdaDrive = (busShift >> (7 - busBit)) & 1;
+		}
+		else if (busBit == 8)
+		{
+			/* released for the ACK of the master */
+			busSdaDrive = true;
+		}
+		else if (busBit == 9)
+		{
+			busBit = 0;
+			if (busMasterAck)
+			{
+				busShift = busDevice->read();
+				busSdaDrive = (busShift >> 7) & 1;
+			}
+			else
+			{
+				busState = SIM_I2C_IGNORE;
+				busSdaDrive = true;
+			}
+		}
+		break;
+	default:
+		break;
+	}
+}
+
+/* called with the simulation lock held on every change of the bus lines */
+void SIM_I2cBusChanged(bool scl, bool sda)
+{
+	if (scl && busScl && (sda != busSda))
+	{
+		if (!sda)
+			SIM_I2cStart();
+		else
+			SIM_I2cStop();
+	}
+	else if (scl && !busScl)
+	{
+		SIM_I2cRising(sda);
+	}
+	else if (!scl && busScl)
+	{
+		SIM_I2cFalling();
+	}
+	busScl = scl;
+	busSda = sda;
+}
+
+bool SIM_I2cSdaDrive(void)
+{
+	return busSdaDrive;
+}
+
+void SIM_I2cReport(void)
+{
+	uint32_t i;
+	printf("i2c: %u START conditions\n", (unsigned)busStarts);
+	for (i = 0; i < sizeof(devices) / sizeof(devices[0]); i++)
+	{
+		printf("  %-14s 0x%02X %8u transfers %6u NACKed\n", devices[i].name, devices[i].address,
+			   (unsigned)devices[i].transfers, (unsigned)devices[i].nacks);
+	}
+	printf("  eeprom write cycles %u, am2320 measurements %u\n", (unsigned)eepromWriteCycles,
+		   (unsigned)am2320Readings);
+}
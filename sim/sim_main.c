@@ -0,0 +1,166 @@
+/* sim_main.c
+* Entry point of the Linux simulation: maps the target address space, starts
+* the simulated devices and the scenario, then runs main() of the firmware
+*
+*   daq-sim [--tap <ifname>] [--pcap <file>] [--ppp-tun <ifname>] [--flash <file>]
+*           [--eeprom <file>] [--script <file>] [--duration <ms>] [--log <file> | --quiet]
+*/
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <malloc.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "sim.h"
+
+#define SIM_PERIPHERAL_BASE		0x40000000UL
+#define SIM_PERIPHERAL_SIZE		0x00100000UL
+#define SIM_PPB_BASE			0xE0000000UL
+#define SIM_PPB_SIZE			0x00100000UL
+#define SIM_SERVICE_PERIOD		SIM_MS(1)
+
+#ifndef MAP_FIXED_NOREPLACE
+#define MAP_FIXED_NOREPLACE		0x100000
+#endif
+
+int SIM_FirmwareMain(void);
+
+static const struct option options[] = {
+	{"tap", required_argument, NULL, 't'},
+	{"pcap", required_argument, NULL, 'p'},
+	{"ppp-tun", required_argument, NULL, 'u'},
+	{"flash", required_argument, NULL, 'f'},
+	{"eeprom", required_argument, NULL, 'e'},
+	{"script", required_argument, NULL, 's'},
+	{"duration", required_argument, NULL, 'd'},
+	{"log", required_argument, NULL, 'l'},
+	{"quiet", no_argument, NULL, 'q'},
+	{"help", no_argument, NULL, 'h'},
+	{NULL, 0, NULL, 0},
+};
+
+static void SIM_Usage(void)
+{
+	printf("usage: daq-sim [options]\n"
+		   "  --tap <ifname>     connect the Ethernet port to a TAP interface (needs CAP_NET_ADMIN)\n"
+		   "  --pcap <file>      write the Ethernet traffic to a capture file\n"
+		   "  --ppp-tun <ifname> route the IP traffic of the modem to a TUN interface (needs CAP_NET_ADMIN)\n"
+		   "  --flash <file>     back the program flash with a 2 MB file\n"
+		   "  --eeprom <file>    back the 24C256 EEPROM with a 32 KB file\n"
+		   "  --script <file>    run a scenario\n"
+		   "  --duration <ms>    stop after that long and print the report\n"
+		   "  --log <file>       write the firmware console to a file\n"
+		   "  --quiet            discard the firmware console\n");
+}
+
+/* the peripheral registers and the private peripheral bus are plain memory,
+* the simulated peripherals use them where the firmware accesses registers
+* directly */
+static void SIM_MapRegion(unsigned long base, unsigned long size)
+{
+	void* map = mmap((void*)base, size, PROT_READ | PROT_WRITE,
+					 MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+	if (map != (void*)base)
+		SIM_Fatal("cannot map 0x%08lX: %s", base, map == MAP_FAILED ? strerror(errno) : "address in use");
+}
+
+static void* SIM_ServiceThread(void* param)
+{
+	uint64_t next = SIM_Now();
+	(void)param;
+	for (;;)
+	{
+		next += SIM_SERVICE_PERIOD;
+		SIM_SleepUntil(next);
+		SIM_UartService();
+	}
+	return NULL;
+}
+
+int main(int argc, char* argv[])
+{
+	const char* tap = NULL;
+	const char* pcap = NULL;
+	const char* pppTun = NULL;
+	const char* flash = NULL;
+	const char* eeprom = NULL;
+	const char* script = NULL;
+	const char* log = NULL;
+	uint32_t duration = 0;
+	bool quiet = false;
+	sigset_t signals;
+	int option;
+	int fd;
+
+	while ((option = getopt_long(argc, argv, "", options, NULL)) != -1)
+	{
+		switch (option)
+		{
+		case 't': tap = optarg; break;
+		case 'p': pcap = optarg; break;
+		case 'u': pppTun = optarg; break;
+		case 'f': flash = optarg; break;
+		case 'e': eeprom = optarg; break;
+		case 's': script = optarg; break;
+		case 'd': duration = strtoul(optarg, NULL, 0); break;
+		case 'l': log = optarg; break;
+		case 'q': quiet = true; break;
+		case 'h': SIM_Usage(); return 0;
+		default: SIM_Usage(); return 2;
+		}
+	}
+
+	/* the threads created from here on inherit the mask, only the task
+	* threads take the tick and the interrupts */
+	sigemptyset(&signals);
+	sigaddset(&signals, SIGALRM);
+	sigaddset(&signals, SIGUSR1);
+	pthread_sigmask(SIG_BLOCK, &signals, NULL);
+	setvbuf(stdout, NULL, _IOLBF, 0);
+
+	/* one arena and no mmap: the firmware keeps pointers in 32-bit fields */
+	mallopt(M_ARENA_MAX, 1);
+	mallopt(M_MMAP_MAX, 0);
+
+	if (quiet)
+		log = "/dev/null";
+	if (log != NULL)
+	{
+		fd = open(log, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		if ((fd < 0) || (dup2(fd, STDERR_FILENO) < 0))
+			SIM_Fatal("cannot open %s: %s", log, strerror(errno));
+		close(fd);
+	}
+
+	SIM_CpuInit();
+	SIM_SetHostThread();
+	SIM_MapRegion(SIM_PERIPHERAL_BASE, SIM_PERIPHERAL_SIZE);
+	SIM_MapRegion(SIM_PPB_BASE, SIM_PPB_SIZE);
+	if (SIM_FlashMap(flash) != 0)
+		SIM_Fatal("cannot map the flash%s%s: %s", flash ? " to " : "", flash ? flash : "", strerror(errno));
+	if ((eeprom != NULL) && (SIM_EepromOpen(eeprom) != 0))
+		SIM_Fatal("cannot open %s: %s", eeprom, strerror(errno));
+	if ((pcap != NULL) && (SIM_EthOpenPcap(pcap) != 0))
+		SIM_Fatal("cannot open %s: %s", pcap, strerror(errno));
+	if ((tap != NULL) && (SIM_EthOpenTap(tap) != 0))
+		SIM_Fatal("cannot open TAP interface %s: %s", tap, strerror(errno));
+	if ((pppTun != NULL) && (SIM_ModemOpenTun(pppTun) != 0))
+		SIM_Fatal("cannot open TUN interface %s: %s", pppTun, strerror(errno));
+
+	SIM_GpioInit();
+	SIM_UartInit();
+	SIM_ModbusInit();
+	SIM_ModemInit();
+	SIM_StartThread(SIM_ServiceThread, NULL);
+	SIM_CreateTask();
+	if (SIM_ScenarioStart(script, duration) != 0)
+		SIM_Fatal("cannot start the scenario");
+	SIM_Log("firmware starting%s%s", tap ? " on " : "", tap ? tap : "");
+
+	SIM_EnterFirmware();
+	SIM_FirmwareMain();
+	SIM_Log("the scheduler stopped");
+	return 0;
+}
@@ -0,0 +1,270 @@
+/* sim_modbus.c
+* Modbus RTU slaves on the RS-485 bus of UART3: the ATS controller (1), the
+* air conditioner controller (2) and the door controller (3). Each answers
+* read holding registers (3), preset single register (6) and the time
+* register write (50) after its turnaround delay, requests with a bad CRC or
+* for an offline slave get no reply so the firmware times out as on site
+*/
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdio.h>
+#include <string.h>
+#include "sim.h"
+
+#define SIM_MODBUS_REGS			64
+#define SIM_MODBUS_FRAME		128
+#define SIM_MODBUS_QUEUE		4
+#define SIM_MODBUS_DELAY_MS		5
+
+typedef struct {
+	uint8_t address;
+	const char* name;
+	bool online;
+	uint32_t delayMs;
+	uint16_t regs[SIM_MODBUS_REGS];
+	uint32_t requests;
+	uint32_t replies;
+	uint32_t writes;
+	uint32_t unanswered;
+} SimModbusSlave_t;
+
+typedef struct {
+	uint8_t data[SIM_MODBUS_FRAME];
+	size_t length;
+	uint64_t time;
+} SimModbusFrame_t;
+
+static SimModbusSlave_t slaves[] = {
+	{1, "ATS"},
+	{2, "air conditioner"},
+	{3, "door"},
+};
+#define SIM_MODBUS_SLAVES		(sizeof(slaves) / sizeof(slaves[0]))
+
+static SimModbusFrame_t queue[SIM_MODBUS_QUEUE];
+static uint32_t queueHead;
+static uint32_t queueTail;
+static sem_t queueSem;
+static uint32_t crcErrors;
+static uint32_t dropped;
+static uint32_t foreign;
+static uint64_t turnaroundMax;
+
+uint16_t SIM_Crc16Modbus(const uint8_t* data, size_t length)
+{
+	uint16_t crc = 0xFFFF;
+	size_t i;
+	int bit;
+	for (i = 0; i < length; i++)
+	{
+		crc ^= data[i];
+		for (bit = 0; bit < 8; bit++)
+			crc = (crc & 1) ? (crc >> 1) ^ 0xA001 : crc >> 1;
+	}
+	return crc;
+}
+
+static SimModbusSlave_t* SIM_ModbusFind(uint8_t address)
+{
+	uint32_t i;
+	for (i = 0; i < SIM_MODBUS_SLAVES; i++)
+	{
+		if (slaves[i].address == address)
+			return &slaves[i];
+	}
+	return NULL;
+}
+
+static size_t SIM_ModbusAppendCrc(uint8_t* frame, size_t length)
+{
+	uint16_t crc = SIM_Crc16Modbus(frame, length);
+	frame[length++] = (uint8_t)crc;
+	frame[length++] = (uint8_t)(crc >> 8);
+	return length;
+}
+
+/* builds the reply to a request with a valid CRC, 0 when there is none */
+static size_t SIM_ModbusAnswer(SimModbusSlave_t* slave, const uint8_t* request, size_t length, uint8_t* reply)
+{
+	uint16_t start = (request[2] << 8) | request[3];
+	uint16_t count = (request[4] << 8) | request[5];
+	size_t n = 0;
+	uint16_t i;
+	switch (request[1])
+	{
+	case 3:
+		if ((length != 8) || (count == 0) || (start + count > SIM_MODBUS_REGS))
+			return 0;
+		reply[n++] = slave->address;
+		reply[n++] = 3;
+		reply[n++] = (uint8_t)(count * 2);
+		for (i = 0; i < count; i++)
+		{
+			reply[n++] = (uint8_t)(slave->regs[start + i] >> 8);
+			reply[n++] = (uint8_t)slave->regs[start + i];
+		}
+		break;
+	case 6:
+		if ((length != 8) || (start >= SIM_MODBUS_REGS))
+			return 0;
+		/* the echo of the request */
+		slave->regs[start] = count;
+		slave->writes++;
+		memcpy(reply, request, 6);
+		n = 6;
+		break;
+	case 50:
+		/* date, month, year, hour, minute and second from byte 4, the
+		* controllers echo the header */
+		if (length < 10)
+			return 0;
+		slave->writes++;
+		memcpy(reply, request, 6);
+		n = 6;
+		break;
+	default:
+		return 0;
+	}
+	return SIM_ModbusAppendCrc(reply, n);
+}
+
+/* called by UART_WriteBlocking on the thread of the polling task */
+static void SIM_ModbusTx(uint32_t uart, const uint8_t* data, size_t length)
+{
+	SimModbusFrame_t* frame;
+	(void)uart;
+	SIM_Lock();
+	if ((queueHead - queueTail >= SIM_MODBUS_QUEUE) || (length > SIM_MODBUS_FRAME))
+	{
+		dropped++;
+		SIM_Unlock();
+		return;
+	}
+	frame = &queue[queueHead % SIM_MODBUS_QUEUE];
+	memcpy(frame->data, data, length);
+	frame->length = length;
+	frame->time = SIM_Now();
+	queueHead++;
+	SIM_Unlock();
+	sem_post(&queueSem);
+}
+
+static void* SIM_ModbusThread(void* param)
+{
+	SimModbusFrame_t frame;
+	SimModbusSlave_t* slave;
+	uint8_t reply[SIM_MODBUS_FRAME + 8];
+	size_t length;
+	uint64_t turnaround;
+	uint32_t delayMs;
+	bool online;
+	(void)param;
+	for (;;)
+	{
+		while (sem_wait(&queueSem) != 0)
+			;
+		SIM_Lock();
+		frame = queue[queueTail % SIM_MODBUS_QUEUE];
+		queueTail++;
+		SIM_Unlock();
+		if ((frame.length < 4) || (SIM_Crc16Modbus(frame.data, frame.length) != 0))
+		{
+			crcErrors++;
+			continue;
+		}
+		SIM_Lock();
+		slave = SIM_ModbusFind(frame.data[0]);
+		if (slave == NULL)
+		{
+			foreign++;
+			SIM_Unlock();
+			continue;
+		}
+		slave->requests++;
+		online = slave->online;
+		delayMs = slave->delayMs;
+		length = online ? SIM_ModbusAnswer(slave, frame.data, frame.length, reply) : 0;
+		if (length == 0)
+			slave->unanswered++;
+		SIM_Unlock();
+		if (length == 0)
+			continue;
+		SIM_SleepUntil(frame.time + SIM_MS(delayMs));
+		turnaround = SIM_Now() - frame.time;
+		if (turnaround > turnaroundMax)
+			turnaroundMax = turnaround;
+		SIM_UartReceive(SIM_UART_MODBUS, reply, length);
+		slave->replies++;
+	}
+	return NULL;
+}
+
+void SIM_ModbusInit(void)
+{
+	SimModbusSlave_t* ats = &slaves[0];
+	SimModbusSlave_t* aircon = &slaves[1];
+	uint32_t i;
+	for (i = 0; i < SIM_MODBUS_SLAVES; i++)
+	{
+		slaves[i].online = true;
+		slaves[i].delayMs = SIM_MODBUS_DELAY_MS;
+	}
+	/* a site on grid power with the generator stopped */
+	ats->regs[0] = 540;		/* battery 54.0 V */
+	ats->regs[1] = 228;		/* grid */
+	ats->regs[2] = 0;		/* generator */
+	ats->regs[5] = 1;		/* grid status */
+	ats->regs[8] = 1;		/* switch on grid */
+	ats->regs[29] = 5000;	/* frequency */
+	aircon->regs[0] = 25;	/* indoor */
+	aircon->regs[1] = 31;	/* outdoor */
+	aircon->regs[6] = 1;	/* air conditioner 1 running */
+	aircon->regs[8] = 1;	/* fan */
+	sem_init(&queueSem, 0, 0);
+	SIM_UartSetTxHook(SIM_UART_MODBUS, SIM_ModbusTx);
+	SIM_StartThread(SIM_ModbusThread, NULL);
+}
+
+bool SIM_ModbusSetReg(uint8_t address, uint16_t reg, uint16_t value)
+{
+	SimModbusSlave_t* slave = SIM_ModbusFind(address);
+	if ((slave == NULL) || (reg >= SIM_MODBUS_REGS))
+		return false;
+	SIM_Lock();
+	slave->regs[reg] = value;
+	SIM_Unlock();
+	return true;
+}
+
+bool SIM_ModbusSetOnline(uint8_t address, bool online)
+{
+	SimModbusSlave_t* slave = SIM_ModbusFind(address);
+	if (slave == NULL)
+		return false;
+	slave->online = online;
+	return true;
+}
+
+bool SIM_ModbusSetDelay(uint8_t address, uint32_t delayMs)
+{
+	SimModbusSlave_t* slave = SIM_ModbusFind(address);
+	if (slave == NULL)
+		return false;
+	slave->delayMs = delayMs;
+	return true;
+}
+
+void SIM_ModbusReport(void)
+{
+	uint32_t i;
+	printf("modbus slaves\n");
+	for (i = 0; i < SIM_MODBUS_SLAVES; i++)
+	{
+		printf("  %u %-16s %-7s requests %6u  replies %6u  writes %4u  unanswered %4u\n",
+			   slaves[i].address, slaves[i].name, slaves[i].online ? "online" : "offline",
+			   (unsigned)slaves[i].requests, (unsigned)slaves[i].replies,
+			   (unsigned)slaves[i].writes, (unsigned)slaves[i].unanswered);
+	}
+	printf("  bad crc %u  other address %u  dropped %u  max turnaround %.3f ms\n",
+		   (unsigned)crcErrors, (unsigned)foreign, (unsigned)dropped, turnaroundMax / 1e6);
+}
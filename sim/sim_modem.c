@@ -0,0 +1,1213 @@
+/* sim_modem.c
+* GPRS modem on UART1: powered by the supply switch and PWRKEY pins like an
+* M26, it boots, reports RDY and registers to the network after fixed delays,
+* answers the AT commands of modem.c after its command delay and sends the
+* +CREG and +CSQN unsolicited result codes once enabled. After ATD it is the
+* PPP peer of the network. The peer opens LCP
+* without authentication, gives the firmware 10.64.64.2 and the DNS server
+* 10.64.64.1 in IPCP, answers LCP echoes and every ICMP echo request, and
+* can ping the firmware to measure the round trip over the link. Both sides
+* of IPCP offer VJ header compression (sim_vj.c). TCP to the reflector,
+* 10.64.64.9, comes back with the addresses swapped after the latency of the
+* network, minus the packets it loses, so the firmware can run a connection
+* to itself across the link. With a TUN interface the modem routes the other
+* IP packets of the firmware to the host. Frames are byte-timed on the line
+* like every other UART device
+*/
+#include <errno.h>
+#include <fcntl.h>
+#include <net/if.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <linux/if_tun.h>
+#include "sim.h"
+
+#define SIM_MODEM_QUEUE				16384
+#define SIM_MODEM_FRAME				1600
+#define SIM_MODEM_LINE				128
+#define SIM_MODEM_DELAY_MS			20
+#define SIM_MODEM_PING_TIMEOUT_MS	3000
+#define SIM_MODEM_NETWORK_QUEUE		64
+
+/* PWRKEY is held low through a transistor while GPRS_EN is high */
+#define SIM_MODEM_KEY_ON_MS			1000	/* held to power on */
+#define SIM_MODEM_KEY_OFF_MS		700		/* held to power down */
+#define SIM_MODEM_BOOT_MS			2000	/* power on to RDY */
+#define SIM_MODEM_REGISTER_MS		4000	/* power on to registered */
+#define SIM_MODEM_RSSI				24
+
+#define SIM_PPP_FLAG				0x7E
+#define SIM_PPP_ESCAPE				0x7D
+#define SIM_PPP_FCS_GOOD			0xF0B8
+
+#define SIM_PPP_IPCP				0x8021
+#define SIM_PPP_LCP					0xC021
+
+/* LCP and IPCP codes */
+#define SIM_CP_CONF_REQ				1
+#define SIM_CP_CONF_ACK				2
+#define SIM_CP_CONF_NAK				3
+#define SIM_CP_CONF_REJ				4
+#define SIM_CP_TERM_REQ				5
+#define SIM_CP_TERM_ACK				6
+#define SIM_CP_PROTOCOL_REJ			8
+#define SIM_CP_ECHO_REQ				9
+#define SIM_CP_ECHO_REP				10
+
+#define SIM_MODEM_PEER_ADDRESS		0x0A404001	/* 10.64.64.1, also the DNS server */
+#define SIM_MODEM_HOST_ADDRESS		0x0A404002	/* 10.64.64.2, given to the firmware */
+#define SIM_MODEM_REFLECTOR_ADDRESS	0x0A404009	/* 10.64.64.9, sends TCP back to the firmware */
+#define SIM_MODEM_MAGIC				0x53494D31
+
+enum {
+	SIM_MODEM_OFF = 0,
+	SIM_MODEM_BOOTING,
+	SIM_MODEM_READY,
+};
+
+typedef struct {
+	bool reqSent;
+	bool ackSent;
+	bool ackReceived;
+	uint8_t id;
+} SimControlProtocol_t;
+
+typedef struct {
+	uint64_t due;
+	size_t length;
+	uint8_t data[SIM_MODEM_FRAME];
+} SimModemPacket_t;
+
+static uint8_t queue[SIM_MODEM_QUEUE];
+static uint32_t queueHead;
+static uint32_t queueTail;
+static sem_t queueSem;
+static pthread_mutex_t sendMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t ipMutex = PTHREAD_MUTEX_INITIALIZER;
+
+static volatile bool online = true;
+static volatile uint32_t delayMs = SIM_MODEM_DELAY_MS;
+static volatile bool dataMode;
+
+/* power pins, written by the firmware under the lock */
+static bool supplyPin;
+static bool keyPin;
+static uint64_t keyTime;
+static bool keyHandled;
+static volatile int power;
+static uint64_t supplyTime;
+static uint64_t powerTime;
+static volatile uint32_t registerMs = SIM_MODEM_REGISTER_MS;
+static volatile bool registered;
+static volatile int cregMode;
+static volatile bool signalUrc;
+static volatile int rssi = SIM_MODEM_RSSI;
+static uint64_t hangupTime;
+
+/* command mode */
+static char line[SIM_MODEM_LINE];
+static size_t lineLength;
+
+/* data mode */
+static uint8_t rxFrame[SIM_MODEM_FRAME];
+static size_t rxLength;
+static bool rxEscape;
+static SimControlProtocol_t lcp;
+static SimControlProtocol_t ipcp;
+static volatile bool lcpOpen;
+static volatile bool ipcpOpen;
+static uint32_t txAccm;
+static bool txPfc;
+static bool txAcfc;
+
+/* VJ compression: offered when enabled, in is what the firmware sends */
+static volatile bool vjEnabled = true;
+static bool vjRejected;
+static bool vjIn;
+static bool vjOut;
+static SimVj_t vj;
+static uint8_t ipFrame[SIM_MODEM_FRAME];
+static int tunFd = -1;
+
+/* network behind the modem: packets on their way back from the reflector */
+static SimModemPacket_t networkQueue[SIM_MODEM_NETWORK_QUEUE];
+static uint32_t networkHead;
+static uint32_t networkTail;
+static sem_t networkSem;
+static volatile uint32_t latencyMs;
+static volatile uint32_t lossPermille;
+static uint32_t lossRandom = 1;
+
+/* ping of the firmware */
+static volatile uint16_t pingSequence;
+static volatile bool pingReplied;
+static uint16_t ipId;
+
+static uint32_t commands;
+static uint32_t powerOns;
+static uint32_t urcs;
+static uint64_t bringUpTime;
+static uint64_t reconnectTime;
+static uint32_t connects;
+static uint32_t dropped;
+static uint64_t framesIn;
+static uint64_t framesOut;
+static uint32_t badFcs;
+static uint32_t protocolRejects;
+static uint64_t ipIn;
+static uint64_t ipOut;
+static uint32_t echoReplies;
+static uint64_t reflected;
+static uint64_t networkLost;
+static uint64_t networkDropped;
+static uint64_t tunIn;
+static uint64_t tunOut;
+static uint32_t pingsSent;
+static uint32_t pingsReceived;
+static uint64_t pingRttMin;
+static uint64_t pingRttMax;
+static uint64_t pingRttSum;
+
+static uint16_t SIM_PppFcs(uint16_t fcs, const uint8_t* data, size_t length)
+{
+	size_t i;
+	int bit;
+	for (i = 0; i < length; i++)
+	{
+		fcs ^= data[i];
+		for (bit = 0; bit < 8; bit++)
+			fcs = (fcs & 1) ? (fcs >> 1) ^ 0x8408 : fcs >> 1;
+	}
+	return fcs;
+}
+
+static uint16_t SIM_IpChecksum(const uint8_t* data, size_t length)
+{
+	uint32_t sum = 0;
+	size_t i;
+	for (i = 0; i + 1 < length; i += 2)
+		sum += (data[i] << 8) | data[i + 1];
+	if (length & 1)
+		sum += data[length - 1] << 8;
+	while (sum >> 16)
+		sum = (sum & 0xFFFF) + (sum >> 16);
+	return (uint16_t)~sum;
+}
+
+static void SIM_Put16(uint8_t* p, uint16_t value)
+{
+	p[0] = (uint8_t)(value >> 8);
+	p[1] = (uint8_t)value;
+}
+
+static void SIM_Put32(uint8_t* p, uint32_t value)
+{
+	SIM_Put16(p, (uint16_t)(value >> 16));
+	SIM_Put16(p + 2, (uint16_t)value);
+}
+
+static uint32_t SIM_Get32(const uint8_t* p)
+{
+	return ((uint32_t)p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+/*================================ line output =================================*/
+
+/* the thread of the modem and the scenario both send, one frame at a time */
+static void SIM_ModemWrite(const void* data, size_t length)
+{
+	pthread_mutex_lock(&sendMutex);
+	SIM_UartReceive(SIM_UART_MODEM, data, length);
+	pthread_mutex_unlock(&sendMutex);
+}
+
+static void SIM_ModemRespond(const char* info, const char* result)
+{
+	char response[SIM_MODEM_LINE * 2];
+	size_t length = 0;
+	SIM_SleepFor(SIM_MS(delayMs));
+	if (info != NULL)
+		length += snprintf(response + length, sizeof(response) - length, "\r\n%s\r\n", info);
+	snprintf(response + length, sizeof(response) - length, "\r\n%s\r\n", result);
+	SIM_ModemWrite(response, strlen(response));
+}
+
+/* unsolicited result codes go out without the command delay */
+static void SIM_ModemUrc(const char* text)
+{
+	char urc[SIM_MODEM_LINE];
+	if ((power != SIM_MODEM_READY) || dataMode)
+		return;
+	snprintf(urc, sizeof(urc), "\r\n%s\r\n", text);
+	urcs++;
+	SIM_ModemWrite(urc, strlen(urc));
+}
+
+/* LCP goes out with the default framing, the rest with what the firmware
+* asked for once LCP is open */
+static void SIM_ModemSend(uint16_t protocol, const uint8_t* data, size_t length)
+{
+	uint8_t frame[SIM_MODEM_FRAME + 8];
+	uint8_t out[2 * sizeof(frame) + 2];
+	bool negotiated = lcpOpen && (protocol != SIM_PPP_LCP);
+	uint32_t accm = negotiated ? txAccm : 0xFFFFFFFF;
+	uint16_t fcs;
+	size_t n = 0, i, k = 0;
+	if (!online || (power != SIM_MODEM_READY) || (length > SIM_MODEM_FRAME))
+		return;
+	if (!negotiated || !txAcfc)
+	{
+		frame[n++] = 0xFF;
+		frame[n++] = 0x03;
+	}
+	if (!negotiated || !txPfc || (protocol > 0xFF))
+		frame[n++] = (uint8_t)(protocol >> 8);
+	frame[n++] = (uint8_t)protocol;
+	memcpy(frame + n, data, length);
+	n += length;
+	fcs = SIM_PppFcs(0xFFFF, frame, n) ^ 0xFFFF;
+	frame[n++] = (uint8_t)fcs;
+	frame[n++] = (uint8_t)(fcs >> 8);
+	out[k++] = SIM_PPP_FLAG;
+	for (i = 0; i < n; i++)
+	{
+		if ((frame[i] == SIM_PPP_FLAG) || (frame[i] == SIM_PPP_ESCAPE) ||
+			((frame[i] < 0x20) && (accm & (1u << frame[i]))))
+		{
+			out[k++] = SIM_PPP_ESCAPE;
+			out[k++] = frame[i] ^ 0x20;
+		}
+		else
+		{
+			out[k++] = frame[i];
+		}
+	}
+	out[k++] = SIM_PPP_FLAG;
+	framesOut++;
+	SIM_ModemWrite(out, k);
+}
+
+static void SIM_ModemSendPacket(uint16_t protocol, uint8_t code, uint8_t id, const uint8_t* data, size_t length)
+{
+	uint8_t packet[SIM_MODEM_FRAME];
+	if (length + 4 > sizeof(packet))
+		return;
+	packet[0] = code;
+	packet[1] = id;
+	SIM_Put16(packet + 2, (uint16_t)(length + 4));
+	memcpy(packet + 4, data, length);
+	SIM_ModemSend(protocol, packet, length + 4);
+}
+
+/* IP datagrams to the firmware are compressed and sent in the same order */
+static void SIM_ModemSendIp(const uint8_t* packet, size_t length)
+{
+	uint8_t frame[SIM_MODEM_FRAME];
+	uint16_t protocol = SIM_PPP_IP;
+	if (length > sizeof(frame))
+		return;
+	pthread_mutex_lock(&ipMutex);
+	memcpy(frame, packet, length);
+	if (vjOut)
+		protocol = SIM_VjCompress(&vj, frame, &length);
+	ipOut++;
+	SIM_ModemSend(protocol, frame, length);
+	pthread_mutex_unlock(&ipMutex);
+}
+
+/*================================ command mode ================================*/
+
+static void SIM_ModemEnterDataMode(void)
+{
+	rxLength = 0;
+	rxEscape = false;
+	memset(&lcp, 0, sizeof(lcp));
+	memset(&ipcp, 0, sizeof(ipcp));
+	lcpOpen = false;
+	ipcpOpen = false;
+	txAccm = 0xFFFFFFFF;
+	txPfc = false;
+	txAcfc = false;
+	vjRejected = false;
+	vjIn = false;
+	vjOut = false;
+	connects++;
+	dataMode = true;
+}
+
+static void SIM_ModemCommand(const char* command)
+{
+	char info[SIM_MODEM_LINE];
+	commands++;
+	if (strncmp(command, "AT", 2) != 0)
+		return;
+	if (strcmp(command, "AT+CGMM") == 0)
+		SIM_ModemRespond("M26", "OK");
+	else if (strcmp(command, "AT+CGMR") == 0)
+		SIM_ModemRespond("Revision: M26FBR03A01", "OK");
+	else if (strcmp(command, "AT+QCCID") == 0)
+		SIM_ModemRespond("89840480000000000001", "OK");
+	else if (strcmp(command, "AT+CPIN?") == 0)
+		SIM_ModemRespond("+CPIN: READY", "OK");
+	else if (strcmp(command, "AT+CREG?") == 0)
+	{
+		snprintf(info, sizeof(info), "+CREG: %d,%d", cregMode, registered ? 1 : 2);
+		SIM_ModemRespond(info, "OK");
+	}
+	else if (strncmp(command, "AT+CREG=", 8) == 0)
+	{
+		cregMode = command[8] - '0';
+		SIM_ModemRespond(NULL, "OK");
+	}
+	else if (strcmp(command, "AT+CSQ") == 0)
+	{
+		snprintf(info, sizeof(info), "+CSQ: %d,0", rssi);
+		SIM_ModemRespond(info, "OK");
+	}
+	else if (strncmp(command, "AT+QEXTUNSOL=\"SQ\",", 18) == 0)
+	{
+		signalUrc = (command[18] == '1');
+		SIM_ModemRespond(NULL, "OK");
+		/* the current level follows the enable */
+		if (signalUrc)
+		{
+			snprintf(info, sizeof(info), "+CSQN: %d,0", rssi);
+			SIM_ModemUrc(info);
+		}
+	}
+	else if (strncmp(command, "ATD", 3) == 0)
+	{
+		if (!registered)
+		{
+			SIM_ModemRespond(NULL, "NO CARRIER");
+			return;
+		}
+		SIM_ModemRespond(NULL, "CONNECT 115200");
+		SIM_ModemEnterDataMode();
+	}
+	else
+		SIM_ModemRespond(NULL, "OK");
+}
+
+/* like a Hayes modem, a command line starts at "AT": whatever comes before,
+* such as the PPP frames of the firmware after the call ended, is dropped */
+static void SIM_ModemCommandInput(uint8_t c)
+{
+	if ((c == '\r') || (c == '\n'))
+	{
+		line[lineLength] = '\0';
+		if (lineLength > 0)
+			SIM_ModemCommand(line);
+		lineLength = 0;
+	}
+	else if (lineLength == 0)
+	{
+		if (c == 'A')
+			line[lineLength++] = (char)c;
+	}
+	else if ((lineLength == 1) && (c != 'T'))
+	{
+		lineLength = (c == 'A') ? 1 : 0;
+	}
+	else if (lineLength < sizeof(line) - 1)
+	{
+		line[lineLength++] = (char)c;
+	}
+}
+
+/*============================== control protocols =============================*/
+
+static void SIM_LcpSendConfigureRequest(void)
+{
+	uint8_t options[12];
+	/* ACCM 0: the firmware need not escape anything towards the modem */
+	options[0] = 2;
+	options[1] = 6;
+	SIM_Put32(options + 2, 0);
+	options[6] = 5;
+	options[7] = 6;
+	SIM_Put32(options + 8, SIM_MODEM_MAGIC);
+	SIM_ModemSendPacket(SIM_PPP_LCP, SIM_CP_CONF_REQ, ++lcp.id, options, lcp.reqSent ? 0 : sizeof(options));
+	lcp.reqSent = true;
+}
+
+static void SIM_LcpConfigureRequest(const uint8_t* packet, size_t length)
+{
+	uint8_t rejected[SIM_MODEM_FRAME];
+	size_t i, n = 0;
+	uint32_t accm = 0xFFFFFFFF;
+	bool pfc = false, acfc = false;
+	for (i = 4; i + 2 <= length && packet[i + 1] >= 2 && i + packet[i + 1] <= length; i += packet[i + 1])
+	{
+		switch (packet[i])
+		{
+		case 1:		/* MRU */
+		case 5:		/* magic number */
+			break;
+		case 2:
+			if (packet[i + 1] == 6)
+				accm = SIM_Get32(packet + i + 2);
+			break;
+		case 7:
+			pfc = true;
+			break;
+		case 8:
+			acfc = true;
+			break;
+		default:
+			/* no authentication, no quality protocol */
+			memcpy(rejected + n, packet + i, packet[i + 1]);
+			n += packet[i + 1];
+			break;
+		}
+	}
+	if (n > 0)
+	{
+		SIM_ModemSendPacket(SIM_PPP_LCP, SIM_CP_CONF_REJ, packet[1], rejected, n);
+		return;
+	}
+	SIM_ModemSendPacket(SIM_PPP_LCP, SIM_CP_CONF_ACK, packet[1], packet + 4, length - 4);
+	lcp.ackSent = true;
+	txAccm = accm;
+	txPfc = pfc;
+	txAcfc = acfc;
+	if (!lcp.reqSent)
+		SIM_LcpSendConfigureRequest();
+	lcpOpen = lcp.ackReceived;
+}
+
+static void SIM_ModemLcp(const uint8_t* packet, size_t length)
+{
+	uint8_t reply[SIM_MODEM_FRAME];
+	switch (packet[0])
+	{
+	case SIM_CP_CONF_REQ:
+		SIM_LcpConfigureRequest(packet, length);
+		break;
+	case SIM_CP_CONF_ACK:
+		lcp.ackReceived = true;
+		lcpOpen = lcp.ackSent;
+		break;
+	case SIM_CP_CONF_NAK:
+	case SIM_CP_CONF_REJ:
+		/* again without options */
+		SIM_LcpSendConfigureRequest();
+		break;
+	case SIM_CP_TERM_REQ:
+		SIM_ModemSendPacket(SIM_PPP_LCP, SIM_CP_TERM_ACK, packet[1], NULL, 0);
+		/* the call ends, back to commands */
+		dataMode = false;
+		lcpOpen = false;
+		ipcpOpen = false;
+		lineLength = 0;
+		SIM_ModemRespond(NULL, "NO CARRIER");
+		break;
+	case SIM_CP_ECHO_REQ:
+		if ((length < 8) || (length > sizeof(reply)))
+			break;
+		memcpy(reply, packet + 4, length - 4);
+		SIM_Put32(reply, SIM_MODEM_MAGIC);
+		SIM_ModemSendPacket(SIM_PPP_LCP, SIM_CP_ECHO_REP, packet[1], reply, length - 4);
+		break;
+	default:
+		break;
+	}
+}
+
+/* VJ with all the slots, the slot ID may be left out */
+static size_t SIM_IpcpVjOption(uint8_t* option)
+{
+	option[0] = 2;
+	option[1] = 6;
+	SIM_Put16(option + 2, SIM_PPP_VJ_COMP);
+	option[4] = SIM_VJ_SLOTS - 1;
+	option[5] = 1;
+	return 6;
+}
+
+/* PPP is up: the time since the supply was switched on, or since the
+* network hung up, is the bring-up or the reconnect time */
+static void SIM_ModemNetworkOpened(void)
+{
+	uint64_t now = SIM_Now();
+	if (hangupTime != 0)
+		reconnectTime = now - hangupTime;
+	else if (supplyTime != 0)
+		bringUpTime = now - supplyTime;
+	hangupTime = 0;
+	supplyTime = 0;
+	ipcpOpen = true;
+}
+
+static void SIM_IpcpSendConfigureRequest(void)
+{
+	uint8_t options[12];
+	size_t n = 6;
+	options[0] = 3;
+	options[1] = 6;
+	SIM_Put32(options + 2, SIM_MODEM_PEER_ADDRESS);
+	if (vjEnabled && !vjRejected)
+		n += SIM_IpcpVjOption(options + n);
+	SIM_ModemSendPacket(SIM_PPP_IPCP, SIM_CP_CONF_REQ, ++ipcp.id, options, n);
+	ipcp.reqSent = true;
+}
+
+static void SIM_IpcpConfigureRequest(const uint8_t* packet, size_t length)
+{
+	uint8_t naked[SIM_MODEM_FRAME];
+	uint8_t rejected[SIM_MODEM_FRAME];
+	size_t i, nak = 0, rej = 0;
+	uint32_t wanted;
+	bool vjRequested = false;
+	uint8_t vjMaxSlotId = 0, vjCompSlot = 0;
+	for (i = 4; i + 2 <= length && packet[i + 1] >= 2 && i + packet[i + 1] <= length; i += packet[i + 1])
+	{
+		switch (packet[i])
+		{
+		case 2:		/* IP compression protocol */
+			if (!vjEnabled)
+			{
+				memcpy(rejected + rej, packet + i, packet[i + 1]);
+				rej += packet[i + 1];
+			}
+			else if ((packet[i + 1] == 6) && (((packet[i + 2] << 8) | packet[i + 3]) == SIM_PPP_VJ_COMP))
+			{
+				vjRequested = true;
+				vjMaxSlotId = packet[i + 4];
+				vjCompSlot = packet[i + 5];
+			}
+			else
+			{
+				nak += SIM_IpcpVjOption(naked + nak);
+			}
+			break;
+		case 3:		/* IP address */
+		case 129:	/* primary DNS */
+		case 131:	/* secondary DNS */
+			wanted = (packet[i] == 3) ? SIM_MODEM_HOST_ADDRESS : SIM_MODEM_PEER_ADDRESS;
+			if ((packet[i + 1] == 6) && (SIM_Get32(packet + i + 2) == wanted))
+				break;
+			naked[nak] = packet[i];
+			naked[nak + 1] = 6;
+			SIM_Put32(naked + nak + 2, wanted);
+			nak += 6;
+			break;
+		default:
+			memcpy(rejected + rej, packet + i, packet[i + 1]);
+			rej += packet[i + 1];
+			break;
+		}
+	}
+	if (!ipcp.reqSent)
+		SIM_IpcpSendConfigureRequest();
+	if (rej > 0)
+		SIM_ModemSendPacket(SIM_PPP_IPCP, SIM_CP_CONF_REJ, packet[1], rejected, rej);
+	else if (nak > 0)
+		SIM_ModemSendPacket(SIM_PPP_IPCP, SIM_CP_CONF_NAK, packet[1], naked, nak);
+	else
+	{
+		pthread_mutex_lock(&ipMutex);
+		SIM_VjInit(&vj, vjMaxSlotId, vjCompSlot != 0);
+		vjOut = vjRequested;
+		pthread_mutex_unlock(&ipMutex);
+		SIM_ModemSendPacket(SIM_PPP_IPCP, SIM_CP_CONF_ACK, packet[1], packet + 4, length - 4);
+		ipcp.ackSent = true;
+		if (ipcp.ackReceived)
+			SIM_ModemNetworkOpened();
+	}
+}
+
+static void SIM_ModemIpcp(const uint8_t* packet, size_t length)
+{
+	switch (packet[0])
+	{
+	case SIM_CP_CONF_REQ:
+		SIM_IpcpConfigureRequest(packet, length);
+		break;
+	case SIM_CP_CONF_ACK:
+		vjIn = vjEnabled && !vjRejected;
+		ipcp.ackReceived = true;
+		if (ipcp.ackSent)
+			SIM_ModemNetworkOpened();
+		break;
+	case SIM_CP_CONF_NAK:
+	case SIM_CP_CONF_REJ:
+		/* only VJ can be refused, the address is the one of the network */
+		vjRejected = true;
+		SIM_IpcpSendConfigureRequest();
+		break;
+	case SIM_CP_TERM_REQ:
+		SIM_ModemSendPacket(SIM_PPP_IPCP, SIM_CP_TERM_ACK, packet[1], NULL, 0);
+		ipcpOpen = false;
+		break;
+	default:
+		break;
+	}
+}
+
+/*==================================== IP ======================================*/
+
+/* queues the packet with the addresses swapped, a full queue drops it like
+* the buffer of a router. The checksums cover both addresses the same way */
+static void SIM_ModemReflect(const uint8_t* packet, size_t length)
+{
+	SimModemPacket_t* p;
+	reflected++;
+	lossRandom ^= lossRandom << 13;
+	lossRandom ^= lossRandom >> 17;
+	lossRandom ^= lossRandom << 5;
+	if (lossRandom % 1000 < lossPermille)
+	{
+		networkLost++;
+		return;
+	}
+	SIM_Lock();
+	if (networkHead - networkTail >= SIM_MODEM_NETWORK_QUEUE)
+	{
+		SIM_Unlock();
+		networkDropped++;
+		return;
+	}
+	p = &networkQueue[networkHead % SIM_MODEM_NETWORK_QUEUE];
+	SIM_Unlock();
+	memcpy(p->data, packet, length);
+	memcpy(p->data + 12, packet + 16, 4);
+	memcpy(p->data + 16, packet + 12, 4);
+	p->length = length;
+	p->due = SIM_Now() + SIM_MS(latencyMs);
+	SIM_Lock();
+	networkHead++;
+	SIM_Unlock();
+	sem_post(&networkSem);
+}
+
+static void SIM_ModemIp(const uint8_t* packet, size_t length)
+{
+	uint8_t reply[SIM_MODEM_FRAME];
+	size_t headerLength;
+	ipIn++;
+	if ((length < 20) || ((packet[0] >> 4) != 4))
+		return;
+	headerLength = (packet[0] & 0x0F) * 4;
+	if ((packet[9] == 6) && (SIM_Get32(packet + 16) == SIM_MODEM_REFLECTOR_ADDRESS))
+	{
+		SIM_ModemReflect(packet, length);
+		return;
+	}
+	/* the modem answers ICMP itself and routes the rest to the host */
+	if ((packet[9] != 1) && (tunFd >= 0))
+	{
+		if (write(tunFd, packet, length) == (ssize_t)length)
+			tunOut++;
+		return;
+	}
+	if ((packet[9] != 1) || (length < headerLength + 8) || (length > sizeof(reply)))
+		return;
+	/* an echo reply to the ping of the scenario */
+	if ((packet[headerLength] == 0) && (packet[headerLength + 6] == (uint8_t)(pingSequence >> 8)) &&
+		(packet[headerLength + 7] == (uint8_t)pingSequence))
+	{
+		pingReplied = true;
+		return;
+	}
+	if (packet[headerLength] != 8)
+		return;
+	/* every address answers a ping from the firmware */
+	memcpy(reply, packet, length);
+	memcpy(reply + 12, packet + 16, 4);
+	memcpy(reply + 16, packet + 12, 4);
+	reply[8] = 64;
+	SIM_Put16(reply + 10, 0);
+	SIM_Put16(reply + 10, SIM_IpChecksum(reply, headerLength));
+	reply[headerLength] = 0;
+	SIM_Put16(reply + headerLength + 2, 0);
+	SIM_Put16(reply + headerLength + 2, SIM_IpChecksum(reply + headerLength, length - headerLength));
+	echoReplies++;
+	SIM_ModemSendIp(reply, length);
+}
+
+/*================================= data mode ==================================*/
+
+static void SIM_ModemFrame(const uint8_t* frame, size_t length)
+{
+	uint8_t reject[SIM_MODEM_FRAME];
+	uint16_t protocol;
+	framesIn++;
+	if ((length >= 2) && (frame[0] == 0xFF) && (frame[1] == 0x03))
+	{
+		frame += 2;
+		length -= 2;
+	}
+	if (length < 1)
+		return;
+	/* a compressed protocol field is odd */
+	if (frame[0] & 1)
+	{
+		protocol = frame[0];
+		frame++;
+		length--;
+	}
+	else
+	{
+		if (length < 2)
+			return;
+		protocol = (frame[0] << 8) | frame[1];
+		frame += 2;
+		length -= 2;
+	}
+	if ((protocol == SIM_PPP_LCP) && (length >= 4))
+	{
+		SIM_ModemLcp(frame, length);
+	}
+	else if ((protocol == SIM_PPP_IPCP) && (length >= 4) && lcpOpen)
+	{
+		SIM_ModemIpcp(frame, length);
+	}
+	else if ((protocol == SIM_PPP_IP) && ipcpOpen)
+	{
+		SIM_ModemIp(frame, length);
+	}
+	else if (((protocol == SIM_PPP_VJ_COMP) || (protocol == SIM_PPP_VJ_UNCOMP)) && ipcpOpen && vjIn)
+	{
+		length = SIM_VjDecompress(&vj, protocol, frame, length, ipFrame, sizeof(ipFrame));
+		if (length > 0)
+			SIM_ModemIp(ipFrame, length);
+	}
+	else if (lcpOpen && (length + 2 <= sizeof(reject)))
+	{
+		protocolRejects++;
+		SIM_Put16(reject, protocol);
+		memcpy(reject + 2, frame, length);
+		SIM_ModemSendPacket(SIM_PPP_LCP, SIM_CP_PROTOCOL_REJ, ++lcp.id, reject, length + 2);
+	}
+}
+
+static void SIM_ModemDataInput(uint8_t c)
+{
+	if (c == SIM_PPP_FLAG)
+	{
+		if (rxLength >= 4)
+		{
+			if (SIM_PppFcs(0xFFFF, rxFrame, rxLength) == SIM_PPP_FCS_GOOD)
+			{
+				SIM_ModemFrame(rxFrame, rxLength - 2);
+			}
+			else
+			{
+				badFcs++;
+				SIM_VjLost(&vj);
+			}
+		}
+		rxLength = 0;
+		rxEscape = false;
+	}
+	else if ((c == '\r') && (rxLength >= 2) && (rxFrame[0] == 'A') && (rxFrame[1] == 'T'))
+	{
+		/* the firmware restarted the module without ending the call */
+		dataMode = false;
+		rxFrame[rxLength] = '\0';
+		SIM_ModemCommand((const char*)rxFrame);
+		rxLength = 0;
+	}
+	else if (c == SIM_PPP_ESCAPE)
+	{
+		rxEscape = true;
+	}
+	else if (rxLength < sizeof(rxFrame) - 1)
+	{
+		rxFrame[rxLength++] = rxEscape ? c ^ 0x20 : c;
+		rxEscape = false;
+	}
+}
+
+/*============================== thread and hook ===============================*/
+
+/* called on the thread that sends the byte: a task, its interrupt handler or
+* the eDMA service */
+static void SIM_ModemTx(uint32_t uart, const uint8_t* data, size_t length)
+{
+	size_t i;
+	(void)uart;
+	SIM_Lock();
+	for (i = 0; i < length; i++)
+	{
+		if (queueHead - queueTail >= SIM_MODEM_QUEUE)
+		{
+			dropped++;
+			break;
+		}
+		queue[queueHead++ % SIM_MODEM_QUEUE] = data[i];
+	}
+	SIM_Unlock();
+	sem_post(&queueSem);
+}
+
+static void* SIM_ModemThread(void* param)
+{
+	uint8_t c;
+	(void)param;
+	for (;;)
+	{
+		while (sem_wait(&queueSem) != 0)
+			;
+		for (;;)
+		{
+			SIM_Lock();
+			if (queueTail == queueHead)
+			{
+				SIM_Unlock();
+				break;
+			}
+			c = queue[queueTail++ % SIM_MODEM_QUEUE];
+			SIM_Unlock();
+			/* an offline or booting module hears nothing */
+			if (!online || (power != SIM_MODEM_READY))
+				continue;
+			if (dataMode)
+				SIM_ModemDataInput(c);
+			else
+				SIM_ModemCommandInput(c);
+		}
+	}
+	return NULL;
+}
+
+/* the module loses the call and its settings */
+static void SIM_ModemReset(void)
+{
+	dataMode = false;
+	lcpOpen = false;
+	ipcpOpen = false;
+	lineLength = 0;
+	registered = false;
+	cregMode = 0;
+	signalUrc = false;
+}
+
+/* follows the power pins every millisecond: PWRKEY held long enough powers
+* the module on or down, then it boots and registers after fixed delays */
+static void* SIM_ModemPowerThread(void* param)
+{
+	uint64_t now, held;
+	bool supply, key, handled;
+	(void)param;
+	for (;;)
+	{
+		SIM_SleepFor(SIM_MS(1));
+		now = SIM_Now();
+		SIM_Lock();
+		supply = supplyPin;
+		key = keyPin;
+		held = key ? now - keyTime : 0;
+		handled = keyHandled;
+		SIM_Unlock();
+		if (!supply)
+		{
+			if (power != SIM_MODEM_OFF)
+			{
+				power = SIM_MODEM_OFF;
+				SIM_ModemReset();
+			}
+			continue;
+		}
+		if (key && !handled)
+		{
+			if ((power == SIM_MODEM_OFF) && (held >= SIM_MS(SIM_MODEM_KEY_ON_MS)))
+			{
+				power = SIM_MODEM_BOOTING;
+				powerTime = now;
+				powerOns++;
+				keyHandled = true;
+			}
+			else if ((power != SIM_MODEM_OFF) && (held >= SIM_MS(SIM_MODEM_KEY_OFF_MS)))
+			{
+				SIM_ModemUrc("NORMAL POWER DOWN");
+				power = SIM_MODEM_OFF;
+				SIM_ModemReset();
+				keyHandled = true;
+			}
+		}
+		if ((power == SIM_MODEM_BOOTING) && (now - powerTime >= SIM_MS(SIM_MODEM_BOOT_MS)))
+		{
+			power = SIM_MODEM_READY;
+			SIM_ModemUrc("RDY");
+			SIM_ModemUrc("+CFUN: 1");
+			SIM_ModemUrc("+CPIN: READY");
+			SIM_ModemUrc("Call Ready");
+		}
+		if ((power == SIM_MODEM_READY) && !registered && (now - powerTime >= SIM_MS(registerMs)))
+		{
+			registered = true;
+			if (cregMode != 0)
+				SIM_ModemUrc("+CREG: 1");
+		}
+	}
+	return NULL;
+}
+
+/* sends the reflected packets once due, at the pace of the line */
+static void* SIM_ModemNetworkThread(void* param)
+{
+	SimModemPacket_t* p;
+	(void)param;
+	for (;;)
+	{
+		while (sem_wait(&networkSem) != 0)
+			;
+		p = &networkQueue[networkTail % SIM_MODEM_NETWORK_QUEUE];
+		SIM_SleepUntil(p->due);
+		if (ipcpOpen)
+			SIM_ModemSendIp(p->data, p->length);
+		SIM_Lock();
+		networkTail++;
+		SIM_Unlock();
+	}
+	return NULL;
+}
+
+/* packets of the host to the firmware, dropped while PPP is down */
+static void* SIM_ModemTunThread(void* param)
+{
+	uint8_t packet[SIM_MODEM_FRAME];
+	ssize_t length;
+	(void)param;
+	for (;;)
+	{
+		length = read(tunFd, packet, sizeof(packet));
+		if (length < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			SIM_Log("ppp tun read failed: %s", strerror(errno));
+			return NULL;
+		}
+		if ((length < 20) || ((packet[0] >> 4) != 4) || !ipcpOpen)
+			continue;
+		tunIn++;
+		SIM_ModemSendIp(packet, length);
+	}
+	return NULL;
+}
+
+int SIM_ModemOpenTun(const char* name)
+{
+	struct ifreq ifr;
+	int sock;
+	tunFd = open("/dev/net/tun", O_RDWR);
+	if (tunFd < 0)
+		return -1;
+	memset(&ifr, 0, sizeof(ifr));
+	ifr.ifr_flags = IFF_TUN | IFF_NO_PI;
+	strncpy(ifr.ifr_name, name, IFNAMSIZ - 1);
+	if (ioctl(tunFd, TUNSETIFF, &ifr) < 0)
+		goto fail;
+	sock = socket(AF_INET, SOCK_DGRAM, 0);
+	if (sock < 0)
+		goto fail;
+	if (ioctl(sock, SIOCGIFFLAGS, &ifr) == 0)
+	{
+		ifr.ifr_flags |= IFF_UP;
+		ioctl(sock, SIOCSIFFLAGS, &ifr);
+	}
+	close(sock);
+	SIM_StartThread(SIM_ModemTunThread, NULL);
+	return 0;
+fail:
+	close(tunFd);
+	tunFd = -1;
+	return -1;
+}
+
+void SIM_ModemInit(void)
+{
+	sem_init(&queueSem, 0, 0);
+	sem_init(&networkSem, 0, 0);
+	SIM_UartSetTxHook(SIM_UART_MODEM, SIM_ModemTx);
+	SIM_StartThread(SIM_ModemThread, NULL);
+	SIM_StartThread(SIM_ModemNetworkThread, NULL);
+	SIM_StartThread(SIM_ModemPowerThread, NULL);
+}
+
+/* GPRS_PWR switches the supply, GPRS_EN high holds PWRKEY low. Called under
+* the lock when the firmware writes the port */
+void SIM_ModemPins(bool supply, bool key)
+{
+	uint64_t now = SIM_Now();
+	if (supply && !supplyPin)
+		supplyTime = now;
+	if (key && !keyPin)
+	{
+		keyTime = now;
+		keyHandled = false;
+	}
+	supplyPin = supply;
+	keyPin = key;
+}
+
+/*================================== scenario ==================================*/
+
+void SIM_ModemSetOnline(bool state)
+{
+	online = state;
+}
+
+void SIM_ModemSetDelay(uint32_t milliseconds)
+{
+	delayMs = milliseconds;
+}
+
+/* offer VJ compression or refuse it, from the next IPCP negotiation */
+void SIM_ModemSetVj(bool enabled)
+{
+	vjEnabled = enabled;
+}
+
+/* one-way latency of the network to the reflector and back */
+void SIM_ModemSetLatency(uint32_t milliseconds)
+{
+	latencyMs = milliseconds;
+}
+
+/* share of the reflected packets the network loses, in 1/1000 */
+void SIM_ModemSetLoss(uint32_t permille)
+{
+	lossPermille = permille;
+}
+
+/* time from power on to registered */
+void SIM_ModemSetRegisterDelay(uint32_t milliseconds)
+{
+	registerMs = milliseconds;
+}
+
+/* signal level of +CSQ, reported by +CSQN once enabled */
+void SIM_ModemSetSignal(int level)
+{
+	char urc[32];
+	rssi = level;
+	if (signalUrc)
+	{
+		snprintf(urc, sizeof(urc), "+CSQN: %d,0", level);
+		SIM_ModemUrc(urc);
+	}
+}
+
+/* the network ends the call: LCP Terminate-Request, then NO CARRIER. False
+* when PPP is not up */
+bool SIM_ModemHangup(void)
+{
+	if (!ipcpOpen)
+		return false;
+	hangupTime = SIM_Now();
+	SIM_ModemSendPacket(SIM_PPP_LCP, SIM_CP_TERM_REQ, ++lcp.id, NULL, 0);
+	dataMode = false;
+	lcpOpen = false;
+	ipcpOpen = false;
+	lineLength = 0;
+	SIM_ModemRespond(NULL, "NO CARRIER");
+	return true;
+}
+
+/* 0 off, 1 booting, 2 on */
+uint32_t SIM_ModemPower(void)
+{
+	return power;
+}
+
+uint32_t SIM_ModemNetworkUp(void)
+{
+	return ipcpOpen ? 1 : 0;
+}
+
+uint32_t SIM_ModemPingsReceived(void)
+{
+	return pingsReceived;
+}
+
+/* echo requests of <size> data bytes to the firmware, one at a time, false
+* when PPP is not up */
+bool SIM_ModemPing(uint32_t count, uint32_t size)
+{
+	uint8_t packet[SIM_MODEM_FRAME];
+	uint64_t start, rtt;
+	uint32_t i, received = 0;
+	size_t length = 20 + 8 + size;
+	if (!ipcpOpen || (length > sizeof(packet)))
+		return false;
+	for (i = 0; i < count; i++)
+	{
+		memset(packet, 0, 28);
+		packet[0] = 0x45;
+		SIM_Put16(packet + 2, (uint16_t)length);
+		SIM_Put16(packet + 4, ++ipId);
+		packet[8] = 64;
+		packet[9] = 1;
+		SIM_Put32(packet + 12, SIM_MODEM_PEER_ADDRESS);
+		SIM_Put32(packet + 16, SIM_MODEM_HOST_ADDRESS);
+		SIM_Put16(packet + 10, SIM_IpChecksum(packet, 20));
+		packet[20] = 8;
+		SIM_Put16(packet + 24, 0x5349);
+		SIM_Put16(packet + 26, (uint16_t)(pingSequence + 1));
+		memset(packet + 28, 0xA5, size);
+		SIM_Put16(packet + 22, SIM_IpChecksum(packet + 20, length - 20));
+		pingReplied = false;
+		pingSequence++;
+		pingsSent++;
+		start = SIM_Now();
+		SIM_ModemSendIp(packet, length);
+		while (!pingReplied && (SIM_Now() - start < SIM_MS(SIM_MODEM_PING_TIMEOUT_MS)))
+			SIM_SleepFor(SIM_US(100));
+		if (!pingReplied)
+			continue;
+		rtt = SIM_Now() - start;
+		received++;
+		pingsReceived++;
+		pingRttSum += rtt;
+		if ((pingRttMin == 0) || (rtt < pingRttMin))
+			pingRttMin = rtt;
+		if (rtt > pingRttMax)
+			pingRttMax = rtt;
+	}
+	SIM_Log("modem ping: %u of %u answered", (unsigned)received, (unsigned)count);
+	return true;
+}
+
+void SIM_ModemReport(void)
+{
+	static const char* const powerNames[] = {"off", "booting", "on"};
+	printf("modem\n");
+	printf("  %-7s power %s  %s  %s mode  lcp %s  ipcp %s  commands %u  urcs %u  connects %u  dropped %u\n",
+		   online ? "online" : "offline", powerNames[power], registered ? "registered" : "not registered",
+		   dataMode ? "data" : "command", lcpOpen ? "open" : "closed", ipcpOpen ? "open" : "closed",
+		   (unsigned)commands, (unsigned)urcs, (unsigned)connects, (unsigned)dropped);
+	printf("  power ons %u  supply on to ppp up %.0f ms  hangup to ppp up %.0f ms\n", (unsigned)powerOns,
+		   bringUpTime / 1e6, reconnectTime / 1e6);
+	printf("  frames in %llu out %llu  bad fcs %u  protocol rejects %u  ip in %llu out %llu  echo replies %u\n",
+		   (unsigned long long)framesIn, (unsigned long long)framesOut, (unsigned)badFcs,
+		   (unsigned)protocolRejects, (unsigned long long)ipIn, (unsigned long long)ipOut,
+		   (unsigned)echoReplies);
+	printf("  vj in %s  compressed %llu uncompressed %llu errors %llu  header bytes saved %llu\n",
+		   vjIn ? "on " : "off", (unsigned long long)vj.rxCompressed, (unsigned long long)vj.rxUncompressed,
+		   (unsigned long long)vj.rxErrors, (unsigned long long)vj.rxSaved);
+	printf("  vj out %s tcp %llu compressed %llu  header bytes saved %llu\n", vjOut ? "on " : "off",
+		   (unsigned long long)vj.txTcp, (unsigned long long)vj.txCompressed, (unsigned long long)vj.txSaved);
+	if (reflected != 0)
+	{
+		printf("  reflector %llu packets  lost %llu  queue full %llu  latency %u ms  loss %u/1000\n",
+			   (unsigned long long)reflected, (unsigned long long)networkLost, (unsigned long long)networkDropped,
+			   (unsigned)latencyMs, (unsigned)lossPermille);
+	}
+	if (tunFd >= 0)
+		printf("  tun to host %llu from host %llu packets\n", (unsigned long long)tunOut, (unsigned long long)tunIn);
+	if (pingsSent != 0)
+	{
+		printf("  ping %u sent %u received  rtt min %.1f avg %.1f max %.1f ms\n", (unsigned)pingsSent,
+			   (unsigned)pingsReceived, pingRttMin / 1e6,
+			   pingsReceived ? pingRttSum / 1e6 / pingsReceived : 0.0, pingRttMax / 1e6);
+	}
+}
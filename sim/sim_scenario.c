@@ -0,0 +1,807 @@
+/* sim_scenario.c
+* Scenario engine. A scenario is a text file of commands, one per line, run in
+* order by a host thread while the firmware runs: they change what the
+* simulated devices report and wait for the firmware to react. "expect" polls
+* a firmware variable every millisecond and records how long after the last
+* "mark" it took the expected value, which gives the end-to-end latency from
+* a field event to the firmware state. See sim/README.md for the commands
+*/
+#include <ctype.h>
+#include <stdarg.h>
+#include <time.h>
+#include "core/net.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "variables.h"
+#include "rs485.h"
+#include "am2320.h"
+#include "ppp/ppp.h"
+#include "modem_interface.h"
+#include "modem.h"
+#include "snmpConnect_manager.h"
+#include "private_mib_module.h"
+#include "data_usage.h"
+#include "core/net_capture.h"
+/* after the stack headers, see sim_eth.c */
+#include <errno.h>
+#include "sim.h"
+
+#define SIM_SCENARIO_LINE			256
+#define SIM_SCENARIO_TOKENS			40
+#define SIM_SCENARIO_EXPECTS		128
+#define SIM_EXPECT_TIMEOUT_MS		5000
+#define SIM_KEY_TAP_MS				200
+#define SIM_PCAP_HEADER				24
+#define SIM_PCAP_RECORD				16
+#define SIM_PCAP_FILE				(SIM_PCAP_HEADER + NET_CAPTURE_RECORD_COUNT * (SIM_PCAP_RECORD + 1 + NET_CAPTURE_SNAP_LEN))
+
+extern uint32_t adcValue[10];
+extern PppContext pppContext;
+extern modem_interface_manage_t interfaceManage;
+
+typedef struct {
+	const char* name;
+	const volatile void* address;
+	uint8_t size;
+	bool isSigned;
+	uint32_t (*get)(void);
+} SimProbe_t;
+
+typedef struct {
+	char label[64];
+	bool passed;
+	uint64_t latency;
+	int64_t value;
+} SimExpect_t;
+
+/* a capture exported by the firmware into captureFile */
+typedef struct {
+	NetInterface* interface;
+	NetCaptureFilter filter;
+	error_t error;
+	uint_t count;
+	size_t length;
+} SimCapture_t;
+
+#define SIM_PROBE(name, var)		{name, &(var), sizeof(var), ((__typeof__(var))-1 < 0), NULL}
+#define SIM_PROBE_GET(name, get)	{name, NULL, 4, false, get}
+
+static uint32_t SIM_ProbeLink(void)
+{
+	return netInterface[0].linkState ? 1 : 0;
+}
+
+/* interface of a traffic class: 0 Ethernet, 1 GPRS, 2 none, as net.path */
+static uint32_t SIM_ProbeRoute(traffic_class_t trafficClass)
+{
+	NetInterface* interface = interfaceManagerGetClassInterface(trafficClass);
+	if (interface == NULL)
+		return 2;
+	return (interface == &netInterface[0]) ? 0 : 1;
+}
+
+static uint32_t SIM_ProbeTelemetryRoute(void)
+{
+	return SIM_ProbeRoute(TRAFFIC_CLASS_TELEMETRY);
+}
+
+static uint32_t SIM_ProbeBulkRoute(void)
+{
+	return SIM_ProbeRoute(TRAFFIC_CLASS_BULK);
+}
+
+/* number of links an alarm is sent on */
+static uint32_t SIM_ProbeAlarmLinks(void)
+{
+	NetInterface* interfaces[CONNECT_MAX_LINKS];
+	return interfaceManagerGetClassInterfaces(TRAFFIC_CLASS_ALARM, interfaces);
+}
+
+/* +CSQN level the firmware last received */
+static uint32_t SIM_ProbeModemSignal(void)
+{
+	return modemGetState()->signal;
+}
+
+/* GPRS octets, both directions, of a traffic class as published in the private MIB */
+static uint32_t SIM_ProbeUsage(unsigned trafficClass)
+{
+	const PrivateMibDataUsageEntry* entry;
+	entry = &privateMibBase.dataUsageGroup.dataUsageTable[DATA_USAGE_IF_GPRS * DATA_USAGE_CLASS_COUNT + trafficClass];
+	return entry->dataUsageInOctets + entry->dataUsageOutOctets;
+}
+
+static uint32_t SIM_ProbeUsageSnmp(void)
+{
+	return SIM_ProbeUsage(DATA_USAGE_CLASS_SNMP);
+}
+
+static uint32_t SIM_ProbeUsageIcmp(void)
+{
+	return SIM_ProbeUsage(DATA_USAGE_CLASS_ICMP);
+}
+
+static uint32_t SIM_ProbeUsageLink(void)
+{
+	return SIM_ProbeUsage(DATA_USAGE_CLASS_LINK);
+}
+
+static uint32_t SIM_ProbeUsageDivider(void)
+{
+	return dataUsageGetTelemetryDivider();
+}
+
+static uint32_t SIM_ProbeUsageCompact(void)
+{
+	return dataUsageCompactJson() ? 1 : 0;
+}
+
+static uint32_t SIM_ProbeTicks(void)
+{
+	return xTaskGetTickCount();
+}
+
+static const SimProbe_t probes[] = {
+	SIM_PROBE("ats.battVolt", sATS_Variable.battVolt),
+	SIM_PROBE("ats.gridVolt", sATS_Variable.grid_Volt),
+	SIM_PROBE("ats.genVolt", sATS_Variable.genVolt),
+	SIM_PROBE("ats.gridStatus", sATS_Variable.grid_Status),
+	SIM_PROBE("ats.genStart", sATS_Variable.GenStart),
+	SIM_PROBE("ats.frequency", sATS_Variable.frequency_i16),
+	SIM_PROBE("aircon.indoorTemp", sAirCon_Variable.indoorTemp),
+	SIM_PROBE("aircon.outdoorTemp", sAirCon_Variable.outdoorTemp),
+	SIM_PROBE("aircon.status1", sAirCon_Variable.airCon1Status),
+	SIM_PROBE("aircon.status2", sAirCon_Variable.airCon2Status),
+	SIM_PROBE("modbus.cycleTime", Modbus.cycleTime),
+	SIM_PROBE("modbus.maxCycleTime", Modbus.maxCycleTime),
+	SIM_PROBE("modbus.atsError", Modbus.atsError),
+	SIM_PROBE("modbus.airConError", Modbus.airConError),
+	SIM_PROBE("modbus.doorError", Modbus.doorError),
+	SIM_PROBE("am2320.temperature", u16Temper),
+	SIM_PROBE("am2320.humidity", u16HumiRh),
+	SIM_PROBE("time.hour", GTime.hour),
+	SIM_PROBE("time.min", GTime.min),
+	SIM_PROBE("time.sec", GTime.sec),
+	SIM_PROBE("time.date", GTime.date),
+	SIM_PROBE("time.month", GTime.month),
+	SIM_PROBE("time.year", GTime.year),
+	SIM_PROBE("alarms.active", sMenu_Control.totalActiveAlarm),
+	SIM_PROBE("menu.mode", sMenu_Control.mode),
+	SIM_PROBE("menu.page", sMenu_Control.menu),
+	SIM_PROBE_GET("eth.link", SIM_ProbeLink),
+	SIM_PROBE("net.path", snmpConnectManager.status),
+	SIM_PROBE_GET("net.telemetry", SIM_ProbeTelemetryRoute),
+	SIM_PROBE_GET("net.bulk", SIM_ProbeBulkRoute),
+	SIM_PROBE_GET("net.alarm.links", SIM_ProbeAlarmLinks),
+	SIM_PROBE("net.rtt.eth", snmpConnectManager.ethRtt),
+	SIM_PROBE("net.rtt.gprs", snmpConnectManager.gprsRtt),
+	SIM_PROBE("ppp.phase", pppContext.pppPhase),
+	SIM_PROBE("modem.state", interfaceManage.currentState),
+	SIM_PROBE_GET("modem.power", SIM_ModemPower),
+	SIM_PROBE_GET("modem.signal", SIM_ProbeModemSignal),
+	SIM_PROBE_GET("modem.network", SIM_ModemNetworkUp),
+	SIM_PROBE_GET("modem.pings", SIM_ModemPingsReceived),
+	SIM_PROBE_GET("led.toggles", SIM_GetLedToggles),
+	SIM_PROBE("usage.stage", privateMibBase.dataUsageGroup.dataUsageStage),
+	SIM_PROBE("usage.budget", privateMibBase.dataUsageGroup.dataUsageBudget),
+	SIM_PROBE("usage.gprs", privateMibBase.dataUsageGroup.dataUsageGprsUsed),
+	SIM_PROBE_GET("usage.snmp", SIM_ProbeUsageSnmp),
+	SIM_PROBE_GET("usage.icmp", SIM_ProbeUsageIcmp),
+	SIM_PROBE_GET("usage.link", SIM_ProbeUsageLink),
+	SIM_PROBE_GET("usage.divider", SIM_ProbeUsageDivider),
+	SIM_PROBE_GET("usage.compact", SIM_ProbeUsageCompact),
+	SIM_PROBE("traps.info", privateMibBase.trapLimitGroup.trapLimitCombinedInfoCount),
+	SIM_PROBE_GET("ticks", SIM_ProbeTicks),
+};
+
+static char** lines;
+static uint32_t lineCount;
+static uint32_t lineNumber;
+static const char* scriptPath;
+static uint32_t duration;
+static uint64_t startTime;
+static uint64_t markTime;
+static char markName[32];
+static SimExpect_t expects[SIM_SCENARIO_EXPECTS];
+static uint32_t expectCount;
+static uint32_t failures;
+static uint8_t captureFile[SIM_PCAP_FILE];
+
+static void SIM_ScenarioError(const char* format, ...) __attribute__((format(printf, 1, 2), noreturn));
+
+static void SIM_ScenarioError(const char* format, ...)
+{
+	char message[160];
+	va_list args;
+	va_start(args, format);
+	vsnprintf(message, sizeof(message), format, args);
+	va_end(args);
+	SIM_Fatal("%s:%u: %s", scriptPath, (unsigned)lineNumber, message);
+}
+
+static long SIM_Number(const char* token)
+{
+	char* end;
+	long value;
+	if (token == NULL)
+		SIM_ScenarioError("missing number");
+	errno = 0;
+	value = strtol(token, &end, 0);
+	if ((errno != 0) || (*end != '\0'))
+		SIM_ScenarioError("bad number '%s'", token);
+	return value;
+}
+
+static int16_t SIM_Tenths(const char* token)
+{
+	char* end;
+	double value;
+	if (token == NULL)
+		SIM_ScenarioError("missing value");
+	value = strtod(token, &end);
+	if (*end != '\0')
+		SIM_ScenarioError("bad value '%s'", token);
+	return (int16_t)(value * 10.0 + (value < 0 ? -0.5 : 0.5));
+}
+
+/*=================================== probes ===================================*/
+
+static const SimProbe_t* SIM_ProbeFind(const char* name, uint32_t* index)
+{
+	static const SimProbe_t digitalInput = SIM_PROBE("di", DigitalInput[0]);
+	static const SimProbe_t adc = SIM_PROBE("adc", adcValue[0]);
+	const char* bracket = strchr(name, '[');
+	uint32_t i;
+	*index = 0;
+	if (bracket != NULL)
+	{
+		*index = strtoul(bracket + 1, NULL, 10);
+		if ((strncmp(name, "di[", 3) == 0) && (*index < 10))
+			return &digitalInput;
+		if ((strncmp(name, "adc[", 4) == 0) && (*index < 10))
+			return &adc;
+		return NULL;
+	}
+	for (i = 0; i < sizeof(probes) / sizeof(probes[0]); i++)
+	{
+		if (strcmp(probes[i].name, name) == 0)
+			return &probes[i];
+	}
+	return NULL;
+}
+
+static int64_t SIM_ProbeRead(const SimProbe_t* probe, uint32_t index)
+{
+	const volatile uint8_t* address;
+	if (probe->get != NULL)
+		return probe->get();
+	address = (const volatile uint8_t*)probe->address + index * probe->size;
+	switch (probe->size)
+	{
+	case 1:
+		return probe->isSigned ? *(const volatile int8_t*)address : *address;
+	case 2:
+		return probe->isSigned ? *(const volatile int16_t*)address : *(const volatile uint16_t*)address;
+	default:
+		return probe->isSigned ? *(const volatile int32_t*)address : *(const volatile uint32_t*)address;
+	}
+}
+
+static bool SIM_Compare(int64_t value, const char* op, int64_t expected)
+{
+	if (strcmp(op, "==") == 0)
+		return value == expected;
+	if (strcmp(op, "!=") == 0)
+		return value != expected;
+	if (strcmp(op, "<") == 0)
+		return value < expected;
+	if (strcmp(op, "<=") == 0)
+		return value <= expected;
+	if (strcmp(op, ">") == 0)
+		return value > expected;
+	if (strcmp(op, ">=") == 0)
+		return value >= expected;
+	SIM_ScenarioError("bad operator '%s'", op);
+}
+
+static void SIM_Record(const char* label, bool passed, uint64_t latency, int64_t value)
+{
+	SimExpect_t* expect;
+	if (expectCount < SIM_SCENARIO_EXPECTS)
+	{
+		expect = &expects[expectCount++];
+		snprintf(expect->label, sizeof(expect->label), "%s", label);
+		expect->passed = passed;
+		expect->latency = latency;
+		expect->value = value;
+	}
+	if (!passed)
+		failures++;
+}
+
+/* a result checked by a command other than expect, such as a benchmark */
+void SIM_ScenarioCheck(bool passed, int64_t value, const char* format, ...)
+{
+	char label[sizeof(expects[0].label)];
+	va_list args;
+	va_start(args, format);
+	vsnprintf(label, sizeof(label), format, args);
+	va_end(args);
+	SIM_Record(label, passed, 0, value);
+	SIM_Log("%s:%u: %s %s, is %lld", scriptPath, (unsigned)lineNumber, passed ? "ok" : "FAIL", label,
+			(long long)value);
+}
+
+/* expect <probe> <op> <value> [timeout ms] */
+static void SIM_Expect(char** argv, int argc)
+{
+	const SimProbe_t* probe;
+	char label[sizeof(expects[0].label)];
+	uint32_t index;
+	uint64_t since, deadline;
+	int64_t expected, value;
+	bool passed;
+	if (argc < 4)
+		SIM_ScenarioError("expect <probe> <op> <value> [timeout ms]");
+	probe = SIM_ProbeFind(argv[1], &index);
+	if (probe == NULL)
+		SIM_ScenarioError("unknown probe '%s'", argv[1]);
+	expected = SIM_Number(argv[3]);
+	since = markTime ? markTime : SIM_Now();
+	deadline = SIM_Now() + SIM_MS(argc > 4 ? SIM_Number(argv[4]) : SIM_EXPECT_TIMEOUT_MS);
+	for (;;)
+	{
+		value = SIM_ProbeRead(probe, index);
+		passed = SIM_Compare(value, argv[2], expected);
+		if (passed || (SIM_Now() >= deadline))
+			break;
+		SIM_SleepFor(SIM_MS(1));
+	}
+	snprintf(label, sizeof(label), "%s%s%s %s %s", markName, markName[0] ? ": " : "", argv[1], argv[2], argv[3]);
+	SIM_Record(label, passed, SIM_Now() - since, value);
+	if (!passed)
+	{
+		SIM_Log("%s:%u: FAIL %s %s %s, is %lld", scriptPath, (unsigned)lineNumber, argv[1], argv[2], argv[3],
+				(long long)value);
+	}
+	else
+	{
+		SIM_Log("%s:%u: ok %s %s %s after %.1f ms", scriptPath, (unsigned)lineNumber, argv[1], argv[2], argv[3],
+				(SIM_Now() - since) / 1e6);
+	}
+}
+
+/*============================ device commands =================================*/
+
+static uint32_t SIM_UartIndex(const char* token)
+{
+	if ((strcmp(token, "1") == 0) || (strcmp(token, "modem") == 0))
+		return SIM_UART_MODEM;
+	if ((strcmp(token, "3") == 0) || (strcmp(token, "modbus") == 0))
+		return SIM_UART_MODBUS;
+	if ((strcmp(token, "4") == 0) || (strcmp(token, "door") == 0))
+		return SIM_UART_DOOR;
+	SIM_ScenarioError("unknown uart '%s'", token);
+}
+
+/* uart <1|3|4|modem|modbus|door> <hex bytes...> */
+static void SIM_Uart(char** argv, int argc)
+{
+	uint8_t data[SIM_SCENARIO_LINE / 2];
+	size_t length = 0;
+	const char* p;
+	unsigned byte;
+	int i;
+	if (argc < 3)
+		SIM_ScenarioError("uart <uart> <hex bytes>");
+	for (i = 2; i < argc; i++)
+	{
+		for (p = argv[i]; *p; p += 2)
+		{
+			if (!isxdigit((unsigned char)p[0]) || !isxdigit((unsigned char)p[1]) ||
+				(sscanf(p, "%2x", &byte) != 1) || (length == sizeof(data)))
+				SIM_ScenarioError("bad hex '%s'", argv[i]);
+			data[length++] = (uint8_t)byte;
+		}
+	}
+	SIM_UartReceive(SIM_UartIndex(argv[1]), data, length);
+}
+
+/* slave <address> reg <n> <value> | online | offline | delay <ms> */
+static void SIM_Slave(char** argv, int argc)
+{
+	uint8_t address;
+	bool ok;
+	if (argc < 3)
+		SIM_ScenarioError("slave <address> reg|online|offline|delay");
+	address = (uint8_t)SIM_Number(argv[1]);
+	if ((strcmp(argv[2], "reg") == 0) && (argc == 5))
+		ok = SIM_ModbusSetReg(address, (uint16_t)SIM_Number(argv[3]), (uint16_t)SIM_Number(argv[4]));
+	else if (strcmp(argv[2], "online") == 0)
+		ok = SIM_ModbusSetOnline(address, true);
+	else if (strcmp(argv[2], "offline") == 0)
+		ok = SIM_ModbusSetOnline(address, false);
+	else if ((strcmp(argv[2], "delay") == 0) && (argc == 4))
+		ok = SIM_ModbusSetDelay(address, SIM_Number(argv[3]));
+	else
+		SIM_ScenarioError("slave <address> reg|online|offline|delay");
+	if (!ok)
+		SIM_ScenarioError("no slave %u or register out of range", address);
+}
+
+/* modem online | offline | delay <ms> | register <ms> | signal <rssi> | hangup |
+* ping <count> <size> | vj on|off | latency <ms> | loss <permille> */
+static void SIM_Modem(char** argv, int argc)
+{
+	if ((argc == 2) && (strcmp(argv[1], "online") == 0))
+		SIM_ModemSetOnline(true);
+	else if ((argc == 2) && (strcmp(argv[1], "offline") == 0))
+		SIM_ModemSetOnline(false);
+	else if ((argc == 3) && (strcmp(argv[1], "delay") == 0))
+		SIM_ModemSetDelay(SIM_Number(argv[2]));
+	else if ((argc == 3) && (strcmp(argv[1], "register") == 0))
+		SIM_ModemSetRegisterDelay(SIM_Number(argv[2]));
+	else if ((argc == 3) && (strcmp(argv[1], "signal") == 0))
+		SIM_ModemSetSignal(SIM_Number(argv[2]));
+	else if ((argc == 2) && (strcmp(argv[1], "hangup") == 0))
+	{
+		if (!SIM_ModemHangup())
+			SIM_ScenarioError("PPP is not up");
+	}
+	else if ((argc == 3) && (strcmp(argv[1], "vj") == 0) && (strcmp(argv[2], "on") == 0))
+		SIM_ModemSetVj(true);
+	else if ((argc == 3) && (strcmp(argv[1], "vj") == 0) && (strcmp(argv[2], "off") == 0))
+		SIM_ModemSetVj(false);
+	else if ((argc == 3) && (strcmp(argv[1], "latency") == 0))
+		SIM_ModemSetLatency(SIM_Number(argv[2]));
+	else if ((argc == 3) && (strcmp(argv[1], "loss") == 0))
+		SIM_ModemSetLoss(SIM_Number(argv[2]));
+	else if ((argc == 4) && (strcmp(argv[1], "ping") == 0))
+	{
+		if (!SIM_ModemPing(SIM_Number(argv[2]), SIM_Number(argv[3])))
+			SIM_ScenarioError("PPP is not up or the ping is too large");
+	}
+	else
+		SIM_ScenarioError("modem online|offline|delay <ms>|register <ms>|signal <rssi>|hangup|ping <count> <size>|vj on|off|latency <ms>|loss <permille>");
+}
+
+/*=============================== packet capture ===============================*/
+
+static error_t SIM_CaptureWrite(void* param, const void* data, size_t length)
+{
+	SimCapture_t* capture = param;
+	if (capture->length + length > sizeof(captureFile))
+		return ERROR_BUFFER_OVERFLOW;
+	memcpy(captureFile + capture->length, data, length);
+	capture->length += length;
+	return NO_ERROR;
+}
+
+static void SIM_CaptureStartRun(void* param)
+{
+	SimCapture_t* capture = param;
+	capture->error = netCaptureStart(&capture->filter);
+}
+
+/* as CAPTURE_ExportTask, without the upload */
+static void SIM_CaptureExportRun(void* param)
+{
+	SimCapture_t* capture = param;
+	netCaptureStop();
+	capture->length = 0;
+	capture->count = 0;
+	capture->error = netCaptureExport(capture->interface, SIM_CaptureWrite, capture, &capture->count);
+}
+
+/* stops the capture, exports the frames of <interface> and checks the pcap
+* file: the global header, the records against the frame count returned by
+* the export, and that count against <op> <expected> */
+void SIM_CaptureCheck(NetInterface* interface, const char* name, const char* op, int64_t expected)
+{
+	SimCapture_t capture = {0};
+	uint32_t linkType, snapLen, inclLen, origLen;
+	uint32_t records = 0, malformed = 0;
+	size_t offset;
+	bool ppp;
+	capture.interface = interface;
+	SIM_RunOnTarget(SIM_CaptureExportRun, &capture);
+	SIM_ScenarioCheck(capture.error == NO_ERROR, capture.error, "capture %s: export error == 0", name);
+	if (capture.error || (capture.length < SIM_PCAP_HEADER))
+		return;
+	ppp = interface->nicDriver->type == NIC_TYPE_PPP;
+	linkType = ppp ? PCAP_LINKTYPE_PPP_WITH_DIR : PCAP_LINKTYPE_ETHERNET;
+	snapLen = NET_CAPTURE_SNAP_LEN + (ppp ? 1 : 0);
+	SIM_ScenarioCheck(LOAD32LE(captureFile) == 0xA1B2C3D4, LOAD32LE(captureFile), "capture %s: magic == A1B2C3D4",
+					  name);
+	SIM_ScenarioCheck(LOAD32LE(captureFile + 4) == 0x00040002, LOAD32LE(captureFile + 4),
+					  "capture %s: version == 2.4", name);
+	SIM_ScenarioCheck(LOAD32LE(captureFile + 16) == snapLen, LOAD32LE(captureFile + 16),
+					  "capture %s: snaplen == %u", name, (unsigned)snapLen);
+	SIM_ScenarioCheck(LOAD32LE(captureFile + 20) == linkType, LOAD32LE(captureFile + 20),
+					  "capture %s: link type == %u", name, (unsigned)linkType);
+	/* the records fill the rest of the file exactly */
+	for (offset = SIM_PCAP_HEADER; offset + SIM_PCAP_RECORD <= capture.length; records++)
+	{
+		inclLen = LOAD32LE(captureFile + offset + 8);
+		origLen = LOAD32LE(captureFile + offset + 12);
+		if ((inclLen > snapLen) || (inclLen > origLen) || (ppp && (captureFile[offset + SIM_PCAP_RECORD] > 1)))
+			malformed++;
+		offset += SIM_PCAP_RECORD + inclLen;
+	}
+	if (offset != capture.length)
+		malformed++;
+	SIM_ScenarioCheck(malformed == 0, malformed, "capture %s: malformed records == 0", name);
+	SIM_ScenarioCheck(records == capture.count, records, "capture %s: records == %u exported", name,
+					  (unsigned)capture.count);
+	SIM_ScenarioCheck(SIM_Compare(capture.count, op, expected), capture.count, "capture %s: frames %s %lld", name, op,
+					  (long long)expected);
+}
+
+static NetInterface* SIM_CaptureInterface(const char* token)
+{
+	if (strcmp(token, "eth") == 0)
+		return &netInterface[0];
+	if (strcmp(token, "gprs") == 0)
+		return &netInterface[1];
+	SIM_ScenarioError("unknown interface '%s', eth or gprs", token);
+}
+
+/* capture start [eth|gprs] | capture export eth|gprs <op> <frames> */
+static void SIM_Capture(char** argv, int argc)
+{
+	SimCapture_t capture = {0};
+	if ((argc <= 3) && (strcmp(argv[1], "start") == 0))
+	{
+		capture.filter.interface = (argc == 3) ? SIM_CaptureInterface(argv[2]) : NULL;
+		SIM_RunOnTarget(SIM_CaptureStartRun, &capture);
+		if (capture.error)
+			SIM_ScenarioError("netCaptureStart error %d", capture.error);
+	}
+	else if ((argc == 5) && (strcmp(argv[1], "export") == 0))
+		SIM_CaptureCheck(SIM_CaptureInterface(argv[2]), argv[2], argv[3], SIM_Number(argv[4]));
+	else
+		SIM_ScenarioError("capture start [eth|gprs] | export eth|gprs <op> <frames>");
+}
+
+static void SIM_Command(char** argv, int argc)
+{
+	const char* command = argv[0];
+	int year, month, date, hour, min, sec;
+	uint32_t holdMs;
+	if ((strcmp(command, "wait") == 0) && (argc == 2))
+	{
+		SIM_SleepFor(SIM_MS(SIM_Number(argv[1])));
+	}
+	else if ((strcmp(command, "at") == 0) && (argc == 2))
+	{
+		SIM_SleepUntil(startTime + SIM_MS(SIM_Number(argv[1])));
+	}
+	else if (strcmp(command, "mark") == 0)
+	{
+		markTime = SIM_Now();
+		snprintf(markName, sizeof(markName), "%s", argc > 1 ? argv[1] : "");
+	}
+	else if (strcmp(command, "expect") == 0)
+	{
+		SIM_Expect(argv, argc);
+	}
+	else if (strcmp(command, "slave") == 0)
+	{
+		SIM_Slave(argv, argc);
+	}
+	else if ((strcmp(command, "am2320") == 0) && (argc >= 2))
+	{
+		if (strcmp(argv[1], "offline") == 0)
+			SIM_Am2320SetOnline(false);
+		else if (strcmp(argv[1], "online") == 0)
+			SIM_Am2320SetOnline(true);
+		else if (argc == 3)
+			SIM_Am2320Set(SIM_Tenths(argv[1]), (uint16_t)SIM_Tenths(argv[2]));
+		else
+			SIM_ScenarioError("am2320 <temperature> <humidity> | online | offline");
+	}
+	else if (strcmp(command, "rtc") == 0)
+	{
+		if ((argc != 3) || (sscanf(argv[1], "%d-%d-%d", &year, &month, &date) != 3) ||
+			(sscanf(argv[2], "%d:%d:%d", &hour, &min, &sec) != 3))
+			SIM_ScenarioError("rtc YYYY-MM-DD HH:MM:SS");
+		SIM_RtcSet(year, month, date, hour, min, sec);
+	}
+	else if ((strcmp(command, "di") == 0) && (argc == 3))
+	{
+		if (strcmp(argv[2], "close") == 0)
+			SIM_SetDigitalInput(SIM_Number(argv[1]), 0);
+		else if (strcmp(argv[2], "open") == 0)
+			SIM_SetDigitalInput(SIM_Number(argv[1]), 1);
+		else if (strcmp(argv[2], "cutoff") == 0)
+			SIM_SetDigitalInput(SIM_Number(argv[1]), 2);
+		else
+			SIM_ScenarioError("di <channel> close|open|cutoff");
+	}
+	else if ((strcmp(command, "key") == 0) && (argc >= 3))
+	{
+		if (strcmp(argv[2], "press") == 0)
+		{
+			SIM_SetKey(SIM_Number(argv[1]), true);
+		}
+		else if (strcmp(argv[2], "release") == 0)
+		{
+			SIM_SetKey(SIM_Number(argv[1]), false);
+		}
+		else if (strcmp(argv[2], "tap") == 0)
+		{
+			holdMs = (argc > 3) ? SIM_Number(argv[3]) : SIM_KEY_TAP_MS;
+			SIM_SetKey(SIM_Number(argv[1]), true);
+			SIM_SleepFor(SIM_MS(holdMs));
+			SIM_SetKey(SIM_Number(argv[1]), false);
+		}
+		else
+		{
+			SIM_ScenarioError("key <1-4> press|release|tap [ms]");
+		}
+	}
+	else if ((strcmp(command, "adc") == 0) && (argc == 4))
+	{
+		SIM_AdcSet(SIM_Number(argv[1]), SIM_Number(argv[2]), SIM_Number(argv[3]));
+	}
+	else if ((strcmp(command, "link") == 0) && (argc == 2))
+	{
+		SIM_EthSetLink(strcmp(argv[1], "up") == 0);
+	}
+	else if ((strcmp(command, "server") == 0) && (argc == 3) && (strcmp(argv[1], "delay") == 0))
+	{
+		SIM_EthSetServerDelay(SIM_Number(argv[2]));
+	}
+	else if ((strcmp(command, "server") == 0) && (argc == 2))
+	{
+		SIM_EthSetServer(strcmp(argv[1], "online") == 0);
+	}
+	else if (strcmp(command, "uart") == 0)
+	{
+		SIM_Uart(argv, argc);
+	}
+	else if (strcmp(command, "modem") == 0)
+	{
+		SIM_Modem(argv, argc);
+	}
+	else if ((strcmp(command, "usage") == 0) && (argc == 3) && (strcmp(argv[1], "budget") == 0))
+	{
+		dataUsageSetBudget(SIM_Number(argv[2]));
+	}
+	else if ((strcmp(command, "usage") == 0) && (argc == 2) && (strcmp(argv[1], "reset") == 0))
+	{
+		dataUsageReset();
+	}
+	else if ((strcmp(command, "capture") == 0) && (argc >= 2))
+	{
+		SIM_Capture(argv, argc);
+	}
+	else if ((strcmp(command, "bench") == 0) && (argc >= 2))
+	{
+		if (!SIM_Bench(argv + 1, argc - 1))
+			SIM_ScenarioError("bench mem [pairs] | memsoak [operations] [seed] | checksum [cases] [seed] | tcp [kbytes] [min B/s] | timers [ms] | demux [lookups] | frag [datagrams] [seed] | hdlc [frames] [seed] | snapshot [ms] [readers] | mib [walks] [seed] | crc [cases] [seed] | usm [pdus] [seed] | capture [packets]");
+	}
+	else if (strcmp(command, "report") == 0)
+	{
+		SIM_ScenarioReport();
+	}
+	else if (strcmp(command, "quit") == 0)
+	{
+		SIM_ScenarioReport();
+		SIM_Exit(argc > 1 ? SIM_Number(argv[1]) : SIM_ScenarioResult());
+	}
+	else
+	{
+		SIM_ScenarioError("unknown command or bad arguments '%s'", command);
+	}
+}
+
+/*=================================== runner ===================================*/
+
+static void* SIM_ScenarioThread(void* param)
+{
+	char line[SIM_SCENARIO_LINE];
+	char* argv[SIM_SCENARIO_TOKENS];
+	char* save;
+	char* token;
+	int argc;
+	(void)param;
+	for (lineNumber = 1; lineNumber <= lineCount; lineNumber++)
+	{
+		snprintf(line, sizeof(line), "%s", lines[lineNumber - 1]);
+		token = strchr(line, '#');
+		if (token != NULL)
+			*token = '\0';
+		argc = 0;
+		for (token = strtok_r(line, " \t\r\n", &save); token != NULL; token = strtok_r(NULL, " \t\r\n", &save))
+		{
+			if (argc < SIM_SCENARIO_TOKENS)
+				argv[argc++] = token;
+		}
+		if (argc == 0)
+			continue;
+		SIM_Command(argv, argc);
+	}
+	if (duration != 0)
+	{
+		SIM_SleepUntil(startTime + SIM_MS(duration));
+		SIM_ScenarioReport();
+		SIM_Exit(SIM_ScenarioResult());
+	}
+	if (scriptPath != NULL)
+		SIM_Log("%s: done, the firmware keeps running", scriptPath);
+	return NULL;
+}
+
+static void SIM_ScenarioLoad(const char* path)
+{
+	char line[SIM_SCENARIO_LINE];
+	FILE* file = fopen(path, "r");
+	if (file == NULL)
+		SIM_Fatal("cannot open %s: %s", path, strerror(errno));
+	while (fgets(line, sizeof(line), file) != NULL)
+	{
+		lines = realloc(lines, (lineCount + 1) * sizeof(*lines));
+		lines[lineCount++] = strdup(line);
+	}
+	fclose(file);
+}
+
+int SIM_ScenarioStart(const char* path, uint32_t durationMs)
+{
+	scriptPath = path;
+	duration = durationMs;
+	if (path != NULL)
+		SIM_ScenarioLoad(path);
+	startTime = SIM_Now();
+	if ((path == NULL) && (durationMs == 0))
+		return 0;
+	return SIM_StartThread(SIM_ScenarioThread, NULL);
+}
+
+int SIM_ScenarioResult(void)
+{
+	return failures ? 1 : 0;
+}
+
+static void SIM_ScenarioSample(void* param)
+{
+	(void)param;
+	SIM_SampleTasks();
+}
+
+void SIM_ScenarioReport(void)
+{
+	uint32_t i;
+	/* the kernel is only read from a task, unless the target stopped; a
+	* task holding the scheduler suspended only delays the request */
+	if (SIM_IsHostThread() && !SIM_TargetStopped())
+		SIM_RunOnTarget(SIM_ScenarioSample, NULL);
+	else
+		SIM_SampleTasks();
+	printf("==== report at %.3f s ====\n", SIM_Now() / 1e9);
+	SIM_ReportTasks();
+	printf("firmware\n");
+	printf("  modbus cycle %u ms (max %u ms)  ats error %u  air conditioner error %u\n",
+		   (unsigned)Modbus.cycleTime, (unsigned)Modbus.maxCycleTime, Modbus.atsError, Modbus.airConError);
+	printf("  active alarms %u  status led toggles %u\n", sMenu_Control.totalActiveAlarm,
+		   (unsigned)SIM_GetLedToggles());
+	SIM_ModbusReport();
+	SIM_UartReport();
+	SIM_EdmaReport();
+	SIM_ModemReport();
+	SIM_I2cReport();
+	SIM_FlashReport();
+	SIM_EthReport();
+	if (expectCount != 0)
+	{
+		printf("expectations (latency from the last mark)\n");
+		for (i = 0; i < expectCount; i++)
+		{
+			printf("  %-4s %9.1f ms  %s (is %lld)\n", expects[i].passed ? "ok" : "FAIL",
+				   expects[i].latency / 1e6, expects[i].label, (long long)expects[i].value);
+		}
+		printf("  %u of %u failed\n", (unsigned)failures, (unsigned)expectCount);
+	}
+	fflush(stdout);
+}
@@ -0,0 +1,372 @@
+/* sim_uart.c
+* UART1 (modem), UART3 (RS-485 Modbus) and UART4 (RS-485 door bus). The
+* receivers hold one byte like the hardware without FIFO and overrun when the
+* firmware is late, the transmitters take one character time per byte. With
+* the DMA select bits of C5 set a received byte is a request to the eDMA
+* model and the transmitter is fed by eDMA at the line rate, the idle line
+* flag rises one character time after the last received byte
+*/
+#include <pthread.h>
+#include "fsl_uart.h"
+#include "sim.h"
+
+#define SIM_UART_BITS_PER_BYTE		10		/* 8N1 */
+#define SIM_UART_ISR_BURST			12		/* bytes sent per interrupt, 1 ms at 115200 */
+
+#define SIM_UART_RX_INTERRUPTS		(kUART_RxDataRegFullInterruptEnable | kUART_RxOverrunInterruptEnable)
+
+typedef struct {
+	UART_Type* base;
+	uint32_t line;
+	const char* name;
+	void (*handler)(void);
+	uint32_t baudRate;
+	uint32_t rxDmaSource;
+	uint32_t txDmaSource;
+	uint32_t interrupts;
+	uint8_t rxData;
+	bool rxFull;
+	bool overrun;
+	bool tdreSeen;
+	bool idle;
+	uint64_t idleAt;
+	uint64_t txBusyUntil;
+	uint64_t rxBusyUntil;
+	SimUartTxHook hook;
+	uint64_t txBytes;
+	uint64_t rxBytes;
+	uint32_t overruns;
+	uint64_t handlerCalls;
+} SimUart_t;
+
+/* the door bus handler only exists without the UART4 debug console */
+extern void UART1_RX_TX_IRQHandler(void) __attribute__((weak));
+extern void UART3_RX_TX_IRQHandler(void) __attribute__((weak));
+extern void UART4_RX_TX_IRQHandler(void) __attribute__((weak));
+
+static SimUart_t uarts[SIM_UART_COUNT] = {
+	{UART1, SIM_IRQ_UART1, "UART1 modem", NULL, 0, kDmaRequestMux0UART1Rx, kDmaRequestMux0UART1Tx},
+	{UART3, SIM_IRQ_UART3, "UART3 RS-485 Modbus", NULL, 0, kDmaRequestMux0UART3Rx, kDmaRequestMux0UART3Tx},
+	{UART4, SIM_IRQ_UART4, "UART4 RS-485 door", NULL, 0, kDmaRequestMux0UART4, kDmaRequestMux0UART4},
+};
+
+/* the eDMA goes through the data register in the model, the receiver and
+* the transmitter take turns with it where the hardware has two buffers */
+static pthread_mutex_t dataRegisterMutex = PTHREAD_MUTEX_INITIALIZER;
+
+static SimUart_t* SIM_UartFind(UART_Type* base)
+{
+	uint32_t i;
+	for (i = 0; i < SIM_UART_COUNT; i++)
+	{
+		if (uarts[i].base == base)
+			return &uarts[i];
+	}
+	return NULL;
+}
+
+static uint64_t SIM_UartByteTime(SimUart_t* uart)
+{
+	return 1000000000ULL * SIM_UART_BITS_PER_BYTE / (uart->baudRate ? uart->baudRate : 9600);
+}
+
+void SIM_UartInit(void)
+{
+	uint32_t i;
+	uarts[SIM_UART_MODEM].handler = UART1_RX_TX_IRQHandler;
+	uarts[SIM_UART_MODBUS].handler = UART3_RX_TX_IRQHandler;
+	uarts[SIM_UART_DOOR].handler = UART4_RX_TX_IRQHandler;
+	for (i = 0; i < SIM_UART_COUNT; i++)
+	{
+		/* reset value, code polling the registers sees an idle transmitter */
+		*(volatile uint8_t*)&uarts[i].base->S1 = UART_S1_TDRE_MASK | UART_S1_TC_MASK;
+	}
+}
+
+void SIM_UartSetTxHook(uint32_t uart, SimUartTxHook hook)
+{
+	uarts[uart].hook = hook;
+}
+
+/*============================== KSDK driver API ===============================*/
+
+void UART_GetDefaultConfig(uart_config_t* config)
+{
+	memset(config, 0, sizeof(*config));
+	config->baudRate_Bps = 115200U;
+	config->parityMode = kUART_ParityDisabled;
+}
+
+status_t UART_Init(UART_Type* base, const uart_config_t* config, uint32_t srcClock_Hz)
+{
+	SimUart_t* uart = SIM_UartFind(base);
+	(void)srcClock_Hz;
+	if (uart == NULL)
+		return kStatus_InvalidArgument;
+	SIM_Lock();
+	uart->baudRate = config->baudRate_Bps;
+	uart->interrupts = 0;
+	uart->rxFull = false;
+	uart->overrun = false;
+	SIM_Unlock();
+	return kStatus_Success;
+}
+
+uint32_t UART_GetStatusFlags(UART_Type* base)
+{
+	SimUart_t* uart = SIM_UartFind(base);
+	uint32_t flags = kUART_TxDataRegEmptyFlag | kUART_TransmissionCompleteFlag;
+	if (uart == NULL)
+		return flags;
+	SIM_Lock();
+	if (uart->rxFull)
+		flags |= kUART_RxDataRegFullFlag;
+	if (uart->overrun)
+		flags |= kUART_RxOverrunFlag;
+	if (uart->idle)
+		flags |= kUART_IdleLineFlag;
+	uart->tdreSeen = true;
+	SIM_Unlock();
+	return flags;
+}
+
+status_t UART_ClearStatusFlags(UART_Type* base, uint32_t mask)
+{
+	SimUart_t* uart = SIM_UartFind(base);
+	if (uart == NULL)
+		return kStatus_Success;
+	SIM_Lock();
+	if (mask & kUART_RxOverrunFlag)
+		uart->overrun = false;
+	if (mask & kUART_IdleLineFlag)
+		uart->idle = false;
+	SIM_Unlock();
+	return kStatus_Success;
+}
+
+void UART_EnableInterrupts(UART_Type* base, uint32_t mask)
+{
+	SimUart_t* uart = SIM_UartFind(base);
+	bool raise;
+	if (uart == NULL)
+		return;
+	SIM_Lock();
+	uart->interrupts |= mask;
+	raise = (mask & kUART_TxDataRegEmptyInterruptEnable) ||
+			((mask & SIM_UART_RX_INTERRUPTS) && (uart->rxFull || uart->overrun));
+	SIM_Unlock();
+	/* the transmit register is always empty */
+	if (raise)
+		SIM_RaiseIrq(uart->line);
+}
+
+void UART_DisableInterrupts(UART_Type* base, uint32_t mask)
+{
+	SimUart_t* uart = SIM_UartFind(base);
+	if (uart == NULL)
+		return;
+	SIM_Lock();
+	uart->interrupts &= ~mask;
+	SIM_Unlock();
+}
+
+/* reading S1 then D clears the receive flags */
+uint8_t UART_ReadByte(UART_Type* base)
+{
+	SimUart_t* uart = SIM_UartFind(base);
+	uint8_t data;
+	if (uart == NULL)
+		return base->D;
+	SIM_Lock();
+	data = uart->rxData;
+	uart->rxFull = false;
+	uart->overrun = false;
+	SIM_Unlock();
+	return data;
+}
+
+static void SIM_UartTransmitted(SimUart_t* uart, const uint8_t* data, size_t length)
+{
+	uart->txBytes += length;
+	if (uart->hook != NULL)
+		uart->hook(uart - uarts, data, length);
+}
+
+void UART_WriteByte(UART_Type* base, uint8_t data)
+{
+	SimUart_t* uart = SIM_UartFind(base);
+	base->D = data;
+	if (uart != NULL)
+		SIM_UartTransmitted(uart, &data, 1);
+}
+
+/* the caller spins on TDRE for the whole frame on the target, here the task
+* thread sleeps for as long, still preemptible by the tick */
+void UART_WriteBlocking(UART_Type* base, const uint8_t* data, size_t length)
+{
+	SimUart_t* uart = SIM_UartFind(base);
+	uint64_t start, end;
+	if (uart == NULL)
+		return;
+	SIM_Lock();
+	start = SIM_Now();
+	if (start < uart->txBusyUntil)
+		start = uart->txBusyUntil;
+	end = start + length * SIM_UartByteTime(uart);
+	uart->txBusyUntil = end;
+	SIM_Unlock();
+	SIM_SleepUntil(end);
+	SIM_UartTransmitted(uart, data, length);
+}
+
+/*================================ device side =================================*/
+
+void SIM_UartReceive(uint32_t index, const uint8_t* data, size_t length)
+{
+	SimUart_t* uart = &uarts[index];
+	uint64_t next, now;
+	bool raise, taken;
+	size_t i;
+	SIM_Lock();
+	next = SIM_Now();
+	if (next < uart->rxBusyUntil)
+		next = uart->rxBusyUntil;
+	uart->rxBusyUntil = next + length * SIM_UartByteTime(uart);
+	/* no idle line before the last byte, a late device thread does not
+	* split the burst */
+	uart->idleAt = 0;
+	uart->idle = false;
+	SIM_Unlock();
+	for (i = 0; i < length; i++)
+	{
+		/* a device thread the host ran late does not catch up with bytes
+		* closer together than the line allows */
+		now = SIM_Now();
+		if (next < now)
+			next = now;
+		next += SIM_UartByteTime(uart);
+		SIM_SleepUntil(next);
+		if ((uart->base->C5 & UART_C5_RDMAS_MASK) && !uart->rxFull)
+		{
+			pthread_mutex_lock(&dataRegisterMutex);
+			uart->base->D = data[i];
+			taken = SIM_EdmaRequest(uart->rxDmaSource);
+			pthread_mutex_unlock(&dataRegisterMutex);
+			if (taken)
+			{
+				uart->rxBytes++;
+				continue;
+			}
+		}
+		SIM_Lock();
+		if (uart->rxFull)
+		{
+			/* the new byte is lost, the one in the data register stays */
+			uart->overrun = true;
+			uart->overruns++;
+		}
+		else
+		{
+			uart->rxData = data[i];
+			uart->rxFull = true;
+		}
+		uart->rxBytes++;
+		raise = (uart->interrupts & SIM_UART_RX_INTERRUPTS) != 0;
+		SIM_Unlock();
+		if (raise)
+			SIM_RaiseIrq(uart->line);
+	}
+	/* the line goes idle one character after the last byte */
+	SIM_Lock();
+	uart->idleAt = next + SIM_UartByteTime(uart);
+	SIM_Unlock();
+}
+
+/* Runs in interrupt context. The modem driver writes the data register from
+* its handler and turns the TX interrupt off when it has nothing left, so a
+* handler that saw TDRE and left the interrupt on has sent a byte */
+void SIM_UartIsr(uint32_t index)
+{
+	SimUart_t* uart = &uarts[index];
+	uint8_t data;
+	uint32_t n;
+	if (uart->handler == NULL)
+		return;
+	for (n = 0; n < SIM_UART_ISR_BURST; n++)
+	{
+		uart->tdreSeen = false;
+		uart->handlerCalls++;
+		uart->handler();
+		if (!(uart->interrupts & kUART_TxDataRegEmptyInterruptEnable) || !uart->tdreSeen)
+			break;
+		data = uart->base->D;
+		SIM_UartTransmitted(uart, &data, 1);
+	}
+}
+
+/* the transmitter requests a byte from the eDMA each time its data register
+* empties, the bytes of the last millisecond are sent together */
+static void SIM_UartServiceTxDma(SimUart_t* uart)
+{
+	uint8_t data[SIM_UART_ISR_BURST * 4];
+	uint64_t now = SIM_Now();
+	uint64_t byteTime = SIM_UartByteTime(uart);
+	size_t length = 0;
+	if (uart->txBusyUntil + SIM_MS(1) < now)
+		uart->txBusyUntil = now - SIM_MS(1);
+	while ((uart->txBusyUntil + byteTime <= now) && (length < sizeof(data)))
+	{
+		pthread_mutex_lock(&dataRegisterMutex);
+		if (!SIM_EdmaRequest(uart->txDmaSource))
+		{
+			pthread_mutex_unlock(&dataRegisterMutex);
+			break;
+		}
+		data[length++] = uart->base->D;
+		pthread_mutex_unlock(&dataRegisterMutex);
+		uart->txBusyUntil += byteTime;
+	}
+	if (length > 0)
+		SIM_UartTransmitted(uart, data, length);
+}
+
+/* every millisecond: transmitters with the interrupt on get the next burst, a
+* received byte is signalled again if its interrupt was missed, the idle line
+* flag rises and the eDMA transmitters are fed */
+void SIM_UartService(void)
+{
+	SimUart_t* uart;
+	uint32_t i;
+	bool raise;
+	for (i = 0; i < SIM_UART_COUNT; i++)
+	{
+		uart = &uarts[i];
+		if (uart->base->C5 & UART_C5_TDMAS_MASK)
+			SIM_UartServiceTxDma(uart);
+		SIM_Lock();
+		if (uart->idleAt && (SIM_Now() >= uart->idleAt))
+		{
+			uart->idleAt = 0;
+			uart->idle = true;
+		}
+		raise = (uart->interrupts & kUART_TxDataRegEmptyInterruptEnable) ||
+				((uart->interrupts & SIM_UART_RX_INTERRUPTS) && uart->rxFull) ||
+				((uart->interrupts & kUART_IdleLineInterruptEnable) && uart->idle);
+		SIM_Unlock();
+		if (raise)
+			SIM_RaiseIrq(uart->line);
+	}
+}
+
+void SIM_UartReport(void)
+{
+	uint32_t i;
+	printf("uarts\n");
+	for (i = 0; i < SIM_UART_COUNT; i++)
+	{
+		printf("  %-20s %6u bit/s  tx %8llu B  rx %8llu B  overruns %u  interrupts %llu\n", uarts[i].name,
+			   (unsigned)uarts[i].baudRate, (unsigned long long)uarts[i].txBytes,
+			   (unsigned long long)uarts[i].rxBytes, (unsigned)uarts[i].overruns,
+			   (unsigned long long)uarts[i].handlerCalls);
+	}
+}
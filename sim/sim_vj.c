@@ -0,0 +1,360 @@
+/* sim_vj.c
+* Van Jacobson TCP/IP header compression (RFC 1144) of the simulated modem.
+* Written from the RFC and not from ppp_vj.c, so a link between the two
+* checks the firmware against a second implementation. Packets are plain
+* byte arrays in network order
+*/
+#include <string.h>
+#include "sim.h"
+
+#define SIM_VJ_C		0x40
+#define SIM_VJ_I		0x20
+#define SIM_VJ_P		0x10
+#define SIM_VJ_S		0x08
+#define SIM_VJ_A		0x04
+#define SIM_VJ_W		0x02
+#define SIM_VJ_U		0x01
+#define SIM_VJ_SPECIAL_I	(SIM_VJ_S | SIM_VJ_W | SIM_VJ_U)
+#define SIM_VJ_SPECIAL_D	(SIM_VJ_S | SIM_VJ_A | SIM_VJ_W | SIM_VJ_U)
+#define SIM_VJ_SPECIALS		SIM_VJ_SPECIAL_D
+
+#define SIM_TCP_FIN		0x01
+#define SIM_TCP_SYN		0x02
+#define SIM_TCP_RST		0x04
+#define SIM_TCP_PSH		0x08
+#define SIM_TCP_ACK		0x10
+#define SIM_TCP_URG		0x20
+
+static uint16_t SIM_VjGet16(const uint8_t* p)
+{
+	return (uint16_t)((p[0] << 8) | p[1]);
+}
+
+static uint32_t SIM_VjGet32(const uint8_t* p)
+{
+	return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static void SIM_VjPut16(uint8_t* p, uint16_t value)
+{
+	p[0] = (uint8_t)(value >> 8);
+	p[1] = (uint8_t)value;
+}
+
+static void SIM_VjPut32(uint8_t* p, uint32_t value)
+{
+	SIM_VjPut16(p, (uint16_t)(value >> 16));
+	SIM_VjPut16(p + 2, (uint16_t)value);
+}
+
+/* ENCODE and ENCODEZ of the RFC: a zero byte introduces a 16-bit value */
+static uint8_t* SIM_VjEncode(uint8_t* p, uint32_t value, bool zero)
+{
+	if ((value >= 256) || (zero && (value == 0)))
+	{
+		*p++ = 0;
+		SIM_VjPut16(p, (uint16_t)value);
+		return p + 2;
+	}
+	*p++ = (uint8_t)value;
+	return p;
+}
+
+static bool SIM_VjDecode(const uint8_t** p, const uint8_t* end, uint16_t* value)
+{
+	if (*p >= end)
+		return false;
+	if (**p != 0)
+	{
+		*value = *(*p)++;
+		return true;
+	}
+	if (end - *p < 3)
+		return false;
+	*value = SIM_VjGet16(*p + 1);
+	*p += 3;
+	return true;
+}
+
+static uint16_t SIM_VjIpChecksum(const uint8_t* header, size_t length)
+{
+	uint32_t sum = 0;
+	size_t i;
+	for (i = 0; i + 1 < length; i += 2)
+		sum += SIM_VjGet16(header + i);
+	while (sum >> 16)
+		sum = (sum & 0xFFFF) + (sum >> 16);
+	return (uint16_t)~sum;
+}
+
+void SIM_VjInit(SimVj_t* vj, uint32_t maxSlotId, bool compSlot)
+{
+	memset(vj, 0, sizeof(*vj));
+	vj->txSlots = (maxSlotId + 1 < SIM_VJ_SLOTS) ? maxSlotId + 1 : SIM_VJ_SLOTS;
+	vj->txCompSlot = compSlot;
+	vj->txLast = SIM_VJ_SLOTS;
+	vj->rxToss = true;
+}
+
+/* compresses an IP datagram in place, returns the PPP protocol to send it
+* with and updates its length */
+uint16_t SIM_VjCompress(SimVj_t* vj, uint8_t* packet, size_t* length)
+{
+	uint8_t delta[16], *p = delta, *t, *ot, *out;
+	uint32_t slot, deltaS, deltaA, previous;
+	uint16_t deltaW, deltaI;
+	uint8_t changes = 0;
+	size_t ipLength, headerLength, n, k;
+	SimVjSlot_t* s = NULL;
+	if ((*length < 40) || (packet[9] != 6) || (SIM_VjGet16(packet + 6) & 0x3FFF))
+		return SIM_PPP_IP;
+	ipLength = (packet[0] & 0x0F) * 4;
+	if ((ipLength < 20) || (ipLength + 20 > *length))
+		return SIM_PPP_IP;
+	t = packet + ipLength;
+	headerLength = ipLength + (t[12] >> 4) * 4;
+	if (((t[12] >> 4) < 5) || (headerLength > *length) || (headerLength > SIM_VJ_HEADER))
+		return SIM_PPP_IP;
+	if ((t[13] & (SIM_TCP_SYN | SIM_TCP_FIN | SIM_TCP_RST | SIM_TCP_ACK)) != SIM_TCP_ACK)
+		return SIM_PPP_IP;
+	vj->txTcp++;
+	for (slot = 0; slot < vj->txSlots; slot++)
+	{
+		s = &vj->tx[slot];
+		ot = s->header + (s->header[0] & 0x0F) * 4;
+		if (s->valid && (memcmp(s->header + 12, packet + 12, 8) == 0) && (memcmp(ot, t, 4) == 0))
+			break;
+	}
+	if (slot == vj->txSlots)
+	{
+		/* round robin over the slots for new connections */
+		slot = vj->txNext;
+		vj->txNext = (vj->txNext + 1) % vj->txSlots;
+		s = &vj->tx[slot];
+		goto uncompressed;
+	}
+	ot = s->header + ipLength;
+	if ((packet[0] != s->header[0]) || (packet[1] != s->header[1]) ||
+		(memcmp(packet + 6, s->header + 6, 3) != 0) || (t[12] != ot[12]) ||
+		(memcmp(packet + 20, s->header + 20, ipLength - 20) != 0) ||
+		(memcmp(t + 20, ot + 20, headerLength - ipLength - 20) != 0))
+		goto uncompressed;
+	if (t[13] & SIM_TCP_URG)
+	{
+		p = SIM_VjEncode(p, SIM_VjGet16(t + 18), true);
+		changes |= SIM_VJ_U;
+	}
+	else if (SIM_VjGet16(t + 18) != SIM_VjGet16(ot + 18))
+	{
+		goto uncompressed;
+	}
+	deltaW = (uint16_t)(SIM_VjGet16(t + 14) - SIM_VjGet16(ot + 14));
+	if (deltaW != 0)
+	{
+		p = SIM_VjEncode(p, deltaW, false);
+		changes |= SIM_VJ_W;
+	}
+	deltaA = SIM_VjGet32(t + 8) - SIM_VjGet32(ot + 8);
+	if (deltaA != 0)
+	{
+		if (deltaA > 0xFFFF)
+			goto uncompressed;
+		p = SIM_VjEncode(p, deltaA, false);
+		changes |= SIM_VJ_A;
+	}
+	deltaS = SIM_VjGet32(t + 4) - SIM_VjGet32(ot + 4);
+	if (deltaS != 0)
+	{
+		if (deltaS > 0xFFFF)
+			goto uncompressed;
+		p = SIM_VjEncode(p, deltaS, false);
+		changes |= SIM_VJ_S;
+	}
+	previous = SIM_VjGet16(s->header + 2) - s->length;
+	switch (changes)
+	{
+	case 0:
+		/* data after a pure ACK, anything else unchanged is a retransmission */
+		if ((SIM_VjGet16(packet + 2) != SIM_VjGet16(s->header + 2)) && (previous == 0))
+			break;
+		goto uncompressed;
+	case SIM_VJ_SPECIAL_I:
+	case SIM_VJ_SPECIAL_D:
+		goto uncompressed;
+	case SIM_VJ_S | SIM_VJ_A:
+		if ((deltaS == deltaA) && (deltaS == previous))
+		{
+			changes = SIM_VJ_SPECIAL_I;
+			p = delta;
+		}
+		break;
+	case SIM_VJ_S:
+		if (deltaS == previous)
+		{
+			changes = SIM_VJ_SPECIAL_D;
+			p = delta;
+		}
+		break;
+	default:
+		break;
+	}
+	deltaI = (uint16_t)(SIM_VjGet16(packet + 4) - SIM_VjGet16(s->header + 4));
+	if (deltaI != 1)
+	{
+		p = SIM_VjEncode(p, deltaI, true);
+		changes |= SIM_VJ_I;
+	}
+	if (t[13] & SIM_TCP_PSH)
+		changes |= SIM_VJ_P;
+	memcpy(s->header, packet, headerLength);
+	s->length = headerLength;
+	n = p - delta;
+	k = n + 3;
+	if (!vj->txCompSlot || (vj->txLast != slot))
+	{
+		changes |= SIM_VJ_C;
+		k++;
+	}
+	out = packet + headerLength - k;
+	*out++ = changes;
+	if (changes & SIM_VJ_C)
+		*out++ = (uint8_t)slot;
+	/* the TCP checksum is still in the saved header */
+	memcpy(out, s->header + ipLength + 16, 2);
+	memcpy(out + 2, delta, n);
+	memmove(packet, packet + headerLength - k, *length - headerLength + k);
+	*length -= headerLength - k;
+	vj->txLast = slot;
+	vj->txCompressed++;
+	vj->txSaved += headerLength - k;
+	return SIM_PPP_VJ_COMP;
+uncompressed:
+	memcpy(s->header, packet, headerLength);
+	s->length = headerLength;
+	s->valid = true;
+	packet[9] = (uint8_t)slot;
+	vj->txLast = slot;
+	return SIM_PPP_VJ_UNCOMP;
+}
+
+/* rebuilds the IP datagram of a VJ packet in out, returns its length or 0
+* when the packet is discarded */
+size_t SIM_VjDecompress(SimVj_t* vj, uint16_t protocol, const uint8_t* in, size_t length, uint8_t* out, size_t size)
+{
+	const uint8_t *p = in, *end = in + length;
+	uint8_t changes, *t;
+	uint16_t value;
+	uint32_t previous;
+	size_t ipLength, headerLength;
+	SimVjSlot_t* s;
+	if (protocol == SIM_PPP_VJ_UNCOMP)
+	{
+		if ((length < 40) || (in[9] >= SIM_VJ_SLOTS) || (length > size))
+			goto error;
+		ipLength = (in[0] & 0x0F) * 4;
+		if ((ipLength < 20) || (ipLength + 20 > length))
+			goto error;
+		headerLength = ipLength + (in[ipLength + 12] >> 4) * 4;
+		if (((in[ipLength + 12] >> 4) < 5) || (headerLength > length) || (headerLength > SIM_VJ_HEADER))
+			goto error;
+		vj->rxLast = in[9];
+		vj->rxToss = false;
+		memcpy(out, in, length);
+		out[9] = 6;
+		s = &vj->rx[vj->rxLast];
+		memcpy(s->header, out, headerLength);
+		s->length = headerLength;
+		s->valid = true;
+		vj->rxUncompressed++;
+		return length;
+	}
+	if (length < 3)
+		goto error;
+	changes = *p++;
+	if (changes & SIM_VJ_C)
+	{
+		if (*p >= SIM_VJ_SLOTS)
+			goto error;
+		vj->rxLast = *p++;
+		vj->rxToss = false;
+	}
+	else if (vj->rxToss)
+	{
+		goto error;
+	}
+	s = &vj->rx[vj->rxLast];
+	if (!s->valid || (end - p < 2))
+		goto error;
+	ipLength = (s->header[0] & 0x0F) * 4;
+	t = s->header + ipLength;
+	memcpy(t + 16, p, 2);
+	p += 2;
+	t[13] = (changes & SIM_VJ_P) ? (t[13] | SIM_TCP_PSH) : (t[13] & ~SIM_TCP_PSH);
+	previous = SIM_VjGet16(s->header + 2) - s->length;
+	switch (changes & SIM_VJ_SPECIALS)
+	{
+	case SIM_VJ_SPECIAL_I:
+		SIM_VjPut32(t + 8, SIM_VjGet32(t + 8) + previous);
+		SIM_VjPut32(t + 4, SIM_VjGet32(t + 4) + previous);
+		break;
+	case SIM_VJ_SPECIAL_D:
+		SIM_VjPut32(t + 4, SIM_VjGet32(t + 4) + previous);
+		break;
+	default:
+		if (changes & SIM_VJ_U)
+		{
+			if (!SIM_VjDecode(&p, end, &value))
+				goto error;
+			t[13] |= SIM_TCP_URG;
+			SIM_VjPut16(t + 18, value);
+		}
+		else
+		{
+			t[13] &= ~SIM_TCP_URG;
+		}
+		if (changes & SIM_VJ_W)
+		{
+			if (!SIM_VjDecode(&p, end, &value))
+				goto error;
+			SIM_VjPut16(t + 14, (uint16_t)(SIM_VjGet16(t + 14) + value));
+		}
+		if (changes & SIM_VJ_A)
+		{
+			if (!SIM_VjDecode(&p, end, &value))
+				goto error;
+			SIM_VjPut32(t + 8, SIM_VjGet32(t + 8) + value);
+		}
+		if (changes & SIM_VJ_S)
+		{
+			if (!SIM_VjDecode(&p, end, &value))
+				goto error;
+			SIM_VjPut32(t + 4, SIM_VjGet32(t + 4) + value);
+		}
+		break;
+	}
+	value = 1;
+	if ((changes & SIM_VJ_I) && !SIM_VjDecode(&p, end, &value))
+		goto error;
+	SIM_VjPut16(s->header + 4, (uint16_t)(SIM_VjGet16(s->header + 4) + value));
+	headerLength = s->length;
+	if (headerLength + (end - p) > size)
+		goto error;
+	SIM_VjPut16(s->header + 2, (uint16_t)(headerLength + (end - p)));
+	SIM_VjPut16(s->header + 10, 0);
+	SIM_VjPut16(s->header + 10, SIM_VjIpChecksum(s->header, ipLength));
+	memcpy(out, s->header, headerLength);
+	memcpy(out + headerLength, p, end - p);
+	vj->rxCompressed++;
+	vj->rxSaved += headerLength - (p - in);
+	return headerLength + (end - p);
+error:
+	vj->rxToss = true;
+	vj->rxErrors++;
+	return 0;
+}
+
+/* a frame was lost, compressed packets are tossed until a slot ID comes */
+void SIM_VjLost(SimVj_t* vj)
+{
+	vj->rxToss = true;
+}
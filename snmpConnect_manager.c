@@ -18,110 +18,253 @@
 //Global Variable
 //========================================
 #if (USERDEF_CLIENT_SNMP == ENABLED)
-extern SnmpAgentContext ethernetSnmpAgentContext;
 extern sMenu_Variable_Struct	sMenu_Variable;
 #endif
 
 SNMPConnectManager  snmpConnectManager = {
   .status = DISCONNECTED,
-  .pingTick  = PING_SEND_PERIOD
+  .backoff = CONNECT_PROBE_MIN_BACKOFF
 };
 
 NetInterface *activeNetInterface = NULL;
+
+//Routing policy of each traffic class
+static const route_policy_t routePolicy[TRAFFIC_CLASS_COUNT] =
+{
+  [TRAFFIC_CLASS_ALARM] = ROUTE_POLICY_ALL_LINKS,
+  [TRAFFIC_CLASS_TELEMETRY] = ROUTE_POLICY_LOWEST_RTT,
+  [TRAFFIC_CLASS_BULK] = ROUTE_POLICY_ETHERNET_ONLY
+};
 //========================================
 //Function Implementation
 //========================================
+
+/**
+* @brief Ethernet link change, called by the TCP/IP stack
+*
+* The task is woken up at once instead of finding out with its next ping
+**/
+static void snmpConnectLinkChange(NetInterface *interface, bool_t linkState, void *params)
+{
+  snmpConnectManager.linkChanged = TRUE;
+  osSetEvent(&snmpConnectManager.event);
+}
+
+/**
+* @brief Move the traffic to GPRS
+*
+* With the warm standby the PPP session is already up and the switch is
+* immediate, otherwise the modem is started and the traffic waits for it
+**/
+static void snmpConnectUseGprs(void)
+{
+  snmpConnectManager.failovers++;
+  snmpConnectManager.lost = 0;
+  snmpConnectManager.backoff = CONNECT_PROBE_MIN_BACKOFF;
+  snmpConnectManager.nextProbe = osGetSystemTime() + CONNECT_PROBE_MIN_BACKOFF;
+  ModemInterfaceSetState(MODEM_INTERFACE_STATE_CONNECTED);
+  if (ModemInterfaceGetState() == MODEM_INTERFACE_STATE_CONNECTED)
+  {
+    snmpConnectManager.status = GPRS_CONNECTED;
+    activeNetInterface = GPRS_INTERFACE;
+    TRACE_INFO("ethernet down, GPRS up\r\n");
+  }
+  else
+  {
+    snmpConnectManager.status = DISCONNECTED;
+    activeNetInterface = NULL;
+    TRACE_INFO("ethernet down, turn GPRS on\r\n");
+  }
+}
+
+/**
+* @brief Move the traffic back to Ethernet
+**/
+static void snmpConnectUseEthernet(void)
+{
+  if (snmpConnectManager.status == GPRS_CONNECTED)
+  {
+    snmpConnectManager.failbacks++;
+    MenuGetDeviceIpv4(&privateMibBase.siteInfoGroup.siteInfoIpAddress);
+  }
+  snmpConnectManager.status = ETHERNET_CONNECTED;
+  activeNetInterface = ETH_INTERFACE;
+#if (USERDEF_GPRS_WARM_STANDBY == ENABLED)
+  TRACE_INFO("Ethernet up, GPRS in standby\r\n");
+#else
+  ModemInterfaceSetState(MODEM_INTERFACE_STATE_DISCONNECTED);
+  TRACE_INFO("Ethernet up, turn GPRS OFF\r\n");
+#endif
+}
+
+/**
+* @brief Choose the link with the lower round trip time
+*
+* With both links up the current one is kept until the other is measured
+* faster by CONNECT_RTT_HYSTERESIS, so that the MQTT session does not move
+* back and forth
+*
+* @param[in] current Interface used so far
+* @param[in] ethUp The server is reachable over Ethernet
+* @param[in] gprsUp The PPP session is up
+* @return Interface to use (NULL if no link is up)
+**/
+static NetInterface* snmpConnectLowestRtt(NetInterface *current, bool_t ethUp, bool_t gprsUp)
+{
+  uint32_t currentRtt;
+  uint32_t otherRtt;
+  
+  if (!ethUp)
+    return gprsUp ? GPRS_INTERFACE : NULL;
+  if (!gprsUp)
+    return ETH_INTERFACE;
+  if ((current != ETH_INTERFACE) && (current != GPRS_INTERFACE))
+    current = activeNetInterface;
+  
+  currentRtt = (current == ETH_INTERFACE) ? snmpConnectManager.ethRtt : snmpConnectManager.gprsRtt;
+  otherRtt = (current == ETH_INTERFACE) ? snmpConnectManager.gprsRtt : snmpConnectManager.ethRtt;
+  //A link that has not been measured yet does not take the traffic
+  if ((currentRtt != 0) && (otherRtt != 0) && (otherRtt < currentRtt - currentRtt / CONNECT_RTT_HYSTERESIS))
+    return (current == ETH_INTERFACE) ? GPRS_INTERFACE : ETH_INTERFACE;
+  return current;
+}
+
+/**
+* @brief Update the interface of each traffic class
+**/
+static void snmpConnectUpdateRoutes(void)
+{
+  bool_t ethUp;
+  bool_t gprsUp;
+  NetInterface *interface;
+  uint_t i;
+  
+  ethUp = (snmpConnectManager.status == ETHERNET_CONNECTED);
+  gprsUp = (ModemInterfaceGetState() == MODEM_INTERFACE_STATE_CONNECTED);
+  osAcquireMutex(&snmpConnectManager.mutex);
+  //A link that comes back is measured again
+  if (!ethUp)
+    snmpConnectManager.ethRtt = 0;
+  if (!gprsUp)
+    snmpConnectManager.gprsRtt = 0;
+  
+  for (i = 0; i < TRAFFIC_CLASS_COUNT; i++)
+  {
+    switch (routePolicy[i])
+    {
+    case ROUTE_POLICY_ETHERNET_ONLY:
+      interface = ethUp ? ETH_INTERFACE : NULL;
+      break;
+    case ROUTE_POLICY_LOWEST_RTT:
+      interface = snmpConnectLowestRtt(snmpConnectManager.route[i], ethUp, gprsUp);
+      break;
+    default:
+      interface = activeNetInterface;
+      break;
+    }
+    if (interface != snmpConnectManager.route[i])
+    {
+      TRACE_INFO("traffic class %u routed to %s\r\n", i, (interface != NULL) ? interface->name : "none");
+      snmpConnectManager.route[i] = interface;
+    }
+  }
+  osReleaseMutex(&snmpConnectManager.mutex);
+}
+
 void snmpConnectManagerTask (void *param)
 {
-  NetInterface *netInterface= ethernetSnmpAgentContext.socket->interface;
+  NetInterface *ethInterface = ETH_INTERFACE;
   IpAddr ipaddr; 
-  uint32_t timeout = 3000;
   uint32_t rtt_time;
   error_t status;
-  uint16_t pingRetry = 0;
-  bool pingRequested = FALSE;
+  systime_t now;
+  systime_t delay;
   ipStringToAddr((const char*)sMenu_Variable.ucSIP, &ipaddr); 
-  osDelayTask(5000); 
+  osCreateEvent(&snmpConnectManager.event);
+  //Before the modem task can measure the GPRS link
+  osCreateMutex(&snmpConnectManager.mutex);
+  netAttachLinkChangeCallback(ethInterface, snmpConnectLinkChange, NULL, NULL);
+#if (USERDEF_GPRS_WARM_STANDBY == ENABLED)
+  //The PPP session is kept up behind Ethernet
+  ModemInterfaceSetState(MODEM_INTERFACE_STATE_CONNECTED);
+#endif
+  //A link up ends the wait early
+  osWaitForEvent(&snmpConnectManager.event, CONNECT_STARTUP_DELAY);
+  snmpConnectManager.linkChanged = TRUE;
   for (;;)  {
-    if (snmpConnectManager.pingTick > PING_SEND_PERIOD)
+    now = osGetSystemTime();
+    if (snmpConnectManager.linkChanged)
     {
-      netInterface = ethernetSnmpAgentContext.socket->interface;
-      if (netInterface->linkState == TRUE)
+      snmpConnectManager.linkChanged = FALSE;
+      //Probe at once when the cable comes back
+      snmpConnectManager.nextProbe = now;
+      snmpConnectManager.backoff = CONNECT_PROBE_MIN_BACKOFF;
+    }
+    
+    if (ethInterface->linkState != TRUE)
+    {
+      if (snmpConnectManager.status == ETHERNET_CONNECTED)
+        snmpConnectUseGprs();
+    }
+    else if (timeCompare(now, snmpConnectManager.nextProbe) >= 0)
+    {
+      TRACE_INFO("Send ping to %s\r\n", sMenu_Variable.ucSIP);  
+      status = ping(ethInterface, &ipaddr, 32, 255, CONNECT_PROBE_TIMEOUT, &rtt_time);
+      now = osGetSystemTime();
+      if (status == NO_ERROR)
+      {
+        interfaceManagerUpdateRtt(ethInterface, rtt_time);
+        snmpConnectManager.lost = 0;
+        snmpConnectManager.nextProbe = now + CONNECT_PROBE_INTERVAL;
+        if (snmpConnectManager.status != ETHERNET_CONNECTED)
+          snmpConnectUseEthernet();
+      }
+      else if (snmpConnectManager.status == ETHERNET_CONNECTED)
       {
-        TRACE_INFO("Send ping to %s\r\n", sMenu_Variable.ucSIP);  
-        status = ping(netInterface, &ipaddr, 32, 255, timeout, &rtt_time);
-        snmpConnectManager.pingTick = 0;
-        pingRequested = TRUE;
-        if (status != NO_ERROR)
-          TRACE_INFO("ethernet ping failed...\r\n");
+        TRACE_INFO("ethernet ping failed...\r\n");
+        snmpConnectManager.nextProbe = now + CONNECT_PROBE_RETRY_INTERVAL;
+        if (++snmpConnectManager.lost >= CONNECT_PROBE_LOST)
+          snmpConnectUseGprs();
       }
       else
       {
-        if (snmpConnectManager.status == ETHERNET_CONNECTED)
-        {
-          activeNetInterface = NULL;
-          snmpConnectManager.status = DISCONNECTED;
-          ModemInterfaceSetState(MODEM_INTERFACE_STATE_CONNECTED);
-        }          
+        //Back off while the server stays unreachable over Ethernet
+        snmpConnectManager.nextProbe = now + snmpConnectManager.backoff;
+        snmpConnectManager.backoff = MIN(snmpConnectManager.backoff * 2, CONNECT_PROBE_MAX_BACKOFF);
       }
-    }    
+    }
+    
     switch (snmpConnectManager.status)
     {
-    case ETHERNET_CONNECTED:
-      if (pingRequested && (status != NO_ERROR))
-      {
-        pingRequested = false;
-        if (pingRetry > 1)
-        {
-          pingRetry = 0;
-          // establish ppp connection
-          snmpConnectManager.status = DISCONNECTED;
-          activeNetInterface = NULL;
-          ModemInterfaceSetState(MODEM_INTERFACE_STATE_CONNECTED);
-        } else pingRetry++;
-      }
-      break;
     case GPRS_CONNECTED:
-      if (pingRequested && (status == NO_ERROR))
-      {
-        pingRequested = false;
-        snmpConnectManager.status = ETHERNET_CONNECTED;        
-        activeNetInterface = &netInterface[0];
-        MenuGetDeviceIpv4(&privateMibBase.siteInfoGroup.siteInfoIpAddress);
-        ModemInterfaceSetState(MODEM_INTERFACE_STATE_DISCONNECTED);
-        TRACE_INFO("Ethernet up, turn GPRS OFF\r\n");
-      }
-      else if (ModemInterfaceGetState() == MODEM_INTERFACE_STATE_DISCONNECTED)
+      if (ModemInterfaceGetState() == MODEM_INTERFACE_STATE_DISCONNECTED)
       {
         snmpConnectManager.status = DISCONNECTED;
         activeNetInterface = NULL;
-        ModemInterfaceSetState(MODEM_INTERFACE_STATE_CONNECTED);
         TRACE_INFO("Turn GPRS on... %d\r\n", ModemInterfaceGetState());
       }
       break;
     case DISCONNECTED:
-      if (pingRequested && (status == NO_ERROR))
-      {
-        activeNetInterface = &netInterface[0];
-        snmpConnectManager.status = ETHERNET_CONNECTED;
-//        MenuGetDeviceIpv4(&privateMibBase.siteInfoGroup.siteInfoIpAddress);
-        ModemInterfaceSetState(MODEM_INTERFACE_STATE_DISCONNECTED);
-        TRACE_INFO("Ethernet up\r\n");
-      }
-      else if (ModemInterfaceGetState() == MODEM_INTERFACE_STATE_DISCONNECTED)
-        ModemInterfaceSetState(MODEM_INTERFACE_STATE_CONNECTED);
-      else if (ModemInterfaceGetState() == MODEM_INTERFACE_STATE_CONNECTED)       
+      if (ModemInterfaceGetState() == MODEM_INTERFACE_STATE_CONNECTED)
       {
         snmpConnectManager.status = GPRS_CONNECTED;
-        activeNetInterface = &netInterface[1];
+        activeNetInterface = GPRS_INTERFACE;
         TRACE_INFO("ethernet down, GPRS up\r\n");
       }
+      else
+        ModemInterfaceSetState(MODEM_INTERFACE_STATE_CONNECTED);
       break;
     default:
       break;
     }
-    pingRequested = FALSE;
-    osDelayTask(1000);
+    snmpConnectUpdateRoutes();
+    
+    //Sleep until the next probe or a link change
+    now = osGetSystemTime();
+    delay = CONNECT_POLL_INTERVAL;
+    if ((ethInterface->linkState == TRUE) && (timeCompare(snmpConnectManager.nextProbe, now + delay) < 0))
+      delay = (timeCompare(snmpConnectManager.nextProbe, now) > 0) ? (snmpConnectManager.nextProbe - now) : 0;
+    osWaitForEvent(&snmpConnectManager.event, delay);
   }
 }
 
@@ -131,12 +274,65 @@ connection_status_t snmpConnectCheckStatus (void)
   return snmpConnectManager.status;
 }
 
-void snmpConnectIncreaseTick (void)
+NetInterface* interfaceManagerGetActiveInterface()
 {
-  snmpConnectManager.pingTick ++;
+  return activeNetInterface;
 }
 
-NetInterface* interfaceManagerGetActiveInterface()
+/**
+* @brief Get the interface of a traffic class
+* @param[in] trafficClass Traffic class
+* @return Preferred interface (NULL if the class has no route)
+**/
+NetInterface* interfaceManagerGetClassInterface(traffic_class_t trafficClass)
 {
-  return activeNetInterface;
+  if (trafficClass >= TRAFFIC_CLASS_COUNT)
+    return NULL;
+  return snmpConnectManager.route[trafficClass];
+}
+
+/**
+* @brief Get every interface a traffic class is sent on
+* @param[in] trafficClass Traffic class
+* @param[out] interfaces Up to CONNECT_MAX_LINKS interfaces, the preferred one first
+* @return Number of interfaces
+**/
+uint_t interfaceManagerGetClassInterfaces(traffic_class_t trafficClass, NetInterface **interfaces)
+{
+  uint_t n = 0;
+  
+  interfaces[0] = interfaceManagerGetClassInterface(trafficClass);
+  if (interfaces[0] == NULL)
+    return 0;
+  n++;
+  //The PPP session kept up behind Ethernet carries a copy
+  if ((routePolicy[trafficClass] == ROUTE_POLICY_ALL_LINKS) && (interfaces[0] == ETH_INTERFACE) &&
+      (ModemInterfaceGetState() == MODEM_INTERFACE_STATE_CONNECTED))
+    interfaces[n++] = GPRS_INTERFACE;
+  return n;
+}
+
+/**
+* @brief Add a round trip time sample of a link
+*
+* Smoothed with a gain of 1/8, as the TCP round trip time estimator.
+* Called by this task for Ethernet and by the modem task for GPRS
+*
+* @param[in] interface Interface the ping was sent on
+* @param[in] rtt Round trip time (ms)
+**/
+void interfaceManagerUpdateRtt(NetInterface *interface, uint32_t rtt)
+{
+  uint32_t *srtt;
+  
+  srtt = (interface == ETH_INTERFACE) ? &snmpConnectManager.ethRtt : &snmpConnectManager.gprsRtt;
+  //Zero means unknown
+  rtt = MAX(rtt, 1);
+  //Not mixed with the reset of a link that went down
+  osAcquireMutex(&snmpConnectManager.mutex);
+  if (*srtt == 0)
+    *srtt = rtt;
+  else
+    *srtt = (7 * *srtt + rtt) / 8;
+  osReleaseMutex(&snmpConnectManager.mutex);
 }
\ No newline at end of file
@@ -39,23 +39,70 @@ typedef enum connection_status_e
   DISCONNECTED
 } connection_status_t;
 
+/**
+* @brief Traffic classes of the routing policy
+**/
+typedef enum traffic_class_e
+{
+  TRAFFIC_CLASS_ALARM,                                  ///<Alarm traps and informs
+  TRAFFIC_CLASS_TELEMETRY,                              ///<MQTT session and periodic info traps
+  TRAFFIC_CLASS_BULK,                                   ///<Firmware update, log and capture upload
+  TRAFFIC_CLASS_COUNT
+} traffic_class_t;
+
+typedef enum route_policy_e
+{
+  ROUTE_POLICY_ALL_LINKS,                               ///<Every link that is up, the active one first
+  ROUTE_POLICY_ETHERNET_ONLY,
+  ROUTE_POLICY_LOWEST_RTT
+} route_policy_t;
+
 typedef struct
 {
   connection_status_t status;
-  uint32_t pingTick;
-  OsMutex mutex;                                        ///<Mutex preventing simultaneous access to SNMP agent context
+  NetInterface *route[TRAFFIC_CLASS_COUNT];             ///<Preferred interface of each traffic class
+  uint32_t ethRtt;                                      ///<Smoothed round trip time over Ethernet (ms, 0 if unknown)
+  uint32_t gprsRtt;                                     ///<Smoothed round trip time over GPRS (ms, 0 if unknown)
+  OsEvent event;                                        ///<Set on an Ethernet link change
+  bool_t linkChanged;
+  systime_t nextProbe;                                  ///<Time of the next ping to the server over Ethernet
+  systime_t backoff;                                    ///<Probe interval while on GPRS
+  uint8_t lost;                                         ///<Consecutive lost replies while on Ethernet
+  uint32_t failovers;
+  uint32_t failbacks;
+  OsMutex mutex;                                        ///<Mutex protecting the round trip times, updated by the modem task too
 }SNMPConnectManager;
 
-#define PING_SEND_PERIOD        5
+//Ping to the server over Ethernet: every 10 s while it answers, every 1 s
+//after a lost reply, and from 2 s doubling up to 60 s while on GPRS
+#define CONNECT_PROBE_INTERVAL          10000
+#define CONNECT_PROBE_RETRY_INTERVAL    1000
+#define CONNECT_PROBE_MIN_BACKOFF       2000
+#define CONNECT_PROBE_MAX_BACKOFF       60000
+#define CONNECT_PROBE_TIMEOUT           2000
+//Lost replies before switching to GPRS, a link down switches at once
+#define CONNECT_PROBE_LOST              3
+//Time given to the Ethernet link at start up
+#define CONNECT_STARTUP_DELAY           5000
+//Longest wait between two checks of the PPP state
+#define CONNECT_POLL_INTERVAL           1000
+//Telemetry moves to the other link once its round trip time is lower by
+//a quarter
+#define CONNECT_RTT_HYSTERESIS          4
+//Links a traffic class can be sent on at once
+#define CONNECT_MAX_LINKS               2
 #define ETH_INTERFACE          (&netInterface[0])
 #define GPRS_INTERFACE         (&netInterface[1])
 
+extern SNMPConnectManager snmpConnectManager;
+
 //=======================================
 //Function declearation
 //=======================================
 void snmpConnectManagerTask (void *param);
 connection_status_t snmpConnectCheckStatus (void);
-void snmpConnectIncreaseTick(void);
-void snmpConnectManagerSendPing (void);
 NetInterface* interfaceManagerGetActiveInterface();
+NetInterface* interfaceManagerGetClassInterface(traffic_class_t trafficClass);
+uint_t interfaceManagerGetClassInterfaces(traffic_class_t trafficClass, NetInterface **interfaces);
+void interfaceManagerUpdateRtt(NetInterface *interface, uint32_t rtt);
 #endif
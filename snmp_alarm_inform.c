@@ -0,0 +1,429 @@
+/**
+* @file snmp_alarm_inform.c
+* @brief Alarm delivery using SNMP InformRequest
+*
+* Alarms are kept in a bounded queue until the manager they were sent to
+* acknowledges them with a GetResponse-PDU. Unacknowledged alarms are
+* retransmitted with an exponential backoff, and stay queued while no link is
+* available. When the queue is full, the oldest alarm is dropped. The variable
+* bindings are encoded when the alarm is queued, so a late or repeated inform
+* still reports the transition that raised it.
+*
+* The queue is mirrored in EEPROM so that a reset or a watchdog does not lose
+* the alarms. An EEPROM byte takes 20 ms to write, so an alarm is saved after
+* its first transmission rather than before, and an acknowledgment only
+* clears the state byte of its entry
+*
+* @section License
+* ^^(^____^)^^
+*
+**/
+
+//Dependencies
+#include <stdlib.h>
+#include <stddef.h>
+#include "core/net.h"
+#include "snmp_alarm_inform.h"
+#include "private_mib_module.h"
+#include "data_usage.h"
+#include "variables.h"
+#include "eeprom_rtc.h"
+#include "i2c_lock.h"
+#include "task.h"
+#include "debug.h"
+
+#if (USERDEF_CLIENT_SNMP == ENABLED && USERDEF_SNMP_ALARM_INFORM == ENABLED)
+
+//The entries must hold a record, start after the data usage record and stay
+//within the 24C256
+typedef char SnmpAlarmInformRecordSizeCheck[(sizeof(SnmpAlarmInformRecord) <= SNMP_ALARM_INFORM_RECORD_SIZE) ? 1 : -1];
+typedef char SnmpAlarmInformDataUsageCheck[(DATA_USAGE_EEPROM_ADDR + sizeof(DataUsageRecord) <= SNMP_ALARM_INFORM_EEPROM_ADDR) ? 1 : -1];
+#if (SNMP_ALARM_INFORM_EEPROM_ADDR + SNMP_ALARM_INFORM_QUEUE_SIZE * SNMP_ALARM_INFORM_RECORD_SIZE > 32768)
+   #error The SNMP inform queue does not fit in EEPROM
+#endif
+//========================================
+//Global Variable
+//========================================
+static SnmpAlarmInformEntry snmpAlarmInformQueue[SNMP_ALARM_INFORM_QUEUE_SIZE];
+static OsMutex snmpAlarmInformMutex;
+static int32_t snmpAlarmInformRequestId;
+
+//========================================
+//Function Implementation
+//========================================
+
+/**
+* @brief Write a byte of a queue entry to EEPROM
+* @param[in] slot Index of the entry
+* @param[in] offset Offset of the byte in the record
+* @param[in] data Value of the byte
+**/
+static void SnmpAlarmInformWriteByte(uint_t slot, uint_t offset, uint8_t data)
+{
+  I2C_Get_Lock();
+  vTaskSuspendAll();
+  WriteEEPROM_Byte(SNMP_ALARM_INFORM_EEPROM_ADDR + slot * SNMP_ALARM_INFORM_RECORD_SIZE + offset, data);
+  xTaskResumeAll();
+  I2C_Release_Lock();
+}
+
+/**
+* @brief Save a queued alarm to EEPROM
+* @param[in] slot Index of the entry
+* @param[in] entry Alarm to be saved
+**/
+static void SnmpAlarmInformStore(uint_t slot, const SnmpAlarmInformEntry *entry)
+{
+  uint_t i;
+  SnmpAlarmInformRecord record;
+  const uint8_t *p = (const uint8_t *) &record;
+
+  record.state = SNMP_ALARM_INFORM_RECORD_PENDING;
+  record.varBindListLen = entry->varBindListLen;
+  record.specificTrapCode = entry->specificTrapCode;
+  record.requestId = entry->requestId;
+  memcpy(record.varBindList, entry->varBindList, entry->varBindListLen);
+
+  //An entry that may still hold another alarm is freed first, and the state
+  //is written last, so that an interrupted write never leaves a pending
+  //entry with a mixed content
+  if(entry->stored)
+    SnmpAlarmInformWriteByte(slot, 0, SNMP_ALARM_INFORM_RECORD_FREE);
+  for(i = 1; i < offsetof(SnmpAlarmInformRecord, varBindList) + record.varBindListLen; i++)
+    SnmpAlarmInformWriteByte(slot, i, p[i]);
+  SnmpAlarmInformWriteByte(slot, 0, record.state);
+}
+
+/**
+* @brief Reload the alarms left in EEPROM by the previous run
+*
+* Called before the scheduler starts, the EEPROM is read without the I2C lock
+**/
+static void SnmpAlarmInformLoad(void)
+{
+  uint_t i;
+  uint_t j;
+  uint16_t address;
+  SnmpAlarmInformRecord record;
+  SnmpAlarmInformEntry *entry;
+  uint8_t *p = (uint8_t *) &record;
+
+  for(i = 0; i < SNMP_ALARM_INFORM_QUEUE_SIZE; i++)
+  {
+    address = SNMP_ALARM_INFORM_EEPROM_ADDR + i * SNMP_ALARM_INFORM_RECORD_SIZE;
+    //Blank EEPROM reads 0xFF, a free entry
+    if(ReadEEPROM_Byte(address) != SNMP_ALARM_INFORM_RECORD_PENDING)
+      continue;
+
+    for(j = 0; j < offsetof(SnmpAlarmInformRecord, varBindList); j++)
+      p[j] = ReadEEPROM_Byte(address + j);
+    if(record.varBindListLen > SNMP_ALARM_INFORM_VARBIND_SIZE)
+      continue;
+    for(j = 0; j < record.varBindListLen; j++)
+      record.varBindList[j] = ReadEEPROM_Byte(address + offsetof(SnmpAlarmInformRecord, varBindList) + j);
+
+    //The alarm is sent again as soon as a link is up, its latency is counted
+    //from this boot
+    entry = &snmpAlarmInformQueue[i];
+    entry->used = TRUE;
+    entry->stored = TRUE;
+    entry->requestId = record.requestId;
+    entry->specificTrapCode = record.specificTrapCode;
+    memcpy(entry->varBindList, record.varBindList, record.varBindListLen);
+    entry->varBindListLen = record.varBindListLen;
+    entry->enqueueTime = osGetSystemTime();
+    entry->timestamp = entry->enqueueTime;
+    privateMibBase.informGroup.informQueueLength++;
+
+    //Debug message
+    TRACE_INFO("SNMP inform %u reloaded from EEPROM\r\n", entry->specificTrapCode);
+  }
+}
+
+/**
+* @brief Save the queue changes to EEPROM
+*
+* The alarms queued since the last call are written, the entries of the
+* acknowledged or dropped ones are freed
+**/
+static void SnmpAlarmInformSave(void)
+{
+  uint_t i;
+  SnmpAlarmInformEntry entry;
+
+  for(i = 0; i < SNMP_ALARM_INFORM_QUEUE_SIZE; i++)
+  {
+    osAcquireMutex(&snmpAlarmInformMutex);
+    entry = snmpAlarmInformQueue[i];
+    osReleaseMutex(&snmpAlarmInformMutex);
+
+    if(entry.used && entry.dirty)
+    {
+      SnmpAlarmInformStore(i, &entry);
+
+      osAcquireMutex(&snmpAlarmInformMutex);
+      snmpAlarmInformQueue[i].stored = TRUE;
+      //The alarm may have been replaced meanwhile
+      if(snmpAlarmInformQueue[i].used && snmpAlarmInformQueue[i].requestId == entry.requestId)
+        snmpAlarmInformQueue[i].dirty = FALSE;
+      osReleaseMutex(&snmpAlarmInformMutex);
+    }
+    else if(!entry.used && entry.stored)
+    {
+      SnmpAlarmInformWriteByte(i, 0, SNMP_ALARM_INFORM_RECORD_FREE);
+
+      osAcquireMutex(&snmpAlarmInformMutex);
+      //A new alarm in this entry is dirty and gets written by the next call
+      snmpAlarmInformQueue[i].stored = FALSE;
+      osReleaseMutex(&snmpAlarmInformMutex);
+    }
+  }
+}
+
+/**
+* @brief Initialize the retransmit queue
+*
+* Must be called before the scheduler starts, the alarms left in EEPROM by
+* the previous run are queued again
+*
+* @return Error code
+**/
+error_t SnmpAlarmInformInit(void)
+{
+  memset(snmpAlarmInformQueue, 0, sizeof(snmpAlarmInformQueue));
+  //Start with a random request identifier so that a reboot does not
+  //reuse identifiers the manager may still be acknowledging
+  snmpAlarmInformRequestId = rand() & 0x7FFFFFFF;
+  if(!osCreateMutex(&snmpAlarmInformMutex))
+    return ERROR_OUT_OF_RESOURCES;
+  SnmpAlarmInformLoad();
+  return NO_ERROR;
+}
+
+/**
+* @brief Queue an alarm until it is acknowledged
+* @param[in] context SNMP agent context, used to encode the variable bindings
+* @param[in] specificTrapCode Specific trap code
+* @param[in] varBindList Objects of the alarm, those without a value take
+*   the current value of the object in the MIB
+* @param[in] varBindListSize Number of entries in the list
+* @return Error code
+**/
+error_t SnmpAlarmInformEnqueue(SnmpAgentContext *context, uint_t specificTrapCode,
+                               const SnmpVarBind *varBindList, uint_t varBindListSize)
+{
+  uint_t i;
+  error_t error;
+  uint8_t buffer[SNMP_ALARM_INFORM_VARBIND_SIZE];
+  size_t length;
+  SnmpAlarmInformEntry *entry;
+
+  if(varBindListSize > SNMP_ALARM_INFORM_MAX_OBJECTS)
+    return ERROR_INVALID_PARAMETER;
+
+  //Capture the values now, outside of the queue mutex since the agent
+  //mutex is taken
+  error = snmpAgentFormatVarBindingList(context, varBindList, varBindListSize,
+                                        buffer, sizeof(buffer), &length);
+  if(error)
+  {
+    TRACE_ERROR("SNMP inform %u cannot be encoded (%d)\r\n", specificTrapCode, error);
+    return error;
+  }
+
+  osAcquireMutex(&snmpAlarmInformMutex);
+
+  //Look for a free slot, or the oldest alarm if the queue is full
+  entry = &snmpAlarmInformQueue[0];
+  for(i = 0; i < SNMP_ALARM_INFORM_QUEUE_SIZE; i++)
+  {
+    if(!snmpAlarmInformQueue[i].used)
+    {
+      entry = &snmpAlarmInformQueue[i];
+      break;
+    }
+    if(timeCompare(snmpAlarmInformQueue[i].enqueueTime, entry->enqueueTime) < 0)
+      entry = &snmpAlarmInformQueue[i];
+  }
+
+  if(entry->used)
+  {
+    TRACE_ERROR("SNMP inform queue full, alarm %u dropped\r\n", entry->specificTrapCode);
+    privateMibBase.informGroup.informDropCount++;
+  }
+  else
+  {
+    privateMibBase.informGroup.informQueueLength++;
+  }
+
+  entry->used = TRUE;
+  entry->dirty = TRUE;
+  entry->requestId = snmpAlarmInformRequestId++;
+  //Wrap around if necessary
+  if(snmpAlarmInformRequestId < 0)
+    snmpAlarmInformRequestId = 0;
+  entry->specificTrapCode = specificTrapCode;
+  memcpy(entry->varBindList, buffer, length);
+  entry->varBindListLen = length;
+  entry->retransmitCount = 0;
+  entry->enqueueTime = osGetSystemTime();
+  //Send as soon as possible
+  entry->timestamp = entry->enqueueTime;
+  entry->timeout = 0;
+
+  osReleaseMutex(&snmpAlarmInformMutex);
+  return NO_ERROR;
+}
+
+/**
+* @brief Send the alarms whose retransmission timer has expired
+* @param[in] context SNMP agent context
+* @param[in] interfaces Links the alarms are sent on
+* @param[in] interfaceCount Number of links
+* @param[in] destIpAddr IP address of the manager
+* @param[in] community Community string
+**/
+static void SnmpAlarmInformSend(SnmpAgentContext *context, NetInterface *const *interfaces,
+                                uint_t interfaceCount, const IpAddr *destIpAddr,
+                                const char_t *community)
+{
+  uint_t i;
+  uint_t j;
+  error_t error;
+  systime_t time;
+  SnmpAlarmInformEntry entry;
+
+  for(i = 0; i < SNMP_ALARM_INFORM_QUEUE_SIZE; i++)
+  {
+    time = osGetSystemTime();
+
+    osAcquireMutex(&snmpAlarmInformMutex);
+    if(!snmpAlarmInformQueue[i].used ||
+       timeCompare(time, snmpAlarmInformQueue[i].timestamp + snmpAlarmInformQueue[i].timeout) < 0)
+    {
+      osReleaseMutex(&snmpAlarmInformMutex);
+      continue;
+    }
+    //Work on a copy, the agent mutex must not be taken while holding the
+    //queue mutex since the acknowledgment callback runs the other way round
+    entry = snmpAlarmInformQueue[i];
+    osReleaseMutex(&snmpAlarmInformMutex);
+
+    //Sent as soon as one link takes the message
+    error = ERROR_FAILURE;
+    for(j = 0; j < interfaceCount; j++)
+    {
+      snmpAgentSetTrapInterface(context, interfaces[j]);
+      if(!snmpAgentSendInform(context, destIpAddr, SNMP_VERSION_2C, community,
+                              SNMP_TRAP_ENTERPRISE_SPECIFIC, entry.specificTrapCode,
+                              entry.varBindList, entry.varBindListLen, entry.requestId))
+        error = NO_ERROR;
+    }
+
+    osAcquireMutex(&snmpAlarmInformMutex);
+    //Make sure the entry has not been acknowledged or replaced meanwhile
+    if(snmpAlarmInformQueue[i].used && snmpAlarmInformQueue[i].requestId == entry.requestId)
+    {
+      snmpAlarmInformQueue[i].timestamp = time;
+      //Only this manager may acknowledge the alarm
+      snmpAlarmInformQueue[i].destIpAddr = *destIpAddr;
+      if(error)
+      {
+        //Retry at the initial rate until the message leaves the device
+        TRACE_ERROR("Failed to send SNMP inform %u!\r\n", entry.specificTrapCode);
+        snmpAlarmInformQueue[i].timeout = SNMP_ALARM_INFORM_INIT_TIMEOUT;
+      }
+      else if(snmpAlarmInformQueue[i].timeout == 0)
+      {
+        privateMibBase.informGroup.informSentCount++;
+        snmpAlarmInformQueue[i].timeout = SNMP_ALARM_INFORM_INIT_TIMEOUT;
+      }
+      else
+      {
+        //Exponential backoff
+        privateMibBase.informGroup.informRetryCount++;
+        snmpAlarmInformQueue[i].retransmitCount++;
+        snmpAlarmInformQueue[i].timeout = MIN(snmpAlarmInformQueue[i].timeout * 2,
+                                              SNMP_ALARM_INFORM_MAX_TIMEOUT);
+      }
+    }
+    osReleaseMutex(&snmpAlarmInformMutex);
+  }
+}
+
+/**
+* @brief Send pending alarms whose retransmission timer has expired
+*
+* Each alarm is sent on every given link with the same request identifier,
+* the first acknowledgment removes it from the queue. The queue changes are
+* then saved to EEPROM, also while no link is available
+*
+* @param[in] context SNMP agent context
+* @param[in] interfaces Links the alarms are sent on
+* @param[in] interfaceCount Number of links (0 if none is up)
+* @param[in] destIpAddr IP address of the manager
+* @param[in] community Community string, the one of the traps
+**/
+void SnmpAlarmInformProcess(SnmpAgentContext *context, NetInterface *const *interfaces,
+                            uint_t interfaceCount, const IpAddr *destIpAddr,
+                            const char_t *community)
+{
+  //Alarms stay queued while no link is available
+  if(context != NULL && interfaceCount > 0)
+    SnmpAlarmInformSend(context, interfaces, interfaceCount, destIpAddr, community);
+
+  SnmpAlarmInformSave();
+}
+
+/**
+* @brief Remove an alarm from the queue once the manager acknowledged it
+*
+* Only a GetResponse-PDU from the manager the alarm was sent to counts. One
+* that carries an error status ends the alarm too, since the manager would
+* answer a retransmission the same way, but the alarm is counted as dropped
+* @param[in] remoteIpAddr IP address of the manager
+* @param[in] requestId Request identifier of the GetResponse-PDU
+* @param[in] errorStatus Error status of the GetResponse-PDU
+**/
+void SnmpAlarmInformAckCallback(const IpAddr *remoteIpAddr,
+                                int32_t requestId, uint_t errorStatus)
+{
+  uint_t i;
+  systime_t latency;
+
+  osAcquireMutex(&snmpAlarmInformMutex);
+  for(i = 0; i < SNMP_ALARM_INFORM_QUEUE_SIZE; i++)
+  {
+    if(snmpAlarmInformQueue[i].used && snmpAlarmInformQueue[i].requestId == requestId &&
+       remoteIpAddr->length == snmpAlarmInformQueue[i].destIpAddr.length &&
+       !memcmp(&remoteIpAddr->ipv4Addr, &snmpAlarmInformQueue[i].destIpAddr.ipv4Addr, remoteIpAddr->length))
+    {
+      latency = osGetSystemTime() - snmpAlarmInformQueue[i].enqueueTime;
+
+      if(errorStatus != SNMP_ERROR_NONE)
+      {
+        TRACE_ERROR("SNMP inform %u rejected by %s (status %u), alarm dropped\r\n",
+                    snmpAlarmInformQueue[i].specificTrapCode, ipAddrToString(remoteIpAddr, NULL),
+                    errorStatus);
+        privateMibBase.informGroup.informDropCount++;
+      }
+      else
+      {
+        TRACE_INFO("SNMP inform %u acknowledged by %s (%u retries, %u ms)\r\n",
+                   snmpAlarmInformQueue[i].specificTrapCode, ipAddrToString(remoteIpAddr, NULL),
+                   snmpAlarmInformQueue[i].retransmitCount, latency);
+
+        privateMibBase.informGroup.informAckCount++;
+        privateMibBase.informGroup.informLastLatency = latency;
+        if(latency > privateMibBase.informGroup.informMaxLatency)
+          privateMibBase.informGroup.informMaxLatency = latency;
+      }
+      privateMibBase.informGroup.informQueueLength--;
+
+      snmpAlarmInformQueue[i].used = FALSE;
+      break;
+    }
+  }
+  osReleaseMutex(&snmpAlarmInformMutex);
+}
+#endif //(USERDEF_CLIENT_SNMP == ENABLED && USERDEF_SNMP_ALARM_INFORM == ENABLED)
@@ -0,0 +1,86 @@
+/**
+* @file snmp_alarm_inform.h
+* @brief Alarm delivery using SNMP InformRequest
+*
+* @section License
+* ^^(^____^)^^
+*
+**/
+
+#ifndef __SNMP_ALARM_INFORM_H
+#define __SNMP_ALARM_INFORM_H
+
+#include "net_config.h"
+#include "core/net.h"
+#include "snmp/snmp_agent.h"
+
+//Maximum number of unacknowledged alarms kept in the retransmit queue
+#ifndef SNMP_ALARM_INFORM_QUEUE_SIZE
+#define SNMP_ALARM_INFORM_QUEUE_SIZE    16
+#endif
+//Maximum number of objects carried by an alarm
+#ifndef SNMP_ALARM_INFORM_MAX_OBJECTS
+#define SNMP_ALARM_INFORM_MAX_OBJECTS   3
+#endif
+//Size of the encoded variable bindings of an alarm (bytes)
+#ifndef SNMP_ALARM_INFORM_VARBIND_SIZE
+#define SNMP_ALARM_INFORM_VARBIND_SIZE  112
+#endif
+//Initial retransmission timeout (ms)
+#ifndef SNMP_ALARM_INFORM_INIT_TIMEOUT
+#define SNMP_ALARM_INFORM_INIT_TIMEOUT  2000
+#endif
+//Upper bound of the retransmission timeout (ms)
+#ifndef SNMP_ALARM_INFORM_MAX_TIMEOUT
+#define SNMP_ALARM_INFORM_MAX_TIMEOUT   64000
+#endif
+//Size of one queue entry in EEPROM
+#define SNMP_ALARM_INFORM_RECORD_SIZE   128
+//State of an EEPROM entry holding an unacknowledged alarm, any other value
+//marks a free entry
+#define SNMP_ALARM_INFORM_RECORD_PENDING 0x5A
+#define SNMP_ALARM_INFORM_RECORD_FREE   0x00
+
+/**
+* @brief Queue entry, as stored in EEPROM
+**/
+typedef struct
+{
+  uint8_t state;
+  uint8_t varBindListLen;
+  uint16_t specificTrapCode;
+  int32_t requestId;
+  uint8_t varBindList[SNMP_ALARM_INFORM_VARBIND_SIZE];
+} SnmpAlarmInformRecord;
+
+/**
+* @brief Retransmit queue entry
+**/
+typedef struct
+{
+  bool_t used;
+  bool_t dirty;                                         ///<Not saved to EEPROM yet
+  bool_t stored;                                        ///<The EEPROM entry may be pending
+  int32_t requestId;
+  IpAddr destIpAddr;                                    ///<Manager the alarm was last sent to
+  uint_t specificTrapCode;
+  uint8_t varBindList[SNMP_ALARM_INFORM_VARBIND_SIZE];
+  size_t varBindListLen;
+  uint_t retransmitCount;
+  systime_t enqueueTime;
+  systime_t timestamp;
+  systime_t timeout;
+} SnmpAlarmInformEntry;
+
+//=======================================
+//Function declearation
+//=======================================
+error_t SnmpAlarmInformInit(void);
+error_t SnmpAlarmInformEnqueue(SnmpAgentContext *context, uint_t specificTrapCode,
+                               const SnmpVarBind *varBindList, uint_t varBindListSize);
+void SnmpAlarmInformProcess(SnmpAgentContext *context, NetInterface *const *interfaces,
+                            uint_t interfaceCount, const IpAddr *destIpAddr,
+                            const char_t *community);
+void SnmpAlarmInformAckCallback(const IpAddr *remoteIpAddr,
+                                int32_t requestId, uint_t errorStatus);
+#endif
@@ -1,4 +1,5 @@
 #include <stdlib.h>
+#include <stddef.h>
 #include "net_config.h"
 #include "FreeRTOS.h"
 #include "task.h"
@@ -6,6 +7,7 @@
 #include "mibs/mib2_module.h"
 #include "mibs/mib2_impl.h"
 #include "oid.h"
+#include "asn1.h"
 #include "private_mib_module.h"
 #include "private_mib_impl.h"
 #include "debug.h"
@@ -14,14 +16,20 @@
 #include "core/net.h"
 #include "snmp_client.h"
 #include "snmpConnect_manager.h"
+#include "snmp_alarm_inform.h"
+#include "snmp_key_cache.h"
+#include "snmp_trap_limit.h"
+#include "data_usage.h"
 
 #if (USERDEF_CLIENT_SNMP == ENABLED)
 #define APP_SNMP_ENTERPRISE_OID "1.3.6.1.4.1.45796.1.16"//"1.3.6.1.4.1.8072.9999.9998"//
 #define APP_SNMP_CONTEXT_ENGINE "\x80\x00\x00\x00\x01\x02\x03\x04"
 #define APP_SNMP_TRAP_DEST_IP_ADDR "192.168.100.25"//"117.6.55.97"//
+//Community of the traps and informs sent to the manager
+#define APP_SNMP_TRAP_COMMUNITY "public"
 SnmpAgentSettings snmpAgentSettings;
-SnmpAgentContext ethernetSnmpAgentContext;
-SnmpAgentContext pppSnmpAgentContext;
+//Single agent serving both the Ethernet and the PPP interfaces
+SnmpAgentContext snmpAgentContext;
 size_t oidLen;
 uint8_t oid[SNMP_MAX_OID_SIZE];  
 #endif //(USERDEF_CLIENT_SNMP == ENABLED)
@@ -49,44 +57,102 @@ error_t snmpAgentRandCallback(uint8_t *data, size_t length)
 }
 
 
+/**
+* @brief Route notifications through the interface of their traffic class
+* @param[in] trafficClass Traffic class of the notifications
+* @return SNMP agent context (NULL if the class has no route)
+**/
+static SnmpAgentContext* SnmpGetTrapContext(traffic_class_t trafficClass)
+{
+  NetInterface *interface;
+  interface = interfaceManagerGetClassInterface(trafficClass);
+  if (interface == NULL)
+    return NULL;
+  snmpAgentSetTrapInterface(&snmpAgentContext, interface);
+  return &snmpAgentContext;
+}
+
+static void SnmpDeliverAlarm(SnmpAgentContext *context, const IpAddr *destIpAddr,
+                             SnmpVersion version, const char_t *username, uint_t genericTrapType,
+                             uint_t specificTrapCode, const SnmpVarBind *varBindList, uint_t varBindListSize)
+{
+#if (USERDEF_SNMP_ALARM_INFORM == ENABLED)
+  //Queue the alarm until the manager acknowledges it
+  SnmpAlarmInformEnqueue(&snmpAgentContext, specificTrapCode, varBindList, varBindListSize);
+#else
+  NetInterface *interfaces[CONNECT_MAX_LINKS];
+  uint8_t buffer[SNMP_ALARM_INFORM_VARBIND_SIZE];
+  size_t length;
+  uint_t i, n;
+  //Every link gets the same values
+  if (snmpAgentFormatVarBindingList(context, varBindList, varBindListSize,
+                                    buffer, sizeof(buffer), &length))
+    return;
+  //Send a SNMP trap on every link that is up
+  n = interfaceManagerGetClassInterfaces(TRAFFIC_CLASS_ALARM, interfaces);
+  for (i = 0; i < n; i++)
+  {
+    snmpAgentSetTrapInterface(context, interfaces[i]);
+    snmpAgentSendEncodedTrap(context, destIpAddr, version,
+                             username, genericTrapType, specificTrapCode, buffer, length);
+  }
+#endif
+}
+
 static void SnmpSendTrapType2(SnmpAgentContext *context, const IpAddr *destIpAddr,
                              SnmpVersion version, const char_t *username, uint_t genericTrapType,
                              uint_t specificTrapCode, const SnmpTrapObject *objectList, uint_t objectListSize ,
-                             uint32_t* pui32value_new, uint32_t* pui32value_old)
+                             uint32_t* pui32value_new, uint32_t* pui32value_old, uint_t alarmIndex)
 {  
+  SnmpVarBind varBindList[SNMP_ALARM_INFORM_MAX_OBJECTS];
+  uint_t i;
   //	trap_flag[number] = 0;
   if (*pui32value_new != *pui32value_old)
   {
-    //Send a SNMP trap
-    snmpAgentSendTrap(context, destIpAddr, version,
-                      username,genericTrapType , specificTrapCode, objectList, objectListSize); 
+    //Transitions beyond the destination budget go to the next summary
+    if (SnmpTrapLimitAdmit(destIpAddr, alarmIndex))
+    {
+      //The objects take their values from the MIB
+      for (i = 0; i < objectListSize && i < SNMP_ALARM_INFORM_MAX_OBJECTS; i++)
+      {
+        varBindList[i].oid = objectList[i].oid;
+        varBindList[i].oidLen = objectList[i].oidLen;
+        varBindList[i].value = NULL;
+      }
+      SnmpDeliverAlarm(context, destIpAddr, version, username, genericTrapType,
+                       specificTrapCode, varBindList, i);
+    }
     *pui32value_old = *pui32value_new;
   }
 }
 
 static void SnmpSendAlarmTrap(SnmpTrapObject* trapObjects, IpAddr destIpAddr)
 {
-  SnmpAgentContext* snmpAgentContext;
-  if (snmpConnectCheckStatus() == ETHERNET_CONNECTED)
-  {
-    snmpAgentContext = &ethernetSnmpAgentContext;
-  }
-  else if (snmpConnectCheckStatus() == GPRS_CONNECTED)
-  {
-    snmpAgentContext = &pppSnmpAgentContext;
-  }
-  else
+  PrivateMibAlarmGroup alarmGroup;
+  uint32_t alarmStates[SNMP_TRAP_LIMIT_ALARM_COUNT];
+  uint8_t summaryCounts[SNMP_TRAP_LIMIT_ALARM_COUNT];
+  uint8_t summaryStates[SNMP_TRAP_LIMIT_ALARM_COUNT];
+  SnmpVarBind summary[3];
+  SnmpAgentContext* context;
+  //Compare against a consistent copy of the alarm group
+  privateMibGetGroupSnapshot(&alarmGroup, offsetof(PrivateMibBase, alarmGroup),
+                             sizeof(PrivateMibAlarmGroup));
+  context = SnmpGetTrapContext(TRAFFIC_CLASS_ALARM);
+  //With informs, alarms are queued even when no link is available
+#if (USERDEF_SNMP_ALARM_INFORM == DISABLED)
+  if (context == NULL)
     return;
+#endif
   //Add the alarmSmokeAlarms.0 object to the variable binding list of the message
   oidFromString("1.3.6.1.4.1.45796.1.15.1.0", trapObjects[0].oid,
                 SNMP_MAX_OID_SIZE, &trapObjects[0].oidLen);
   //Add the siteInfoBTSCode.0 object to the variable binding list of the message
   oidFromString("1.3.6.1.4.1.45796.1.1.1.0", trapObjects[1].oid,
                 SNMP_MAX_OID_SIZE, &trapObjects[1].oidLen);
-  SnmpSendTrapType2(snmpAgentContext, &destIpAddr,SNMP_VERSION_2C,
-                    "public", SNMP_TRAP_ENTERPRISE_SPECIFIC,1, trapObjects, 2,                             
-                    &privateMibBase.alarmGroup.alarmFireAlarms, 
-                    &privateMibBase.alarmGroup.alarmFireAlarms_old);
+  SnmpSendTrapType2(context, &destIpAddr,SNMP_VERSION_2C,
+                    APP_SNMP_TRAP_COMMUNITY, SNMP_TRAP_ENTERPRISE_SPECIFIC,1, trapObjects, 2,                             
+                    &alarmGroup.alarmFireAlarms, 
+                    &privateMibBase.alarmGroup.alarmFireAlarms_old, 1);
   
   //Add the alarmSmokeAlarms.0 object to the variable binding list of the message
   oidFromString("1.3.6.1.4.1.45796.1.15.2.0", trapObjects[1].oid,
@@ -94,10 +160,10 @@ static void SnmpSendAlarmTrap(SnmpTrapObject* trapObjects, IpAddr destIpAddr)
   //Add the siteInfoBTSCode.0 object to the variable binding list of the message
   oidFromString("1.3.6.1.4.1.45796.1.1.1.0", trapObjects[0].oid,
                 SNMP_MAX_OID_SIZE, &trapObjects[1].oidLen);
-  SnmpSendTrapType2(snmpAgentContext, &destIpAddr,SNMP_VERSION_2C,
-                    "public", SNMP_TRAP_ENTERPRISE_SPECIFIC,2, trapObjects, 2,                              
-                    &privateMibBase.alarmGroup.alarmSmokeAlarms, 
-                    &privateMibBase.alarmGroup.alarmSmokeAlarms_old);
+  SnmpSendTrapType2(context, &destIpAddr,SNMP_VERSION_2C,
+                    APP_SNMP_TRAP_COMMUNITY, SNMP_TRAP_ENTERPRISE_SPECIFIC,2, trapObjects, 2,                              
+                    &alarmGroup.alarmSmokeAlarms, 
+                    &privateMibBase.alarmGroup.alarmSmokeAlarms_old, 2);
   
   //Add the alarmMotionDetectAlarms.0 object to the variable binding list of the message
   oidFromString("1.3.6.1.4.1.45796.1.15.3.0", trapObjects[0].oid,
@@ -105,10 +171,10 @@ static void SnmpSendAlarmTrap(SnmpTrapObject* trapObjects, IpAddr destIpAddr)
   //Add the siteInfoBTSCode.0 object to the variable binding list of the message
   oidFromString("1.3.6.1.4.1.45796.1.1.1.0", trapObjects[1].oid,
                 SNMP_MAX_OID_SIZE, &trapObjects[1].oidLen);       
-  SnmpSendTrapType2(snmpAgentContext, &destIpAddr,SNMP_VERSION_2C,
-                    "public", SNMP_TRAP_ENTERPRISE_SPECIFIC,3, trapObjects, 2,                             
-                    &privateMibBase.alarmGroup.alarmMotionDetectAlarms, 
-                    &privateMibBase.alarmGroup.alarmMotionDetectAlarms_old);
+  SnmpSendTrapType2(context, &destIpAddr,SNMP_VERSION_2C,
+                    APP_SNMP_TRAP_COMMUNITY, SNMP_TRAP_ENTERPRISE_SPECIFIC,3, trapObjects, 2,                             
+                    &alarmGroup.alarmMotionDetectAlarms, 
+                    &privateMibBase.alarmGroup.alarmMotionDetectAlarms_old, 3);
   
   //Add the alarmFloodDetectAlarms.0 object to the variable binding list of the message
   oidFromString("1.3.6.1.4.1.45796.1.15.4.0", trapObjects[0].oid,
@@ -116,10 +182,10 @@ static void SnmpSendAlarmTrap(SnmpTrapObject* trapObjects, IpAddr destIpAddr)
   //Add the siteInfoBTSCode.0 object to the variable binding list of the message
   oidFromString("1.3.6.1.4.1.45796.1.1.1.0", trapObjects[1].oid,
                 SNMP_MAX_OID_SIZE, &trapObjects[1].oidLen);
-  SnmpSendTrapType2(snmpAgentContext, &destIpAddr,SNMP_VERSION_2C,
-                    "public", SNMP_TRAP_ENTERPRISE_SPECIFIC,4, trapObjects, 2,                             
-                    &privateMibBase.alarmGroup.alarmFloodDetectAlarms, 
-                    &privateMibBase.alarmGroup.alarmFloodDetectAlarms_old);
+  SnmpSendTrapType2(context, &destIpAddr,SNMP_VERSION_2C,
+                    APP_SNMP_TRAP_COMMUNITY, SNMP_TRAP_ENTERPRISE_SPECIFIC,4, trapObjects, 2,                             
+                    &alarmGroup.alarmFloodDetectAlarms, 
+                    &privateMibBase.alarmGroup.alarmFloodDetectAlarms_old, 4);
   
   //Add the alarmDoorOpenAlarms.0 object to the variable binding list of the message
   oidFromString("1.3.6.1.4.1.45796.1.15.5.0", trapObjects[0].oid,
@@ -127,10 +193,10 @@ static void SnmpSendAlarmTrap(SnmpTrapObject* trapObjects, IpAddr destIpAddr)
   //Add the siteInfoBTSCode.0 object to the variable binding list of the message
   oidFromString("1.3.6.1.4.1.45796.1.1.1.0", trapObjects[1].oid,
                 SNMP_MAX_OID_SIZE, &trapObjects[1].oidLen);
-  SnmpSendTrapType2(snmpAgentContext, &destIpAddr,SNMP_VERSION_2C,
-                    "public", SNMP_TRAP_ENTERPRISE_SPECIFIC,5, trapObjects, 2,
-                    &privateMibBase.alarmGroup.alarmDoorOpenAlarms, 
-                    &privateMibBase.alarmGroup.alarmDoorOpenAlarms_old);
+  SnmpSendTrapType2(context, &destIpAddr,SNMP_VERSION_2C,
+                    APP_SNMP_TRAP_COMMUNITY, SNMP_TRAP_ENTERPRISE_SPECIFIC,5, trapObjects, 2,
+                    &alarmGroup.alarmDoorOpenAlarms, 
+                    &privateMibBase.alarmGroup.alarmDoorOpenAlarms_old, 5);
   
   //Add the alarmGenFailureAlarms.0 object to the variable binding list of the message
   oidFromString("1.3.6.1.4.1.45796.1.15.6.0", trapObjects[0].oid,
@@ -138,10 +204,10 @@ static void SnmpSendAlarmTrap(SnmpTrapObject* trapObjects, IpAddr destIpAddr)
   //Add the siteInfoBTSCode.0 object to the variable binding list of the message
   oidFromString("1.3.6.1.4.1.45796.1.1.1.0", trapObjects[1].oid,
                 SNMP_MAX_OID_SIZE, &trapObjects[1].oidLen); 
-  SnmpSendTrapType2(snmpAgentContext, &destIpAddr,SNMP_VERSION_2C,
-                    "public", SNMP_TRAP_ENTERPRISE_SPECIFIC,6, trapObjects, 2,
-                    &privateMibBase.alarmGroup.alarmGenFailureAlarms, 
-                    &privateMibBase.alarmGroup.alarmGenFailureAlarms_old);
+  SnmpSendTrapType2(context, &destIpAddr,SNMP_VERSION_2C,
+                    APP_SNMP_TRAP_COMMUNITY, SNMP_TRAP_ENTERPRISE_SPECIFIC,6, trapObjects, 2,
+                    &alarmGroup.alarmGenFailureAlarms, 
+                    &privateMibBase.alarmGroup.alarmGenFailureAlarms_old, 6);
   
   //Add the alarmDcThresAlarms.0 object to the variable binding list of the message
   oidFromString("1.3.6.1.4.1.45796.1.15.7.0", trapObjects[0].oid,
@@ -149,10 +215,10 @@ static void SnmpSendAlarmTrap(SnmpTrapObject* trapObjects, IpAddr destIpAddr)
   //Add the siteInfoBTSCode.0 object to the variable binding list of the message
   oidFromString("1.3.6.1.4.1.45796.1.1.1.0", trapObjects[1].oid,
                 SNMP_MAX_OID_SIZE, &trapObjects[1].oidLen);  
-  SnmpSendTrapType2(snmpAgentContext, &destIpAddr,SNMP_VERSION_2C,
-                    "public", SNMP_TRAP_ENTERPRISE_SPECIFIC,7, trapObjects, 2,
-                    &privateMibBase.alarmGroup.alarmDcThresAlarms, 
-                    &privateMibBase.alarmGroup.alarmDcThresAlarms_old);
+  SnmpSendTrapType2(context, &destIpAddr,SNMP_VERSION_2C,
+                    APP_SNMP_TRAP_COMMUNITY, SNMP_TRAP_ENTERPRISE_SPECIFIC,7, trapObjects, 2,
+                    &alarmGroup.alarmDcThresAlarms, 
+                    &privateMibBase.alarmGroup.alarmDcThresAlarms_old, 7);
   
   //Add the alarmMachineStopAlarms.0 object to the variable binding list of the message
   oidFromString("1.3.6.1.4.1.45796.1.15.8.0", trapObjects[0].oid,
@@ -160,10 +226,10 @@ static void SnmpSendAlarmTrap(SnmpTrapObject* trapObjects, IpAddr destIpAddr)
   //Add the siteInfoBTSCode.0 object to the variable binding list of the message
   oidFromString("1.3.6.1.4.1.45796.1.1.1.0", trapObjects[1].oid,
                 SNMP_MAX_OID_SIZE, &trapObjects[1].oidLen);  
-  SnmpSendTrapType2(snmpAgentContext, &destIpAddr,SNMP_VERSION_2C,
-                    "public", SNMP_TRAP_ENTERPRISE_SPECIFIC,8, trapObjects, 2,
-                    &privateMibBase.alarmGroup.alarmMachineStopAlarms, 
-                    &privateMibBase.alarmGroup.alarmMachineStopAlarms_old);
+  SnmpSendTrapType2(context, &destIpAddr,SNMP_VERSION_2C,
+                    APP_SNMP_TRAP_COMMUNITY, SNMP_TRAP_ENTERPRISE_SPECIFIC,8, trapObjects, 2,
+                    &alarmGroup.alarmMachineStopAlarms, 
+                    &privateMibBase.alarmGroup.alarmMachineStopAlarms_old, 8);
   
    //Add the alarmAcThresAlarms.0 object to the variable binding list of the message
   oidFromString("1.3.6.1.4.1.45796.1.15.9.0", trapObjects[0].oid,
@@ -171,10 +237,10 @@ static void SnmpSendAlarmTrap(SnmpTrapObject* trapObjects, IpAddr destIpAddr)
   //Add the siteInfoBTSCode.0 object to the variable binding list of the message
   oidFromString("1.3.6.1.4.1.45796.1.1.1.0", trapObjects[1].oid,
                 SNMP_MAX_OID_SIZE, &trapObjects[1].oidLen);  
-  SnmpSendTrapType2(snmpAgentContext, &destIpAddr,SNMP_VERSION_2C,
-                    "public", SNMP_TRAP_ENTERPRISE_SPECIFIC,9, trapObjects, 2,
-                    &privateMibBase.alarmGroup.alarmAcThresAlarms, 
-                    &privateMibBase.alarmGroup.alarmAcThresAlarms_old);
+  SnmpSendTrapType2(context, &destIpAddr,SNMP_VERSION_2C,
+                    APP_SNMP_TRAP_COMMUNITY, SNMP_TRAP_ENTERPRISE_SPECIFIC,9, trapObjects, 2,
+                    &alarmGroup.alarmAcThresAlarms, 
+                    &privateMibBase.alarmGroup.alarmAcThresAlarms_old, 9);
   
 //Add the alarmAccessAlarms.0 object to the variable binding list of the message
   oidFromString("1.3.6.1.4.1.45796.1.15.10.0", trapObjects[0].oid,
@@ -185,26 +251,57 @@ static void SnmpSendAlarmTrap(SnmpTrapObject* trapObjects, IpAddr destIpAddr)
   //Add the siteInfoBTSCode.0 object to the variable binding list of the message
   oidFromString("1.3.6.1.4.1.45796.1.1.1.0", trapObjects[2].oid,
                 SNMP_MAX_OID_SIZE, &trapObjects[2].oidLen);  
-  SnmpSendTrapType2(snmpAgentContext, &destIpAddr,SNMP_VERSION_2C,
-                    "public", SNMP_TRAP_ENTERPRISE_SPECIFIC,9, trapObjects, 3,
-                    &privateMibBase.alarmGroup.alarmAccessAlarms, 
-                    &privateMibBase.alarmGroup.alarmAccessAlarms_old);  
+  SnmpSendTrapType2(context, &destIpAddr,SNMP_VERSION_2C,
+                    APP_SNMP_TRAP_COMMUNITY, SNMP_TRAP_ENTERPRISE_SPECIFIC,9, trapObjects, 3,
+                    &alarmGroup.alarmAccessAlarms, 
+                    &privateMibBase.alarmGroup.alarmAccessAlarms_old, 10);  
+  
+  //Report the transitions held back by the rate limiter
+  alarmStates[0] = alarmGroup.alarmFireAlarms;
+  alarmStates[1] = alarmGroup.alarmSmokeAlarms;
+  alarmStates[2] = alarmGroup.alarmMotionDetectAlarms;
+  alarmStates[3] = alarmGroup.alarmFloodDetectAlarms;
+  alarmStates[4] = alarmGroup.alarmDoorOpenAlarms;
+  alarmStates[5] = alarmGroup.alarmGenFailureAlarms;
+  alarmStates[6] = alarmGroup.alarmDcThresAlarms;
+  alarmStates[7] = alarmGroup.alarmMachineStopAlarms;
+  alarmStates[8] = alarmGroup.alarmAcThresAlarms;
+  alarmStates[9] = alarmGroup.alarmAccessAlarms;
+  if (SnmpTrapLimitTakeSummary(&destIpAddr, alarmStates, summaryCounts, summaryStates))
+  {
+    //The counts and states of this summary travel with it, a later summary
+    //does not change them
+    //Add the trapLimitSummaryCounts.0 object to the variable binding list of the message
+    oidFromString("1.3.6.1.4.1.45796.1.19.4.0", trapObjects[0].oid,
+                  SNMP_MAX_OID_SIZE, &trapObjects[0].oidLen);
+    summary[0].oid = trapObjects[0].oid;
+    summary[0].oidLen = trapObjects[0].oidLen;
+    summary[0].objClass = ASN1_CLASS_UNIVERSAL;
+    summary[0].objType = ASN1_TYPE_OCTET_STRING;
+    summary[0].value = summaryCounts;
+    summary[0].valueLen = SNMP_TRAP_LIMIT_ALARM_COUNT;
+    //Add the trapLimitSummaryStates.0 object to the variable binding list of the message
+    oidFromString("1.3.6.1.4.1.45796.1.19.5.0", trapObjects[1].oid,
+                  SNMP_MAX_OID_SIZE, &trapObjects[1].oidLen);
+    summary[1].oid = trapObjects[1].oid;
+    summary[1].oidLen = trapObjects[1].oidLen;
+    summary[1].objClass = ASN1_CLASS_UNIVERSAL;
+    summary[1].objType = ASN1_TYPE_OCTET_STRING;
+    summary[1].value = summaryStates;
+    summary[1].valueLen = SNMP_TRAP_LIMIT_ALARM_COUNT;
+    //Add the siteInfoBTSCode.0 object to the variable binding list of the message
+    oidFromString("1.3.6.1.4.1.45796.1.1.1.0", trapObjects[2].oid,
+                  SNMP_MAX_OID_SIZE, &trapObjects[2].oidLen);
+    summary[2].oid = trapObjects[2].oid;
+    summary[2].oidLen = trapObjects[2].oidLen;
+    summary[2].value = NULL;
+    SnmpDeliverAlarm(context, &destIpAddr, SNMP_VERSION_2C, APP_SNMP_TRAP_COMMUNITY,
+                     SNMP_TRAP_ENTERPRISE_SPECIFIC, SNMP_TRAP_SUMMARY_CODE, summary, 3);
+  }
 }
 
-static void SnmpSendSiteInfoTrap(SnmpTrapObject* trapObjects, IpAddr destIpAddr)
+static uint_t SnmpAddSiteInfoObjects(SnmpTrapObject* trapObjects)
 {
-  error_t error;
-  SnmpAgentContext* snmpAgentContext;
-  if (snmpConnectCheckStatus() == ETHERNET_CONNECTED)
-  {
-    snmpAgentContext = &ethernetSnmpAgentContext;
-  }
-  else if (snmpConnectCheckStatus() == GPRS_CONNECTED)
-  {
-    snmpAgentContext = &pppSnmpAgentContext;
-  }
-  else
-    return;
   //============================= Site Info ============================================//
   //Add the siteInfoBTSCode.0 object to the variable binding list of the message
   oidFromString("1.3.6.1.4.1.45796.1.1.1.0", trapObjects[0].oid,
@@ -233,36 +330,11 @@ static void SnmpSendSiteInfoTrap(SnmpTrapObject* trapObjects, IpAddr destIpAddr)
   //Add the siteInfoBTSCode.0 object to the variable binding list of the message
   oidFromString("1.3.6.1.4.1.45796.1.1.1.0", trapObjects[8].oid,
                 SNMP_MAX_OID_SIZE, &trapObjects[8].oidLen);
-  
-  //Send a SNMP trap
-  error = snmpAgentSendTrap(snmpAgentContext, &destIpAddr, SNMP_VERSION_2C,
-                            "public",SNMP_TRAP_ENTERPRISE_SPECIFIC , 11, trapObjects, 9); //
-  //Failed to send trap message?
-  if(error)
-  {
-    //Debug message
-    TRACE_ERROR("Failed to send SNMP trap message 1!\r\n");
-  } else
-  {
-    //Debug message
-    TRACE_INFO("Trap result: %d\r\n", error);
-  }
+  return 9;
 }
 
-static void SnmpSendAcInfoTrap(SnmpTrapObject* trapObjects, IpAddr destIpAddr)
+static uint_t SnmpAddAcInfoObjects(SnmpTrapObject* trapObjects)
 {
-  error_t error;
-  SnmpAgentContext* snmpAgentContext;
-  if (snmpConnectCheckStatus() == ETHERNET_CONNECTED)
-  {
-    snmpAgentContext = &ethernetSnmpAgentContext;
-  }
-  else if (snmpConnectCheckStatus() == GPRS_CONNECTED)
-  {
-    snmpAgentContext = &pppSnmpAgentContext;
-  }
-  else
-    return;
   //============================= AC Info ============================================//
   //Add the acPhaseNumber.0 object to the variable binding list of the message
   oidFromString("1.3.6.1.4.1.45796.1.2.1.0", trapObjects[0].oid,
@@ -291,36 +363,11 @@ static void SnmpSendAcInfoTrap(SnmpTrapObject* trapObjects, IpAddr destIpAddr)
   //Add the siteInfoBTSCode.0 object to the variable binding list of the message
   oidFromString("1.3.6.1.4.1.45796.1.1.1.0", trapObjects[8].oid,
                 SNMP_MAX_OID_SIZE, &trapObjects[8].oidLen);
-  
-  //Send a SNMP trap
-  error = snmpAgentSendTrap(snmpAgentContext, &destIpAddr, SNMP_VERSION_2C,
-                            "public",SNMP_TRAP_ENTERPRISE_SPECIFIC , 12, trapObjects, 9); //
-  //Failed to send trap message?
-  if(error)
-  {
-    //Debug message
-    TRACE_ERROR("Failed to send SNMP trap message 2!\r\n");
-  } else
-  {
-    //Debug message
-    TRACE_INFO("Trap result: %d\r\n", error);
-  }
+  return 9;
 }
 
-static void SnmpSendBatteryInfoTrap(SnmpTrapObject* trapObjects, IpAddr destIpAddr)
+static uint_t SnmpAddBatteryInfoObjects(SnmpTrapObject* trapObjects)
 {
-  error_t error;
-  SnmpAgentContext* snmpAgentContext;
-  if (snmpConnectCheckStatus() == ETHERNET_CONNECTED)
-  {
-    snmpAgentContext = &ethernetSnmpAgentContext;
-  }
-  else if (snmpConnectCheckStatus() == GPRS_CONNECTED)
-  {
-    snmpAgentContext = &pppSnmpAgentContext;
-  }
-  else
-    return;
   //============================= Battery Info ============================================//
   //Add the battery1Voltage.0 object to the variable binding list of the message
   oidFromString("1.3.6.1.4.1.45796.1.3.1.0", trapObjects[0].oid,
@@ -343,36 +390,11 @@ static void SnmpSendBatteryInfoTrap(SnmpTrapObject* trapObjects, IpAddr destIpAd
   //Add the siteInfoBTSCode.0 object to the variable binding list of the message
   oidFromString("1.3.6.1.4.1.45796.1.1.1.0", trapObjects[6].oid,
                 SNMP_MAX_OID_SIZE, &trapObjects[6].oidLen);
-  
-  //Send a SNMP trap
-  error = snmpAgentSendTrap(snmpAgentContext, &destIpAddr, SNMP_VERSION_2C,
-                            "public",SNMP_TRAP_ENTERPRISE_SPECIFIC , 13, trapObjects, 7); //
-  //Failed to send trap message?
-  if(error)
-  {
-    //Debug message
-    TRACE_ERROR("Failed to send SNMP trap message 1!\r\n");
-  } else
-  {
-    //Debug message
-    TRACE_INFO("Trap result: %d\r\n", error);
-  }
+  return 7;
 }
 
-static void SnmpSendAccessoriesInfoTrap(SnmpTrapObject* trapObjects, IpAddr destIpAddr)
+static uint_t SnmpAddAccessoriesInfoObjects(SnmpTrapObject* trapObjects)
 {
-  error_t error;
-  SnmpAgentContext* snmpAgentContext;
-  if (snmpConnectCheckStatus() == ETHERNET_CONNECTED)
-  {
-    snmpAgentContext = &ethernetSnmpAgentContext;
-  }
-  else if (snmpConnectCheckStatus() == GPRS_CONNECTED)
-  {
-    snmpAgentContext = &pppSnmpAgentContext;
-  }
-  else
-    return;
   //============================= Accessories Info ============================================//
   //Add the airCon1Status.0 object to the variable binding list of the message
   oidFromString("1.3.6.1.4.1.45796.1.4.1.0", trapObjects[0].oid,
@@ -421,36 +443,12 @@ static void SnmpSendAccessoriesInfoTrap(SnmpTrapObject* trapObjects, IpAddr dest
                 SNMP_MAX_OID_SIZE, &trapObjects[14].oidLen);
   //Add the siteInfoBTSCode.0 object to the variable binding list of the message
   oidFromString("1.3.6.1.4.1.45796.1.1.1.0", trapObjects[15].oid,
-                SNMP_MAX_OID_SIZE, &trapObjects[15].oidLen);  
-  //Send a SNMP trap
-  error = snmpAgentSendTrap(snmpAgentContext, &destIpAddr, SNMP_VERSION_2C,
-                            "public",SNMP_TRAP_ENTERPRISE_SPECIFIC , 14, trapObjects, 16); //
-  //Failed to send trap message?
-  if(error)
-  {
-    //Debug message
-    TRACE_ERROR("Failed to send SNMP trap message 1!\r\n");
-  } else
-  {
-    //Debug message
-    TRACE_INFO("Trap result: %d\r\n", error);
-  }
+                SNMP_MAX_OID_SIZE, &trapObjects[15].oidLen);
+  return 16;
 }
 
-static void SnmpSendConfigurationInfoTrap(SnmpTrapObject* trapObjects, IpAddr destIpAddr)
+static uint_t SnmpAddConfigurationInfoObjects(SnmpTrapObject* trapObjects)
 {
-  error_t error;
-  SnmpAgentContext* snmpAgentContext;
-  if (snmpConnectCheckStatus() == ETHERNET_CONNECTED)
-  {
-    snmpAgentContext = &ethernetSnmpAgentContext;
-  }
-  else if (snmpConnectCheckStatus() == GPRS_CONNECTED)
-  {
-    snmpAgentContext = &pppSnmpAgentContext;
-  }
-  else
-    return;
   //============================= Configuration Info ============================================//
   //Add the configDevIPAddr.0 object to the variable binding list of the message
   oidFromString("1.3.6.1.4.1.45796.1.14.1.0", trapObjects[0].oid,
@@ -575,38 +573,11 @@ static void SnmpSendConfigurationInfoTrap(SnmpTrapObject* trapObjects, IpAddr de
   //Add the siteInfoBTSCode.0 object to the variable binding list of the message
   oidFromString("1.3.6.1.4.1.45796.1.1.1.0", trapObjects[38].oid,
                 SNMP_MAX_OID_SIZE, &trapObjects[38].oidLen);
-  
-  
-  
-  //Send a SNMP trap
-  error = snmpAgentSendTrap(snmpAgentContext, &destIpAddr, SNMP_VERSION_2C,
-                            "public",SNMP_TRAP_ENTERPRISE_SPECIFIC , 15, trapObjects, 39); //
-  //Failed to send trap message?
-  if(error)
-  {
-    //Debug message
-    TRACE_ERROR("Failed to send SNMP trap message 1!\r\n");
-  } else
-  {
-    //Debug message
-    TRACE_INFO("Trap result: %d\r\n", error);
-  }
+  return 39;
 }
 
-static void SnmpSendAlarmInfoTrap(SnmpTrapObject* trapObjects, IpAddr destIpAddr)
+static uint_t SnmpAddAlarmInfoObjects(SnmpTrapObject* trapObjects)
 {
-  error_t error;
-  SnmpAgentContext* snmpAgentContext;
-  if (snmpConnectCheckStatus() == ETHERNET_CONNECTED)
-  {
-    snmpAgentContext = &ethernetSnmpAgentContext;
-  }
-  else if (snmpConnectCheckStatus() == GPRS_CONNECTED)
-  {
-    snmpAgentContext = &pppSnmpAgentContext;
-  }
-  else
-    return;
   //============================= Alarm Info ============================================//
   //Add the battery1Voltage.0 object to the variable binding list of the message
   oidFromString("1.3.6.1.4.1.45796.1.15.1.0", trapObjects[0].oid,
@@ -638,39 +609,107 @@ static void SnmpSendAlarmInfoTrap(SnmpTrapObject* trapObjects, IpAddr destIpAddr
   //Add the siteInfoBTSCode.0 object to the variable binding list of the message
   oidFromString("1.3.6.1.4.1.45796.1.1.1.0", trapObjects[9].oid,
                 SNMP_MAX_OID_SIZE, &trapObjects[9].oidLen);
+  return 10;
+}
+
+static error_t SnmpSendInfoTrap(SnmpAgentContext *context, const IpAddr *destIpAddr,
+                                uint_t specificTrapCode, const SnmpTrapObject *trapObjects, uint_t n)
+{
+  error_t error;
   //Send a SNMP trap
-  error = snmpAgentSendTrap(snmpAgentContext, &destIpAddr, SNMP_VERSION_2C,
-                            "public",SNMP_TRAP_ENTERPRISE_SPECIFIC , 16, trapObjects, 10); //
-  //        osDelayTask(100);
+  error = snmpAgentSendTrap(context, destIpAddr, SNMP_VERSION_2C,
+                            APP_SNMP_TRAP_COMMUNITY,SNMP_TRAP_ENTERPRISE_SPECIFIC , specificTrapCode, trapObjects, n);
   //Failed to send trap message?
   if(error)
   {
     //Debug message
-    TRACE_ERROR("Failed to send SNMP trap message 1!\r\n");
+    TRACE_ERROR("Failed to send SNMP trap message %u!\r\n", specificTrapCode);
   } else
   {
     //Debug message
     TRACE_INFO("Trap result: %d\r\n", error);
   }
+  return error;
+}
+
+static void SnmpSendInfoTraps(SnmpTrapObject* trapObjects, IpAddr destIpAddr)
+{
+  static uint_t configInfoCycle = 0;
+  uint_t n;
+  error_t error;
+  SnmpAgentContext* context;
+  //Periodic status is telemetry, sent on the link with the lower round trip time
+  context = SnmpGetTrapContext(TRAFFIC_CLASS_TELEMETRY);
+  if (context == NULL)
+    return;
   trapStatus_TimePeriod = 0;
+#if (USERDEF_DATA_USAGE == ENABLED)
+  //Periodic status is given up first when the GPRS budget runs low, alarm
+  //traps and informs are not affected
+  if (dataUsageSuppressInfoTraps(context->trapInterface))
+    return;
+#endif
+  
+  if (context->trapInterface == GPRS_INTERFACE)
+  {
+    //Over GPRS every message pays its own headers and radio wake-up, so the
+    //periodic groups share one PDU. Each group ends with siteInfoBTSCode.0,
+    //which is overwritten by the next group and kept only once at the end
+    n = SnmpAddSiteInfoObjects(trapObjects) - 1;
+    n += SnmpAddAcInfoObjects(trapObjects + n) - 1;
+    n += SnmpAddBatteryInfoObjects(trapObjects + n) - 1;
+    n += SnmpAddAccessoriesInfoObjects(trapObjects + n) - 1;
+    n += SnmpAddAlarmInfoObjects(trapObjects + n);
+    error = SnmpSendInfoTrap(context, &destIpAddr, SNMP_TRAP_COMBINED_INFO_CODE, trapObjects, n);
+    if (!error)
+    {
+      privateMibBase.trapLimitGroup.trapLimitCombinedInfoCount++;
+      //The configuration seldom changes and is sent at a lower rate
+      if ((configInfoCycle++ % SNMP_TRAP_CONFIG_INFO_DIVIDER) == 0)
+      {
+        n = SnmpAddConfigurationInfoObjects(trapObjects);
+        SnmpSendInfoTrap(context, &destIpAddr, 15, trapObjects, n);
+      }
+      return;
+    }
+    //The combined PDU does not fit, fall back to one trap per group
+  }
+  
+  n = SnmpAddSiteInfoObjects(trapObjects);
+  SnmpSendInfoTrap(context, &destIpAddr, 11, trapObjects, n);
+  n = SnmpAddAcInfoObjects(trapObjects);
+  SnmpSendInfoTrap(context, &destIpAddr, 12, trapObjects, n);
+  n = SnmpAddBatteryInfoObjects(trapObjects);
+  SnmpSendInfoTrap(context, &destIpAddr, 13, trapObjects, n);
+  n = SnmpAddAccessoriesInfoObjects(trapObjects);
+  SnmpSendInfoTrap(context, &destIpAddr, 14, trapObjects, n);
+  n = SnmpAddConfigurationInfoObjects(trapObjects);
+  SnmpSendInfoTrap(context, &destIpAddr, 15, trapObjects, n);
+  n = SnmpAddAlarmInfoObjects(trapObjects);
+  SnmpSendInfoTrap(context, &destIpAddr, 16, trapObjects, n);
 }
 
 static void SnmpSendTrap(void)
 {
     IpAddr destIpAddr;
     SnmpTrapObject trapObjects[65];
+#if (USERDEF_SNMP_ALARM_INFORM == ENABLED)
+    NetInterface *interfaces[CONNECT_MAX_LINKS];
+    uint_t n;
+#endif
     //Destination IP address
     ipStringToAddr((const char_t*)sMenu_Variable.ucSIP, &destIpAddr);  
     SnmpSendAlarmTrap(trapObjects, destIpAddr);
+#if (USERDEF_SNMP_ALARM_INFORM == ENABLED)
+    //Send pending alarms on every link that is up
+    n = interfaceManagerGetClassInterfaces(TRAFFIC_CLASS_ALARM, interfaces);
+    SnmpAlarmInformProcess(&snmpAgentContext, interfaces, n, &destIpAddr,
+                           APP_SNMP_TRAP_COMMUNITY);
+#endif
 #if (USERDEF_NO_TRAP_INFO_UPDATE_TEST == DISABLED)
     if (trapStatus_TimePeriod >= 30)
     {        
-        SnmpSendSiteInfoTrap(trapObjects, destIpAddr);
-        SnmpSendAcInfoTrap(trapObjects, destIpAddr);
-        SnmpSendBatteryInfoTrap(trapObjects, destIpAddr);
-        SnmpSendAccessoriesInfoTrap(trapObjects, destIpAddr);
-	SnmpSendConfigurationInfoTrap(trapObjects, destIpAddr);
-        SnmpSendAlarmInfoTrap(trapObjects, destIpAddr);
+        SnmpSendInfoTraps(trapObjects, destIpAddr);
     }    
 #endif
     //	//Add the ifNum object to the variable binding list of the message
@@ -714,34 +753,40 @@ void SnmpInitMib()
     //Debug message
     TRACE_ERROR("Failed to initialize MIB!\r\n");
   }
+  //Trap rate limiter initialization
+  SnmpTrapLimitInit();
+#if (USERDEF_SNMP_ALARM_INFORM == ENABLED)
+  //Alarm retransmit queue initialization
+  error = SnmpAlarmInformInit();
+  //Any error to report?
+  if(error)
+  {
+    //Debug message
+    TRACE_ERROR("Failed to initialize SNMP inform queue!\r\n");
+  }
+#endif
 }
 
-error_t SnmpInitClient(NetInterface* interface)
+error_t SnmpInitClient(void)
 {
-  SnmpAgentContext* snmpAgentContext;
   error_t error;
-  // if interface = NULL then can not iit snmpAgent --> print error and while
-  if (interface == NULL)
-  {
-    TRACE_ERROR("network interface is not valid - can not initialize snmp agent");
-    while(1);
-  }    
   snmpAgentGetDefaultSettings(&snmpAgentSettings);
-  if (interface == &netInterface[0])
-    snmpAgentContext = &ethernetSnmpAgentContext;
-  if (interface == &netInterface[1])
-    snmpAgentContext = &pppSnmpAgentContext; 
-  snmpAgentSettings.interface = interface;
+  //Listen on all interfaces, traps are routed by traffic class
+  snmpAgentSettings.interface = NULL;
   snmpAgentSettings.versionMin = SNMP_VERSION_1;
   snmpAgentSettings.versionMax = SNMP_VERSION_2C;
   
+#if (USERDEF_SNMP_ALARM_INFORM == ENABLED)
+  snmpAgentSettings.informCallback = SnmpAlarmInformAckCallback;
+#endif //(USERDEF_SNMP_ALARM_INFORM == ENABLED)
+  
 #if (SNMP_V3_SUPPORT == ENABLED)
   snmpAgentSettings.versionMax = SNMP_VERSION_3;
   snmpAgentSettings.randCallback = snmpAgentRandCallback;
 #endif //(SNMP_V3_SUPPORT == ENABLED)
   
   //SNMP agent initialization
-  error = snmpAgentInit(snmpAgentContext, &snmpAgentSettings);
+  error = snmpAgentInit(&snmpAgentContext, &snmpAgentSettings);
   if(error)
   {
     //Debug message
@@ -749,19 +794,19 @@ error_t SnmpInitClient(NetInterface* interface)
     return error;
   }
   //Load standard MIB-II
-  snmpAgentLoadMib(snmpAgentContext, &mib2Module);
+  snmpAgentLoadMib(&snmpAgentContext, &mib2Module);
   //Load private MIB
-  snmpAgentLoadMib(snmpAgentContext, &privateMibModule);
+  snmpAgentLoadMib(&snmpAgentContext, &privateMibModule);
   oidFromString(APP_SNMP_ENTERPRISE_OID, oid, sizeof(oid), &oidLen);
   //Set enterprise OID
-  snmpAgentSetEnterpriseOid(snmpAgentContext, oid, oidLen);
+  snmpAgentSetEnterpriseOid(&snmpAgentContext, oid, oidLen);
   
   //Set read-only community string
-  snmpAgentCreateCommunity(snmpAgentContext, "public",
+  snmpAgentCreateCommunity(&snmpAgentContext, "public",
                            SNMP_ACCESS_READ_ONLY);
   
   //Set read-write community string
-  snmpAgentCreateCommunity(snmpAgentContext, "private",
+  snmpAgentCreateCommunity(&snmpAgentContext, "private",
                            SNMP_ACCESS_READ_WRITE);
   
 #if (SNMP_V3_SUPPORT == ENABLED)
@@ -769,21 +814,24 @@ error_t SnmpInitClient(NetInterface* interface)
   snmpAgentSetContextEngine(&snmpAgentContext,
                             APP_SNMP_CONTEXT_ENGINE, sizeof(APP_SNMP_CONTEXT_ENGINE) - 1);
   
-  //Add a new user
-  snmpAgentCreateUser(&snmpAgentContext, "usr-md5-none",
-                      SNMP_ACCESS_READ_WRITE, SNMP_KEY_FORMAT_TEXT,
-                      SNMP_AUTH_PROTOCOL_MD5, "authkey1",
-                      SNMP_PRIV_PROTOCOL_NONE, "");
+  //The engine time must not go back across reboots
+  snmpAgentSetEngineBoots(&snmpAgentContext, SnmpKeyCacheNextEngineBoots());
+  
+  //Add a new user, localized keys are loaded from EEPROM
+  SnmpKeyCacheCreateUser(&snmpAgentContext, 0, "usr-md5-none",
+                         SNMP_ACCESS_READ_WRITE,
+                         SNMP_AUTH_PROTOCOL_MD5, "authkey1",
+                         SNMP_PRIV_PROTOCOL_NONE, "");
   
   //Add a new user
-  snmpAgentCreateUser(&snmpAgentContext, "usr-md5-aes",
-                      SNMP_ACCESS_READ_WRITE, SNMP_KEY_FORMAT_TEXT,
-                      SNMP_AUTH_PROTOCOL_MD5, "authkey2",
-                      SNMP_PRIV_PROTOCOL_AES, "privkey2");
+  SnmpKeyCacheCreateUser(&snmpAgentContext, 1, "usr-md5-aes",
+                         SNMP_ACCESS_READ_WRITE,
+                         SNMP_AUTH_PROTOCOL_MD5, "authkey2",
+                         SNMP_PRIV_PROTOCOL_AES, "privkey2");
 #endif //(SNMP_V3_SUPPORT == ENABLED)
   
   //Start SNMP agent
-  error = snmpAgentStart(snmpAgentContext);
+  error = snmpAgentStart(&snmpAgentContext);
   //Failed to start SNMP agent?
   if(error)
   {
@@ -2,6 +2,6 @@
 #define __SNMP_CLIENT_H__
 
 void SnmpInitMib();
-error_t SnmpInitClient(NetInterface* interface);
+error_t SnmpInitClient(void);
 void SnmpSendTrapTask(void *param);
 #endif // __SNMP_CLIENT_H__
\ No newline at end of file
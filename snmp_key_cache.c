@@ -0,0 +1,194 @@
+/**
+* @file snmp_key_cache.c
+* @brief Persistent cache of SNMPv3 localized keys
+*
+* Password to key localization hashes one megabyte per key, which takes
+* seconds on this target. The localized keys are therefore computed once and
+* kept in EEPROM. Each entry is identified by a fingerprint of the engine ID,
+* user name, protocols and passwords, so that changing any of them makes the
+* entry stale and the keys are computed again on the next boot
+*
+* @section License
+* ^^(^____^)^^
+*
+**/
+
+//Dependencies
+#include "core/net.h"
+#include "snmp_key_cache.h"
+#include "snmp/snmp_usm.h"
+#include "sha1.h"
+#include "variables.h"
+#include "eeprom_rtc.h"
+#include "debug.h"
+
+#if (USERDEF_CLIENT_SNMP == ENABLED && SNMP_V3_SUPPORT == ENABLED)
+
+//The slots must hold an entry and stay below the next EEPROM record
+#if (SNMP_KEY_CACHE_EEPROM_ADDR + SNMP_KEY_CACHE_SIZE * SNMP_KEY_CACHE_ENTRY_SIZE > DATA_USAGE_EEPROM_ADDR)
+   #error The SNMP key cache overlaps the data usage record in EEPROM
+#endif
+typedef char SnmpKeyCacheEntrySizeCheck[(sizeof(SnmpKeyCacheEntry) <= SNMP_KEY_CACHE_ENTRY_SIZE) ? 1 : -1];
+
+//========================================
+//Function Implementation
+//========================================
+
+/**
+* @brief Compute the fingerprint of a user configuration
+* @param[in] engineId Pointer to the engine ID
+* @param[in] engineIdLen Length of the engine ID
+* @param[in] username User name
+* @param[in] authProtocol Authentication protocol
+* @param[in] authPassword Authentication password
+* @param[in] privProtocol Privacy protocol
+* @param[in] privPassword Privacy password
+* @param[out] fingerprint Resulting fingerprint
+**/
+static void SnmpKeyCacheFingerprint(const uint8_t *engineId, size_t engineIdLen,
+                                    const char_t *username,
+                                    SnmpAuthProtocol authProtocol, const char_t *authPassword,
+                                    SnmpPrivProtocol privProtocol, const char_t *privPassword,
+                                    uint8_t *fingerprint)
+{
+  Sha1Context context;
+  uint8_t protocol;
+
+  sha1Init(&context);
+  sha1Update(&context, engineId, engineIdLen);
+  //Strings are hashed with their terminating null character
+  sha1Update(&context, username, strlen(username) + 1);
+  protocol = authProtocol;
+  sha1Update(&context, &protocol, 1);
+  sha1Update(&context, authPassword, strlen(authPassword) + 1);
+  protocol = privProtocol;
+  sha1Update(&context, &protocol, 1);
+  sha1Update(&context, privPassword, strlen(privPassword) + 1);
+  sha1Final(&context, fingerprint);
+}
+
+/**
+* @brief Read a cache entry from EEPROM
+* @param[in] slot Index of the entry
+* @param[out] entry Cache entry
+**/
+static void SnmpKeyCacheRead(uint_t slot, SnmpKeyCacheEntry *entry)
+{
+  uint_t i;
+  uint8_t *p = (uint8_t *) entry;
+
+  for(i = 0; i < sizeof(SnmpKeyCacheEntry); i++)
+    p[i] = ReadEEPROM_Byte(SNMP_KEY_CACHE_EEPROM_ADDR + slot * SNMP_KEY_CACHE_ENTRY_SIZE + i);
+}
+
+/**
+* @brief Write a cache entry to EEPROM
+* @param[in] slot Index of the entry
+* @param[in] entry Cache entry
+**/
+static void SnmpKeyCacheWrite(uint_t slot, const SnmpKeyCacheEntry *entry)
+{
+  uint_t i;
+  const uint8_t *p = (const uint8_t *) entry;
+
+  //The keys are written first, the fingerprint last, so that an interrupted
+  //write leaves a stale entry rather than a valid looking one
+  for(i = SNMP_KEY_CACHE_FINGERPRINT_SIZE; i < sizeof(SnmpKeyCacheEntry); i++)
+    WriteEEPROM_Byte(SNMP_KEY_CACHE_EEPROM_ADDR + slot * SNMP_KEY_CACHE_ENTRY_SIZE + i, p[i]);
+  for(i = 0; i < SNMP_KEY_CACHE_FINGERPRINT_SIZE; i++)
+    WriteEEPROM_Byte(SNMP_KEY_CACHE_EEPROM_ADDR + slot * SNMP_KEY_CACHE_ENTRY_SIZE + i, p[i]);
+}
+
+/**
+* @brief Create a SNMPv3 user from cached localized keys
+*
+* Must be called after the context engine identifier is set, and before the
+* scheduler starts since the EEPROM is accessed without the I2C lock
+*
+* @param[in] context Pointer to the SNMP agent context
+* @param[in] slot Cache entry reserved for this user
+* @param[in] username User name
+* @param[in] mode Access rights
+* @param[in] authProtocol Authentication protocol
+* @param[in] authPassword Authentication password
+* @param[in] privProtocol Privacy protocol
+* @param[in] privPassword Privacy password ("" if none)
+* @return Error code
+**/
+error_t SnmpKeyCacheCreateUser(SnmpAgentContext *context, uint_t slot,
+                               const char_t *username, SnmpAccess mode,
+                               SnmpAuthProtocol authProtocol, const char_t *authPassword,
+                               SnmpPrivProtocol privProtocol, const char_t *privPassword)
+{
+  error_t error;
+  SnmpKey authKey;
+  SnmpKey privKey;
+  SnmpKeyCacheEntry entry;
+  uint8_t fingerprint[SNMP_KEY_CACHE_FINGERPRINT_SIZE];
+
+  if(slot >= SNMP_KEY_CACHE_SIZE || authProtocol == SNMP_AUTH_PROTOCOL_NONE)
+    return ERROR_INVALID_PARAMETER;
+
+  memset(&authKey, 0, sizeof(SnmpKey));
+  memset(&privKey, 0, sizeof(SnmpKey));
+
+  SnmpKeyCacheFingerprint(context->contextEngine, context->contextEngineLen, username,
+                          authProtocol, authPassword, privProtocol, privPassword, fingerprint);
+  SnmpKeyCacheRead(slot, &entry);
+
+  if(!memcmp(entry.fingerprint, fingerprint, SNMP_KEY_CACHE_FINGERPRINT_SIZE))
+  {
+    //Cache hit, the keys are already localized to this engine
+    memcpy(authKey.b, entry.authKey, SNMP_MAX_KEY_SIZE);
+    memcpy(privKey.b, entry.privKey, SNMP_MAX_KEY_SIZE);
+  }
+  else
+  {
+    TRACE_INFO("Localizing SNMP keys for %s...\r\n", username);
+    error = snmpGenerateKey(authProtocol, authPassword, context->contextEngine,
+                            context->contextEngineLen, &authKey);
+    //The privacy key is derived with the hash of the authentication protocol
+    if(!error && privProtocol != SNMP_PRIV_PROTOCOL_NONE)
+      error = snmpGenerateKey(authProtocol, privPassword, context->contextEngine,
+                              context->contextEngineLen, &privKey);
+    if(error)
+      return error;
+
+    memcpy(entry.fingerprint, fingerprint, SNMP_KEY_CACHE_FINGERPRINT_SIZE);
+    memcpy(entry.authKey, authKey.b, SNMP_MAX_KEY_SIZE);
+    memcpy(entry.privKey, privKey.b, SNMP_MAX_KEY_SIZE);
+    SnmpKeyCacheWrite(slot, &entry);
+  }
+
+  error = snmpAgentCreateUser(context, username, mode, SNMP_KEY_FORMAT_RAW,
+                              authProtocol, &authKey, privProtocol, &privKey);
+
+  //Do not leave key material on the stack
+  memset(&entry, 0, sizeof(entry));
+  memset(&authKey, 0, sizeof(SnmpKey));
+  memset(&privKey, 0, sizeof(SnmpKey));
+  return error;
+}
+
+/**
+* @brief Increment the persistent snmpEngineBoots counter
+*
+* RFC 3414 requires snmpEngineBoots to grow at each reboot, otherwise the
+* managers see the engine time go back and reject the messages until they
+* resynchronize
+*
+* @return Value of snmpEngineBoots for this boot
+**/
+int32_t SnmpKeyCacheNextEngineBoots(void)
+{
+  uint32_t engineBoots;
+
+  engineBoots = ReadEEPROMu32(SNMP_ENGINE_BOOTS_EEPROM_ADDR);
+  //Erased EEPROM or counter at its maximum value (RFC 3414 2.2.2)
+  if(engineBoots >= 2147483647)
+    engineBoots = 0;
+  engineBoots++;
+  WriteEEPROMu32(SNMP_ENGINE_BOOTS_EEPROM_ADDR, engineBoots);
+  return (int32_t) engineBoots;
+}
+#endif //(USERDEF_CLIENT_SNMP == ENABLED && SNMP_V3_SUPPORT == ENABLED)
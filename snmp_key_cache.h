@@ -0,0 +1,49 @@
+/**
+* @file snmp_key_cache.h
+* @brief Persistent cache of SNMPv3 localized keys
+*
+* @section License
+* ^^(^____^)^^
+*
+**/
+
+#ifndef __SNMP_KEY_CACHE_H
+#define __SNMP_KEY_CACHE_H
+
+#include "net_config.h"
+#include "core/net.h"
+#include "snmp/snmp_agent.h"
+
+//Number of users whose keys are cached
+#ifndef SNMP_KEY_CACHE_SIZE
+#define SNMP_KEY_CACHE_SIZE             2
+#endif
+//Size of the fingerprint identifying the cached keys
+#define SNMP_KEY_CACHE_FINGERPRINT_SIZE 20
+//Size of one cache entry in EEPROM
+#define SNMP_KEY_CACHE_ENTRY_SIZE       64
+
+//Stronger authentication protocols need larger keys
+#if (SNMP_KEY_CACHE_FINGERPRINT_SIZE + 2 * SNMP_MAX_KEY_SIZE > SNMP_KEY_CACHE_ENTRY_SIZE)
+   #error SNMP_KEY_CACHE_ENTRY_SIZE is too small for SNMP_MAX_KEY_SIZE
+#endif
+
+/**
+* @brief Cache entry, as stored in EEPROM
+**/
+typedef struct
+{
+  uint8_t fingerprint[SNMP_KEY_CACHE_FINGERPRINT_SIZE];
+  uint8_t authKey[SNMP_MAX_KEY_SIZE];
+  uint8_t privKey[SNMP_MAX_KEY_SIZE];
+} SnmpKeyCacheEntry;
+
+//=======================================
+//Function declearation
+//=======================================
+error_t SnmpKeyCacheCreateUser(SnmpAgentContext *context, uint_t slot,
+                               const char_t *username, SnmpAccess mode,
+                               SnmpAuthProtocol authProtocol, const char_t *authPassword,
+                               SnmpPrivProtocol privProtocol, const char_t *privPassword);
+int32_t SnmpKeyCacheNextEngineBoots(void);
+#endif
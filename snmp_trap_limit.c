@@ -0,0 +1,172 @@
+/**
+* @file snmp_trap_limit.c
+* @brief Per-destination rate limiting of alarm notifications
+*
+* Each trap destination owns a token bucket. An alarm transition is sent
+* only if a token is available, otherwise it is counted against its alarm.
+* Suppressed transitions are reported later in a single summary carrying
+* the number of transitions and the current state of each alarm, so that a
+* flapping dry contact costs one notification per period instead of one per
+* change. All functions run in the trap task context
+*
+* @section License
+* ^^(^____^)^^
+*
+**/
+
+//Dependencies
+#include "core/net.h"
+#include "snmp_trap_limit.h"
+#include "debug.h"
+
+#if (USERDEF_CLIENT_SNMP == ENABLED)
+//========================================
+//Global Variable
+//========================================
+static SnmpTrapLimitEntry snmpTrapLimitTable[SNMP_TRAP_LIMIT_DEST_COUNT];
+
+//========================================
+//Function Implementation
+//========================================
+
+/**
+* @brief Initialize the token buckets
+**/
+void SnmpTrapLimitInit(void)
+{
+  memset(snmpTrapLimitTable, 0, sizeof(snmpTrapLimitTable));
+}
+
+/**
+* @brief Find the token bucket of a destination and refill it
+* @param[in] destIpAddr IP address of the manager
+* @return Token bucket of the destination
+**/
+static SnmpTrapLimitEntry *SnmpTrapLimitGetEntry(const IpAddr *destIpAddr)
+{
+  uint_t i;
+  systime_t time;
+  SnmpTrapLimitEntry *entry;
+
+  time = osGetSystemTime();
+  entry = NULL;
+
+  for(i = 0; i < SNMP_TRAP_LIMIT_DEST_COUNT; i++)
+  {
+    if(snmpTrapLimitTable[i].used &&
+       snmpTrapLimitTable[i].ipAddr.length == destIpAddr->length &&
+       !memcmp(&snmpTrapLimitTable[i].ipAddr.ipv4Addr, &destIpAddr->ipv4Addr, destIpAddr->length))
+    {
+      entry = &snmpTrapLimitTable[i];
+      break;
+    }
+  }
+
+  if(entry == NULL)
+  {
+    //Take a free bucket, or the one idle for the longest time
+    entry = &snmpTrapLimitTable[0];
+    for(i = 0; i < SNMP_TRAP_LIMIT_DEST_COUNT; i++)
+    {
+      if(!snmpTrapLimitTable[i].used)
+      {
+        entry = &snmpTrapLimitTable[i];
+        break;
+      }
+      if(timeCompare(snmpTrapLimitTable[i].timestamp, entry->timestamp) < 0)
+        entry = &snmpTrapLimitTable[i];
+    }
+
+    //A new destination starts with a full bucket
+    memset(entry, 0, sizeof(SnmpTrapLimitEntry));
+    entry->used = TRUE;
+    entry->ipAddr = *destIpAddr;
+    entry->credit = SNMP_TRAP_LIMIT_BURST * SNMP_TRAP_LIMIT_PERIOD;
+  }
+  else
+  {
+    //Earn credit for the elapsed time, up to the burst size
+    entry->credit = MIN(entry->credit + (time - entry->timestamp),
+                        SNMP_TRAP_LIMIT_BURST * SNMP_TRAP_LIMIT_PERIOD);
+  }
+
+  entry->timestamp = time;
+  return entry;
+}
+
+/**
+* @brief Decide whether an alarm transition may be sent now
+* @param[in] destIpAddr IP address of the manager
+* @param[in] alarmIndex Index of the alarm in the alarmGroup (1-based)
+* @return TRUE if the notification may be sent, FALSE if it was folded
+*   into the next summary
+**/
+bool_t SnmpTrapLimitAdmit(const IpAddr *destIpAddr, uint_t alarmIndex)
+{
+  SnmpTrapLimitEntry *entry;
+
+  entry = SnmpTrapLimitGetEntry(destIpAddr);
+
+  if(entry->credit >= SNMP_TRAP_LIMIT_PERIOD)
+  {
+    entry->credit -= SNMP_TRAP_LIMIT_PERIOD;
+    return TRUE;
+  }
+
+  if(alarmIndex >= 1 && alarmIndex <= SNMP_TRAP_LIMIT_ALARM_COUNT)
+    entry->suppressed[alarmIndex - 1]++;
+  entry->pending++;
+  privateMibBase.trapLimitGroup.trapLimitSuppressedCount++;
+  return FALSE;
+}
+
+/**
+* @brief Prepare the summary of the suppressed transitions
+*
+* When transitions are pending and a token is available, the per-alarm
+* counts and the current alarm states are returned for the variable bindings
+* of the summary notification, which carries them until it is delivered.
+* The last summary is also published in the trapLimitGroup
+*
+* @param[in] destIpAddr IP address of the manager
+* @param[in] alarmStates Current value of each alarm
+* @param[out] counts Number of suppressed transitions of each alarm, one
+*   octet per alarm
+* @param[out] states State of each alarm, one octet per alarm
+* @return TRUE if a summary must be sent now
+**/
+bool_t SnmpTrapLimitTakeSummary(const IpAddr *destIpAddr, const uint32_t *alarmStates,
+                                uint8_t *counts, uint8_t *states)
+{
+  uint_t i;
+  SnmpTrapLimitEntry *entry;
+  PrivateMibTrapLimitGroup *group;
+
+  entry = SnmpTrapLimitGetEntry(destIpAddr);
+
+  if(entry->pending == 0 || entry->credit < SNMP_TRAP_LIMIT_PERIOD)
+    return FALSE;
+  entry->credit -= SNMP_TRAP_LIMIT_PERIOD;
+
+  for(i = 0; i < SNMP_TRAP_LIMIT_ALARM_COUNT; i++)
+  {
+    //One octet per alarm, counts saturate
+    counts[i] = MIN(entry->suppressed[i], 255);
+    states[i] = MIN(alarmStates[i], 255);
+  }
+
+  group = &privateMibBase.trapLimitGroup;
+  memcpy(group->trapLimitSummaryCounts, counts, SNMP_TRAP_LIMIT_ALARM_COUNT);
+  memcpy(group->trapLimitSummaryStates, states, SNMP_TRAP_LIMIT_ALARM_COUNT);
+  group->trapLimitSummaryCountsLen = SNMP_TRAP_LIMIT_ALARM_COUNT;
+  group->trapLimitSummaryStatesLen = SNMP_TRAP_LIMIT_ALARM_COUNT;
+  group->trapLimitSummaryCount++;
+
+  TRACE_INFO("SNMP trap summary to %s: %u transitions suppressed\r\n",
+             ipAddrToString(destIpAddr, NULL), entry->pending);
+
+  memset(entry->suppressed, 0, sizeof(entry->suppressed));
+  entry->pending = 0;
+  return TRUE;
+}
+#endif //(USERDEF_CLIENT_SNMP == ENABLED)
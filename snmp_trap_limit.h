@@ -0,0 +1,60 @@
+/**
+* @file snmp_trap_limit.h
+* @brief Per-destination rate limiting of alarm notifications
+*
+* @section License
+* ^^(^____^)^^
+*
+**/
+
+#ifndef __SNMP_TRAP_LIMIT_H
+#define __SNMP_TRAP_LIMIT_H
+
+#include "net_config.h"
+#include "core/net.h"
+#include "private_mib_module.h"
+
+//Number of trap destinations tracked at the same time
+#ifndef SNMP_TRAP_LIMIT_DEST_COUNT
+#define SNMP_TRAP_LIMIT_DEST_COUNT      2
+#endif
+//Number of alarm notifications sent back to back before limiting starts
+#ifndef SNMP_TRAP_LIMIT_BURST
+#define SNMP_TRAP_LIMIT_BURST           4
+#endif
+//Time needed to earn one more notification (ms)
+#ifndef SNMP_TRAP_LIMIT_PERIOD
+#define SNMP_TRAP_LIMIT_PERIOD          15000
+#endif
+//Number of alarms tracked, indexed like the alarmGroup objects
+#define SNMP_TRAP_LIMIT_ALARM_COUNT     PRIVATE_MIB_TRAP_LIMIT_ALARM_COUNT
+//Specific trap code of the summary notification
+#define SNMP_TRAP_SUMMARY_CODE          17
+//Specific trap code of the combined info notification
+#define SNMP_TRAP_COMBINED_INFO_CODE    18
+//Over GPRS, the configuration info is sent once every N info periods
+#ifndef SNMP_TRAP_CONFIG_INFO_DIVIDER
+#define SNMP_TRAP_CONFIG_INFO_DIVIDER   10
+#endif
+
+/**
+* @brief Token bucket of a trap destination
+**/
+typedef struct
+{
+  bool_t used;
+  IpAddr ipAddr;
+  systime_t credit;
+  systime_t timestamp;
+  uint32_t suppressed[SNMP_TRAP_LIMIT_ALARM_COUNT];
+  uint32_t pending;
+} SnmpTrapLimitEntry;
+
+//=======================================
+//Function declearation
+//=======================================
+void SnmpTrapLimitInit(void);
+bool_t SnmpTrapLimitAdmit(const IpAddr *destIpAddr, uint_t alarmIndex);
+bool_t SnmpTrapLimitTakeSummary(const IpAddr *destIpAddr, const uint32_t *alarmStates,
+                                uint8_t *counts, uint8_t *states);
+#endif
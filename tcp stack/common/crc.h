@@ -0,0 +1,62 @@
+/**
+ * @file crc.h
+ * @brief CRC engine (CRC-32, FCS-16, Modbus CRC-16 and CRC-8)
+ *
+ * @section License
+ * ^^(^____^)^^
+ *
+ **/
+
+#ifndef _CRC_H
+#define _CRC_H
+
+//Dependencies
+#include "os_port.h"
+#include "net_config.h"
+#include "error.h"
+
+//Number of lookup tables used by the CRC-32 kernel (1, 4 or 8)
+#ifndef CRC32_SLICE_COUNT
+   #define CRC32_SLICE_COUNT 8
+#elif (CRC32_SLICE_COUNT != 1 && CRC32_SLICE_COUNT != 4 && CRC32_SLICE_COUNT != 8)
+   #error CRC32_SLICE_COUNT parameter is not valid
+#endif
+
+//Number of lookup tables used by the CRC-16 kernels (1 or 4)
+#ifndef CRC16_SLICE_COUNT
+   #define CRC16_SLICE_COUNT 4
+#elif (CRC16_SLICE_COUNT != 1 && CRC16_SLICE_COUNT != 4)
+   #error CRC16_SLICE_COUNT parameter is not valid
+#endif
+
+//Hardware CRC-32 using the CRC module of the MCU
+#ifndef CRC_HW_SUPPORT
+   #define CRC_HW_SUPPORT DISABLED
+#elif (CRC_HW_SUPPORT != ENABLED && CRC_HW_SUPPORT != DISABLED)
+   #error CRC_HW_SUPPORT parameter is not valid
+#endif
+
+//Shorter blocks are not worth locking the CRC module
+#ifndef CRC_HW_MIN_LENGTH
+   #define CRC_HW_MIN_LENGTH 512
+#elif (CRC_HW_MIN_LENGTH < 1)
+   #error CRC_HW_MIN_LENGTH parameter is not valid
+#endif
+
+
+//CRC related functions
+error_t crcInit(void);
+
+uint32_t crc32Calc(const void *data, size_t length);
+uint32_t crc32Update(uint32_t crc, const void *data, size_t length);
+
+uint16_t crc16FcsCalc(const void *data, size_t length);
+uint16_t crc16FcsUpdate(uint16_t fcs, const void *data, size_t length);
+
+uint16_t crc16ModbusCalc(const void *data, size_t length);
+uint16_t crc16ModbusUpdate(uint16_t crc, const void *data, size_t length);
+
+uint8_t crc8Calc(const void *data, size_t length);
+uint8_t crc8Update(uint8_t crc, const void *data, size_t length);
+
+#endif
@@ -46,13 +46,6 @@
    #error MAC_MULTICAST_FILTER_SIZE parameter is not valid
 #endif
 
-//CRC32 calculation using a pre-calculated lookup table
-#ifndef ETH_FAST_CRC_SUPPORT
-   #define ETH_FAST_CRC_SUPPORT DISABLED
-#elif (ETH_FAST_CRC_SUPPORT != ENABLED && ETH_FAST_CRC_SUPPORT != DISABLED)
-   #error ETH_FAST_CRC_SUPPORT parameter is not valid
-#endif
-
 //Minimum Ethernet frame size
 #define ETH_MIN_FRAME_SIZE 64
 //Maximum Ethernet frame size
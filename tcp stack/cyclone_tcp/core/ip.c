@@ -135,36 +135,312 @@ error_t ipSelectSourceAddr(NetInterface **interface,
 }
 
 
+//Checksum kernels sum 32-bit words. Since 2^16 = 1 modulo 0xFFFF, the
+//16-bit 1's complement sum is obtained by folding the 32-bit result. On
+//ARMv7-M, four words are added with a single ADDS/ADCS carry chain and the
+//end-around carry is folded back immediately (one cycle per word). Other
+//targets accumulate into a 64-bit integer that cannot overflow
+#if ((defined(__GNUC__) && defined(__arm__)) || defined(__ICCARM__)) && defined(__CORTEX_M) && (__CORTEX_M >= 3)
+
+typedef uint32_t IpChecksumAcc;
+
+#define IP_CHECKSUM_ADD4(acc, a, b, c, d) \
+   __asm__("adds %0, %0, %1\n\t" \
+           "adcs %0, %0, %2\n\t" \
+           "adcs %0, %0, %3\n\t" \
+           "adcs %0, %0, %4\n\t" \
+           "adc %0, %0, #0" \
+           : "+r" (acc) : "r" (a), "r" (b), "r" (c), "r" (d) : "cc")
+
+#define IP_CHECKSUM_ADD1(acc, a) \
+   __asm__("adds %0, %0, %1\n\t" \
+           "adc %0, %0, #0" \
+           : "+r" (acc) : "r" (a) : "cc")
+
+#else
+
+typedef uint64_t IpChecksumAcc;
+
+#define IP_CHECKSUM_ADD4(acc, a, b, c, d) \
+   acc += (uint64_t) (a) + (b) + (c) + (d)
+
+#define IP_CHECKSUM_ADD1(acc, a) \
+   acc += (a)
+
+#endif
+
+//Swap the bytes of a 16-bit partial sum
+#define IP_CHECKSUM_SWAP(sum) ((((sum) >> 8) | ((sum) << 8)) & 0xFFFF)
+
+
 /**
- * @brief IP checksum calculation
- * @param[in] data Pointer to the data over which to calculate the IP checksum
+ * @brief Fold a checksum accumulator to 16 bits
+ * @param[in] acc Checksum accumulator
+ * @return 16-bit 1's complement sum
+ **/
+
+static uint_t ipChecksumFold(IpChecksumAcc acc)
+{
+   uint32_t checksum;
+
+   //Fold the accumulator to 32 bits (no-op for a 32-bit accumulator)
+   while(acc >> 16 >> 16)
+      acc = (acc & 0xFFFFFFFF) + (acc >> 16 >> 16);
+
+   //Fold 32-bit sum to 16 bits
+   checksum = (uint32_t) acc;
+   checksum = (checksum & 0xFFFF) + (checksum >> 16);
+   checksum = (checksum & 0xFFFF) + (checksum >> 16);
+
+   //Return 16-bit value
+   return checksum;
+}
+
+
+/**
+ * @brief Compute the 1's complement sum of a contiguous block
+ * @param[in] data Pointer to the data
  * @param[in] length Number of bytes to process
- * @return Checksum value
+ * @return 16-bit 1's complement sum (not complemented)
  **/
 
-uint16_t ipCalcChecksum(const void *data, size_t length)
+static uint_t ipChecksumBlock(const uint8_t *data, size_t length)
 {
-   //Checksum preset value
-   uint32_t checksum = 0x0000;
+   bool_t odd;
+   uint_t checksum;
+   const uint32_t *p;
+   IpChecksumAcc acc;
 
-   //Process all the data
-   while(length > 1)
+   //Initialize accumulator
+   acc = 0;
+   //Check whether the block starts on an odd address
+   odd = ((uintptr_t) data & 1) ? TRUE : FALSE;
+
+   //Restore the alignment on 16-bit boundaries
+   if(odd && length > 0)
+   {
+#ifdef _BIG_ENDIAN
+      IP_CHECKSUM_ADD1(acc, *data);
+#else
+      IP_CHECKSUM_ADD1(acc, *data << 8);
+#endif
+      data += 1;
+      length -= 1;
+   }
+
+   //Restore the alignment on 32-bit boundaries
+   if(((uintptr_t) data & 2) && length > 1)
    {
-      //Update checksum value
-      checksum += *((uint16_t *) data);
-      //Point to the next 16-bit word
-      data = (uint16_t *) data + 1;
-      //Adjust the number of remaining words to process
+      IP_CHECKSUM_ADD1(acc, *((uint16_t *) data));
+      data += 2;
+      length -= 2;
+   }
+
+   //Point to the first 32-bit word
+   p = (const uint32_t *) data;
+
+   //Process the data 16 bytes at a time
+   while(length >= 16)
+   {
+      IP_CHECKSUM_ADD4(acc, p[0], p[1], p[2], p[3]);
+      p += 4;
+      length -= 16;
+   }
+
+   //Process the remaining 32-bit words
+   while(length >= 4)
+   {
+      IP_CHECKSUM_ADD1(acc, p[0]);
+      p += 1;
+      length -= 4;
+   }
+
+   data = (const uint8_t *) p;
+
+   //Process the remaining 16-bit word, if any
+   if(length > 1)
+   {
+      IP_CHECKSUM_ADD1(acc, *((uint16_t *) data));
+      data += 2;
       length -= 2;
    }
 
    //Add left-over byte, if any
    if(length > 0)
-      checksum += *((uint8_t *) data);
+   {
+#ifdef _BIG_ENDIAN
+      IP_CHECKSUM_ADD1(acc, *data << 8);
+#else
+      IP_CHECKSUM_ADD1(acc, *data);
+#endif
+   }
 
-   //Fold 32-bit sum to 16 bits
-   while(checksum >> 16)
-      checksum = (checksum & 0xFFFF) + (checksum >> 16);
+   //Fold the accumulator to 16 bits
+   checksum = ipChecksumFold(acc);
+
+   //Every byte was summed one position off when the block starts on an
+   //odd address
+   if(odd)
+      checksum = IP_CHECKSUM_SWAP(checksum);
+
+   //Return 1's complement sum
+   return checksum;
+}
+
+
+/**
+ * @brief Copy a contiguous block and compute its 1's complement sum
+ * @param[out] dest Destination address
+ * @param[in] src Source address
+ * @param[in] length Number of bytes to copy
+ * @return 16-bit 1's complement sum (not complemented)
+ **/
+
+static uint_t ipCopyChecksumBlock(uint8_t *dest, const uint8_t *src, size_t length)
+{
+   bool_t odd;
+   uint_t checksum;
+   uint32_t a;
+   uint32_t b;
+   uint32_t c;
+   uint32_t d;
+   const uint32_t *p;
+   IpChecksumAcc acc;
+
+   //Initialize accumulator
+   acc = 0;
+   //The loads are aligned on the source buffer
+   odd = ((uintptr_t) src & 1) ? TRUE : FALSE;
+
+   //Restore the alignment on 16-bit boundaries
+   if(odd && length > 0)
+   {
+#ifdef _BIG_ENDIAN
+      IP_CHECKSUM_ADD1(acc, *src);
+#else
+      IP_CHECKSUM_ADD1(acc, *src << 8);
+#endif
+      *(dest++) = *(src++);
+      length -= 1;
+   }
+
+   //Restore the alignment on 32-bit boundaries
+   if(((uintptr_t) src & 2) && length > 1)
+   {
+      IP_CHECKSUM_ADD1(acc, *((uint16_t *) src));
+      dest[0] = src[0];
+      dest[1] = src[1];
+      dest += 2;
+      src += 2;
+      length -= 2;
+   }
+
+   //Point to the first 32-bit word
+   p = (const uint32_t *) src;
+
+   //Both buffers share the same alignment?
+   if(((uintptr_t) dest & 3) == 0)
+   {
+      uint32_t *q = (uint32_t *) dest;
+
+      //Copy and sum the data 16 bytes at a time
+      while(length >= 16)
+      {
+         a = p[0];
+         b = p[1];
+         c = p[2];
+         d = p[3];
+         q[0] = a;
+         q[1] = b;
+         q[2] = c;
+         q[3] = d;
+         IP_CHECKSUM_ADD4(acc, a, b, c, d);
+         p += 4;
+         q += 4;
+         length -= 16;
+      }
+
+      dest = (uint8_t *) q;
+   }
+   else
+   {
+      //Copy and sum the data 16 bytes at a time
+      while(length >= 16)
+      {
+         a = p[0];
+         b = p[1];
+         c = p[2];
+         d = p[3];
+         //Unaligned stores
+         memcpy(dest, p, 16);
+         IP_CHECKSUM_ADD4(acc, a, b, c, d);
+         p += 4;
+         dest += 16;
+         length -= 16;
+      }
+   }
+
+   //Process the remaining 32-bit words
+   while(length >= 4)
+   {
+      a = p[0];
+      memcpy(dest, &a, 4);
+      IP_CHECKSUM_ADD1(acc, a);
+      p += 1;
+      dest += 4;
+      length -= 4;
+   }
+
+   src = (const uint8_t *) p;
+
+   //Process the remaining 16-bit word, if any
+   if(length > 1)
+   {
+      IP_CHECKSUM_ADD1(acc, *((uint16_t *) src));
+      dest[0] = src[0];
+      dest[1] = src[1];
+      dest += 2;
+      src += 2;
+      length -= 2;
+   }
+
+   //Copy left-over byte, if any
+   if(length > 0)
+   {
+#ifdef _BIG_ENDIAN
+      IP_CHECKSUM_ADD1(acc, *src << 8);
+#else
+      IP_CHECKSUM_ADD1(acc, *src);
+#endif
+      *dest = *src;
+   }
+
+   //Fold the accumulator to 16 bits
+   checksum = ipChecksumFold(acc);
+
+   //Every byte was summed one position off when the block starts on an
+   //odd address
+   if(odd)
+      checksum = IP_CHECKSUM_SWAP(checksum);
+
+   //Return 1's complement sum
+   return checksum;
+}
+
+
+/**
+ * @brief IP checksum calculation
+ * @param[in] data Pointer to the data over which to calculate the IP checksum
+ * @param[in] length Number of bytes to process
+ * @return Checksum value
+ **/
+
+uint16_t ipCalcChecksum(const void *data, size_t length)
+{
+   uint_t checksum;
+
+   //Process all the data
+   checksum = ipChecksumBlock(data, length);
 
    //Return 1's complement value
    return checksum ^ 0xFFFF;
@@ -184,7 +460,7 @@ uint16_t ipCalcChecksumEx(const NetBuffer *buffer, size_t offset, size_t length)
    uint_t i;
    uint_t m;
    uint_t n;
-   bool_t odd;
+   uint_t partial;
    uint8_t *data;
    uint32_t checksum;
 
@@ -199,9 +475,6 @@ uint16_t ipCalcChecksumEx(const NetBuffer *buffer, size_t offset, size_t length)
       //Is there any data to process in the current chunk?
       if(offset < buffer->chunk[i].length)
       {
-         //Check whether the total number of bytes already processed is odd
-         odd = (n & 1) ? TRUE : FALSE;
-
          //Point to the first data byte
          data = (uint8_t *) buffer->chunk[i].address + offset;
 
@@ -210,115 +483,19 @@ uint16_t ipCalcChecksumEx(const NetBuffer *buffer, size_t offset, size_t length)
          //Limit the number of byte to process
          m = MIN(m, length - n);
 
+         //Sum the current block
+         partial = ipChecksumBlock(data, m);
+
+         //The block starts at an odd position within the checksummed data?
+         if(n & 1)
+            partial = IP_CHECKSUM_SWAP(partial);
+
+         //Update checksum value
+         checksum += partial;
+
          //Now adjust the total length
          n += m;
 
-         //Data buffer is not aligned on 16-bit boundaries?
-         if((uint_t) data & 1)
-         {
-            //The total number of bytes is even?
-            if(!odd)
-            {
-               //Fold 32-bit sum to 16 bits
-               while(checksum >> 16)
-                  checksum = (checksum & 0xFFFF) + (checksum >> 16);
-               //Swap checksum value
-               checksum = ((checksum >> 8) | (checksum << 8)) & 0xFFFF;
-            }
-
-            //Restore the alignment on 16-bit boundaries
-            if(m > 0)
-            {
-#ifdef _BIG_ENDIAN
-               //Update checksum value
-               checksum += *data;
-#else
-               //Update checksum value
-               checksum += *data << 8;
-#endif
-               //Point to the next byte
-               data += 1;
-               m -= 1;
-            }
-
-            //Process the data 2 bytes at a time
-            while(m > 1)
-            {
-               //Update checksum value
-               checksum += *((uint16_t *) data);
-               //Point to the next 16-bit word
-               data += 2;
-               m -= 2;
-            }
-
-            //Add left-over byte, if any
-            if(m > 0)
-            {
-#ifdef _BIG_ENDIAN
-               //Update checksum value
-               checksum += *data << 8;
-#else
-               //Update checksum value
-               checksum += *data;
-#endif
-            }
-
-            //Restore checksum endianness
-            if(!odd)
-            {
-               //Fold 32-bit sum to 16 bits
-               while(checksum >> 16)
-                  checksum = (checksum & 0xFFFF) + (checksum >> 16);
-               //Swap checksum value
-               checksum = ((checksum >> 8) | (checksum << 8)) & 0xFFFF;
-            }
-         }
-         //Data buffer is aligned on 16-bit boundaries?
-         else
-         {
-            //The total number of bytes is odd?
-            if(odd)
-            {
-               //Fold 32-bit sum to 16 bits
-               while(checksum >> 16)
-                  checksum = (checksum & 0xFFFF) + (checksum >> 16);
-               //Swap checksum value
-               checksum = ((checksum >> 8) | (checksum << 8)) & 0xFFFF;
-            }
-
-            //Process the data 2 bytes at a time
-            while(m > 1)
-            {
-               //Update checksum value
-               checksum += *((uint16_t *) data);
-               //Point to the next 16-bit word
-               data += 2;
-               m -= 2;
-            }
-
-            //Add left-over byte, if any
-            if(m > 0)
-            {
-#ifdef _BIG_ENDIAN
-               //Update checksum value
-               checksum += *data << 8;
-#else
-               //Update checksum value
-               checksum += *data;
-#endif
-            }
-
-            //Restore checksum endianness
-            if(odd)
-            {
-               //Fold 32-bit sum to 16 bits
-               while(checksum >> 16)
-                  checksum = (checksum & 0xFFFF) + (checksum >> 16);
-               //Swap checksum value
-               checksum = ((checksum >> 8) | (checksum << 8)) & 0xFFFF;
-            }
-         }
-
          //Process the next block from the start
          offset = 0;
       }
@@ -350,42 +527,12 @@ uint16_t ipCalcChecksumEx(const NetBuffer *buffer, size_t offset, size_t length)
 uint16_t ipCalcUpperLayerChecksum(const void *pseudoHeader,
    size_t pseudoHeaderLength, const void *data, size_t dataLength)
 {
-   //Checksum preset value
-   uint32_t checksum = 0x0000;
+   uint32_t checksum;
 
    //Process pseudo header
-   while(pseudoHeaderLength > 1)
-   {
-      //Update checksum value
-      checksum += *((uint16_t *) pseudoHeader);
-      //Point to the next 16-bit word
-      pseudoHeader = (uint16_t *) pseudoHeader + 1;
-      //Adjust the number of remaining words to process
-      pseudoHeaderLength -= 2;
-   }
-
+   checksum = ipChecksumBlock(pseudoHeader, pseudoHeaderLength);
    //Process upper-layer data
-   while(dataLength > 1)
-   {
-      //Update checksum value
-      checksum += *((uint16_t *) data);
-      //Point to the next 16-bit word
-      data = (uint16_t *) data + 1;
-      //Adjust the number of remaining words to process
-      dataLength -= 2;
-   }
-
-   //Add left-over byte, if any
-   if(dataLength > 0)
-   {
-#ifdef _BIG_ENDIAN
-      //Update checksum value
-      checksum += *((uint8_t *) data) << 8;
-#else
-      //Update checksum value
-      checksum += *((uint8_t *) data);
-#endif
-   }
+   checksum += ipChecksumBlock(data, dataLength);
 
    //Fold 32-bit sum to 16 bits
    while(checksum >> 16)
@@ -417,15 +564,7 @@ uint16_t ipCalcUpperLayerChecksumEx(const void *pseudoHeader,
    checksum = checksum ^ 0xFFFF;
 
    //Process pseudo header
-   while(pseudoHeaderLength > 1)
-   {
-      //Update checksum value
-      checksum += *((uint16_t *) pseudoHeader);
-      //Point to the next 16-bit word
-      pseudoHeader = (uint16_t *) pseudoHeader + 1;
-      //Adjust the number of remaining words to process
-      pseudoHeaderLength -= 2;
-   }
+   checksum += ipChecksumBlock(pseudoHeader, pseudoHeaderLength);
 
    //Fold 32-bit sum to 16 bits
    while(checksum >> 16)
@@ -436,6 +575,161 @@ uint16_t ipCalcUpperLayerChecksumEx(const void *pseudoHeader,
 }
 
 
+/**
+ * @brief Combine two partial 1's complement sums
+ * @param[in] checksum 1's complement sum of the first block
+ * @param[in] partial 1's complement sum of the second block
+ * @param[in] offset Position of the second block relative to the first one
+ * @return 1's complement sum of both blocks (not complemented)
+ **/
+
+uint16_t ipCombineChecksum(uint16_t checksum, uint16_t partial, size_t offset)
+{
+   uint32_t sum;
+
+   //The second block starts at an odd position?
+   if(offset & 1)
+      partial = IP_CHECKSUM_SWAP(partial);
+
+   //Add the partial sums
+   sum = (uint32_t) checksum + partial;
+   //Fold 32-bit sum to 16 bits
+   sum = (sum & 0xFFFF) + (sum >> 16);
+
+   //Return 1's complement sum
+   return sum;
+}
+
+
+/**
+ * @brief Copy data and compute its 1's complement sum in a single pass
+ * @param[out] dest Destination buffer
+ * @param[in] src Source buffer
+ * @param[in] length Number of bytes to copy
+ * @return 1's complement sum of the data (not complemented)
+ **/
+
+uint16_t ipCopyChecksum(void *dest, const void *src, size_t length)
+{
+   //Copy and sum the data
+   return ipCopyChecksumBlock(dest, src, length);
+}
+
+
+/**
+ * @brief Write data to a multi-part buffer and compute its 1's complement sum
+ * @param[out] dest Pointer to a multi-part buffer
+ * @param[in] destOffset Offset from the beginning of the multi-part buffer
+ * @param[in] src User buffer containing the data to be written
+ * @param[in] length Number of bytes to copy
+ * @return 1's complement sum of the data actually written (not complemented)
+ **/
+
+uint16_t ipCopyChecksumToBuffer(NetBuffer *dest,
+   size_t destOffset, const void *src, size_t length)
+{
+   uint_t i;
+   uint_t n;
+   size_t totalLength;
+   uint8_t *p;
+   uint32_t checksum;
+
+   //Checksum preset value
+   checksum = 0x0000;
+   //Total number of bytes written
+   totalLength = 0;
+
+   //Loop through data chunks
+   for(i = 0; i < dest->chunkCount && totalLength < length; i++)
+   {
+      //Is there any data to copy in the current chunk?
+      if(destOffset < dest->chunk[i].length)
+      {
+         //Point to the first byte to be written
+         p = (uint8_t *) dest->chunk[i].address + destOffset;
+         //Compute the number of bytes to copy at a time
+         n = MIN(length - totalLength, dest->chunk[i].length - destOffset);
+
+         //Copy data and update checksum value
+         checksum = ipCombineChecksum(checksum,
+            ipCopyChecksumBlock(p, src, n), totalLength);
+
+         //Advance read pointer
+         src = (uint8_t *) src + n;
+         //Total number of bytes written
+         totalLength += n;
+         //Process the next block from the start
+         destOffset = 0;
+      }
+      else
+      {
+         //Skip the current chunk
+         destOffset -= dest->chunk[i].length;
+      }
+   }
+
+   //Return 1's complement sum
+   return checksum;
+}
+
+
+/**
+ * @brief Read data from a multi-part buffer and compute its 1's complement sum
+ * @param[out] dest Pointer to the buffer where to return the data
+ * @param[in] src Pointer to a multi-part buffer
+ * @param[in] srcOffset Offset from the beginning of the multi-part buffer
+ * @param[in] length Number of bytes to copy
+ * @return 1's complement sum of the data actually read (not complemented)
+ **/
+
+uint16_t ipCopyChecksumFromBuffer(void *dest, const NetBuffer *src,
+   size_t srcOffset, size_t length)
+{
+   uint_t i;
+   uint_t n;
+   size_t totalLength;
+   uint8_t *p;
+   uint32_t checksum;
+
+   //Checksum preset value
+   checksum = 0x0000;
+   //Total number of bytes copied
+   totalLength = 0;
+
+   //Loop through data chunks
+   for(i = 0; i < src->chunkCount && totalLength < length; i++)
+   {
+      //Is there any data to copy from the current chunk?
+      if(srcOffset < src->chunk[i].length)
+      {
+         //Point to the first byte to be read
+         p = (uint8_t *) src->chunk[i].address + srcOffset;
+         //Compute the number of bytes to copy at a time
+         n = MIN(length - totalLength, src->chunk[i].length - srcOffset);
+
+         //Copy data and update checksum value
+         checksum = ipCombineChecksum(checksum,
+            ipCopyChecksumBlock(dest, p, n), totalLength);
+
+         //Advance write pointer
+         dest = (uint8_t *) dest + n;
+         //Total number of bytes copied
+         totalLength += n;
+         //Process the next block from the start
+         srcOffset = 0;
+      }
+      else
+      {
+         //Skip the current chunk
+         srcOffset -= src->chunk[i].length;
+      }
+   }
+
+   //Return 1's complement sum
+   return checksum;
+}
+
+
 /**
  * @brief Allocate a buffer to hold an IP packet
  * @param[in] length Desired payload length
@@ -104,6 +104,15 @@ uint16_t ipCalcUpperLayerChecksum(const void *pseudoHeader,
 uint16_t ipCalcUpperLayerChecksumEx(const void *pseudoHeader,
    size_t pseudoHeaderLength, const NetBuffer *buffer, size_t offset, size_t length);
 
+uint16_t ipCombineChecksum(uint16_t checksum, uint16_t partial, size_t offset);
+uint16_t ipCopyChecksum(void *dest, const void *src, size_t length);
+
+uint16_t ipCopyChecksumToBuffer(NetBuffer *dest,
+   size_t destOffset, const void *src, size_t length);
+
+uint16_t ipCopyChecksumFromBuffer(void *dest, const NetBuffer *src,
+   size_t srcOffset, size_t length);
+
 NetBuffer *ipAllocBuffer(size_t length, size_t *offset);
 
 error_t ipJoinMulticastGroup(NetInterface *interface, const IpAddr *groupAddr);
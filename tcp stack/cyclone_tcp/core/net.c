@@ -33,6 +33,7 @@
 #include <stdlib.h>
 #include "core/net.h"
 #include "core/socket.h"
+#include "core/net_timer.h"
 #include "core/tcp_timer.h"
 #include "core/ethernet.h"
 #include "ipv4/arp.h"
@@ -73,8 +74,6 @@ NetInterface netInterface[NET_INTERFACE_COUNT];
 
 //TCP/IP process state
 static bool_t netTaskRunning;
-//Timestamp
-static systime_t netTimestamp;
 //Pseudo-random number generator state
 static uint32_t prngState = 0;
 
@@ -92,6 +91,292 @@ static uint_t netTaskStack[NET_TASK_STACK_SIZE];
 
 #endif
 
+//Modules that still poll their state at a fixed rate
+static NetTimer nicTimer;
+#if (PPP_SUPPORT == ENABLED)
+static NetTimer pppTimer;
+#endif
+#if (IPV4_SUPPORT == ENABLED && IPV4_FRAG_SUPPORT == ENABLED)
+static NetTimer ipv4FragTimer;
+#endif
+#if (IPV4_SUPPORT == ENABLED && IGMP_SUPPORT == ENABLED)
+static NetTimer igmpTimer;
+#endif
+#if (IPV4_SUPPORT == ENABLED && AUTO_IP_SUPPORT == ENABLED)
+static NetTimer autoIpTimer;
+#endif
+#if (IPV4_SUPPORT == ENABLED && DHCP_CLIENT_SUPPORT == ENABLED)
+static NetTimer dhcpClientTimer;
+#endif
+#if (IPV6_SUPPORT == ENABLED && IPV6_FRAG_SUPPORT == ENABLED)
+static NetTimer ipv6FragTimer;
+#endif
+#if (IPV6_SUPPORT == ENABLED && MLD_SUPPORT == ENABLED)
+static NetTimer mldTimer;
+#endif
+#if (IPV6_SUPPORT == ENABLED && NDP_SUPPORT == ENABLED)
+static NetTimer ndpTimer;
+#endif
+#if (IPV6_SUPPORT == ENABLED && NDP_ROUTER_ADV_SUPPORT == ENABLED)
+static NetTimer ndpRouterAdvTimer;
+#endif
+#if (IPV6_SUPPORT == ENABLED && DHCPV6_CLIENT_SUPPORT == ENABLED)
+static NetTimer dhcpv6ClientTimer;
+#endif
+#if (MDNS_RESPONDER_SUPPORT == ENABLED)
+static NetTimer mdnsResponderTimer;
+#endif
+#if (DNS_SD_SUPPORT == ENABLED)
+static NetTimer dnsSdTimer;
+#endif
+
+
+/**
+ * @brief Periodic NIC operations such as polling the link state
+ * @param[in] param Unused parameter
+ **/
+
+static void netNicTimerHandler(void *param)
+{
+   uint_t i;
+
+   //Loop through network interfaces
+   for(i = 0; i < NET_INTERFACE_COUNT; i++)
+   {
+      //Make sure the interface has been properly configured
+      if(netInterface[i].configured)
+         nicTick(&netInterface[i]);
+   }
+}
+
+#if (PPP_SUPPORT == ENABLED)
+
+/**
+ * @brief Manage PPP related timers
+ * @param[in] param Unused parameter
+ **/
+
+static void netPppTimerHandler(void *param)
+{
+   uint_t i;
+
+   //Loop through network interfaces
+   for(i = 0; i < NET_INTERFACE_COUNT; i++)
+   {
+      //Make sure the interface has been properly configured
+      if(netInterface[i].configured)
+         pppTick(&netInterface[i]);
+   }
+}
+
+#endif
+#if (IPV4_SUPPORT == ENABLED && IPV4_FRAG_SUPPORT == ENABLED)
+
+/**
+ * @brief Handle IPv4 fragment reassembly timeout
+ * @param[in] param Unused parameter
+ **/
+
+static void netIpv4FragTimerHandler(void *param)
+{
+   uint_t i;
+
+   //Loop through network interfaces
+   for(i = 0; i < NET_INTERFACE_COUNT; i++)
+   {
+      //Make sure the interface has been properly configured
+      if(netInterface[i].configured)
+         ipv4FragTick(&netInterface[i]);
+   }
+}
+
+#endif
+#if (IPV4_SUPPORT == ENABLED && IGMP_SUPPORT == ENABLED)
+
+/**
+ * @brief Handle IGMP related timers
+ * @param[in] param Unused parameter
+ **/
+
+static void netIgmpTimerHandler(void *param)
+{
+   uint_t i;
+
+   //Loop through network interfaces
+   for(i = 0; i < NET_INTERFACE_COUNT; i++)
+   {
+      //Make sure the interface has been properly configured
+      if(netInterface[i].configured)
+         igmpTick(&netInterface[i]);
+   }
+}
+
+#endif
+#if (IPV4_SUPPORT == ENABLED && AUTO_IP_SUPPORT == ENABLED)
+
+/**
+ * @brief Handle Auto-IP related timers
+ * @param[in] param Unused parameter
+ **/
+
+static void netAutoIpTimerHandler(void *param)
+{
+   uint_t i;
+
+   //Loop through network interfaces
+   for(i = 0; i < NET_INTERFACE_COUNT; i++)
+      autoIpTick(netInterface[i].autoIpContext);
+}
+
+#endif
+#if (IPV4_SUPPORT == ENABLED && DHCP_CLIENT_SUPPORT == ENABLED)
+
+/**
+ * @brief Handle DHCP client related timers
+ * @param[in] param Unused parameter
+ **/
+
+static void netDhcpClientTimerHandler(void *param)
+{
+   uint_t i;
+
+   //Loop through network interfaces
+   for(i = 0; i < NET_INTERFACE_COUNT; i++)
+      dhcpClientTick(netInterface[i].dhcpClientContext);
+}
+
+#endif
+#if (IPV6_SUPPORT == ENABLED && IPV6_FRAG_SUPPORT == ENABLED)
+
+/**
+ * @brief Handle IPv6 fragment reassembly timeout
+ * @param[in] param Unused parameter
+ **/
+
+static void netIpv6FragTimerHandler(void *param)
+{
+   uint_t i;
+
+   //Loop through network interfaces
+   for(i = 0; i < NET_INTERFACE_COUNT; i++)
+   {
+      //Make sure the interface has been properly configured
+      if(netInterface[i].configured)
+         ipv6FragTick(&netInterface[i]);
+   }
+}
+
+#endif
+#if (IPV6_SUPPORT == ENABLED && MLD_SUPPORT == ENABLED)
+
+/**
+ * @brief Handle MLD related timers
+ * @param[in] param Unused parameter
+ **/
+
+static void netMldTimerHandler(void *param)
+{
+   uint_t i;
+
+   //Loop through network interfaces
+   for(i = 0; i < NET_INTERFACE_COUNT; i++)
+   {
+      //Make sure the interface has been properly configured
+      if(netInterface[i].configured)
+         mldTick(&netInterface[i]);
+   }
+}
+
+#endif
+#if (IPV6_SUPPORT == ENABLED && NDP_SUPPORT == ENABLED)
+
+/**
+ * @brief Handle NDP related timers
+ * @param[in] param Unused parameter
+ **/
+
+static void netNdpTimerHandler(void *param)
+{
+   uint_t i;
+
+   //Loop through network interfaces
+   for(i = 0; i < NET_INTERFACE_COUNT; i++)
+   {
+      //Make sure the interface has been properly configured
+      if(netInterface[i].configured)
+         ndpTick(&netInterface[i]);
+   }
+}
+
+#endif
+#if (IPV6_SUPPORT == ENABLED && NDP_ROUTER_ADV_SUPPORT == ENABLED)
+
+/**
+ * @brief Handle RA service related timers
+ * @param[in] param Unused parameter
+ **/
+
+static void netNdpRouterAdvTimerHandler(void *param)
+{
+   uint_t i;
+
+   //Loop through network interfaces
+   for(i = 0; i < NET_INTERFACE_COUNT; i++)
+      ndpRouterAdvTick(netInterface[i].ndpRouterAdvContext);
+}
+
+#endif
+#if (IPV6_SUPPORT == ENABLED && DHCPV6_CLIENT_SUPPORT == ENABLED)
+
+/**
+ * @brief Handle DHCPv6 client related timers
+ * @param[in] param Unused parameter
+ **/
+
+static void netDhcpv6ClientTimerHandler(void *param)
+{
+   uint_t i;
+
+   //Loop through network interfaces
+   for(i = 0; i < NET_INTERFACE_COUNT; i++)
+      dhcpv6ClientTick(netInterface[i].dhcpv6ClientContext);
+}
+
+#endif
+#if (MDNS_RESPONDER_SUPPORT == ENABLED)
+
+/**
+ * @brief Manage mDNS probing and announcing
+ * @param[in] param Unused parameter
+ **/
+
+static void netMdnsResponderTimerHandler(void *param)
+{
+   uint_t i;
+
+   //Loop through network interfaces
+   for(i = 0; i < NET_INTERFACE_COUNT; i++)
+      mdnsResponderTick(netInterface[i].mdnsResponderContext);
+}
+
+#endif
+#if (DNS_SD_SUPPORT == ENABLED)
+
+/**
+ * @brief Manage DNS-SD probing and announcing
+ * @param[in] param Unused parameter
+ **/
+
+static void netDnsSdTimerHandler(void *param)
+{
+   uint_t i;
+
+   //Loop through network interfaces
+   for(i = 0; i < NET_INTERFACE_COUNT; i++)
+      dnsSdTick(netInterface[i].dnsSdContext);
+}
+
+#endif
 
 /**
  * @brief TCP/IP stack initialization
@@ -106,8 +391,8 @@ error_t netInit(void)
 
    //The TCP/IP process is currently suspended
    netTaskRunning = FALSE;
-   //Get current time
-   netTimestamp = osGetSystemTime();
+   //Timers are started from now on
+   netTimerWheelInit();
 
    //Create a mutex to prevent simultaneous access to the TCP/IP stack
    if(!osCreateMutex(&netMutex))
@@ -213,54 +498,56 @@ error_t netInit(void)
    if(error) return error;
 #endif
 
-   //Initialize tick counters
-   nicTickCounter = 0;
-
+   //Start the periodic operations of the modules
+   netTimerInit(&nicTimer, netNicTimerHandler, NULL);
+   netTimerStartPeriodic(&nicTimer, NIC_TICK_INTERVAL);
 #if (PPP_SUPPORT == ENABLED)
-   pppTickCounter = 0;
-#endif
-#if (IPV4_SUPPORT == ENABLED && ETH_SUPPORT == ENABLED)
-   arpTickCounter = 0;
+   netTimerInit(&pppTimer, netPppTimerHandler, NULL);
+   netTimerStartPeriodic(&pppTimer, PPP_TICK_INTERVAL);
 #endif
 #if (IPV4_SUPPORT == ENABLED && IPV4_FRAG_SUPPORT == ENABLED)
-   ipv4FragTickCounter = 0;
+   netTimerInit(&ipv4FragTimer, netIpv4FragTimerHandler, NULL);
+   netTimerStartPeriodic(&ipv4FragTimer, IPV4_FRAG_TICK_INTERVAL);
 #endif
 #if (IPV4_SUPPORT == ENABLED && IGMP_SUPPORT == ENABLED)
-   igmpTickCounter = 0;
+   netTimerInit(&igmpTimer, netIgmpTimerHandler, NULL);
+   netTimerStartPeriodic(&igmpTimer, IGMP_TICK_INTERVAL);
 #endif
 #if (IPV4_SUPPORT == ENABLED && AUTO_IP_SUPPORT == ENABLED)
-   autoIpTickCounter = 0;
+   netTimerInit(&autoIpTimer, netAutoIpTimerHandler, NULL);
+   netTimerStartPeriodic(&autoIpTimer, AUTO_IP_TICK_INTERVAL);
 #endif
 #if (IPV4_SUPPORT == ENABLED && DHCP_CLIENT_SUPPORT == ENABLED)
-   dhcpClientTickCounter = 0;
+   netTimerInit(&dhcpClientTimer, netDhcpClientTimerHandler, NULL);
+   netTimerStartPeriodic(&dhcpClientTimer, DHCP_CLIENT_TICK_INTERVAL);
 #endif
 #if (IPV6_SUPPORT == ENABLED && IPV6_FRAG_SUPPORT == ENABLED)
-   ipv6FragTickCounter = 0;
+   netTimerInit(&ipv6FragTimer, netIpv6FragTimerHandler, NULL);
+   netTimerStartPeriodic(&ipv6FragTimer, IPV6_FRAG_TICK_INTERVAL);
 #endif
 #if (IPV6_SUPPORT == ENABLED && MLD_SUPPORT == ENABLED)
-   mldTickCounter = 0;
+   netTimerInit(&mldTimer, netMldTimerHandler, NULL);
+   netTimerStartPeriodic(&mldTimer, MLD_TICK_INTERVAL);
 #endif
 #if (IPV6_SUPPORT == ENABLED && NDP_SUPPORT == ENABLED)
-   ndpTickCounter = 0;
+   netTimerInit(&ndpTimer, netNdpTimerHandler, NULL);
+   netTimerStartPeriodic(&ndpTimer, NDP_TICK_INTERVAL);
 #endif
 #if (IPV6_SUPPORT == ENABLED && NDP_ROUTER_ADV_SUPPORT == ENABLED)
-   ndpRouterAdvTickCounter = 0;
+   netTimerInit(&ndpRouterAdvTimer, netNdpRouterAdvTimerHandler, NULL);
+   netTimerStartPeriodic(&ndpRouterAdvTimer, NDP_ROUTER_ADV_TICK_INTERVAL);
 #endif
 #if (IPV6_SUPPORT == ENABLED && DHCPV6_CLIENT_SUPPORT == ENABLED)
-   dhcpv6ClientTickCounter = 0;
-#endif
-#if (TCP_SUPPORT == ENABLED)
-   tcpTickCounter = 0;
-#endif
-#if (DNS_CLIENT_SUPPORT == ENABLED || MDNS_CLIENT_SUPPORT == ENABLED || \
-   NBNS_CLIENT_SUPPORT == ENABLED)
-   dnsTickCounter = 0;
+   netTimerInit(&dhcpv6ClientTimer, netDhcpv6ClientTimerHandler, NULL);
+   netTimerStartPeriodic(&dhcpv6ClientTimer, DHCPV6_CLIENT_TICK_INTERVAL);
 #endif
 #if (MDNS_RESPONDER_SUPPORT == ENABLED)
-   mdnsResponderTickCounter = 0;
+   netTimerInit(&mdnsResponderTimer, netMdnsResponderTimerHandler, NULL);
+   netTimerStartPeriodic(&mdnsResponderTimer, MDNS_RESPONDER_TICK_INTERVAL);
 #endif
 #if (DNS_SD_SUPPORT == ENABLED)
-   dnsSdTickCounter = 0;
+   netTimerInit(&dnsSdTimer, netDnsSdTimerHandler, NULL);
+   netTimerStartPeriodic(&dnsSdTimer, DNS_SD_TICK_INTERVAL);
 #endif
 
 #if (NET_STATIC_OS_RESOURCES == ENABLED)
@@ -948,25 +1235,29 @@ void netTask(void)
    while(1)
    {
 #endif
+      //Get exclusive access
+      osAcquireMutex(&netMutex);
       //Get current time
       time = osGetSystemTime();
+      //Sleep until the next timer expires
+      timeout = netTimerGetTimeout(time);
+      //Release exclusive access
+      osReleaseMutex(&netMutex);
+
+      //Receive notifications when a frame has been received, the link
+      //state of any network interfaces has changed, or a timer has been
+      //started with an earlier deadline
+      status = osWaitForEvent(&netEvent, timeout);
 
-      //Compute the maximum blocking time when waiting for an event
-      if(timeCompare(time, netTimestamp) < 0)
-         timeout = netTimestamp - time;
-      else
-         timeout = 0;
+      //Get exclusive access
+      osAcquireMutex(&netMutex);
 
-      //Receive notifications when a frame has been received, or the
-      //link state of any network interfaces has changed
-      status = osWaitForEvent(&netEvent, timeout);
+      //Handle the timers that have expired
+      netTick();
 
       //Check whether the specified event is in signaled state
       if(status)
       {
-         //Get exclusive access
-         osAcquireMutex(&netMutex);
-
          //Process events
          for(i = 0; i < NET_INTERFACE_COUNT; i++)
          {
@@ -1001,24 +1292,10 @@ void netTask(void)
                interface->nicDriver->enableIrq(interface);
             }
          }
-
-         //Release exclusive access
-         osReleaseMutex(&netMutex);
       }
 
-      //Check current time
-      if(timeCompare(time, netTimestamp) > 0)
-      {
-         //Get exclusive access
-         osAcquireMutex(&netMutex);
-         //Handle periodic operations
-         netTick();
-         //Release exclusive access
-         osReleaseMutex(&netMutex);
-
-         //Next event
-         netTimestamp = time + NET_TICK_INTERVAL;
-      }
+      //Release exclusive access
+      osReleaseMutex(&netMutex);
 #if (NET_RTOS_SUPPORT == ENABLED)
    }
 #endif
@@ -1027,294 +1304,17 @@ void netTask(void)
 
 /**
  * @brief Manage TCP/IP timers
+ *
+ * Runs the callbacks of the timers that have expired. The TCP connections,
+ * the ARP and DNS caches and the periodic operations of the other modules
+ * all share the same timer wheel
+ *
  **/
 
 void netTick(void)
 {
-   uint_t i;
-
-   //Increment tick counter
-   nicTickCounter += NET_TICK_INTERVAL;
-
-   //Handle periodic operations such as polling the link state
-   if(nicTickCounter >= NIC_TICK_INTERVAL)
-   {
-      //Loop through network interfaces
-      for(i = 0; i < NET_INTERFACE_COUNT; i++)
-      {
-         //Make sure the interface has been properly configured
-         if(netInterface[i].configured)
-            nicTick(&netInterface[i]);
-      }
-
-      //Reset tick counter
-      nicTickCounter = 0;
-   }
-
-#if (PPP_SUPPORT == ENABLED)
-   //Increment tick counter
-   pppTickCounter += NET_TICK_INTERVAL;
-
-   //Manage PPP related timers
-   if(pppTickCounter >= PPP_TICK_INTERVAL)
-   {
-      //Loop through network interfaces
-      for(i = 0; i < NET_INTERFACE_COUNT; i++)
-      {
-         //Make sure the interface has been properly configured
-         if(netInterface[i].configured)
-            pppTick(&netInterface[i]);
-      }
-
-      //Reset tick counter
-      pppTickCounter = 0;
-   }
-#endif
-
-#if (IPV4_SUPPORT == ENABLED && ETH_SUPPORT == ENABLED)
-   //Increment tick counter
-   arpTickCounter += NET_TICK_INTERVAL;
-
-   //Manage ARP cache
-   if(arpTickCounter >= ARP_TICK_INTERVAL)
-   {
-      //Loop through network interfaces
-      for(i = 0; i < NET_INTERFACE_COUNT; i++)
-      {
-         //Make sure the interface has been properly configured
-         if(netInterface[i].configured)
-            arpTick(&netInterface[i]);
-      }
-
-      //Reset tick counter
-      arpTickCounter = 0;
-   }
-#endif
-
-#if (IPV4_SUPPORT == ENABLED && IPV4_FRAG_SUPPORT == ENABLED)
-   //Increment tick counter
-   ipv4FragTickCounter += NET_TICK_INTERVAL;
-
-   //Handle IPv4 fragment reassembly timeout
-   if(ipv4FragTickCounter >= IPV4_FRAG_TICK_INTERVAL)
-   {
-      //Loop through network interfaces
-      for(i = 0; i < NET_INTERFACE_COUNT; i++)
-      {
-         //Make sure the interface has been properly configured
-         if(netInterface[i].configured)
-            ipv4FragTick(&netInterface[i]);
-      }
-
-      //Reset tick counter
-      ipv4FragTickCounter = 0;
-   }
-#endif
-
-#if (IPV4_SUPPORT == ENABLED && IGMP_SUPPORT == ENABLED)
-   //Increment tick counter
-   igmpTickCounter += NET_TICK_INTERVAL;
-
-   //Handle IGMP related timers
-   if(igmpTickCounter >= IGMP_TICK_INTERVAL)
-   {
-      //Loop through network interfaces
-      for(i = 0; i < NET_INTERFACE_COUNT; i++)
-      {
-         //Make sure the interface has been properly configured
-         if(netInterface[i].configured)
-            igmpTick(&netInterface[i]);
-      }
-
-      //Reset tick counter
-      igmpTickCounter = 0;
-   }
-#endif
-
-#if (IPV4_SUPPORT == ENABLED && AUTO_IP_SUPPORT == ENABLED)
-   //Increment tick counter
-   autoIpTickCounter += NET_TICK_INTERVAL;
-
-   //Handle Auto-IP related timers
-   if(autoIpTickCounter >= AUTO_IP_TICK_INTERVAL)
-   {
-      //Loop through network interfaces
-      for(i = 0; i < NET_INTERFACE_COUNT; i++)
-         autoIpTick(netInterface[i].autoIpContext);
-
-      //Reset tick counter
-      autoIpTickCounter = 0;
-   }
-#endif
-
-#if (IPV4_SUPPORT == ENABLED && DHCP_CLIENT_SUPPORT == ENABLED)
-   //Increment tick counter
-   dhcpClientTickCounter += NET_TICK_INTERVAL;
-
-   //Handle DHCP client related timers
-   if(dhcpClientTickCounter >= DHCP_CLIENT_TICK_INTERVAL)
-   {
-      //Loop through network interfaces
-      for(i = 0; i < NET_INTERFACE_COUNT; i++)
-         dhcpClientTick(netInterface[i].dhcpClientContext);
-
-      //Reset tick counter
-      dhcpClientTickCounter = 0;
-   }
-#endif
-
-#if (IPV6_SUPPORT == ENABLED && IPV6_FRAG_SUPPORT == ENABLED)
-   //Increment tick counter
-   ipv6FragTickCounter += NET_TICK_INTERVAL;
-
-   //Handle IPv6 fragment reassembly timeout
-   if(ipv6FragTickCounter >= IPV6_FRAG_TICK_INTERVAL)
-   {
-      //Loop through network interfaces
-      for(i = 0; i < NET_INTERFACE_COUNT; i++)
-      {
-         //Make sure the interface has been properly configured
-         if(netInterface[i].configured)
-            ipv6FragTick(&netInterface[i]);
-      }
-
-      //Reset tick counter
-      ipv6FragTickCounter = 0;
-   }
-#endif
-
-#if (IPV6_SUPPORT == ENABLED && MLD_SUPPORT == ENABLED)
-   //Increment tick counter
-   mldTickCounter += NET_TICK_INTERVAL;
-
-   //Handle MLD related timers
-   if(mldTickCounter >= MLD_TICK_INTERVAL)
-   {
-      //Loop through network interfaces
-      for(i = 0; i < NET_INTERFACE_COUNT; i++)
-      {
-         //Make sure the interface has been properly configured
-         if(netInterface[i].configured)
-            mldTick(&netInterface[i]);
-      }
-
-      //Reset tick counter
-      mldTickCounter = 0;
-   }
-#endif
-
-#if (IPV6_SUPPORT == ENABLED && NDP_SUPPORT == ENABLED)
-   //Increment tick counter
-   ndpTickCounter += NET_TICK_INTERVAL;
-
-   //Handle NDP related timers
-   if(ndpTickCounter >= NDP_TICK_INTERVAL)
-   {
-      //Loop through network interfaces
-      for(i = 0; i < NET_INTERFACE_COUNT; i++)
-      {
-         //Make sure the interface has been properly configured
-         if(netInterface[i].configured)
-            ndpTick(&netInterface[i]);
-      }
-
-      //Reset tick counter
-      ndpTickCounter = 0;
-   }
-#endif
-
-#if (IPV6_SUPPORT == ENABLED && NDP_ROUTER_ADV_SUPPORT == ENABLED)
-   //Increment tick counter
-   ndpRouterAdvTickCounter += NET_TICK_INTERVAL;
-
-   //Handle RA service related timers
-   if(ndpRouterAdvTickCounter >= NDP_ROUTER_ADV_TICK_INTERVAL)
-   {
-      //Loop through network interfaces
-      for(i = 0; i < NET_INTERFACE_COUNT; i++)
-         ndpRouterAdvTick(netInterface[i].ndpRouterAdvContext);
-
-      //Reset tick counter
-      ndpRouterAdvTickCounter = 0;
-   }
-#endif
-
-#if (IPV6_SUPPORT == ENABLED && DHCPV6_CLIENT_SUPPORT == ENABLED)
-   //Increment tick counter
-   dhcpv6ClientTickCounter += NET_TICK_INTERVAL;
-
-   //Handle DHCPv6 client related timers
-   if(dhcpv6ClientTickCounter >= DHCPV6_CLIENT_TICK_INTERVAL)
-   {
-      //Loop through network interfaces
-      for(i = 0; i < NET_INTERFACE_COUNT; i++)
-         dhcpv6ClientTick(netInterface[i].dhcpv6ClientContext);
-
-      //Reset tick counter
-      dhcpv6ClientTickCounter = 0;
-   }
-#endif
-
-#if (TCP_SUPPORT == ENABLED)
-   //Increment tick counter
-   tcpTickCounter += NET_TICK_INTERVAL;
-
-   //Manage TCP related timers
-   if(tcpTickCounter >= TCP_TICK_INTERVAL)
-   {
-      //TCP timer handler
-      tcpTick();
-      //Reset tick counter
-      tcpTickCounter = 0;
-   }
-#endif
-
-#if (DNS_CLIENT_SUPPORT == ENABLED || MDNS_CLIENT_SUPPORT == ENABLED || \
-NBNS_CLIENT_SUPPORT == ENABLED)
-   //Increment tick counter
-   dnsTickCounter += NET_TICK_INTERVAL;
-
-   //Manage DNS cache
-   if(dnsTickCounter >= DNS_TICK_INTERVAL)
-   {
-      //DNS timer handler
-      dnsTick();
-      //Reset tick counter
-      dnsTickCounter = 0;
-   }
-#endif
-
-#if (MDNS_RESPONDER_SUPPORT == ENABLED)
-   //Increment tick counter
-   mdnsResponderTickCounter += NET_TICK_INTERVAL;
-
-   //Manage mDNS probing and announcing
-   if(mdnsResponderTickCounter >= MDNS_RESPONDER_TICK_INTERVAL)
-   {
-      //Loop through network interfaces
-      for(i = 0; i < NET_INTERFACE_COUNT; i++)
-         mdnsResponderTick(netInterface[i].mdnsResponderContext);
-
-      //Reset tick counter
-      mdnsResponderTickCounter = 0;
-   }
-#endif
-
-#if (DNS_SD_SUPPORT == ENABLED)
-   //Increment tick counter
-   dnsSdTickCounter += NET_TICK_INTERVAL;
-
-   //Manage DNS-SD probing and announcing
-   if(dnsSdTickCounter >= DNS_SD_TICK_INTERVAL)
-   {
-      //Loop through network interfaces
-      for(i = 0; i < NET_INTERFACE_COUNT; i++)
-         dnsSdTick(netInterface[i].dnsSdContext);
-
-      //Reset tick counter
-      dnsSdTickCounter = 0;
-   }
-#endif
+   //Process the timer wheel
+   netTimerProcess(osGetSystemTime());
 }
 
 
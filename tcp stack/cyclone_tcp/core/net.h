@@ -38,6 +38,7 @@ struct _NetInterface;
 #include "net_config.h"
 #include "core/net_legacy.h"
 #include "core/net_mem.h"
+#include "core/net_timer.h"
 #include "core/nic.h"
 #include "core/ethernet.h"
 #include "ipv4/ipv4.h"
@@ -130,13 +131,6 @@ struct _NetInterface;
    #define NET_TASK_PRIORITY OS_TASK_PRIORITY_HIGH
 #endif
 
-//TCP/IP stack tick interval
-#ifndef NET_TICK_INTERVAL
-   #define NET_TICK_INTERVAL 100
-#elif (NET_TICK_INTERVAL < 10)
-   #error NET_TICK_INTERVAL parameter is not valid
-#endif
-
 
 /**
  * @brief Structure describing a network interface
@@ -173,6 +167,7 @@ struct _NetInterface
 #if (IPV4_SUPPORT == ENABLED)
    Ipv4Context ipv4Context;                       ///<IPv4 context
    ArpCacheEntry arpCache[ARP_CACHE_SIZE];        ///<ARP cache
+   NetTimer arpTimer;                             ///<Next ARP cache entry to time out
 #if (IGMP_SUPPORT == ENABLED)
    systime_t igmpv1RouterPresentTimer;            ///<IGMPv1 router present timer
    bool_t igmpv1RouterPresent;                    ///<An IGMPv1 query has been recently heard
@@ -213,6 +208,8 @@ struct _NetInterface
    PppContext *pppContext;                        ///<PPP context
 #endif
 
+   const struct _TcpProfile *tcpProfile;          ///<TCP settings (NULL for the defaults)
+
 #if (MIB2_SUPPORT == ENABLED)
    Mib2IfEntry *mibIfEntry;
 #endif
@@ -0,0 +1,428 @@
+/**
+ * @file net_accounting.c
+ * @brief Per-frame traffic accounting
+ *
+ * @section License
+ *
+ * Copyright (C) 2010-2016 Oryx Embedded SARL. All rights reserved.
+ *
+ * This file is part of CycloneTCP Open.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * @section Description
+ *
+ * The NIC layer hands every frame sent or received on an Ethernet or PPP
+ * interface to the accounting, next to the packet capture. The link, IP
+ * and transport headers are parsed in place, and the callback registered
+ * by the application receives the length of the frame split between the
+ * link layer and the IP datagram, with the IP protocol and the ports, so
+ * that it can charge the frame to a traffic class. A VJ compressed TCP
+ * segment only carries the slot of its connection: the ports are learnt
+ * from the uncompressed segment that set up the slot
+ *
+ * @author Oryx Embedded SARL (www.oryx-embedded.com)
+ * @version 1.7.5b
+ **/
+
+//Switch to the appropriate trace level
+#define TRACE_LEVEL TRACE_LEVEL_INFO
+
+//Dependencies
+#include "core/net.h"
+#include "core/net_accounting.h"
+#include "core/nic.h"
+#include "core/ethernet.h"
+#include "ipv4/ipv4.h"
+#include "ppp/ppp.h"
+#include "ppp/ppp_vj.h"
+#include "debug.h"
+
+//Check TCP/IP stack configuration
+#if (NET_ACCOUNTING_SUPPORT == ENABLED)
+
+//IPv6 header size
+#define NET_ACCOUNTING_IPV6_HEADER_SIZE 40
+//Closing flag of a PPP frame
+#define NET_ACCOUNTING_PPP_FLAG_SIZE 1
+
+
+/**
+ * @brief Ports of a VJ connection slot
+ **/
+
+typedef struct
+{
+   uint16_t srcPort;
+   uint16_t destPort;
+} NetAccountingVjSlot;
+
+
+//Callback invoked for each frame
+static NetAccountingCallback netAccountingCallback = NULL;
+//Callback parameter
+static void *netAccountingParam = NULL;
+
+#if (PPP_SUPPORT == ENABLED && PPP_VJ_SUPPORT == ENABLED)
+//Ports of the VJ connections, per interface and direction
+static NetAccountingVjSlot netAccountingVjSlots[NET_INTERFACE_COUNT][2][PPP_VJ_MAX_SLOTS];
+//Slot of the last VJ segment, per interface and direction
+static uint8_t netAccountingVjLastSlot[NET_INTERFACE_COUNT][2];
+#endif
+
+
+/**
+ * @brief Parse the IP and transport headers of a datagram
+ * @param[in,out] frame Frame being accounted
+ * @param[in] protocol EtherType of the datagram
+ * @param[in] p Captured bytes, starting with the IP header
+ * @param[in] length Number of captured bytes
+ * @param[in] payloadLength Length of the frame payload
+ **/
+
+static void netAccountingParseIp(NetAccountingFrame *frame,
+   uint16_t protocol, const uint8_t *p, size_t length, size_t payloadLength)
+{
+   size_t n;
+   size_t ipLength;
+   uint16_t fragOffset;
+
+   //IPv4 datagram?
+   if(protocol == ETH_TYPE_IPV4)
+   {
+      //Malformed datagram?
+      if(length < sizeof(Ipv4Header) || (p[0] >> 4) != 4)
+         return;
+
+      //Retrieve the header length, protocol and fragment offset
+      n = (p[0] & 0x0F) * 4;
+      ipLength = LOAD16BE(p + 2);
+      frame->ipProtocol = p[9];
+      fragOffset = LOAD16BE(p + 6) & 0x1FFF;
+   }
+   //IPv6 datagram?
+   else if(protocol == ETH_TYPE_IPV6)
+   {
+      //Malformed datagram?
+      if(length < NET_ACCOUNTING_IPV6_HEADER_SIZE)
+         return;
+
+      //Extension headers are not followed
+      n = NET_ACCOUNTING_IPV6_HEADER_SIZE;
+      ipLength = NET_ACCOUNTING_IPV6_HEADER_SIZE + LOAD16BE(p + 4);
+      frame->ipProtocol = p[6];
+      fragOffset = 0;
+   }
+   else
+   {
+      //Not an IP datagram
+      return;
+   }
+
+   //Ethernet padding belongs to the link layer
+   if(ipLength < payloadLength)
+   {
+      frame->linkLength += payloadLength - ipLength;
+      frame->ipLength = ipLength;
+   }
+
+   //Only the first fragment of a TCP or UDP datagram carries the ports
+   if(frame->ipProtocol != IPV4_PROTOCOL_TCP && frame->ipProtocol != IPV4_PROTOCOL_UDP)
+      return;
+   if(fragOffset != 0 || length < (n + 4))
+      return;
+
+   //Retrieve the ports
+   frame->srcPort = LOAD16BE(p + n);
+   frame->destPort = LOAD16BE(p + n + 2);
+}
+
+
+#if (PPP_SUPPORT == ENABLED && PPP_VJ_SUPPORT == ENABLED)
+
+/**
+ * @brief Parse a VJ compressed or uncompressed TCP segment
+ * @param[in,out] frame Frame being accounted
+ * @param[in] protocol PPP protocol of the frame
+ * @param[in] p Captured bytes, starting with the VJ header
+ * @param[in] length Number of captured bytes
+ **/
+
+static void netAccountingParseVj(NetAccountingFrame *frame,
+   uint16_t protocol, const uint8_t *p, size_t length)
+{
+   uint_t i;
+   uint_t slot;
+   size_t n;
+
+   //Index of the interface
+   i = frame->interface - netInterface;
+   //VJ segments are TCP/IP datagrams
+   frame->protocol = ETH_TYPE_IPV4;
+   frame->ipProtocol = IPV4_PROTOCOL_TCP;
+
+   //Uncompressed segment?
+   if(protocol == PPP_PROTOCOL_VJ_UNCOMP)
+   {
+      //Malformed segment?
+      if(length < sizeof(Ipv4Header))
+         return;
+
+      //The protocol field of the IP header holds the slot
+      n = (p[0] & 0x0F) * 4;
+      slot = p[9];
+      //Invalid slot or truncated header?
+      if(slot >= PPP_VJ_MAX_SLOTS || length < (n + 4))
+         return;
+
+      //Remember the ports of the connection
+      netAccountingVjSlots[i][frame->direction][slot].srcPort = LOAD16BE(p + n);
+      netAccountingVjSlots[i][frame->direction][slot].destPort = LOAD16BE(p + n + 2);
+   }
+   else
+   {
+      //Malformed segment?
+      if(length < 1)
+         return;
+
+      //The slot is omitted when it is the same as the previous segment
+      if(p[0] & PPP_VJ_NEW_C)
+      {
+         if(length < 2)
+            return;
+         slot = p[1];
+      }
+      else
+      {
+         slot = netAccountingVjLastSlot[i][frame->direction];
+      }
+
+      //Invalid slot?
+      if(slot >= PPP_VJ_MAX_SLOTS)
+         return;
+   }
+
+   //Save the slot of the segment
+   netAccountingVjLastSlot[i][frame->direction] = slot;
+
+   //Retrieve the ports of the connection
+   frame->srcPort = netAccountingVjSlots[i][frame->direction][slot].srcPort;
+   frame->destPort = netAccountingVjSlots[i][frame->direction][slot].destPort;
+}
+
+#endif
+
+
+/**
+ * @brief Split a frame between link layer and IP, then report it
+ * @param[in] interface Underlying network interface
+ * @param[in] direction Direction of the frame
+ * @param[in] p First bytes of the frame
+ * @param[in] capLength Number of bytes available at p
+ * @param[in] length Length of the frame
+ **/
+
+static void netAccountingProcess(NetInterface *interface, uint8_t direction,
+   const uint8_t *p, size_t capLength, size_t length)
+{
+   NicType type;
+   size_t n;
+   size_t trailer;
+   uint16_t protocol;
+   NetAccountingFrame frame;
+
+   //Retrieve interface type
+   type = interface->nicDriver->type;
+
+   //Ethernet frame?
+   if(type == NIC_TYPE_ETHERNET)
+   {
+      //Malformed frame?
+      if(capLength < sizeof(EthHeader))
+         return;
+
+      //Retrieve the EtherType
+      protocol = LOAD16BE(p + 12);
+      n = sizeof(EthHeader);
+
+      //The CRC is part of received frames unless the controller strips it
+      if(direction == NET_ACCOUNTING_DIR_RX && !interface->nicDriver->autoCrcStrip)
+         trailer = ETH_CRC_SIZE;
+      else
+         trailer = 0;
+
+      //Header and CRC sent on the wire
+      frame.linkLength = n + ETH_CRC_SIZE;
+   }
+   else if(type == NIC_TYPE_PPP)
+   {
+#if (PPP_SUPPORT == ENABLED)
+      //Decompress the PPP header
+      n = pppParseFrameHeader(p, capLength, &protocol);
+      //Malformed frame?
+      if(!n)
+         return;
+
+      //The FCS is part of the frame unless the driver handles it
+      if(direction == NET_ACCOUNTING_DIR_RX && !interface->nicDriver->autoCrcStrip)
+         trailer = PPP_FCS_SIZE;
+      else if(direction == NET_ACCOUNTING_DIR_TX && !interface->nicDriver->autoCrcCalc)
+         trailer = PPP_FCS_SIZE;
+      else
+         trailer = 0;
+
+      //Header, FCS and closing flag sent on the wire (escape bytes added
+      //by the HDLC framing are not counted)
+      frame.linkLength = n + PPP_FCS_SIZE + NET_ACCOUNTING_PPP_FLAG_SIZE;
+
+      //IP datagrams are reported with the corresponding EtherType
+      if(protocol == PPP_PROTOCOL_IP)
+         protocol = ETH_TYPE_IPV4;
+      else if(protocol == PPP_PROTOCOL_IPV6)
+         protocol = ETH_TYPE_IPV6;
+#else
+      //PPP is not supported
+      return;
+#endif
+   }
+   else
+   {
+      //Other interface types are not accounted
+      return;
+   }
+
+   //Malformed frame?
+   if(length < (n + trailer))
+      return;
+
+   //Length of the payload
+   length -= n + trailer;
+   capLength = MIN(capLength, n + length);
+
+   //Fill in the frame information
+   frame.interface = interface;
+   frame.direction = direction;
+   frame.protocol = protocol;
+   frame.ipLength = 0;
+   frame.ipProtocol = 0;
+   frame.srcPort = 0;
+   frame.destPort = 0;
+
+   //IP datagram?
+   if(protocol == ETH_TYPE_IPV4 || protocol == ETH_TYPE_IPV6)
+   {
+      frame.ipLength = length;
+      netAccountingParseIp(&frame, protocol, p + n, capLength - n, length);
+   }
+#if (PPP_SUPPORT == ENABLED && PPP_VJ_SUPPORT == ENABLED)
+   //VJ compressed or uncompressed TCP/IP?
+   else if(type == NIC_TYPE_PPP && (protocol == PPP_PROTOCOL_VJ_COMP ||
+      protocol == PPP_PROTOCOL_VJ_UNCOMP))
+   {
+      frame.ipLength = length;
+      netAccountingParseVj(&frame, protocol, p + n, capLength - n);
+   }
+#endif
+   else
+   {
+      //The whole frame belongs to the link layer (ARP, LCP, IPCP...)
+      frame.linkLength += length;
+   }
+
+   //Report the frame
+   netAccountingCallback(&frame, netAccountingParam);
+}
+
+
+/**
+ * @brief Register the accounting callback
+ *
+ * The callback runs in the context of the task that sends or receives the
+ * frame, with the stack mutex held, so it must only update counters
+ *
+ * @param[in] callback Function called for each frame (NULL to stop)
+ * @param[in] param Callback parameter
+ * @return Error code
+ **/
+
+error_t netAccountingRegisterCallback(NetAccountingCallback callback,
+   void *param)
+{
+   //Get exclusive access
+   osAcquireMutex(&netMutex);
+
+   //Save the callback
+   netAccountingCallback = callback;
+   netAccountingParam = param;
+
+   //Release exclusive access
+   osReleaseMutex(&netMutex);
+
+   //Successful processing
+   return NO_ERROR;
+}
+
+
+/**
+ * @brief Account for a frame passed to the network controller
+ * @param[in] interface Underlying network interface
+ * @param[in] buffer Multi-part buffer containing the frame
+ * @param[in] offset Offset to the first byte of the frame
+ **/
+
+void netAccountingTxPacket(NetInterface *interface,
+   const NetBuffer *buffer, size_t offset)
+{
+   size_t length;
+   size_t capLength;
+   uint8_t header[NET_ACCOUNTING_HEADER_LEN];
+
+   //No callback registered?
+   if(netAccountingCallback == NULL)
+      return;
+
+   //Retrieve the length of the frame
+   length = netBufferGetLength(buffer) - offset;
+
+   //Copy the headers, which may span several chunks
+   capLength = netBufferRead(header, buffer, offset,
+      MIN(length, NET_ACCOUNTING_HEADER_LEN));
+
+   //Report the frame
+   netAccountingProcess(interface, NET_ACCOUNTING_DIR_TX, header,
+      capLength, length);
+}
+
+
+/**
+ * @brief Account for a frame received by the network controller
+ * @param[in] interface Underlying network interface
+ * @param[in] packet Incoming frame
+ * @param[in] length Length of the frame
+ **/
+
+void netAccountingRxPacket(NetInterface *interface,
+   const uint8_t *packet, size_t length)
+{
+   //No callback registered?
+   if(netAccountingCallback == NULL)
+      return;
+
+   //Report the frame
+   netAccountingProcess(interface, NET_ACCOUNTING_DIR_RX, packet,
+      length, length);
+}
+
+#endif
@@ -0,0 +1,97 @@
+/**
+ * @file net_accounting.h
+ * @brief Per-frame traffic accounting
+ *
+ * @section License
+ *
+ * Copyright (C) 2010-2016 Oryx Embedded SARL. All rights reserved.
+ *
+ * This file is part of CycloneTCP Open.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * @author Oryx Embedded SARL (www.oryx-embedded.com)
+ * @version 1.7.5b
+ **/
+
+#ifndef _NET_ACCOUNTING_H
+#define _NET_ACCOUNTING_H
+
+//Dependencies
+#include "core/net.h"
+#include "core/net_mem.h"
+
+//Traffic accounting support
+#ifndef NET_ACCOUNTING_SUPPORT
+   #define NET_ACCOUNTING_SUPPORT DISABLED
+#elif (NET_ACCOUNTING_SUPPORT != ENABLED && NET_ACCOUNTING_SUPPORT != DISABLED)
+   #error NET_ACCOUNTING_SUPPORT parameter is not valid
+#endif
+
+//Number of bytes parsed from each frame (link, IP and transport headers)
+#ifndef NET_ACCOUNTING_HEADER_LEN
+   #define NET_ACCOUNTING_HEADER_LEN 80
+#elif (NET_ACCOUNTING_HEADER_LEN < 40 || NET_ACCOUNTING_HEADER_LEN > 128)
+   #error NET_ACCOUNTING_HEADER_LEN parameter is not valid
+#endif
+
+//Direction of a frame
+#define NET_ACCOUNTING_DIR_RX 0
+#define NET_ACCOUNTING_DIR_TX 1
+
+
+/**
+ * @brief Frame seen by the network controller
+ *
+ * The length of the frame is split between the link layer and the IP
+ * datagram it carries. The link layer accounts for the bytes sent on the
+ * wire around the datagram: Ethernet header and CRC, or PPP header, FCS
+ * and closing flag. Frames that do not carry an IP datagram (ARP, LCP,
+ * IPCP, PAP, CHAP...) are link layer bytes only. VJ compressed TCP
+ * segments are reported with the ports of their connection
+ **/
+
+typedef struct
+{
+   NetInterface *interface; ///<Underlying network interface
+   uint8_t direction;       ///<NET_ACCOUNTING_DIR_RX or NET_ACCOUNTING_DIR_TX
+   uint16_t protocol;       ///<EtherType, or PPP protocol of non-IP frames
+   size_t linkLength;       ///<Number of link layer bytes
+   size_t ipLength;         ///<Length of the IP datagram (0 if none)
+   uint8_t ipProtocol;      ///<IP protocol (TCP, UDP, ICMP...)
+   uint16_t srcPort;        ///<TCP or UDP source port (0 if unknown)
+   uint16_t destPort;       ///<TCP or UDP destination port (0 if unknown)
+} NetAccountingFrame;
+
+
+/**
+ * @brief Callback invoked for each frame, with the stack mutex held
+ **/
+
+typedef void (*NetAccountingCallback)(const NetAccountingFrame *frame,
+   void *param);
+
+
+//Traffic accounting related functions
+error_t netAccountingRegisterCallback(NetAccountingCallback callback,
+   void *param);
+
+void netAccountingTxPacket(NetInterface *interface,
+   const NetBuffer *buffer, size_t offset);
+
+void netAccountingRxPacket(NetInterface *interface,
+   const uint8_t *packet, size_t length);
+
+#endif
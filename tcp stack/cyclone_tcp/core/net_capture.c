@@ -0,0 +1,534 @@
+/**
+ * @file net_capture.c
+ * @brief In-RAM packet capture with pcap export
+ *
+ * @section License
+ *
+ * Copyright (C) 2010-2016 Oryx Embedded SARL. All rights reserved.
+ *
+ * This file is part of CycloneTCP Open.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * @section Description
+ *
+ * The NIC layer hands every frame sent or received on an Ethernet or PPP
+ * interface to the capture while it is running. The first bytes of the
+ * frame are copied into the next slot of a fixed ring, the filter is
+ * applied to that copy, and the slot is kept only if the frame matches.
+ * When the ring is full, the oldest frames are overwritten. Once the
+ * capture is stopped, the frames of one interface can be exported as a
+ * standard pcap file through a write callback. PPP frames are exported
+ * with a one-byte direction pseudo-header, so that the negotiation can be
+ * followed from both ends
+ *
+ * @author Oryx Embedded SARL (www.oryx-embedded.com)
+ * @version 1.7.5b
+ **/
+
+//Switch to the appropriate trace level
+#define TRACE_LEVEL TRACE_LEVEL_INFO
+
+//Dependencies
+#include "core/net.h"
+#include "core/net_capture.h"
+#include "core/nic.h"
+#include "core/ethernet.h"
+#include "ipv4/ipv4.h"
+#include "ppp/ppp.h"
+#include "debug.h"
+
+//Check TCP/IP stack configuration
+#if (NET_CAPTURE_SUPPORT == ENABLED)
+
+//pcap file format
+#define PCAP_MAGIC_NUMBER   0xA1B2C3D4
+#define PCAP_VERSION_MAJOR  2
+#define PCAP_VERSION_MINOR  4
+
+//IPv6 header size
+#define NET_CAPTURE_IPV6_HEADER_SIZE 40
+
+
+/**
+ * @brief pcap global header
+ **/
+
+typedef __start_packed struct
+{
+   uint32_t magicNumber;
+   uint16_t versionMajor;
+   uint16_t versionMinor;
+   int32_t thisZone;
+   uint32_t sigFigs;
+   uint32_t snapLen;
+   uint32_t network;
+} __end_packed PcapHeader;
+
+
+/**
+ * @brief pcap record header
+ **/
+
+typedef __start_packed struct
+{
+   uint32_t tsSec;
+   uint32_t tsUsec;
+   uint32_t inclLen;
+   uint32_t origLen;
+} __end_packed PcapRecordHeader;
+
+
+/**
+ * @brief Captured frame
+ **/
+
+typedef struct
+{
+   systime_t timestamp;                ///<Time at which the frame was seen
+   NetInterface *interface;            ///<Underlying network interface
+   uint16_t length;                    ///<Length of the frame
+   uint16_t capLength;                 ///<Number of bytes kept
+   uint8_t direction;                  ///<Direction of the frame
+   uint8_t data[NET_CAPTURE_SNAP_LEN]; ///<First bytes of the frame
+} NetCaptureRecord;
+
+
+//Capture is running
+bool_t netCaptureRunning = FALSE;
+
+//Active filter
+static NetCaptureFilter netCaptureFilter;
+//Ring of captured frames
+static NetCaptureRecord netCaptureRing[NET_CAPTURE_RECORD_COUNT];
+//Slot receiving the next frame
+static uint_t netCaptureIndex;
+//Number of frames held in the ring
+static uint_t netCaptureCount;
+//Number of frames overwritten since the capture was started
+static uint32_t netCaptureLost;
+
+
+/**
+ * @brief Check a captured frame against the filter
+ * @param[in] type Interface type
+ * @param[in] p Captured bytes, starting with the link header
+ * @param[in] length Number of captured bytes
+ * @return TRUE if the frame matches the filter, else FALSE
+ **/
+
+static bool_t netCaptureMatch(NicType type, const uint8_t *p, size_t length)
+{
+   size_t n;
+   uint16_t protocol;
+   uint8_t ipProtocol;
+   uint16_t fragOffset;
+
+   //Fast path when no filter is set
+   if(!netCaptureFilter.protocol && !netCaptureFilter.ipProtocol &&
+      !netCaptureFilter.port)
+   {
+      return TRUE;
+   }
+
+   //Ethernet frame?
+   if(type == NIC_TYPE_ETHERNET)
+   {
+      //Malformed frame?
+      if(length < sizeof(EthHeader))
+         return FALSE;
+
+      //Retrieve the EtherType
+      protocol = LOAD16BE(p + 12);
+      n = sizeof(EthHeader);
+   }
+   else
+   {
+#if (PPP_SUPPORT == ENABLED)
+      //Decompress the PPP header
+      n = pppParseFrameHeader(p, length, &protocol);
+      //Malformed frame?
+      if(!n)
+         return FALSE;
+
+      //IP datagrams match the corresponding EtherType
+      if(protocol == PPP_PROTOCOL_IP)
+         protocol = ETH_TYPE_IPV4;
+      else if(protocol == PPP_PROTOCOL_IPV6)
+         protocol = ETH_TYPE_IPV6;
+#else
+      //PPP is not supported
+      return FALSE;
+#endif
+   }
+
+   //Check the protocol
+   if(netCaptureFilter.protocol && netCaptureFilter.protocol != protocol)
+      return FALSE;
+   //No need to look further if the IP header is not filtered
+   if(!netCaptureFilter.ipProtocol && !netCaptureFilter.port)
+      return TRUE;
+
+   //Point to the IP header
+   p += n;
+   length -= n;
+
+   //IPv4 datagram?
+   if(protocol == ETH_TYPE_IPV4)
+   {
+      //Malformed datagram?
+      if(length < sizeof(Ipv4Header) || (p[0] >> 4) != 4)
+         return FALSE;
+
+      //Retrieve the header length, protocol and fragment offset
+      n = (p[0] & 0x0F) * 4;
+      ipProtocol = p[9];
+      fragOffset = LOAD16BE(p + 6) & 0x1FFF;
+   }
+   //IPv6 datagram?
+   else if(protocol == ETH_TYPE_IPV6)
+   {
+      //Malformed datagram?
+      if(length < NET_CAPTURE_IPV6_HEADER_SIZE)
+         return FALSE;
+
+      //Extension headers are not followed
+      n = NET_CAPTURE_IPV6_HEADER_SIZE;
+      ipProtocol = p[6];
+      fragOffset = 0;
+   }
+   else
+   {
+      //Not an IP datagram
+      return FALSE;
+   }
+
+   //Check the IP protocol
+   if(netCaptureFilter.ipProtocol && netCaptureFilter.ipProtocol != ipProtocol)
+      return FALSE;
+   //No port to check?
+   if(!netCaptureFilter.port)
+      return TRUE;
+
+   //Only the first fragment of a TCP or UDP datagram carries the ports
+   if(ipProtocol != IPV4_PROTOCOL_TCP && ipProtocol != IPV4_PROTOCOL_UDP)
+      return FALSE;
+   if(fragOffset != 0 || length < (n + 4))
+      return FALSE;
+
+   //Match either the source or the destination port
+   if(LOAD16BE(p + n) == netCaptureFilter.port)
+      return TRUE;
+   if(LOAD16BE(p + n + 2) == netCaptureFilter.port)
+      return TRUE;
+
+   //The frame does not match the filter
+   return FALSE;
+}
+
+
+/**
+ * @brief Keep the frame copied into the current slot if it matches
+ * @param[in] interface Underlying network interface
+ * @param[in] length Length of the frame
+ * @param[in] direction Direction of the frame
+ **/
+
+static void netCaptureCommit(NetInterface *interface, size_t length,
+   uint8_t direction)
+{
+   NicType type;
+   NetCaptureRecord *record;
+
+   //Point to the current slot
+   record = &netCaptureRing[netCaptureIndex];
+   //Retrieve interface type
+   type = interface->nicDriver->type;
+
+   //PPP frame?
+   if(type == NIC_TYPE_PPP)
+   {
+      //The FCS is not part of the capture
+      if(length < PPP_FCS_SIZE)
+         return;
+
+      length -= PPP_FCS_SIZE;
+      record->capLength = MIN(record->capLength, length);
+   }
+   else if(type != NIC_TYPE_ETHERNET)
+   {
+      //Other interface types are not captured
+      return;
+   }
+
+   //Apply the filter
+   if(!netCaptureMatch(type, record->data, record->capLength))
+      return;
+
+   //Save frame information
+   record->timestamp = osGetSystemTime();
+   record->interface = interface;
+   record->length = length;
+   record->direction = direction;
+
+   //Advance to the next slot
+   if(++netCaptureIndex >= NET_CAPTURE_RECORD_COUNT)
+      netCaptureIndex = 0;
+
+   //The oldest frame is overwritten when the ring is full
+   if(netCaptureCount < NET_CAPTURE_RECORD_COUNT)
+      netCaptureCount++;
+   else
+      netCaptureLost++;
+}
+
+
+/**
+ * @brief Start capturing frames
+ *
+ * Any frame previously captured is discarded
+ *
+ * @param[in] filter Capture filter (NULL to capture every frame)
+ * @return Error code
+ **/
+
+error_t netCaptureStart(const NetCaptureFilter *filter)
+{
+   //Check the direction flags
+   if(filter != NULL && (filter->direction & ~NET_CAPTURE_DIR_ANY))
+      return ERROR_INVALID_PARAMETER;
+
+   //Get exclusive access
+   osAcquireMutex(&netMutex);
+
+   //Save the filter
+   if(filter != NULL)
+      netCaptureFilter = *filter;
+   else
+      memset(&netCaptureFilter, 0, sizeof(NetCaptureFilter));
+
+   //Capture both directions by default
+   if(!netCaptureFilter.direction)
+      netCaptureFilter.direction = NET_CAPTURE_DIR_ANY;
+
+   //Empty the ring
+   netCaptureIndex = 0;
+   netCaptureCount = 0;
+   netCaptureLost = 0;
+
+   //Start capturing
+   netCaptureRunning = TRUE;
+
+   //Release exclusive access
+   osReleaseMutex(&netMutex);
+
+   //Successful processing
+   return NO_ERROR;
+}
+
+
+/**
+ * @brief Stop capturing frames
+ *
+ * The captured frames are kept until the capture is started again
+ **/
+
+void netCaptureStop(void)
+{
+   //Get exclusive access
+   osAcquireMutex(&netMutex);
+
+   //Stop capturing
+   netCaptureRunning = FALSE;
+
+   //Debug message
+   TRACE_INFO("Capture stopped: %u frames held, %" PRIu32 " overwritten\r\n",
+      netCaptureCount, netCaptureLost);
+
+   //Release exclusive access
+   osReleaseMutex(&netMutex);
+}
+
+
+/**
+ * @brief Export the frames captured on an interface as a pcap file
+ *
+ * The capture must be stopped, so that the ring does not change while
+ * the callback sends the file over the network
+ *
+ * @param[in] interface Interface whose frames are exported
+ * @param[in] callback Function called to write each chunk of the file
+ * @param[in] param Callback parameter
+ * @param[out] count Number of frames exported (optional)
+ * @return Error code
+ **/
+
+error_t netCaptureExport(NetInterface *interface,
+   NetCaptureWriteCallback callback, void *param, uint_t *count)
+{
+   error_t error;
+   uint_t i;
+   uint_t n;
+   uint_t index;
+   PcapHeader header;
+   PcapRecordHeader recordHeader;
+   NetCaptureRecord *record;
+   uint8_t direction;
+   size_t dirLength;
+
+   //Check parameters
+   if(interface == NULL || callback == NULL)
+      return ERROR_INVALID_PARAMETER;
+   //The ring must not change during the export
+   if(netCaptureRunning)
+      return ERROR_WRONG_STATE;
+
+   //Format the global header
+   header.magicNumber = htole32(PCAP_MAGIC_NUMBER);
+   header.versionMajor = htole16(PCAP_VERSION_MAJOR);
+   header.versionMinor = htole16(PCAP_VERSION_MINOR);
+   header.thisZone = 0;
+   header.sigFigs = 0;
+
+   //Select the link type
+   if(interface->nicDriver->type == NIC_TYPE_ETHERNET)
+   {
+      header.network = htole32(PCAP_LINKTYPE_ETHERNET);
+      dirLength = 0;
+   }
+   else if(interface->nicDriver->type == NIC_TYPE_PPP)
+   {
+      //PPP frames are preceded by their direction
+      header.network = htole32(PCAP_LINKTYPE_PPP_WITH_DIR);
+      dirLength = sizeof(uint8_t);
+   }
+   else
+   {
+      return ERROR_INVALID_INTERFACE;
+   }
+
+   //Largest record
+   header.snapLen = htole32(NET_CAPTURE_SNAP_LEN + dirLength);
+
+   //Write the global header
+   error = callback(param, &header, sizeof(PcapHeader));
+
+   //Start with the oldest frame
+   index = netCaptureIndex + NET_CAPTURE_RECORD_COUNT - netCaptureCount;
+   n = 0;
+
+   //Walk through the ring
+   for(i = 0; i < netCaptureCount && !error; i++)
+   {
+      //Point to the current frame
+      record = &netCaptureRing[(index + i) % NET_CAPTURE_RECORD_COUNT];
+
+      //Skip frames captured on other interfaces
+      if(record->interface != interface)
+         continue;
+
+      //Format the record header
+      recordHeader.tsSec = htole32(record->timestamp / 1000);
+      recordHeader.tsUsec = htole32((record->timestamp % 1000) * 1000);
+      recordHeader.inclLen = htole32(record->capLength + dirLength);
+      recordHeader.origLen = htole32(record->length + dirLength);
+
+      //Write the record header
+      error = callback(param, &recordHeader, sizeof(PcapRecordHeader));
+
+      //Write the direction pseudo-header (0 for received, 1 for sent)
+      if(!error && dirLength != 0)
+      {
+         direction = (record->direction == NET_CAPTURE_DIR_TX) ? 1 : 0;
+         error = callback(param, &direction, sizeof(uint8_t));
+      }
+
+      //Write the captured bytes
+      if(!error)
+         error = callback(param, record->data, record->capLength);
+
+      //Count the exported frames
+      n++;
+   }
+
+   //Return the number of frames exported
+   if(count != NULL)
+      *count = n;
+
+   //Return status code
+   return error;
+}
+
+
+/**
+ * @brief Capture a frame passed to the network controller
+ * @param[in] interface Underlying network interface
+ * @param[in] buffer Multi-part buffer containing the frame
+ * @param[in] offset Offset to the first byte of the frame
+ **/
+
+void netCaptureTxPacket(NetInterface *interface,
+   const NetBuffer *buffer, size_t offset)
+{
+   size_t length;
+   NetCaptureRecord *record;
+
+   //Check the interface and the direction before copying anything
+   if(!(netCaptureFilter.direction & NET_CAPTURE_DIR_TX))
+      return;
+   if(netCaptureFilter.interface != NULL && netCaptureFilter.interface != interface)
+      return;
+
+   //Retrieve the length of the frame
+   length = netBufferGetLength(buffer) - offset;
+
+   //Copy the first bytes of the frame into the current slot
+   record = &netCaptureRing[netCaptureIndex];
+   record->capLength = netBufferRead(record->data, buffer, offset,
+      MIN(length, NET_CAPTURE_SNAP_LEN));
+
+   //Keep the frame if it matches the filter
+   netCaptureCommit(interface, length, NET_CAPTURE_DIR_TX);
+}
+
+
+/**
+ * @brief Capture a frame received by the network controller
+ * @param[in] interface Underlying network interface
+ * @param[in] packet Incoming frame
+ * @param[in] length Length of the frame
+ **/
+
+void netCaptureRxPacket(NetInterface *interface,
+   const uint8_t *packet, size_t length)
+{
+   NetCaptureRecord *record;
+
+   //Check the interface and the direction before copying anything
+   if(!(netCaptureFilter.direction & NET_CAPTURE_DIR_RX))
+      return;
+   if(netCaptureFilter.interface != NULL && netCaptureFilter.interface != interface)
+      return;
+
+   //Copy the first bytes of the frame into the current slot
+   record = &netCaptureRing[netCaptureIndex];
+   record->capLength = MIN(length, NET_CAPTURE_SNAP_LEN);
+   memcpy(record->data, packet, record->capLength);
+
+   //Keep the frame if it matches the filter
+   netCaptureCommit(interface, length, NET_CAPTURE_DIR_RX);
+}
+
+#endif
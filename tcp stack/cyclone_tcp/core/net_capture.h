@@ -0,0 +1,109 @@
+/**
+ * @file net_capture.h
+ * @brief In-RAM packet capture with pcap export
+ *
+ * @section License
+ *
+ * Copyright (C) 2010-2016 Oryx Embedded SARL. All rights reserved.
+ *
+ * This file is part of CycloneTCP Open.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * @author Oryx Embedded SARL (www.oryx-embedded.com)
+ * @version 1.7.5b
+ **/
+
+#ifndef _NET_CAPTURE_H
+#define _NET_CAPTURE_H
+
+//Dependencies
+#include "core/net.h"
+#include "core/net_mem.h"
+
+//Packet capture support
+#ifndef NET_CAPTURE_SUPPORT
+   #define NET_CAPTURE_SUPPORT DISABLED
+#elif (NET_CAPTURE_SUPPORT != ENABLED && NET_CAPTURE_SUPPORT != DISABLED)
+   #error NET_CAPTURE_SUPPORT parameter is not valid
+#endif
+
+//Number of frames held in the capture ring
+#ifndef NET_CAPTURE_RECORD_COUNT
+   #define NET_CAPTURE_RECORD_COUNT 64
+#elif (NET_CAPTURE_RECORD_COUNT < 1)
+   #error NET_CAPTURE_RECORD_COUNT parameter is not valid
+#endif
+
+//Number of bytes kept from each frame (link, IP and transport headers)
+#ifndef NET_CAPTURE_SNAP_LEN
+   #define NET_CAPTURE_SNAP_LEN 96
+#elif (NET_CAPTURE_SNAP_LEN < 40 || NET_CAPTURE_SNAP_LEN > 1536)
+   #error NET_CAPTURE_SNAP_LEN parameter is not valid
+#endif
+
+//Direction flags
+#define NET_CAPTURE_DIR_RX  0x01
+#define NET_CAPTURE_DIR_TX  0x02
+#define NET_CAPTURE_DIR_ANY 0x03
+
+//pcap link types
+#define PCAP_LINKTYPE_ETHERNET     1
+#define PCAP_LINKTYPE_PPP_WITH_DIR 204
+
+
+/**
+ * @brief Capture filter
+ *
+ * Zero fields match any frame. The protocol is an EtherType. IP frames
+ * carried over PPP match ETH_TYPE_IPV4 or ETH_TYPE_IPV6, other PPP frames
+ * match their PPP protocol number (0xC021 for LCP, 0x8021 for IPCP...)
+ **/
+
+typedef struct
+{
+   NetInterface *interface; ///<Underlying network interface
+   uint8_t direction;       ///<Direction flags (0 for both directions)
+   uint16_t protocol;       ///<EtherType or PPP protocol
+   uint8_t ipProtocol;      ///<IP protocol (TCP, UDP, ICMP...)
+   uint16_t port;           ///<TCP or UDP source or destination port
+} NetCaptureFilter;
+
+
+/**
+ * @brief Callback invoked to write a chunk of the pcap file
+ **/
+
+typedef error_t (*NetCaptureWriteCallback)(void *param,
+   const void *data, size_t length);
+
+
+//Capture is running (checked by the NIC layer before calling the hooks)
+extern bool_t netCaptureRunning;
+
+//Packet capture related functions
+error_t netCaptureStart(const NetCaptureFilter *filter);
+void netCaptureStop(void);
+
+error_t netCaptureExport(NetInterface *interface,
+   NetCaptureWriteCallback callback, void *param, uint_t *count);
+
+void netCaptureTxPacket(NetInterface *interface,
+   const NetBuffer *buffer, size_t offset);
+
+void netCaptureRxPacket(NetInterface *interface,
+   const uint8_t *packet, size_t length);
+
+#endif
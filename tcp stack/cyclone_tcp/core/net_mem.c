@@ -46,42 +46,204 @@
 //Use fixed-size blocks allocation?
 #if (NET_MEM_POOL_SUPPORT == ENABLED)
 
-//Mutex preventing simultaneous access to the memory pool
-static OsMutex memPoolMutex;
-//Memory pool
-static uint8_t memPool[NET_MEM_POOL_BUFFER_COUNT][NET_MEM_POOL_BUFFER_SIZE];
-//Allocation table
-static bool_t memPoolAllocTable[NET_MEM_POOL_BUFFER_COUNT];
-//Number of buffers currently allocated
-uint_t memPoolCurrentUsage;
-//Maximum number of buffers that have been allocated so far
-uint_t memPoolMaxUsage;
+/**
+ * @brief Free buffer, linked through its first word
+ **/
 
-#endif
+typedef struct _MemPoolBlock
+{
+   struct _MemPoolBlock *next;
+} MemPoolBlock;
 
 
 /**
- * @brief Memory pool initialization
- * @return Error code
+ * @brief Size class of the memory pool
  **/
 
-error_t memPoolInit(void)
+typedef struct
 {
+   MemPoolBlock *volatile freeList;
+   uint8_t *start;
+   uint8_t *end;
+   size_t blockSize;
+   uint_t blockCount;
+   volatile uint_t currentUsage;
+   volatile uint_t maxUsage;
+   volatile uint_t failCount;
+} MemPoolClass;
+
+//Buffers of each class (32-bit aligned)
+static uint32_t memPoolSmall[NET_MEM_POOL_SMALL_BUFFER_COUNT][NET_MEM_POOL_SMALL_BUFFER_SIZE / 4];
+static uint32_t memPoolMedium[NET_MEM_POOL_MEDIUM_BUFFER_COUNT][NET_MEM_POOL_MEDIUM_BUFFER_SIZE / 4];
+static uint32_t memPoolLarge[NET_MEM_POOL_BUFFER_COUNT][NET_MEM_POOL_BUFFER_SIZE / 4];
+
+//Size classes, sorted by increasing buffer size
+static MemPoolClass memPoolClass[NET_MEM_POOL_CLASS_COUNT];
+
+#endif
+
+
 //Use fixed-size blocks allocation?
 #if (NET_MEM_POOL_SUPPORT == ENABLED)
-   //Create a mutex to prevent simultaneous access to the memory pool
-   if(!osCreateMutex(&memPoolMutex))
+
+//The free lists are updated with LDREX/STREX on ARMv7-M. Any exception
+//entry or return clears the exclusive monitor, so a sequence interrupted by
+//an ISR that touched the same list fails its STREX and is retried. This
+//makes the pool usable from interrupt handlers without masking interrupts,
+//and also rules out the ABA problem of lock-free stacks on a single core
+#if ((defined(__GNUC__) && defined(__arm__)) || defined(__ICCARM__)) && defined(__CORTEX_M) && (__CORTEX_M >= 3)
+
+static MemPoolBlock *memPoolPop(MemPoolBlock *volatile *head)
+{
+   MemPoolBlock *block;
+
+   do
+   {
+      block = (MemPoolBlock *) __LDREXW((volatile uint32_t *) head);
+
+      //The free list is empty?
+      if(block == NULL)
+      {
+         __CLREX();
+         break;
+      }
+   } while(__STREXW((uint32_t) block->next, (volatile uint32_t *) head));
+
+   return block;
+}
+
+static void memPoolPush(MemPoolBlock *volatile *head, MemPoolBlock *block)
+{
+   do
+   {
+      block->next = (MemPoolBlock *) __LDREXW((volatile uint32_t *) head);
+   } while(__STREXW((uint32_t) block, (volatile uint32_t *) head));
+}
+
+static uint_t memPoolAtomicAdd(volatile uint_t *value, int_t n)
+{
+   uint_t result;
+
+   do
    {
-      //Failed to create mutex
-      return ERROR_OUT_OF_RESOURCES;
+      result = __LDREXW((volatile uint32_t *) value) + n;
+   } while(__STREXW(result, (volatile uint32_t *) value));
+
+   return result;
+}
+
+static void memPoolAtomicMax(volatile uint_t *value, uint_t n)
+{
+   do
+   {
+      //Nothing to update?
+      if(__LDREXW((volatile uint32_t *) value) >= n)
+      {
+         __CLREX();
+         break;
+      }
+   } while(__STREXW(n, (volatile uint32_t *) value));
+}
+
+#else
+
+//Other targets (host builds) serialize the updates. This path must not be
+//used from interrupt context
+static MemPoolBlock *memPoolPop(MemPoolBlock *volatile *head)
+{
+   MemPoolBlock *block;
+
+   osSuspendAllTasks();
+   block = *head;
+   if(block != NULL)
+      *head = block->next;
+   osResumeAllTasks();
+
+   return block;
+}
+
+static void memPoolPush(MemPoolBlock *volatile *head, MemPoolBlock *block)
+{
+   osSuspendAllTasks();
+   block->next = *head;
+   *head = block;
+   osResumeAllTasks();
+}
+
+static uint_t memPoolAtomicAdd(volatile uint_t *value, int_t n)
+{
+   uint_t result;
+
+   osSuspendAllTasks();
+   result = *value + n;
+   *value = result;
+   osResumeAllTasks();
+
+   return result;
+}
+
+static void memPoolAtomicMax(volatile uint_t *value, uint_t n)
+{
+   osSuspendAllTasks();
+   if(*value < n)
+      *value = n;
+   osResumeAllTasks();
+}
+
+#endif
+
+
+/**
+ * @brief Initialize a size class and thread its free list
+ * @param[in] poolClass Size class to initialize
+ * @param[in] buffer Storage of the buffers
+ * @param[in] blockSize Size of the buffers
+ * @param[in] blockCount Number of buffers
+ **/
+
+static void memPoolInitClass(MemPoolClass *poolClass, void *buffer,
+   size_t blockSize, uint_t blockCount)
+{
+   uint_t i;
+   MemPoolBlock *block;
+
+   poolClass->start = (uint8_t *) buffer;
+   poolClass->end = poolClass->start + blockSize * blockCount;
+   poolClass->blockSize = blockSize;
+   poolClass->blockCount = blockCount;
+   poolClass->currentUsage = 0;
+   poolClass->maxUsage = 0;
+   poolClass->failCount = 0;
+
+   //Link the buffers in address order
+   poolClass->freeList = NULL;
+   for(i = blockCount; i > 0; i--)
+   {
+      block = (MemPoolBlock *) (poolClass->start + blockSize * (i - 1));
+      block->next = poolClass->freeList;
+      poolClass->freeList = block;
    }
+}
+
+#endif
 
-   //Clear allocation table
-   memset(memPoolAllocTable, 0, sizeof(memPoolAllocTable));
 
-   //Clear statistics
-   memPoolCurrentUsage = 0;
-   memPoolMaxUsage = 0;
+/**
+ * @brief Memory pool initialization
+ * @return Error code
+ **/
+
+error_t memPoolInit(void)
+{
+//Use fixed-size blocks allocation?
+#if (NET_MEM_POOL_SUPPORT == ENABLED)
+   //Build the free list of each class
+   memPoolInitClass(&memPoolClass[0], memPoolSmall,
+      NET_MEM_POOL_SMALL_BUFFER_SIZE, NET_MEM_POOL_SMALL_BUFFER_COUNT);
+   memPoolInitClass(&memPoolClass[1], memPoolMedium,
+      NET_MEM_POOL_MEDIUM_BUFFER_SIZE, NET_MEM_POOL_MEDIUM_BUFFER_COUNT);
+   memPoolInitClass(&memPoolClass[2], memPoolLarge,
+      NET_MEM_POOL_BUFFER_SIZE, NET_MEM_POOL_BUFFER_COUNT);
 #endif
 
    //Successful initialization
@@ -91,6 +253,11 @@ error_t memPoolInit(void)
 
 /**
  * @brief Allocate a memory block
+ *
+ * The block is taken from the smallest class that fits the request. When
+ * that class is exhausted, the next larger one is used. Allocation and
+ * release run in constant time and may be called from interrupt context
+ *
  * @param[in] size Bytes to allocate
  * @return Pointer to the allocated space or NULL if there is insufficient memory available
  **/
@@ -99,6 +266,8 @@ void *memPoolAlloc(size_t size)
 {
 #if (NET_MEM_POOL_SUPPORT == ENABLED)
    uint_t i;
+   uint_t usage;
+   MemPoolClass *poolClass;
 #endif
 
    //Pointer to the allocated memory block
@@ -109,36 +278,31 @@ void *memPoolAlloc(size_t size)
 
 //Use fixed-size blocks allocation?
 #if (NET_MEM_POOL_SUPPORT == ENABLED)
-   //Acquire exclusive access to the memory pool
-   osAcquireMutex(&memPoolMutex);
-
-   //Enforce block size
-   if(size <= NET_MEM_POOL_BUFFER_SIZE)
+   //Loop through the classes large enough for the request
+   for(i = 0; i < NET_MEM_POOL_CLASS_COUNT; i++)
    {
-      //Loop through allocation table
-      for(i = 0; i < NET_MEM_POOL_BUFFER_COUNT; i++)
+      poolClass = &memPoolClass[i];
+
+      if(size <= poolClass->blockSize)
       {
-         //Check whether the current block is free
-         if(!memPoolAllocTable[i])
-         {
-            //Mark the current entry as used
-            memPoolAllocTable[i] = TRUE;
-            //Point to the corresponding memory block
-            p = memPool[i];
+         //Take the first free buffer
+         p = memPoolPop(&poolClass->freeList);
 
+         if(p != NULL)
+         {
             //Update statistics
-            memPoolCurrentUsage++;
+            usage = memPoolAtomicAdd(&poolClass->currentUsage, 1);
             //Maximum number of buffers that have been allocated so far
-            memPoolMaxUsage = MAX(memPoolCurrentUsage, memPoolMaxUsage);
+            memPoolAtomicMax(&poolClass->maxUsage, usage);
 
             //Exit immediately
             break;
          }
+
+         //The class is exhausted
+         memPoolAtomicAdd(&poolClass->failCount, 1);
       }
    }
-
-   //Release exclusive access to the memory pool
-   osReleaseMutex(&memPoolMutex);
 #else
    //Allocate a memory block
    p = osAllocMem(size);
@@ -166,28 +330,25 @@ void memPoolFree(void *p)
 //Use fixed-size blocks allocation?
 #if (NET_MEM_POOL_SUPPORT == ENABLED)
    uint_t i;
+   MemPoolClass *poolClass;
 
-   //Acquire exclusive access to the memory pool
-   osAcquireMutex(&memPoolMutex);
-
-   //Loop through allocation table
-   for(i = 0; i < NET_MEM_POOL_BUFFER_COUNT; i++)
+   //Find the class the buffer belongs to from its address
+   for(i = 0; i < NET_MEM_POOL_CLASS_COUNT; i++)
    {
-      if(memPool[i] == p)
+      poolClass = &memPoolClass[i];
+
+      if((uint8_t *) p >= poolClass->start && (uint8_t *) p < poolClass->end)
       {
-         //Mark the current block as free
-         memPoolAllocTable[i] = FALSE;
+         //Return the buffer to the free list
+         memPoolPush(&poolClass->freeList, (MemPoolBlock *) p);
 
          //Update statistics
-         memPoolCurrentUsage--;
+         memPoolAtomicAdd(&poolClass->currentUsage, -1);
 
          //Exit immediately
          break;
       }
    }
-
-   //Release exclusive access to the memory pool
-   osReleaseMutex(&memPoolMutex);
 #else
    //Release memory block
    osFreeMem(p);
@@ -197,37 +358,36 @@ void memPoolFree(void *p)
 
 /**
  * @brief Get memory pool usage
- * @param[out] currentUsage Number of buffers currently allocated
- * @param[out] maxUsage Maximum number of buffers that have been allocated so far
- * @param[out] size Total number of buffers in the memory pool
+ * @param[in] classIndex Index of the size class (0 for the smallest buffers)
+ * @param[out] stats Statistics of the class
+ * @return Error code
  **/
 
-void memPoolGetStats(uint_t *currentUsage, uint_t *maxUsage, uint_t *size)
+error_t memPoolGetStats(uint_t classIndex, MemPoolStats *stats)
 {
+   //Check parameters
+   if(classIndex >= NET_MEM_POOL_CLASS_COUNT || stats == NULL)
+      return ERROR_INVALID_PARAMETER;
+
 //Use fixed-size blocks allocation?
 #if (NET_MEM_POOL_SUPPORT == ENABLED)
+   //Size of the buffers
+   stats->blockSize = memPoolClass[classIndex].blockSize;
+   //Total number of buffers in the class
+   stats->blockCount = memPoolClass[classIndex].blockCount;
    //Number of buffers currently allocated
-   if(currentUsage != NULL)
-      *currentUsage = memPoolCurrentUsage;
-
+   stats->currentUsage = memPoolClass[classIndex].currentUsage;
    //Maximum number of buffers that have been allocated so far
-   if(maxUsage != NULL)
-      *maxUsage = memPoolMaxUsage;
-
-   //Total number of buffers in the memory pool
-   if(size != NULL)
-      *size = NET_MEM_POOL_BUFFER_COUNT;
+   stats->maxUsage = memPoolClass[classIndex].maxUsage;
+   //Number of requests that found the class exhausted
+   stats->failCount = memPoolClass[classIndex].failCount;
 #else
    //Memory pool is not used...
-   if(currentUsage != NULL)
-      *currentUsage = 0;
-
-   if(maxUsage != NULL)
-      *maxUsage = 0;
-
-   if(size != NULL)
-      *size = 0;
+   memset(stats, 0, sizeof(MemPoolStats));
 #endif
+
+   //Successful processing
+   return NO_ERROR;
 }
 
 
@@ -241,10 +401,23 @@ void memPoolGetStats(uint_t *currentUsage, uint_t *maxUsage, uint_t *size)
 NetBuffer *netBufferAlloc(size_t length)
 {
    error_t error;
+   size_t size;
    NetBuffer *buffer;
 
+   //Use fixed-size blocks allocation?
+#if (NET_MEM_POOL_SUPPORT == ENABLED)
+   //Short packets are held by a smaller buffer, provided that the whole
+   //packet fits in the first chunk so that headers remain contiguous
+   if((CHUNKED_BUFFER_HEADER_SIZE + length) <= NET_MEM_POOL_SMALL_BUFFER_SIZE)
+      size = NET_MEM_POOL_SMALL_BUFFER_SIZE;
+   else if((CHUNKED_BUFFER_HEADER_SIZE + length) <= NET_MEM_POOL_MEDIUM_BUFFER_SIZE)
+      size = NET_MEM_POOL_MEDIUM_BUFFER_SIZE;
+   else
+#endif
+      size = NET_MEM_POOL_BUFFER_SIZE;
+
    //Allocate memory to hold the multi-part buffer
-   buffer = memPoolAlloc(NET_MEM_POOL_BUFFER_SIZE);
+   buffer = memPoolAlloc(size);
    //Failed to allocate memory?
    if(buffer == NULL)
       return NULL;
@@ -253,7 +426,7 @@ NetBuffer *netBufferAlloc(size_t length)
    buffer->chunkCount = 1;
    buffer->maxChunkCount = MAX_CHUNK_COUNT;
    buffer->chunk[0].address = (uint8_t *) buffer + CHUNKED_BUFFER_HEADER_SIZE;
-   buffer->chunk[0].length = NET_MEM_POOL_BUFFER_SIZE - CHUNKED_BUFFER_HEADER_SIZE;
+   buffer->chunk[0].length = size - CHUNKED_BUFFER_HEADER_SIZE;
    buffer->chunk[0].size = 0;
 
    //Adjust the length of the buffer
@@ -71,6 +71,42 @@
    #error NET_MEM_POOL_BUFFER_SIZE parameter is not valid
 #endif
 
+//Size of the buffers of the small class
+#ifndef NET_MEM_POOL_SMALL_BUFFER_SIZE
+   #define NET_MEM_POOL_SMALL_BUFFER_SIZE 128
+#elif (NET_MEM_POOL_SMALL_BUFFER_SIZE < 16 || (NET_MEM_POOL_SMALL_BUFFER_SIZE % 4) != 0)
+   #error NET_MEM_POOL_SMALL_BUFFER_SIZE parameter is not valid
+#endif
+
+//Number of buffers of the small class
+#ifndef NET_MEM_POOL_SMALL_BUFFER_COUNT
+   #define NET_MEM_POOL_SMALL_BUFFER_COUNT 32
+#elif (NET_MEM_POOL_SMALL_BUFFER_COUNT < 1)
+   #error NET_MEM_POOL_SMALL_BUFFER_COUNT parameter is not valid
+#endif
+
+//Size of the buffers of the medium class
+#ifndef NET_MEM_POOL_MEDIUM_BUFFER_SIZE
+   #define NET_MEM_POOL_MEDIUM_BUFFER_SIZE 512
+#elif (NET_MEM_POOL_MEDIUM_BUFFER_SIZE <= NET_MEM_POOL_SMALL_BUFFER_SIZE || (NET_MEM_POOL_MEDIUM_BUFFER_SIZE % 4) != 0)
+   #error NET_MEM_POOL_MEDIUM_BUFFER_SIZE parameter is not valid
+#endif
+
+//Number of buffers of the medium class
+#ifndef NET_MEM_POOL_MEDIUM_BUFFER_COUNT
+   #define NET_MEM_POOL_MEDIUM_BUFFER_COUNT 16
+#elif (NET_MEM_POOL_MEDIUM_BUFFER_COUNT < 1)
+   #error NET_MEM_POOL_MEDIUM_BUFFER_COUNT parameter is not valid
+#endif
+
+//The largest class holds NET_MEM_POOL_BUFFER_COUNT buffers of NET_MEM_POOL_BUFFER_SIZE bytes
+#if (NET_MEM_POOL_BUFFER_SIZE <= NET_MEM_POOL_MEDIUM_BUFFER_SIZE || (NET_MEM_POOL_BUFFER_SIZE % 4) != 0)
+   #error NET_MEM_POOL_BUFFER_SIZE parameter is not valid
+#endif
+
+//Number of size classes
+#define NET_MEM_POOL_CLASS_COUNT 3
+
 //Size of the header part of the buffer
 #define CHUNKED_BUFFER_HEADER_SIZE (sizeof(NetBuffer) + MAX_CHUNK_COUNT * sizeof(ChunkDesc))
 
@@ -110,11 +146,25 @@ typedef struct
 } NetBuffer1;
 
 
+/**
+ * @brief Memory pool statistics of a size class
+ **/
+
+typedef struct
+{
+   size_t blockSize;  ///<Size of the buffers
+   uint_t blockCount; ///<Total number of buffers
+   uint_t currentUsage; ///<Number of buffers currently allocated
+   uint_t maxUsage;   ///<Maximum number of buffers that have been allocated so far
+   uint_t failCount;  ///<Number of requests that found the class exhausted
+} MemPoolStats;
+
+
 //Memory management functions
 error_t memPoolInit(void);
 void *memPoolAlloc(size_t size);
 void memPoolFree(void *p);
-void memPoolGetStats(uint_t *currentUsage, uint_t *maxUsage, uint_t *size);
+error_t memPoolGetStats(uint_t classIndex, MemPoolStats *stats);
 
 NetBuffer *netBufferAlloc(size_t length);
 void netBufferFree(NetBuffer *buffer);
@@ -0,0 +1,548 @@
+/**
+ * @file net_timer.c
+ * @brief Hierarchical timer wheel shared by the TCP/IP stack
+ *
+ * @section License
+ *
+ * Copyright (C) 2010-2016 Oryx Embedded SARL. All rights reserved.
+ *
+ * This file is part of CycloneTCP Open.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * @section Description
+ *
+ * Timers are hashed by expiration tick into three levels of 32 slots.
+ * The first level holds the timers due within 32 ticks, one slot per
+ * tick. Each slot of an upper level covers a whole rotation of the level
+ * below, and its timers are redistributed (cascaded) when that rotation
+ * starts. Starting and stopping a timer is O(1), and only the slots that
+ * hold timers are visited, so the stack task can sleep until the next
+ * deadline instead of polling every module at a fixed rate
+ *
+ * @author Oryx Embedded SARL (www.oryx-embedded.com)
+ * @version 1.7.5b
+ **/
+
+//Dependencies
+#include "core/net.h"
+#include "core/net_timer.h"
+#include "debug.h"
+
+//Timer lists, indexed by level and slot
+static NetTimerLink netTimerSlot[NET_TIMER_LEVEL_COUNT][NET_TIMER_SLOT_COUNT];
+//Slots that may hold timers (a bit may be stale after a timer is stopped)
+static uint32_t netTimerMap[NET_TIMER_LEVEL_COUNT];
+
+//Next tick to be processed
+static uint32_t netTimerTick;
+//Time at which that tick is due
+static systime_t netTimerTime;
+
+//The stack task is blocked, until the wake-up time if one is set
+static bool_t netTimerSleeping;
+static bool_t netTimerWakeupSet;
+static systime_t netTimerWakeup;
+
+
+/**
+ * @brief Link a timer at the end of a list
+ * @param[in] head List head
+ * @param[in] link Links of the timer
+ **/
+
+static void netTimerLinkTail(NetTimerLink *head, NetTimerLink *link)
+{
+   link->next = head;
+   link->prev = head->prev;
+   head->prev->next = link;
+   head->prev = link;
+}
+
+
+/**
+ * @brief Move the contents of a list to another (empty) list
+ * @param[out] dest Destination list head
+ * @param[in] src Source list head, empty on return
+ **/
+
+static void netTimerSplice(NetTimerLink *dest, NetTimerLink *src)
+{
+   //Empty source list?
+   if(src->next == src)
+   {
+      dest->next = dest;
+      dest->prev = dest;
+   }
+   else
+   {
+      //Take over the chain of timers
+      dest->next = src->next;
+      dest->prev = src->prev;
+      dest->next->prev = dest;
+      dest->prev->next = dest;
+
+      //The source list is now empty
+      src->next = src;
+      src->prev = src;
+   }
+}
+
+
+/**
+ * @brief Number of ticks until the given time, rounded up
+ * @param[in] time Absolute time
+ * @return Number of ticks from the next tick to be processed
+ **/
+
+static uint32_t netTimerGetTicks(systime_t time)
+{
+   int32_t delta;
+
+   //Time remaining after the next tick to be processed
+   delta = timeCompare(time, netTimerTime);
+
+   //Already due?
+   if(delta <= 0)
+      return 0;
+
+   //Round up so that the timer never fires early
+   return ((uint32_t) delta + NET_TIMER_RESOLUTION - 1) / NET_TIMER_RESOLUTION;
+}
+
+
+/**
+ * @brief Hash a timer into the wheel
+ * @param[in] timer Timer to insert (not currently linked)
+ **/
+
+static void netTimerInsert(NetTimer *timer)
+{
+   uint_t level;
+   uint_t slot;
+   uint32_t ticks;
+   uint32_t tick;
+
+   //Number of ticks until expiration
+   ticks = netTimerGetTicks(timer->deadline);
+   //Longer delays are cascaded through the last level several times
+   ticks = MIN(ticks, NET_TIMER_MAX_TICKS);
+
+   //Tick at which the timer fires
+   tick = netTimerTick + ticks;
+
+   //Select the lowest level whose range covers the delay
+   for(level = 0; level < (NET_TIMER_LEVEL_COUNT - 1); level++)
+   {
+      if(ticks < (1UL << (NET_TIMER_SLOT_BITS * (level + 1))))
+         break;
+   }
+
+   //Slot that gets processed or cascaded when the tick is reached
+   slot = (tick >> (NET_TIMER_SLOT_BITS * level)) & NET_TIMER_SLOT_MASK;
+
+   //Append the timer to the slot
+   netTimerLinkTail(&netTimerSlot[level][slot], &timer->link);
+   netTimerMap[level] |= (1UL << slot);
+}
+
+
+/**
+ * @brief Redistribute the timers of an upper-level slot
+ * @param[in] level Level index
+ * @param[in] slot Slot index
+ **/
+
+static void netTimerCascade(uint_t level, uint_t slot)
+{
+   NetTimerLink list;
+   NetTimerLink *link;
+
+   //Nothing to do if the slot is known to be empty
+   if(!(netTimerMap[level] & (1UL << slot)))
+      return;
+
+   //Detach the timers from the slot
+   netTimerSplice(&list, &netTimerSlot[level][slot]);
+   netTimerMap[level] &= ~(1UL << slot);
+
+   //Hash each timer again, relative to the current tick
+   while(list.next != &list)
+   {
+      link = list.next;
+
+      //Unlink the timer from the temporary list
+      list.next = link->next;
+      link->next->prev = &list;
+
+      //Insert it at a lower level
+      netTimerInsert((NetTimer *) link);
+   }
+}
+
+
+/**
+ * @brief Initialize the timer wheel
+ **/
+
+void netTimerWheelInit(void)
+{
+   uint_t i;
+   uint_t j;
+
+   //Empty all the slots
+   for(i = 0; i < NET_TIMER_LEVEL_COUNT; i++)
+   {
+      for(j = 0; j < NET_TIMER_SLOT_COUNT; j++)
+      {
+         netTimerSlot[i][j].next = &netTimerSlot[i][j];
+         netTimerSlot[i][j].prev = &netTimerSlot[i][j];
+      }
+
+      netTimerMap[i] = 0;
+   }
+
+   //The wheel starts at the current time
+   netTimerTick = 0;
+   netTimerTime = osGetSystemTime();
+
+   //The stack task is not waiting yet
+   netTimerSleeping = FALSE;
+   netTimerWakeupSet = FALSE;
+   netTimerWakeup = 0;
+}
+
+
+/**
+ * @brief Initialize a timer
+ * @param[in] timer Timer to initialize
+ * @param[in] callback Function to call upon expiration
+ * @param[in] param Callback parameter
+ **/
+
+void netTimerInit(NetTimer *timer, NetTimerCallback callback, void *param)
+{
+   //The timer is not linked into the wheel
+   timer->link.next = NULL;
+   timer->link.prev = NULL;
+
+   //Save parameters
+   timer->deadline = 0;
+   timer->period = 0;
+   timer->callback = callback;
+   timer->param = param;
+}
+
+
+/**
+ * @brief Start (or restart) a one-shot timer
+ * @param[in] timer Timer to start
+ * @param[in] delay Time interval before expiration
+ **/
+
+void netTimerStart(NetTimer *timer, systime_t delay)
+{
+   //Expire after the specified delay
+   netTimerStartAt(timer, osGetSystemTime() + delay);
+}
+
+
+/**
+ * @brief Start (or restart) a one-shot timer at an absolute time
+ * @param[in] timer Timer to start
+ * @param[in] deadline Expiration time
+ **/
+
+void netTimerStartAt(NetTimer *timer, systime_t deadline)
+{
+   //Remove the timer from the wheel if already running
+   netTimerStop(timer);
+
+   //Save the expiration time
+   timer->deadline = deadline;
+   timer->period = 0;
+
+   //Hash the timer into the wheel
+   netTimerInsert(timer);
+
+   //Wake up the stack task if it sleeps past the new deadline
+   if(netTimerSleeping && (!netTimerWakeupSet || timeCompare(netTimerTime +
+      netTimerGetTicks(deadline) * NET_TIMER_RESOLUTION, netTimerWakeup) < 0))
+   {
+      //The task will compute a new timeout
+      netTimerSleeping = FALSE;
+      osSetEvent(&netEvent);
+   }
+}
+
+
+/**
+ * @brief Start (or restart) a periodic timer
+ * @param[in] timer Timer to start
+ * @param[in] period Interval between successive expirations
+ **/
+
+void netTimerStartPeriodic(NetTimer *timer, systime_t period)
+{
+   //The first expiration occurs one period from now
+   netTimerStart(timer, period);
+   //Reload value
+   timer->period = period;
+}
+
+
+/**
+ * @brief Stop a timer
+ * @param[in] timer Timer to stop
+ **/
+
+void netTimerStop(NetTimer *timer)
+{
+   //Linked into the wheel?
+   if(timer->link.next != NULL)
+   {
+      //Remove the timer from its slot
+      timer->link.prev->next = timer->link.next;
+      timer->link.next->prev = timer->link.prev;
+
+      //The timer is no longer running
+      timer->link.next = NULL;
+      timer->link.prev = NULL;
+   }
+
+   //A periodic timer is not reloaded anymore
+   timer->period = 0;
+}
+
+
+/**
+ * @brief Check whether a timer is running
+ * @param[in] timer Timer to check
+ * @return TRUE if the timer is armed
+ **/
+
+bool_t netTimerRunning(NetTimer *timer)
+{
+   //The timer runs as long as it is linked into the wheel
+   return (timer->link.next != NULL) ? TRUE : FALSE;
+}
+
+
+/**
+ * @brief Process the timers that have expired
+ *
+ * Must be called with netMutex held. Callbacks may start or stop any
+ * timer, including the one being processed
+ *
+ * @param[in] time Current time
+ **/
+
+void netTimerProcess(systime_t time)
+{
+   uint_t i;
+   uint_t index;
+   uint32_t n;
+   NetTimerLink list;
+   NetTimerLink *link;
+   NetTimer *timer;
+
+   //The stack task is running
+   netTimerSleeping = FALSE;
+
+   //Process the ticks that are due
+   while(timeCompare(time, netTimerTime) >= 0)
+   {
+      //Slot of the first level
+      index = netTimerTick & NET_TIMER_SLOT_MASK;
+
+      //A new rotation of the first level starts?
+      if(index == 0)
+      {
+         //Bring down the timers of the upper levels that fall in it
+         for(i = 1; i < NET_TIMER_LEVEL_COUNT; i++)
+         {
+            n = (netTimerTick >> (NET_TIMER_SLOT_BITS * i)) & NET_TIMER_SLOT_MASK;
+            netTimerCascade(i, n);
+
+            //Upper levels only turn when this one wraps around
+            if(n != 0)
+               break;
+         }
+      }
+
+      //Detach the timers of the current tick
+      netTimerSplice(&list, &netTimerSlot[0][index]);
+      netTimerMap[0] &= ~(1UL << index);
+
+      //Move on before calling back, so that a timer restarted with a short
+      //delay lands in a later slot than the one being processed
+      netTimerTick++;
+      netTimerTime += NET_TIMER_RESOLUTION;
+
+      //Run the callbacks
+      while(list.next != &list)
+      {
+         link = list.next;
+         timer = (NetTimer *) link;
+
+         //Unlink the timer from the temporary list
+         list.next = link->next;
+         link->next->prev = &list;
+         link->next = NULL;
+         link->prev = NULL;
+
+         //Periodic timer?
+         if(timer->period != 0)
+         {
+            //Keep the phase, unless whole periods were missed
+            timer->deadline += timer->period;
+            if(timeCompare(timer->deadline, netTimerTime) < 0)
+               timer->deadline = netTimerTime + timer->period;
+
+            //Reload the timer before the callback may stop it
+            netTimerInsert(timer);
+         }
+
+         //Invoke the user callback
+         if(timer->callback != NULL)
+            timer->callback(timer->param);
+      }
+
+      //No other timer in the current rotation of the first level?
+      index = netTimerTick & NET_TIMER_SLOT_MASK;
+      if(index != 0 && (netTimerMap[0] >> index) == 0 &&
+         timeCompare(time, netTimerTime) >= 0)
+      {
+         //Skip the empty slots that are due, up to the end of the rotation
+         n = (time - netTimerTime) / NET_TIMER_RESOLUTION + 1;
+         n = MIN(n, NET_TIMER_SLOT_COUNT - index);
+
+         netTimerTick += n;
+         netTimerTime += n * NET_TIMER_RESOLUTION;
+      }
+   }
+}
+
+
+/**
+ * @brief Time until the next timer expires
+ *
+ * Must be called with netMutex held, right before the stack task blocks.
+ * A timer started afterwards with an earlier deadline wakes up the task
+ *
+ * @param[in] time Current time
+ * @return Maximum blocking time (INFINITE_DELAY if no timer is running)
+ **/
+
+systime_t netTimerGetTimeout(systime_t time)
+{
+   uint_t i;
+   uint_t j;
+   uint_t slot;
+   uint_t first;
+   uint32_t pos;
+   bool_t found;
+   systime_t wakeup;
+   systime_t t;
+   NetTimerLink *link;
+
+   //No timer found yet
+   found = FALSE;
+   wakeup = 0;
+
+   //Timers of the first level fire at the start of their tick
+   pos = netTimerTick & NET_TIMER_SLOT_MASK;
+
+   //Look for the first occupied slot
+   for(j = 0; j < NET_TIMER_SLOT_COUNT; j++)
+   {
+      slot = (pos + j) & NET_TIMER_SLOT_MASK;
+
+      //Possibly occupied slot?
+      if(netTimerMap[0] & (1UL << slot))
+      {
+         //Stale bit?
+         if(netTimerSlot[0][slot].next == &netTimerSlot[0][slot])
+         {
+            netTimerMap[0] &= ~(1UL << slot);
+         }
+         else
+         {
+            wakeup = netTimerTime + j * NET_TIMER_RESOLUTION;
+            found = TRUE;
+            break;
+         }
+      }
+   }
+
+   //Upper levels may hold earlier timers, sitting in the slot that
+   //will be cascaded first
+   for(i = 1; i < NET_TIMER_LEVEL_COUNT; i++)
+   {
+      //Current position of the level
+      pos = (netTimerTick >> (NET_TIMER_SLOT_BITS * i)) & NET_TIMER_SLOT_MASK;
+      //The current slot is still to be cascaded at a rotation boundary
+      first = (netTimerTick & ((1UL << (NET_TIMER_SLOT_BITS * i)) - 1)) ? 1 : 0;
+
+      //Look for the first occupied slot
+      for(j = first; j < (NET_TIMER_SLOT_COUNT + first); j++)
+      {
+         slot = (pos + j) & NET_TIMER_SLOT_MASK;
+
+         //Possibly occupied slot?
+         if(netTimerMap[i] & (1UL << slot))
+         {
+            //Stale bit?
+            if(netTimerSlot[i][slot].next == &netTimerSlot[i][slot])
+            {
+               netTimerMap[i] &= ~(1UL << slot);
+               continue;
+            }
+
+            //Earliest deadline of the slot, rounded to the tick it fires at
+            for(link = netTimerSlot[i][slot].next; link != &netTimerSlot[i][slot];
+               link = link->next)
+            {
+               t = netTimerTime + netTimerGetTicks(((NetTimer *) link)->deadline) *
+                  NET_TIMER_RESOLUTION;
+
+               if(!found || timeCompare(t, wakeup) < 0)
+               {
+                  wakeup = t;
+                  found = TRUE;
+               }
+            }
+
+            //Later slots of this level only hold later timers
+            break;
+         }
+      }
+   }
+
+   //The stack task sleeps until the wake-up time
+   netTimerSleeping = TRUE;
+   netTimerWakeupSet = found;
+   netTimerWakeup = wakeup;
+
+   //No timer running?
+   if(!found)
+      return INFINITE_DELAY;
+
+   //Compute the blocking time
+   if(timeCompare(wakeup, time) > 0)
+      return wakeup - time;
+   else
+      return 0;
+}
@@ -0,0 +1,103 @@
+/**
+ * @file net_timer.h
+ * @brief Hierarchical timer wheel shared by the TCP/IP stack
+ *
+ * @section License
+ *
+ * Copyright (C) 2010-2016 Oryx Embedded SARL. All rights reserved.
+ *
+ * This file is part of CycloneTCP Open.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * @author Oryx Embedded SARL (www.oryx-embedded.com)
+ * @version 1.7.5b
+ **/
+
+#ifndef _NET_TIMER_H
+#define _NET_TIMER_H
+
+//Dependencies
+#include "os_port.h"
+#include "net_config.h"
+
+//Resolution of the timer wheel, in milliseconds
+#ifndef NET_TIMER_RESOLUTION
+   #define NET_TIMER_RESOLUTION 10
+#elif (NET_TIMER_RESOLUTION < 1)
+   #error NET_TIMER_RESOLUTION parameter is not valid
+#endif
+
+//Number of slots per level (one bit of a 32-bit occupancy map each)
+#define NET_TIMER_SLOT_BITS 5
+#define NET_TIMER_SLOT_COUNT (1 << NET_TIMER_SLOT_BITS)
+#define NET_TIMER_SLOT_MASK (NET_TIMER_SLOT_COUNT - 1)
+
+//Number of levels (32, 1024 and 32768 ticks)
+#define NET_TIMER_LEVEL_COUNT 3
+
+//Longest delay handled without cascading through the last level again
+#define NET_TIMER_MAX_TICKS ((1UL << (NET_TIMER_SLOT_BITS * NET_TIMER_LEVEL_COUNT)) - 1)
+
+
+/**
+ * @brief Timer callback
+ **/
+
+typedef void (*NetTimerCallback)(void *param);
+
+
+/**
+ * @brief Links of a doubly-linked timer list
+ **/
+
+typedef struct _NetTimerLink
+{
+   struct _NetTimerLink *next;
+   struct _NetTimerLink *prev;
+} NetTimerLink;
+
+
+/**
+ * @brief Timer
+ *
+ * The timer is armed as long as it is linked into the wheel. The callback
+ * runs in the context of the TCP/IP stack task, with netMutex held
+ **/
+
+typedef struct
+{
+   NetTimerLink link;         ///<Must be the first field
+   systime_t deadline;        ///<Expiration time
+   systime_t period;          ///<Reload value (0 for a one-shot timer)
+   NetTimerCallback callback; ///<Function to call upon expiration
+   void *param;               ///<Callback parameter
+} NetTimer;
+
+
+//Timer wheel related functions
+void netTimerWheelInit(void);
+
+void netTimerInit(NetTimer *timer, NetTimerCallback callback, void *param);
+void netTimerStart(NetTimer *timer, systime_t delay);
+void netTimerStartAt(NetTimer *timer, systime_t deadline);
+void netTimerStartPeriodic(NetTimer *timer, systime_t period);
+void netTimerStop(NetTimer *timer);
+bool_t netTimerRunning(NetTimer *timer);
+
+void netTimerProcess(systime_t time);
+systime_t netTimerGetTimeout(systime_t time);
+
+#endif
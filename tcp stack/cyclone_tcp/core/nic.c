@@ -32,6 +32,8 @@
 //Dependencies
 #include "core/net.h"
 #include "core/nic.h"
+#include "core/net_capture.h"
+#include "core/net_accounting.h"
 #include "core/socket.h"
 #include "core/raw_socket.h"
 #include "core/tcp_misc.h"
@@ -110,6 +112,18 @@ error_t nicSendPacket(NetInterface *interface, const NetBuffer *buffer, size_t o
       //Re-enable interrupts if necessary
       if(interface->configured)
          interface->nicDriver->enableIrq(interface);
+
+#if (NET_CAPTURE_SUPPORT == ENABLED)
+      //Capture the frame if it was accepted by the controller
+      if(netCaptureRunning && !error)
+         netCaptureTxPacket(interface, buffer, offset);
+#endif
+
+#if (NET_ACCOUNTING_SUPPORT == ENABLED)
+      //Account for the frame if it was accepted by the controller
+      if(!error)
+         netAccountingTxPacket(interface, buffer, offset);
+#endif
    }
    else
    {
@@ -166,6 +180,17 @@ void nicProcessPacket(NetInterface *interface, void *packet, size_t length)
    TRACE_DEBUG("Packet received (%" PRIuSIZE " bytes)...\r\n", length);
    TRACE_DEBUG_ARRAY("  ", packet, length);
 
+#if (NET_CAPTURE_SUPPORT == ENABLED)
+   //Capture the frame before it is processed
+   if(netCaptureRunning)
+      netCaptureRxPacket(interface, packet, length);
+#endif
+
+#if (NET_ACCOUNTING_SUPPORT == ENABLED)
+   //Account for the frame before it is processed
+   netAccountingRxPacket(interface, packet, length);
+#endif
+
    //Retrieve network interface type
    type = interface->nicDriver->type;
 
@@ -292,8 +317,8 @@ void nicNotifyLinkChange(NetInterface *interface)
 
 #if (DNS_CLIENT_SUPPORT == ENABLED || MDNS_CLIENT_SUPPORT == ENABLED || \
    NBNS_CLIENT_SUPPORT == ENABLED)
-   //Flush DNS cache
-   dnsFlushCache(interface);
+   //Update DNS cache
+   dnsLinkChangeEvent(interface);
 #endif
 
 #if (MDNS_RESPONDER_SUPPORT == ENABLED)
@@ -37,6 +37,7 @@
 #include "core/udp.h"
 #include "core/tcp.h"
 #include "core/tcp_misc.h"
+#include "core/tcp_timer.h"
 #include "dns/dns_client.h"
 #include "mdns/mdns_client.h"
 #include "netbios/nbns_client.h"
@@ -45,6 +46,11 @@
 //Socket table
 Socket socketTable[SOCKET_MAX_COUNT];
 
+//Connected TCP sockets, hashed on the local/remote port and remote address
+static Socket *socketConnHash[SOCKET_HASH_SIZE];
+//Other TCP and UDP sockets (listeners...), hashed on the local port
+static Socket *socketPortHash[SOCKET_HASH_SIZE];
+
 
 /**
  * @brief Socket related initialization
@@ -59,6 +65,10 @@ error_t socketInit(void)
    //Initialize socket descriptors
    memset(socketTable, 0, sizeof(socketTable));
 
+   //The demultiplexing tables are empty
+   memset(socketConnHash, 0, sizeof(socketConnHash));
+   memset(socketPortHash, 0, sizeof(socketPortHash));
+
    //Loop through socket descriptors
    for(i = 0; i < SOCKET_MAX_COUNT; i++)
    {
@@ -82,6 +92,162 @@ error_t socketInit(void)
 }
 
 
+/**
+ * @brief Hash a local port number
+ * @param[in] localPort Local port number
+ * @return Bucket index
+ **/
+
+static uint_t socketHashPort(uint16_t localPort)
+{
+   //Well-known ports differ in their lower bits, ephemeral ones are sequential
+   return (localPort ^ (localPort >> 8)) & (SOCKET_HASH_SIZE - 1);
+}
+
+
+/**
+ * @brief Hash the 4-tuple of a connection
+ * @param[in] localPort Local port number
+ * @param[in] remotePort Remote port number
+ * @param[in] remoteIpAddr Remote IP address
+ * @return Bucket index
+ **/
+
+static uint_t socketHashConn(uint16_t localPort,
+   uint16_t remotePort, const IpAddr *remoteIpAddr)
+{
+   uint32_t h;
+
+   //Combine the port numbers
+   h = ((uint32_t) localPort << 16) | remotePort;
+
+#if (IPV4_SUPPORT == ENABLED)
+   //IPv4 address?
+   if(remoteIpAddr->length == sizeof(Ipv4Addr))
+      h ^= remoteIpAddr->ipv4Addr;
+#endif
+#if (IPV6_SUPPORT == ENABLED)
+   //IPv6 address?
+   if(remoteIpAddr->length == sizeof(Ipv6Addr))
+      h ^= remoteIpAddr->ipv6Addr.dw[0] ^ remoteIpAddr->ipv6Addr.dw[1] ^
+         remoteIpAddr->ipv6Addr.dw[2] ^ remoteIpAddr->ipv6Addr.dw[3];
+#endif
+
+   //Fold the upper bits into the bucket index
+   h ^= h >> 16;
+   h ^= h >> 8;
+
+   return h & (SOCKET_HASH_SIZE - 1);
+}
+
+
+/**
+ * @brief Link a socket into the demultiplexing table matching its tuple
+ *
+ * Must be called with netMutex held whenever the type, the local port or
+ * the remote endpoint of the socket changes. Buckets are kept sorted by
+ * descriptor, so that lookups return the same socket as a linear scan of
+ * the socket table would
+ *
+ * @param[in] socket Handle referencing the socket
+ **/
+
+void socketHashUpdate(Socket *socket)
+{
+   Socket **bucket;
+   Socket **p;
+
+   //Unlink the socket from its current bucket
+   socketHashRemove(socket);
+
+   //Connected TCP socket?
+   if(socket->type == SOCKET_TYPE_STREAM && socket->remotePort != 0 &&
+      socket->remoteIpAddr.length != 0)
+   {
+      bucket = &socketConnHash[socketHashConn(socket->localPort,
+         socket->remotePort, &socket->remoteIpAddr)];
+   }
+   //Listening or unconnected TCP socket, or UDP socket?
+   else if(socket->type == SOCKET_TYPE_STREAM || socket->type == SOCKET_TYPE_DGRAM)
+   {
+      bucket = &socketPortHash[socketHashPort(socket->localPort)];
+   }
+   //Raw sockets are not demultiplexed by port
+   else
+   {
+      return;
+   }
+
+   //Find the insertion point
+   for(p = bucket; *p != NULL; p = &(*p)->hashNext)
+   {
+      if((*p)->descriptor > socket->descriptor)
+         break;
+   }
+
+   //Link the socket
+   socket->hashNext = *p;
+   socket->hashBucket = bucket;
+   *p = socket;
+}
+
+
+/**
+ * @brief Unlink a socket from the demultiplexing tables
+ * @param[in] socket Handle referencing the socket
+ **/
+
+void socketHashRemove(Socket *socket)
+{
+   Socket **p;
+
+   //Not linked into any bucket?
+   if(socket->hashBucket == NULL)
+      return;
+
+   //Find the socket in its bucket
+   for(p = socket->hashBucket; *p != NULL; p = &(*p)->hashNext)
+   {
+      if(*p == socket)
+      {
+         *p = socket->hashNext;
+         break;
+      }
+   }
+
+   //The socket is not linked anymore
+   socket->hashNext = NULL;
+   socket->hashBucket = NULL;
+}
+
+
+/**
+ * @brief Get the sockets that may be bound to a given local port
+ * @param[in] localPort Local port number
+ * @return First socket of the bucket (linked through hashNext)
+ **/
+
+Socket *socketGetPortBucket(uint16_t localPort)
+{
+   return socketPortHash[socketHashPort(localPort)];
+}
+
+
+/**
+ * @brief Get the connected sockets that may match a given 4-tuple
+ * @param[in] localPort Local port number
+ * @param[in] remotePort Remote port number
+ * @param[in] remoteIpAddr Remote IP address
+ * @return First socket of the bucket (linked through hashNext)
+ **/
+
+Socket *socketGetConnBucket(uint16_t localPort,
+   uint16_t remotePort, const IpAddr *remoteIpAddr)
+{
+   return socketConnHash[socketHashConn(localPort, remotePort, remoteIpAddr)];
+}
+
+
 /**
  * @brief Create a socket (UDP or TCP)
  * @param[in] type Type specification for the new socket
@@ -178,6 +344,8 @@ Socket *socketOpen(uint_t type, uint_t protocol)
          i = socket->descriptor;
          //Save event object instance
          memcpy(&event, &socket->event, sizeof(OsEvent));
+         //Stop delivering packets to the previous user of the entry
+         socketHashRemove(socket);
 
          //Clear associated structure
          memset(socket, 0, sizeof(Socket));
@@ -190,10 +358,14 @@ Socket *socketOpen(uint_t type, uint_t protocol)
          socket->protocol = protocol;
          socket->localPort = port;
          socket->timeout = INFINITE_DELAY;
+         //Packets sent to the ephemeral port can now be received
+         socketHashUpdate(socket);
 
 #if (TCP_SUPPORT == ENABLED)
          socket->txBufferSize = MIN(TCP_DEFAULT_TX_BUFFER_SIZE, TCP_MAX_TX_BUFFER_SIZE);
          socket->rxBufferSize = MIN(TCP_DEFAULT_RX_BUFFER_SIZE, TCP_MAX_RX_BUFFER_SIZE);
+         //Attach the TCP timers to the timer wheel
+         tcpInitTimers(socket);
 #endif
       }
    }
@@ -337,9 +509,17 @@ error_t socketBind(Socket *socket, const IpAddr *localIpAddr, uint16_t localPort
    if(socket->type != SOCKET_TYPE_STREAM && socket->type != SOCKET_TYPE_DGRAM)
       return ERROR_INVALID_SOCKET;
 
+   //Get exclusive access
+   osAcquireMutex(&netMutex);
+
    //Associate the specified IP address and port number
    socket->localIpAddr = *localIpAddr;
    socket->localPort = localPort;
+   //The socket is now demultiplexed on the new port
+   socketHashUpdate(socket);
+
+   //Release exclusive access
+   osReleaseMutex(&netMutex);
 
    //No error to report
    return NO_ERROR;
@@ -384,6 +564,8 @@ error_t socketConnect(Socket *socket, const IpAddr *remoteIpAddr, uint16_t remot
       //Get exclusive access
       osAcquireMutex(&netMutex);
 
+      //Segments from the remote host are matched on the full 4-tuple
+      socketHashUpdate(socket);
       //Establish TCP connection
       error = tcpConnect(socket);
 
@@ -587,6 +769,102 @@ error_t socketSendTo(Socket *socket, const IpAddr *destIpAddr, uint16_t destPort
 }
 
 
+#if (TCP_SUPPORT == ENABLED && TCP_ZERO_COPY_SUPPORT == ENABLED)
+
+/**
+ * @brief Send data from long-lived memory without copying it
+ *
+ * The segments, including retransmissions, are built directly from the
+ * specified memory (typically constant data in flash). Data located in RAM
+ * must not be modified until it has been acknowledged, which the
+ * SOCKET_FLAG_WAIT_ACK flag ensures before returning
+ *
+ * @param[in] socket Handle that identifies a connected socket
+ * @param[in] data Pointer to the data to be transmitted
+ * @param[in] length Number of data bytes to send
+ * @param[out] written Actual number of bytes written (optional parameter)
+ * @param[in] flags Set of flags that influences the behavior of this function
+ * @return Error code
+ **/
+
+error_t socketSendStatic(Socket *socket, const void *data,
+   size_t length, size_t *written, uint_t flags)
+{
+   error_t error;
+
+   //No data has been transmitted yet
+   if(written)
+      *written = 0;
+
+   //Make sure the socket handle is valid
+   if(!socket)
+      return ERROR_INVALID_PARAMETER;
+   //Only connection-oriented sockets are supported
+   if(socket->type != SOCKET_TYPE_STREAM)
+      return ERROR_INVALID_SOCKET;
+
+   //Get exclusive access
+   osAcquireMutex(&netMutex);
+   //Reference the data from the send stream
+   error = tcpSendEx(socket, data, length, written, flags, TRUE);
+   //Release exclusive access
+   osReleaseMutex(&netMutex);
+
+   //Return status code
+   return error;
+}
+
+
+/**
+ * @brief Send the contents of a multi-part buffer without copying it
+ *
+ * The socket takes ownership of the buffer, even when an error is returned,
+ * and frees it once the data has been acknowledged
+ *
+ * @param[in] socket Handle that identifies a connected socket
+ * @param[in] buffer Multi-part buffer containing the data to be transmitted
+ * @param[in] offset Offset to the first data byte
+ * @param[in] flags Set of flags that influences the behavior of this function
+ * @return Error code
+ **/
+
+error_t socketSendBuffer(Socket *socket, NetBuffer *buffer,
+   size_t offset, uint_t flags)
+{
+   error_t error;
+
+   //Check parameters
+   if(buffer == NULL)
+      return ERROR_INVALID_PARAMETER;
+
+   //Make sure the socket handle is valid
+   if(!socket)
+   {
+      netBufferFree(buffer);
+      return ERROR_INVALID_PARAMETER;
+   }
+
+   //Only connection-oriented sockets are supported
+   if(socket->type != SOCKET_TYPE_STREAM)
+   {
+      netBufferFree(buffer);
+      return ERROR_INVALID_SOCKET;
+   }
+
+   //Get exclusive access
+   osAcquireMutex(&netMutex);
+   //Segment directly from the buffer
+   error = tcpSendBuffer(socket, buffer, offset, flags);
+   //Release exclusive access
+   osReleaseMutex(&netMutex);
+
+   //Return status code
+   return error;
+}
+
+#endif
+
+
 /**
  * @brief Receive data from a connected socket
  * @param[in] socket Handle that identifies a connected socket
@@ -848,6 +1126,8 @@ void socketClose(Socket *socket)
 
       //Mark the socket as closed
       socket->type = SOCKET_TYPE_UNUSED;
+      //Stop delivering packets to the socket
+      socketHashRemove(socket);
    }
 #endif
 
@@ -1149,7 +1429,7 @@ error_t getHostByName(NetInterface *interface,
       if(protocol == HOST_NAME_RESOLVER_DNS)
       {
          //Perform host name resolution
-         error = dnsResolve(interface, name, type, ipAddr);
+         error = dnsResolve(interface, name, type, flags, ipAddr);
       }
       else
 #endif
@@ -1181,3 +1461,57 @@ error_t getHostByName(NetInterface *interface,
    //Return status code
    return error;
 }
+
+
+/**
+ * @brief Resolve a host name without blocking the calling task
+ *
+ * Only DNS is used. When the name is an IP address or is found in the cache,
+ * the address is returned at once. Otherwise ERROR_IN_PROGRESS is returned
+ * and the callback is invoked when the resolution completes
+ *
+ * @param[in] interface Underlying network interface (optional parameter)
+ * @param[in] name Name of the host to be resolved
+ * @param[out] ipAddr IP address corresponding to the specified host name
+ * @param[in] flags Set of flags that influences the behavior of this function
+ * @param[in] callback Completion callback (optional parameter)
+ * @param[in] param Opaque pointer passed to the callback
+ * @return Error code
+ **/
+
+error_t getHostByNameAsync(NetInterface *interface, const char_t *name,
+   IpAddr *ipAddr, uint_t flags, HostnameCallback callback, void *param)
+{
+#if (DNS_CLIENT_SUPPORT == ENABLED)
+   HostType type;
+
+   //Check parameters
+   if(name == NULL || ipAddr == NULL)
+      return ERROR_INVALID_PARAMETER;
+
+   //Use default network interface?
+   if(interface == NULL)
+      interface = netGetDefaultInterface();
+
+   //No need to resolve an IP address
+   if(!ipStringToAddr(name, ipAddr))
+      return NO_ERROR;
+
+   //The user may provide a hint to choose between IPv4 and IPv6
+   if(flags & HOST_TYPE_IPV6)
+      type = HOST_TYPE_IPV6;
+#if (IPV4_SUPPORT == ENABLED)
+   else
+      type = HOST_TYPE_IPV4;
+#else
+   else
+      type = HOST_TYPE_IPV6;
+#endif
+
+   //Start host name resolution
+   return dnsResolveAsync(interface, name, type, flags, ipAddr, callback, param);
+#else
+   //Not implemented
+   return ERROR_NOT_IMPLEMENTED;
+#endif
+}
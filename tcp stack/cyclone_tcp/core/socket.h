@@ -45,6 +45,13 @@ struct _Socket;
    #error SOCKET_MAX_COUNT parameter is not valid
 #endif
 
+//Number of buckets of the socket demultiplexing tables (power of two)
+#ifndef SOCKET_HASH_SIZE
+   #define SOCKET_HASH_SIZE 16
+#elif (SOCKET_HASH_SIZE < 1 || (SOCKET_HASH_SIZE & (SOCKET_HASH_SIZE - 1)) != 0)
+   #error SOCKET_HASH_SIZE parameter is not valid
+#endif
+
 //Dynamic port range (lower limit)
 #ifndef SOCKET_EPHEMERAL_PORT_MIN
    #define SOCKET_EPHEMERAL_PORT_MIN 49152
@@ -182,6 +189,23 @@ typedef enum
 } HostnameResolver;
 
 
+/**
+ * @brief Host name resolution flags
+ **/
+
+typedef enum
+{
+   HOST_NAME_ALLOW_STALE = 0x0100
+} HostnameFlags;
+
+
+/**
+ * @brief Completion callback of an asynchronous host name resolution
+ **/
+
+typedef void (*HostnameCallback)(error_t error, const IpAddr *ipAddr, void *param);
+
+
 /**
  * @brief Receive queue item
  **/
@@ -218,6 +242,8 @@ struct _Socket
    uint_t eventMask;
    uint_t eventFlags;
    OsEvent *userEvent;
+   struct _Socket *hashNext;
+   struct _Socket **hashBucket;
 
 //TCP specific variables
 #if (TCP_SUPPORT == ENABLED)
@@ -260,9 +286,16 @@ struct _Socket
 
    TcpTxBuffer txBuffer;          ///<Send buffer
    size_t txBufferSize;           ///<Size of the send buffer
+   uint32_t txChecksumSeqNum;     ///<First sequence number covered by txChecksum
+   uint16_t txChecksumLength;     ///<Number of unsent bytes covered by txChecksum
+   uint16_t txChecksum;           ///<1's complement sum computed while filling the send buffer
    TcpRxBuffer rxBuffer;          ///<Receive buffer
    size_t rxBufferSize;           ///<Size of the receive buffer
 
+#if (TCP_ZERO_COPY_SUPPORT == ENABLED)
+   TcpTxRef *txRefQueue;          ///<Caller-owned data not yet acknowledged
+#endif
+
    TcpQueueItem *retransmitQueue; ///<Retransmission queue
    TcpTimer retransmitTimer;      ///<Retransmission timer
    uint_t retransmitCount;        ///<Number of retransmissions
@@ -278,9 +311,12 @@ struct _Socket
    TcpTimer finWait2Timer;        ///<FIN-WAIT-2 timer
    TcpTimer timeWaitTimer;        ///<2MSL timer
 
-   bool_t sackPermitted;                        ///<SACK Permitted option received
+   bool_t sackPermitted;                        ///<SACK in use on the connection
    TcpSackBlock sackBlock[TCP_MAX_SACK_BLOCKS]; ///<List of non-contiguous blocks that have been received
    uint_t sackBlockCount;                       ///<Number of non-contiguous blocks that have been received
+
+   bool_t tsPermitted;            ///<Timestamps option in use on the connection
+   uint32_t tsRecent;             ///<Timestamp to be echoed in the next segment sent
 #endif
 
 //UDP specific variables
@@ -308,6 +344,12 @@ extern Socket socketTable[SOCKET_MAX_COUNT];
 //Socket related functions
 error_t socketInit(void);
 
+void socketHashUpdate(Socket *socket);
+void socketHashRemove(Socket *socket);
+Socket *socketGetPortBucket(uint16_t localPort);
+Socket *socketGetConnBucket(uint16_t localPort,
+   uint16_t remotePort, const IpAddr *remoteIpAddr);
+
 Socket *socketOpen(uint_t type, uint_t protocol);
 
 error_t socketSetTimeout(Socket *socket, systime_t timeout);
@@ -326,6 +368,14 @@ error_t socketSend(Socket *socket, const void *data,
 error_t socketSendTo(Socket *socket, const IpAddr *destIpAddr, uint16_t destPort,
    const void *data, size_t length, size_t *written, uint_t flags);
 
+#if (TCP_SUPPORT == ENABLED && TCP_ZERO_COPY_SUPPORT == ENABLED)
+error_t socketSendStatic(Socket *socket, const void *data,
+   size_t length, size_t *written, uint_t flags);
+
+error_t socketSendBuffer(Socket *socket, NetBuffer *buffer,
+   size_t offset, uint_t flags);
+#endif
+
 error_t socketReceive(Socket *socket, void *data,
    size_t size, size_t *received, uint_t flags);
 
@@ -349,4 +399,7 @@ error_t socketGetEvents(Socket *socket, uint_t *eventFlags);
 error_t getHostByName(NetInterface *interface,
    const char_t *name, IpAddr *ipAddr, uint_t flags);
 
+error_t getHostByNameAsync(NetInterface *interface, const char_t *name,
+   IpAddr *ipAddr, uint_t flags, HostnameCallback callback, void *param);
+
 #endif
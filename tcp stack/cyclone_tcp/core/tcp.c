@@ -42,9 +42,6 @@
 //Check TCP/IP stack configuration
 #if (TCP_SUPPORT == ENABLED)
 
-//Tick counter to handle periodic operations
-systime_t tcpTickCounter;
-
 //Ephemeral ports are used for dynamic port assignment
 static uint16_t tcpDynamicPort;
 
@@ -101,6 +98,62 @@ uint16_t tcpGetDynamicPort(void)
 }
 
 
+/**
+ * @brief Initialize a TCP profile with the compile-time defaults
+ * @param[out] profile Structure that contains the TCP settings
+ **/
+
+void tcpGetDefaultProfile(TcpProfile *profile)
+{
+   //Default buffer sizes
+   profile->txBufferSize = TCP_DEFAULT_TX_BUFFER_SIZE;
+   profile->rxBufferSize = TCP_DEFAULT_RX_BUFFER_SIZE;
+
+   //Negotiate the options the stack was built with
+   profile->sackEnabled = (TCP_SACK_SUPPORT == ENABLED) ? TRUE : FALSE;
+   profile->timestampEnabled = (TCP_TIMESTAMP_SUPPORT == ENABLED) ? TRUE : FALSE;
+}
+
+
+/**
+ * @brief Set the TCP settings of an interface
+ *
+ * The settings apply to the connections opened over the interface from
+ * now on. The structure must remain valid as long as it is in use
+ *
+ * @param[in] interface Underlying network interface
+ * @param[in] profile TCP settings (NULL to revert to the defaults)
+ * @return Error code
+ **/
+
+error_t tcpSetProfile(NetInterface *interface, const TcpProfile *profile)
+{
+   //Check parameters
+   if(interface == NULL)
+      return ERROR_INVALID_PARAMETER;
+
+   //Check buffer sizes
+   if(profile != NULL)
+   {
+      if(profile->txBufferSize > TCP_MAX_TX_BUFFER_SIZE ||
+         profile->rxBufferSize > TCP_MAX_RX_BUFFER_SIZE)
+      {
+         return ERROR_INVALID_PARAMETER;
+      }
+   }
+
+   //Get exclusive access
+   osAcquireMutex(&netMutex);
+   //Save the settings
+   interface->tcpProfile = profile;
+   //Release exclusive access
+   osReleaseMutex(&netMutex);
+
+   //Successful processing
+   return NO_ERROR;
+}
+
+
 /**
  * @brief Establish a TCP connection
  * @param[in] socket Handle to an unconnected socket
@@ -119,6 +172,9 @@ error_t tcpConnect(Socket *socket)
    //The user owns the socket
    socket->ownedFlag = TRUE;
 
+   //Apply the TCP settings of the outgoing interface
+   tcpApplyProfile(socket, socket->interface);
+
    //Number of chunks that comprise the TX and the RX buffers
    socket->txBuffer.maxChunkCount = arraysize(socket->txBuffer.chunk);
    socket->rxBuffer.maxChunkCount = arraysize(socket->rxBuffer.chunk);
@@ -298,6 +354,15 @@ Socket *tcpAccept(Socket *socket, IpAddr *clientIpAddr, uint16_t *clientPort)
          newSocket->txBufferSize = socket->txBufferSize;
          newSocket->rxBufferSize = socket->rxBufferSize;
 
+         //Apply the TCP settings of the interface the SYN came from
+         tcpApplyProfile(newSocket, queueItem->interface);
+
+         //Options remain in use only if the peer offered them as well
+         newSocket->sackPermitted = newSocket->sackPermitted && queueItem->sackPermitted;
+         newSocket->tsPermitted = newSocket->tsPermitted && queueItem->tsPermitted;
+         //Timestamp to be echoed in the SYN/ACK
+         newSocket->tsRecent = queueItem->tsVal;
+
          //Number of chunks that comprise the TX and the RX buffers
          newSocket->txBuffer.maxChunkCount = arraysize(newSocket->txBuffer.chunk);
          newSocket->rxBuffer.maxChunkCount = arraysize(newSocket->rxBuffer.chunk);
@@ -324,10 +389,16 @@ Socket *tcpAccept(Socket *socket, IpAddr *clientIpAddr, uint16_t *clientPort)
             //Save the port number and the IP address of the remote host
             newSocket->remoteIpAddr = queueItem->srcAddr;
             newSocket->remotePort = queueItem->srcPort;
+            //Segments of the connection are matched on the full 4-tuple
+            socketHashUpdate(newSocket);
 
             //Save the maximum segment size
             newSocket->mss = queueItem->mss;
 
+            //The Timestamps option is carried by every segment
+            if(newSocket->tsPermitted)
+               newSocket->mss = MAX(newSocket->mss - TCP_TIMESTAMP_OPTION_SIZE, TCP_MIN_MSS);
+
             //Initialize TCP control block
             newSocket->iss = netGetRand();
             newSocket->irs = queueItem->isn;
@@ -411,6 +482,31 @@ Socket *tcpAccept(Socket *socket, IpAddr *clientIpAddr, uint16_t *clientPort)
 
 error_t tcpSend(Socket *socket, const uint8_t *data,
    size_t length, size_t *written, uint_t flags)
+{
+   //Copy the data to the send buffer
+   return tcpSendEx(socket, data, length, written, flags, FALSE);
+}
+
+
+/**
+ * @brief Send data to a connected socket, optionally without copying it
+ *
+ * When reference is TRUE, the segments are built directly from the caller's
+ * memory, which must remain valid and unchanged until the data has been
+ * acknowledged (or the connection has been closed). Space is still reserved
+ * in the send buffer so that the flow control is not affected
+ *
+ * @param[in] socket Handle that identifies a connected socket
+ * @param[in] data Pointer to a buffer containing the data to be transmitted
+ * @param[in] length Number of bytes to be transmitted
+ * @param[out] written Actual number of bytes written (optional parameter)
+ * @param[in] flags Set of flags that influences the behavior of this function
+ * @param[in] reference Reference the data instead of copying it
+ * @return Error code
+ **/
+
+error_t tcpSendEx(Socket *socket, const uint8_t *data, size_t length,
+   size_t *written, uint_t flags, bool_t reference)
 {
    uint_t n;
    uint_t totalLength;
@@ -420,6 +516,12 @@ error_t tcpSend(Socket *socket, const uint8_t *data,
    if(socket->state == TCP_STATE_LISTEN)
       return ERROR_NOT_CONNECTED;
 
+#if (TCP_ZERO_COPY_SUPPORT == DISABLED)
+   //Data can only be copied to the send buffer
+   if(reference)
+      return ERROR_NOT_IMPLEMENTED;
+#endif
+
    //Actual number of bytes written
    totalLength = 0;
 
@@ -471,8 +573,22 @@ error_t tcpSend(Socket *socket, const uint8_t *data,
       //Any data to copy?
       if(n > 0)
       {
-         //Copy user data to send buffer
-         tcpWriteTxBuffer(socket, socket->sndNxt + socket->sndUser, data, n);
+#if (TCP_ZERO_COPY_SUPPORT == ENABLED)
+         //Zero-copy operation?
+         if(reference)
+         {
+            //Segments will read the data from the caller's memory
+            error_t error = tcpAddTxRef(socket, socket->sndNxt + socket->sndUser, data, n);
+            //Any error to report?
+            if(error)
+               return error;
+         }
+         else
+#endif
+         {
+            //Copy user data to send buffer
+            tcpWriteTxBuffer(socket, socket->sndNxt + socket->sndUser, data, n);
+         }
 
          //Update the number of data buffered but not yet sent
          socket->sndUser += n;
@@ -523,6 +639,121 @@ error_t tcpSend(Socket *socket, const uint8_t *data,
 }
 
 
+#if (TCP_ZERO_COPY_SUPPORT == ENABLED)
+
+/**
+ * @brief Send the contents of a multi-part buffer without copying it
+ *
+ * The function takes ownership of the buffer in all cases. The buffer is
+ * freed once its data has been acknowledged, when the connection is closed,
+ * or immediately if nothing could be queued
+ *
+ * @param[in] socket Handle that identifies a connected socket
+ * @param[in] buffer Multi-part buffer containing the data to be transmitted
+ * @param[in] offset Offset to the first data byte
+ * @param[in] flags Set of flags that influences the behavior of this function
+ * @return Error code
+ **/
+
+error_t tcpSendBuffer(Socket *socket, NetBuffer *buffer,
+   size_t offset, uint_t flags)
+{
+   error_t error;
+   uint_t i;
+   uint_t event;
+   size_t n;
+   size_t written;
+   bool_t queued;
+   TcpTxRef *ownerRef;
+
+   //The last item of the queue releases the buffer once acknowledged
+   ownerRef = memPoolAlloc(sizeof(TcpTxRef));
+
+   //Failed to allocate memory?
+   if(ownerRef == NULL)
+   {
+      //The caller no longer owns the buffer
+      netBufferFree(buffer);
+      //Report an error
+      return ERROR_OUT_OF_MEMORY;
+   }
+
+   //Initialize variables
+   error = NO_ERROR;
+   queued = FALSE;
+
+   //Loop through data chunks
+   for(i = 0; i < buffer->chunkCount && !error; i++)
+   {
+      //Skip the data that precede the specified offset
+      if(offset >= buffer->chunk[i].length)
+      {
+         offset -= buffer->chunk[i].length;
+         continue;
+      }
+
+      //Number of bytes to send from the current chunk
+      n = buffer->chunk[i].length - offset;
+      written = 0;
+
+      //Tiny segments are avoided until the last chunk has been queued
+      error = tcpSendEx(socket, (uint8_t *) buffer->chunk[i].address + offset, n, &written,
+         (i + 1 < buffer->chunkCount) ? SOCKET_FLAG_DELAY : (flags & ~SOCKET_FLAG_WAIT_ACK), TRUE);
+
+      //Part of the buffer is now referenced by the send stream
+      if(written > 0)
+         queued = TRUE;
+
+      //Process the next chunk
+      offset = 0;
+   }
+
+   //Any data referenced by the send stream?
+   if(queued)
+   {
+      //The buffer is freed once the last queued byte is acknowledged
+      ownerRef->seqNum = socket->sndNxt + socket->sndUser;
+      ownerRef->data = NULL;
+      ownerRef->length = 0;
+      ownerRef->owner = buffer;
+
+      //Append the item to the queue
+      tcpLinkTxRef(socket, ownerRef);
+   }
+   else
+   {
+      //Nothing refers to the buffer
+      netBufferFree(buffer);
+      memPoolFree(ownerRef);
+   }
+
+   //Failed to queue the whole buffer?
+   if(error)
+      return error;
+
+   //The SOCKET_FLAG_WAIT_ACK flag causes the function to
+   //wait for acknowledgment from the remote side
+   if(flags & SOCKET_FLAG_WAIT_ACK)
+   {
+      //Wait for the data to be acknowledged
+      event = tcpWaitForEvents(socket, SOCKET_EVENT_TX_ACKED, socket->timeout);
+
+      //A timeout exception occurred?
+      if(event != SOCKET_EVENT_TX_ACKED)
+         return ERROR_TIMEOUT;
+
+      //The connection was closed before an acknowledgment was received?
+      if(socket->state != TCP_STATE_ESTABLISHED && socket->state != TCP_STATE_CLOSE_WAIT)
+         return ERROR_NOT_CONNECTED;
+   }
+
+   //Successful write operation
+   return NO_ERROR;
+}
+
+#endif
+
+
 /**
  * @brief Receive data from a connected socket
  * @param[in] socket Handle that identifies a connected socket
@@ -850,6 +1081,8 @@ error_t tcpAbort(Socket *socket)
       tcpDeleteControlBlock(socket);
       //Mark the socket as closed
       socket->type = SOCKET_TYPE_UNUSED;
+      //Stop delivering segments to the socket
+      socketHashRemove(socket);
       //Return status code
       return error;
 
@@ -868,6 +1101,8 @@ error_t tcpAbort(Socket *socket)
       tcpDeleteControlBlock(socket);
       //Mark the socket as closed
       socket->type = SOCKET_TYPE_UNUSED;
+      //Stop delivering segments to the socket
+      socketHashRemove(socket);
       //No error to report
       return NO_ERROR;
 #endif
@@ -880,6 +1115,8 @@ error_t tcpAbort(Socket *socket)
       tcpDeleteControlBlock(socket);
       //Mark the socket as closed
       socket->type = SOCKET_TYPE_UNUSED;
+      //Stop delivering segments to the socket
+      socketHashRemove(socket);
       //No error to report
       return NO_ERROR;
    }
@@ -962,6 +1199,8 @@ Socket *tcpKillOldestConnection(void)
       tcpDeleteControlBlock(oldestSocket);
       //Mark the socket as closed
       oldestSocket->type = SOCKET_TYPE_UNUSED;
+      //Stop delivering segments to the socket
+      socketHashRemove(oldestSocket);
    }
 
    //The oldest connection in the TIME-WAIT state can be reused
@@ -32,6 +32,7 @@
 //Dependencies
 #include "net_config.h"
 #include "core/ip.h"
+#include "core/net_timer.h"
 
 //TCP support
 #ifndef TCP_SUPPORT
@@ -40,13 +41,6 @@
    #error TCP_SUPPORT parameter is not valid
 #endif
 
-//TCP tick interval
-#ifndef TCP_TICK_INTERVAL
-   #define TCP_TICK_INTERVAL 100
-#elif (TCP_TICK_INTERVAL < 10)
-   #error TCP_TICK_INTERVAL parameter is not valid
-#endif
-
 //Maximum segment size
 #ifndef TCP_MAX_MSS
    #define TCP_MAX_MSS 1430
@@ -208,8 +202,24 @@
    #error TCP_MAX_SACK_BLOCKS parameter is not valid
 #endif
 
+//Timestamps option support (RTT measurement and PAWS)
+#ifndef TCP_TIMESTAMP_SUPPORT
+   #define TCP_TIMESTAMP_SUPPORT DISABLED
+#elif (TCP_TIMESTAMP_SUPPORT != ENABLED && TCP_TIMESTAMP_SUPPORT != DISABLED)
+   #error TCP_TIMESTAMP_SUPPORT parameter is not valid
+#endif
+
+//Zero-copy send support (segments built from caller-owned memory)
+#ifndef TCP_ZERO_COPY_SUPPORT
+   #define TCP_ZERO_COPY_SUPPORT ENABLED
+#elif (TCP_ZERO_COPY_SUPPORT != ENABLED && TCP_ZERO_COPY_SUPPORT != DISABLED)
+   #error TCP_ZERO_COPY_SUPPORT parameter is not valid
+#endif
+
 //Maximum TCP header length
 #define TCP_MAX_HEADER_LENGTH 60
+//Space taken by the Timestamps option, including padding
+#define TCP_TIMESTAMP_OPTION_SIZE 12
 //Default maximum segment size
 #define TCP_DEFAULT_MSS 536
 
@@ -341,6 +351,7 @@ typedef struct
    bool_t running;
    systime_t startTime;
    systime_t interval;
+   NetTimer entry;      ///<Entry in the timer wheel
 } TcpTimer;
 
 
@@ -353,6 +364,7 @@ typedef struct _TcpQueueItem
    struct _TcpQueueItem *next;
    uint_t length;
    uint_t sacked;
+   bool_t retransmitted;
    IpPseudoHeader pseudoHeader;
    uint8_t header[TCP_MAX_HEADER_LENGTH];
 } TcpQueueItem;
@@ -371,9 +383,29 @@ typedef struct _TcpSynQueueItem
    IpAddr destAddr;
    uint32_t isn;
    uint16_t mss;
+   bool_t sackPermitted;
+   bool_t tsPermitted;
+   uint32_t tsVal;
 } TcpSynQueueItem;
 
 
+/**
+ * @brief Caller-owned data in the send stream
+ *
+ * The bytes are read from the caller's memory instead of the send buffer
+ * until they are acknowledged. The owner, if any, is released at that time
+ **/
+
+typedef struct _TcpTxRef
+{
+   struct _TcpTxRef *next;
+   uint32_t seqNum;     ///<Sequence number of the first byte
+   const uint8_t *data; ///<Caller's memory
+   size_t length;       ///<Number of bytes referenced
+   NetBuffer *owner;    ///<Buffer to free once the data is acknowledged
+} TcpTxRef;
+
+
 /**
  * @brief SACK block
  **/
@@ -385,6 +417,22 @@ typedef struct
 } TcpSackBlock;
 
 
+/**
+ * @brief Per-interface TCP settings
+ *
+ * Applied to the connections running over the interface. The buffer sizes
+ * are lower bounds, a larger size requested by the application is kept
+ **/
+
+typedef struct _TcpProfile
+{
+   size_t txBufferSize;     ///<Minimum size of the send buffer
+   size_t rxBufferSize;     ///<Minimum size of the receive buffer
+   bool_t sackEnabled;      ///<Negotiate selective acknowledgments
+   bool_t timestampEnabled; ///<Negotiate the Timestamps option
+} TcpProfile;
+
+
 /**
  * @brief Transmit buffer
  **/
@@ -409,13 +457,13 @@ typedef struct
 } TcpRxBuffer;
 
 
-//Tick counter to handle periodic operations
-extern systime_t tcpTickCounter;
-
 //TCP related functions
 error_t tcpInit(void);
 uint16_t tcpGetDynamicPort(void);
 
+void tcpGetDefaultProfile(TcpProfile *profile);
+error_t tcpSetProfile(NetInterface *interface, const TcpProfile *profile);
+
 error_t tcpConnect(Socket *socket);
 error_t tcpListen(Socket *socket, uint_t backlog);
 Socket *tcpAccept(Socket *socket, IpAddr *clientIpAddr, uint16_t *clientPort);
@@ -423,6 +471,14 @@ Socket *tcpAccept(Socket *socket, IpAddr *clientIpAddr, uint16_t *clientPort);
 error_t tcpSend(Socket *socket, const uint8_t *data,
    size_t length, size_t *written, uint_t flags);
 
+error_t tcpSendEx(Socket *socket, const uint8_t *data, size_t length,
+   size_t *written, uint_t flags, bool_t reference);
+
+#if (TCP_ZERO_COPY_SUPPORT == ENABLED)
+error_t tcpSendBuffer(Socket *socket, NetBuffer *buffer,
+   size_t offset, uint_t flags);
+#endif
+
 error_t tcpReceive(Socket *socket, uint8_t *data,
    size_t size, size_t *received, uint_t flags);
 
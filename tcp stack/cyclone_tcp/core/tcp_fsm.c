@@ -69,10 +69,8 @@
 void tcpProcessSegment(NetInterface *interface,
    IpPseudoHeader *pseudoHeader, const NetBuffer *buffer, size_t offset)
 {
-   uint_t i;
    size_t length;
    Socket *socket;
-   Socket *passiveSocket;
    TcpHeader *segment;
 
    //Total number of segments received, including those received in error
@@ -151,99 +149,8 @@ void tcpProcessSegment(NetInterface *interface,
       return;
    }
 
-   //No matching socket in the LISTEN state for the moment
-   passiveSocket = NULL;
-
-   //Look through opened sockets
-   for(i = 0; i < SOCKET_MAX_COUNT; i++)
-   {
-      //Point to the current socket
-      socket = socketTable + i;
-
-      //TCP socket found?
-      if(socket->type != SOCKET_TYPE_STREAM)
-         continue;
-      //Check whether the socket is bound to a particular interface
-      if(socket->interface && socket->interface != interface)
-         continue;
-      //Check destination port number
-      if(socket->localPort != ntohs(segment->destPort))
-         continue;
-
-#if (IPV4_SUPPORT == ENABLED)
-      //An IPv4 packet was received?
-      if(pseudoHeader->length == sizeof(Ipv4PseudoHeader))
-      {
-         //Destination IP address filtering
-         if(socket->localIpAddr.length)
-         {
-            //An IPv4 address is expected
-            if(socket->localIpAddr.length != sizeof(Ipv4Addr))
-               continue;
-            //Filter out non-matching addresses
-            if(socket->localIpAddr.ipv4Addr != pseudoHeader->ipv4Data.destAddr)
-               continue;
-         }
-         //Source IP address filtering
-         if(socket->remoteIpAddr.length)
-         {
-            //An IPv4 address is expected
-            if(socket->remoteIpAddr.length != sizeof(Ipv4Addr))
-               continue;
-            //Filter out non-matching addresses
-            if(socket->remoteIpAddr.ipv4Addr != pseudoHeader->ipv4Data.srcAddr)
-               continue;
-         }
-      }
-      else
-#endif
-#if (IPV6_SUPPORT == ENABLED)
-      //An IPv6 packet was received?
-      if(pseudoHeader->length == sizeof(Ipv6PseudoHeader))
-      {
-         //Destination IP address filtering
-         if(socket->localIpAddr.length)
-         {
-            //An IPv6 address is expected
-            if(socket->localIpAddr.length != sizeof(Ipv6Addr))
-               continue;
-            //Filter out non-matching addresses
-            if(!ipv6CompAddr(&socket->localIpAddr.ipv6Addr, &pseudoHeader->ipv6Data.destAddr))
-               continue;
-         }
-         //Source IP address filtering
-         if(socket->remoteIpAddr.length)
-         {
-            //An IPv6 address is expected
-            if(socket->remoteIpAddr.length != sizeof(Ipv6Addr))
-               continue;
-            //Filter out non-matching addresses
-            if(!ipv6CompAddr(&socket->remoteIpAddr.ipv6Addr, &pseudoHeader->ipv6Data.srcAddr))
-               continue;
-         }
-      }
-      else
-#endif
-      //An invalid packet was received?
-      {
-         //This should never occur...
-         continue;
-      }
-
-      //Keep track of the first matching socket in the LISTEN state
-      if(socket->state == TCP_STATE_LISTEN && !passiveSocket)
-         passiveSocket = socket;
-      //Source port filtering
-      if(socket->remotePort != ntohs(segment->srcPort))
-         continue;
-
-      //A matching socket has been found
-      break;
-   }
-
-   //If no matching socket has been found then try to
-   //use the first matching socket in the LISTEN state
-   if(i >= SOCKET_MAX_COUNT) socket = passiveSocket;
+   //Find the connection or the listening socket the segment belongs to
+   socket = tcpFindSocket(interface, pseudoHeader, segment);
 
    //Offset to the first data byte
    offset += segment->dataOffset * 4;
@@ -519,6 +426,16 @@ void tcpStateListen(Socket *socket, NetInterface *interface,
          queueItem->mss = MAX(queueItem->mss, TCP_MIN_MSS);
       }
 
+      //Check whether the peer is willing to use selective acknowledgments
+      option = tcpGetOption(segment, TCP_OPTION_SACK_PERMITTED);
+      queueItem->sackPermitted = (option != NULL && option->length == 2) ? TRUE : FALSE;
+
+      //Check whether the peer supports the Timestamps option
+      option = tcpGetOption(segment, TCP_OPTION_TIMESTAMP);
+      queueItem->tsPermitted = (option != NULL && option->length == 10) ? TRUE : FALSE;
+      //Save the timestamp to be echoed in the SYN/ACK
+      queueItem->tsVal = queueItem->tsPermitted ? LOAD32BE(option->value) : 0;
+
       //Notify user that a connection request is pending
       tcpUpdateEvents(socket);
 
@@ -617,6 +534,25 @@ void tcpStateSynSent(Socket *socket, TcpHeader *segment, size_t length)
          socket->mss = MAX(socket->mss, TCP_MIN_MSS);
       }
 
+      //Selective acknowledgments are used only if both ends offered them
+      option = tcpGetOption(segment, TCP_OPTION_SACK_PERMITTED);
+      if(option == NULL || option->length != 2)
+         socket->sackPermitted = FALSE;
+
+      //Same for the Timestamps option
+      option = tcpGetOption(segment, TCP_OPTION_TIMESTAMP);
+      if(option == NULL || option->length != 10)
+         socket->tsPermitted = FALSE;
+
+      //Timestamps option in use?
+      if(socket->tsPermitted)
+      {
+         //Save the timestamp to be echoed
+         socket->tsRecent = LOAD32BE(option->value);
+         //The option is carried by every segment
+         socket->mss = MAX(socket->mss - TCP_TIMESTAMP_OPTION_SIZE, TCP_MIN_MSS);
+      }
+
 #if (TCP_CONGEST_CONTROL_SUPPORT == ENABLED)
       //Initial congestion window
       socket->cwnd = MIN(TCP_INITIAL_WINDOW * socket->mss, socket->txBufferSize);
@@ -1134,6 +1070,8 @@ void tcpStateTimeWait(Socket *socket, TcpHeader *segment, size_t length)
          tcpDeleteControlBlock(socket);
          //Mark the socket as closed
          socket->type = SOCKET_TYPE_UNUSED;
+         //Stop delivering segments to the socket
+         socketHashRemove(socket);
       }
 
       //Return immediately
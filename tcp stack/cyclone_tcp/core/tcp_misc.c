@@ -65,6 +65,7 @@ error_t tcpSendSegment(Socket *socket, uint8_t flags, uint32_t seqNum,
    error_t error;
    size_t offset;
    size_t totalLength;
+   size_t checksumLength;
    NetBuffer *buffer;
    TcpHeader *segment;
    TcpQueueItem *queueItem;
@@ -102,11 +103,58 @@ error_t tcpSendSegment(Socket *socket, uint8_t flags, uint32_t seqNum,
       tcpAddOption(segment, TCP_OPTION_MAX_SEGMENT_SIZE, &mss, sizeof(mss));
 
 #if (TCP_SACK_SUPPORT == ENABLED)
-      //Append SACK Permitted option
-      tcpAddOption(segment, TCP_OPTION_SACK_PERMITTED, NULL, 0);
+      //Offer selective acknowledgments?
+      if(socket->sackPermitted)
+      {
+         //Append SACK Permitted option
+         tcpAddOption(segment, TCP_OPTION_SACK_PERMITTED, NULL, 0);
+      }
 #endif
    }
 
+#if (TCP_TIMESTAMP_SUPPORT == ENABLED)
+   //Once negotiated, the Timestamps option is sent in every segment
+   //except RST segments (refer to RFC 7323, section 3.2)
+   if(socket->tsPermitted && !(flags & TCP_FLAG_RST))
+   {
+      uint32_t timestamp[2];
+
+      //TSval field holds the current value of the timestamp clock
+      timestamp[0] = htonl(osGetSystemTime());
+      //TSecr field is only valid when the ACK bit is set
+      timestamp[1] = (flags & TCP_FLAG_ACK) ? htonl(socket->tsRecent) : 0;
+
+      //Append Timestamps option
+      tcpAddOption(segment, TCP_OPTION_TIMESTAMP, timestamp, sizeof(timestamp));
+   }
+#endif
+
+#if (TCP_SACK_SUPPORT == ENABLED)
+   //Report the out-of-order blocks held in the receive buffer
+   if(socket->sackPermitted && socket->sackBlockCount > 0 &&
+      length == 0 && !(flags & (TCP_FLAG_SYN | TCP_FLAG_RST)))
+   {
+      uint_t i;
+      uint_t n;
+      uint32_t edge[2 * TCP_MAX_SACK_BLOCKS];
+
+      //Number of blocks that fit in the remaining option space
+      //(2 bytes of padding and 2 bytes for kind and length)
+      n = (TCP_MAX_HEADER_LENGTH - segment->dataOffset * 4 - 4) / sizeof(TcpSackBlock);
+      n = MIN(n, socket->sackBlockCount);
+
+      //The first block reports the most recently received segment
+      for(i = 0; i < n; i++)
+      {
+         edge[2 * i] = htonl(socket->sackBlock[i].leftEdge);
+         edge[2 * i + 1] = htonl(socket->sackBlock[i].rightEdge);
+      }
+
+      //Append SACK option
+      tcpAddOption(segment, TCP_OPTION_SACK, edge, n * sizeof(TcpSackBlock));
+   }
+#endif
+
    //Adjust the length of the multi-part buffer
    netBufferSetLength(buffer, offset + segment->dataOffset * 4);
 
@@ -128,6 +176,23 @@ error_t tcpSendSegment(Socket *socket, uint8_t flags, uint32_t seqNum,
    //Calculate the length of the complete TCP segment
    totalLength = segment->dataOffset * 4 + length;
 
+   //When the segment carries exactly the data covered by the running sum,
+   //the payload does not need to be read again. The sum is stored in the
+   //checksum field, which is then folded in with the header
+   if(length > 0 && seqNum == socket->txChecksumSeqNum &&
+      length == socket->txChecksumLength)
+   {
+      //Payload sum computed while filling the send buffer
+      segment->checksum = socket->txChecksum;
+      //Checksum the header only
+      checksumLength = segment->dataOffset * 4;
+   }
+   else
+   {
+      //Checksum the complete segment
+      checksumLength = totalLength;
+   }
+
 #if (IPV4_SUPPORT == ENABLED)
    //Destination address is an IPv4 address?
    if(socket->remoteIpAddr.length == sizeof(Ipv4Addr))
@@ -142,7 +207,7 @@ error_t tcpSendSegment(Socket *socket, uint8_t flags, uint32_t seqNum,
 
       //Calculate TCP header checksum
       segment->checksum = ipCalcUpperLayerChecksumEx(&pseudoHeader.ipv4Data,
-         sizeof(Ipv4PseudoHeader), buffer, offset, totalLength);
+         sizeof(Ipv4PseudoHeader), buffer, offset, checksumLength);
    }
    else
 #endif
@@ -160,7 +225,7 @@ error_t tcpSendSegment(Socket *socket, uint8_t flags, uint32_t seqNum,
 
       //Calculate TCP header checksum
       segment->checksum = ipCalcUpperLayerChecksumEx(&pseudoHeader.ipv6Data,
-         sizeof(Ipv6PseudoHeader), buffer, offset, totalLength);
+         sizeof(Ipv6PseudoHeader), buffer, offset, checksumLength);
    }
    else
 #endif
@@ -208,6 +273,7 @@ error_t tcpSendSegment(Socket *socket, uint8_t flags, uint32_t seqNum,
       queueItem->next = NULL;
       queueItem->length = length;
       queueItem->sacked = FALSE;
+      queueItem->retransmitted = FALSE;
       //Save TCP header
       memcpy(queueItem->header, segment, segment->dataOffset * 4);
       //Save pseudo header
@@ -519,6 +585,44 @@ error_t tcpCheckSequenceNumber(Socket *socket, TcpHeader *segment, size_t length
    //Acceptability test for an incoming segment
    bool_t acceptable = FALSE;
 
+#if (TCP_TIMESTAMP_SUPPORT == ENABLED)
+   //Timestamps option in use on the connection?
+   if(socket->tsPermitted)
+   {
+      uint32_t tsVal;
+      TcpOption *option;
+
+      //Search for the Timestamps option
+      option = tcpGetOption(segment, TCP_OPTION_TIMESTAMP);
+
+      //Check option length
+      if(option != NULL && option->length == 10)
+      {
+         //Retrieve the timestamp of the sender
+         tsVal = LOAD32BE(option->value);
+
+         //PAWS: a segment carrying a timestamp older than the most recent one
+         //is an old duplicate and must be rejected (refer to RFC 7323, section 5.3)
+         if(TCP_CMP_SEQ(tsVal, socket->tsRecent) < 0 && !(segment->flags & TCP_FLAG_RST))
+         {
+            //Debug message
+            TRACE_WARNING("TCP segment rejected by PAWS!\r\n");
+
+            //Send an acknowledgment in reply
+            tcpSendSegment(socket, TCP_FLAG_ACK, socket->sndNxt, socket->rcvNxt, 0, FALSE);
+            //Drop the segment
+            return ERROR_FAILURE;
+         }
+
+         //The timestamp to be echoed is taken from the segment that fills the
+         //left edge of the window (every segment is acknowledged immediately,
+         //so RCV.NXT stands for Last.ACK.sent)
+         if(TCP_CMP_SEQ(segment->seqNum, socket->rcvNxt) <= 0)
+            socket->tsRecent = tsVal;
+      }
+   }
+#endif
+
    //Case where both segment length and receive window are zero
    if(!length && !socket->rcvWnd)
    {
@@ -619,6 +723,7 @@ error_t tcpCheckAck(Socket *socket, TcpHeader *segment, size_t length)
    uint_t thresh;
    bool_t duplicateFlag;
    bool_t updateFlag;
+   bool_t lossFlag;
 
    //If the ACK bit is off drop the segment and return
    if(!(segment->flags & TCP_FLAG_ACK))
@@ -644,6 +749,12 @@ error_t tcpCheckAck(Socket *socket, TcpHeader *segment, size_t length)
    //Check whether the ACK is a duplicate
    duplicateFlag = tcpIsDuplicateAck(socket, segment, length);
 
+#if (TCP_SACK_SUPPORT == ENABLED)
+   //Record the segments the receiver holds out of order
+   if(socket->sackPermitted)
+      tcpUpdateScoreboard(socket, segment);
+#endif
+
    //The send window should be updated
    tcpUpdateSendWindow(socket, segment);
 
@@ -667,6 +778,13 @@ error_t tcpCheckAck(Socket *socket, TcpHeader *segment, size_t length)
       //Compute retransmission timeout
       updateFlag = tcpComputeRto(socket);
 
+#if (TCP_TIMESTAMP_SUPPORT == ENABLED)
+      //The echoed timestamp gives an RTT sample for every ACK covering
+      //new data, including retransmitted data (refer to RFC 7323, section 4)
+      if(socket->tsPermitted)
+         tcpTimestampRtt(socket, segment);
+#endif
+
       //Any segments on the retransmission queue which are thereby
       //entirely acknowledged are removed
       tcpUpdateRetransmitQueue(socket);
@@ -753,7 +871,20 @@ error_t tcpCheckAck(Socket *socket, TcpHeader *segment, size_t length)
          }
 
          //Check the number of duplicate ACKs that have been received
-         if(socket->dupAckCount >= thresh)
+         lossFlag = (socket->dupAckCount >= thresh);
+
+#if (TCP_SACK_SUPPORT == ENABLED)
+         //With SACK, the first unacknowledged segment is also deemed lost once
+         //enough segments sent after it have arrived (refer to RFC 6675)
+         if(socket->sackPermitted && socket->retransmitQueue != NULL)
+         {
+            if(tcpIsLostSegment(socket, socket->retransmitQueue))
+               lossFlag = TRUE;
+         }
+#endif
+
+         //Loss detected?
+         if(lossFlag)
          {
             //The TCP sender first checks the value of recover to see if the
             //cumulative acknowledgment field covers more than recover
@@ -771,6 +902,15 @@ error_t tcpCheckAck(Socket *socket, TcpHeader *segment, size_t length)
       }
       else if(socket->congestState == TCP_CONGEST_STATE_RECOVERY)
       {
+#if (TCP_SACK_SUPPORT == ENABLED)
+         //With SACK, the scoreboard tells how much data is still in flight
+         if(socket->sackPermitted)
+         {
+            //Retransmit the segments that are deemed lost
+            tcpSackRecovery(socket);
+         }
+         else
+#endif
          //Duplicate ACK received?
          if(duplicateFlag)
          {
@@ -860,6 +1000,36 @@ void tcpFastRetransmit(Socket *socket)
    //Debug message
    TRACE_INFO("TCP fast retransmit...\r\n");
 
+#if (TCP_SACK_SUPPORT == ENABLED)
+   //SACK-based loss recovery?
+   if(socket->sackPermitted && socket->retransmitQueue != NULL)
+   {
+      TcpQueueItem *queueItem;
+
+      //The amount of data in flight is estimated from the scoreboard, so
+      //the congestion window is not inflated (refer to RFC 6675, section 5)
+      socket->cwnd = socket->ssthresh;
+      //Enter the fast recovery procedure
+      socket->congestState = TCP_CONGEST_STATE_RECOVERY;
+
+      //Forget about the retransmissions made before
+      for(queueItem = socket->retransmitQueue; queueItem != NULL; queueItem = queueItem->next)
+         queueItem->retransmitted = FALSE;
+
+      //Retransmit the first unacknowledged segment
+      if(!tcpRetransmitQueueItem(socket, socket->retransmitQueue))
+         socket->retransmitQueue->retransmitted = TRUE;
+
+      //The retransmission gets a full RTO before the timer gives up on it
+      tcpTimerStart(&socket->retransmitTimer, socket->rto);
+
+      //Then any other segment deemed lost, as the window allows
+      tcpSackRecovery(socket);
+      //Exit immediately
+      return;
+   }
+#endif
+
    //TCP performs a retransmission of what appears to be the missing segment,
    //without waiting for the retransmission timer to expire
    tcpRetransmitSegment(socket);
@@ -903,6 +1073,25 @@ void tcpFastRecovery(Socket *socket, TcpHeader *segment, uint_t n)
       //recover, then this is a partial ACK
       TRACE_INFO("TCP partial acknowledgment\r\n");
 
+#if (TCP_SACK_SUPPORT == ENABLED)
+      //SACK-based loss recovery?
+      if(socket->sackPermitted)
+      {
+         //A partial ACK shows that the first unacknowledged segment is
+         //missing as well
+         if(socket->retransmitQueue != NULL && !socket->retransmitQueue->retransmitted)
+         {
+            if(!tcpRetransmitQueueItem(socket, socket->retransmitQueue))
+               socket->retransmitQueue->retransmitted = TRUE;
+         }
+
+         //Retransmit the other segments deemed lost, as the window allows
+         tcpSackRecovery(socket);
+         //Do not exit the fast recovery procedure...
+         return;
+      }
+#endif
+
       //Retransmit the first unacknowledged segment
       tcpRetransmitSegment(socket);
 
@@ -1028,6 +1217,193 @@ void tcpProcessSegmentData(Socket *socket, TcpHeader *segment,
 }
 
 
+/**
+ * @brief Check whether a socket accepts a segment (remote port aside)
+ * @param[in] socket Handle referencing the socket
+ * @param[in] interface Underlying network interface
+ * @param[in] pseudoHeader TCP pseudo header
+ * @param[in] destPort Destination port of the segment
+ * @return TRUE if the socket type, interface, local port and addresses match
+ **/
+
+static bool_t tcpMatchSocket(Socket *socket, NetInterface *interface,
+   const IpPseudoHeader *pseudoHeader, uint16_t destPort)
+{
+   //TCP socket found?
+   if(socket->type != SOCKET_TYPE_STREAM)
+      return FALSE;
+   //Check whether the socket is bound to a particular interface
+   if(socket->interface && socket->interface != interface)
+      return FALSE;
+   //Check destination port number
+   if(socket->localPort != destPort)
+      return FALSE;
+
+#if (IPV4_SUPPORT == ENABLED)
+   //An IPv4 packet was received?
+   if(pseudoHeader->length == sizeof(Ipv4PseudoHeader))
+   {
+      //Destination IP address filtering
+      if(socket->localIpAddr.length)
+      {
+         //An IPv4 address is expected
+         if(socket->localIpAddr.length != sizeof(Ipv4Addr))
+            return FALSE;
+         //Filter out non-matching addresses
+         if(socket->localIpAddr.ipv4Addr != pseudoHeader->ipv4Data.destAddr)
+            return FALSE;
+      }
+      //Source IP address filtering
+      if(socket->remoteIpAddr.length)
+      {
+         //An IPv4 address is expected
+         if(socket->remoteIpAddr.length != sizeof(Ipv4Addr))
+            return FALSE;
+         //Filter out non-matching addresses
+         if(socket->remoteIpAddr.ipv4Addr != pseudoHeader->ipv4Data.srcAddr)
+            return FALSE;
+      }
+   }
+   else
+#endif
+#if (IPV6_SUPPORT == ENABLED)
+   //An IPv6 packet was received?
+   if(pseudoHeader->length == sizeof(Ipv6PseudoHeader))
+   {
+      //Destination IP address filtering
+      if(socket->localIpAddr.length)
+      {
+         //An IPv6 address is expected
+         if(socket->localIpAddr.length != sizeof(Ipv6Addr))
+            return FALSE;
+         //Filter out non-matching addresses
+         if(!ipv6CompAddr(&socket->localIpAddr.ipv6Addr, &pseudoHeader->ipv6Data.destAddr))
+            return FALSE;
+      }
+      //Source IP address filtering
+      if(socket->remoteIpAddr.length)
+      {
+         //An IPv6 address is expected
+         if(socket->remoteIpAddr.length != sizeof(Ipv6Addr))
+            return FALSE;
+         //Filter out non-matching addresses
+         if(!ipv6CompAddr(&socket->remoteIpAddr.ipv6Addr, &pseudoHeader->ipv6Data.srcAddr))
+            return FALSE;
+      }
+   }
+   else
+#endif
+   //An invalid packet was received?
+   {
+      //This should never occur...
+      return FALSE;
+   }
+
+   //The socket meets all the criteria
+   return TRUE;
+}
+
+
+/**
+ * @brief Find the socket an incoming segment is addressed to
+ *
+ * A socket whose 4-tuple matches the segment takes precedence over the
+ * first matching socket in the LISTEN state. Only the buckets of the
+ * demultiplexing tables that can hold a match are visited
+ *
+ * @param[in] interface Underlying network interface
+ * @param[in] pseudoHeader TCP pseudo header
+ * @param[in] segment Incoming TCP segment (network byte order)
+ * @return Handle referencing the socket, or NULL if the port is unreachable
+ **/
+
+Socket *tcpFindSocket(NetInterface *interface,
+   const IpPseudoHeader *pseudoHeader, const TcpHeader *segment)
+{
+   uint16_t srcPort;
+   uint16_t destPort;
+   IpAddr srcIpAddr;
+   Socket *socket;
+   Socket *passiveSocket;
+
+   //Port numbers of the segment
+   srcPort = ntohs(segment->srcPort);
+   destPort = ntohs(segment->destPort);
+
+#if (IPV4_SUPPORT == ENABLED)
+   //An IPv4 packet was received?
+   if(pseudoHeader->length == sizeof(Ipv4PseudoHeader))
+   {
+      //Save the source IPv4 address
+      srcIpAddr.length = sizeof(Ipv4Addr);
+      srcIpAddr.ipv4Addr = pseudoHeader->ipv4Data.srcAddr;
+   }
+   else
+#endif
+#if (IPV6_SUPPORT == ENABLED)
+   //An IPv6 packet was received?
+   if(pseudoHeader->length == sizeof(Ipv6PseudoHeader))
+   {
+      //Save the source IPv6 address
+      srcIpAddr.length = sizeof(Ipv6Addr);
+      ipv6CopyAddr(&srcIpAddr.ipv6Addr, &pseudoHeader->ipv6Data.srcAddr);
+   }
+   else
+#endif
+   //An invalid packet was received?
+   {
+      //This should never occur...
+      return NULL;
+   }
+
+   //Connected sockets are hashed on the 4-tuple
+   socket = socketGetConnBucket(destPort, srcPort, &srcIpAddr);
+
+   //Look for the connection the segment belongs to
+   while(socket != NULL)
+   {
+      //Matching socket?
+      if(tcpMatchSocket(socket, interface, pseudoHeader, destPort) &&
+         socket->remotePort == srcPort)
+      {
+         return socket;
+      }
+
+      //Next socket in the bucket
+      socket = socket->hashNext;
+   }
+
+   //No matching socket in the LISTEN state for the moment
+   passiveSocket = NULL;
+
+   //Listening and unconnected sockets are hashed on the local port
+   socket = socketGetPortBucket(destPort);
+
+   //Look for a socket bound to the destination port
+   while(socket != NULL)
+   {
+      //Matching socket?
+      if(tcpMatchSocket(socket, interface, pseudoHeader, destPort))
+      {
+         //Source port filtering
+         if(socket->remotePort == srcPort)
+            return socket;
+
+         //Keep track of the first matching socket in the LISTEN state
+         if(socket->state == TCP_STATE_LISTEN && !passiveSocket)
+            passiveSocket = socket;
+      }
+
+      //Next socket in the bucket
+      socket = socket->hashNext;
+   }
+
+   //If no matching connection has been found then try to
+   //use the first matching socket in the LISTEN state
+   return passiveSocket;
+}
+
+
 /**
  * @brief Delete TCB structure
  * @param[in] socket Handle referencing the socket
@@ -1035,12 +1411,20 @@ void tcpProcessSegmentData(Socket *socket, TcpHeader *segment,
 
 void tcpDeleteControlBlock(Socket *socket)
 {
+   //Remove the timers from the timer wheel
+   tcpStopTimers(socket);
+
    //Delete retransmission queue
    tcpFlushRetransmitQueue(socket);
 
    //Delete SYN queue
    tcpFlushSynQueue(socket);
 
+#if (TCP_ZERO_COPY_SUPPORT == ENABLED)
+   //Release caller-owned data
+   tcpFlushTxRefQueue(socket);
+#endif
+
    //Release transmit buffer
    netBufferSetLength((NetBuffer *) &socket->txBuffer, 0);
 
@@ -1124,6 +1508,11 @@ void tcpUpdateRetransmitQueue(Socket *socket)
    //turn off the retransmission timer
    if(socket->retransmitQueue == NULL)
       tcpTimerStop(&socket->retransmitTimer);
+
+#if (TCP_ZERO_COPY_SUPPORT == ENABLED)
+   //Caller-owned data that has been acknowledged can be released
+   tcpUpdateTxRefQueue(socket);
+#endif
 }
 
 
@@ -1182,6 +1571,194 @@ void tcpFlushSynQueue(Socket *socket)
 }
 
 
+#if (TCP_ZERO_COPY_SUPPORT == ENABLED)
+
+/**
+ * @brief Reference caller-owned data from the send stream
+ * @param[in] socket Handle referencing the socket
+ * @param[in] seqNum First sequence number occupied by the data
+ * @param[in] data Caller's memory
+ * @param[in] length Number of bytes
+ * @return Error code
+ **/
+
+error_t tcpAddTxRef(Socket *socket, uint32_t seqNum,
+   const uint8_t *data, size_t length)
+{
+   TcpTxRef *txRef;
+
+   //Point to the last item of the queue
+   txRef = socket->txRefQueue;
+   while(txRef != NULL && txRef->next != NULL)
+      txRef = txRef->next;
+
+   //The data directly follows the previous block in both the send stream
+   //and the caller's memory?
+   if(txRef != NULL && txRef->owner == NULL &&
+      (seqNum - txRef->seqNum) == txRef->length && data == (txRef->data + txRef->length))
+   {
+      //Extend the existing block
+      txRef->length += length;
+      //Successful processing
+      return NO_ERROR;
+   }
+
+   //Allocate a new item
+   txRef = memPoolAlloc(sizeof(TcpTxRef));
+   //Failed to allocate memory?
+   if(txRef == NULL)
+      return ERROR_OUT_OF_MEMORY;
+
+   //Describe the data
+   txRef->seqNum = seqNum;
+   txRef->data = data;
+   txRef->length = length;
+   txRef->owner = NULL;
+
+   //Add the item at the end of the queue
+   tcpLinkTxRef(socket, txRef);
+
+   //Successful processing
+   return NO_ERROR;
+}
+
+
+/**
+ * @brief Append an item to the queue of caller-owned data
+ * @param[in] socket Handle referencing the socket
+ * @param[in] txRef Item to append (sequence numbers must be increasing)
+ **/
+
+void tcpLinkTxRef(Socket *socket, TcpTxRef *txRef)
+{
+   TcpTxRef *lastTxRef;
+
+   //This item will be the last one of the queue
+   txRef->next = NULL;
+
+   //Empty queue?
+   if(socket->txRefQueue == NULL)
+   {
+      socket->txRefQueue = txRef;
+   }
+   else
+   {
+      //Point to the last item of the queue
+      lastTxRef = socket->txRefQueue;
+      while(lastTxRef->next != NULL)
+         lastTxRef = lastTxRef->next;
+
+      //Append the new item
+      lastTxRef->next = txRef;
+   }
+
+   //An empty item carrying an owner may already be acknowledged
+   tcpUpdateTxRefQueue(socket);
+}
+
+
+/**
+ * @brief Release caller-owned data that has been acknowledged
+ * @param[in] socket Handle referencing the socket
+ **/
+
+void tcpUpdateTxRefQueue(Socket *socket)
+{
+   TcpTxRef *txRef;
+
+   //The queue is sorted by sequence number
+   while(socket->txRefQueue != NULL)
+   {
+      //Point to the first item
+      txRef = socket->txRefQueue;
+
+      //Some bytes are not yet acknowledged?
+      if(TCP_CMP_SEQ(socket->sndUna, txRef->seqNum + txRef->length) < 0)
+         break;
+
+      //Remove the item from the queue
+      socket->txRefQueue = txRef->next;
+
+      //The caller's buffer is no longer referenced
+      if(txRef->owner != NULL)
+         netBufferFree(txRef->owner);
+
+      //The item can now be safely deleted
+      memPoolFree(txRef);
+   }
+}
+
+
+/**
+ * @brief Flush the queue of caller-owned data
+ * @param[in] socket Handle referencing the socket
+ **/
+
+void tcpFlushTxRefQueue(Socket *socket)
+{
+   //Point to the first item of the queue
+   TcpTxRef *txRef = socket->txRefQueue;
+
+   //Loop through the queue
+   while(txRef != NULL)
+   {
+      //Keep track of the next item in the queue
+      TcpTxRef *nextTxRef = txRef->next;
+
+      //Release the caller's buffer
+      if(txRef->owner != NULL)
+         netBufferFree(txRef->owner);
+
+      //Free previously allocated memory
+      memPoolFree(txRef);
+      //Point to the next item
+      txRef = nextTxRef;
+   }
+
+   //The queue is now empty
+   socket->txRefQueue = NULL;
+}
+
+#endif
+
+
+/**
+ * @brief Apply the TCP settings of the underlying interface to a socket
+ * @param[in] socket Handle referencing the socket
+ * @param[in] interface Interface the connection runs over
+ **/
+
+void tcpApplyProfile(Socket *socket, NetInterface *interface)
+{
+   TcpProfile profile;
+
+   //Settings of the interface, or the defaults when none were set
+   if(interface != NULL && interface->tcpProfile != NULL)
+      profile = *interface->tcpProfile;
+   else
+      tcpGetDefaultProfile(&profile);
+
+   //Enlarge the buffers when the interface calls for larger windows
+   socket->txBufferSize = MAX(socket->txBufferSize, profile.txBufferSize);
+   socket->txBufferSize = MIN(socket->txBufferSize, TCP_MAX_TX_BUFFER_SIZE);
+   socket->rxBufferSize = MAX(socket->rxBufferSize, profile.rxBufferSize);
+   socket->rxBufferSize = MIN(socket->rxBufferSize, TCP_MAX_RX_BUFFER_SIZE);
+
+   //Options offered in the SYN segment. They remain in use only if
+   //the peer agrees
+#if (TCP_SACK_SUPPORT == ENABLED)
+   socket->sackPermitted = profile.sackEnabled;
+#else
+   socket->sackPermitted = FALSE;
+#endif
+#if (TCP_TIMESTAMP_SUPPORT == ENABLED)
+   socket->tsPermitted = profile.timestampEnabled;
+#else
+   socket->tsPermitted = FALSE;
+#endif
+}
+
+
 /**
  * @brief Update the list of non-contiguous blocks that have been received
  * @param[in] socket Handle referencing the socket
@@ -1205,7 +1782,7 @@ void tcpUpdateSackBlocks(Socket *socket, uint32_t *leftEdge, uint32_t *rightEdge
          *rightEdge = MAX(*rightEdge, socket->sackBlock[i].rightEdge);
 
          //Delete current block
-         memcpy(socket->sackBlock + i, socket->sackBlock + i + 1,
+         memmove(socket->sackBlock + i, socket->sackBlock + i + 1,
             (TCP_MAX_SACK_BLOCKS - i - 1) * sizeof(TcpSackBlock));
 
          //Decrement the number of non-contiguous blocks
@@ -1222,7 +1799,7 @@ void tcpUpdateSackBlocks(Socket *socket, uint32_t *leftEdge, uint32_t *rightEdge
    if(TCP_CMP_SEQ(*leftEdge, socket->rcvNxt) > 0)
    {
       //Make room for the new non-contiguous block
-      memcpy(socket->sackBlock + 1, socket->sackBlock,
+      memmove(socket->sackBlock + 1, socket->sackBlock,
          (TCP_MAX_SACK_BLOCKS - 1) * sizeof(TcpSackBlock));
 
       //Insert the element in the list
@@ -1236,6 +1813,184 @@ void tcpUpdateSackBlocks(Socket *socket, uint32_t *leftEdge, uint32_t *rightEdge
 }
 
 
+#if (TCP_SACK_SUPPORT == ENABLED)
+
+/**
+ * @brief Mark the segments reported by the SACK option of an incoming ACK
+ * @param[in] socket Handle referencing the socket
+ * @param[in] segment Incoming ACK segment
+ **/
+
+void tcpUpdateScoreboard(Socket *socket, TcpHeader *segment)
+{
+   uint_t i;
+   uint_t n;
+   uint32_t seqNum;
+   uint32_t leftEdge;
+   uint32_t rightEdge;
+   TcpOption *option;
+   TcpQueueItem *queueItem;
+
+   //Search for the SACK option
+   option = tcpGetOption(segment, TCP_OPTION_SACK);
+   //No blocks reported?
+   if(option == NULL || option->length < (sizeof(TcpOption) + sizeof(TcpSackBlock)))
+      return;
+
+   //Number of blocks reported
+   n = (option->length - sizeof(TcpOption)) / sizeof(TcpSackBlock);
+
+   //Loop through the blocks
+   for(i = 0; i < n; i++)
+   {
+      //Retrieve the edges of the current block
+      leftEdge = LOAD32BE(option->value + i * sizeof(TcpSackBlock));
+      rightEdge = LOAD32BE(option->value + i * sizeof(TcpSackBlock) + 4);
+
+      //Ignore blocks that do not lie within the outstanding data
+      if(TCP_CMP_SEQ(leftEdge, socket->sndUna) < 0 ||
+         TCP_CMP_SEQ(rightEdge, socket->sndNxt) > 0)
+      {
+         continue;
+      }
+
+      //Mark the segments entirely covered by the block
+      for(queueItem = socket->retransmitQueue; queueItem != NULL; queueItem = queueItem->next)
+      {
+         //First sequence number of the segment
+         seqNum = ntohl(((TcpHeader *) queueItem->header)->seqNum);
+
+         //Check whether the block covers the whole segment
+         if(queueItem->length > 0 && TCP_CMP_SEQ(seqNum, leftEdge) >= 0 &&
+            TCP_CMP_SEQ(seqNum + queueItem->length, rightEdge) <= 0)
+         {
+            queueItem->sacked = TRUE;
+         }
+      }
+   }
+}
+
+
+/**
+ * @brief Check whether a segment is deemed lost
+ *
+ * A segment is deemed lost once enough segments sent after it have been
+ * selectively acknowledged (IsLost, refer to RFC 6675, section 4)
+ *
+ * @param[in] socket Handle referencing the socket
+ * @param[in] queueItem Segment held in the retransmission queue
+ * @return TRUE if the segment is deemed lost, else FALSE
+ **/
+
+bool_t tcpIsLostSegment(Socket *socket, TcpQueueItem *queueItem)
+{
+   uint_t n;
+
+   //A segment that has been selectively acknowledged is not lost
+   if(queueItem->sacked)
+      return FALSE;
+
+   //Count the segments sent later that have reached the receiver
+   for(n = 0, queueItem = queueItem->next; queueItem != NULL; queueItem = queueItem->next)
+   {
+      if(queueItem->sacked)
+         n++;
+   }
+
+   //Compare against the duplicate ACK threshold
+   return (n >= TCP_FAST_RETRANSMIT_THRES) ? TRUE : FALSE;
+}
+
+
+/**
+ * @brief Estimate the number of bytes still in the network
+ *
+ * Outstanding segments count unless they have been selectively acknowledged
+ * or are deemed lost, retransmitted segments count once more (SetPipe,
+ * refer to RFC 6675, section 4)
+ *
+ * @param[in] socket Handle referencing the socket
+ * @return Number of bytes in flight
+ **/
+
+uint_t tcpGetPipe(Socket *socket)
+{
+   uint_t n;
+   uint_t pipe;
+   TcpQueueItem *queueItem;
+
+   //Total number of segments that have been selectively acknowledged
+   for(n = 0, queueItem = socket->retransmitQueue; queueItem != NULL; queueItem = queueItem->next)
+   {
+      if(queueItem->sacked)
+         n++;
+   }
+
+   //Loop through the retransmission queue
+   for(pipe = 0, queueItem = socket->retransmitQueue; queueItem != NULL; queueItem = queueItem->next)
+   {
+      //Segment that has reached the receiver?
+      if(queueItem->sacked)
+      {
+         //Number of such segments sent after the next one
+         n--;
+      }
+      else
+      {
+         //The original transmission is in flight unless deemed lost
+         if(n < TCP_FAST_RETRANSMIT_THRES)
+            pipe += queueItem->length;
+         //So is the retransmission
+         if(queueItem->retransmitted)
+            pipe += queueItem->length;
+      }
+   }
+
+   //Return the number of bytes in flight
+   return pipe;
+}
+
+
+/**
+ * @brief SACK-based loss recovery
+ *
+ * Retransmit the segments deemed lost as long as the congestion window
+ * allows (refer to RFC 6675, section 5)
+ *
+ * @param[in] socket Handle referencing the socket
+ **/
+
+void tcpSackRecovery(Socket *socket)
+{
+   error_t error;
+   TcpQueueItem *queueItem;
+
+   //Loop through the retransmission queue
+   for(queueItem = socket->retransmitQueue; queueItem != NULL; queueItem = queueItem->next)
+   {
+      //Make sure the congestion window can accommodate another segment
+      if((tcpGetPipe(socket) + socket->mss) > socket->cwnd)
+         break;
+
+      //Skip segments that have already been retransmitted or that
+      //are not deemed lost
+      if(queueItem->retransmitted || !tcpIsLostSegment(socket, queueItem))
+         continue;
+
+      //Retransmit the lost segment
+      error = tcpRetransmitQueueItem(socket, queueItem);
+      //Any error to report?
+      if(error)
+         break;
+
+      //Keep track of the retransmission
+      queueItem->retransmitted = TRUE;
+   }
+}
+
+#endif
+
+
 /**
  * @brief Update send window
  * @param[in] socket Handle referencing the socket
@@ -1333,7 +2088,6 @@ bool_t tcpComputeRto(Socket *socket)
 {
    bool_t flag;
    systime_t r;
-   systime_t delta;
 
    //Clear flag
    flag = FALSE;
@@ -1347,36 +2101,10 @@ bool_t tcpComputeRto(Socket *socket)
          //Calculate round-time trip
          r = osGetSystemTime() - socket->rttStartTime;
 
-         //First RTT measurement?
-         if(!socket->srtt && !socket->rttvar)
-         {
-            //Initialize RTO calculation algorithm
-            socket->srtt = r;
-            socket->rttvar = r / 2;
-         }
-         else
-         {
-            //Calculate the difference between the measured value and the
-            //current RTT estimator
-            delta = (r > socket->srtt) ? (r - socket->srtt) : (socket->srtt - r);
-
-            //Implement Van Jacobson's algorithm (as specified in RFC 6298 2.3)
-            socket->rttvar = (3 * socket->rttvar + delta) / 4;
-            socket->srtt = (7 * socket->srtt + r) / 8;
-         }
-
-         //Calculate the next retransmission timeout
-         socket->rto = socket->srtt + 4 * socket->rttvar;
-
-         //Whenever RTO is computed, if it is less than 1 second, then
-         //the RTO should be rounded up to 1 second
-         socket->rto = MAX(socket->rto, TCP_MIN_RTO);
-         //A maximum value may be placed on RTO provided it is at least 60 seconds
-         socket->rto = MIN(socket->rto, TCP_MAX_RTO);
-
-         //Debug message
-         TRACE_DEBUG("R=%" PRIu32 ", SRTT=%" PRIu32 ", RTTVAR=%" PRIu32 ", RTO=%" PRIu32 "\r\n",
-            r, socket->srtt, socket->rttvar, socket->rto);
+         //When timestamps are in use, the RTT samples are taken from the
+         //echoed timestamps instead
+         if(!socket->tsPermitted)
+            tcpUpdateRttEstimator(socket, r, 1);
 
          //RTT measurement is complete
          socket->rttBusy = FALSE;
@@ -1390,6 +2118,94 @@ bool_t tcpComputeRto(Socket *socket)
 }
 
 
+/**
+ * @brief Update the RTT estimator with a new sample
+ * @param[in] socket Handle referencing the socket
+ * @param[in] r Round-trip time sample
+ * @param[in] k Number of samples expected per round-trip time. The gains
+ *   are divided by k so that the estimator does not converge faster when
+ *   every ACK yields a sample (refer to RFC 7323, appendix G)
+ **/
+
+void tcpUpdateRttEstimator(Socket *socket, systime_t r, uint_t k)
+{
+   systime_t delta;
+
+   //First RTT measurement?
+   if(!socket->srtt && !socket->rttvar)
+   {
+      //Initialize RTO calculation algorithm
+      socket->srtt = r;
+      socket->rttvar = r / 2;
+   }
+   else
+   {
+      //Calculate the difference between the measured value and the
+      //current RTT estimator
+      delta = (r > socket->srtt) ? (r - socket->srtt) : (socket->srtt - r);
+
+      //Implement Van Jacobson's algorithm (as specified in RFC 6298 2.3)
+      socket->rttvar = ((4 * k - 1) * socket->rttvar + delta) / (4 * k);
+      socket->srtt = ((8 * k - 1) * socket->srtt + r) / (8 * k);
+   }
+
+   //Calculate the next retransmission timeout
+   socket->rto = socket->srtt + 4 * socket->rttvar;
+
+   //Whenever RTO is computed, if it is less than 1 second, then
+   //the RTO should be rounded up to 1 second
+   socket->rto = MAX(socket->rto, TCP_MIN_RTO);
+   //A maximum value may be placed on RTO provided it is at least 60 seconds
+   socket->rto = MIN(socket->rto, TCP_MAX_RTO);
+
+   //Debug message
+   TRACE_DEBUG("R=%" PRIu32 ", SRTT=%" PRIu32 ", RTTVAR=%" PRIu32 ", RTO=%" PRIu32 "\r\n",
+      r, socket->srtt, socket->rttvar, socket->rto);
+}
+
+
+#if (TCP_TIMESTAMP_SUPPORT == ENABLED)
+
+/**
+ * @brief Take an RTT sample from the timestamp echoed by the peer
+ * @param[in] socket Handle referencing the socket
+ * @param[in] segment Incoming ACK segment
+ **/
+
+void tcpTimestampRtt(Socket *socket, TcpHeader *segment)
+{
+   uint_t k;
+   systime_t time;
+   uint32_t tsEcr;
+   TcpOption *option;
+
+   //Search for the Timestamps option
+   option = tcpGetOption(segment, TCP_OPTION_TIMESTAMP);
+
+   //Check option length
+   if(option != NULL && option->length == 10)
+   {
+      //Retrieve the echoed timestamp
+      tsEcr = LOAD32BE(option->value + 4);
+      //Current value of the timestamp clock
+      time = osGetSystemTime();
+
+      //A zero value or a timestamp from the future cannot be trusted
+      if(tsEcr != 0 && TCP_CMP_SEQ(time, tsEcr) >= 0)
+      {
+         //Number of samples expected during one round-trip time, assuming
+         //the peer acknowledges every other segment
+         k = (socket->sndNxt - socket->sndUna + 2 * socket->mss - 1) / (2 * socket->mss);
+
+         //Update the RTT estimator
+         tcpUpdateRttEstimator(socket, time - tsEcr, MAX(k, 1));
+      }
+   }
+}
+
+#endif
+
+
 /**
  * @brief TCP segment retransmission
  * @param[in] socket Handle referencing the socket
@@ -1399,11 +2215,8 @@ bool_t tcpComputeRto(Socket *socket)
 error_t tcpRetransmitSegment(Socket *socket)
 {
    error_t error;
-   size_t offset;
    size_t length;
-   NetBuffer *buffer;
    TcpQueueItem *queueItem;
-   TcpHeader *header;
 
    //Initialize error code
    error = NO_ERROR;
@@ -1428,60 +2241,101 @@ error_t tcpRetransmitSegment(Socket *socket)
          break;
       }
 
-      //Point to the TCP header
-      header = (TcpHeader *) queueItem->header;
-
-      //Allocate a memory buffer to hold the TCP segment
-      buffer = ipAllocBuffer(0, &offset);
-      //Failed to allocate memory?
-      if(buffer == NULL)
+      //Retransmit the current segment
+      error = tcpRetransmitQueueItem(socket, queueItem);
+      //Any error to report?
+      if(error)
       {
-         //Report an error
-         error = ERROR_OUT_OF_MEMORY;
          //Exit immediately
          break;
       }
 
-      //Start of exception handling block
-      do
-      {
-         //Copy TCP header
-         error = netBufferAppend(buffer, header, header->dataOffset * 4);
-         //Any error to report?
-         if(error) break;
+      //Point to the next segment in the queue
+      queueItem = queueItem->next;
+   }
 
-         //Copy data from send buffer
-         error = tcpReadTxBuffer(socket, ntohl(header->seqNum), buffer, queueItem->length);
-         //Any error to report?
-         if(error) break;
+   //Return status code
+   return error;
+}
 
-         //Total number of segments retransmitted
-         MIB2_INC_COUNTER32(mib2Base.tcpGroup.tcpRetransSegs, 1);
 
-         //Dump TCP header contents for debugging purpose
-         tcpDumpHeader(header, queueItem->length, socket->iss, socket->irs);
+/**
+ * @brief Retransmit a segment held in the retransmission queue
+ * @param[in] socket Handle referencing the socket
+ * @param[in] queueItem Segment to be retransmitted
+ * @return Error code
+ **/
 
-         //Retransmit the lost segment without waiting for the
-         //retransmission timer to expire
-         error = ipSendDatagram(socket->interface,
-            &queueItem->pseudoHeader, buffer, offset, 0);
+error_t tcpRetransmitQueueItem(Socket *socket, TcpQueueItem *queueItem)
+{
+   error_t error;
+   size_t offset;
+   NetBuffer *buffer;
+   TcpHeader *header;
 
-         //End of exception handling block
-      } while(0);
+   //Point to the TCP header
+   header = (TcpHeader *) queueItem->header;
 
-      //Free previously allocated memory
-      netBufferFree(buffer);
+   //Allocate a memory buffer to hold the TCP segment
+   buffer = ipAllocBuffer(0, &offset);
+   //Failed to allocate memory?
+   if(buffer == NULL)
+      return ERROR_OUT_OF_MEMORY;
 
+   //Start of exception handling block
+   do
+   {
+      //Copy TCP header
+      error = netBufferAppend(buffer, header, header->dataOffset * 4);
       //Any error to report?
-      if(error)
+      if(error) break;
+
+      //Copy data from send buffer
+      error = tcpReadTxBuffer(socket, ntohl(header->seqNum), buffer, queueItem->length);
+      //Any error to report?
+      if(error) break;
+
+#if (TCP_TIMESTAMP_SUPPORT == ENABLED)
+      //The retransmission carries a fresh timestamp
+      if(socket->tsPermitted)
       {
-         //Exit immediately
-         break;
+         TcpOption *option;
+
+         //Search for the Timestamps option
+         option = tcpGetOption(header, TCP_OPTION_TIMESTAMP);
+
+         //Check option length
+         if(option != NULL && option->length == 10)
+         {
+            //Update TSval and TSecr fields
+            STORE32BE(osGetSystemTime(), option->value);
+            STORE32BE(socket->tsRecent, option->value + 4);
+
+            //The checksum covers the header and the data
+            header->checksum = 0;
+            header->checksum = ipCalcUpperLayerChecksumEx(queueItem->pseudoHeader.data,
+               queueItem->pseudoHeader.length, buffer, offset,
+               header->dataOffset * 4 + queueItem->length);
+         }
       }
+#endif
 
-      //Point to the next segment in the queue
-      queueItem = queueItem->next;
-   }
+      //Total number of segments retransmitted
+      MIB2_INC_COUNTER32(mib2Base.tcpGroup.tcpRetransSegs, 1);
+
+      //Dump TCP header contents for debugging purpose
+      tcpDumpHeader(header, queueItem->length, socket->iss, socket->irs);
+
+      //Retransmit the lost segment without waiting for the
+      //retransmission timer to expire
+      error = ipSendDatagram(socket->interface,
+         &queueItem->pseudoHeader, buffer, offset, 0);
+
+      //End of exception handling block
+   } while(0);
+
+   //Free previously allocated memory
+   netBufferFree(buffer);
 
    //Return status code
    return error;
@@ -1519,6 +2373,26 @@ error_t tcpNagleAlgo(Socket *socket, uint_t flags)
    if((int_t) u < 0)
       return NO_ERROR;
 
+#if (TCP_CONGEST_CONTROL_SUPPORT == ENABLED && TCP_SACK_SUPPORT == ENABLED)
+   //During SACK-based recovery, the congestion window is compared against the
+   //estimated amount of data in flight (refer to RFC 6675, section 5)
+   if(socket->sackPermitted && socket->congestState == TCP_CONGEST_STATE_RECOVERY)
+   {
+      uint_t pipe;
+
+      //Usable window as far as the receiver is concerned
+      u = MIN(socket->sndWnd, socket->txBufferSize) - (socket->sndNxt - socket->sndUna);
+      //Handle window shrinking
+      if((int_t) u < 0)
+         return NO_ERROR;
+
+      //Number of bytes still in the network
+      pipe = tcpGetPipe(socket);
+      //Apply the congestion window
+      u = (socket->cwnd > pipe) ? MIN(u, socket->cwnd - pipe) : 0;
+   }
+#endif
+
    //The Nagle algorithm discourages sending tiny segments when
    //the data to be sent increases in small increments
    while(socket->sndUser > 0)
@@ -1821,24 +2695,46 @@ uint_t tcpWaitForEvents(Socket *socket, uint_t eventMask, systime_t timeout)
 void tcpWriteTxBuffer(Socket *socket, uint32_t seqNum,
    const uint8_t *data, size_t length)
 {
+   uint16_t checksum;
+
    //Offset of the first byte to write in the circular buffer
    size_t offset = (seqNum - socket->iss - 1) % socket->txBufferSize;
 
    //Check whether the specified data crosses buffer boundaries
    if((offset + length) <= socket->txBufferSize)
    {
-      //Copy the payload
-      netBufferWrite((NetBuffer *) &socket->txBuffer,
+      //Copy the payload and compute its checksum on the fly
+      checksum = ipCopyChecksumToBuffer((NetBuffer *) &socket->txBuffer,
          offset, data, length);
    }
    else
    {
       //Copy the first part of the payload
-      netBufferWrite((NetBuffer *) &socket->txBuffer,
+      checksum = ipCopyChecksumToBuffer((NetBuffer *) &socket->txBuffer,
          offset, data, socket->txBufferSize - offset);
       //Wrap around to the beginning of the circular buffer
-      netBufferWrite((NetBuffer *) &socket->txBuffer,
-         0, data + socket->txBufferSize - offset, length - socket->txBufferSize + offset);
+      checksum = ipCombineChecksum(checksum,
+         ipCopyChecksumToBuffer((NetBuffer *) &socket->txBuffer, 0,
+         data + socket->txBufferSize - offset, length - socket->txBufferSize + offset),
+         socket->txBufferSize - offset);
+   }
+
+   //The new data directly follows the unsent data already covered by
+   //the running sum?
+   if(socket->txChecksumLength > 0 && socket->txChecksumLength <= socket->sndUser &&
+      (seqNum - socket->txChecksumSeqNum) == socket->txChecksumLength)
+   {
+      //Extend the running sum
+      socket->txChecksum = ipCombineChecksum(socket->txChecksum,
+         checksum, socket->txChecksumLength);
+      socket->txChecksumLength += length;
+   }
+   else
+   {
+      //Start a new running sum
+      socket->txChecksumSeqNum = seqNum;
+      socket->txChecksumLength = length;
+      socket->txChecksum = checksum;
    }
 }
 
@@ -1856,30 +2752,77 @@ error_t tcpReadTxBuffer(Socket *socket, uint32_t seqNum,
    NetBuffer *buffer, size_t length)
 {
    error_t error;
+   size_t n;
+   size_t offset;
+#if (TCP_ZERO_COPY_SUPPORT == ENABLED)
+   TcpTxRef *txRef;
 
-   //Offset of the first byte to read in the circular buffer
-   size_t offset = (seqNum - socket->iss - 1) % socket->txBufferSize;
+   //Point to the first block of caller-owned data
+   txRef = socket->txRefQueue;
+#endif
 
-   //Check whether the specified data crosses buffer boundaries
-   if((offset + length) <= socket->txBufferSize)
-   {
-      //Copy the payload
-      error = netBufferConcat(buffer, (NetBuffer *) &socket->txBuffer,
-         offset, length);
-   }
-   else
+   //Initialize status code
+   error = NO_ERROR;
+
+   //The range may alternate between the send buffer and caller-owned data
+   while(length > 0 && !error)
    {
-      //Copy the first part of the payload
-      error = netBufferConcat(buffer, (NetBuffer *) &socket->txBuffer,
-         offset, socket->txBufferSize - offset);
+      //Number of bytes to read from the current source
+      n = length;
+
+#if (TCP_ZERO_COPY_SUPPORT == ENABLED)
+      //Skip the blocks that end before the current sequence number
+      while(txRef != NULL && TCP_CMP_SEQ(txRef->seqNum + txRef->length, seqNum) <= 0)
+         txRef = txRef->next;
+
+      //The current byte lies in a block of caller-owned data?
+      if(txRef != NULL && TCP_CMP_SEQ(txRef->seqNum, seqNum) <= 0)
+      {
+         //Read up to the end of the block
+         n = MIN(n, txRef->seqNum + txRef->length - seqNum);
 
-      //Check status code
-      if(!error)
+         //Reference the caller's memory
+         error = netBufferAppend(buffer, txRef->data + (seqNum - txRef->seqNum), n);
+
+         //Next bytes to read
+         seqNum += n;
+         length -= n;
+         continue;
+      }
+
+      //Read up to the beginning of the next block
+      if(txRef != NULL)
+         n = MIN(n, txRef->seqNum - seqNum);
+#endif
+
+      //Offset of the first byte to read in the circular buffer
+      offset = (seqNum - socket->iss - 1) % socket->txBufferSize;
+
+      //Check whether the specified data crosses buffer boundaries
+      if((offset + n) <= socket->txBufferSize)
       {
-         //Wrap around to the beginning of the circular buffer
+         //Copy the payload
          error = netBufferConcat(buffer, (NetBuffer *) &socket->txBuffer,
-            0, length - socket->txBufferSize + offset);
+            offset, n);
       }
+      else
+      {
+         //Copy the first part of the payload
+         error = netBufferConcat(buffer, (NetBuffer *) &socket->txBuffer,
+            offset, socket->txBufferSize - offset);
+
+         //Check status code
+         if(!error)
+         {
+            //Wrap around to the beginning of the circular buffer
+            error = netBufferConcat(buffer, (NetBuffer *) &socket->txBuffer,
+               0, n - socket->txBufferSize + offset);
+         }
+      }
+
+      //Next bytes to read
+      seqNum += n;
+      length -= n;
    }
 
    //Return status code
@@ -55,6 +55,9 @@ void tcpFastLossRecovery(Socket *socket, TcpHeader *segment);
 void tcpProcessSegmentData(Socket *socket, TcpHeader *segment,
    const NetBuffer *buffer, size_t offset, size_t length);
 
+Socket *tcpFindSocket(NetInterface *interface,
+   const IpPseudoHeader *pseudoHeader, const TcpHeader *segment);
+
 void tcpDeleteControlBlock(Socket *socket);
 
 void tcpUpdateRetransmitQueue(Socket *socket);
@@ -62,12 +65,30 @@ void tcpFlushRetransmitQueue(Socket *socket);
 
 void tcpFlushSynQueue(Socket *socket);
 
+#if (TCP_ZERO_COPY_SUPPORT == ENABLED)
+error_t tcpAddTxRef(Socket *socket, uint32_t seqNum,
+   const uint8_t *data, size_t length);
+
+void tcpLinkTxRef(Socket *socket, TcpTxRef *txRef);
+void tcpUpdateTxRefQueue(Socket *socket);
+void tcpFlushTxRefQueue(Socket *socket);
+#endif
+
+void tcpApplyProfile(Socket *socket, NetInterface *interface);
+
 void tcpUpdateSackBlocks(Socket *socket, uint32_t *leftEdge, uint32_t *rightEdge);
+void tcpUpdateScoreboard(Socket *socket, TcpHeader *segment);
+bool_t tcpIsLostSegment(Socket *socket, TcpQueueItem *queueItem);
+uint_t tcpGetPipe(Socket *socket);
+void tcpSackRecovery(Socket *socket);
 void tcpUpdateSendWindow(Socket *socket, TcpHeader *segment);
 void tcpUpdateReceiveWindow(Socket *socket);
 
 bool_t tcpComputeRto(Socket *socket);
+void tcpUpdateRttEstimator(Socket *socket, systime_t r, uint_t k);
+void tcpTimestampRtt(Socket *socket, TcpHeader *segment);
 error_t tcpRetransmitSegment(Socket *socket);
+error_t tcpRetransmitQueueItem(Socket *socket, TcpQueueItem *queueItem);
 error_t tcpNagleAlgo(Socket *socket, uint_t flags);
 
 void tcpChangeState(Socket *socket, TcpState newState);
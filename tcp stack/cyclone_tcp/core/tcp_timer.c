@@ -47,30 +47,32 @@
 /**
  * @brief TCP timer handler
  *
- * This routine must be periodically called by the TCP/IP stack to
- * handle retransmissions and TCP related timers (persist timer,
- * FIN-WAIT-2 timer and TIME-WAIT timer)
+ * Called from the timer wheel when one of the timers of the socket expires.
+ * Handles retransmissions and the other TCP related timers (persist timer,
+ * override timer, FIN-WAIT-2 timer and TIME-WAIT timer)
  *
+ * @param[in] param Handle referencing the socket
  **/
 
-void tcpTick(void)
+void tcpTimerHandler(void *param)
 {
    error_t error;
-   uint_t i;
    uint_t n;
    uint_t u;
+   Socket *socket;
 
-   //Loop through opened sockets
-   for(i = 0; i < SOCKET_MAX_COUNT; i++)
+   //Point to the socket whose timer expired
+   socket = (Socket *) param;
+
+   //Single pass, so that the state checks below can exit early
+   do
    {
-      //Shortcut to the current socket
-      Socket *socket = socketTable + i;
       //Check socket type
       if(socket->type != SOCKET_TYPE_STREAM)
-         continue;
+         break;
       //Check the current state of the TCP state machine
       if(socket->state == TCP_STATE_CLOSED)
-         continue;
+         break;
 
       //Is there any packet in the retransmission queue?
       if(socket->retransmitQueue != NULL)
@@ -136,7 +138,7 @@ void tcpTick(void)
 
       //Check the current state of the TCP state machine
       if(socket->state == TCP_STATE_CLOSED)
-         continue;
+         break;
 
       //The persist timer is used when the remote host advertises
       //a window size of zero
@@ -245,7 +247,7 @@ void tcpTick(void)
          if(tcpTimerElapsed(&socket->timeWaitTimer))
          {
             //Debug message
-            TRACE_WARNING("TCP 2MSL timer elapsed (socket %u)...\r\n", i);
+            TRACE_WARNING("TCP 2MSL timer elapsed (socket %u)...\r\n", socket->descriptor);
             //Enter CLOSED state
             tcpChangeState(socket, TCP_STATE_CLOSED);
 
@@ -256,10 +258,44 @@ void tcpTick(void)
                tcpDeleteControlBlock(socket);
                //Mark the socket as closed
                socket->type = SOCKET_TYPE_UNUSED;
+               //Stop delivering segments to the socket
+               socketHashRemove(socket);
             }
          }
       }
-   }
+   } while(0);
+}
+
+
+/**
+ * @brief Attach the TCP timers of a socket to the timer wheel
+ * @param[in] socket Handle referencing the socket
+ **/
+
+void tcpInitTimers(Socket *socket)
+{
+   //All the timers of the socket share the same handler
+   netTimerInit(&socket->retransmitTimer.entry, tcpTimerHandler, socket);
+   netTimerInit(&socket->persistTimer.entry, tcpTimerHandler, socket);
+   netTimerInit(&socket->overrideTimer.entry, tcpTimerHandler, socket);
+   netTimerInit(&socket->finWait2Timer.entry, tcpTimerHandler, socket);
+   netTimerInit(&socket->timeWaitTimer.entry, tcpTimerHandler, socket);
+}
+
+
+/**
+ * @brief Stop all the TCP timers of a socket
+ * @param[in] socket Handle referencing the socket
+ **/
+
+void tcpStopTimers(Socket *socket)
+{
+   //Remove the timers from the timer wheel
+   tcpTimerStop(&socket->retransmitTimer);
+   tcpTimerStop(&socket->persistTimer);
+   tcpTimerStop(&socket->overrideTimer);
+   tcpTimerStop(&socket->finWait2Timer);
+   tcpTimerStop(&socket->timeWaitTimer);
 }
 
 
@@ -277,6 +313,9 @@ void tcpTimerStart(TcpTimer *timer, systime_t delay)
 
    //The timer is now running...
    timer->running = TRUE;
+
+   //The socket is only visited when the timer expires
+   netTimerStartAt(&timer->entry, timer->startTime + delay);
 }
 
 
@@ -289,6 +328,9 @@ void tcpTimerStop(TcpTimer *timer)
 {
    //Stop timer
    timer->running = FALSE;
+
+   //Remove the timer from the timer wheel
+   netTimerStop(&timer->entry);
 }
 
 
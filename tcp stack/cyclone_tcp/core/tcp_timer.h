@@ -30,7 +30,10 @@
 #define _TCP_TIMER_H
 
 //TCP timer related functions
-void tcpTick(void);
+void tcpTimerHandler(void *param);
+
+void tcpInitTimers(Socket *socket);
+void tcpStopTimers(Socket *socket);
 
 void tcpTimerStart(TcpTimer *timer, systime_t delay);
 void tcpTimerStop(TcpTimer *timer);
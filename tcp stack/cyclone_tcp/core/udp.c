@@ -178,12 +178,10 @@ error_t udpProcessDatagram(NetInterface *interface,
       }
    }
 
-   //Loop through opened sockets
-   for(i = 0; i < SOCKET_MAX_COUNT; i++)
+   //Only the sockets hashed on the destination port need to be checked
+   for(socket = socketGetPortBucket(ntohs(header->destPort));
+      socket != NULL; socket = socket->hashNext)
    {
-      //Point to the current socket
-      socket = socketTable + i;
-
       //UDP socket found?
       if(socket->type != SOCKET_TYPE_DGRAM)
          continue;
@@ -266,7 +264,7 @@ error_t udpProcessDatagram(NetInterface *interface,
    length -= sizeof(UdpHeader);
 
    //No matching socket found?
-   if(i >= SOCKET_MAX_COUNT)
+   if(socket == NULL)
    {
       //Invoke user callback, if any
       error = udpInvokeRxCallback(interface, pseudoHeader, header, buffer, offset);
@@ -43,10 +43,22 @@
 #if (DNS_CLIENT_SUPPORT == ENABLED || MDNS_CLIENT_SUPPORT == ENABLED || \
    NBNS_CLIENT_SUPPORT == ENABLED)
 
-//Tick counter to handle periodic operations
-systime_t dnsTickCounter;
 //DNS cache
 DnsCacheEntry dnsCache[DNS_CACHE_SIZE];
+//Next DNS cache entry to time out
+static NetTimer dnsTimer;
+
+
+/**
+ * @brief Timer wheel callback
+ * @param[in] param Unused parameter
+ **/
+
+static void dnsTimerHandler(void *param)
+{
+   //Process the entries that have timed out
+   dnsTick();
+}
 
 
 /**
@@ -58,6 +70,8 @@ error_t dnsInit(void)
 {
    //Initialize DNS cache
    memset(dnsCache, 0, sizeof(dnsCache));
+   //The cache is only visited when an entry times out
+   netTimerInit(&dnsTimer, dnsTimerHandler, NULL);
 
    //Successful initialization
    return NO_ERROR;
@@ -91,6 +105,57 @@ void dnsFlushCache(NetInterface *interface)
 }
 
 
+/**
+ * @brief Update the DNS cache after a link state change
+ *
+ * Resolved DNS names stay in the cache so that they can be served right after
+ * a reconnection. Pending DNS queries are abandoned and the other resolvers
+ * start from scratch
+ *
+ * @param[in] interface Underlying network interface
+ **/
+
+void dnsLinkChangeEvent(NetInterface *interface)
+{
+#if (DNS_CACHE_PERSISTENT == ENABLED)
+   uint_t i;
+   DnsCacheEntry *entry;
+
+   //Go through DNS cache
+   for(i = 0; i < DNS_CACHE_SIZE; i++)
+   {
+      //Point to the current entry
+      entry = &dnsCache[i];
+
+      //Skip unused entries and entries of other interfaces
+      if(entry->state == DNS_STATE_NONE || entry->interface != interface)
+         continue;
+
+#if (DNS_CLIENT_SUPPORT == ENABLED)
+      //DNS resolver?
+      if(entry->protocol == HOST_NAME_RESOLVER_DNS)
+      {
+         //The query was sent over the previous link
+         if(entry->state == DNS_STATE_IN_PROGRESS)
+            dnsCompleteQuery(entry, ERROR_FAILURE);
+      }
+      else
+#endif
+      {
+         //mDNS and NBNS names are only valid on the local link
+         dnsDeleteEntry(entry);
+      }
+   }
+
+   //Schedule the next timeout
+   dnsUpdateTimer();
+#else
+   //Flush DNS cache
+   dnsFlushCache(interface);
+#endif
+}
+
+
 /**
  * @brief Create a new entry in the DNS cache
  * @return Pointer to the newly created entry
@@ -101,9 +166,11 @@ DnsCacheEntry *dnsCreateEntry(void)
    uint_t i;
    DnsCacheEntry *entry;
    DnsCacheEntry *oldestEntry;
+   DnsCacheEntry *oldestStaleEntry;
 
    //Keep track of the oldest entry
    oldestEntry = &dnsCache[0];
+   oldestStaleEntry = NULL;
 
    //Loop through DNS cache entries
    for(i = 0; i < DNS_CACHE_SIZE; i++)
@@ -123,8 +190,19 @@ DnsCacheEntry *dnsCreateEntry(void)
       //Keep track of the oldest entry in the table
       if(timeCompare(entry->timestamp, oldestEntry->timestamp) < 0)
          oldestEntry = entry;
+
+      //Expired addresses are given up first
+      if(entry->state == DNS_STATE_STALE && (oldestStaleEntry == NULL ||
+         timeCompare(entry->timestamp, oldestStaleEntry->timestamp) < 0))
+      {
+         oldestStaleEntry = entry;
+      }
    }
 
+   //Evict a stale entry if any
+   if(oldestStaleEntry != NULL)
+      oldestEntry = oldestStaleEntry;
+
    //The oldest entry is removed whenever the table runs out of space
    dnsDeleteEntry(oldestEntry);
    //Erase contents
@@ -153,6 +231,8 @@ void dnsDeleteEntry(DnsCacheEntry *entry)
          {
             //Unregister user callback
             udpDetachRxCallback(entry->interface, entry->port);
+            //The pending requests cannot complete anymore
+            dnsCompleteRequests(entry, ERROR_FAILURE);
          }
       }
 #endif
@@ -162,6 +242,29 @@ void dnsDeleteEntry(DnsCacheEntry *entry)
 }
 
 
+/**
+ * @brief Handle the failure of a name resolution
+ * @param[in] entry Pointer to the DNS cache entry
+ **/
+
+static void dnsFailEntry(DnsCacheEntry *entry)
+{
+#if (DNS_CLIENT_SUPPORT == ENABLED)
+   //DNS resolver?
+   if(entry->protocol == HOST_NAME_RESOLVER_DNS)
+   {
+      //The entry falls back to its stale address, if any
+      dnsCompleteQuery(entry, ERROR_FAILURE);
+   }
+   else
+#endif
+   {
+      //The entry should be deleted since name resolution has failed
+      dnsDeleteEntry(entry);
+   }
+}
+
+
 /**
  * @brief Search the DNS cache for a given domain name
  * @param[in] interface Underlying network interface
@@ -209,8 +312,8 @@ DnsCacheEntry *dnsFindEntry(NetInterface *interface,
 /**
  * @brief DNS timer handler
  *
- * This routine must be periodically called by the TCP/IP stack to
- * manage DNS cache
+ * This routine is called by the TCP/IP stack when the earliest DNS cache
+ * entry times out
  *
  **/
 
@@ -283,8 +386,8 @@ void dnsTick(void)
                }
                else
                {
-                  //The entry should be deleted since name resolution has failed
-                  dnsDeleteEntry(entry);
+                  //Name resolution has failed
+                  dnsFailEntry(entry);
                }
             }
 #if (DNS_CLIENT_SUPPORT == ENABLED)
@@ -310,15 +413,15 @@ void dnsTick(void)
                }
                else
                {
-                  //The entry should be deleted since name resolution has failed
-                  dnsDeleteEntry(entry);
+                  //Name resolution has failed
+                  dnsFailEntry(entry);
                }
             }
 #endif
             else
             {
                //The maximum number of retransmissions has been exceeded
-               dnsDeleteEntry(entry);
+               dnsFailEntry(entry);
             }
          }
       }
@@ -328,11 +431,83 @@ void dnsTick(void)
          //Check the lifetime of the current DNS cache entry
          if(timeCompare(time, entry->timestamp + entry->timeout) >= 0)
          {
-            //Periodically time out DNS cache entries
+#if (DNS_CLIENT_SUPPORT == ENABLED && DNS_STALE_LIFETIME > 0)
+            //Expired DNS addresses may still be served until refreshed
+            if(entry->protocol == HOST_NAME_RESOLVER_DNS)
+            {
+               entry->state = DNS_STATE_STALE;
+            }
+            else
+#endif
+            {
+               //Periodically time out DNS cache entries
+               dnsDeleteEntry(entry);
+            }
+         }
+      }
+      //Expired address?
+      else if(entry->state == DNS_STATE_STALE)
+      {
+         //The address is no longer served past the stale period
+         if(timeCompare(time, entry->staleDeadline) >= 0)
             dnsDeleteEntry(entry);
+      }
+   }
+
+   //Schedule the next timeout
+   dnsUpdateTimer();
+}
+
+
+/**
+ * @brief Arm the DNS timer for the earliest entry timeout
+ **/
+
+void dnsUpdateTimer(void)
+{
+   uint_t i;
+   bool_t found;
+   systime_t deadline;
+   DnsCacheEntry *entry;
+
+   //No pending timeout yet
+   found = FALSE;
+   deadline = 0;
+
+   //Go through DNS cache
+   for(i = 0; i < DNS_CACHE_SIZE; i++)
+   {
+      //Point to the current entry
+      entry = &dnsCache[i];
+
+      //Pending query or resolved name?
+      if(entry->state == DNS_STATE_IN_PROGRESS ||
+         entry->state == DNS_STATE_RESOLVED)
+      {
+         //Keep track of the earliest timeout
+         if(!found || timeCompare(entry->timestamp + entry->timeout, deadline) < 0)
+         {
+            deadline = entry->timestamp + entry->timeout;
+            found = TRUE;
+         }
+      }
+      //Expired address?
+      else if(entry->state == DNS_STATE_STALE)
+      {
+         //Keep track of the end of the stale period
+         if(!found || timeCompare(entry->staleDeadline, deadline) < 0)
+         {
+            deadline = entry->staleDeadline;
+            found = TRUE;
          }
       }
    }
+
+   //Any entry to time out?
+   if(found)
+      netTimerStartAt(&dnsTimer, deadline);
+   else
+      netTimerStop(&dnsTimer);
 }
 
 #endif
@@ -33,13 +33,6 @@
 #include "core/net.h"
 #include "core/socket.h"
 
-//DNS tick interval
-#ifndef DNS_TICK_INTERVAL
-   #define DNS_TICK_INTERVAL 200
-#elif (DNS_TICK_INTERVAL < 10)
-   #error DNS_TICK_INTERVAL parameter is not valid
-#endif
-
 //Size of DNS cache
 #ifndef DNS_CACHE_SIZE
    #define DNS_CACHE_SIZE 8
@@ -68,6 +61,13 @@
    #error DNS_CACHE_MAX_POLLING_INTERVAL parameter is not valid
 #endif
 
+//Keep resolved DNS entries across link changes
+#ifndef DNS_CACHE_PERSISTENT
+   #define DNS_CACHE_PERSISTENT ENABLED
+#elif (DNS_CACHE_PERSISTENT != ENABLED && DNS_CACHE_PERSISTENT != DISABLED)
+   #error DNS_CACHE_PERSISTENT parameter is not valid
+#endif
+
 
 /**
  * @brief DNS cache entry states
@@ -78,7 +78,8 @@ typedef enum
    DNS_STATE_NONE        = 0,
    DNS_STATE_IN_PROGRESS = 1,
    DNS_STATE_RESOLVED    = 2,
-   DNS_STATE_PERMANENT   = 3
+   DNS_STATE_PERMANENT   = 3,
+   DNS_STATE_STALE       = 4
 } DnsState;
 
 
@@ -101,17 +102,20 @@ typedef struct
    systime_t timeout;                 ///<Retransmission timeout
    systime_t maxTimeout;              ///<Maximum retransmission timeout
    uint_t retransmitCount;            ///<Retransmission counter
+   bool_t refresh;                    ///<The query refreshes a stale address
+   systime_t staleDeadline;           ///<End of the stale period of the address
+   systime_t queryStart;              ///<Time at which the first query was sent
 } DnsCacheEntry;
 
 
 //Global variables
-extern systime_t dnsTickCounter;
 extern DnsCacheEntry dnsCache[DNS_CACHE_SIZE];
 
 //DNS related functions
 error_t dnsInit(void);
 
 void dnsFlushCache(NetInterface *interface);
+void dnsLinkChangeEvent(NetInterface *interface);
 
 DnsCacheEntry *dnsCreateEntry(void);
 void dnsDeleteEntry(DnsCacheEntry *entry);
@@ -120,5 +124,6 @@ DnsCacheEntry *dnsFindEntry(NetInterface *interface,
    const char_t *name, HostType type, HostnameResolver protocol);
 
 void dnsTick(void);
+void dnsUpdateTimer(void);
 
 #endif
@@ -40,167 +40,475 @@
 //Check TCP/IP stack configuration
 #if (DNS_CLIENT_SUPPORT == ENABLED)
 
+//Pending asynchronous requests
+static DnsRequest dnsRequestTable[DNS_CLIENT_MAX_REQUESTS];
+//Statistics
+static DnsClientStats dnsClientStats;
+
+
+/**
+ * @brief Completion context of a blocking resolution
+ **/
+
+typedef struct
+{
+   OsEvent event;
+   bool_t done;
+   error_t error;
+   IpAddr ipAddr;
+} DnsCompletion;
+
+
+/**
+ * @brief Completion callback of a blocking resolution
+ * @param[in] error Status of the resolution
+ * @param[in] ipAddr Resolved address (NULL on failure)
+ * @param[in] param Pointer to the completion context
+ **/
+
+static void dnsCompletionCallback(error_t error, const IpAddr *ipAddr, void *param)
+{
+   DnsCompletion *completion = (DnsCompletion *) param;
+
+   //Save the result
+   completion->error = error;
+   if(ipAddr != NULL)
+      completion->ipAddr = *ipAddr;
+   completion->done = TRUE;
+
+   //Wake up the waiting task
+   osSetEvent(&completion->event);
+}
+
+
+/**
+ * @brief Send the first query of a name resolution
+ * @param[in] entry Pointer to the DNS cache entry, new or stale
+ * @return Error code
+ **/
+
+static error_t dnsStartQuery(DnsCacheEntry *entry)
+{
+   error_t error;
+
+   //Select primary DNS server
+   entry->dnsServerNum = 0;
+   //Get an ephemeral port number
+   entry->port = udpGetDynamicPort();
+
+   //An identifier is used by the DNS client to match replies
+   //with corresponding requests
+   entry->id = netGetRand();
+
+   //Callback function to be called when a DNS response is received
+   error = udpAttachRxCallback(entry->interface, entry->port, dnsProcessResponse, NULL);
+   //Any error to report?
+   if(error)
+      return error;
+
+   //Initialize retransmission counter
+   entry->retransmitCount = DNS_CLIENT_MAX_RETRIES;
+   //Send DNS query
+   error = dnsSendQuery(entry);
+
+   //DNS message successfully sent?
+   if(!error)
+   {
+      //Save the time at which the query message was sent
+      entry->timestamp = osGetSystemTime();
+      entry->queryStart = entry->timestamp;
+      //Set timeout value
+      entry->timeout = DNS_CLIENT_INIT_TIMEOUT;
+      entry->maxTimeout = DNS_CLIENT_MAX_TIMEOUT;
+      //Decrement retransmission counter
+      entry->retransmitCount--;
+
+      //A stale address remains usable while it is being refreshed
+      entry->refresh = (entry->state == DNS_STATE_STALE);
+
+      //Update statistics
+      dnsClientStats.queries++;
+      if(entry->refresh)
+         dnsClientStats.refreshes++;
+
+      //Switch state
+      entry->state = DNS_STATE_IN_PROGRESS;
+      //Schedule the retransmission of the query
+      dnsUpdateTimer();
+   }
+   else
+   {
+      //Unregister callback function
+      udpDetachRxCallback(entry->interface, entry->port);
+   }
+
+   //Return status code
+   return error;
+}
+
 
 /**
  * @brief Resolve a host name using DNS
+ *
+ * The calling task is blocked until the name is resolved, the resolution
+ * fails or DNS_CLIENT_MAX_RESOLVE_TIME elapses
+ *
  * @param[in] interface Underlying network interface
  * @param[in] name Name of the host to be resolved
  * @param[in] type Host type (IPv4 or IPv6)
+ * @param[in] flags Host name resolution flags (HOST_NAME_ALLOW_STALE)
  * @param[out] ipAddr IP address corresponding to the specified host name
+ * @return Error code
  **/
 
-error_t dnsResolve(NetInterface *interface,
-   const char_t *name, HostType type, IpAddr *ipAddr)
+error_t dnsResolve(NetInterface *interface, const char_t *name,
+   HostType type, uint_t flags, IpAddr *ipAddr)
 {
    error_t error;
-   DnsCacheEntry *entry;
 
 #if (NET_RTOS_SUPPORT == ENABLED)
-   systime_t delay;
+   DnsCompletion completion;
 
    //Debug message
    TRACE_INFO("Resolving host name %s (DNS resolver)...\r\n", name);
-#endif
 
-   //Get exclusive access
-   osAcquireMutex(&netMutex);
+   //Create an event object to wait for completion
+   if(!osCreateEvent(&completion.event))
+      return ERROR_OUT_OF_RESOURCES;
 
-   //Search the DNS cache for the specified host name
-   entry = dnsFindEntry(interface, name, type, HOST_NAME_RESOLVER_DNS);
+   //No result yet
+   completion.done = FALSE;
+   completion.error = ERROR_FAILURE;
+
+   //Start host name resolution
+   error = dnsResolveAsync(interface, name, type, flags, ipAddr,
+      dnsCompletionCallback, &completion);
 
-   //Check whether a matching entry has been found
-   if(entry)
+   //The answer of a DNS server is needed?
+   if(error == ERROR_IN_PROGRESS)
    {
-      //Host name already resolved?
-      if(entry->state == DNS_STATE_RESOLVED ||
-         entry->state == DNS_STATE_PERMANENT)
+      //Wait for the resolution to complete
+      osWaitForEvent(&completion.event, DNS_CLIENT_MAX_RESOLVE_TIME);
+      //The callback cannot run anymore once the request is cancelled
+      dnsCancelResolve(dnsCompletionCallback, &completion);
+
+      //Check whether the resolution has completed
+      if(completion.done)
       {
-         //Return the corresponding IP address
-         *ipAddr = entry->ipAddr;
-         //Successful host name resolution
-         error = NO_ERROR;
+         error = completion.error;
+         if(!error)
+            *ipAddr = completion.ipAddr;
       }
       else
       {
-         //Host name resolution is in progress...
-         error = ERROR_IN_PROGRESS;
+         //Report a timeout error
+         error = ERROR_TIMEOUT;
       }
    }
+
+   //Delete event object
+   osDeleteEvent(&completion.event);
+
+   //Check status code
+   if(error)
+   {
+      //Failed to resolve host name
+      TRACE_INFO("Host name resolution failed!\r\n");
+   }
    else
    {
-      //If no entry exists, then create a new one
-      entry = dnsCreateEntry();
+      //Successful host name resolution
+      TRACE_INFO("Host name resolved to %s...\r\n", ipAddrToString(ipAddr, NULL));
+   }
+#else
+   //Without RTOS, the caller polls until the name is resolved
+   error = dnsResolveAsync(interface, name, type, flags, ipAddr, NULL, NULL);
+#endif
+
+   //Return status code
+   return error;
+}
+
+
+/**
+ * @brief Resolve a host name using DNS without blocking
+ *
+ * A name found in the cache is returned at once. With HOST_NAME_ALLOW_STALE,
+ * an expired address is returned as well and refreshed in the background.
+ * Otherwise ERROR_IN_PROGRESS is returned and the callback is invoked from
+ * the TCP/IP stack when the resolution completes. The callback runs with the
+ * stack locked, it must not block nor call the stack
+ *
+ * @param[in] interface Underlying network interface
+ * @param[in] name Name of the host to be resolved
+ * @param[in] type Host type (IPv4 or IPv6)
+ * @param[in] flags Host name resolution flags (HOST_NAME_ALLOW_STALE)
+ * @param[out] ipAddr IP address corresponding to the specified host name
+ * @param[in] callback Completion callback (optional parameter)
+ * @param[in] param Opaque pointer passed to the callback
+ * @return Error code
+ **/
 
-      //Record the host name whose IP address is unknown
-      strcpy(entry->name, name);
+error_t dnsResolveAsync(NetInterface *interface, const char_t *name,
+   HostType type, uint_t flags, IpAddr *ipAddr,
+   HostnameCallback callback, void *param)
+{
+   error_t error;
+   uint_t i;
+   DnsCacheEntry *entry;
+   DnsRequest *request;
 
-      //Initialize DNS cache entry
-      entry->type = type;
-      entry->protocol = HOST_NAME_RESOLVER_DNS;
-      entry->interface = interface;
-      //Select primary DNS server
-      entry->dnsServerNum = 0;
-      //Get an ephemeral port number
-      entry->port = udpGetDynamicPort();
+   //Check parameters
+   if(name == NULL || ipAddr == NULL)
+      return ERROR_INVALID_PARAMETER;
+   if(strlen(name) > DNS_MAX_NAME_LEN)
+      return ERROR_INVALID_PARAMETER;
 
-      //An identifier is used by the DNS client to match replies
-      //with corresponding requests
-      entry->id = netGetRand();
+   //Get exclusive access
+   osAcquireMutex(&netMutex);
 
-      //Callback function to be called when a DNS response is received
-      error = udpAttachRxCallback(interface, entry->port, dnsProcessResponse, NULL);
+   //Search the DNS cache for the specified host name
+   entry = dnsFindEntry(interface, name, type, HOST_NAME_RESOLVER_DNS);
 
-      //Check status code
-      if(!error)
-      {
-         //Initialize retransmission counter
-         entry->retransmitCount = DNS_CLIENT_MAX_RETRIES;
-         //Send DNS query
-         error = dnsSendQuery(entry);
+   //Host name already resolved?
+   if(entry != NULL && (entry->state == DNS_STATE_RESOLVED ||
+      entry->state == DNS_STATE_PERMANENT))
+   {
+      //Return the corresponding IP address
+      *ipAddr = entry->ipAddr;
+      //Update statistics
+      dnsClientStats.cacheHits++;
+      //Successful host name resolution
+      error = NO_ERROR;
+   }
+   //Expired address the caller accepts?
+   else if(entry != NULL && (flags & HOST_NAME_ALLOW_STALE) &&
+      (entry->state == DNS_STATE_STALE || entry->refresh))
+   {
+      //Return the last known IP address
+      *ipAddr = entry->ipAddr;
+      //Update statistics
+      dnsClientStats.staleHits++;
 
-         //DNS message successfully sent?
-         if(!error)
+      //Refresh the entry in the background
+      if(entry->state == DNS_STATE_STALE)
+         dnsStartQuery(entry);
+
+      //Successful host name resolution
+      error = NO_ERROR;
+   }
+   else
+   {
+      //Update statistics
+      dnsClientStats.cacheMisses++;
+
+      //Look for a free request slot
+      for(request = NULL, i = 0; i < DNS_CLIENT_MAX_REQUESTS; i++)
+      {
+         if(dnsRequestTable[i].entry == NULL)
          {
-            //Save the time at which the query message was sent
-            entry->timestamp = osGetSystemTime();
-            //Set timeout value
-            entry->timeout = DNS_CLIENT_INIT_TIMEOUT;
-            entry->maxTimeout = DNS_CLIENT_MAX_TIMEOUT;
-            //Decrement retransmission counter
-            entry->retransmitCount--;
-
-            //Switch state
-            entry->state = DNS_STATE_IN_PROGRESS;
-            //Host name resolution is in progress
-            error = ERROR_IN_PROGRESS;
+            request = &dnsRequestTable[i];
+            break;
          }
-         else
+      }
+
+      //Too many pending requests?
+      if(callback != NULL && request == NULL)
+      {
+         error = ERROR_OUT_OF_RESOURCES;
+      }
+      //Name resolution already in progress?
+      else if(entry != NULL && entry->state == DNS_STATE_IN_PROGRESS)
+      {
+         error = NO_ERROR;
+      }
+      //Expired address the caller refuses?
+      else if(entry != NULL)
+      {
+         //Refresh the entry
+         error = dnsStartQuery(entry);
+      }
+      else
+      {
+         //If no entry exists, then create a new one
+         entry = dnsCreateEntry();
+
+         //Record the host name whose IP address is unknown
+         strcpy(entry->name, name);
+
+         //Initialize DNS cache entry
+         entry->type = type;
+         entry->protocol = HOST_NAME_RESOLVER_DNS;
+         entry->interface = interface;
+
+         //Send the first query
+         error = dnsStartQuery(entry);
+      }
+
+      //Query in progress?
+      if(!error)
+      {
+         //Register the completion callback
+         if(callback != NULL)
          {
-            //Unregister callback function
-            udpDetachRxCallback(interface, entry->port);
+            request->entry = entry;
+            request->callback = callback;
+            request->param = param;
          }
+
+         //Host name resolution is in progress
+         error = ERROR_IN_PROGRESS;
       }
    }
 
    //Release exclusive access
    osReleaseMutex(&netMutex);
 
-#if (NET_RTOS_SUPPORT == ENABLED)
-   //Set default polling interval
-   delay = DNS_CACHE_INIT_POLLING_INTERVAL;
+   //Return status code
+   return error;
+}
 
-   //Wait the host name resolution to complete
-   while(error == ERROR_IN_PROGRESS)
-   {
-      //Wait until the next polling period
-      osDelayTask(delay);
 
-      //Get exclusive access
-      osAcquireMutex(&netMutex);
+/**
+ * @brief Cancel pending asynchronous requests
+ * @param[in] callback Completion callback of the requests
+ * @param[in] param Callback parameter of the requests
+ **/
 
-      //Search the DNS cache for the specified host name
-      entry = dnsFindEntry(interface, name, type, HOST_NAME_RESOLVER_DNS);
+void dnsCancelResolve(HostnameCallback callback, void *param)
+{
+   uint_t i;
 
-      //Check whether a matching entry has been found
-      if(entry)
-      {
-         //Host name successfully resolved?
-         if(entry->state == DNS_STATE_RESOLVED)
-         {
-            //Return the corresponding IP address
-            *ipAddr = entry->ipAddr;
-            //Successful host name resolution
-            error = NO_ERROR;
-         }
-      }
-      else
+   //Get exclusive access
+   osAcquireMutex(&netMutex);
+
+   //The queries themselves go on and update the cache
+   for(i = 0; i < DNS_CLIENT_MAX_REQUESTS; i++)
+   {
+      if(dnsRequestTable[i].entry != NULL &&
+         dnsRequestTable[i].callback == callback &&
+         dnsRequestTable[i].param == param)
       {
-         //Host name resolution failed
-         error = ERROR_FAILURE;
+         dnsRequestTable[i].entry = NULL;
       }
+   }
 
-      //Release exclusive access
-      osReleaseMutex(&netMutex);
+   //Release exclusive access
+   osReleaseMutex(&netMutex);
+}
 
-      //Backoff support for less aggressive polling
-      delay = MIN(delay * 2, DNS_CACHE_MAX_POLLING_INTERVAL);
-   }
 
-   //Check status code
-   if(error)
+/**
+ * @brief Get DNS client statistics
+ * @param[out] stats Cache hits and misses, query counts and latencies (ms)
+ * @return Error code
+ **/
+
+error_t dnsGetStats(DnsClientStats *stats)
+{
+   //Check parameters
+   if(stats == NULL)
+      return ERROR_INVALID_PARAMETER;
+
+   //Get exclusive access
+   osAcquireMutex(&netMutex);
+   //Take a consistent snapshot
+   *stats = dnsClientStats;
+   //Release exclusive access
+   osReleaseMutex(&netMutex);
+
+   //Successful processing
+   return NO_ERROR;
+}
+
+
+/**
+ * @brief Complete the query of a DNS cache entry
+ *
+ * On success the entry holds the new address and its lifetime. On failure a
+ * refreshed entry falls back to its stale address until the end of the stale
+ * period, any other entry is deleted
+ *
+ * @param[in] entry Pointer to the DNS cache entry
+ * @param[in] error Status of the query
+ **/
+
+void dnsCompleteQuery(DnsCacheEntry *entry, error_t error)
+{
+   systime_t time;
+   systime_t latency;
+
+   //Get current time
+   time = osGetSystemTime();
+
+   //Unregister UDP callback function
+   udpDetachRxCallback(entry->interface, entry->port);
+
+   //Successful name resolution?
+   if(!error)
    {
-      //Failed to resolve host name
-      TRACE_INFO("Host name resolution failed!\r\n");
+      //Update statistics
+      latency = time - entry->queryStart;
+      dnsClientStats.resolved++;
+      dnsClientStats.lastLatency = latency;
+      dnsClientStats.maxLatency = MAX(dnsClientStats.maxLatency, latency);
+      dnsClientStats.totalLatency += latency;
+
+      //Host name successfully resolved
+      entry->state = DNS_STATE_RESOLVED;
+      entry->refresh = FALSE;
+      //The address may be served past its TTL for a limited period
+      entry->staleDeadline = entry->timestamp + entry->timeout + DNS_STALE_LIFETIME;
    }
    else
    {
-      //Successful host name resolution
-      TRACE_INFO("Host name resolved to %s...\r\n", ipAddrToString(ipAddr, NULL));
+      //Update statistics
+      dnsClientStats.failures++;
+
+      //Keep the last known address?
+      if(entry->refresh && timeCompare(time, entry->staleDeadline) < 0)
+         entry->state = DNS_STATE_STALE;
+      else
+         entry->state = DNS_STATE_NONE;
+
+      //The refresh is over
+      entry->refresh = FALSE;
    }
-#endif
 
-   //Return status code
-   return error;
+   //Notify the pending requests
+   dnsCompleteRequests(entry, error);
+   //Schedule the next timeout
+   dnsUpdateTimer();
+}
+
+
+/**
+ * @brief Invoke the callbacks of the requests waiting for an entry
+ * @param[in] entry Pointer to the DNS cache entry
+ * @param[in] error Status of the name resolution
+ **/
+
+void dnsCompleteRequests(DnsCacheEntry *entry, error_t error)
+{
+   uint_t i;
+   HostnameCallback callback;
+   void *param;
+
+   //Loop through the pending requests
+   for(i = 0; i < DNS_CLIENT_MAX_REQUESTS; i++)
+   {
+      //Request waiting for this entry?
+      if(dnsRequestTable[i].entry == entry)
+      {
+         //The slot is released before the callback is invoked
+         callback = dnsRequestTable[i].callback;
+         param = dnsRequestTable[i].param;
+         dnsRequestTable[i].entry = NULL;
+
+         //Notify the user
+         callback(error, error ? NULL : &entry->ipAddr, param);
+      }
+   }
 }
 
 
@@ -442,8 +750,8 @@ void dnsProcessResponse(NetInterface *interface, const IpPseudoHeader *pseudoHea
             //Check return code
             if(message->rcode != DNS_RCODE_NO_ERROR)
             {
-               //The entry should be deleted since name resolution has failed
-               dnsDeleteEntry(entry);
+               //Name resolution has failed
+               dnsCompleteQuery(entry, ERROR_FAILURE);
                //Exit immediately
                break;
             }
@@ -484,8 +792,8 @@ void dnsProcessResponse(NetInterface *interface, const IpPseudoHeader *pseudoHea
 
                      //Save current time
                      entry->timestamp = osGetSystemTime();
-                     //Save TTL value
-                     entry->timeout = ntohl(record->ttl) * 1000;
+                     //Save TTL value (large values would overflow in milliseconds)
+                     entry->timeout = MIN(ntohl(record->ttl), DNS_MAX_LIFETIME / 1000) * 1000;
 
                      //Limit the lifetime of the DNS cache entries
                      if(entry->timeout >= DNS_MAX_LIFETIME)
@@ -493,10 +801,8 @@ void dnsProcessResponse(NetInterface *interface, const IpPseudoHeader *pseudoHea
                      if(entry->timeout <= DNS_MIN_LIFETIME)
                         entry->timeout = DNS_MIN_LIFETIME;
 
-                     //Unregister UDP callback function
-                     udpDetachRxCallback(interface, entry->port);
                      //Host name successfully resolved
-                     entry->state = DNS_STATE_RESOLVED;
+                     dnsCompleteQuery(entry, NO_ERROR);
                      //Exit immediately
                      break;
                   }
@@ -516,8 +822,8 @@ void dnsProcessResponse(NetInterface *interface, const IpPseudoHeader *pseudoHea
 
                      //Save current time
                      entry->timestamp = osGetSystemTime();
-                     //Save TTL value
-                     entry->timeout = ntohl(record->ttl) * 1000;
+                     //Save TTL value (large values would overflow in milliseconds)
+                     entry->timeout = MIN(ntohl(record->ttl), DNS_MAX_LIFETIME / 1000) * 1000;
 
                      //Limit the lifetime of the DNS cache entries
                      if(entry->timeout >= DNS_MAX_LIFETIME)
@@ -525,10 +831,8 @@ void dnsProcessResponse(NetInterface *interface, const IpPseudoHeader *pseudoHea
                      if(entry->timeout <= DNS_MIN_LIFETIME)
                         entry->timeout = DNS_MIN_LIFETIME;
 
-                     //Unregister UDP callback function
-                     udpDetachRxCallback(interface, entry->port);
                      //Host name successfully resolved
-                     entry->state = DNS_STATE_RESOLVED;
+                     dnsCompleteQuery(entry, NO_ERROR);
                      //Exit immediately
                      break;
                   }
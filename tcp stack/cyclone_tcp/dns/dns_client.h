@@ -77,11 +77,74 @@
    #error DNS_MAX_LIFETIME parameter is not valid
 #endif
 
+//Period during which an expired address may still be served
+#ifndef DNS_STALE_LIFETIME
+   #define DNS_STALE_LIFETIME 86400000
+#elif (DNS_STALE_LIFETIME < 0)
+   #error DNS_STALE_LIFETIME parameter is not valid
+#endif
+
+//Maximum number of pending asynchronous requests
+#ifndef DNS_CLIENT_MAX_REQUESTS
+   #define DNS_CLIENT_MAX_REQUESTS 4
+#elif (DNS_CLIENT_MAX_REQUESTS < 1)
+   #error DNS_CLIENT_MAX_REQUESTS parameter is not valid
+#endif
+
+//Maximum time a blocking resolution waits for completion
+#ifndef DNS_CLIENT_MAX_RESOLVE_TIME
+   #define DNS_CLIENT_MAX_RESOLVE_TIME 30000
+#elif (DNS_CLIENT_MAX_RESOLVE_TIME < 1000)
+   #error DNS_CLIENT_MAX_RESOLVE_TIME parameter is not valid
+#endif
+
+
+/**
+ * @brief Pending asynchronous request
+ **/
+
+typedef struct
+{
+   DnsCacheEntry *entry;      ///<Entry being resolved (NULL if unused)
+   HostnameCallback callback; ///<Completion callback
+   void *param;               ///<Callback parameter
+} DnsRequest;
+
+
+/**
+ * @brief DNS client statistics
+ **/
+
+typedef struct
+{
+   uint32_t cacheHits;     ///<Names served from a valid cache entry
+   uint32_t staleHits;     ///<Names served from an expired cache entry
+   uint32_t cacheMisses;   ///<Names that had to wait for a query
+   uint32_t queries;       ///<Queries started
+   uint32_t refreshes;     ///<Queries started for an expired entry
+   uint32_t resolved;      ///<Queries answered
+   uint32_t failures;      ///<Queries that failed
+   systime_t lastLatency;  ///<Resolution time of the last answered query
+   systime_t maxLatency;   ///<Longest resolution time
+   systime_t totalLatency; ///<Sum of the resolution times
+} DnsClientStats;
+
+
 //DNS related functions
-error_t dnsResolve(NetInterface *interface,
-   const char_t *name, HostType type, IpAddr *ipAddr);
+error_t dnsResolve(NetInterface *interface, const char_t *name,
+   HostType type, uint_t flags, IpAddr *ipAddr);
+
+error_t dnsResolveAsync(NetInterface *interface, const char_t *name,
+   HostType type, uint_t flags, IpAddr *ipAddr,
+   HostnameCallback callback, void *param);
+
+void dnsCancelResolve(HostnameCallback callback, void *param);
+
+error_t dnsGetStats(DnsClientStats *stats);
 
 error_t dnsSendQuery(DnsCacheEntry *entry);
+void dnsCompleteQuery(DnsCacheEntry *entry, error_t error);
+void dnsCompleteRequests(DnsCacheEntry *entry, error_t error);
 
 void dnsProcessResponse(NetInterface *interface, const IpPseudoHeader *pseudoHeader,
    const UdpHeader *udpHeader, const NetBuffer *buffer, size_t offset, void *params);
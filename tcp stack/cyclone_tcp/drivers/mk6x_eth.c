@@ -51,6 +51,7 @@
 //Dependencies
 #include "core/net.h"
 #include "drivers/mk6x_eth.h"
+#include "crc.h"
 #include "debug.h"
 
 //Underlying network interface
@@ -944,29 +945,7 @@ uint16_t mk6xEthReadPhyReg(uint8_t phyAddr, uint8_t regAddr)
 
 uint32_t mk6xEthCalcCrc(const void *data, size_t length)
 {
-   uint_t i;
-   uint_t j;
-
-   //Point to the data over which to calculate the CRC
-   const uint8_t *p = (uint8_t *) data;
-   //CRC preset value
-   uint32_t crc = 0xFFFFFFFF;
-
-   //Loop through data
-   for(i = 0; i < length; i++)
-   {
-      //Update CRC value
-      crc ^= p[i];
-      //The message is processed bit by bit
-      for(j = 0; j < 8; j++)
-      {
-         if(crc & 0x00000001)
-            crc = (crc >> 1) ^ 0xEDB88320;
-         else
-            crc = crc >> 1;
-      }
-   }
-
-   //Return CRC value
-   return crc;
+   //The hash filter is indexed by the CRC register before the final
+   //inversion, hence the complement of the Ethernet FCS
+   return ~crc32Calc(data, length);
 }
@@ -1045,6 +1045,81 @@ error_t ftpWriteFile(FtpClientContext *context,
 }
 
 
+#if (TCP_SUPPORT == ENABLED && TCP_ZERO_COPY_SUPPORT == ENABLED)
+
+/**
+ * @brief Write the contents of a multi-part buffer to a remote file
+ *
+ * The data connection segments directly from the buffer, which it frees
+ * once the data has been acknowledged. The function takes ownership of the
+ * buffer in all cases
+ *
+ * @param[in] context Pointer to the FTP client context
+ * @param[in] buffer Multi-part buffer containing the data to be written
+ * @param[in] offset Offset to the first data byte
+ * @param[in] flags Set of flags that influences the behavior of this function
+ * @return Error code
+ **/
+
+error_t ftpWriteFileBuffer(FtpClientContext *context,
+   NetBuffer *buffer, size_t offset, uint_t flags)
+{
+   error_t error;
+#if (FTP_CLIENT_TLS_SUPPORT == ENABLED)
+   uint_t i;
+   size_t n;
+#endif
+
+   //Invalid context?
+   if(context == NULL)
+   {
+      netBufferFree(buffer);
+      return ERROR_INVALID_PARAMETER;
+   }
+
+#if (FTP_CLIENT_TLS_SUPPORT == ENABLED)
+   if(context->dataTlsContext != NULL)
+   {
+      //The records are encrypted, so the data is copied chunk by chunk
+      error = NO_ERROR;
+
+      //Loop through data chunks
+      for(i = 0; i < buffer->chunkCount && !error; i++)
+      {
+         //Skip the data that precede the specified offset
+         if(offset >= buffer->chunk[i].length)
+         {
+            offset -= buffer->chunk[i].length;
+            continue;
+         }
+
+         //Number of bytes to write from the current chunk
+         n = buffer->chunk[i].length - offset;
+         //Transmit data to the FTP server
+         error = tlsWrite(context->dataTlsContext,
+            (uint8_t *) buffer->chunk[i].address + offset, n, flags);
+
+         //Process the next chunk
+         offset = 0;
+      }
+
+      //The buffer is no longer needed
+      netBufferFree(buffer);
+   }
+   else
+#endif
+   {
+      //Transmit data to the FTP server
+      error = socketSendBuffer(context->dataSocket, buffer, offset, flags);
+   }
+
+   //Return status code
+   return error;
+}
+
+#endif
+
+
 /**
  * @brief Read from a remote file
  * @param[in] context Pointer to the FTP client context
@@ -204,6 +204,11 @@ error_t ftpOpenFile(FtpClientContext *context, const char_t *path, uint_t flags)
 error_t ftpWriteFile(FtpClientContext *context,
    const void *data, size_t length, uint_t flags);
 
+#if (TCP_SUPPORT == ENABLED && TCP_ZERO_COPY_SUPPORT == ENABLED)
+error_t ftpWriteFileBuffer(FtpClientContext *context,
+   NetBuffer *buffer, size_t offset, uint_t flags);
+#endif
+
 error_t ftpReadFile(FtpClientContext *context,
    void *data, size_t size, size_t *length, uint_t flags);
 
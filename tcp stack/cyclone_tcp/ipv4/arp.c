@@ -44,8 +44,16 @@
 //Check TCP/IP stack configuration
 #if (IPV4_SUPPORT == ENABLED && ETH_SUPPORT == ENABLED)
 
-//Tick counter to handle periodic operations
-systime_t arpTickCounter;
+/**
+ * @brief Timer wheel callback
+ * @param[in] param Underlying network interface
+ **/
+
+static void arpTimerHandler(void *param)
+{
+   //Process the entries that have timed out
+   arpTick((NetInterface *) param);
+}
 
 
 /**
@@ -58,6 +66,8 @@ error_t arpInit(NetInterface *interface)
 {
    //Initialize the ARP cache
    memset(interface->arpCache, 0, sizeof(interface->arpCache));
+   //The cache is only visited when an entry times out
+   netTimerInit(&interface->arpTimer, arpTimerHandler, interface);
 
    //Successful initialization
    return NO_ERROR;
@@ -85,6 +95,9 @@ void arpFlushCache(NetInterface *interface)
       //Release ARP entry
       entry->state = ARP_STATE_NONE;
    }
+
+   //No entry to time out
+   netTimerStop(&interface->arpTimer);
 }
 
 
@@ -261,6 +274,8 @@ error_t arpResolve(NetInterface *interface, Ipv4Addr ipAddr, MacAddr *macAddr)
          entry->timeout = ARP_DELAY_FIRST_PROBE_TIME;
          //Switch to the DELAY state
          entry->state = ARP_STATE_DELAY;
+         //Schedule the first probe
+         arpUpdateTimer(interface);
 
          //Successful address resolution
          error = NO_ERROR;
@@ -290,16 +305,19 @@ error_t arpResolve(NetInterface *interface, Ipv4Addr ipAddr, MacAddr *macAddr)
          //No packet are pending in the transmit queue
          entry->queueSize = 0;
 
-         //Send an ARP request
-         arpSendRequest(interface, entry->ipAddr, &MAC_BROADCAST_ADDR);
-
          //Save the time at which the packet was sent
          entry->timestamp = osGetSystemTime();
          //Set timeout value
          entry->timeout = ARP_REQUEST_TIMEOUT;
-         //Enter INCOMPLETE state
+         //Enter INCOMPLETE state before sending, so that a reply received
+         //at once finds the entry
          entry->state = ARP_STATE_INCOMPLETE;
 
+         //Send an ARP request
+         arpSendRequest(interface, entry->ipAddr, &MAC_BROADCAST_ADDR);
+         //Schedule the retransmission of the request
+         arpUpdateTimer(interface);
+
          //The address resolution is in progress
          error = ERROR_IN_PROGRESS;
       }
@@ -402,8 +420,8 @@ error_t arpEnqueuePacket(NetInterface *interface,
 /**
  * @brief ARP timer handler
  *
- * This routine must be periodically called by the TCP/IP stack to
- * manage ARP cache
+ * This routine is called by the TCP/IP stack when the earliest ARP cache
+ * entry times out
  *
  * @param[in] interface Underlying network interface
  **/
@@ -509,6 +527,54 @@ void arpTick(NetInterface *interface)
          }
       }
    }
+
+   //Schedule the next timeout
+   arpUpdateTimer(interface);
+}
+
+
+/**
+ * @brief Arm the ARP timer for the earliest entry timeout
+ * @param[in] interface Underlying network interface
+ **/
+
+void arpUpdateTimer(NetInterface *interface)
+{
+   uint_t i;
+   bool_t found;
+   systime_t deadline;
+   ArpCacheEntry *entry;
+
+   //No pending timeout yet
+   found = FALSE;
+   deadline = 0;
+
+   //Go through ARP cache
+   for(i = 0; i < ARP_CACHE_SIZE; i++)
+   {
+      //Point to the current entry
+      entry = &interface->arpCache[i];
+
+      //STALE entries wait for traffic and NONE entries are unused
+      if(entry->state == ARP_STATE_INCOMPLETE ||
+         entry->state == ARP_STATE_REACHABLE ||
+         entry->state == ARP_STATE_DELAY ||
+         entry->state == ARP_STATE_PROBE)
+      {
+         //Keep track of the earliest timeout
+         if(!found || timeCompare(entry->timestamp + entry->timeout, deadline) < 0)
+         {
+            deadline = entry->timestamp + entry->timeout;
+            found = TRUE;
+         }
+      }
+   }
+
+   //Any entry to time out?
+   if(found)
+      netTimerStartAt(&interface->arpTimer, deadline);
+   else
+      netTimerStop(&interface->arpTimer);
 }
 
 
@@ -698,6 +764,8 @@ void arpProcessReply(NetInterface *interface, ArpPacket *arpReply)
          entry->timeout = ARP_REACHABLE_TIME;
          //Switch to the REACHABLE state
          entry->state = ARP_STATE_REACHABLE;
+         //Schedule the expiration of the entry
+         arpUpdateTimer(interface);
       }
       else if(entry->state == ARP_STATE_REACHABLE)
       {
@@ -720,6 +788,8 @@ void arpProcessReply(NetInterface *interface, ArpPacket *arpReply)
          entry->timeout = ARP_REACHABLE_TIME;
          //Switch to the REACHABLE state
          entry->state = ARP_STATE_REACHABLE;
+         //Schedule the expiration of the entry
+         arpUpdateTimer(interface);
       }
    }
 }
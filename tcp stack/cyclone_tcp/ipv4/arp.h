@@ -32,13 +32,6 @@
 //Dependencies
 #include "core/net.h"
 
-//ARP tick interval
-#ifndef ARP_TICK_INTERVAL
-   #define ARP_TICK_INTERVAL 200
-#elif (ARP_TICK_INTERVAL < 10)
-   #error ARP_TICK_INTERVAL parameter is not valid
-#endif
-
 //Size of ARP cache
 #ifndef ARP_CACHE_SIZE
    #define ARP_CACHE_SIZE 8
@@ -186,9 +179,6 @@ typedef struct
 } ArpCacheEntry;
 
 
-//Tick counter to handle periodic operations
-extern systime_t arpTickCounter;
-
 //ARP related functions
 error_t arpInit(NetInterface *interface);
 void arpFlushCache(NetInterface *interface);
@@ -205,6 +195,7 @@ error_t arpEnqueuePacket(NetInterface *interface,
    Ipv4Addr ipAddr, NetBuffer *buffer, size_t offset);
 
 void arpTick(NetInterface *interface);
+void arpUpdateTimer(NetInterface *interface);
 
 void arpProcessPacket(NetInterface *interface, ArpPacket *arpPacket, size_t length);
 void arpProcessRequest(NetInterface *interface, ArpPacket *arpRequest);
@@ -52,6 +52,13 @@
 
 //Tick counter to handle periodic operations
 systime_t ipv4FragTickCounter;
+//Memory held by the reassembly queues
+size_t ipv4FragMemUsage;
+
+//Forward declaration of functions
+static size_t ipv4FragBlockSize(size_t size);
+static error_t ipv4MergeChunks(Ipv4FragDesc *frag, uint_t index, uint_t count);
+static error_t ipv4CompactChunks(Ipv4FragDesc *frag);
 
 
 /**
@@ -158,6 +165,12 @@ error_t ipv4FragmentDatagram(NetInterface *interface, Ipv4PseudoHeader *pseudoHe
 
 /**
  * @brief IPv4 datagram reassembly algorithm
+ *
+ * The payload of each fragment is kept in a memory block of its own, linked
+ * into the reassembly buffer in offset order. Data already received is not
+ * copied again, so overlapping fragments only fill the holes. The datagram
+ * is passed to the higher protocol layer as a chain of chunks
+ *
  * @param[in] interface Underlying network interface
  * @param[in] packet Pointer to the IPv4 fragmented packet
  * @param[in] length Packet length including header and payload
@@ -167,18 +180,20 @@ void ipv4ReassembleDatagram(NetInterface *interface,
    const Ipv4Header *packet, size_t length)
 {
    error_t error;
+   uint_t i;
    uint16_t offset;
    uint16_t dataFirst;
    uint16_t dataLast;
+   size_t headerLength;
    Ipv4FragDesc *frag;
-   Ipv4HoleDesc *hole;
-   Ipv4HoleDesc *prevHole;
 
    //Number of IP fragments received which needed to be reassembled
    MIB2_INC_COUNTER32(mib2Base.ipGroup.ipReasmReqds, 1);
 
+   //Get the length of the IP header
+   headerLength = packet->headerLength * 4;
    //Get the length of the payload
-   length -= packet->headerLength * 4;
+   length -= headerLength;
    //Convert the fragment offset from network byte order
    offset = ntohs(packet->fragmentOffset);
 
@@ -191,6 +206,15 @@ void ipv4ReassembleDatagram(NetInterface *interface,
       return;
    }
 
+   //Empty fragments carry nothing to reassemble
+   if(length == 0)
+   {
+      //Number of failures detected by the IP reassembly algorithm
+      MIB2_INC_COUNTER32(mib2Base.ipGroup.ipReasmFails, 1);
+      //Drop the incoming fragment
+      return;
+   }
+
    //Calculate the index of the first byte
    dataFirst = (offset & IPV4_OFFSET_MASK) * 8;
    //Calculate the index immediately following the last byte
@@ -208,168 +232,73 @@ void ipv4ReassembleDatagram(NetInterface *interface,
       return;
    }
 
-   //The very first fragment requires special handling
-   if(!(offset & IPV4_OFFSET_MASK))
-   {
-      //Calculate the length of the IP header including options
-      frag->headerLength = packet->headerLength * 4;
+   //Point to the last data chunk received so far
+   i = frag->buffer.chunkCount - 1;
 
-      //Enforce the size of the reconstructed datagram
-      if((frag->headerLength + frag->dataLength) > IPV4_MAX_FRAG_DATAGRAM_SIZE)
-      {
-         //Number of failures detected by the IP reassembly algorithm
-         MIB2_INC_COUNTER32(mib2Base.ipGroup.ipReasmFails, 1);
-         //Drop the reconstructed datagram
-         netBufferSetLength((NetBuffer *) &frag->buffer, 0);
-         //Exit immediately
-         return;
-      }
-
-      //Make sure the IP header entirely fits in the first chunk
-      if(frag->headerLength > frag->buffer.chunk[0].size)
-      {
-         //Number of failures detected by the IP reassembly algorithm
-         MIB2_INC_COUNTER32(mib2Base.ipGroup.ipReasmFails, 1);
-         //Drop the reconstructed datagram
-         netBufferSetLength((NetBuffer *) &frag->buffer, 0);
-         //Exit immediately
-         return;
-      }
-
-      //Fix the length of the first chunk
-      frag->buffer.chunk[0].length = frag->headerLength;
-      //Always take the IP header from the first fragment
-      netBufferWrite((NetBuffer *) &frag->buffer, 0, packet, frag->headerLength);
+   //Enforce the size of the reconstructed datagram
+   if((headerLength + dataLast) > IPV4_MAX_FRAG_DATAGRAM_SIZE)
+   {
+      error = ERROR_INVALID_LENGTH;
    }
-
-   //It may be necessary to increase the size of the buffer...
-   if(dataLast > frag->dataLength)
+   //Last fragment?
+   else if(!(offset & IPV4_FLAG_MF))
    {
-      //Enforce the size of the reconstructed datagram
-      if((frag->headerLength + dataLast) > IPV4_MAX_FRAG_DATAGRAM_SIZE)
-      {
-         //Number of failures detected by the IP reassembly algorithm
-         MIB2_INC_COUNTER32(mib2Base.ipGroup.ipReasmFails, 1);
-         //Drop the reconstructed datagram
-         netBufferSetLength((NetBuffer *) &frag->buffer, 0);
-         //Exit immediately
-         return;
-      }
-
-      //Adjust the size of the reconstructed datagram
-      error = netBufferSetLength((NetBuffer *) &frag->buffer,
-         frag->headerLength + dataLast + sizeof(Ipv4HoleDesc));
-
-      //Any error to report?
-      if(error)
-      {
-         //Number of failures detected by the IP reassembly algorithm
-         MIB2_INC_COUNTER32(mib2Base.ipGroup.ipReasmFails, 1);
-         //Drop the reconstructed datagram
-         netBufferSetLength((NetBuffer *) &frag->buffer, 0);
-         //Exit immediately
-         return;
-      }
-
-      //Actual length of the payload
-      frag->dataLength = dataLast;
+      //The payload cannot end at two different places, nor before
+      //data that has already been received
+      if(frag->dataLength != 0 && frag->dataLength != dataLast)
+         error = ERROR_INVALID_PACKET;
+      else if(i > 0 && (frag->offset[i] + frag->buffer.chunk[i].length) > dataLast)
+         error = ERROR_INVALID_PACKET;
+      else
+         error = NO_ERROR;
    }
-
-   //Select the first hole descriptor from the list
-   hole = ipv4FindHole(frag, frag->firstHole);
-   //Keep track of the previous hole in the list
-   prevHole = NULL;
-
-   //Iterate through the hole descriptors
-   while(hole != NULL)
+   else
    {
-      //Save lower and upper boundaries for later use
-      uint16_t holeFirst = hole->first;
-      uint16_t holeLast = hole->last;
-
-      //Check whether the newly arrived fragment
-      //interacts with this hole in some way
-      if(dataFirst < holeLast && dataLast > holeFirst)
-      {
-         //The current descriptor is no longer valid. We will destroy
-         //it, and in the next two steps, we will determine whether
-         //or not it is necessary to create any new hole descriptors
-         if(prevHole != NULL)
-            prevHole->next = hole->next;
-         else
-            frag->firstHole = hole->next;
-
-         //Is there still a hole at the beginning of the segment?
-         if(dataFirst > holeFirst)
-         {
-            //Create a new entry that describes this hole
-            hole = ipv4FindHole(frag, holeFirst);
-            hole->first = holeFirst;
-            hole->last = dataFirst;
-
-            //Insert the newly created entry into the hole descriptor list
-            if(prevHole != NULL)
-            {
-               hole->next = prevHole->next;
-               prevHole->next = hole->first;
-            }
-            else
-            {
-               hole->next = frag->firstHole;
-               frag->firstHole = hole->first;
-            }
-
-            //Always keep track of the previous hole
-            prevHole = hole;
-         }
-
-         //Is there still a hole at the end of the segment?
-         if(dataLast < holeLast && (offset & IPV4_FLAG_MF))
-         {
-            //Create a new entry that describes this hole
-            hole = ipv4FindHole(frag, dataLast);
-            hole->first = dataLast;
-            hole->last = holeLast;
+      //No fragment may extend past the end of the payload
+      if(frag->dataLength != 0 && dataLast > frag->dataLength)
+         error = ERROR_INVALID_PACKET;
+      else
+         error = NO_ERROR;
+   }
 
-            //Insert the newly created entry into the hole descriptor list
-            if(prevHole != NULL)
-            {
-               hole->next = prevHole->next;
-               prevHole->next = hole->first;
-            }
-            else
-            {
-               hole->next = frag->firstHole;
-               frag->firstHole = hole->first;
-            }
+   //Check status code
+   if(!error)
+   {
+      //Save the length of the payload
+      if(!(offset & IPV4_FLAG_MF))
+         frag->dataLength = dataLast;
 
-            //Always keep track of the previous hole
-            prevHole = hole;
-         }
-      }
-      else
+      //Always take the IP header from the first fragment
+      if(dataFirst == 0)
       {
-         //The newly arrived fragment does not interact with the current hole
-         prevHole = hole;
+         frag->headerLength = headerLength;
+         frag->buffer.chunk[0].length = headerLength;
+         memcpy(frag->buffer.chunk[0].address, packet, headerLength);
       }
 
-      //Select the next hole descriptor from the list
-      hole = ipv4FindHole(frag, prevHole ? prevHole->next : frag->firstHole);
+      //Link the new data into the reassembly buffer
+      error = ipv4InsertFragment(frag, IPV4_DATA(packet), dataFirst, dataLast);
    }
 
-   //Copy data from the fragment to the reassembly buffer
-   netBufferWrite((NetBuffer *) &frag->buffer,
-      frag->headerLength + dataFirst, IPV4_DATA(packet), length);
+   //Any error to report?
+   if(error)
+   {
+      //Number of failures detected by the IP reassembly algorithm
+      MIB2_INC_COUNTER32(mib2Base.ipGroup.ipReasmFails, 1);
+      //Drop the partially reconstructed datagram
+      ipv4DropFragDesc(frag);
+      //Exit immediately
+      return;
+   }
 
    //Dump hole descriptor list
    ipv4DumpHoleList(frag);
 
-   //If the hole descriptor list is empty, the reassembly process is now complete
-   if(!ipv4FindHole(frag, frag->firstHole))
+   //The reassembly process is complete when the whole payload is received
+   if(frag->dataLength != 0 && frag->receivedLength == frag->dataLength)
    {
-      //Discard the extra hole descriptor that follows the reconstructed datagram
-      error = netBufferSetLength((NetBuffer *) &frag->buffer,
-         frag->headerLength + frag->dataLength);
+      //The headers of the upper layer must not span several chunks
+      error = ipv4MergeFragments(frag, IPV4_FRAG_CONTIGUOUS_LENGTH);
 
       //Check status code
       if(error)
@@ -380,7 +309,7 @@ void ipv4ReassembleDatagram(NetInterface *interface,
       else
       {
          //Point to the IP header
-         Ipv4Header *datagram = netBufferAt((NetBuffer *) &frag->buffer, 0);
+         Ipv4Header *datagram = frag->buffer.chunk[0].address;
 
          //Fix IP header
          datagram->totalLength = htons(frag->headerLength + frag->dataLength);
@@ -395,7 +324,7 @@ void ipv4ReassembleDatagram(NetInterface *interface,
       }
 
       //Release previously allocated memory
-      netBufferSetLength((NetBuffer *) &frag->buffer, 0);
+      ipv4DropFragDesc(frag);
    }
 }
 
@@ -414,7 +343,6 @@ void ipv4FragTick(NetInterface *interface)
    error_t error;
    uint_t i;
    systime_t time;
-   Ipv4HoleDesc *hole;
 
    //Get current time
    time = osGetSystemTime();
@@ -440,16 +368,13 @@ void ipv4FragTick(NetInterface *interface)
             //Number of failures detected by the IP reassembly algorithm
             MIB2_INC_COUNTER32(mib2Base.ipGroup.ipReasmFails, 1);
 
-            //Point to the first hole descriptor
-            hole = ipv4FindHole(frag, frag->firstHole);
-
             //Make sure the fragment zero has been received
             //before sending an ICMP message
-            if(hole != NULL && hole->first > 0)
+            if(frag->buffer.chunkCount > 1 && frag->offset[1] == 0)
             {
-               //Fix the size of the reconstructed datagram
+               //Keep the data that follows the header
                error = netBufferSetLength((NetBuffer *) &frag->buffer,
-                  frag->headerLength + hole->first);
+                  frag->headerLength + frag->buffer.chunk[1].length);
 
                //Check status code
                if(!error)
@@ -461,7 +386,7 @@ void ipv4FragTick(NetInterface *interface)
             }
 
             //Drop the partially reconstructed datagram
-            netBufferSetLength((NetBuffer *) &frag->buffer, 0);
+            ipv4DropFragDesc(frag);
          }
       }
    }
@@ -470,6 +395,9 @@ void ipv4FragTick(NetInterface *interface)
 
 /**
  * @brief Search for a matching datagram in the reassembly queue
+ *
+ * When the queue is full, the oldest datagram is dropped to make room
+ *
  * @param[in] interface Underlying network interface
  * @param[in] packet Incoming IPv4 packet
  * @return Matching fragment descriptor
@@ -477,11 +405,13 @@ void ipv4FragTick(NetInterface *interface)
 
 Ipv4FragDesc *ipv4SearchFragQueue(NetInterface *interface, const Ipv4Header *packet)
 {
-   error_t error;
    uint_t i;
    Ipv4Header *datagram;
    Ipv4FragDesc *frag;
-   Ipv4HoleDesc *hole;
+   Ipv4FragDesc *oldestFrag;
+
+   //Keep track of the oldest entry
+   oldestFrag = NULL;
 
    //Search for a matching IP datagram being reassembled
    for(i = 0; i < IPV4_MAX_FRAG_DATAGRAMS; i++)
@@ -493,7 +423,11 @@ Ipv4FragDesc *ipv4SearchFragQueue(NetInterface *interface, const Ipv4Header *pac
       if(frag->buffer.chunkCount > 0)
       {
          //Point to the corresponding datagram
-         datagram = netBufferAt((NetBuffer *) &frag->buffer, 0);
+         datagram = frag->buffer.chunk[0].address;
+
+         //Keep track of the oldest entry
+         if(oldestFrag == NULL || timeCompare(frag->timestamp, oldestFrag->timestamp) < 0)
+            oldestFrag = frag;
 
          //Check source and destination addresses
          if(datagram->srcAddr != packet->srcAddr)
@@ -520,55 +454,56 @@ Ipv4FragDesc *ipv4SearchFragQueue(NetInterface *interface, const Ipv4Header *pac
 
       //The current entry is free?
       if(!frag->buffer.chunkCount)
-      {
-         //Number of chunks that comprise the reassembly buffer
-         frag->buffer.maxChunkCount = arraysize(frag->buffer.chunk);
+         break;
+   }
 
-         //Allocate sufficient memory to hold the IPv4 header and
-         //the first hole descriptor
-         error = netBufferSetLength((NetBuffer *) &frag->buffer,
-            NET_MEM_POOL_BUFFER_SIZE + sizeof(Ipv4HoleDesc));
+   //The reassembly queue is full?
+   if(i >= IPV4_MAX_FRAG_DATAGRAMS)
+   {
+      //Number of failures detected by the IP reassembly algorithm
+      MIB2_INC_COUNTER32(mib2Base.ipGroup.ipReasmFails, 1);
+      //The oldest datagram is the least likely to complete
+      ipv4DropFragDesc(oldestFrag);
+      //Reuse its entry
+      frag = oldestFrag;
+   }
 
-         //Failed to allocate memory?
-         if(error)
-         {
-            //Clean up side effects
-            netBufferSetLength((NetBuffer *) &frag->buffer, 0);
-            //Exit immediately
-            return NULL;
-         }
+   //Make room for the IPv4 header
+   if(ipv4ReserveFragMem(frag, ipv4FragBlockSize(IPV4_MAX_HEADER_LENGTH)))
+      return NULL;
 
-         //Initial length of the reconstructed datagram
-         frag->headerLength = packet->headerLength * 4;
-         frag->dataLength = 0;
+   //The first chunk holds the IPv4 header
+   frag->buffer.chunk[0].address = memPoolAlloc(IPV4_MAX_HEADER_LENGTH);
+   //Failed to allocate memory?
+   if(frag->buffer.chunk[0].address == NULL)
+      return NULL;
 
-         //Fix the length of the first chunk
-         frag->buffer.chunk[0].length = frag->headerLength;
-         //Copy IPv4 header from the incoming fragment
-         netBufferWrite((NetBuffer *) &frag->buffer, 0, packet, frag->headerLength);
+   //Number of chunks that comprise the reassembly buffer
+   frag->buffer.maxChunkCount = arraysize(frag->buffer.chunk);
+   frag->buffer.chunkCount = 1;
+   frag->buffer.chunk[0].size = ipv4FragBlockSize(IPV4_MAX_HEADER_LENGTH);
 
-         //Save current time
-         frag->timestamp = osGetSystemTime();
-         //Create a new entry in the hole descriptor list
-         frag->firstHole = 0;
+   //Initial length of the reconstructed datagram
+   frag->headerLength = packet->headerLength * 4;
+   frag->dataLength = 0;
+   frag->receivedLength = 0;
 
-         //Point to first hole descriptor
-         hole = ipv4FindHole(frag, frag->firstHole);
-         //The entry describes the datagram as being completely missing
-         hole->first = 0;
-         hole->last = IPV4_INFINITY;
-         hole->next = IPV4_INFINITY;
+   //Keep track of the memory held by the reassembly buffer
+   frag->memUsage = frag->buffer.chunk[0].size;
+   ipv4FragMemUsage += frag->buffer.chunk[0].size;
 
-         //Dump hole descriptor list
-         ipv4DumpHoleList(frag);
+   //Copy IPv4 header from the incoming fragment
+   frag->buffer.chunk[0].length = frag->headerLength;
+   memcpy(frag->buffer.chunk[0].address, packet, frag->headerLength);
 
-         //Return the matching fragment descriptor
-         return frag;
-      }
-   }
+   //Save current time
+   frag->timestamp = osGetSystemTime();
 
-   //The reassembly queue is full
-   return NULL;
+   //Dump hole descriptor list
+   ipv4DumpHoleList(frag);
+
+   //Return the matching fragment descriptor
+   return frag;
 }
 
 
@@ -585,23 +520,481 @@ void ipv4FlushFragQueue(NetInterface *interface)
    for(i = 0; i < IPV4_MAX_FRAG_DATAGRAMS; i++)
    {
       //Drop any partially reconstructed datagram
-      netBufferSetLength((NetBuffer *) &interface->ipv4Context.fragQueue[i].buffer, 0);
+      ipv4DropFragDesc(&interface->ipv4Context.fragQueue[i]);
    }
 }
 
 
 /**
- * @brief Retrieve hole descriptor
+ * @brief Link the data of a fragment into the reassembly buffer
+ *
+ * Only the parts of the fragment that fall into holes are stored. A part
+ * that extends an adjacent chunk goes into the unused end of its memory
+ * block when it fits, otherwise it gets a block of its own
+ *
  * @param[in] frag IPv4 fragment descriptor
- * @param[in] offset Offset of the hole
- * @return A pointer to the hole descriptor is returned if the
- *   specified offset is valid. Otherwise NULL is returned
+ * @param[in] data Payload of the fragment
+ * @param[in] dataFirst Index of the first byte
+ * @param[in] dataLast Index immediately following the last byte
+ * @return Error code
  **/
 
-Ipv4HoleDesc *ipv4FindHole(Ipv4FragDesc *frag, uint16_t offset)
+error_t ipv4InsertFragment(Ipv4FragDesc *frag,
+   const uint8_t *data, uint16_t dataFirst, uint16_t dataLast)
 {
-   //Return a pointer to the hole descriptor
-   return netBufferAt((NetBuffer *) &frag->buffer, frag->headerLength + offset);
+   error_t error;
+   uint_t i;
+   uint16_t pos;
+   uint16_t end;
+   uint8_t *p;
+   ChunkDesc *chunk;
+   Ipv4ReassemblyBuffer *buffer;
+
+   //Point to the reassembly buffer
+   buffer = &frag->buffer;
+
+   //The data chunks follow the IP header
+   i = 1;
+   pos = dataFirst;
+
+   //Fill the holes covered by the fragment
+   while(pos < dataLast)
+   {
+      //Skip the chunks that end before the current position
+      while(i < buffer->chunkCount &&
+         (frag->offset[i] + buffer->chunk[i].length) <= pos)
+      {
+         i++;
+      }
+
+      //Data already received at the current position?
+      if(i < buffer->chunkCount && frag->offset[i] <= pos)
+      {
+         //The first copy is kept
+         pos = frag->offset[i] + buffer->chunk[i].length;
+         i++;
+         continue;
+      }
+
+      //End of the hole, or of the fragment
+      end = dataLast;
+      if(i < buffer->chunkCount && frag->offset[i] < end)
+         end = frag->offset[i];
+
+      //Does the data follow the previous chunk?
+      if(i > 1 && (frag->offset[i - 1] + buffer->chunk[i - 1].length) == pos)
+      {
+         //Point to the previous chunk
+         chunk = &buffer->chunk[i - 1];
+
+         //Room left in its memory block?
+         if((chunk->length + end - pos) <= chunk->size)
+         {
+            //Append the data
+            memcpy((uint8_t *) chunk->address + chunk->length,
+               data + (pos - dataFirst), end - pos);
+            chunk->length += end - pos;
+
+            //Update the amount of data received
+            frag->receivedLength += end - pos;
+
+            //Next hole
+            pos = end;
+            continue;
+         }
+      }
+
+      //Does the data precede the next chunk?
+      if(i < buffer->chunkCount && frag->offset[i] == end)
+      {
+         //Point to the next chunk
+         chunk = &buffer->chunk[i];
+
+         //Room left in its memory block?
+         if((chunk->length + end - pos) <= chunk->size)
+         {
+            //Move the chunk contents and prepend the data
+            memmove((uint8_t *) chunk->address + end - pos,
+               chunk->address, chunk->length);
+            memcpy(chunk->address, data + (pos - dataFirst), end - pos);
+            chunk->length += end - pos;
+            frag->offset[i] = pos;
+
+            //Update the amount of data received
+            frag->receivedLength += end - pos;
+
+            //Next hole
+            pos = end;
+            continue;
+         }
+      }
+
+      //Make sure there is a free chunk descriptor
+      if(buffer->chunkCount >= buffer->maxChunkCount)
+      {
+         //Merge two chunks that precede or follow the hole
+         error = ipv4CompactChunks(frag);
+         //Any error to report?
+         if(error)
+            return error;
+
+         //The chunks before the current position may have moved
+         i = 1;
+         continue;
+      }
+
+      //Make room for the data
+      error = ipv4ReserveFragMem(frag, ipv4FragBlockSize(end - pos));
+      //Any error to report?
+      if(error)
+         return error;
+
+      //Allocate a memory block that fits the data
+      p = memPoolAlloc(end - pos);
+      //Failed to allocate memory?
+      if(p == NULL)
+         return ERROR_OUT_OF_MEMORY;
+
+      //Copy the data
+      memcpy(p, data + (pos - dataFirst), end - pos);
+
+      //Insert a new chunk, keeping offset order
+      memmove(&buffer->chunk[i + 1], &buffer->chunk[i],
+         (buffer->chunkCount - i) * sizeof(ChunkDesc));
+      memmove(&frag->offset[i + 1], &frag->offset[i],
+         (buffer->chunkCount - i) * sizeof(uint16_t));
+
+      buffer->chunk[i].address = p;
+      buffer->chunk[i].length = end - pos;
+      buffer->chunk[i].size = ipv4FragBlockSize(end - pos);
+      frag->offset[i] = pos;
+      buffer->chunkCount++;
+
+      //Update the amount of data received and memory held
+      frag->receivedLength += end - pos;
+      frag->memUsage += buffer->chunk[i].size;
+      ipv4FragMemUsage += buffer->chunk[i].size;
+
+      //Next hole
+      pos = end;
+      i++;
+   }
+
+   //Successful processing
+   return NO_ERROR;
+}
+
+
+/**
+ * @brief Make the beginning of a reassembled payload contiguous
+ *
+ * The first data chunks are copied into one block when they are shorter
+ * than the requested length
+ *
+ * @param[in] frag IPv4 fragment descriptor
+ * @param[in] length Number of bytes that must be contiguous
+ * @return Error code
+ **/
+
+error_t ipv4MergeFragments(Ipv4FragDesc *frag, size_t length)
+{
+   uint_t n;
+   size_t size;
+   Ipv4ReassemblyBuffer *buffer;
+
+   //Point to the reassembly buffer
+   buffer = &frag->buffer;
+
+   //The payload may be shorter
+   length = MIN(length, frag->dataLength);
+
+   //Count the chunks that hold the first bytes
+   for(size = 0, n = 1; (n < buffer->chunkCount) && (size < length); n++)
+      size += buffer->chunk[n].length;
+
+   //The first data chunk is long enough in most cases
+   if(n <= 2)
+      return NO_ERROR;
+
+   //Copy them into one block
+   return ipv4MergeChunks(frag, 1, n - 1);
+}
+
+
+/**
+ * @brief Copy adjacent data chunks into one memory block
+ * @param[in] frag IPv4 fragment descriptor
+ * @param[in] index Index of the first chunk
+ * @param[in] count Number of chunks to merge
+ * @return Error code
+ **/
+
+static error_t ipv4MergeChunks(Ipv4FragDesc *frag, uint_t index, uint_t count)
+{
+   error_t error;
+   uint_t i;
+   size_t size;
+   size_t blockSize;
+   size_t memUsage;
+   uint8_t *p;
+   Ipv4ReassemblyBuffer *buffer;
+
+   //Point to the reassembly buffer
+   buffer = &frag->buffer;
+
+   //Total length of the chunks and memory they hold
+   for(size = 0, memUsage = 0, i = index; i < (index + count); i++)
+   {
+      size += buffer->chunk[i].length;
+      memUsage += buffer->chunk[i].size;
+   }
+
+   //The merged block may be larger than the original ones together
+   blockSize = ipv4FragBlockSize(size);
+
+   //Make room for the difference
+   if(blockSize > memUsage)
+   {
+      error = ipv4ReserveFragMem(frag, blockSize - memUsage);
+      //Any error to report?
+      if(error)
+         return error;
+   }
+
+   //Allocate a memory block for the merged chunks
+   p = memPoolAlloc(size);
+   //Failed to allocate memory?
+   if(p == NULL)
+      return ERROR_OUT_OF_MEMORY;
+
+   //Copy the data and release the original blocks
+   for(size = 0, i = index; i < (index + count); i++)
+   {
+      memcpy(p + size, buffer->chunk[i].address, buffer->chunk[i].length);
+      size += buffer->chunk[i].length;
+      memPoolFree(buffer->chunk[i].address);
+   }
+
+   //The merged block replaces the first chunk
+   buffer->chunk[index].address = p;
+   buffer->chunk[index].length = size;
+   buffer->chunk[index].size = blockSize;
+
+   //Update the memory held
+   frag->memUsage = frag->memUsage + blockSize - memUsage;
+   ipv4FragMemUsage = ipv4FragMemUsage + blockSize - memUsage;
+
+   //Remove the other merged chunks
+   memmove(&buffer->chunk[index + 1], &buffer->chunk[index + count],
+      (buffer->chunkCount - index - count) * sizeof(ChunkDesc));
+   memmove(&frag->offset[index + 1], &frag->offset[index + count],
+      (buffer->chunkCount - index - count) * sizeof(uint16_t));
+   buffer->chunkCount -= count - 1;
+
+   //Successful processing
+   return NO_ERROR;
+}
+
+
+/**
+ * @brief Size of the memory block that holds a data chunk
+ *
+ * The pool hands out the smallest buffer class that fits, which is what a
+ * chunk pins and what the memory budget is charged
+ *
+ * @param[in] size Length of the data
+ * @return Size of the memory block
+ **/
+
+static size_t ipv4FragBlockSize(size_t size)
+{
+#if (NET_MEM_POOL_SUPPORT == ENABLED)
+   //Round up to the size of the buffer class
+   if(size <= NET_MEM_POOL_SMALL_BUFFER_SIZE)
+      return NET_MEM_POOL_SMALL_BUFFER_SIZE;
+   else if(size <= NET_MEM_POOL_MEDIUM_BUFFER_SIZE)
+      return NET_MEM_POOL_MEDIUM_BUFFER_SIZE;
+   else
+      return NET_MEM_POOL_BUFFER_SIZE;
+#else
+   //The block is allocated with the exact size
+   return size;
+#endif
+}
+
+
+/**
+ * @brief Free a chunk descriptor of a reassembly buffer
+ *
+ * Small fragments may use up the chunk descriptors. The shortest pair of
+ * adjacent chunks that fits in a pool buffer is then copied into one block
+ *
+ * @param[in] frag IPv4 fragment descriptor
+ * @return Error code
+ **/
+
+static error_t ipv4CompactChunks(Ipv4FragDesc *frag)
+{
+   uint_t i;
+   uint_t index;
+   size_t size;
+   size_t minSize;
+   Ipv4ReassemblyBuffer *buffer;
+
+   //Point to the reassembly buffer
+   buffer = &frag->buffer;
+
+   //No pair found yet
+   index = 0;
+   minSize = NET_MEM_POOL_BUFFER_SIZE + 1;
+
+   //Loop through the data chunks
+   for(i = 1; (i + 1) < buffer->chunkCount; i++)
+   {
+      //Only chunks with no hole in between can be merged
+      if((frag->offset[i] + buffer->chunk[i].length) != frag->offset[i + 1])
+         continue;
+
+      //Keep track of the shortest pair
+      size = buffer->chunk[i].length + buffer->chunk[i + 1].length;
+      if(size < minSize)
+      {
+         index = i;
+         minSize = size;
+      }
+   }
+
+   //No pair can be merged?
+   if(index == 0)
+      return ERROR_BUFFER_OVERFLOW;
+
+   //Merge the pair
+   return ipv4MergeChunks(frag, index, 2);
+}
+
+
+/**
+ * @brief Reserve reassembly memory
+ *
+ * The datagrams that have been waiting the longest are dropped until the
+ * memory held by the reassembly queues fits IPV4_FRAG_MEM_BUDGET
+ *
+ * @param[in] frag Datagram the memory is reserved for
+ * @param[in] size Number of bytes
+ * @return Error code
+ **/
+
+error_t ipv4ReserveFragMem(const Ipv4FragDesc *frag, size_t size)
+{
+   uint_t i;
+   uint_t j;
+   Ipv4FragDesc *entry;
+   Ipv4FragDesc *oldestFrag;
+
+   //Over budget?
+   while((ipv4FragMemUsage + size) > IPV4_FRAG_MEM_BUDGET)
+   {
+      //Keep track of the oldest datagram
+      oldestFrag = NULL;
+
+      //Loop through the reassembly queues of all interfaces
+      for(i = 0; i < NET_INTERFACE_COUNT; i++)
+      {
+         for(j = 0; j < IPV4_MAX_FRAG_DATAGRAMS; j++)
+         {
+            //Point to the current entry
+            entry = &netInterface[i].ipv4Context.fragQueue[j];
+
+            //The datagram that needs the memory is never dropped
+            if(entry->buffer.chunkCount == 0 || entry == frag)
+               continue;
+
+            //Keep track of the oldest datagram
+            if(oldestFrag == NULL || timeCompare(entry->timestamp, oldestFrag->timestamp) < 0)
+               oldestFrag = entry;
+         }
+      }
+
+      //Nothing left to drop?
+      if(oldestFrag == NULL)
+         return ERROR_OUT_OF_RESOURCES;
+
+      //Debug message
+      TRACE_INFO("IPv4 reassembly memory exhausted, dropping oldest datagram...\r\n");
+
+      //Number of failures detected by the IP reassembly algorithm
+      MIB2_INC_COUNTER32(mib2Base.ipGroup.ipReasmFails, 1);
+      //Drop the datagram
+      ipv4DropFragDesc(oldestFrag);
+   }
+
+   //Successful processing
+   return NO_ERROR;
+}
+
+
+/**
+ * @brief Drop a datagram being reassembled
+ * @param[in] frag IPv4 fragment descriptor
+ **/
+
+void ipv4DropFragDesc(Ipv4FragDesc *frag)
+{
+   //Release the memory blocks of the reassembly buffer
+   netBufferSetLength((NetBuffer *) &frag->buffer, 0);
+
+   //The memory is available to the other datagrams
+   ipv4FragMemUsage -= frag->memUsage;
+
+   //The entry is now free
+   frag->memUsage = 0;
+   frag->receivedLength = 0;
+   frag->dataLength = 0;
+}
+
+
+/**
+ * @brief Retrieve the first hole of a datagram being reassembled
+ * @param[in] frag IPv4 fragment descriptor
+ * @param[out] hole Boundaries of the hole
+ * @return TRUE if the datagram has a hole, else FALSE
+ **/
+
+bool_t ipv4FindHole(const Ipv4FragDesc *frag, Ipv4HoleDesc *hole)
+{
+   uint_t i;
+   uint16_t pos;
+
+   //Start right after the IP header
+   pos = 0;
+
+   //Loop through the data chunks
+   for(i = 1; i < frag->buffer.chunkCount; i++)
+   {
+      //Gap before the current chunk?
+      if(frag->offset[i] > pos)
+         break;
+
+      //Skip the current chunk
+      pos = frag->offset[i] + frag->buffer.chunk[i].length;
+   }
+
+   //No hole once the whole payload has been received
+   if(frag->dataLength != 0 && pos >= frag->dataLength)
+      return FALSE;
+
+   //Boundaries of the hole
+   hole->first = pos;
+
+   if(i < frag->buffer.chunkCount)
+      hole->last = frag->offset[i];
+   else if(frag->dataLength != 0)
+      hole->last = frag->dataLength;
+   else
+      hole->last = IPV4_MAX_FRAG_DATAGRAM_SIZE;
+
+   //A hole has been found
+   return TRUE;
 }
 
 
@@ -614,20 +1007,31 @@ void ipv4DumpHoleList(Ipv4FragDesc *frag)
 {
 //Check debugging level
 #if (TRACE_LEVEL >= TRACE_LEVEL_DEBUG)
-   Ipv4HoleDesc *hole;
+   uint_t i;
+   uint16_t pos;
+   uint16_t last;
 
    //Debug message
    TRACE_DEBUG("Hole descriptor list:\r\n");
-   //Select the first hole descriptor from the list
-   hole = ipv4FindHole(frag, frag->firstHole);
 
-   //Loop through the hole descriptor list
-   while(hole != NULL)
+   //The holes are the gaps between the data chunks
+   for(pos = 0, i = 1; i <= frag->buffer.chunkCount; i++)
    {
+      //End of the current gap
+      if(i < frag->buffer.chunkCount)
+         last = frag->offset[i];
+      else if(frag->dataLength != 0)
+         last = frag->dataLength;
+      else
+         last = IPV4_MAX_FRAG_DATAGRAM_SIZE;
+
       //Display current hole
-      TRACE_DEBUG("  %" PRIu16 " - %" PRIu16 "\r\n", hole->first, hole->last);
-      //Select the next hole descriptor from the list
-      hole = ipv4FindHole(frag, hole->next);
+      if(last > pos)
+         TRACE_DEBUG("  %" PRIu16 " - %" PRIu16 "\r\n", pos, last);
+
+      //Skip the current chunk
+      if(i < frag->buffer.chunkCount)
+         pos = frag->offset[i] + frag->buffer.chunk[i].length;
    }
 #endif
 }
@@ -69,13 +69,26 @@
    #error IPV4_FRAG_TIME_TO_LIVE parameter is not valid
 #endif
 
-//Infinity is implemented by a very large integer
-#define IPV4_INFINITY 0xFFFF
+//Memory the reassembly queues of all interfaces may hold, counted in
+//memory pool blocks
+#ifndef IPV4_FRAG_MEM_BUDGET
+   #define IPV4_FRAG_MEM_BUDGET (2 * IPV4_MAX_FRAG_DATAGRAM_SIZE)
+#elif (IPV4_FRAG_MEM_BUDGET < 576)
+   #error IPV4_FRAG_MEM_BUDGET parameter is not valid
+#endif
 
+//Maximum number of data chunks of a datagram being reassembled
+#ifndef IPV4_MAX_FRAG_CHUNKS
+   #define IPV4_MAX_FRAG_CHUNKS (N(IPV4_MAX_FRAG_DATAGRAM_SIZE) + 4)
+#elif (IPV4_MAX_FRAG_CHUNKS < 2)
+   #error IPV4_MAX_FRAG_CHUNKS parameter is not valid
+#endif
 
-//CodeWarrior or Win32 compiler?
-#if defined(__CWCC__) || defined(_WIN32)
-   #pragma pack(push, 1)
+//Length of the payload kept contiguous for the upper layer headers
+#ifndef IPV4_FRAG_CONTIGUOUS_LENGTH
+   #define IPV4_FRAG_CONTIGUOUS_LENGTH 64
+#elif (IPV4_FRAG_CONTIGUOUS_LENGTH < 8)
+   #error IPV4_FRAG_CONTIGUOUS_LENGTH parameter is not valid
 #endif
 
 
@@ -83,29 +96,26 @@
  * @brief Hole descriptor
  **/
 
-typedef __start_packed struct
+typedef struct
 {
    uint16_t first;
    uint16_t last;
-   uint16_t next;
-} __end_packed Ipv4HoleDesc;
-
-
-//CodeWarrior or Win32 compiler?
-#if defined(__CWCC__) || defined(_WIN32)
-   #pragma pack(pop)
-#endif
+} Ipv4HoleDesc;
 
 
 /**
  * @brief Reassembly buffer
+ *
+ * The first chunk holds the IP header. The other ones are the received data,
+ * in offset order and without overlap. The holes are the gaps between them
+ *
  **/
 
 typedef struct
 {
    uint_t chunkCount;
    uint_t maxChunkCount;
-   ChunkDesc chunk[N(IPV4_MAX_FRAG_DATAGRAM_SIZE) + 1];
+   ChunkDesc chunk[IPV4_MAX_FRAG_CHUNKS + 1];
 } Ipv4ReassemblyBuffer;
 
 
@@ -117,14 +127,18 @@ typedef struct
 {
    systime_t timestamp;         ///<Time at which the first fragment was received
    size_t headerLength;         ///<Length of the header
-   size_t dataLength;           ///<Length of the payload
-   uint16_t firstHole;          ///<Index of the first hole
+   size_t dataLength;           ///<Length of the payload (0 until the last fragment is received)
+   size_t receivedLength;       ///<Number of payload bytes received so far
+   size_t memUsage;             ///<Memory held by the reassembly buffer
+   uint16_t offset[IPV4_MAX_FRAG_CHUNKS + 1]; ///<Payload offset of each chunk
    Ipv4ReassemblyBuffer buffer; ///<Buffer containing the reassembled datagram
 } Ipv4FragDesc;
 
 
 //Tick counter to handle periodic operations
 extern systime_t ipv4FragTickCounter;
+//Memory held by the reassembly queues
+extern size_t ipv4FragMemUsage;
 
 //IPv4 datagram fragmentation and reassembly
 error_t ipv4FragmentDatagram(NetInterface *interface, Ipv4PseudoHeader *pseudoHeader,
@@ -138,7 +152,13 @@ void ipv4FragTick(NetInterface *interface);
 Ipv4FragDesc *ipv4SearchFragQueue(NetInterface *interface, const Ipv4Header *packet);
 void ipv4FlushFragQueue(NetInterface *interface);
 
-Ipv4HoleDesc *ipv4FindHole(Ipv4FragDesc *frag, uint16_t offset);
+error_t ipv4InsertFragment(Ipv4FragDesc *frag,
+   const uint8_t *data, uint16_t dataFirst, uint16_t dataLast);
+error_t ipv4MergeFragments(Ipv4FragDesc *frag, size_t length);
+error_t ipv4ReserveFragMem(const Ipv4FragDesc *frag, size_t size);
+void ipv4DropFragDesc(Ipv4FragDesc *frag);
+
+bool_t ipv4FindHole(const Ipv4FragDesc *frag, Ipv4HoleDesc *hole);
 void ipv4DumpHoleList(Ipv4FragDesc *frag);
 
 #endif
@@ -119,6 +119,8 @@ error_t mdnsClientResolve(NetInterface *interface,
 
          //Switch state
          entry->state = DNS_STATE_IN_PROGRESS;
+         //Schedule the retransmission of the query
+         dnsUpdateTimer();
          //Host name resolution is in progress
          error = ERROR_IN_PROGRESS;
       }
@@ -304,6 +306,8 @@ void mdnsClientParseAnRecord(NetInterface *interface,
 
                         //Host name successfully resolved
                         entry->state = DNS_STATE_RESOLVED;
+                        //Schedule the expiration of the entry
+                        dnsUpdateTimer();
                      }
                   }
                }
@@ -331,6 +335,8 @@ void mdnsClientParseAnRecord(NetInterface *interface,
 
                         //Host name successfully resolved
                         entry->state = DNS_STATE_RESOLVED;
+                        //Schedule the expiration of the entry
+                        dnsUpdateTimer();
                      }
                   }
                }
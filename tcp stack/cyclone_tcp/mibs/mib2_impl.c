@@ -617,7 +617,7 @@ error_t mib2GetNextIpAddrEntry(const MibObject *object, const uint8_t *oid,
    n = object->oidLen;
 
    //The ipAdEntAddr is used as instance identifier
-   error = mibEncodeIpv4Addr(nextOid, *nextOidLen, &n, interface->ipv4Context.addr);
+   error = mibEncodeIpv4Addr(nextOid, *nextOidLen, &n, ipAddr);
    //Any error to report?
    if(error) return error;
 
@@ -114,6 +114,8 @@ error_t nbnsResolve(NetInterface *interface, const char_t *name, IpAddr *ipAddr)
 
          //Switch state
          entry->state = DNS_STATE_IN_PROGRESS;
+         //Schedule the retransmission of the query
+         dnsUpdateTimer();
          //Host name resolution is in progress
          error = ERROR_IN_PROGRESS;
       }
@@ -343,6 +345,8 @@ void nbnsProcessResponse(NetInterface *interface, const Ipv4PseudoHeader *pseudo
 
                //Host name successfully resolved
                entry->state = DNS_STATE_RESOLVED;
+               //Schedule the expiration of the entry
+               dnsUpdateTimer();
             }
          }
       }
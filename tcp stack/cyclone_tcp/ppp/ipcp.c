@@ -36,6 +36,7 @@
 #include "ppp/ppp_misc.h"
 #include "ppp/ppp_debug.h"
 #include "ppp/ipcp.h"
+#include "ppp/ppp_vj.h"
 #include "debug.h"
 
 //Check TCP/IP stack configuration
@@ -237,6 +238,12 @@ error_t ipcpProcessConfigureReq(PppContext *context,
    notRecognizable = FALSE;
    notAcceptable = FALSE;
 
+#if (PPP_VJ_SUPPORT == ENABLED)
+   //The headers are compressed only if the request being acknowledged
+   //contains the IP-Compression-Protocol option
+   context->peerConfig.vjComp = FALSE;
+#endif
+
    //Retrieve the length of the option list
    length = ntohs(configureReqPacket->length) - sizeof(PppConfigurePacket);
    //Point to the first option
@@ -409,6 +416,35 @@ error_t ipcpProcessConfigureNak(PppContext *context,
          //Save secondary DNS server address
          context->localConfig.secondaryDns = secondaryDns->ipAddr;
       }
+#if (PPP_VJ_SUPPORT == ENABLED)
+      //IP-Compression-Protocol option?
+      else if(option->type == IPCP_OPTION_IP_COMP_PROTOCOL)
+      {
+         //Cast option
+         IpcpIpCompProtocolOption *ipCompProtocol = (IpcpIpCompProtocolOption *) option;
+
+         //Check option length
+         if(ipCompProtocol->length < sizeof(IpcpIpCompProtocolOption))
+            return ERROR_INVALID_LENGTH;
+
+         //Van Jacobson compression with other parameters?
+         if(ipCompProtocol->length == IPCP_VJ_COMP_OPTION_SIZE &&
+            ntohs(ipCompProtocol->protocol) == PPP_PROTOCOL_VJ_COMP &&
+            ipCompProtocol->data[0] <= context->localConfig.vjMaxSlotId)
+         {
+            //The decompressor holds fewer slots than it can
+            context->localConfig.vjMaxSlotId = ipCompProtocol->data[0];
+            //The slot ID may have to be sent in every packet
+            if(!ipCompProtocol->data[1])
+               context->localConfig.vjCompSlotId = FALSE;
+         }
+         else
+         {
+            //The peer cannot send compressed headers we can read
+            context->localConfig.vjCompRejected = TRUE;
+         }
+      }
+#endif
 
       //Remaining bytes to process
       length -= option->length;
@@ -477,6 +513,14 @@ error_t ipcpProcessConfigureReject(PppContext *context,
          //The option is not recognized by the peer
          context->localConfig.secondaryDnsRejected = TRUE;
       }
+#if (PPP_VJ_SUPPORT == ENABLED)
+      //IP-Compression-Protocol option?
+      else if(option->type == IPCP_OPTION_IP_COMP_PROTOCOL)
+      {
+         //The option is not recognized by the peer
+         context->localConfig.vjCompRejected = TRUE;
+      }
+#endif
 
       //Remaining bytes to process
       length -= option->length;
@@ -624,6 +668,16 @@ void ipcpThisLayerUp(PppContext *context)
    TRACE_INFO("  Primary DNS = %s\r\n", ipv4AddrToString(context->localConfig.primaryDns, NULL));
    TRACE_INFO("  Secondary DNS = %s\r\n", ipv4AddrToString(context->localConfig.secondaryDns, NULL));
 
+#if (PPP_VJ_SUPPORT == ENABLED)
+   //Debug message
+   TRACE_INFO("  VJ compression: receive = %s, send = %s\r\n",
+      (context->localConfig.vjComp && !context->localConfig.vjCompRejected) ? "yes" : "no",
+      context->peerConfig.vjComp ? "yes" : "no");
+
+   //Start with no connection in either direction
+   pppVjInit(context, context->peerConfig.vjMaxSlotId, context->peerConfig.vjCompSlotId);
+#endif
+
    //Point to the underlying interface
    interface = context->interface;
 
@@ -797,6 +851,21 @@ error_t ipcpSendConfigureReq(PppContext *context)
          &context->localConfig.secondaryDns, sizeof(Ipv4Addr));
    }
 
+#if (PPP_VJ_SUPPORT == ENABLED)
+   //Make sure the IP-Compression-Protocol option has not been
+   //previously rejected
+   if(!context->localConfig.vjCompRejected)
+   {
+      //Van Jacobson compression is requested?
+      if(context->localConfig.vjComp)
+      {
+         //Add option
+         ipcpAddVjCompOption(configureReqPacket, context->localConfig.vjMaxSlotId,
+            context->localConfig.vjCompSlotId);
+      }
+   }
+#endif
+
    //Save packet length
    length = configureReqPacket->length;
    //Convert length field to network byte order
@@ -1000,11 +1069,17 @@ error_t ipcpParseOption(PppContext *context, PppOption *option,
       //Check IP-Address option
       error = ipcpParseIpAddressOption(context, (IpcpIpAddressOption *) option, outPacket);
       break;
+#if (PPP_VJ_SUPPORT == ENABLED)
+   case IPCP_OPTION_IP_COMP_PROTOCOL:
+      //Check IP-Compression-Protocol option
+      error = ipcpParseIpCompProtocolOption(context, (IpcpIpCompProtocolOption *) option, outPacket);
+      break;
+#endif
    default:
       //If some configuration options received in the Configure-Request are not
       //recognizable or not acceptable for negotiation, then the implementation
       //must transmit a Configure-Reject
-      if(outPacket->code == PPP_CODE_CONFIGURE_REJ)
+      if(outPacket != NULL && outPacket->code == PPP_CODE_CONFIGURE_REJ)
       {
          //The options field of the Configure-Reject packet is filled
          //with the unrecognized options from the Configure-Request
@@ -1084,4 +1159,95 @@ error_t ipcpParseIpAddressOption(PppContext *context,
    return error;
 }
 
+#if (PPP_VJ_SUPPORT == ENABLED)
+
+/**
+ * @brief Parse IP-Compression-Protocol option
+ * @param[in] context PPP context
+ * @param[in] option Option to be checked
+ * @param[out] outPacket Pointer to the Configure-Nak or Configure-Reject packet
+ * @return Error code
+ **/
+
+error_t ipcpParseIpCompProtocolOption(PppContext *context,
+   IpcpIpCompProtocolOption *option, PppConfigurePacket *outPacket)
+{
+   error_t error;
+
+   //Check length field
+   if(option->length >= sizeof(IpcpIpCompProtocolOption))
+   {
+      //Van Jacobson compression is the only protocol supported
+      if(option->length == IPCP_VJ_COMP_OPTION_SIZE &&
+         ntohs(option->protocol) == PPP_PROTOCOL_VJ_COMP)
+      {
+         //If every configuration option received in the Configure-Request is
+         //recognizable and all values are acceptable, then the implementation
+         //must transmit a Configure-Ack
+         if(outPacket != NULL && outPacket->code == PPP_CODE_CONFIGURE_ACK)
+         {
+            //The compressor uses at most as many slots as the peer holds
+            context->peerConfig.vjComp = TRUE;
+            context->peerConfig.vjMaxSlotId = option->data[0];
+            context->peerConfig.vjCompSlotId = option->data[1] ? TRUE : FALSE;
+
+            //The options field of the Configure-Ack packet contains the
+            //configuration options that the sender is acknowledging
+            pppAddOption(outPacket, IPCP_OPTION_IP_COMP_PROTOCOL,
+               (void *) &option->protocol, option->length - sizeof(PppOption));
+         }
+
+         //The value is acceptable
+         error = NO_ERROR;
+      }
+      else
+      {
+         //If all configuration options are recognizable, but some values are not
+         //acceptable, then the implementation must transmit a Configure-Nak
+         if(outPacket != NULL && outPacket->code == PPP_CODE_CONFIGURE_NAK)
+         {
+            //The option must be modified to a value acceptable to the
+            //Configure-Nak sender
+            ipcpAddVjCompOption(outPacket, PPP_VJ_MAX_SLOTS - 1, TRUE);
+         }
+
+         //The value is not acceptable
+         error = ERROR_INVALID_VALUE;
+      }
+   }
+   else
+   {
+      //Invalid length field
+      error = ERROR_INVALID_LENGTH;
+   }
+
+   //Return status code
+   return error;
+}
+
+
+/**
+ * @brief Add an IP-Compression-Protocol option for Van Jacobson compression
+ * @param[in] packet Pointer to the Configure packet
+ * @param[in] maxSlotId Highest slot ID
+ * @param[in] compSlotId The slot ID may be omitted
+ * @return Error code
+ **/
+
+error_t ipcpAddVjCompOption(PppConfigurePacket *packet, uint8_t maxSlotId,
+   bool_t compSlotId)
+{
+   uint8_t value[4];
+
+   //Protocol, Max-Slot-Id and Comp-Slot-Id fields
+   STORE16BE(PPP_PROTOCOL_VJ_COMP, value);
+   value[2] = maxSlotId;
+   value[3] = compSlotId ? 1 : 0;
+
+   //Add option
+   return pppAddOption(packet, IPCP_OPTION_IP_COMP_PROTOCOL, value, sizeof(value));
+}
+
+#endif
+
 #endif
@@ -84,6 +84,9 @@ typedef __start_packed struct
    uint8_t data[];    //4
 } __end_packed IpcpIpCompProtocolOption;
 
+//Size of the option for Van Jacobson compression (Max-Slot-Id and Comp-Slot-Id)
+#define IPCP_VJ_COMP_OPTION_SIZE (sizeof(IpcpIpCompProtocolOption) + 2)
+
 
 /**
  * @brief IP-Address option
@@ -217,4 +220,10 @@ error_t ipcpParseOption(PppContext *context, PppOption *option,
 error_t ipcpParseIpAddressOption(PppContext *context,
    IpcpIpAddressOption *option, PppConfigurePacket *outPacket);
 
+error_t ipcpParseIpCompProtocolOption(PppContext *context,
+   IpcpIpCompProtocolOption *option, PppConfigurePacket *outPacket);
+
+error_t ipcpAddVjCompOption(PppConfigurePacket *packet, uint8_t maxSlotId,
+   bool_t compSlotId);
+
 #endif
@@ -39,7 +39,9 @@
 #include "ppp/ipv6cp.h"
 #include "ppp/pap.h"
 #include "ppp/chap.h"
+#include "ppp/ppp_vj.h"
 #include "str.h"
+#include "crc.h"
 #include "debug.h"
 
 //Check TCP/IP stack configuration
@@ -48,43 +50,6 @@
 //Tick counter to handle periodic operations
 systime_t pppTickCounter;
 
-//FCS lookup table
-static const uint16_t fcsTable[256] =
-{
-   0x0000, 0x1189, 0x2312, 0x329B, 0x4624, 0x57AD, 0x6536, 0x74BF,
-   0x8C48, 0x9DC1, 0xAF5A, 0xBED3, 0xCA6C, 0xDBE5, 0xE97E, 0xF8F7,
-   0x1081, 0x0108, 0x3393, 0x221A, 0x56A5, 0x472C, 0x75B7, 0x643E,
-   0x9CC9, 0x8D40, 0xBFDB, 0xAE52, 0xDAED, 0xCB64, 0xF9FF, 0xE876,
-   0x2102, 0x308B, 0x0210, 0x1399, 0x6726, 0x76AF, 0x4434, 0x55BD,
-   0xAD4A, 0xBCC3, 0x8E58, 0x9FD1, 0xEB6E, 0xFAE7, 0xC87C, 0xD9F5,
-   0x3183, 0x200A, 0x1291, 0x0318, 0x77A7, 0x662E, 0x54B5, 0x453C,
-   0xBDCB, 0xAC42, 0x9ED9, 0x8F50, 0xFBEF, 0xEA66, 0xD8FD, 0xC974,
-   0x4204, 0x538D, 0x6116, 0x709F, 0x0420, 0x15A9, 0x2732, 0x36BB,
-   0xCE4C, 0xDFC5, 0xED5E, 0xFCD7, 0x8868, 0x99E1, 0xAB7A, 0xBAF3,
-   0x5285, 0x430C, 0x7197, 0x601E, 0x14A1, 0x0528, 0x37B3, 0x263A,
-   0xDECD, 0xCF44, 0xFDDF, 0xEC56, 0x98E9, 0x8960, 0xBBFB, 0xAA72,
-   0x6306, 0x728F, 0x4014, 0x519D, 0x2522, 0x34AB, 0x0630, 0x17B9,
-   0xEF4E, 0xFEC7, 0xCC5C, 0xDDD5, 0xA96A, 0xB8E3, 0x8A78, 0x9BF1,
-   0x7387, 0x620E, 0x5095, 0x411C, 0x35A3, 0x242A, 0x16B1, 0x0738,
-   0xFFCF, 0xEE46, 0xDCDD, 0xCD54, 0xB9EB, 0xA862, 0x9AF9, 0x8B70,
-   0x8408, 0x9581, 0xA71A, 0xB693, 0xC22C, 0xD3A5, 0xE13E, 0xF0B7,
-   0x0840, 0x19C9, 0x2B52, 0x3ADB, 0x4E64, 0x5FED, 0x6D76, 0x7CFF,
-   0x9489, 0x8500, 0xB79B, 0xA612, 0xD2AD, 0xC324, 0xF1BF, 0xE036,
-   0x18C1, 0x0948, 0x3BD3, 0x2A5A, 0x5EE5, 0x4F6C, 0x7DF7, 0x6C7E,
-   0xA50A, 0xB483, 0x8618, 0x9791, 0xE32E, 0xF2A7, 0xC03C, 0xD1B5,
-   0x2942, 0x38CB, 0x0A50, 0x1BD9, 0x6F66, 0x7EEF, 0x4C74, 0x5DFD,
-   0xB58B, 0xA402, 0x9699, 0x8710, 0xF3AF, 0xE226, 0xD0BD, 0xC134,
-   0x39C3, 0x284A, 0x1AD1, 0x0B58, 0x7FE7, 0x6E6E, 0x5CF5, 0x4D7C,
-   0xC60C, 0xD785, 0xE51E, 0xF497, 0x8028, 0x91A1, 0xA33A, 0xB2B3,
-   0x4A44, 0x5BCD, 0x6956, 0x78DF, 0x0C60, 0x1DE9, 0x2F72, 0x3EFB,
-   0xD68D, 0xC704, 0xF59F, 0xE416, 0x90A9, 0x8120, 0xB3BB, 0xA232,
-   0x5AC5, 0x4B4C, 0x79D7, 0x685E, 0x1CE1, 0x0D68, 0x3FF3, 0x2E7A,
-   0xE70E, 0xF687, 0xC41C, 0xD595, 0xA12A, 0xB0A3, 0x8238, 0x93B1,
-   0x6B46, 0x7ACF, 0x4854, 0x59DD, 0x2D62, 0x3CEB, 0x0E70, 0x1FF9,
-   0xF78F, 0xE606, 0xD49D, 0xC514, 0xB1AB, 0xA022, 0x92B9, 0x8330,
-   0x7BC7, 0x6A4E, 0x58D5, 0x495C, 0x3DE3, 0x2C6A, 0x1EF1, 0x0F78
-};
-
 
 /**
  * @brief Initialize settings with default values
@@ -445,6 +410,107 @@ error_t pppReceiveAtCommand(NetInterface *interface, char_t *data, size_t size)
 }
 
 
+/**
+ * @brief Send AT command without waiting
+ *
+ * Unlike pppSendAtCommand, the receive buffer is left untouched so that the
+ * unsolicited result codes already received are not lost
+ *
+ * @param[in] interface Underlying network interface
+ * @param[in] data NULL-terminated string that contains the AT command to be sent
+ * @return Error code
+ **/
+
+error_t pppWriteAtCommand(NetInterface *interface, const char_t *data)
+{
+   error_t error;
+   PppContext *context;
+
+   //Check parameters
+   if(interface == NULL)
+      return ERROR_INVALID_PARAMETER;
+   //Make sure PPP has been properly configured
+   if(interface->pppContext == NULL)
+      return ERROR_NOT_CONFIGURED;
+
+   //Point to the PPP context
+   context = interface->pppContext;
+
+   //The send buffer must be available for writing
+   if(!osWaitForEvent(&interface->nicTxEvent, 0))
+      return ERROR_WOULD_BLOCK;
+
+   //Get exclusive access
+   osAcquireMutex(&netMutex);
+
+   //Check current PPP state
+   if(context->pppPhase == PPP_PHASE_DEAD)
+   {
+      //Send AT command
+      error = pppHdlcDriverSendAtCommand(interface, data);
+   }
+   else
+   {
+      //The TX queue is left as it was
+      osSetEvent(&interface->nicTxEvent);
+      //Report an error
+      error = ERROR_ALREADY_CONNECTED;
+   }
+
+   //Release exclusive access
+   osReleaseMutex(&netMutex);
+
+   //Return status code
+   return error;
+}
+
+
+/**
+ * @brief Read a line received from the modem without waiting
+ * @param[in] interface Underlying network interface
+ * @param[out] data Buffer where to store the line
+ * @param[in] size Size of the buffer, in bytes
+ * @return ERROR_BUFFER_EMPTY if no complete line has been received
+ **/
+
+error_t pppReadAtCommand(NetInterface *interface, char_t *data, size_t size)
+{
+   error_t error;
+   PppContext *context;
+
+   //Check parameters
+   if(interface == NULL || data == NULL || size < 2)
+      return ERROR_INVALID_PARAMETER;
+   //Make sure PPP has been properly configured
+   if(interface->pppContext == NULL)
+      return ERROR_NOT_CONFIGURED;
+
+   //Point to the PPP context
+   context = interface->pppContext;
+
+   //Get exclusive access
+   osAcquireMutex(&netMutex);
+
+   //Check current PPP state
+   if(context->pppPhase == PPP_PHASE_DEAD)
+   {
+      //Extract the next line, if complete
+      error = pppHdlcDriverReceiveAtCommand(interface, data, size);
+   }
+   else
+   {
+      //Report an error
+      error = ERROR_ALREADY_CONNECTED;
+   }
+
+   //Release exclusive access
+   osReleaseMutex(&netMutex);
+
+   //Return status code
+   return error;
+}
+
+
 /**
  * @brief Establish a PPP connection
  * @param[in] interface Underlying network interface
@@ -586,8 +652,23 @@ error_t pppConnect(NetInterface *interface)
    if(context->localConfig.secondaryDns != IPV4_UNSPECIFIED_ADDR)
       context->localConfig.secondaryDnsRejected = TRUE;
 
+#if (PPP_VJ_SUPPORT == ENABLED)
+   //Ask the peer to compress the TCP/IP headers it sends
+   context->localConfig.vjComp = TRUE;
+   context->localConfig.vjCompRejected = FALSE;
+   context->localConfig.vjMaxSlotId = PPP_VJ_MAX_SLOTS - 1;
+   context->localConfig.vjCompSlotId = TRUE;
+#endif
+
    //Default peer's configuration
    context->peerConfig.ipAddr = interface->ipv4Context.defaultGateway;
+
+#if (PPP_VJ_SUPPORT == ENABLED)
+   //TCP/IP headers are sent uncompressed until the peer asks otherwise
+   context->peerConfig.vjComp = FALSE;
+   context->peerConfig.vjMaxSlotId = 0;
+   context->peerConfig.vjCompSlotId = FALSE;
+#endif
 #endif
 
 #if (IPV6_SUPPORT == ENABLED)
@@ -893,18 +974,33 @@ void pppProcessFrame(NetInterface *interface, uint8_t *frame, size_t length)
    //Point to the PPP context
    context = interface->pppContext;
 
+   //Total number of octets received on the interface
+   MIB2_INC_COUNTER32(interface->mibIfEntry->ifInOctets, length);
+
    //Check the length of the PPP frame
    if(length < PPP_FCS_SIZE)
+   {
+      //Number of inbound packets that contained errors
+      MIB2_INC_COUNTER32(interface->mibIfEntry->ifInErrors, 1);
+      //Discard the received frame
       return;
+   }
 
    //Debug message
    TRACE_DEBUG("PPP frame received (%" PRIuSIZE " bytes)...\r\n", length);
 
    //The value of the residue is 0x0F47 when no FCS errors are detected
-   if(pppCalcFcs(frame, length) != 0x0F47)
+   //(the driver may have checked it while removing the octet stuffing)
+   if(!interface->nicDriver->autoCrcVerif && pppCalcFcs(frame, length) != 0x0F47)
    {
       //Debug message
       TRACE_WARNING("Wrong FCS detected!\r\n");
+      //Number of inbound packets that contained errors
+      MIB2_INC_COUNTER32(interface->mibIfEntry->ifInErrors, 1);
+#if (IPV4_SUPPORT == ENABLED && PPP_VJ_SUPPORT == ENABLED)
+      //The decompressor must not apply the next differences
+      pppVjRxError(context);
+#endif
       //Drop the received frame
       return;
    }
@@ -942,6 +1038,27 @@ void pppProcessFrame(NetInterface *interface, uint8_t *frame, size_t length)
       //Process incoming IPv4 packet
       ipv4ProcessPacket(interface, (Ipv4Header *) frame, length);
       break;
+#if (PPP_VJ_SUPPORT == ENABLED)
+   //Van Jacobson compressed or uncompressed TCP/IP?
+   case PPP_PROTOCOL_VJ_COMP:
+   case PPP_PROTOCOL_VJ_UNCOMP:
+      //The peer may only use the compression it has acknowledged
+      if(context->localConfig.vjComp && !context->localConfig.vjCompRejected)
+      {
+         //Rebuild the IPv4 datagram from the state of the connection
+         if(!pppVjDecompress(context, protocol, &frame, &length))
+         {
+            //Process incoming IPv4 packet
+            ipv4ProcessPacket(interface, (Ipv4Header *) frame, length);
+         }
+      }
+      else
+      {
+         //The peer is attempting to use a protocol which is unsupported
+         lcpProcessUnknownProtocol(context, protocol, frame, length);
+      }
+      break;
+#endif
 #endif
 
 #if (IPV6_SUPPORT == ENABLED)
@@ -1010,6 +1127,12 @@ error_t pppSendFrame(NetInterface *interface,
    //Point to the PPP context
    context = interface->pppContext;
 
+#if (IPV4_SUPPORT == ENABLED && PPP_VJ_SUPPORT == ENABLED)
+   //Compress the TCP/IP headers if the peer asked for it
+   if(protocol == PPP_PROTOCOL_IP && context->peerConfig.vjComp)
+      protocol = pppVjCompress(context, buffer, &offset);
+#endif
+
    //Check whether the Protocol field can be compressed
    if(context->peerConfig.pfc && MSB(protocol) == 0)
    {
@@ -1066,19 +1189,26 @@ error_t pppSendFrame(NetInterface *interface,
    //Retrieve the length of the frame
    length = netBufferGetLength(buffer) - offset;
 
-   //Compute FCS over the header and payload
-   fcs = pppCalcFcsEx(buffer, offset, length);
-   //The FCS is transmitted least significant octet first
-   fcs = htole16(fcs);
-
-   //Append the calculated FCS value
-   error = netBufferAppend(buffer, &fcs, PPP_FCS_SIZE);
-   //Any error to report?
-   if(error) return error;
+   //The driver may calculate the FCS while stuffing the frame
+   if(!interface->nicDriver->autoCrcCalc)
+   {
+      //Compute FCS over the header and payload
+      fcs = pppCalcFcsEx(buffer, offset, length);
+      //The FCS is transmitted least significant octet first
+      fcs = htole16(fcs);
+
+      //Append the calculated FCS value
+      error = netBufferAppend(buffer, &fcs, PPP_FCS_SIZE);
+      //Any error to report?
+      if(error) return error;
+   }
 
    //Adjust frame length
    length += PPP_FCS_SIZE;
 
+   //Total number of octets transmitted out of the interface
+   MIB2_INC_COUNTER32(interface->mibIfEntry->ifOutOctets, length);
+
    //Debug message
    TRACE_DEBUG("Sending PPP frame (%" PRIuSIZE " bytes)...\r\n", length);
    TRACE_DEBUG("  Protocol = 0x%04" PRIX16 "\r\n", protocol);
@@ -1173,21 +1303,8 @@ size_t pppParseFrameHeader(const uint8_t *frame, size_t length, uint16_t *protoc
 
 uint16_t pppCalcFcs(const uint8_t *data, size_t length)
 {
-   size_t i;
-   uint16_t fcs;
-
-   //FCS preset value
-   fcs = 0xFFFF;
-
-   //Loop through data
-   for(i = 0; i < length; i++)
-   {
-      //The message is processed byte by byte
-      fcs = (fcs >> 8) ^ fcsTable[(fcs & 0xFF) ^ data[i]];
-   }
-
-   //Return 1's complement value
-   return ~fcs;
+   //Table driven FCS-16 (RFC 1662)
+   return crc16FcsCalc(data, length);
 }
 
 
@@ -1206,8 +1323,8 @@ uint16_t pppCalcFcsEx(const NetBuffer *buffer, size_t offset, size_t length)
    uint16_t fcs;
    uint8_t *p;
 
-   //FCS preset value
-   fcs = 0xFFFF;
+   //Start from an empty message
+   fcs = 0;
 
    //Loop through data chunks
    for(i = 0; i < buffer->chunkCount && length > 0; i++)
@@ -1223,15 +1340,7 @@ uint16_t pppCalcFcsEx(const NetBuffer *buffer, size_t offset, size_t length)
          length -= n;
 
          //Process current chunk
-         while(n > 0)
-         {
-            //The message is processed byte by byte
-            fcs = (fcs >> 8) ^ fcsTable[(fcs & 0xFF) ^ *p];
-
-            //Next byte
-            p++;
-            n--;
-         }
+         fcs = crc16FcsUpdate(fcs, p, n);
 
          //Process the next block from the start
          offset = 0;
@@ -1243,8 +1352,8 @@ uint16_t pppCalcFcsEx(const NetBuffer *buffer, size_t offset, size_t length)
       }
    }
 
-   //Return 1's complement value
-   return ~fcs;
+   //Return FCS value
+   return fcs;
 }
 
 
@@ -39,6 +39,7 @@ struct _PppContext;
 #include "core/net.h"
 #include "ppp/pap.h"
 #include "ppp/chap.h"
+#include "ppp/ppp_vj.h"
 
 //PPP support
 #ifndef PPP_SUPPORT
@@ -189,14 +190,16 @@ typedef enum
 
 typedef enum
 {
-   PPP_PROTOCOL_IP     = 0x0021, ///<Internet Protocol
-   PPP_PROTOCOL_IPV6   = 0x0057, ///<Internet Protocol version 6
-   PPP_PROTOCOL_IPCP   = 0x8021, ///<IP Control Protocol
-   PPP_PROTOCOL_IPV6CP = 0x8057, ///<IPv6 Control Protocol
-   PPP_PROTOCOL_LCP    = 0xC021, ///<Link Control Protocol
-   PPP_PROTOCOL_PAP    = 0xC023, ///<Password Authentication Protocol
-   PPP_PROTOCOL_LQR    = 0xC025, ///<Link Quality Report
-   PPP_PROTOCOL_CHAP   = 0xC223  ///<Challenge Handshake Authentication Protocol
+   PPP_PROTOCOL_IP        = 0x0021, ///<Internet Protocol
+   PPP_PROTOCOL_VJ_COMP   = 0x002D, ///<Van Jacobson Compressed TCP/IP
+   PPP_PROTOCOL_VJ_UNCOMP = 0x002F, ///<Van Jacobson Uncompressed TCP/IP
+   PPP_PROTOCOL_IPV6      = 0x0057, ///<Internet Protocol version 6
+   PPP_PROTOCOL_IPCP      = 0x8021, ///<IP Control Protocol
+   PPP_PROTOCOL_IPV6CP    = 0x8057, ///<IPv6 Control Protocol
+   PPP_PROTOCOL_LCP       = 0xC021, ///<Link Control Protocol
+   PPP_PROTOCOL_PAP       = 0xC023, ///<Password Authentication Protocol
+   PPP_PROTOCOL_LQR       = 0xC025, ///<Link Quality Report
+   PPP_PROTOCOL_CHAP      = 0xC223  ///<Challenge Handshake Authentication Protocol
 } PppProtocol;
 
 
@@ -421,6 +424,12 @@ typedef struct
    bool_t primaryDnsRejected;
    Ipv4Addr secondaryDns;
    bool_t secondaryDnsRejected;
+#if (PPP_VJ_SUPPORT == ENABLED)
+   bool_t vjComp;
+   bool_t vjCompRejected;
+   uint8_t vjMaxSlotId;
+   bool_t vjCompSlotId;
+#endif
 #endif
 #if (IPV6_SUPPORT == ENABLED)
    Eui64 interfaceId;
@@ -464,6 +473,9 @@ struct _PppContext
    PppConfig peerConfig;    ///<Peer configuration options
    bool_t ipRejected;       ///<IPv4 protocol is not supported by the peer
    bool_t ipv6Rejected;     ///<IPv6 protocol is not support by the peer
+#if (IPV4_SUPPORT == ENABLED && PPP_VJ_SUPPORT == ENABLED)
+   PppVjContext vjContext;  ///<VJ TCP/IP header compression
+#endif
 
    uint8_t frame[PPP_MAX_FRAME_SIZE]; ///<Incoming PPP frame
 
@@ -471,12 +483,16 @@ struct _PppContext
    uint_t txBufferLen;
    uint_t txWriteIndex;
    uint_t txReadIndex;
+   uint8_t txCharMap[256];  ///<Characters to be escaped on transmission
+   uint32_t txCharMapAccm;  ///<ACCM the transmit map was built for
 
    uint8_t rxBuffer[PPP_RX_BUFFER_SIZE]; ///<Receive buffer
    uint_t rxBufferLen;
    uint_t rxWriteIndex;
    uint_t rxReadIndex;
    uint_t rxFrameCount;
+   uint8_t rxCharMap[256];  ///<Class of each received character
+   uint32_t rxCharMapAccm;  ///<ACCM the receive map was built for
 };
 
 
@@ -496,6 +512,8 @@ bool_t pppCheckPassword(NetInterface *interface, const char_t *password);
 
 error_t pppSendAtCommand(NetInterface *interface, const char_t *data);
 error_t pppReceiveAtCommand(NetInterface *interface, char_t *data, size_t size);
+error_t pppWriteAtCommand(NetInterface *interface, const char_t *data);
+error_t pppReadAtCommand(NetInterface *interface, char_t *data, size_t size);
 
 error_t pppConnect(NetInterface *interface);
 error_t pppClose(NetInterface *interface);
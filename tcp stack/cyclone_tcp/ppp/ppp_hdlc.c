@@ -34,11 +34,24 @@
 #include "core/net.h"
 #include "ppp/ppp.h"
 #include "ppp/ppp_hdlc.h"
+#include "crc.h"
 #include "debug.h"
 
 //Check TCP/IP stack configuration
 #if (PPP_SUPPORT == ENABLED)
 
+//Character classes of the receive map
+#define PPP_HDLC_CHAR_DATA    0
+#define PPP_HDLC_CHAR_IGNORED 1
+#define PPP_HDLC_CHAR_ESC     2
+#define PPP_HDLC_CHAR_FLAG    3
+
+//Forward declaration of functions
+static void pppHdlcDriverBuildTxCharMap(PppContext *context, uint32_t accm);
+static void pppHdlcDriverBuildRxCharMap(PppContext *context, uint32_t accm);
+static uint_t pppHdlcDriverCopyTxQueue(PppContext *context, uint_t index,
+   const uint8_t *data, size_t length);
+
 
 /**
  * @brief PPP HDLC driver
@@ -59,8 +72,8 @@ const NicDriver pppHdlcDriver =
    NULL,
    NULL,
    FALSE,
-   FALSE,
-   FALSE,
+   TRUE,
+   TRUE,
    FALSE
 };
 
@@ -90,6 +103,10 @@ error_t pppHdlcDriverInit(NetInterface *interface)
    context->rxReadIndex = 0;
    context->rxFrameCount = 0;
 
+   //Character maps for the default ACCM
+   pppHdlcDriverBuildTxCharMap(context, PPP_DEFAULT_ACCM);
+   pppHdlcDriverBuildRxCharMap(context, PPP_DEFAULT_ACCM);
+
    //Initialize UART
    interface->uartDriver->init();
 
@@ -172,6 +189,13 @@ void pppHdlcDriverEventHandler(NetInterface *interface)
 
 /**
  * @brief Send a packet
+ *
+ * The frame is escaped straight into the TX queue, chunk by chunk. The FCS
+ * is calculated over the whole chunk first, then the chunk is escaped run by
+ * run: runs of characters that need no escaping are copied as a block. The
+ * FCS is escaped and appended after the last chunk, and the length of the
+ * queue is updated once
+ *
  * @param[in] interface Underlying network interface
  * @param[in] buffer Multi-part buffer containing the data to send
  * @param[in] offset Offset to the first data byte
@@ -182,11 +206,17 @@ error_t pppHdlcDriverSendPacket(NetInterface *interface,
    const NetBuffer *buffer, size_t offset)
 {
    uint_t i;
+   uint_t k;
    size_t j;
+   size_t m;
    size_t n;
+   size_t length;
    uint8_t *p;
+   uint8_t c[2];
+   uint16_t fcs;
    uint16_t protocol;
    uint32_t accm;
+   const uint8_t *map;
    PppContext *context;
 
    //Point to the PPP context
@@ -199,7 +229,8 @@ error_t pppHdlcDriverSendPacket(NetInterface *interface,
    pppParseFrameHeader(p, PPP_FRAME_HEADER_SIZE, &protocol);
 
    //Check Protocol field
-   if(protocol == PPP_PROTOCOL_IP || protocol == PPP_PROTOCOL_IPV6)
+   if(protocol == PPP_PROTOCOL_IP || protocol == PPP_PROTOCOL_IPV6 ||
+      protocol == PPP_PROTOCOL_VJ_COMP || protocol == PPP_PROTOCOL_VJ_UNCOMP)
    {
       //Use the ACCM value that has been negotiated
       accm = context->peerConfig.accm;
@@ -210,8 +241,23 @@ error_t pppHdlcDriverSendPacket(NetInterface *interface,
       accm = PPP_DEFAULT_ACCM;
    }
 
+   //The map is rebuilt only when the ACCM changes
+   if(accm != context->txCharMapAccm)
+      pppHdlcDriverBuildTxCharMap(context, accm);
+
+   //Point to the escape map
+   map = context->txCharMap;
+
+   //The queue is written from the current write index, the data becomes
+   //visible to the transmitter when the length is updated
+   k = context->txWriteIndex;
+   length = 0;
+   fcs = 0;
+
    //Send flag
-   pppHdlcDriverWriteTxQueue(context, PPP_FLAG_CHAR);
+   context->txBuffer[k] = PPP_FLAG_CHAR;
+   k = (k + 1) % PPP_TX_BUFFER_SIZE;
+   length++;
 
    //Loop through data chunks
    for(i = 0; i < buffer->chunkCount; i++)
@@ -224,32 +270,31 @@ error_t pppHdlcDriverSendPacket(NetInterface *interface,
          //Compute the number of bytes to copy at a time
          n = buffer->chunk[i].length - offset;
 
-         //Copy data to TX queue
-         for(j = 0; j < n; j++)
+         //The FCS is calculated over the whole chunk first
+         fcs = crc16FcsUpdate(fcs, p, n);
+
+         //Then the chunk is escaped run by run
+         for(j = 0; j < n; j = m)
          {
-            if(p[j] < PPP_MASK_CHAR)
-            {
-                //Check whether the character is flagged
-               if(accm & (1 << p[j]))
-               {
-                  pppHdlcDriverWriteTxQueue(context, PPP_ESC_CHAR);
-                  pppHdlcDriverWriteTxQueue(context, p[j] ^ PPP_MASK_CHAR);
-               }
-               else
-               {
-                  //Enqueue current character
-                  pppHdlcDriverWriteTxQueue(context, p[j]);
-               }
-            }
-            else if(p[j] == PPP_ESC_CHAR || p[j] == PPP_FLAG_CHAR)
+            //Find the end of the run of characters sent as is
+            for(m = j; m < n && !map[p[m]]; m++);
+
+            //Copy the run to the TX queue
+            if(m > j)
             {
-               pppHdlcDriverWriteTxQueue(context, PPP_ESC_CHAR);
-               pppHdlcDriverWriteTxQueue(context, p[j] ^ PPP_MASK_CHAR);
+               k = pppHdlcDriverCopyTxQueue(context, k, p + j, m - j);
+               length += m - j;
             }
-            else
+
+            //The run ends with a character to be escaped
+            if(m < n)
             {
-               //Enqueue current character
-               pppHdlcDriverWriteTxQueue(context, p[j]);
+               context->txBuffer[k] = PPP_ESC_CHAR;
+               k = (k + 1) % PPP_TX_BUFFER_SIZE;
+               context->txBuffer[k] = p[m] ^ PPP_MASK_CHAR;
+               k = (k + 1) % PPP_TX_BUFFER_SIZE;
+               length += 2;
+               m++;
             }
          }
 
@@ -263,8 +308,43 @@ error_t pppHdlcDriverSendPacket(NetInterface *interface,
       }
    }
 
+   //The FCS is transmitted least significant octet first
+   c[0] = LSB(fcs);
+   c[1] = MSB(fcs);
+
+   //The FCS is escaped like the data
+   for(j = 0; j < 2; j++)
+   {
+      if(map[c[j]])
+      {
+         context->txBuffer[k] = PPP_ESC_CHAR;
+         k = (k + 1) % PPP_TX_BUFFER_SIZE;
+         context->txBuffer[k] = c[j] ^ PPP_MASK_CHAR;
+         length += 2;
+      }
+      else
+      {
+         context->txBuffer[k] = c[j];
+         length++;
+      }
+
+      k = (k + 1) % PPP_TX_BUFFER_SIZE;
+   }
+
    //Send flag
-   pppHdlcDriverWriteTxQueue(context, PPP_FLAG_CHAR);
+   context->txBuffer[k] = PPP_FLAG_CHAR;
+   k = (k + 1) % PPP_TX_BUFFER_SIZE;
+   length++;
+
+   //Advance write index
+   context->txWriteIndex = k;
+
+   //Enter critical section
+   __disable_irq();
+   //Update the length of the queue
+   context->txBufferLen += length;
+   //Exit critical section
+   __enable_irq();
 
    //Start transferring data
    interface->uartDriver->startTx();
@@ -283,79 +363,156 @@ error_t pppHdlcDriverSendPacket(NetInterface *interface,
 
 /**
  * @brief Receive a packet
+ *
+ * The RX queue is decoded up to the next flag, one contiguous part of the
+ * ring at a time: runs of ordinary characters are copied as a block, then
+ * the FCS is calculated over the data decoded from that part. Frames with a
+ * wrong FCS are dropped here
+ *
  * @param[in] interface Underlying network interface
  * @return Error code
  **/
 
 error_t pppHdlcDriverReceivePacket(NetInterface *interface)
 {
+   size_t i;
+   size_t j;
+   size_t k;
+   size_t m;
    size_t n;
+   size_t length;
+   size_t checked;
+   size_t consumed;
    uint8_t c;
+   uint16_t fcs;
    bool_t escFlag;
-   uint32_t accm;
+   bool_t endFlag;
+   const uint8_t *p;
+   const uint8_t *map;
    PppContext *context;
 
    //Point to the PPP context
    context = interface->pppContext;
-   //Retrieve ACCM
-   accm = context->localConfig.accm;
+
+   //The map is rebuilt only when the ACCM changes
+   if(context->localConfig.accm != context->rxCharMapAccm)
+      pppHdlcDriverBuildRxCharMap(context, context->localConfig.accm);
+
+   //Point to the character map
+   map = context->rxCharMap;
+
+   //Number of characters pending in the receive buffer
+   length = context->rxBufferLen;
 
    //Length of the original PPP frame
    n = 0;
+   fcs = 0;
+   checked = 0;
+   consumed = 0;
    //This flag tells whether the next character is escaped
    escFlag = FALSE;
+   //This flag is set when the closing flag is reached
+   endFlag = FALSE;
 
    //The receiver must reverse the octet stuffing procedure
-   while(n < PPP_MAX_FRAME_SIZE && context->rxBufferLen > 0)
+   while(consumed < length && !endFlag)
    {
-      //Read a single character
-      c = pppHdlcDriverReadRxQueue(context);
+      //Contiguous data up to the end of the buffer
+      i = (context->rxReadIndex + consumed) % PPP_RX_BUFFER_SIZE;
+      p = context->rxBuffer + i;
+      m = MIN(length - consumed, PPP_RX_BUFFER_SIZE - i);
 
-      if(c < PPP_MASK_CHAR)
+      //Process the block run by run
+      for(j = 0; j < m && !endFlag; )
       {
-         //Check whether the character is flagged
-         if(accm & (1 << c))
+         //Read current character
+         c = p[j];
+
+         //Check the class of the character
+         if(map[c] == PPP_HDLC_CHAR_DATA)
          {
-            //The extra characters must be removed from the incoming data stream
+            //Escaped character?
+            if(escFlag)
+            {
+               //The character is XOR'ed with 0x20
+               if(n < PPP_MAX_FRAME_SIZE)
+                  context->frame[n++] = c ^ PPP_MASK_CHAR;
+
+               escFlag = FALSE;
+               j++;
+            }
+            else
+            {
+               //Find the end of the run of ordinary characters
+               for(i = j + 1; i < m && map[p[i]] == PPP_HDLC_CHAR_DATA; i++);
+
+               //The excess of an oversized frame is dropped
+               k = MIN(i - j, PPP_MAX_FRAME_SIZE - n);
+
+               //Copy the run
+               memcpy(context->frame + n, p + j, k);
+               n += k;
+
+               j = i;
+            }
+         }
+         else if(map[c] == PPP_HDLC_CHAR_ESC)
+         {
+            //All occurrences of 0x7D indicate that the next character is escaped
+            escFlag = TRUE;
+            j++;
+         }
+         else if(map[c] == PPP_HDLC_CHAR_FLAG)
+         {
+            //0x7E flag found
+            endFlag = TRUE;
+            j++;
          }
          else
          {
-            //Copy current character
-            context->frame[n++] = c;
+            //The extra characters must be removed from the incoming data stream
+            j++;
          }
       }
-      else if(c == PPP_ESC_CHAR)
-      {
-         //All occurrences of 0x7D indicate that the next character is escaped
-         escFlag = TRUE;
-      }
-      else if(c == PPP_FLAG_CHAR)
-      {
-         //0x7E flag found
-         break;
-      }
-      else if(escFlag)
-      {
-         //The character is XOR'ed with 0x20
-         context->frame[n++] = c ^ PPP_MASK_CHAR;
-         escFlag = FALSE;
-      }
-      else
-      {
-         //Copy current character
-         context->frame[n++] = c;
-      }
+
+      //Number of characters processed
+      consumed += j;
+
+      //The FCS is then calculated over the data decoded from the segment
+      fcs = crc16FcsUpdate(fcs, context->frame + checked, n - checked);
+      checked = n;
    }
 
+   //Advance read index
+   context->rxReadIndex = (context->rxReadIndex + consumed) % PPP_RX_BUFFER_SIZE;
+
+   //Enter critical section
+   __disable_irq();
+   //Update the length of the RX buffer
+   context->rxBufferLen -= consumed;
+   //Exit critical section
+   __enable_irq();
+
    //Check whether a valid PPP frame has been received
    if(n > 0)
    {
-      //Debug message
-      TRACE_DEBUG("PPP frame received (%" PRIuSIZE " bytes)...\r\n", n);
-      TRACE_DEBUG_ARRAY("  ", context->frame, n);
-
-      //Pass the packet to the upper layer
-      nicProcessPacket(interface, context->frame, n);
+      //The value of the residue is 0x0F47 when no FCS errors are detected
+      if(n >= PPP_FCS_SIZE && fcs == 0x0F47)
+      {
+         //Pass the packet to the upper layer
+         nicProcessPacket(interface, context->frame, n);
+      }
+      else
+      {
+         //Debug message
+         TRACE_WARNING("Wrong FCS detected!\r\n");
+         //Number of inbound packets that contained errors
+         MIB2_INC_COUNTER32(interface->mibIfEntry->ifInErrors, 1);
+#if (IPV4_SUPPORT == ENABLED && PPP_VJ_SUPPORT == ENABLED)
+         //The decompressor must not apply the next differences
+         pppVjRxError(context);
+#endif
+      }
    }
 
    //Successful read operation
@@ -385,15 +542,25 @@ error_t pppHdlcDriverSetMulticastFilter(NetInterface *interface)
 
 error_t pppHdlcDriverSendAtCommand(NetInterface *interface, const char_t *data)
 {
-   size_t i;
+   size_t n;
    PppContext *context;
 
    //Point to the PPP context
    context = interface->pppContext;
 
-   //Send AT command
-   for(i = 0; data[i] != '\0' && i < 3006; i++)
-      pppHdlcDriverWriteTxQueue(context, data[i]);
+   //Length of the AT command
+   n = MIN(strlen(data), 3006);
+
+   //Copy the AT command to the TX queue
+   context->txWriteIndex = pppHdlcDriverCopyTxQueue(context,
+      context->txWriteIndex, (const uint8_t *) data, n);
+
+   //Enter critical section
+   __disable_irq();
+   //Update the length of the queue
+   context->txBufferLen += n;
+   //Exit critical section
+   __enable_irq();
 
    //Start transferring data
    interface->uartDriver->startTx();
@@ -597,6 +764,89 @@ uint8_t pppHdlcDriverReadRxQueue(PppContext *context)
 }
 
 
+/**
+ * @brief Build the map of the characters to be escaped on transmission
+ * @param[in] context Pointer to the PPP context
+ * @param[in] accm Async-Control-Character-Map
+ **/
+
+static void pppHdlcDriverBuildTxCharMap(PppContext *context, uint32_t accm)
+{
+   uint_t i;
+
+   //Control characters are escaped when flagged in the ACCM
+   for(i = 0; i < PPP_MASK_CHAR; i++)
+      context->txCharMap[i] = (accm & (1 << i)) ? 1 : 0;
+
+   //Other characters are sent as is
+   for(i = PPP_MASK_CHAR; i < 256; i++)
+      context->txCharMap[i] = 0;
+
+   //The flag and escape characters are always escaped
+   context->txCharMap[PPP_ESC_CHAR] = 1;
+   context->txCharMap[PPP_FLAG_CHAR] = 1;
+
+   //Save the ACCM the map was built for
+   context->txCharMapAccm = accm;
+}
+
+
+/**
+ * @brief Build the map of the classes of the received characters
+ * @param[in] context Pointer to the PPP context
+ * @param[in] accm Async-Control-Character-Map
+ **/
+
+static void pppHdlcDriverBuildRxCharMap(PppContext *context, uint32_t accm)
+{
+   uint_t i;
+
+   //Control characters flagged in the ACCM are inserted by the link
+   for(i = 0; i < PPP_MASK_CHAR; i++)
+      context->rxCharMap[i] = (accm & (1 << i)) ? PPP_HDLC_CHAR_IGNORED : PPP_HDLC_CHAR_DATA;
+
+   //Other characters are data
+   for(i = PPP_MASK_CHAR; i < 256; i++)
+      context->rxCharMap[i] = PPP_HDLC_CHAR_DATA;
+
+   //Escape and flag characters
+   context->rxCharMap[PPP_ESC_CHAR] = PPP_HDLC_CHAR_ESC;
+   context->rxCharMap[PPP_FLAG_CHAR] = PPP_HDLC_CHAR_FLAG;
+
+   //Save the ACCM the map was built for
+   context->rxCharMapAccm = accm;
+}
+
+
+/**
+ * @brief Copy a block of characters to the TX queue
+ *
+ * The length of the queue is left unchanged, the caller makes the
+ * characters visible to the transmitter once the whole frame is written
+ *
+ * @param[in] context Pointer to the PPP context
+ * @param[in] index Position in the TX queue where to write the data
+ * @param[in] data Characters to be written
+ * @param[in] length Number of characters to write
+ * @return Position in the TX queue following the data
+ **/
+
+static uint_t pppHdlcDriverCopyTxQueue(PppContext *context, uint_t index,
+   const uint8_t *data, size_t length)
+{
+   size_t n;
+
+   //Copy the data up to the end of the buffer
+   n = MIN(length, PPP_TX_BUFFER_SIZE - index);
+   memcpy(context->txBuffer + index, data, n);
+   //Wrap around if necessary
+   memcpy(context->txBuffer, data + n, length - n);
+
+   //Return the position following the data
+   return (index + length) % PPP_TX_BUFFER_SIZE;
+}
+
+
 /**
  * @brief Read TX queue
  * @param[in] interface Underlying network interface
@@ -695,5 +945,135 @@ bool_t pppHdlcDriverWriteRxQueue(NetInterface *interface, uint8_t c)
    return flag;
 }
 
+
+/**
+ * @brief Get the data at the head of the TX queue
+ *
+ * The data stays in the queue until pppHdlcDriverReleaseTxBlock is called,
+ * so that a DMA channel can read it in place
+ *
+ * @param[in] interface Underlying network interface
+ * @param[out] data Pointer to the first pending byte
+ * @return Number of contiguous bytes pending (0 if the TX queue is empty)
+ **/
+
+size_t pppHdlcDriverGetTxBlock(NetInterface *interface, const uint8_t **data)
+{
+   PppContext *context;
+
+   //Point to the PPP context
+   context = interface->pppContext;
+
+   //Point to the first pending byte
+   *data = context->txBuffer + context->txReadIndex;
+
+   //The block ends at the end of the queue or where the buffer wraps around
+   return MIN(context->txBufferLen, PPP_TX_BUFFER_SIZE - context->txReadIndex);
+}
+
+
+/**
+ * @brief Remove sent data from the TX queue
+ * @param[in] interface Underlying network interface
+ * @param[in] length Number of bytes sent
+ * @return TRUE if a context switch is required
+ **/
+
+bool_t pppHdlcDriverReleaseTxBlock(NetInterface *interface, size_t length)
+{
+   bool_t flag;
+   PppContext *context;
+
+   //Point to the PPP context
+   context = interface->pppContext;
+   //This flag will be set if a higher priority task must be woken
+   flag = FALSE;
+
+   //The queue may have been purged in the meantime
+   length = MIN(length, context->txBufferLen);
+
+   //Any data to remove?
+   if(length > 0)
+   {
+      //Advance read index and wrap around if necessary
+      context->txReadIndex = (context->txReadIndex + length) % PPP_TX_BUFFER_SIZE;
+
+      //Check whether the TX queue becomes available for writing
+      if(context->txBufferLen > (PPP_TX_BUFFER_SIZE - 3006) &&
+         (context->txBufferLen - length) <= (PPP_TX_BUFFER_SIZE - 3006))
+      {
+         flag = osSetEventFromIsr(&interface->nicTxEvent);
+      }
+
+      //Update the length of the queue
+      context->txBufferLen -= length;
+   }
+
+   //The return value tells whether a context switch is required
+   return flag;
+}
+
+
+/**
+ * @brief Write a block of received data to the RX queue
+ * @param[in] interface Underlying network interface
+ * @param[in] data Received data
+ * @param[in] length Number of bytes received
+ * @return TRUE if a context switch is required
+ **/
+
+bool_t pppHdlcDriverWriteRxBlock(NetInterface *interface, const uint8_t *data, size_t length)
+{
+   size_t i;
+   size_t n;
+   uint_t flagCount;
+   bool_t flag;
+   PppContext *context;
+
+   //Point to the PPP context
+   context = interface->pppContext;
+   //This flag will be set if a higher priority task must be woken
+   flag = FALSE;
+
+   //The data that does not fit in the RX queue is dropped
+   length = MIN(length, PPP_RX_BUFFER_SIZE - context->rxBufferLen);
+
+   //Copy the data up to the end of the buffer
+   n = MIN(length, PPP_RX_BUFFER_SIZE - context->rxWriteIndex);
+   memcpy(context->rxBuffer + context->rxWriteIndex, data, n);
+   //Wrap around if necessary
+   memcpy(context->rxBuffer, data + n, length - n);
+
+   //Advance write index
+   context->rxWriteIndex = (context->rxWriteIndex + length) % PPP_RX_BUFFER_SIZE;
+   //Update the length of the queue
+   context->rxBufferLen += length;
+
+   //Check PPP connection state
+   if(interface->pppContext->pppPhase != PPP_PHASE_DEAD)
+   {
+      //Each 0x7E flag ends a frame
+      for(flagCount = 0, i = 0; i < length; i++)
+      {
+         if(data[i] == PPP_FLAG_CHAR)
+            flagCount++;
+      }
+
+      //Complete HDLC frames received?
+      if(flagCount > 0)
+      {
+         //Update frame counter
+         context->rxFrameCount += flagCount;
+
+         //Notify the TCP/IP stack of the event
+         interface->nicEvent = TRUE;
+         flag = osSetEventFromIsr(&netEvent);
+      }
+   }
+
+   //The return value tells whether a context switch is required
+   return flag;
+}
+
 #endif
 
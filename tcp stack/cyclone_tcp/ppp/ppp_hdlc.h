@@ -63,4 +63,8 @@ uint8_t pppHdlcDriverReadRxQueue(PppContext *context);
 bool_t pppHdlcDriverReadTxQueue(NetInterface *interface, int_t *c);
 bool_t pppHdlcDriverWriteRxQueue(NetInterface *interface, uint8_t c);
 
+size_t pppHdlcDriverGetTxBlock(NetInterface *interface, const uint8_t **data);
+bool_t pppHdlcDriverReleaseTxBlock(NetInterface *interface, size_t length);
+bool_t pppHdlcDriverWriteRxBlock(NetInterface *interface, const uint8_t *data, size_t length);
+
 #endif
@@ -0,0 +1,731 @@
+/**
+ * @file ppp_vj.c
+ * @brief Van Jacobson TCP/IP header compression (RFC 1144)
+ *
+ * @section License
+ *
+ * Copyright (C) 2010-2016 Oryx Embedded SARL. All rights reserved.
+ *
+ * This file is part of CycloneTCP Open.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * @section Description
+ *
+ * Each end of the link keeps the IP and TCP headers of the last packet of
+ * every connection in a slot. Once a connection has been sent with its full
+ * header, its next packets only carry the fields that changed, coded as
+ * small differences: 3 to 5 bytes instead of 40 for a typical segment.
+ * Refer to RFC 1144 for more details
+ *
+ * @author Oryx Embedded SARL (www.oryx-embedded.com)
+ * @version 1.7.5b
+ **/
+
+//Switch to the appropriate trace level
+#define TRACE_LEVEL PPP_TRACE_LEVEL
+
+//Dependencies
+#include "core/net.h"
+#include "core/tcp.h"
+#include "ipv4/ipv4.h"
+#include "ppp/ppp.h"
+#include "ppp/ppp_vj.h"
+#include "debug.h"
+
+//Check TCP/IP stack configuration
+#if (PPP_SUPPORT == ENABLED && IPV4_SUPPORT == ENABLED && PPP_VJ_SUPPORT == ENABLED)
+
+//Forward declaration of functions
+static uint8_t *pppVjEncode(uint8_t *p, uint16_t value, bool_t zero);
+static error_t pppVjDecode(const uint8_t **p, const uint8_t *end, uint16_t *value);
+
+
+/**
+ * @brief Reset the compressor and the decompressor
+ * @param[in] context PPP context
+ * @param[in] maxSlotId Highest slot ID the peer can decompress
+ * @param[in] compSlotId The peer accepts packets without slot ID
+ **/
+
+void pppVjInit(PppContext *context, uint_t maxSlotId, bool_t compSlotId)
+{
+   uint_t i;
+   PppVjContext *vjContext;
+
+   //Point to the VJ compression context
+   vjContext = &context->vjContext;
+
+   //Forget all the connections
+   for(i = 0; i < PPP_VJ_MAX_SLOTS; i++)
+   {
+      vjContext->txSlot[i].valid = FALSE;
+      vjContext->rxSlot[i].valid = FALSE;
+   }
+
+   //The compressor cannot use more slots than the peer holds
+   vjContext->txSlotCount = MIN(maxSlotId + 1, PPP_VJ_MAX_SLOTS);
+   vjContext->txCompSlotId = compSlotId;
+   //The first compressed packet carries its slot ID
+   vjContext->txLastSlot = PPP_VJ_MAX_SLOTS;
+   vjContext->txClock = 0;
+
+   //Compressed packets are discarded until a slot is known
+   vjContext->rxLastSlot = 0;
+   vjContext->rxToss = TRUE;
+}
+
+
+/**
+ * @brief Compress the header of an outgoing IP datagram
+ *
+ * The compressed header is written in place, just before the TCP data, and
+ * the offset is moved to it. An uncompressed TCP packet carries the slot ID
+ * in the Protocol field of its IP header
+ *
+ * @param[in] context PPP context
+ * @param[in] buffer Multi-part buffer containing the IP datagram
+ * @param[in,out] offset Offset to the first byte of the datagram
+ * @return PPP protocol to send the datagram with
+ **/
+
+uint16_t pppVjCompress(PppContext *context, NetBuffer *buffer, size_t *offset)
+{
+   uint_t i;
+   uint_t k;
+   size_t n;
+   size_t length;
+   size_t headerLen;
+   size_t ipHeaderLen;
+   uint8_t changes;
+   uint8_t delta[16];
+   uint8_t *p;
+   uint16_t checksum;
+   uint16_t deltaW;
+   uint16_t deltaId;
+   uint32_t deltaA;
+   uint32_t deltaS;
+   Ipv4Header *ipHeader;
+   Ipv4Header *oldIpHeader;
+   TcpHeader *tcpHeader;
+   TcpHeader *oldTcpHeader;
+   PppVjContext *vjContext;
+   PppVjSlot *slot;
+
+   //Point to the VJ compression context
+   vjContext = &context->vjContext;
+
+   //Total length of the datagram
+   length = netBufferGetLength(buffer) - *offset;
+
+   //Number of contiguous bytes at the start of the datagram
+   for(n = *offset, i = 0; i < buffer->chunkCount; i++)
+   {
+      if(n < buffer->chunk[i].length)
+         break;
+      n -= buffer->chunk[i].length;
+   }
+
+   //Malformed buffer?
+   if(i >= buffer->chunkCount)
+      return PPP_PROTOCOL_IP;
+
+   //Point to the IP header
+   ipHeader = (Ipv4Header *) ((uint8_t *) buffer->chunk[i].address + n);
+   n = buffer->chunk[i].length - n;
+
+   //Only TCP segments are compressed
+   if(n < sizeof(Ipv4Header) || ipHeader->protocol != IPV4_PROTOCOL_TCP)
+      return PPP_PROTOCOL_IP;
+   //Fragments are sent as is
+   if(ntohs(ipHeader->fragmentOffset) & (IPV4_FLAG_MF | IPV4_OFFSET_MASK))
+      return PPP_PROTOCOL_IP;
+
+   //Number of TCP packets sent
+   vjContext->txTcpPackets++;
+
+   //Length of the IP header
+   ipHeaderLen = ipHeader->headerLength * 4;
+
+   //The IP and TCP headers must be contiguous
+   if(ipHeaderLen < sizeof(Ipv4Header) || (ipHeaderLen + sizeof(TcpHeader)) > n)
+      return PPP_PROTOCOL_IP;
+
+   //Point to the TCP header
+   tcpHeader = (TcpHeader *) ((uint8_t *) ipHeader + ipHeaderLen);
+   //Length of the IP and TCP headers
+   headerLen = ipHeaderLen + tcpHeader->dataOffset * 4;
+
+   //Check the length of the headers
+   if(headerLen > n || headerLen > length || headerLen > PPP_VJ_MAX_HEADER_SIZE)
+      return PPP_PROTOCOL_IP;
+
+   //Segments that open, close or reset a connection, or that do not
+   //acknowledge anything, are sent as is
+   if((tcpHeader->flags & (TCP_FLAG_SYN | TCP_FLAG_FIN | TCP_FLAG_RST |
+      TCP_FLAG_ACK)) != TCP_FLAG_ACK)
+   {
+      return PPP_PROTOCOL_IP;
+   }
+
+   //Look for the slot of the connection, the oldest slot is reused
+   //if there is none
+   for(k = 0, i = 0; i < vjContext->txSlotCount; i++)
+   {
+      //Point to the current slot
+      slot = &vjContext->txSlot[i];
+
+      //Free slot?
+      if(!slot->valid)
+      {
+         //Free slots are used first
+         if(vjContext->txSlot[k].valid)
+            k = i;
+      }
+      else
+      {
+         //Point to the saved headers
+         oldIpHeader = (Ipv4Header *) slot->header;
+         oldTcpHeader = (TcpHeader *) (slot->header + oldIpHeader->headerLength * 4);
+
+         //Same connection?
+         if(oldIpHeader->srcAddr == ipHeader->srcAddr &&
+            oldIpHeader->destAddr == ipHeader->destAddr &&
+            oldTcpHeader->srcPort == tcpHeader->srcPort &&
+            oldTcpHeader->destPort == tcpHeader->destPort)
+         {
+            break;
+         }
+
+         //Keep track of the least recently used slot
+         if(vjContext->txSlot[k].valid && slot->lastUsed < vjContext->txSlot[k].lastUsed)
+            k = i;
+      }
+   }
+
+   //New connection?
+   if(i >= vjContext->txSlotCount)
+   {
+      //Take the free or oldest slot
+      i = k;
+      slot = &vjContext->txSlot[i];
+
+      //The first packet is sent with its full header
+      goto uncompressed;
+   }
+
+   //Point to the saved headers
+   oldIpHeader = (Ipv4Header *) slot->header;
+   oldTcpHeader = (TcpHeader *) (slot->header + ipHeaderLen);
+
+   //Only the fields that normally change from one packet to the next can
+   //be coded, any other difference requires the full header
+   if(((uint8_t *) ipHeader)[0] != slot->header[0] ||
+      ipHeader->typeOfService != oldIpHeader->typeOfService ||
+      ipHeader->fragmentOffset != oldIpHeader->fragmentOffset ||
+      ipHeader->timeToLive != oldIpHeader->timeToLive ||
+      tcpHeader->dataOffset != oldTcpHeader->dataOffset ||
+      memcmp(ipHeader->options, oldIpHeader->options, ipHeaderLen - sizeof(Ipv4Header)) ||
+      memcmp(tcpHeader->options, oldTcpHeader->options, headerLen - ipHeaderLen - sizeof(TcpHeader)))
+   {
+      goto uncompressed;
+   }
+
+   //Start with an empty change mask
+   changes = 0;
+   p = delta;
+
+   //Urgent pointer
+   if(tcpHeader->flags & TCP_FLAG_URG)
+   {
+      p = pppVjEncode(p, ntohs(tcpHeader->urgentPointer), TRUE);
+      changes |= PPP_VJ_NEW_U;
+   }
+   else if(tcpHeader->urgentPointer != oldTcpHeader->urgentPointer)
+   {
+      goto uncompressed;
+   }
+
+   //Window
+   deltaW = ntohs(tcpHeader->window) - ntohs(oldTcpHeader->window);
+
+   if(deltaW != 0)
+   {
+      p = pppVjEncode(p, deltaW, FALSE);
+      changes |= PPP_VJ_NEW_W;
+   }
+
+   //Acknowledgment number
+   deltaA = ntohl(tcpHeader->ackNum) - ntohl(oldTcpHeader->ackNum);
+
+   if(deltaA != 0)
+   {
+      //The difference must fit in 16 bits
+      if(deltaA > 0xFFFF)
+         goto uncompressed;
+
+      p = pppVjEncode(p, (uint16_t) deltaA, FALSE);
+      changes |= PPP_VJ_NEW_A;
+   }
+
+   //Sequence number
+   deltaS = ntohl(tcpHeader->seqNum) - ntohl(oldTcpHeader->seqNum);
+
+   if(deltaS != 0)
+   {
+      //The difference must fit in 16 bits
+      if(deltaS > 0xFFFF)
+         goto uncompressed;
+
+      p = pppVjEncode(p, (uint16_t) deltaS, FALSE);
+      changes |= PPP_VJ_NEW_S;
+   }
+
+   //Length of the data of the previous packet
+   n = ntohs(oldIpHeader->totalLength) - slot->headerLen;
+
+   //Look for the special cases
+   switch(changes)
+   {
+   case 0:
+      //A data segment that follows a pure ACK is compressed. Other segments
+      //with an unchanged header are retransmissions or window probes, sent
+      //in full in case the peer lost the previous one
+      if(ipHeader->totalLength != oldIpHeader->totalLength && n == 0)
+         break;
+      goto uncompressed;
+   case PPP_VJ_SPECIAL_I:
+   case PPP_VJ_SPECIAL_D:
+      //These changes would be read as one of the special cases
+      goto uncompressed;
+   case PPP_VJ_NEW_S | PPP_VJ_NEW_A:
+      //Echoed interactive traffic
+      if(deltaS == deltaA && deltaS == n)
+      {
+         changes = PPP_VJ_SPECIAL_I;
+         p = delta;
+      }
+      break;
+   case PPP_VJ_NEW_S:
+      //Unidirectional data transfer
+      if(deltaS == n)
+      {
+         changes = PPP_VJ_SPECIAL_D;
+         p = delta;
+      }
+      break;
+   default:
+      break;
+   }
+
+   //IP identification, normally incremented by one
+   deltaId = ntohs(ipHeader->identification) - ntohs(oldIpHeader->identification);
+
+   if(deltaId != 1)
+   {
+      p = pppVjEncode(p, deltaId, TRUE);
+      changes |= PPP_VJ_NEW_I;
+   }
+
+   //PSH flag
+   if(tcpHeader->flags & TCP_FLAG_PSH)
+      changes |= PPP_VJ_PUSH;
+
+   //The TCP checksum is sent as is
+   checksum = tcpHeader->checksum;
+
+   //Save the headers of the packet
+   memcpy(slot->header, ipHeader, headerLen);
+   slot->headerLen = headerLen;
+   slot->lastUsed = ++vjContext->txClock;
+
+   //Length of the coded differences
+   n = p - delta;
+   //Length of the compressed header
+   k = n + 3;
+
+   //The slot ID can be omitted when it is the same as the previous one
+   if(!vjContext->txCompSlotId || vjContext->txLastSlot != i)
+   {
+      changes |= PPP_VJ_NEW_C;
+      k++;
+   }
+
+   //The compressed header ends where the TCP data begins
+   p = (uint8_t *) ipHeader + headerLen - k;
+   *(p++) = changes;
+
+   //Slot ID
+   if(changes & PPP_VJ_NEW_C)
+      *(p++) = i;
+
+   //TCP checksum
+   memcpy(p, &checksum, sizeof(uint16_t));
+   //Coded differences
+   memcpy(p + sizeof(uint16_t), delta, n);
+
+   //Skip the bytes saved
+   *offset += headerLen - k;
+
+   //Update statistics
+   vjContext->txLastSlot = i;
+   vjContext->txCompressed++;
+   vjContext->txSavedBytes += headerLen - k;
+
+   //Send a compressed TCP packet
+   return PPP_PROTOCOL_VJ_COMP;
+
+uncompressed:
+   //Save the headers of the packet
+   memcpy(slot->header, ipHeader, headerLen);
+   slot->headerLen = headerLen;
+   slot->valid = TRUE;
+   slot->lastUsed = ++vjContext->txClock;
+
+   //The Protocol field carries the slot ID
+   ipHeader->protocol = i;
+   vjContext->txLastSlot = i;
+
+   //Send an uncompressed TCP packet
+   return PPP_PROTOCOL_VJ_UNCOMP;
+}
+
+
+/**
+ * @brief Rebuild an incoming IP datagram
+ *
+ * An uncompressed TCP packet is fixed in place. The datagram carried by a
+ * compressed packet is rebuilt at the start of the receive buffer of the
+ * PPP context
+ *
+ * @param[in] context PPP context
+ * @param[in] protocol PPP protocol of the packet
+ * @param[in,out] frame Pointer to the packet, then to the IP datagram
+ * @param[in,out] length Length of the packet, then of the IP datagram
+ * @return Error code
+ **/
+
+error_t pppVjDecompress(PppContext *context, uint16_t protocol,
+   uint8_t **frame, size_t *length)
+{
+   error_t error;
+   uint_t i;
+   size_t n;
+   size_t headerLen;
+   size_t ipHeaderLen;
+   uint8_t changes;
+   uint16_t value;
+   const uint8_t *p;
+   const uint8_t *end;
+   Ipv4Header *ipHeader;
+   TcpHeader *tcpHeader;
+   PppVjContext *vjContext;
+   PppVjSlot *slot;
+
+   //Point to the VJ compression context
+   vjContext = &context->vjContext;
+
+   //Uncompressed TCP packet?
+   if(protocol == PPP_PROTOCOL_VJ_UNCOMP)
+   {
+      //Point to the IP header
+      ipHeader = (Ipv4Header *) *frame;
+
+      //Malformed packet?
+      if(*length < sizeof(Ipv4Header))
+         goto error;
+
+      //The Protocol field carries the slot ID
+      i = ipHeader->protocol;
+      //Length of the IP header
+      ipHeaderLen = ipHeader->headerLength * 4;
+
+      //Check the slot ID and the length of the IP header
+      if(i >= PPP_VJ_MAX_SLOTS || ipHeaderLen < sizeof(Ipv4Header) ||
+         (ipHeaderLen + sizeof(TcpHeader)) > *length)
+      {
+         goto error;
+      }
+
+      //Point to the TCP header
+      tcpHeader = (TcpHeader *) (*frame + ipHeaderLen);
+      //Length of the IP and TCP headers
+      headerLen = ipHeaderLen + tcpHeader->dataOffset * 4;
+
+      //Check the length of the headers
+      if(tcpHeader->dataOffset < 5 || headerLen > *length ||
+         headerLen > PPP_VJ_MAX_HEADER_SIZE)
+      {
+         goto error;
+      }
+
+      //Restore the Protocol field
+      ipHeader->protocol = IPV4_PROTOCOL_TCP;
+
+      //Save the headers of the packet
+      slot = &vjContext->rxSlot[i];
+      memcpy(slot->header, ipHeader, headerLen);
+      slot->headerLen = headerLen;
+      slot->valid = TRUE;
+
+      //Compressed packets can be accepted again
+      vjContext->rxLastSlot = i;
+      vjContext->rxToss = FALSE;
+      vjContext->rxUncompressed++;
+
+      //The datagram is complete
+      return NO_ERROR;
+   }
+
+   //Point to the compressed header
+   p = *frame;
+   end = *frame + *length;
+
+   //Check the length of the packet
+   if(*length < 3)
+      goto error;
+
+   //Change mask
+   changes = *(p++);
+
+   //Explicit slot ID?
+   if(changes & PPP_VJ_NEW_C)
+   {
+      //Check the slot ID
+      if(*p >= PPP_VJ_MAX_SLOTS)
+         goto error;
+
+      vjContext->rxLastSlot = *(p++);
+      vjContext->rxToss = FALSE;
+   }
+   else if(vjContext->rxToss)
+   {
+      //A previous packet was lost, the state of the slot is unknown
+      goto error;
+   }
+
+   //Point to the slot of the connection
+   slot = &vjContext->rxSlot[vjContext->rxLastSlot];
+
+   //Unknown connection?
+   if(!slot->valid || (end - p) < 2)
+      goto error;
+
+   //Point to the saved headers
+   ipHeader = (Ipv4Header *) slot->header;
+   ipHeaderLen = ipHeader->headerLength * 4;
+   tcpHeader = (TcpHeader *) (slot->header + ipHeaderLen);
+   headerLen = slot->headerLen;
+
+   //TCP checksum
+   memcpy(&tcpHeader->checksum, p, sizeof(uint16_t));
+   p += sizeof(uint16_t);
+
+   //PSH flag
+   if(changes & PPP_VJ_PUSH)
+      tcpHeader->flags |= TCP_FLAG_PSH;
+   else
+      tcpHeader->flags &= ~TCP_FLAG_PSH;
+
+   //Length of the data of the previous packet
+   n = ntohs(ipHeader->totalLength) - headerLen;
+
+   //Check the special cases
+   switch(changes & PPP_VJ_SPECIALS_MASK)
+   {
+   case PPP_VJ_SPECIAL_I:
+      //Echoed interactive traffic
+      tcpHeader->ackNum = htonl(ntohl(tcpHeader->ackNum) + n);
+      tcpHeader->seqNum = htonl(ntohl(tcpHeader->seqNum) + n);
+      break;
+   case PPP_VJ_SPECIAL_D:
+      //Unidirectional data transfer
+      tcpHeader->seqNum = htonl(ntohl(tcpHeader->seqNum) + n);
+      break;
+   default:
+      //Urgent pointer
+      if(changes & PPP_VJ_NEW_U)
+      {
+         error = pppVjDecode(&p, end, &value);
+         if(error) goto error;
+
+         tcpHeader->flags |= TCP_FLAG_URG;
+         tcpHeader->urgentPointer = htons(value);
+      }
+      else
+      {
+         tcpHeader->flags &= ~TCP_FLAG_URG;
+      }
+
+      //Window
+      if(changes & PPP_VJ_NEW_W)
+      {
+         error = pppVjDecode(&p, end, &value);
+         if(error) goto error;
+
+         tcpHeader->window = htons(ntohs(tcpHeader->window) + value);
+      }
+
+      //Acknowledgment number
+      if(changes & PPP_VJ_NEW_A)
+      {
+         error = pppVjDecode(&p, end, &value);
+         if(error) goto error;
+
+         tcpHeader->ackNum = htonl(ntohl(tcpHeader->ackNum) + value);
+      }
+
+      //Sequence number
+      if(changes & PPP_VJ_NEW_S)
+      {
+         error = pppVjDecode(&p, end, &value);
+         if(error) goto error;
+
+         tcpHeader->seqNum = htonl(ntohl(tcpHeader->seqNum) + value);
+      }
+      break;
+   }
+
+   //IP identification
+   if(changes & PPP_VJ_NEW_I)
+   {
+      error = pppVjDecode(&p, end, &value);
+      if(error) goto error;
+
+      ipHeader->identification = htons(ntohs(ipHeader->identification) + value);
+   }
+   else
+   {
+      ipHeader->identification = htons(ntohs(ipHeader->identification) + 1);
+   }
+
+   //Length of the TCP data
+   n = end - p;
+
+   //The rebuilt datagram must fit in the receive buffer
+   if((headerLen + n) > sizeof(context->frame))
+      goto error;
+
+   //Update the Total Length and Header Checksum fields
+   ipHeader->totalLength = htons(headerLen + n);
+   ipHeader->headerChecksum = 0;
+   ipHeader->headerChecksum = ipCalcChecksum(ipHeader, ipHeaderLen);
+
+   //Move the data behind the room for the headers and copy them
+   memmove(context->frame + headerLen, p, n);
+   memcpy(context->frame, slot->header, headerLen);
+
+   //Return the rebuilt datagram
+   *frame = context->frame;
+   *length = headerLen + n;
+
+   //Number of compressed packets received
+   vjContext->rxCompressed++;
+
+   //Successful processing
+   return NO_ERROR;
+
+error:
+   //Compressed packets are discarded until the next explicit slot ID
+   vjContext->rxToss = TRUE;
+   vjContext->rxErrors++;
+
+   //Debug message
+   TRACE_WARNING("VJ compressed packet discarded!\r\n");
+
+   //Report an error
+   return ERROR_INVALID_PACKET;
+}
+
+
+/**
+ * @brief Report a frame lost on the link
+ *
+ * The differences carried by the next compressed packets would be applied
+ * to an outdated state, so they are discarded until the peer sends a slot
+ * ID again, which it does when TCP retransmits
+ *
+ * @param[in] context PPP context
+ **/
+
+void pppVjRxError(PppContext *context)
+{
+   //Discard compressed packets until the next explicit slot ID
+   context->vjContext.rxToss = TRUE;
+}
+
+
+/**
+ * @brief Code a difference
+ * @param[in] p Pointer to the output
+ * @param[in] value Difference to be coded
+ * @param[in] zero The value may be zero
+ * @return Pointer following the coded value
+ **/
+
+static uint8_t *pppVjEncode(uint8_t *p, uint16_t value, bool_t zero)
+{
+   //A zero byte introduces a 16-bit value
+   if(value >= 256 || (zero && value == 0))
+   {
+      *(p++) = 0;
+      *(p++) = MSB(value);
+      *(p++) = LSB(value);
+   }
+   else
+   {
+      *(p++) = LSB(value);
+   }
+
+   //Return the position following the coded value
+   return p;
+}
+
+
+/**
+ * @brief Read a coded difference
+ * @param[in,out] p Pointer to the input
+ * @param[in] end End of the input
+ * @param[out] value Difference
+ * @return Error code
+ **/
+
+static error_t pppVjDecode(const uint8_t **p, const uint8_t *end, uint16_t *value)
+{
+   //Malformed packet?
+   if(*p >= end)
+      return ERROR_INVALID_LENGTH;
+
+   //A zero byte introduces a 16-bit value
+   if(**p == 0)
+   {
+      //Malformed packet?
+      if((end - *p) < 3)
+         return ERROR_INVALID_LENGTH;
+
+      *value = ((*p)[1] << 8) | (*p)[2];
+      *p += 3;
+   }
+   else
+   {
+      *value = **p;
+      *p += 1;
+   }
+
+   //Successful processing
+   return NO_ERROR;
+}
+
+#endif
@@ -0,0 +1,113 @@
+/**
+ * @file ppp_vj.h
+ * @brief Van Jacobson TCP/IP header compression (RFC 1144)
+ *
+ * @section License
+ *
+ * Copyright (C) 2010-2016 Oryx Embedded SARL. All rights reserved.
+ *
+ * This file is part of CycloneTCP Open.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * @author Oryx Embedded SARL (www.oryx-embedded.com)
+ * @version 1.7.5b
+ **/
+
+#ifndef _PPP_VJ_H
+#define _PPP_VJ_H
+
+//Dependencies
+#include "core/net.h"
+
+//VJ TCP/IP header compression support
+#ifndef PPP_VJ_SUPPORT
+   #define PPP_VJ_SUPPORT ENABLED
+#elif (PPP_VJ_SUPPORT != ENABLED && PPP_VJ_SUPPORT != DISABLED)
+   #error PPP_VJ_SUPPORT parameter is not valid
+#endif
+
+//Number of connection slots in each direction
+#ifndef PPP_VJ_MAX_SLOTS
+   #define PPP_VJ_MAX_SLOTS 16
+#elif (PPP_VJ_MAX_SLOTS < 3 || PPP_VJ_MAX_SLOTS > 256)
+   #error PPP_VJ_MAX_SLOTS parameter is not valid
+#endif
+
+//Maximum size of the IP and TCP headers kept for a connection
+#define PPP_VJ_MAX_HEADER_SIZE 128
+
+//Bits of the change mask
+#define PPP_VJ_NEW_C 0x40
+#define PPP_VJ_NEW_I 0x20
+#define PPP_VJ_PUSH  0x10
+#define PPP_VJ_NEW_S 0x08
+#define PPP_VJ_NEW_A 0x04
+#define PPP_VJ_NEW_W 0x02
+#define PPP_VJ_NEW_U 0x01
+
+//Special cases of the change mask
+#define PPP_VJ_SPECIAL_I (PPP_VJ_NEW_S | PPP_VJ_NEW_W | PPP_VJ_NEW_U)
+#define PPP_VJ_SPECIAL_D (PPP_VJ_NEW_S | PPP_VJ_NEW_A | PPP_VJ_NEW_W | PPP_VJ_NEW_U)
+#define PPP_VJ_SPECIALS_MASK (PPP_VJ_NEW_S | PPP_VJ_NEW_A | PPP_VJ_NEW_W | PPP_VJ_NEW_U)
+
+
+/**
+ * @brief Connection slot
+ **/
+
+typedef struct
+{
+   uint8_t header[PPP_VJ_MAX_HEADER_SIZE]; ///<IP and TCP headers of the last packet
+   size_t headerLen;                       ///<Length of the saved headers
+   bool_t valid;                           ///<The slot holds a connection
+   uint32_t lastUsed;                      ///<Age of the slot, for reuse
+} PppVjSlot;
+
+
+/**
+ * @brief VJ compression context
+ **/
+
+typedef struct
+{
+   PppVjSlot txSlot[PPP_VJ_MAX_SLOTS]; ///<Connections of the compressor
+   uint_t txSlotCount;                 ///<Number of slots the peer can hold
+   bool_t txCompSlotId;                ///<The slot ID may be omitted
+   uint_t txLastSlot;                  ///<Slot of the last packet sent
+   uint32_t txClock;                   ///<Counter used to age the slots
+   PppVjSlot rxSlot[PPP_VJ_MAX_SLOTS]; ///<Connections of the decompressor
+   uint_t rxLastSlot;                  ///<Slot of the last packet received
+   bool_t rxToss;                      ///<Discard packets until a slot ID is received
+   uint32_t txTcpPackets;              ///<TCP packets sent
+   uint32_t txCompressed;              ///<TCP packets sent with a compressed header
+   uint32_t txSavedBytes;              ///<Header bytes removed by the compressor
+   uint32_t rxCompressed;              ///<Packets received with a compressed header
+   uint32_t rxUncompressed;            ///<Packets received with a full header
+   uint32_t rxErrors;                  ///<Packets discarded by the decompressor
+} PppVjContext;
+
+
+//VJ compression related functions
+void pppVjInit(PppContext *context, uint_t maxSlotId, bool_t compSlotId);
+
+uint16_t pppVjCompress(PppContext *context, NetBuffer *buffer, size_t *offset);
+
+error_t pppVjDecompress(PppContext *context, uint16_t protocol,
+   uint8_t **frame, size_t *length);
+
+void pppVjRxError(PppContext *context);
+
+#endif
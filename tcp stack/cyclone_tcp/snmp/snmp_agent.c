@@ -88,6 +88,11 @@ void snmpAgentGetDefaultSettings(SnmpAgentSettings *settings)
 
    //Random data generation callback function
    settings->randCallback = NULL;
+
+#if (SNMP_AGENT_INFORM_SUPPORT == ENABLED)
+   //InformRequest acknowledgment callback function
+   settings->informCallback = NULL;
+#endif
 }
 
 
@@ -118,6 +123,8 @@ error_t snmpAgentInit(SnmpAgentContext *context, const SnmpAgentSettings *settin
 
    //Save user settings
    context->settings = *settings;
+   //Notifications leave through the interface the agent is bound to, if any
+   context->trapInterface = settings->interface;
 
 #if (SNMP_V3_SUPPORT == ENABLED)
    //Get current time
@@ -287,8 +294,22 @@ error_t snmpAgentLoadMib(SnmpAgentContext *context, const MibModule *module)
          //Update the number of MIBs
          context->mibModuleCount++;
 
-         //Successful processing
-         error = NO_ERROR;
+         //Rebuild the merged object index
+         error = snmpBuildMibIndex(context);
+
+         //The object index cannot hold the new MIB?
+         if(error)
+         {
+            //Update the number of MIBs
+            context->mibModuleCount--;
+
+            //Remove the new MIB from the list
+            for(j = i; j < context->mibModuleCount; j++)
+               context->mibModule[j] = context->mibModule[j + 1];
+
+            //Restore the previous object index
+            snmpBuildMibIndex(context);
+         }
       }
       else
       {
@@ -343,8 +364,8 @@ error_t snmpAgentUnloadMib(SnmpAgentContext *context, const MibModule *module)
       for(j = i; j < context->mibModuleCount; j++)
          context->mibModule[j] = context->mibModule[j + 1];
 
-      //Successful processing
-      error = NO_ERROR;
+      //Rebuild the merged object index
+      error = snmpBuildMibIndex(context);
    }
    else
    {
@@ -462,6 +483,37 @@ error_t snmpAgentSetEnterpriseOid(SnmpAgentContext *context,
 }
 
 
+/**
+ * @brief Select the interface used to send notifications
+ *
+ * When the agent listens on all interfaces, the application selects the
+ * interface that currently has the route to the managers. A NULL value lets
+ * the stack pick the interface from the destination address
+ *
+ * @param[in] context Pointer to the SNMP agent context
+ * @param[in] interface Underlying network interface
+ * @return Error code
+ **/
+
+error_t snmpAgentSetTrapInterface(SnmpAgentContext *context,
+   NetInterface *interface)
+{
+   //Check parameters
+   if(context == NULL)
+      return ERROR_INVALID_PARAMETER;
+
+   //Acquire exclusive access to the SNMP agent context
+   osAcquireMutex(&context->mutex);
+   //Save the interface for subsequent traps and informs
+   context->trapInterface = interface;
+   //Release exclusive access to the SNMP agent context
+   osReleaseMutex(&context->mutex);
+
+   //Successful processing
+   return NO_ERROR;
+}
+
+
 /**
  * @brief Set context engine identifier
  * @param[in] context Pointer to the SNMP agent context
@@ -708,6 +760,13 @@ error_t snmpAgentCreateUser(SnmpAgentContext *context,
             //Save the authentication key
             memcpy(&entry->authKey, authKey, sizeof(SnmpKey));
          }
+
+         //Check status code
+         if(!error)
+         {
+            //The key is fixed, so the HMAC pads are only hashed once
+            error = snmpPrecomputeHmacPads(entry);
+         }
       }
 
       //Check status code
@@ -803,7 +862,7 @@ error_t snmpAgentDeleteUser(SnmpAgentContext *context, const char_t *username)
 
 
 /**
- * @brief Send SNMP trap message
+ * @brief Format and send SNMP trap message
  * @param[in] context Pointer to the SNMP agent context
  * @param[in] destIpAddr Destination IP address
  * @param[in] version SNMP version identifier
@@ -812,23 +871,20 @@ error_t snmpAgentDeleteUser(SnmpAgentContext *context, const char_t *username)
  * @param[in] specificTrapCode Specific code
  * @param[in] objectList List of object names
  * @param[in] objectListSize Number of entries in the list
+ * @param[in] varBindList Variable bindings appended after the objects,
+ *   already encoded
+ * @param[in] varBindListLen Length of the encoded list in bytes
  * @return Error code
  **/
 
-error_t snmpAgentSendTrap(SnmpAgentContext *context, const IpAddr *destIpAddr,
-   SnmpVersion version, const char_t *username, uint_t genericTrapType,
-   uint_t specificTrapCode, const SnmpTrapObject *objectList, uint_t objectListSize)
+static error_t snmpAgentSendTrapMessage(SnmpAgentContext *context,
+   const IpAddr *destIpAddr, SnmpVersion version, const char_t *username,
+   uint_t genericTrapType, uint_t specificTrapCode,
+   const SnmpTrapObject *objectList, uint_t objectListSize,
+   const uint8_t *varBindList, size_t varBindListLen)
 {
    error_t error;
 
-   //Check parameters
-   if(context == NULL || destIpAddr == NULL || username == NULL)
-      return ERROR_INVALID_PARAMETER;
-
-   //Make sure the list of objects is valid
-   if(objectListSize > 0 && objectList == NULL)
-      return ERROR_INVALID_PARAMETER;
-
    //Acquire exclusive access to the SNMP agent context
    osAcquireMutex(&context->mutex);
 
@@ -844,7 +900,8 @@ error_t snmpAgentSendTrap(SnmpAgentContext *context, const IpAddr *destIpAddr,
       {
          //Format Trap-PDU
          error = snmpFormatTrapPdu(context, version, username,
-            genericTrapType, specificTrapCode, objectList, objectListSize);
+            genericTrapType, specificTrapCode, objectList, objectListSize,
+            varBindList, varBindListLen);
          //Any error to report?
          if(error) break;
 
@@ -861,7 +918,8 @@ error_t snmpAgentSendTrap(SnmpAgentContext *context, const IpAddr *destIpAddr,
       {
          //Format SNMPv2-Trap-PDU
          error = snmpFormatTrapPdu(context, version, username,
-            genericTrapType, specificTrapCode, objectList, objectListSize);
+            genericTrapType, specificTrapCode, objectList, objectListSize,
+            varBindList, varBindListLen);
          //Any error to report?
          if(error) break;
 
@@ -891,7 +949,8 @@ error_t snmpAgentSendTrap(SnmpAgentContext *context, const IpAddr *destIpAddr,
 
          //Format SNMPv2-Trap-PDU
          error = snmpFormatTrapPdu(context, version, username,
-            genericTrapType, specificTrapCode, objectList, objectListSize);
+            genericTrapType, specificTrapCode, objectList, objectListSize,
+            varBindList, varBindListLen);
          //Any error to report?
          if(error) break;
 
@@ -951,8 +1010,8 @@ error_t snmpAgentSendTrap(SnmpAgentContext *context, const IpAddr *destIpAddr,
       asn1DumpObject(context->response.pos, context->response.length, 0);
 
       //Send SNMP trap message
-      error = socketSendTo(context->socket, destIpAddr, context->settings.trapPort,
-         context->response.pos, context->response.length, NULL, 0);
+      error = snmpSendMessage(context, context->trapInterface,
+         destIpAddr, context->settings.trapPort);
       //End of exception handling block
    } while(0);
 
@@ -964,6 +1023,253 @@ error_t snmpAgentSendTrap(SnmpAgentContext *context, const IpAddr *destIpAddr,
 }
 
 
+/**
+ * @brief Send SNMP trap message
+ * @param[in] context Pointer to the SNMP agent context
+ * @param[in] destIpAddr Destination IP address
+ * @param[in] version SNMP version identifier
+ * @param[in] username User name or community name
+ * @param[in] genericTrapType Generic trap type
+ * @param[in] specificTrapCode Specific code
+ * @param[in] objectList List of object names
+ * @param[in] objectListSize Number of entries in the list
+ * @return Error code
+ **/
+
+error_t snmpAgentSendTrap(SnmpAgentContext *context, const IpAddr *destIpAddr,
+   SnmpVersion version, const char_t *username, uint_t genericTrapType,
+   uint_t specificTrapCode, const SnmpTrapObject *objectList, uint_t objectListSize)
+{
+   //Check parameters
+   if(context == NULL || destIpAddr == NULL || username == NULL)
+      return ERROR_INVALID_PARAMETER;
+
+   //Make sure the list of objects is valid
+   if(objectListSize > 0 && objectList == NULL)
+      return ERROR_INVALID_PARAMETER;
+
+   //The values are read from the MIB while the message is formatted
+   return snmpAgentSendTrapMessage(context, destIpAddr, version, username,
+      genericTrapType, specificTrapCode, objectList, objectListSize, NULL, 0);
+}
+
+
+/**
+ * @brief Send SNMP trap message with variable bindings already encoded
+ * @param[in] context Pointer to the SNMP agent context
+ * @param[in] destIpAddr Destination IP address
+ * @param[in] version SNMP version identifier
+ * @param[in] username User name or community name
+ * @param[in] genericTrapType Generic trap type
+ * @param[in] specificTrapCode Specific code
+ * @param[in] varBindList Variable bindings of the objects, as encoded by
+ *   snmpAgentFormatVarBindingList
+ * @param[in] varBindListLen Length of the list in bytes
+ * @return Error code
+ **/
+
+error_t snmpAgentSendEncodedTrap(SnmpAgentContext *context, const IpAddr *destIpAddr,
+   SnmpVersion version, const char_t *username, uint_t genericTrapType,
+   uint_t specificTrapCode, const uint8_t *varBindList, size_t varBindListLen)
+{
+   //Check parameters
+   if(context == NULL || destIpAddr == NULL || username == NULL)
+      return ERROR_INVALID_PARAMETER;
+
+   //Make sure the list of variable bindings is valid
+   if(varBindListLen > 0 && varBindList == NULL)
+      return ERROR_INVALID_PARAMETER;
+
+   //Send the values captured by the caller
+   return snmpAgentSendTrapMessage(context, destIpAddr, version, username,
+      genericTrapType, specificTrapCode, NULL, 0, varBindList, varBindListLen);
+}
+
+
+/**
+ * @brief Encode variable bindings for a later notification
+ *
+ * A variable binding without a value takes the current value of the object
+ * in the MIB. The encoded list can be passed to snmpAgentSendInform or
+ * snmpAgentSendEncodedTrap as many times as needed, so that a retransmission
+ * carries the same values as the first transmission
+ *
+ * @param[in] context Pointer to the SNMP agent context
+ * @param[in] varBindList List of variable bindings
+ * @param[in] varBindListSize Number of entries in the list
+ * @param[out] buffer Buffer where to store the encoded list
+ * @param[in] size Size of the buffer
+ * @param[out] length Length of the encoded list
+ * @return Error code
+ **/
+
+error_t snmpAgentFormatVarBindingList(SnmpAgentContext *context,
+   const SnmpVarBind *varBindList, uint_t varBindListSize,
+   uint8_t *buffer, size_t size, size_t *length)
+{
+   error_t error;
+   uint_t i;
+   SnmpVarBind var;
+   SnmpMessage *message;
+
+   //Check parameters
+   if(context == NULL || buffer == NULL || length == NULL)
+      return ERROR_INVALID_PARAMETER;
+
+   //Make sure the list of variable bindings is valid
+   if(varBindListSize > 0 && varBindList == NULL)
+      return ERROR_INVALID_PARAMETER;
+
+   //Acquire exclusive access to the SNMP agent context
+   osAcquireMutex(&context->mutex);
+
+   //The variable bindings are formatted in the response buffer, as they
+   //would be in a notification
+   message = &context->response;
+   //Initialize SNMP message
+   snmpInitMessage(message);
+   //Notifications are sent in SNMPv2c messages
+   message->version = SNMP_VERSION_2C;
+
+   //Make room for the message header at the beginning of the buffer
+   error = snmpComputeMessageOverhead(message);
+
+   //Check status code
+   if(!error)
+   {
+      //Lock access to MIB bases
+      snmpLockMib(context);
+
+      //Loop through the list of variable bindings
+      for(i = 0; i < varBindListSize; i++)
+      {
+         var = varBindList[i];
+
+         //Retrieve the object value if none is given
+         if(var.value == NULL)
+         {
+            error = snmpGetObjectValue(context, &var);
+            //Any error to report?
+            if(error) break;
+         }
+
+         //Append variable binding to the list
+         error = snmpWriteVarBinding(context, &var);
+         //Any error to report?
+         if(error) break;
+      }
+
+      //Unlock access to MIB bases
+      snmpUnlockMib(context);
+   }
+
+   //Check status code
+   if(!error)
+   {
+      //Make sure the output buffer is large enough
+      if(message->varBindListLen <= size)
+      {
+         //Copy the encoded list
+         memcpy(buffer, message->varBindList, message->varBindListLen);
+         *length = message->varBindListLen;
+      }
+      else
+      {
+         //Report an error
+         error = ERROR_BUFFER_OVERFLOW;
+      }
+   }
+
+   //Release exclusive access to the SNMP agent context
+   osReleaseMutex(&context->mutex);
+
+   //Return status code
+   return error;
+}
+
+
+/**
+ * @brief Send SNMP inform request
+ *
+ * The InformRequest-PDU is sent once. Retransmission is left to the caller,
+ * which is notified through the informCallback function when the matching
+ * GetResponse-PDU is received
+ *
+ * @param[in] context Pointer to the SNMP agent context
+ * @param[in] destIpAddr Destination IP address
+ * @param[in] version SNMP version identifier
+ * @param[in] username Community name
+ * @param[in] genericTrapType Generic trap type
+ * @param[in] specificTrapCode Specific code
+ * @param[in] varBindList Variable bindings of the objects, as encoded by
+ *   snmpAgentFormatVarBindingList
+ * @param[in] varBindListLen Length of the list in bytes
+ * @param[in] requestId Request identifier
+ * @return Error code
+ **/
+
+error_t snmpAgentSendInform(SnmpAgentContext *context, const IpAddr *destIpAddr,
+   SnmpVersion version, const char_t *username, uint_t genericTrapType,
+   uint_t specificTrapCode, const uint8_t *varBindList, size_t varBindListLen,
+   int32_t requestId)
+{
+#if (SNMP_AGENT_INFORM_SUPPORT == ENABLED)
+   error_t error;
+
+   //Check parameters
+   if(context == NULL || destIpAddr == NULL || username == NULL)
+      return ERROR_INVALID_PARAMETER;
+
+   //Make sure the list of variable bindings is valid
+   if(varBindListLen > 0 && varBindList == NULL)
+      return ERROR_INVALID_PARAMETER;
+
+   //Acquire exclusive access to the SNMP agent context
+   osAcquireMutex(&context->mutex);
+
+   //Start of exception handling block
+   do
+   {
+      //Format InformRequest-PDU
+      error = snmpFormatInformRequestPdu(context, version, username,
+         genericTrapType, specificTrapCode, varBindList, varBindListLen,
+         requestId);
+      //Any error to report?
+      if(error) break;
+
+      //Format SMNP message header
+      error = snmpWriteMessageHeader(&context->response);
+      //Any error to report?
+      if(error) break;
+
+      //Total number of messages which were passed from the SNMP protocol
+      //entity to the transport service
+      MIB2_INC_COUNTER32(mib2Base.snmpGroup.snmpOutPkts, 1);
+
+      //Debug message
+      TRACE_INFO("Sending SNMP inform to %s port %" PRIu16
+         " (%" PRIuSIZE " bytes)...\r\n",
+         ipAddrToString(destIpAddr, NULL),
+         context->settings.trapPort, context->response.length);
+
+      //Send SNMP inform message
+      error = snmpSendMessage(context, context->trapInterface,
+         destIpAddr, context->settings.trapPort);
+      //End of exception handling block
+   } while(0);
+
+   //Release exclusive access to the SNMP agent context
+   osReleaseMutex(&context->mutex);
+
+   //Return status code
+   return error;
+#else
+   //Not implemented
+   return ERROR_NOT_IMPLEMENTED;
+#endif
+}
+
+
 /**
  * @brief SNMP agent task
  * @param[in] context Pointer to the SNMP agent context
@@ -972,6 +1278,7 @@ error_t snmpAgentSendTrap(SnmpAgentContext *context, const IpAddr *destIpAddr,
 void snmpAgentTask(SnmpAgentContext *context)
 {
    error_t error;
+   IpAddr localIpAddr;
 
 #if (NET_RTOS_SUPPORT == ENABLED)
    //Main loop
@@ -979,8 +1286,8 @@ void snmpAgentTask(SnmpAgentContext *context)
    {
 #endif
       //Wait for an incoming datagram
-      error = socketReceiveFrom(context->socket, &context->remoteIpAddr,
-         &context->remotePort, context->request.buffer,
+      error = socketReceiveEx(context->socket, &context->remoteIpAddr,
+         &context->remotePort, &localIpAddr, context->request.buffer,
          SNMP_MAX_MSG_SIZE, &context->request.bufferLen, 0);
 
       //Any datagram received?
@@ -989,6 +1296,12 @@ void snmpAgentTask(SnmpAgentContext *context)
          //Acquire exclusive access to the SNMP agent context
          osAcquireMutex(&context->mutex);
 
+         //The response must leave through the interface the request came in
+         if(context->settings.interface != NULL)
+            context->remoteInterface = context->settings.interface;
+         else
+            context->remoteInterface = snmpFindInterface(&localIpAddr);
+
          //Debug message
          TRACE_INFO("\r\nSNMP message received from %s port %" PRIu16
             " (%" PRIuSIZE " bytes)...\r\n",
@@ -1018,8 +1331,8 @@ void snmpAgentTask(SnmpAgentContext *context)
             asn1DumpObject(context->response.pos, context->response.length, 0);
 
             //Send SNMP response message
-            socketSendTo(context->socket, &context->remoteIpAddr, context->remotePort,
-               context->response.pos, context->response.length, NULL, 0);
+            snmpSendMessage(context, context->remoteInterface,
+               &context->remoteIpAddr, context->remotePort);
          }
 
          //Release exclusive access to the SNMP agent context
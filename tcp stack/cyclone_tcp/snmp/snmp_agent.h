@@ -42,6 +42,13 @@
    #error SNMP_AGENT_SUPPORT parameter is not valid
 #endif
 
+//InformRequest-PDU support
+#ifndef SNMP_AGENT_INFORM_SUPPORT
+   #define SNMP_AGENT_INFORM_SUPPORT DISABLED
+#elif (SNMP_AGENT_INFORM_SUPPORT != ENABLED && SNMP_AGENT_INFORM_SUPPORT != DISABLED)
+   #error SNMP_AGENT_INFORM_SUPPORT parameter is not valid
+#endif
+
 //Stack size required to run the SNMP agent
 #ifndef SNMP_AGENT_STACK_SIZE
    #define SNMP_AGENT_STACK_SIZE 550
@@ -68,6 +75,13 @@
    #error SNMP_AGENT_MAX_MIB_COUNT parameter is not valid
 #endif
 
+//Maximum number of objects across all loaded MIBs
+#ifndef SNMP_AGENT_MAX_MIB_OBJECT_COUNT
+   #define SNMP_AGENT_MAX_MIB_OBJECT_COUNT 256
+#elif (SNMP_AGENT_MAX_MIB_OBJECT_COUNT < 1)
+   #error SNMP_AGENT_MAX_MIB_OBJECT_COUNT parameter is not valid
+#endif
+
 
 /**
  * @brief Random data generation callback function
@@ -76,6 +90,14 @@
 typedef error_t (*SnmpAgentRandCallback)(uint8_t *data, size_t length);
 
 
+/**
+ * @brief InformRequest acknowledgment callback function
+ **/
+
+typedef void (*SnmpAgentInformCallback)(const IpAddr *remoteIpAddr,
+   int32_t requestId, uint_t errorStatus);
+
+
 /**
  * @brief SNMP agent settings
  **/
@@ -88,6 +110,9 @@ typedef struct
    uint16_t port;                                  ///<SNMP port number
    uint16_t trapPort;                              ///<SNMP trap port number
    SnmpAgentRandCallback randCallback;             ///<Random data generation callback function
+#if (SNMP_AGENT_INFORM_SUPPORT == ENABLED)
+   SnmpAgentInformCallback informCallback;         ///<InformRequest acknowledgment callback function
+#endif
 } SnmpAgentSettings;
 
 
@@ -104,9 +129,16 @@ typedef struct
    SnmpUserInfo userTable[SNMP_AGENT_MAX_USER_COUNT];    ///<List of users
    const MibModule *mibModule[SNMP_AGENT_MAX_MIB_COUNT]; ///<MIB modules
    uint_t mibModuleCount;                                ///<Number of MIB modules
+   const MibObject *mibObjectIndex[SNMP_AGENT_MAX_MIB_OBJECT_COUNT]; ///<Objects of all MIBs sorted by OID
+   uint_t mibObjectCount;                                ///<Number of entries in the object index
+   uint_t walkCursor;                                    ///<Index of the object that matched the last GetNext lookup
+   uint8_t walkCursorOid[SNMP_MAX_OID_SIZE];             ///<OID returned by the last GetNext lookup
+   size_t walkCursorOidLen;                              ///<Length of the cursor OID (0 if not valid)
    Socket *socket;                                       ///<Underlying socket
+   NetInterface *trapInterface;                          ///<Interface used to send notifications
    IpAddr remoteIpAddr;                                  ///<IP address of the remote SNMP engine
    uint16_t remotePort;                                  ///<Source port used by the remote SNMP engine
+   NetInterface *remoteInterface;                        ///<Interface on which the request was received
    SnmpMessage request;                                  ///<SNMP request message
    SnmpMessage response;                                 ///<SNMP response message
    const SnmpUserInfo *user;                             ///<Security profile of current user
@@ -148,6 +180,9 @@ error_t snmpAgentGetEngineBoots(SnmpAgentContext *context, int32_t *engineBoots)
 error_t snmpAgentSetEnterpriseOid(SnmpAgentContext *context,
    const uint8_t *enterpriseOid, size_t enterpriseOidLen);
 
+error_t snmpAgentSetTrapInterface(SnmpAgentContext *context,
+   NetInterface *interface);
+
 error_t snmpAgentSetContextEngine(SnmpAgentContext *context,
    const void *contextEngine, size_t contextEngineLen);
 
@@ -171,6 +206,19 @@ error_t snmpAgentSendTrap(SnmpAgentContext *context, const IpAddr *destIpAddr,
    SnmpVersion version, const char_t *username, uint_t genericTrapType,
    uint_t specificTrapCode, const SnmpTrapObject *objectList, uint_t objectListSize);
 
+error_t snmpAgentSendEncodedTrap(SnmpAgentContext *context, const IpAddr *destIpAddr,
+   SnmpVersion version, const char_t *username, uint_t genericTrapType,
+   uint_t specificTrapCode, const uint8_t *varBindList, size_t varBindListLen);
+
+error_t snmpAgentFormatVarBindingList(SnmpAgentContext *context,
+   const SnmpVarBind *varBindList, uint_t varBindListSize,
+   uint8_t *buffer, size_t size, size_t *length);
+
+error_t snmpAgentSendInform(SnmpAgentContext *context, const IpAddr *destIpAddr,
+   SnmpVersion version, const char_t *username, uint_t genericTrapType,
+   uint_t specificTrapCode, const uint8_t *varBindList, size_t varBindListLen,
+   int32_t requestId);
+
 void snmpAgentTask(SnmpAgentContext *context);
 
 #endif
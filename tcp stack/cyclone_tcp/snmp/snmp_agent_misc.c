@@ -32,6 +32,7 @@
 //Dependencies
 #include <limits.h>
 #include "core/net.h"
+#include "core/udp.h"
 #include "snmp/snmp_agent.h"
 #include "snmp/snmp_agent_misc.h"
 #include "mibs/mib2_module.h"
@@ -465,6 +466,37 @@ error_t snmpWriteVarBinding(SnmpAgentContext *context, const SnmpVarBind *var)
 }
 
 
+/**
+ * @brief Append a list of variable bindings that is already encoded
+ * @param[in] context Pointer to the SNMP agent context
+ * @param[in] varBindList Encoded variable bindings
+ * @param[in] varBindListLen Length of the list in bytes
+ * @return Error code
+ **/
+
+error_t snmpWriteVarBindingList(SnmpAgentContext *context,
+   const uint8_t *varBindList, size_t varBindListLen)
+{
+   //Make sure the buffer is large enough to hold the whole list
+   if((context->response.varBindListLen + varBindListLen) >
+      context->response.varBindListMaxLen)
+   {
+      //Report an error
+      return ERROR_BUFFER_OVERFLOW;
+   }
+
+   //Copy the variable bindings after the ones already written
+   memcpy(context->response.varBindList + context->response.varBindListLen,
+      varBindList, varBindListLen);
+
+   //Update the length of the list
+   context->response.varBindListLen += varBindListLen;
+
+   //Successful processing
+   return NO_ERROR;
+}
+
+
 /**
  * @brief Copy the list of variable bindings
  * @param[in] context Pointer to the SNMP agent context
@@ -811,7 +843,6 @@ error_t snmpGetNextObject(SnmpAgentContext *context, SnmpVarBind *var)
 {
    error_t error;
    uint_t i;
-   uint_t j;
    size_t nextOidLen;
    uint8_t *nextOid;
    const MibObject *object;
@@ -819,88 +850,213 @@ error_t snmpGetNextObject(SnmpAgentContext *context, SnmpVarBind *var)
    //Buffer where to store the next object identifier
    nextOid = context->response.varBindList + context->response.varBindListLen;
 
+   //Sequential walk? When the OID is the one returned by the previous
+   //lookup, resume the search from the same object
+   if(context->walkCursorOidLen > 0 && oidComp(var->oid, var->oidLen,
+      context->walkCursorOid, context->walkCursorOidLen) == 0)
+   {
+      i = context->walkCursor;
+   }
+   else
+   {
+      //Locate the first object that may follow the specified OID
+      i = snmpSearchMibIndex(context, var->oid, var->oidLen);
+   }
+
+   //Loop through the sorted list of objects
+   for(; i < context->mibObjectCount; i++)
+   {
+      //Point to the current object
+      object = context->mibObjectIndex[i];
+
+      //Scalar or tabular object?
+      if(object->getNext == NULL)
+      {
+         //Take in account the instance sub-identifier to determine
+         //the length of the OID
+         nextOidLen = object->oidLen + 1;
+
+         //Make sure the buffer is large enough to hold the entire OID
+         if((context->response.varBindListLen + nextOidLen) >
+            context->response.varBindListMaxLen)
+         {
+            //Report an error
+            return ERROR_BUFFER_OVERFLOW;
+         }
+
+         //Copy object identifier
+         memcpy(nextOid, object->oid, object->oidLen);
+         //Append instance sub-identifier
+         nextOid[nextOidLen - 1] = 0;
+
+         //Perform lexicographical comparison
+         if(oidComp(var->oid, var->oidLen, nextOid, nextOidLen) < 0)
+            break;
+      }
+      else
+      {
+         //Maximum acceptable size of the OID
+         nextOidLen = context->response.varBindListMaxLen -
+            context->response.varBindListLen;
+
+         //Search the MIB for the next object
+         error = object->getNext(object, var->oid, var->oidLen, nextOid, &nextOidLen);
+
+         //Check status code
+         if(error == NO_ERROR)
+            break;
+         if(error != ERROR_OBJECT_NOT_FOUND)
+         {
+            //Exit immediately
+            return error;
+         }
+      }
+   }
+
+   //The specified OID does not lexicographically precede the
+   //name of some object?
+   if(i >= context->mibObjectCount)
+      return ERROR_OBJECT_NOT_FOUND;
+
+   //Replace the original OID with the name of the next object
+   var->oid = nextOid;
+   var->oidLen = nextOidLen;
+
+   //Save the length of the OID
+   context->response.oidLen = nextOidLen;
+
+   //Save the position of the walk cursor
+   context->walkCursor = i;
+
+   //Instance OIDs that do not fit in the cursor are located by a
+   //binary search on the next lookup
+   if(nextOidLen <= SNMP_MAX_OID_SIZE)
+   {
+      memcpy(context->walkCursorOid, nextOid, nextOidLen);
+      context->walkCursorOidLen = nextOidLen;
+   }
+   else
+   {
+      context->walkCursorOidLen = 0;
+   }
+
+   //The specified OID lexicographically precedes the name
+   //of the current object
+   return NO_ERROR;
+}
+
+
+/**
+ * @brief Build the sorted index of the objects of all loaded MIBs
+ * @param[in] context Pointer to the SNMP agent context
+ * @return Error code
+ **/
+
+error_t snmpBuildMibIndex(SnmpAgentContext *context)
+{
+   uint_t i;
+   uint_t j;
+   uint_t k;
+   const MibObject *object;
+
+   //Invalidate the walk cursor
+   context->walkCursorOidLen = 0;
+   //Clear the index
+   context->mibObjectCount = 0;
+
    //Loop through MIBs
    for(i = 0; i < context->mibModuleCount; i++)
    {
-      //Point the first object of the MIB
-      object = context->mibModule[i]->objects;
+      //Make sure the index is large enough to hold all the objects
+      if((context->mibObjectCount + context->mibModule[i]->numObjects) >
+         SNMP_AGENT_MAX_MIB_OBJECT_COUNT)
+      {
+         //Report an error
+         return ERROR_OUT_OF_RESOURCES;
+      }
 
       //Loop through objects
       for(j = 0; j < context->mibModule[i]->numObjects; j++)
       {
-         //Scalar or tabular object?
-         if(object->getNext == NULL)
-         {
-            //Take in account the instance sub-identifier to determine
-            //the length of the OID
-            nextOidLen = object->oidLen + 1;
+         //Point to the current object
+         object = &context->mibModule[i]->objects[j];
 
-            //Make sure the buffer is large enough to hold the entire OID
-            if((context->response.varBindListLen + nextOidLen) >
-               context->response.varBindListMaxLen)
+         //Objects are mostly sorted already, hence the insertion sort
+         for(k = context->mibObjectCount; k > 0; k--)
+         {
+            //Compare object identifiers
+            if(oidComp(context->mibObjectIndex[k - 1]->oid,
+               context->mibObjectIndex[k - 1]->oidLen,
+               object->oid, object->oidLen) <= 0)
             {
-               //Report an error
-               return ERROR_BUFFER_OVERFLOW;
+               break;
             }
 
-            //Copy object identifier
-            memcpy(nextOid, object->oid, object->oidLen);
-            //Append instance sub-identifier
-            nextOid[nextOidLen - 1] = 0;
+            //Make room for the new object
+            context->mibObjectIndex[k] = context->mibObjectIndex[k - 1];
+         }
 
-            //Perform lexicographical comparison
-            if(oidComp(var->oid, var->oidLen, nextOid, nextOidLen) < 0)
-            {
-               //Replace the original OID with the name of the next object
-               var->oid = nextOid;
-               var->oidLen = nextOidLen;
+         //Insert the object in the index
+         context->mibObjectIndex[k] = object;
+         //Update the number of objects
+         context->mibObjectCount++;
+      }
+   }
 
-               //Save the length of the OID
-               context->response.oidLen = nextOidLen;
+   //Successful processing
+   return NO_ERROR;
+}
 
-               //The specified OID lexicographically precedes the name
-               //of the current object
-               return NO_ERROR;
-            }
-         }
-         else
-         {
-            //Maximum acceptable size of the OID
-            nextOidLen = context->response.varBindListMaxLen -
-               context->response.varBindListLen;
 
-            //Search the MIB for the next object
-            error = object->getNext(object, var->oid, var->oidLen, nextOid, &nextOidLen);
+/**
+ * @brief Locate the first object that may hold the specified OID or follow it
+ * @param[in] context Pointer to the SNMP agent context
+ * @param[in] oid Object identifier
+ * @param[in] oidLen Length of the OID
+ * @return Position in the object index
+ **/
 
-            //Check status code
-            if(error == NO_ERROR)
-            {
-               //Replace the original OID with the name of the next object
-               var->oid = nextOid;
-               var->oidLen = nextOidLen;
+uint_t snmpSearchMibIndex(SnmpAgentContext *context,
+   const uint8_t *oid, size_t oidLen)
+{
+   uint_t left;
+   uint_t right;
+   uint_t mid;
+   const MibObject *object;
 
-               //Save the length of the OID
-               context->response.oidLen = nextOidLen;
+   //Binary search for the first object whose name is not lower than the OID
+   left = 0;
+   right = context->mibObjectCount;
 
-               //The specified OID lexicographically precedes the name
-               //of the current object
-               return NO_ERROR;
-            }
-            if(error != ERROR_OBJECT_NOT_FOUND)
-            {
-               //Exit immediately
-               return error;
-            }
-         }
+   while(left < right)
+   {
+      mid = (left + right) / 2;
 
-         //Point to the next object in the MIB
-         object++;
+      //Compare object identifiers
+      if(oidComp(context->mibObjectIndex[mid]->oid,
+         context->mibObjectIndex[mid]->oidLen, oid, oidLen) < 0)
+      {
+         left = mid + 1;
+      }
+      else
+      {
+         right = mid;
       }
    }
 
-   //The specified OID does not lexicographically precede the
-   //name of some object
-   return ERROR_OBJECT_NOT_FOUND;
+   //The OID may designate an instance of the preceding object
+   if(left > 0)
+   {
+      //Point to the preceding object
+      object = context->mibObjectIndex[left - 1];
+
+      //Check whether the name of the object is a prefix of the OID
+      if(oidLen > object->oidLen && !memcmp(oid, object->oid, object->oidLen))
+         left--;
+   }
+
+   //Return the position in the object index
+   return left;
 }
 
 
@@ -916,67 +1072,116 @@ error_t snmpGetNextObject(SnmpAgentContext *context, SnmpVarBind *var)
 error_t snmpFindMibObject(SnmpAgentContext *context,
    const uint8_t *oid, size_t oidLen, const MibObject **object)
 {
-   error_t error;
    uint_t i;
-   uint_t j;
    const MibObject *p;
 
-   //Initialize status code
-   error = ERROR_OBJECT_NOT_FOUND;
+   //Locate the object in the sorted index
+   i = snmpSearchMibIndex(context, oid, oidLen);
 
-   //Loop through MIBs
-   for(i = 0; i < context->mibModuleCount; i++)
+   //No object found?
+   if(i >= context->mibObjectCount)
+      return ERROR_OBJECT_NOT_FOUND;
+
+   //Point to the matching object
+   p = context->mibObjectIndex[i];
+
+   //The name of the object must be a prefix of the OID
+   if(oidLen <= p->oidLen || memcmp(oid, p->oid, p->oidLen))
+      return ERROR_OBJECT_NOT_FOUND;
+
+   //Scalar object?
+   if(p->getNext == NULL)
    {
-      //Point the first object of the MIB
-      p = context->mibModule[i]->objects;
+      //The instance sub-identifier shall be 0 for scalar objects
+      if(oidLen != (p->oidLen + 1) || oid[oidLen - 1] != 0)
+      {
+         //No such instance...
+         return ERROR_INSTANCE_NOT_FOUND;
+      }
+   }
 
-      //Loop through objects
-      for(j = 0; j < context->mibModule[i]->numObjects; j++)
+   //Return a pointer to the matching object
+   *object = p;
+   //No error to report
+   return NO_ERROR;
+}
+
+
+/**
+ * @brief Send the response buffer through the specified interface
+ *
+ * The agent socket may listen on all interfaces, so the outgoing interface
+ * cannot be taken from the socket. When no interface is specified, the
+ * stack selects one from the destination address
+ *
+ * @param[in] context Pointer to the SNMP agent context
+ * @param[in] interface Underlying network interface (optional)
+ * @param[in] destIpAddr Destination IP address
+ * @param[in] destPort Destination port
+ * @return Error code
+ **/
+
+error_t snmpSendMessage(SnmpAgentContext *context, NetInterface *interface,
+   const IpAddr *destIpAddr, uint16_t destPort)
+{
+   error_t error;
+   size_t offset;
+   NetBuffer *buffer;
+
+   //Allocate a memory buffer to hold the UDP datagram
+   buffer = udpAllocBuffer(0, &offset);
+   //Failed to allocate buffer?
+   if(buffer == NULL)
+      return ERROR_OUT_OF_MEMORY;
+
+   //Copy the SNMP message
+   error = netBufferAppend(buffer, context->response.pos,
+      context->response.length);
+
+   //Successful processing?
+   if(!error)
+   {
+      //Send UDP datagram
+      error = udpSendDatagramEx(interface, context->socket->localPort,
+         destIpAddr, destPort, buffer, offset, context->socket->ttl);
+   }
+
+   //Free previously allocated memory
+   netBufferFree(buffer);
+   //Return status code
+   return error;
+}
+
+
+/**
+ * @brief Find the interface that owns a local IP address
+ * @param[in] ipAddr Local IP address
+ * @return Pointer to the matching interface (NULL if none)
+ **/
+
+NetInterface *snmpFindInterface(const IpAddr *ipAddr)
+{
+#if (IPV4_SUPPORT == ENABLED)
+   uint_t i;
+
+   //IPv4 address?
+   if(ipAddr->length == sizeof(Ipv4Addr))
+   {
+      //Loop through network interfaces
+      for(i = 0; i < NET_INTERFACE_COUNT; i++)
       {
-         //Check the length of the OID
-         if(oidLen > p->oidLen)
+         //Matching address?
+         if(netInterface[i].ipv4Context.addrState == IPV4_ADDR_STATE_VALID &&
+            netInterface[i].ipv4Context.addr == ipAddr->ipv4Addr)
          {
-            //Compare object names
-            if(!memcmp(oid, p->oid, p->oidLen))
-            {
-               //Scalar object?
-               if(p->getNext == NULL)
-               {
-                  //The instance sub-identifier shall be 0 for scalar objects
-                  if(oidLen == (p->oidLen + 1) && oid[oidLen - 1] == 0)
-                  {
-                     //Return a pointer to the matching object
-                     *object = p;
-                     //No error to report
-                     error = NO_ERROR;
-                  }
-                  else
-                  {
-                     //No such instance...
-                     error = ERROR_INSTANCE_NOT_FOUND;
-                  }
-               }
-               //Tabular object?
-               else
-               {
-                  //Return a pointer to the matching object
-                  *object = p;
-                  //No error to report
-                  error = NO_ERROR;
-               }
-
-               //Exit immediately
-               break;
-            }
+            return &netInterface[i];
          }
-
-         //Point to the next object in the MIB
-         p++;
       }
    }
+#endif
 
-   //Return status code
-   return error;
+   //Let the stack select the interface
+   return NULL;
 }
 
 
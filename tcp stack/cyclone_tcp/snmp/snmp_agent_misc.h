@@ -49,15 +49,25 @@ error_t snmpParseVarBinding(const uint8_t *p,
    size_t length, SnmpVarBind *var, size_t *consumed);
 
 error_t snmpWriteVarBinding(SnmpAgentContext *context, const SnmpVarBind *var);
+error_t snmpWriteVarBindingList(SnmpAgentContext *context,
+   const uint8_t *varBindList, size_t varBindListLen);
 error_t snmpCopyVarBindingList(SnmpAgentContext *context);
 
 error_t snmpSetObjectValue(SnmpAgentContext *context, SnmpVarBind *var, bool_t commit);
 error_t snmpGetObjectValue(SnmpAgentContext *context, SnmpVarBind *var);
 error_t snmpGetNextObject(SnmpAgentContext *context, SnmpVarBind *var);
 
+error_t snmpBuildMibIndex(SnmpAgentContext *context);
+uint_t snmpSearchMibIndex(SnmpAgentContext *context,
+   const uint8_t *oid, size_t oidLen);
+
 error_t snmpFindMibObject(SnmpAgentContext *context,
    const uint8_t *oid, size_t oidLen, const MibObject **object);
 
+error_t snmpSendMessage(SnmpAgentContext *context, NetInterface *interface,
+   const IpAddr *destIpAddr, uint16_t destPort);
+NetInterface *snmpFindInterface(const IpAddr *ipAddr);
+
 error_t snmpTranslateStatusCode(SnmpMessage *message, error_t status, uint_t index);
 
 #endif
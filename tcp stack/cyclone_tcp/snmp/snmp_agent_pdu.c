@@ -82,6 +82,14 @@ error_t snmpProcessPdu(SnmpAgentContext *context)
       //Process SetRequest-PDU
       error = snmpProcessSetRequestPdu(context);
       break;
+#if (SNMP_AGENT_INFORM_SUPPORT == ENABLED)
+   case SNMP_PDU_GET_RESPONSE:
+      //Process GetResponse-PDU
+      error = snmpProcessGetResponsePdu(context);
+      //The notification receiver does not expect any reply
+      if(!error) return ERROR_MESSAGE_DISCARDED;
+      break;
+#endif
    default:
       //Invalid PDU type
       error = ERROR_INVALID_TYPE;
@@ -645,6 +653,45 @@ error_t snmpProcessSetRequestPdu(SnmpAgentContext *context)
 }
 
 
+/**
+ * @brief Process GetResponse-PDU
+ * @param[in] context Pointer to the SNMP agent context
+ * @return Error code
+ **/
+
+error_t snmpProcessGetResponsePdu(SnmpAgentContext *context)
+{
+#if (SNMP_AGENT_INFORM_SUPPORT == ENABLED)
+   SnmpMessage *message;
+
+   //Debug message
+   TRACE_INFO("Parsing GetResponse-PDU...\r\n");
+
+   //Point to the incoming SNMP message
+   message = &context->request;
+
+   //Total number of SNMP Get-Response PDUs which have been accepted and
+   //processed by the SNMP protocol entity
+   MIB2_INC_COUNTER32(mib2Base.snmpGroup.snmpInGetResponses, 1);
+
+   //A GetResponse-PDU received by the agent acknowledges a previously
+   //sent InformRequest-PDU. The request-id identifies the notification
+   if(context->settings.informCallback != NULL)
+   {
+      //Invoke user callback function
+      context->settings.informCallback(&context->remoteIpAddr,
+         message->requestId, message->errorStatus);
+   }
+
+   //Successful processing
+   return NO_ERROR;
+#else
+   //Not implemented
+   return ERROR_NOT_IMPLEMENTED;
+#endif
+}
+
+
 /**
  * @brief Format Trap-PDU or SNMPv2-Trap-PDU
  * @param[in] context Pointer to the SNMP agent context
@@ -654,19 +701,19 @@ error_t snmpProcessSetRequestPdu(SnmpAgentContext *context)
  * @param[in] specificTrapCode Specific code
  * @param[in] objectList List of object names
  * @param[in] objectListSize Number of entries in the list
+ * @param[in] varBindList Variable bindings appended after the objects,
+ *   already encoded
+ * @param[in] varBindListLen Length of the encoded list in bytes
  * @return Error code
  **/
 
 error_t snmpFormatTrapPdu(SnmpAgentContext *context, SnmpVersion version,
    const char_t *username, uint_t genericTrapType, uint_t specificTrapCode,
-   const SnmpTrapObject *objectList, uint_t objectListSize)
+   const SnmpTrapObject *objectList, uint_t objectListSize,
+   const uint8_t *varBindList, size_t varBindListLen)
 {
    error_t error;
-   uint_t i;
-   size_t n;
-   systime_t time;
    SnmpMessage *message;
-   SnmpVarBind var;
 
    //Point to the SNMP message
    message = &context->response;
@@ -804,9 +851,126 @@ error_t snmpFormatTrapPdu(SnmpAgentContext *context, SnmpVersion version,
    //Any error to report?
    if(error) return error;
 
+   //Format the list of variable bindings
+   error = snmpWriteTrapVarBindingList(context, genericTrapType,
+      specificTrapCode, objectList, objectListSize);
+   //Any error to report?
+   if(error) return error;
+
+   //Append the variable bindings that are already encoded
+   error = snmpWriteVarBindingList(context, varBindList, varBindListLen);
+   //Any error to report?
+   if(error) return error;
+
+   //Total number of SNMP Trap PDUs which have been generated by
+   //the SNMP protocol entity
+   MIB2_INC_COUNTER32(mib2Base.snmpGroup.snmpOutTraps, 1);
+
+   //Format PDU header
+   error = snmpWritePduHeader(&context->response);
+   //Return status code
+   return error;
+}
+
+
+/**
+ * @brief Format InformRequest-PDU
+ * @param[in] context Pointer to the SNMP agent context
+ * @param[in] version SNMP version identifier
+ * @param[in] username Community name
+ * @param[in] genericTrapType Generic trap type
+ * @param[in] specificTrapCode Specific code
+ * @param[in] varBindList Variable bindings of the objects, already encoded
+ * @param[in] varBindListLen Length of the list in bytes
+ * @param[in] requestId Request identifier
+ * @return Error code
+ **/
+
+error_t snmpFormatInformRequestPdu(SnmpAgentContext *context, SnmpVersion version,
+   const char_t *username, uint_t genericTrapType, uint_t specificTrapCode,
+   const uint8_t *varBindList, size_t varBindListLen, int32_t requestId)
+{
+#if (SNMP_AGENT_INFORM_SUPPORT == ENABLED && SNMP_V2C_SUPPORT == ENABLED)
+   error_t error;
+   SnmpMessage *message;
+
+   //InformRequest-PDUs are only supported in SNMPv2c messages
+   if(version != SNMP_VERSION_2C)
+      return ERROR_INVALID_VERSION;
+
+   //Point to the SNMP message
+   message = &context->response;
+   //Initialize SNMP message
+   snmpInitMessage(message);
+
+   //SNMP version identifier
+   message->version = version;
+
+   //Community name
+   message->community = username;
+   message->communityLen = strlen(username);
+
+   //Prepare to send an InformRequest-PDU
+   message->pduType = SNMP_PDU_INFORM_REQUEST;
+   //The request-id is used to match the GetResponse-PDU returned
+   //by the notification receiver
+   message->requestId = requestId;
+
+   //Make room for the message header at the beginning of the buffer
+   error = snmpComputeMessageOverhead(&context->response);
+   //Any error to report?
+   if(error) return error;
+
+   //sysUpTime.0 and snmpTrapOID.0 come first
+   error = snmpWriteTrapVarBindingList(context, genericTrapType,
+      specificTrapCode, NULL, 0);
+   //Any error to report?
+   if(error) return error;
+
+   //The objects carry the values they had when the notification was raised
+   error = snmpWriteVarBindingList(context, varBindList, varBindListLen);
+   //Any error to report?
+   if(error) return error;
+
+   //Format PDU header
+   error = snmpWritePduHeader(&context->response);
+   //Return status code
+   return error;
+#else
+   //Not implemented
+   return ERROR_NOT_IMPLEMENTED;
+#endif
+}
+
+
+/**
+ * @brief Format the variable binding list of a notification PDU
+ * @param[in] context Pointer to the SNMP agent context
+ * @param[in] genericTrapType Generic trap type
+ * @param[in] specificTrapCode Specific code
+ * @param[in] objectList List of object names
+ * @param[in] objectListSize Number of entries in the list
+ * @return Error code
+ **/
+
+error_t snmpWriteTrapVarBindingList(SnmpAgentContext *context,
+   uint_t genericTrapType, uint_t specificTrapCode,
+   const SnmpTrapObject *objectList, uint_t objectListSize)
+{
+   error_t error;
+   uint_t i;
+   size_t n;
+   systime_t time;
+   SnmpMessage *message;
+   SnmpVarBind var;
+
+   //Point to the SNMP message
+   message = &context->response;
+
 #if (SNMP_V2C_SUPPORT == ENABLED || SNMP_V3_SUPPORT == ENABLED)
    //SNMPv2c or SNMPv3 version?
-   if(version == SNMP_VERSION_2C || version == SNMP_VERSION_3)
+   if(message->version == SNMP_VERSION_2C ||
+      message->version == SNMP_VERSION_3)
    {
       //Get current time
       time = osGetSystemTime() / 10;
@@ -892,6 +1056,12 @@ error_t snmpFormatTrapPdu(SnmpAgentContext *context, SnmpVersion version,
    }
 #endif
 
+   //Initialize status code
+   error = NO_ERROR;
+
+   //Lock access to MIB bases
+   snmpLockMib(context);
+
    //Loop through the list of objects
    for(i = 0; i < objectListSize; i++)
    {
@@ -902,20 +1072,17 @@ error_t snmpFormatTrapPdu(SnmpAgentContext *context, SnmpVersion version,
       //Retrieve object value
       error = snmpGetObjectValue(context, &var);
       //Any error to report?
-      if(error) return error;
+      if(error) break;
 
       //Append variable binding to the list
       error = snmpWriteVarBinding(context, &var);
       //Any error to report?
-      if(error) return error;
+      if(error) break;
    }
 
-   //Total number of SNMP Trap PDUs which have been generated by
-   //the SNMP protocol entity
-   MIB2_INC_COUNTER32(mib2Base.snmpGroup.snmpOutTraps, 1);
+   //Unlock access to MIB bases
+   snmpUnlockMib(context);
 
-   //Format PDU header
-   error = snmpWritePduHeader(&context->response);
    //Return status code
    return error;
 }
@@ -39,9 +39,19 @@ error_t snmpProcessPdu(SnmpAgentContext *context);
 error_t snmpProcessGetRequestPdu(SnmpAgentContext *context);
 error_t snmpProcessGetBulkRequestPdu(SnmpAgentContext *context);
 error_t snmpProcessSetRequestPdu(SnmpAgentContext *context);
+error_t snmpProcessGetResponsePdu(SnmpAgentContext *context);
 
 error_t snmpFormatTrapPdu(SnmpAgentContext *context, SnmpVersion version,
    const char_t *username, uint_t genericTrapType, uint_t specificTrapCode,
+   const SnmpTrapObject *objectList, uint_t objectListSize,
+   const uint8_t *varBindList, size_t varBindListLen);
+
+error_t snmpFormatInformRequestPdu(SnmpAgentContext *context, SnmpVersion version,
+   const char_t *username, uint_t genericTrapType, uint_t specificTrapCode,
+   const uint8_t *varBindList, size_t varBindListLen, int32_t requestId);
+
+error_t snmpWriteTrapVarBindingList(SnmpAgentContext *context,
+   uint_t genericTrapType, uint_t specificTrapCode,
    const SnmpTrapObject *objectList, uint_t objectListSize);
 
 error_t snmpFormatReportPdu(SnmpAgentContext *context, error_t errorIndication);
@@ -178,6 +178,128 @@ error_t snmpGenerateKey(SnmpAuthProtocol authProtocol, const char_t *password,
 }
 
 
+/**
+ * @brief Get the hash function used by an authentication protocol
+ * @param[in] authProtocol Authentication protocol
+ * @return Hash algorithm (NULL if the protocol is not supported)
+ **/
+
+static const HashAlgo *snmpGetAuthHashAlgo(SnmpAuthProtocol authProtocol)
+{
+#if (SNMP_MD5_SUPPORT == ENABLED)
+   //HMAC-MD5-96 authentication protocol?
+   if(authProtocol == SNMP_AUTH_PROTOCOL_MD5)
+      return MD5_HASH_ALGO;
+#endif
+#if (SNMP_SHA1_SUPPORT == ENABLED)
+   //HMAC-SHA-1-96 authentication protocol?
+   if(authProtocol == SNMP_AUTH_PROTOCOL_SHA1)
+      return SHA1_HASH_ALGO;
+#endif
+#if (SNMP_SHA224_SUPPORT == ENABLED)
+   //HMAC-SHA-224-128 authentication protocol?
+   if(authProtocol == SNMP_AUTH_PROTOCOL_SHA224)
+      return SHA224_HASH_ALGO;
+#endif
+#if (SNMP_SHA256_SUPPORT == ENABLED)
+   //HMAC-SHA-256-192 authentication protocol?
+   if(authProtocol == SNMP_AUTH_PROTOCOL_SHA256)
+      return SHA256_HASH_ALGO;
+#endif
+#if (SNMP_SHA384_SUPPORT == ENABLED)
+   //HMAC-SHA-384-256 authentication protocol?
+   if(authProtocol == SNMP_AUTH_PROTOCOL_SHA384)
+      return SHA384_HASH_ALGO;
+#endif
+#if (SNMP_SHA512_SUPPORT == ENABLED)
+   //HMAC-SHA-512-384 authentication protocol?
+   if(authProtocol == SNMP_AUTH_PROTOCOL_SHA512)
+      return SHA512_HASH_ALGO;
+#endif
+
+   //Invalid authentication protocol
+   return NULL;
+}
+
+
+/**
+ * @brief Precompute the HMAC inner and outer pad states
+ *
+ * The authentication key of a user does not change between messages, so the
+ * hash states reached after absorbing K XOR ipad and K XOR opad are computed
+ * once. Each message then costs two compression function calls less
+ *
+ * @param[in,out] user Security profile of the user
+ * @return Error code
+ **/
+
+error_t snmpPrecomputeHmacPads(SnmpUserInfo *user)
+{
+   uint_t i;
+   const HashAlgo *hash;
+   uint8_t pad[MAX_HASH_BLOCK_SIZE];
+
+   //Retrieve the hash function of the authentication protocol
+   hash = snmpGetAuthHashAlgo(user->authProtocol);
+   //Invalid authentication protocol?
+   if(hash == NULL)
+      return ERROR_INVALID_PARAMETER;
+
+   //The localized key is never longer than the block size, so it is
+   //simply padded to the right with extra zeros
+   memset(pad, 0, hash->blockSize);
+   memcpy(pad, user->authKey.b, hash->digestSize);
+
+   //XOR the resulting key with ipad
+   for(i = 0; i < hash->blockSize; i++)
+      pad[i] ^= HMAC_IPAD;
+
+   //Save the hash state after the inner pad
+   hash->init(user->authInnerContext);
+   hash->update(user->authInnerContext, pad, hash->blockSize);
+
+   //XOR the original key with opad
+   for(i = 0; i < hash->blockSize; i++)
+      pad[i] ^= HMAC_IPAD ^ HMAC_OPAD;
+
+   //Save the hash state after the outer pad
+   hash->init(user->authOuterContext);
+   hash->update(user->authOuterContext, pad, hash->blockSize);
+
+   //Do not leave key material on the stack
+   memset(pad, 0, sizeof(pad));
+
+   //Successful processing
+   return NO_ERROR;
+}
+
+
+/**
+ * @brief Compute HMAC using the precomputed pad states
+ * @param[in] user Security profile of the user
+ * @param[in] hash Hash function of the authentication protocol
+ * @param[in] data Pointer to the message
+ * @param[in] length Length of the message
+ * @param[out] digest Resulting MAC (hash->digestSize bytes)
+ **/
+
+static void snmpComputeHmac(const SnmpUserInfo *user, const HashAlgo *hash,
+   const void *data, size_t length, uint8_t *digest)
+{
+   uint8_t context[MAX_HASH_CONTEXT_SIZE];
+
+   //First pass, resumed from the inner pad state
+   memcpy(context, user->authInnerContext, hash->contextSize);
+   hash->update(context, data, length);
+   hash->final(context, digest);
+
+   //Second pass, resumed from the outer pad state
+   memcpy(context, user->authOuterContext, hash->contextSize);
+   hash->update(context, digest, hash->digestSize);
+   hash->final(context, digest);
+}
+
+
 /**
  * @brief Check security parameters
  * @param[in] user Security profile of the user
@@ -238,7 +360,7 @@ error_t snmpAuthOutgoingMessage(const SnmpUserInfo *user, SnmpMessage *message)
 {
    const HashAlgo *hash;
    size_t hmacDigestSize;
-   HmacContext hmacContext;
+   uint8_t digest[MAX_HASH_DIGEST_SIZE];
 
 #if (SNMP_MD5_SUPPORT == ENABLED)
    //HMAC-MD5-96 authentication protocol?
@@ -317,12 +439,10 @@ error_t snmpAuthOutgoingMessage(const SnmpUserInfo *user, SnmpMessage *message)
       return ERROR_FAILURE;
 
    //The MAC is calculated over the whole message
-   hmacInit(&hmacContext, hash, user->authKey.b, hash->digestSize);
-   hmacUpdate(&hmacContext, message->pos, message->length);
-   hmacFinal(&hmacContext, NULL);
+   snmpComputeHmac(user, hash, message->pos, message->length, digest);
 
    //Replace the msgAuthenticationParameters field with the calculated MAC
-   memcpy(message->msgAuthParameters, hmacContext.digest, hmacDigestSize);
+   memcpy(message->msgAuthParameters, digest, hmacDigestSize);
 
    //Successful message authentication
    return NO_ERROR;
@@ -341,7 +461,7 @@ error_t snmpAuthIncomingMessage(const SnmpUserInfo *user, SnmpMessage *message)
    const HashAlgo *hash;
    size_t hmacDigestSize;
    uint8_t hmacDigest[SNMP_MAX_HMAC_DIGEST_SIZE];
-   HmacContext hmacContext;
+   uint8_t digest[MAX_HASH_DIGEST_SIZE];
 
 #if (SNMP_MD5_SUPPORT == ENABLED)
    //HMAC-MD5-96 authentication protocol?
@@ -427,16 +547,14 @@ error_t snmpAuthIncomingMessage(const SnmpUserInfo *user, SnmpMessage *message)
    memset(message->msgAuthParameters, 0, hmacDigestSize);
 
    //The MAC is calculated over the whole message
-   hmacInit(&hmacContext, hash, user->authKey.b, hash->digestSize);
-   hmacUpdate(&hmacContext, message->buffer, message->bufferLen);
-   hmacFinal(&hmacContext, NULL);
+   snmpComputeHmac(user, hash, message->buffer, message->bufferLen, digest);
 
    //Restore the value of the msgAuthenticationParameters field
    memcpy(message->msgAuthParameters, hmacDigest, hmacDigestSize);
 
    //The newly calculated MAC is compared with the MAC value that was
    //saved in the first step
-   if(memcmp(hmacContext.digest, hmacDigest, hmacDigestSize))
+   if(memcmp(digest, hmacDigest, hmacDigestSize))
       return ERROR_AUTHENTICATION_FAILED;
 
    //Successful message authentication
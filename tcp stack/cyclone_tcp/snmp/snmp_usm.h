@@ -276,6 +276,8 @@ typedef struct
    SnmpKey authKey;                         ///<Authentication key
    SnmpPrivProtocol privProtocol;           ///<Privacy protocol
    SnmpKey privKey;                         ///<Privacy key
+   uint8_t authInnerContext[MAX_HASH_CONTEXT_SIZE]; ///<Hash state after the inner pad (K XOR ipad)
+   uint8_t authOuterContext[MAX_HASH_CONTEXT_SIZE]; ///<Hash state after the outer pad (K XOR opad)
 #endif
 } SnmpUserInfo;
 
@@ -292,6 +294,8 @@ extern const uint8_t usmStatsDecryptionErrorsObject[10];
 error_t snmpGenerateKey(SnmpAuthProtocol authProtocol, const char_t *password,
    const uint8_t *engineId, size_t engineIdLen, SnmpKey *key);
 
+error_t snmpPrecomputeHmacPads(SnmpUserInfo *user);
+
 error_t snmpCheckSecurityParameters(const SnmpUserInfo *user,
    SnmpMessage *message, const uint8_t *engineId, size_t engineIdLen);
 
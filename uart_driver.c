@@ -28,6 +28,8 @@
 //Dependencies
 #include <stdio.h>
 #include "fsl_uart.h"
+#include "fsl_edma.h"
+#include "fsl_dmamux.h"
 #include "core/net.h"
 #include "ppp/ppp_hdlc.h"
 #include "uart_driver.h"
@@ -38,6 +40,42 @@
 //Disable hardware flow control
 #define APP_UART_HW_FLOW_CTRL DISABLE
 
+//Size of the eDMA receive ring (the destination address wraps around
+//with the eDMA modulo feature, so the ring is aligned on its size and the
+//alignment pragma below must match)
+#define UART_RX_RING_SIZE 256
+#define UART_RX_RING_MODULO kEDMA_Modulo256bytes
+
+//Largest block sent by one eDMA transfer, the space it takes in the HDLC
+//TX queue is released when the transfer completes
+#define UART_TX_BLOCK_SIZE 512
+
+//IAR EWARM compiler?
+#if defined(__ICCARM__)
+
+//eDMA receive ring
+#pragma data_alignment = 256
+static uint8_t uartRxRing[UART_RX_RING_SIZE];
+
+//ARM or GCC compiler?
+#else
+
+//eDMA receive ring
+static uint8_t uartRxRing[UART_RX_RING_SIZE]
+  __attribute__((aligned(UART_RX_RING_SIZE)));
+
+#endif
+
+//Index of the first received byte not yet passed to the HDLC driver
+static uint_t uartRxIndex;
+//Length of the block being sent (0 when the transmitter is idle)
+static size_t uartTxLength;
+
+//Forward declaration of functions
+static void uartStartRxDma(void);
+static void uartSendBlock(void);
+static bool_t uartReadRxRing(void);
+
 
 /**
 * @brief UART driver
@@ -60,6 +98,7 @@ const UartDriver uartDriver =
 error_t uartInit(void)
 {
   uart_config_t config;
+  edma_config_t edmaConfig;
   //Debug message
   TRACE_INFO("Initializing UART for ppp modem...\r\n");
   // configure UART RX - TX pin if neccessary
@@ -71,12 +110,26 @@ error_t uartInit(void)
   config.enableRx = true;
   UART_Init(MODEM_UART, &config, CLOCK_GetFreq(MODEM_UART_CLKSRC));
   
-  //Configure USART1 interrupts
-  // configure TXE and RXNE interrup - not enable at this point
-  UART_EnableInterrupts(MODEM_UART, kUART_RxDataRegFullInterruptEnable | kUART_RxOverrunInterruptEnable);
+  //Route the UART DMA requests to their eDMA channels
+  DMAMUX_Init(MODEM_UART_DMAMUX);
+  DMAMUX_SetSource(MODEM_UART_DMAMUX, MODEM_UART_RX_DMA_CHANNEL, MODEM_UART_RX_DMA_REQUEST);
+  DMAMUX_EnableChannel(MODEM_UART_DMAMUX, MODEM_UART_RX_DMA_CHANNEL);
+  DMAMUX_SetSource(MODEM_UART_DMAMUX, MODEM_UART_TX_DMA_CHANNEL, MODEM_UART_TX_DMA_REQUEST);
+  DMAMUX_EnableChannel(MODEM_UART_DMAMUX, MODEM_UART_TX_DMA_CHANNEL);
+  EDMA_GetDefaultConfig(&edmaConfig);
+  EDMA_Init(MODEM_UART_DMA, &edmaConfig);
+  
+  //Received bytes go to the ring by eDMA, the CPU is interrupted when the
+  //ring is half full, full, or when the line goes idle after a burst
+  uartTxLength = 0;
+  uartStartRxDma();
+  UART_EnableRxDMA(MODEM_UART, true);
+  UART_EnableInterrupts(MODEM_UART, kUART_IdleLineInterruptEnable | kUART_RxOverrunInterruptEnable);
   NVIC_SetPriorityGrouping(3);
-  //Configure interrupt priority
+  //Configure interrupt priority, the three handlers do not preempt each other
   NVIC_SetPriority(MODEM_UART_IRQn, NVIC_EncodePriority(3, 12, 0));
+  NVIC_SetPriority(MODEM_UART_RX_DMA_IRQn, NVIC_EncodePriority(3, 12, 0));
+  NVIC_SetPriority(MODEM_UART_TX_DMA_IRQn, NVIC_EncodePriority(3, 12, 0));
   //Enable USART if neccessary
   //Successful processing
   return NO_ERROR;
@@ -89,8 +142,10 @@ error_t uartInit(void)
 
 void uartEnableIrq(void)
 {
-  //Enable modem UART interrupts
+  //Enable modem UART and eDMA interrupts
   EnableIRQ(MODEM_UART_IRQn);
+  EnableIRQ(MODEM_UART_RX_DMA_IRQn);
+  EnableIRQ(MODEM_UART_TX_DMA_IRQn);
 }
 
 
@@ -100,8 +155,10 @@ void uartEnableIrq(void)
 
 void uartDisableIrq(void)
 {
-  //Disable USART1 interrupt
+  //Disable modem UART and eDMA interrupts
   DisableIRQ(MODEM_UART_IRQn);
+  DisableIRQ(MODEM_UART_RX_DMA_IRQn);
+  DisableIRQ(MODEM_UART_TX_DMA_IRQn);
 }
 
 
@@ -111,8 +168,115 @@ void uartDisableIrq(void)
 
 void uartStartTx(void)
 {
-  //Enable TXE interrupt
-  UART_EnableInterrupts(MODEM_UART, kUART_TxDataRegEmptyInterruptEnable);
+  //Enter critical section
+  __disable_irq();
+  
+  //Send the pending data unless a transfer is in progress
+  if(uartTxLength == 0)
+    uartSendBlock();
+  
+  //Exit critical section
+  __enable_irq();
+}
+
+
+/**
+* @brief Start the circular eDMA transfer to the receive ring
+**/
+
+static void uartStartRxDma(void)
+{
+  edma_transfer_config_t config;
+  
+  //One byte per request, the major loop covers the ring once
+  EDMA_ResetChannel(MODEM_UART_DMA, MODEM_UART_RX_DMA_CHANNEL);
+  EDMA_PrepareTransfer(&config, (void *) UART_GetDataRegisterAddress(MODEM_UART), 1,
+    uartRxRing, 1, 1, UART_RX_RING_SIZE, kEDMA_PeripheralToMemory);
+  EDMA_SetTransferConfig(MODEM_UART_DMA, MODEM_UART_RX_DMA_CHANNEL, &config, NULL);
+  
+  //The destination address wraps around at the end of the ring and the
+  //channel restarts after each major loop
+  EDMA_SetModulo(MODEM_UART_DMA, MODEM_UART_RX_DMA_CHANNEL, kEDMA_ModuloDisable, UART_RX_RING_MODULO);
+  EDMA_EnableChannelInterrupts(MODEM_UART_DMA, MODEM_UART_RX_DMA_CHANNEL,
+    kEDMA_HalfInterruptEnable | kEDMA_MajorInterruptEnable);
+  
+  //Start at the beginning of the ring
+  uartRxIndex = 0;
+  EDMA_EnableChannelRequest(MODEM_UART_DMA, MODEM_UART_RX_DMA_CHANNEL);
+}
+
+
+/**
+* @brief Send the data at the head of the HDLC TX queue by eDMA
+*
+* Called with the interrupts disabled or from the TX eDMA interrupt
+*
+**/
+
+static void uartSendBlock(void)
+{
+  const uint8_t *data;
+  edma_transfer_config_t config;
+  
+  //Contiguous data pending in the TX queue
+  uartTxLength = pppHdlcDriverGetTxBlock(&netInterface[1], &data);
+  uartTxLength = MIN(uartTxLength, UART_TX_BLOCK_SIZE);
+  
+  //Nothing to send?
+  if(uartTxLength == 0)
+    return;
+  
+  //The data is read in place from the queue, one byte per request
+  EDMA_PrepareTransfer(&config, (void *) data, 1,
+    (void *) UART_GetDataRegisterAddress(MODEM_UART), 1, 1, uartTxLength, kEDMA_MemoryToPeripheral);
+  EDMA_SetTransferConfig(MODEM_UART_DMA, MODEM_UART_TX_DMA_CHANNEL, &config, NULL);
+  
+  //Stop the requests and interrupt when the block has been sent
+  EDMA_EnableAutoStopRequest(MODEM_UART_DMA, MODEM_UART_TX_DMA_CHANNEL, true);
+  EDMA_EnableChannelInterrupts(MODEM_UART_DMA, MODEM_UART_TX_DMA_CHANNEL, kEDMA_MajorInterruptEnable);
+  EDMA_EnableChannelRequest(MODEM_UART_DMA, MODEM_UART_TX_DMA_CHANNEL);
+  UART_EnableTxDMA(MODEM_UART, true);
+}
+
+
+/**
+* @brief Pass the bytes written by eDMA to the HDLC driver
+* @return TRUE if a context switch is required
+**/
+
+static bool_t uartReadRxRing(void)
+{
+  uint_t index;
+  bool_t flag;
+  NetInterface *interface;
+  
+  //Point to the PPP network interface
+  interface = &netInterface[1];
+  //This flag will be set if a higher priority task must be woken
+  flag = FALSE;
+  
+  //Position of the eDMA in the ring
+  index = (UART_RX_RING_SIZE - EDMA_GetRemainingMajorLoopCount(MODEM_UART_DMA,
+    MODEM_UART_RX_DMA_CHANNEL)) % UART_RX_RING_SIZE;
+  
+  //The new data wraps around the end of the ring?
+  if(index < uartRxIndex)
+  {
+    flag |= pppHdlcDriverWriteRxBlock(interface, uartRxRing + uartRxIndex,
+      UART_RX_RING_SIZE - uartRxIndex);
+    uartRxIndex = 0;
+  }
+  
+  //Data up to the eDMA position
+  if(index > uartRxIndex)
+  {
+    flag |= pppHdlcDriverWriteRxBlock(interface, uartRxRing + uartRxIndex,
+      index - uartRxIndex);
+    uartRxIndex = index;
+  }
+  
+  //The return value tells whether a context switch is required
+  return flag;
 }
 
 
@@ -122,9 +286,8 @@ void uartStartTx(void)
 
 void MODEM_UART_IRQHandler(void)
 {
-  int_t c;
   bool_t flag;
-  NetInterface *interface;
+  uint32_t status;
   
   //Enter interrupt service routine
   osEnterIsr();
@@ -132,39 +295,20 @@ void MODEM_UART_IRQHandler(void)
   //This flag will be set if a higher priority task must be woken
   flag = FALSE;
   
-  //Point to the PPP network interface
-  interface = &netInterface[1];
-  
-  //TXE interrupt?
-  if(kUART_TxDataRegEmptyFlag & UART_GetStatusFlags(MODEM_UART))
-  {
-    //Get next character
-    flag |= pppHdlcDriverReadTxQueue(interface, &c);
-    
-    //Valid character read?
-    if(c != EOF)
-    {
-      //Send data byte
-      MODEM_UART->D = c;
-    }
-    else
-    {
-      //Disable TXE interrupt
-     UART_DisableInterrupts(MODEM_UART, kUART_TxDataRegEmptyInterruptEnable);
-    }
-  }
+  //Read the status register
+  status = UART_GetStatusFlags(MODEM_UART);
   
-  //RXNE interrupt?
-  if(kUART_RxDataRegFullFlag & UART_GetStatusFlags(MODEM_UART))
+  //Idle line interrupt?
+  if(status & kUART_IdleLineFlag)
   {
-    //Read data byte
-    c = UART_ReadByte(MODEM_UART);
-    //Process incoming character
-    flag |= pppHdlcDriverWriteRxQueue(interface, c);
+    //Clear IDLE interrupt flag
+    UART_ClearStatusFlags(MODEM_UART, kUART_IdleLineFlag);
+    //The end of a burst, pass the bytes received so far
+    flag |= uartReadRxRing();
   }
   
   //ORE interrupt?
-  if(kUART_RxOverrunFlag & UART_GetStatusFlags(MODEM_UART))
+  if(status & kUART_RxOverrunFlag)
   {
     //Clear ORE interrupt flag
     UART_ClearStatusFlags(MODEM_UART, kUART_RxOverrunFlag);
@@ -173,3 +317,49 @@ void MODEM_UART_IRQHandler(void)
   //Leave interrupt service routine
   osExitIsr(flag);
 }
+
+
+/**
+* @brief Receive eDMA interrupt handler (receive ring half full or full)
+**/
+
+void MODEM_UART_RX_DMA_IRQHandler(void)
+{
+  bool_t flag;
+  
+  //Enter interrupt service routine
+  osEnterIsr();
+  
+  //Clear the interrupt flag of the channel
+  EDMA_ClearChannelStatusFlags(MODEM_UART_DMA, MODEM_UART_RX_DMA_CHANNEL, kEDMA_InterruptFlag);
+  //Pass the received bytes before the eDMA overwrites them
+  flag = uartReadRxRing();
+  
+  //Leave interrupt service routine
+  osExitIsr(flag);
+}
+
+
+/**
+* @brief Transmit eDMA interrupt handler (block sent)
+**/
+
+void MODEM_UART_TX_DMA_IRQHandler(void)
+{
+  bool_t flag;
+  
+  //Enter interrupt service routine
+  osEnterIsr();
+  
+  //Clear the interrupt and done flags of the channel
+  EDMA_ClearChannelStatusFlags(MODEM_UART_DMA, MODEM_UART_TX_DMA_CHANNEL,
+    kEDMA_InterruptFlag | kEDMA_DoneFlag);
+  
+  //Remove the block from the TX queue
+  flag = pppHdlcDriverReleaseTxBlock(&netInterface[1], uartTxLength);
+  //Send the data queued in the meantime
+  uartSendBlock();
+  
+  //Leave interrupt service routine
+  osExitIsr(flag);
+}
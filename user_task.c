@@ -31,6 +31,10 @@
 #include "modem_interface.h"
 #endif
 
+#if (USERDEF_DATA_USAGE == ENABLED)
+#include "data_usage.h"
+#endif
+
 #include "i2c_lock.h"
 #include "am2320.h"
 
@@ -294,6 +298,14 @@ static void rs485_task(void *pvParameters) {
       Modbus.runningStep = _READ_ATS_STATUS;
       break;
     case _READ_ATS_STATUS:
+      //A poll cycle starts and ends with the ATS query
+      if (Modbus.cycleStartTime != 0)
+      {
+        Modbus.cycleTime = osGetSystemTime() - Modbus.cycleStartTime;
+        if (Modbus.cycleTime > Modbus.maxCycleTime)
+          Modbus.maxCycleTime = Modbus.cycleTime;
+      }
+      Modbus.cycleStartTime = osGetSystemTime();
       Modbus.u8DataPointer = 0;
       Read_Holding_Regs_Query(0x01,0x00,33);
       Modbus.runningStep = _WAIT_ATS_RESPOND;
@@ -333,7 +345,8 @@ static void rs485_task(void *pvParameters) {
       }
       break;
     case _WAIT_DOOR_RESPOND:
-      reVal = -1;
+      //Consume the reply, a frame left in the buffer fails the next poll
+      reVal = RS4851_Check_Respond_Data();
       if(reVal != 1)
       {
         Modbus.doorNorespond ++;
@@ -587,9 +600,6 @@ static void SwTimerCallback(TimerHandle_t xTimer)
       IO_OPENDOOR_MCU_ON();
     }
   }
-#if (USERDEF_SNMPCONNECT_MANAGER == ENABLED)
-  snmpConnectIncreaseTick();
-#endif
 }
 #endif // USERDEF_SW_TIMER == ENABLED
 
@@ -686,6 +696,17 @@ void UserTaskInit()
   }
 #endif
   
+#if (USERDEF_DATA_USAGE == ENABLED)
+  //Create a task to count the data usage against the GPRS budget
+  task = osCreateTask("Data Usage", dataUsageTask, NULL, DATA_USAGE_STACK_SIZE, OS_TASK_PRIORITY_NORMAL);
+  //Failed to create the task?
+  if(task == OS_INVALID_HANDLE)
+  {
+    //Debug message
+    TRACE_ERROR("Failed to create Data Usage task!\r\n");
+  }
+#endif
+  
 #if (USERDEF_CHAUNM_TEST_DOOR == ENABLED)
   task = osCreateTask("DOOR TEST", TestOpenDoorUpdate, NULL, 100, OS_TASK_PRIORITY_NORMAL);
   //Failed to create the task?
@@ -21,6 +21,10 @@
 #define DEVICE_NAME_MAX_LENGTH      16
 #define DEVICE_MAC_EEPROM_ADDR		102
 #define DEVICE_MAC_ID_LENGTH		17
+#define SNMP_ENGINE_BOOTS_EEPROM_ADDR   200
+#define SNMP_KEY_CACHE_EEPROM_ADDR      256
+#define DATA_USAGE_EEPROM_ADDR          384
+#define SNMP_ALARM_INFORM_EEPROM_ADDR   1024
 
 typedef struct TimeFormat
 {